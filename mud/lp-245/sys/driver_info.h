@@ -31,6 +31,10 @@
 #define DI_TRACE_LAST_UNCAUGHT_ERROR                         -45
 #define DI_TRACE_LAST_UNCAUGHT_ERROR_AS_STRING               -46
 
+/* Profiling */
+#define DI_PROFILE_SAMPLES                                   -50
+#define DI_PROFILE_FUNCTIONS                                 -51
+
 /* LPC Runtime statistics */
 #define DI_NUM_FUNCTION_NAME_CALLS                          -100
 #define DI_NUM_FUNCTION_NAME_CALL_HITS                      -101
@@ -42,6 +46,10 @@
 #define DI_NUM_HEARTBEAT_ACTIVE_CYCLES                      -105
 #define DI_NUM_HEARTBEATS_LAST_PROCESSED                    -106
 
+#define DI_NUM_CALL_SITE_CACHE_HITS                         -107
+#define DI_NUM_CALL_SITE_CACHE_MISSES                       -108
+#define DI_NUM_FUNCTION_NAME_CALL_EVICTIONS                 -109
+
 #define DI_NUM_STRING_TABLE_STRINGS_ADDED                   -110
 #define DI_NUM_STRING_TABLE_STRINGS_REMOVED                 -111
 #define DI_NUM_STRING_TABLE_LOOKUPS_BY_VALUE                -112
@@ -51,12 +59,43 @@
 #define DI_NUM_STRING_TABLE_HITS_BY_VALUE                   -116
 #define DI_NUM_STRING_TABLE_HITS_BY_INDEX                   -117
 #define DI_NUM_STRING_TABLE_COLLISIONS                      -118
+#define DI_NUM_STRING_TABLE_RESIZES                         -119
 
 #define DI_NUM_REGEX_LOOKUPS                                -120
 #define DI_NUM_REGEX_LOOKUP_HITS                            -121
 #define DI_NUM_REGEX_LOOKUP_MISSES                          -122
 #define DI_NUM_REGEX_LOOKUP_COLLISIONS                      -123
 
+#define DI_NUM_OBJECTS_RESET_QUEUE                          -130
+#define DI_NUM_OBJECTS_CLEAN_UP_QUEUE                       -131
+#define DI_NUM_OBJECTS_DATA_CLEAN_QUEUE                     -132
+#define DI_NUM_OBJECTS_SWAP_QUEUE                           -133
+
+#define DI_NUM_MAPPING_COMPACTIONS                          -140
+#define DI_NUM_MAPPING_COMPACTIONS_LAST_CYCLE               -141
+#define DI_SIZE_MAPPING_COMPACTIONS_SAVED                   -142
+#define DI_SIZE_MAPPING_COMPACTIONS_SAVED_LAST_CYCLE        -143
+
+#define DI_NUM_PROGRAM_CACHE_HITS                           -150
+#define DI_NUM_PROGRAM_CACHE_MISSES                         -151
+#define DI_NUM_INCLUDE_CACHE_HITS                           -152
+#define DI_NUM_INCLUDE_CACHE_MISSES                         -153
+#define DI_NUM_INCLUDE_CACHE_REPLAYS                        -154
+#define DI_NUM_STRING_APPENDS_IN_PLACE                      -155
+#define DI_NUM_STRING_APPENDS_COPIED                        -156
+#define DI_NUM_JIT_LOOPS_COMPILED                           -157
+#define DI_NUM_JIT_LOOPS_FAILED                             -158
+#define DI_NUM_JIT_RUNS                                     -159
+#define DI_SIZE_JIT_CODE                                    -160
+#define DI_NUM_PROFILE_SAMPLES                              -161
+#define DI_NUM_PROFILE_SAMPLES_LOST                         -162
+#define DI_NUM_GC_SLICES                                    -163
+#define DI_GC_LAST_PAUSE                                    -164
+#define DI_GC_MAX_PAUSE                                     -165
+#define DI_GC_MAX_SLICE                                     -166
+#define DI_NUM_CC_ROOTS_SCANNED                             -167
+#define DI_NUM_CC_FREED                                     -168
+
 /* Network statistics */
 #define DI_NUM_MESSAGES_OUT                                 -200
 #define DI_NUM_PACKETS_OUT                                  -201
@@ -101,6 +140,9 @@
 #define DI_NUM_STRING_TABLE_SLOTS_USED                      -426
 #define DI_NUM_REGEX                                        -427
 #define DI_NUM_REGEX_TABLE_SLOTS                            -428
+#define DI_NUM_STRING_TABLE_LONGEST_CHAIN                   -429
+#define DI_NUM_STRING_TABLE_LONGEST_CHAIN_BEFORE_RESIZE     -430
+#define DI_NUM_STRING_TABLE_CHAINS_TO_REHASH                -431
 
 #define DI_SIZE_ACTIONS                                     -450
 #define DI_SIZE_CALLOUTS                                    -451
@@ -124,6 +166,7 @@
 #define DI_SIZE_REGEX                                       -469
 #define DI_SIZE_BUFFER_FILE                                 -470
 #define DI_SIZE_BUFFER_SWAP                                 -471
+#define DI_SIZE_OBJECT_QUEUES                               -472
 
 /* Memory swapper statistics */
 #define DI_NUM_SWAP_BLOCKS                                  -500
@@ -177,6 +220,8 @@
 #define DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_INSPECTED      -658
 #define DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_MERGED         -659
 #define DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_RESULTING      -660
+#define DI_NUM_LARGE_BLOCKS_RELEASED                        -661
+#define DI_SIZE_LARGE_BLOCKS_RELEASED                       -662
 
 #define DI_MEMORY_EXTENDED_STATISTICS                       -670
 
@@ -209,6 +254,19 @@
 #define DDI_OBJECTS_DESTRUCTED          1
 #define DDI_OPCODES                     2
 #define DDI_MEMORY                      3
+#define DDI_PROFILE                     4
+
+/* Indices into the values of the mapping resulting from
+ * driver_info(DI_PROFILE_FUNCTIONS)
+ */
+
+#define PROFILE_CALLS      0
+#define PROFILE_TICKS_SELF 1
+#define PROFILE_TICKS      2
+#define PROFILE_TIME_SELF  3
+#define PROFILE_TIME       4
+
+#define PROFILE_MAX        5
 
 /* Indices into the subarrays resulting from driver_info(DI_TRACE_*)
  */
@@ -1106,6 +1106,7 @@ mixed valid_write (string path, string euid, string fun, object caller)
 //   memdump
 //   objdump
 //   opcdump
+//   profdump
 //   save_object
 //   remove_file
 //   rmdir
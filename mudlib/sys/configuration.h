@@ -36,5 +36,10 @@
 #define DC_EXTRA_WIZINFO_SIZE            7
 #define DC_DEFAULT_RUNTIME_LIMITS        8
 #define DC_SWAP_COMPACT_MODE             9
+#define DC_APPLY_CACHE_SIZE             10
+#define DC_PROFILE_INTERVAL             11
+#define DC_PROFILE_FUNCTIONS            12
+#define DC_GC_SLICE_TIME                13
+#define DC_CYCLE_COLLECTION             14
 
 #endif /* LPC_CONFIGURATION_H_ */
@@ -157,6 +157,9 @@ _allocate_array(mp_int n MTRACE_DECL)
 
     p->ref = 1;
     p->size = n;
+#ifdef USE_CYCLE_COLLECTOR
+    p->cc_root = 0;
+#endif
     if (current_object)
         (p->user = current_object->user)->size_array += n;
     else
@@ -216,6 +219,9 @@ _allocate_array_unlimited(mp_int n MTRACE_DECL)
 
     p->ref = 1;
     p->size = n;
+#ifdef USE_CYCLE_COLLECTOR
+    p->cc_root = 0;
+#endif
     if (current_object)
         (p->user = current_object->user)->size_array += n;
     else
@@ -272,6 +278,9 @@ _allocate_uninit_array (mp_int n MTRACE_DECL)
 
     p->ref = 1;
     p->size = n;
+#ifdef USE_CYCLE_COLLECTOR
+    p->cc_root = 0;
+#endif
     if (current_object)
         (p->user = current_object->user)->size_array += n;
     else
@@ -305,6 +314,11 @@ _free_vector (vector_t *p)
     num_arrays--;
     p->user->size_array -= i;
 
+#ifdef USE_CYCLE_COLLECTOR
+    if (p->cc_root)
+        cc_forget_root(p->cc_root);
+#endif
+
     svp = p->item;
     do {
         free_svalue(svp++);
@@ -327,6 +341,10 @@ free_empty_vector (vector_t *p)
     i = VEC_SIZE(p);
     p->user->size_array -= i;
     num_arrays--;
+#ifdef USE_CYCLE_COLLECTOR
+    if (p->cc_root)
+        cc_forget_root(p->cc_root);
+#endif
     xfree((char *)p);
 }
 
@@ -5,6 +5,7 @@
 #include <stddef.h>
 
 #include "typedefs.h"
+#include "cyclegc.h"
 #include "svalue.h"
 
 
@@ -23,6 +24,9 @@ struct vector_s {
     p_int extra_ref;   /* Second refcount, used to check .ref. */
 #endif
     wiz_list_t *user;  /* Save who made the vector */
+#ifdef USE_CYCLE_COLLECTOR
+    uint32_t cc_root;  /* Index+1 in the roots of the cycle collector, or 0 */
+#endif
     svalue_t item[1];
 };
 
@@ -38,7 +42,11 @@ struct vector_s {
 #endif
 
 
-#define VEC_HEAD(size) size, 1, VEC_DEBUGREF(1) NULL
+#ifdef USE_CYCLE_COLLECTOR
+#    define VEC_HEAD(size) size, 1, VEC_DEBUGREF(1) NULL, 0
+#else
+#    define VEC_HEAD(size) size, 1, VEC_DEBUGREF(1) NULL
+#endif
 
 #define VEC_SIZE(v) ((v)->size)
 
@@ -127,11 +135,16 @@ static INLINE vector_t* ref_array(vector_t *a) {
 
 /* void free_array(vector_t *a)
  *   Subtract one ref from array <a>, and free the array fully if
- *   the refcount reaches zero.
+ *   the refcount reaches zero. Otherwise <a> may have become cyclic
+ *   garbage and is handed to the cycle collector.
  */
 static INLINE void free_array(vector_t *a) {
     if (--(a->ref) <= 0) 
         _free_vector(a); 
+#ifdef USE_CYCLE_COLLECTOR
+    else if (cycle_collection && !a->cc_root)
+        cc_add_array(a);
+#endif
 }
 
 /* p_int deref_array(vector_t *a)
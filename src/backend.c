@@ -16,15 +16,28 @@
  * heartbeats are evaluated, but no longer until the time runs out. Any
  * heartbeat remaining will be evaluated in the next cycle. After the
  * heartbeat, the call_outs are evaluated. Callouts have no time limit,
- * but are bound by the eval_cost limit. Next, the object list is scanned
- * for objects in need of a reset, cleanup or swap. The driver will
- * (due objects given) perform at least one of each operation, but only
- * as many as it can before the time runs out. Last, player commands are
+ * but are bound by the eval_cost limit. Next, the objects in need of a
+ * reset, cleanup or swap are taken from the object queues (see below).
+ * The driver will (due objects given) perform at least one of each
+ * operation, but only as many as it can before the time runs out. Last, player commands are
  * retrieved with get_message(). The semantic is so that all players are
  * considered once before get_message() checks for a timeout. If a timeout
  * is detected, get_message() select()s, but returns immediately with the
  * variable time_to_call_heart_beat set, else it selects() in one second
  * intervals until either commands come in or the time runs out.
+ *
+ * The object queues are binary min-heaps of all listed objects, one each
+ * for resets, clean_up() calls, data cleanups and swapping, sorted by the
+ * time the object needs to be looked at next. The positions in the heaps
+ * are stored in the object's .queue_pos[] so that objects can be removed
+ * or rescheduled in O(log n).
+ *
+ * The reset queue is kept exact by calling update_reset_queue() whenever
+ * an object's .time_reset changes. The other queues depend on .time_of_ref,
+ * which changes far too often to update the queues each time. Since
+ * .time_of_ref only ever increases, these queues may hold an object with
+ * a due time earlier than the real one: when such an object comes up,
+ * it is just rescheduled with the new due time.
  *---------------------------------------------------------------------------
  */
 
@@ -51,6 +64,7 @@
 #include "call_out.h"
 #include "closure.h"
 #include "comm.h"
+#include "cyclegc.h"
 #include "ed.h"
 #include "exec.h"
 #include "filestat.h"
@@ -76,6 +90,7 @@
 #include "i-eval_cost.h"
 
 #include "../mudlib/sys/driver_hook.h"
+#include "../mudlib/sys/driver_info.h"
 #include "../mudlib/sys/debug_message.h"
 #include "../mudlib/sys/signals.h"
 
@@ -170,6 +185,33 @@ static sigset_t pending_signals;
 /* The pending signals which should be delivered to the mudlib master.
  */
 
+/* --- struct object_queue_s: One of the object queues.
+ */
+
+typedef struct object_queue_entry_s object_queue_entry_t;
+
+struct object_queue_entry_s
+{
+    mp_int     due;  /* Time when the object has to be looked at */
+    object_t * ob;   /* The object, not counted as reference */
+};
+
+typedef struct object_queue_s
+{
+    object_queue_entry_t * heap;  /* The min-heap, ordered by .due */
+    mp_int                 num;   /* Number of entries used */
+    mp_int                 size;  /* Number of entries allocated */
+} object_queue_t;
+
+static object_queue_t object_queues[NUM_OBJECT_QUEUES];
+  /* The queues of objects waiting for resets, clean_ups, data cleanups
+   * and swapping, indexed by OQ_*.
+   */
+
+#define OBJECT_QUEUE_MIN_SIZE 1024
+  /* Minimum number of entries allocated for an object queue.
+   */
+
 /*-------------------------------------------------------------------------*/
 
 /* --- Forward declarations --- */
@@ -606,6 +648,10 @@ backend (void)
         /* Replace programs, remove destructed objects, and similar stuff */
         cleanup_stuff();
 
+        /* Continue pending resizes of the string and object tables */
+        mstring_rehash_step();
+        otable_rehash_step();
+
 #ifdef DEBUG
         if (check_a_lot_ref_counts_flag)
             check_a_lot_ref_counts(NULL);
@@ -634,6 +680,22 @@ backend (void)
             }
         }
 
+        /* Continue an incremental garbage collection */
+        if (gc_slices_pending)
+        {
+            current_interactive = NULL;
+            command_giver = NULL;
+            current_object = NULL;
+            garbage_collection_slice();
+            malloc_privilege = MALLOC_USER;
+        }
+
+#ifdef USE_CYCLE_COLLECTOR
+        /* Look for garbage cycles among the values freed lately */
+        if (cycle_collection)
+            cycle_collection_step();
+#endif
+
         if (extra_jobs_to_do) {
 
             current_interactive = NULL;
@@ -682,7 +744,13 @@ backend (void)
                   notify_lowmemory_condition(gc_request == gcEfun ?
                                              NO_MALLOC_LIMIT_EXCEEDED : 
                                              HARD_MALLOC_LIMIT_EXCEEDED);
-                  garbage_collection();
+                  /* A shortage of memory can't wait for the slices of
+                   * an incremental GC.
+                   */
+                  if (gc_request == gcEfun)
+                      start_garbage_collection();
+                  else
+                      garbage_collection();
                 }
                 else
                 {
@@ -1005,6 +1073,321 @@ void check_alarm (void)
     alarm_called = MY_FALSE;
 } /* check_alarm() */
 
+/*-------------------------------------------------------------------------*/
+static mp_int
+object_due (int q, object_t *ob)
+
+/* Return the earliest time at which object <ob> might need to be handled
+ * by queue <q>, or 0 if the object doesn't belong into that queue.
+ * An object is due when the returned time is not in the future.
+ */
+
+{
+    mp_int due;
+
+    switch (q)
+    {
+    case OQ_RESET:
+        if (time_to_reset <= 0 || !ob->time_reset)
+            return 0;
+        due = ob->time_reset + 1;
+        break;
+
+    case OQ_CLEAN_UP:
+        if (time_to_cleanup <= 0 || !(ob->flags & O_WILL_CLEAN_UP))
+            return 0;
+        due = ob->time_of_ref + time_to_cleanup + 1;
+        break;
+
+    case OQ_DATA_CLEAN:
+        due = ob->time_cleanup + 1;
+        break;
+
+    case OQ_SWAP:
+        if (time_to_swap > 0
+         && (time_to_swap_variables <= 0 || time_to_swap < time_to_swap_variables))
+            due = ob->time_of_ref + time_to_swap;
+        else if (time_to_swap_variables > 0)
+            due = ob->time_of_ref + time_to_swap_variables;
+        else
+            return 0;
+        break;
+
+    default:
+        fatal("Unknown object queue %d.\n", q);
+        /* NOTREACHED */
+        return 0;
+    }
+
+    return due > 0 ? due : 1;
+} /* object_due() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE void
+object_queue_set (object_queue_t *oq, int q, mp_int ix, object_queue_entry_t entry)
+
+/* Store <entry> at position <ix> of queue <oq> (which is queue <q>).
+ */
+
+{
+    oq->heap[ix] = entry;
+    entry.ob->queue_pos[q] = (int32)(ix + 1);
+} /* object_queue_set() */
+
+/*-------------------------------------------------------------------------*/
+static void
+object_queue_sift (int q, mp_int ix)
+
+/* Move the entry at position <ix> of queue <q> up or down until
+ * the heap condition is restored.
+ */
+
+{
+    object_queue_t *oq = &object_queues[q];
+    object_queue_entry_t entry = oq->heap[ix];
+
+    /* Sift up */
+    while (ix > 0 && oq->heap[(ix - 1) / 2].due > entry.due)
+    {
+        object_queue_set(oq, q, ix, oq->heap[(ix - 1) / 2]);
+        ix = (ix - 1) / 2;
+    }
+
+    /* Sift down */
+    for (;;)
+    {
+        mp_int child = 2 * ix + 1;
+
+        if (child >= oq->num)
+            break;
+        if (child + 1 < oq->num && oq->heap[child+1].due < oq->heap[child].due)
+            child++;
+        if (oq->heap[child].due >= entry.due)
+            break;
+        object_queue_set(oq, q, ix, oq->heap[child]);
+        ix = child;
+    }
+
+    object_queue_set(oq, q, ix, entry);
+} /* object_queue_sift() */
+
+/*-------------------------------------------------------------------------*/
+static void
+object_queue_remove (int q, object_t *ob)
+
+/* Remove object <ob> from queue <q>, if it is in there.
+ */
+
+{
+    object_queue_t *oq = &object_queues[q];
+    mp_int ix = ob->queue_pos[q] - 1;
+
+    if (ix < 0)
+        return;
+
+    ob->queue_pos[q] = 0;
+    oq->num--;
+    if (ix < oq->num)
+    {
+        object_queue_set(oq, q, ix, oq->heap[oq->num]);
+        object_queue_sift(q, ix);
+    }
+} /* object_queue_remove() */
+
+/*-------------------------------------------------------------------------*/
+static void
+object_queue_schedule (int q, object_t *ob, mp_int due)
+
+/* Schedule object <ob> in queue <q> to be handled at time <due>.
+ * A <due> time of 0 removes the object from the queue.
+ */
+
+{
+    object_queue_t *oq = &object_queues[q];
+    object_queue_entry_t entry;
+    mp_int ix;
+
+    if (!due)
+    {
+        object_queue_remove(q, ob);
+        return;
+    }
+
+    entry.due = due;
+    entry.ob = ob;
+
+    ix = ob->queue_pos[q] - 1;
+    if (ix < 0)
+    {
+        if (oq->num >= oq->size)
+        {
+            mp_int new_size = oq->size ? 2 * oq->size : OBJECT_QUEUE_MIN_SIZE;
+            object_queue_entry_t *new_heap;
+
+            new_heap = prexalloc(oq->heap, new_size * sizeof(*oq->heap));
+            if (!new_heap)
+            {
+                /* The object will just not be processed by this queue. */
+                debug_message("%s Out of memory (%zu bytes) for object queue %d.\n"
+                             , time_stamp(), new_size * sizeof(*oq->heap), q);
+                return;
+            }
+            oq->heap = new_heap;
+            oq->size = new_size;
+        }
+        ix = oq->num++;
+    }
+
+    object_queue_set(oq, q, ix, entry);
+    object_queue_sift(q, ix);
+} /* object_queue_schedule() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE mp_int
+object_queue_due (int q, object_t *ob)
+
+/* Return the time object <ob> is scheduled for in queue <q>.
+ * The object must be in the queue.
+ */
+
+{
+    return object_queues[q].heap[ob->queue_pos[q] - 1].due;
+} /* object_queue_due() */
+
+/*-------------------------------------------------------------------------*/
+static object_t *
+object_queue_first_due (int q)
+
+/* Return the first object in queue <q> if it is due, or NULL.
+ */
+
+{
+    object_queue_t *oq = &object_queues[q];
+
+    if (oq->num && oq->heap[0].due <= current_time)
+        return oq->heap[0].ob;
+    return NULL;
+} /* object_queue_first_due() */
+
+/*-------------------------------------------------------------------------*/
+static void
+object_queue_reschedule (int q, object_t *ob, mp_int recheck)
+
+/* Object <ob> was just handled by queue <q>: schedule it for the next
+ * time it will be due. If it is still (or again) due now - because it
+ * couldn't be handled for reasons other than time - it will be looked
+ * at again in <recheck> seconds.
+ */
+
+{
+    mp_int due = object_due(q, ob);
+
+    if (due && due <= current_time)
+        due = current_time + recheck;
+    object_queue_schedule(q, ob, due);
+} /* object_queue_reschedule() */
+
+/*-------------------------------------------------------------------------*/
+void
+enter_object_queues (object_t *ob)
+
+/* Enter the newly listed object <ob> into the object queues.
+ */
+
+{
+    int q;
+
+    for (q = 0; q < NUM_OBJECT_QUEUES; q++)
+        object_queue_schedule(q, ob, object_due(q, ob));
+} /* enter_object_queues() */
+
+/*-------------------------------------------------------------------------*/
+void
+remove_object_queues (object_t *ob)
+
+/* Remove object <ob>, which is about to be unlisted, from all
+ * object queues.
+ */
+
+{
+    int q;
+
+    for (q = 0; q < NUM_OBJECT_QUEUES; q++)
+        object_queue_remove(q, ob);
+} /* remove_object_queues() */
+
+/*-------------------------------------------------------------------------*/
+void
+update_reset_queue (object_t *ob)
+
+/* The .time_reset of object <ob> changed: update its position in
+ * the reset queue.
+ */
+
+{
+    if (ob->flags & O_DESTRUCTED)
+        return;
+    object_queue_schedule(OQ_RESET, ob, object_due(OQ_RESET, ob));
+} /* update_reset_queue() */
+
+/*-------------------------------------------------------------------------*/
+void
+update_clean_up_queue (object_t *ob)
+
+/* The O_WILL_CLEAN_UP flag of object <ob> was set: update its position
+ * in the clean_up queue.
+ */
+
+{
+    if (ob->flags & O_DESTRUCTED)
+        return;
+    object_queue_schedule(OQ_CLEAN_UP, ob, object_due(OQ_CLEAN_UP, ob));
+} /* update_clean_up_queue() */
+
+/*-------------------------------------------------------------------------*/
+void
+object_queue_driver_info (svalue_t *svp, int value)
+
+/* Returns the object queue information for driver_info(<what>).
+ * <svp> points to the svalue for the result.
+ */
+
+{
+    switch (value)
+    {
+        case DI_NUM_OBJECTS_RESET_QUEUE:
+            put_number(svp, object_queues[OQ_RESET].num);
+            break;
+
+        case DI_NUM_OBJECTS_CLEAN_UP_QUEUE:
+            put_number(svp, object_queues[OQ_CLEAN_UP].num);
+            break;
+
+        case DI_NUM_OBJECTS_DATA_CLEAN_QUEUE:
+            put_number(svp, object_queues[OQ_DATA_CLEAN].num);
+            break;
+
+        case DI_NUM_OBJECTS_SWAP_QUEUE:
+            put_number(svp, object_queues[OQ_SWAP].num);
+            break;
+
+        case DI_SIZE_OBJECT_QUEUES:
+        {
+            p_int size = 0;
+            int q;
+
+            for (q = 0; q < NUM_OBJECT_QUEUES; q++)
+                size += object_queues[q].size * sizeof(*object_queues[q].heap);
+            put_number(svp, size);
+            break;
+        }
+
+        default:
+            fatal("Unknown option for object_queue_driver_info(): %d\n", value);
+            break;
+    }
+} /* object_queue_driver_info() */
+
 /*-------------------------------------------------------------------------*/
 static void
 process_objects (void)
@@ -1018,9 +1401,10 @@ process_objects (void)
  * before the current timeslot runs out (as registered by comm_time_to-
  * _call_heart_beat), but will do at least one cleanup/swap and reset.
  *
- * Objects are moved to the end of the list before they are processed,
- * so that a the next object to handle is always the first object
- * in the list. Even arbitrary object destruction doesn't change this.
+ * The objects to process are taken from the object queues, so only
+ * objects which are (or might be) due are looked at. Before an object
+ * is handled, it is rescheduled to the next second, so that an error
+ * during the handling won't cause it to be handled again in this cycle.
  *
  * The functions in detail:
  *
@@ -1040,6 +1424,8 @@ process_objects (void)
  *    are not swapped out right before the next reset which in that case
  *    would cause a swap in/swap out-yoyo. Instead, such variable swapping
  *    is delayed until after the reset occured.
+ *    Objects which can't be swapped for other reasons (heart beat, program
+ *    still referenced) are looked at again after the swap time.
  *
  *    To disable swapping, set the swapping times (either in config.h or per
  *    commandline option) to a value <= 0.
@@ -1047,9 +1433,6 @@ process_objects (void)
  * The function maintains its own error recovery info so that errors
  * in reset() or clean_up() won't mess up the handling.
  *
- * TODO: The objlist should be split into resets and cleanup/swaps, which
- * TODO:: are then sorted by due times. This would make this function
- * TODO:: much more efficient.
  * TODO: It might be a good idea to distinguish between the time_of_ref
  * TODO:: (when the object was last used/called) and the time_of_swap,
  * TODO:: when it was last swapped in or out. Then, maybe not.
@@ -1067,6 +1450,8 @@ static Bool did_swap;
 
     object_t *obj;               /* Current object worked on */
     long      limit_data_clean;  /* Max number of objects to dataclean */
+    mp_int    min_time_to_swap;  /* Variable swap exclusion time before reset */
+    mp_int    swap_recheck;      /* Delay to look again at unswappable objects */
 
     struct error_recovery_info error_recovery_info;
       /* Local error recovery info */
@@ -1108,253 +1493,269 @@ static Bool did_swap;
     if (limit_data_clean < num_newly_destructed)
         limit_data_clean = num_newly_destructed;
 
-    /* The processing loop, runs until either time or objects
-     * run short.
-     *
-     * To be safe against errors and destruction of objects,
-     * the object processed is moved immediately to the end
-     * of the object list, so that obj_list always points to
-     * the next object to process.
-     *
-     * The loop ends (apart from timeouts) when num_last_processed
-     * exceeds num_listed_objs.
+    /* Variables won't be swapped if a reset is due shortly.
+     * "shortly" means half the var swap interval, but at max 5 minutes.
+     */
+    min_time_to_swap = 5 * 60;
+    if (time_to_swap_variables / 2 < min_time_to_swap)
+        min_time_to_swap = time_to_swap_variables/2;
+
+    /* Objects which can't be swapped for other reasons than time are
+     * looked at again after the shorter of the swap times.
+     */
+    swap_recheck = time_to_swap;
+    if (swap_recheck <= 0
+     || (time_to_swap_variables > 0 && time_to_swap_variables < swap_recheck))
+        swap_recheck = time_to_swap_variables;
+    if (swap_recheck < 1)
+        swap_recheck = 1;
+
+    /* ------ Reset ------ */
+
+    /* Check if a reset() is due. Objects which have not been touched
+     * since the last reset just get a new due time set.
+     * It is tempting to skip the reset handling for objects which
+     * are swapped out, but then swapper would have to call reset_object()
+     * for due objects on swap-in (just setting a new due-time is not
+     * sufficient).
+     * TODO: Do exactly that?
      */
-    while (NULL != (obj = obj_list)
-        && (!did_reset || !did_swap || !comm_time_to_call_heart_beat)
-        && num_last_processed < num_listed_objs
-          )
+
+    while (NULL != (obj = object_queue_first_due(OQ_RESET)))
     {
         mp_int time_since_ref; /* Time since last reference */
-        mp_int min_time_to_swap; /* Variable swap exclusion time before reset */
-        Bool bResetCalled;  /* TRUE: reset() called */
 
         clear_state();
 
-        num_last_processed++;
-
-        /* Move obj to the end of the list */
-        if (obj != obj_list_end)
+        if (obj->flags & O_RESET_STATE)
         {
-            obj_list = obj->next_all;
-            obj_list->prev_all = NULL;
-            obj->next_all = NULL;
-            obj->prev_all = obj_list_end;
-            obj_list_end->next_all = obj;
-            obj_list_end = obj;
+#ifdef DEBUG
+            if (d_flag)
+                fprintf(stderr, "%s RESET (virtual) %s\n", time_stamp(), get_txt(obj->name));
+#endif
+            num_last_processed++;
+            obj->time_reset = current_time+time_to_reset/2
+                              +(mp_int)random_number((uint32)time_to_reset/2);
+            update_reset_queue(obj);
+            continue;
         }
 
-        /* Set Variables */
-        time_since_ref = current_time - obj->time_of_ref;
-        bResetCalled = MY_FALSE;
+        if (did_reset && comm_time_to_call_heart_beat)
+            break;
 
-        /* Variables won't be swapped if a reset is due shortly.
-         * "shortly" means half the var swap interval, but at max 5 minutes.
-         */
-        min_time_to_swap = 5 * 60;
-        if (time_to_swap_variables / 2 < min_time_to_swap)
-            min_time_to_swap = time_to_swap_variables/2;
-
-        /* ------ Reset ------ */
-
-        /* Check if a reset() is due. Objects which have not been touched
-         * since the last reset just get a new due time set.
-         * It is tempting to skip the reset handling for objects which
-         * are swapped out, but then swapper would have to call reset_object()
-         * for due objects on swap-in (just setting a new due-time is not
-         * sufficient).
-         * TODO: Do exactly that?
-         */
+        num_last_processed++;
+        object_queue_schedule(OQ_RESET, obj, current_time + 1);
 
-        if (time_to_reset > 0
-         && obj->time_reset
-         && obj->time_reset < current_time)
-        {
-            if (obj->flags & O_RESET_STATE)
-            {
-#ifdef DEBUG
-                if (d_flag)
-                    fprintf(stderr, "%s RESET (virtual) %s\n", time_stamp(), get_txt(obj->name));
-#endif
-                obj->time_reset = current_time+time_to_reset/2
-                                  +(mp_int)random_number((uint32)time_to_reset/2);
-            }
-            else if (!did_reset || !comm_time_to_call_heart_beat)
-            {
 #ifdef DEBUG
-                if (d_flag)
-                    fprintf(stderr, "%s RESET %s\n", time_stamp(), get_txt(obj->name));
+        if (d_flag)
+            fprintf(stderr, "%s RESET %s\n", time_stamp(), get_txt(obj->name));
 #endif
-                mark_start_evaluation();
-                if (obj->flags & O_SWAPPED
-                 && load_ob_from_swap(obj) < 0)
-                   continue;
-                bResetCalled = MY_TRUE;
-                did_reset = MY_TRUE;
-                RESET_LIMITS;
-                CLEAR_EVAL_COST;
-                command_giver = 0;
-                previous_ob = NULL;
-                trace_level = 0;
-                reset_object(obj, H_RESET);
-                mark_end_evaluation();
-                if (obj->flags & O_DESTRUCTED)
-                    continue;
-
-                if (time_to_swap > 0 || time_to_swap_variables > 0)
-                {
-                    /* Restore old time_of_ref. This might result in a quick
-                     * swap-in/swap-out yoyo if this object was swapped out
-                     * in the first place. To make this less costly, variables
-                     * are not swapped out short before a reset (see below).
-                     */
-                    obj->time_of_ref = current_time - time_since_ref;
-                }
-            } /* if (call reset or not) */
-        } /* if (needs reset?) */
-
+        time_since_ref = current_time - obj->time_of_ref;
+        mark_start_evaluation();
+        if (obj->flags & O_SWAPPED
+         && load_ob_from_swap(obj) < 0)
+        {
+            mark_end_evaluation();
+            continue;
+        }
+        did_reset = MY_TRUE;
+        RESET_LIMITS;
+        CLEAR_EVAL_COST;
+        command_giver = 0;
+        previous_ob = NULL;
+        trace_level = 0;
+        reset_object(obj, H_RESET);
+        mark_end_evaluation();
+        if (obj->flags & O_DESTRUCTED)
+            continue;
 
-        /* ------ Clean Up ------ */
+        if (time_to_swap > 0 || time_to_swap_variables > 0)
+        {
+            /* Restore old time_of_ref. This might result in a quick
+             * swap-in/swap-out yoyo if this object was swapped out
+             * in the first place. To make this less costly, variables
+             * are not swapped out short before a reset (see below).
+             */
+            obj->time_of_ref = current_time - time_since_ref;
+        }
 
-        /* If enough time has passed, give the object a chance to self-
-         * destruct. The O_RESET_STATE is saved over the call to clean_up().
-         *
-         * Only call clean_up in objects that have defined such a function.
-         * Only if the clean_up returns a non-zero value, it will be called
-         * again.
-         *
-         * The cleanup is not called if the object was actively reset
+        /* The clean_up is not called if the object was actively reset
          * just before.
          */
-        if (time_to_cleanup > 0
-          && obj->flags & O_WILL_CLEAN_UP
-          && time_since_ref > time_to_cleanup
-          && !bResetCalled
-          && (!did_swap || !comm_time_to_call_heart_beat))
+        if (obj->queue_pos[OQ_CLEAN_UP]
+         && object_queue_due(OQ_CLEAN_UP, obj) <= current_time)
+            object_queue_schedule(OQ_CLEAN_UP, obj, current_time + 1);
+    } /* while (resets due) */
+
+
+    /* ------ Clean Up ------ */
+
+    /* If enough time has passed, give the object a chance to self-
+     * destruct. The O_RESET_STATE is saved over the call to clean_up().
+     *
+     * Only call clean_up in objects that have defined such a function.
+     * Only if the clean_up returns a non-zero value, it will be called
+     * again.
+     */
+    while ((!did_swap || !comm_time_to_call_heart_beat)
+        && NULL != (obj = object_queue_first_due(OQ_CLEAN_UP)))
+    {
+        int save_reset_state;
+        svalue_t *svp;
+
+        clear_state();
+
+        num_last_processed++;
+
+        if (!(time_to_cleanup > 0
+           && obj->flags & O_WILL_CLEAN_UP
+           && current_time - obj->time_of_ref > time_to_cleanup))
         {
-            int save_reset_state = obj->flags & O_RESET_STATE;
-            svalue_t *svp;
+            /* Not due after all: the object was used in between. */
+            object_queue_reschedule(OQ_CLEAN_UP, obj, 1);
+            continue;
+        }
+
+        object_queue_schedule(OQ_CLEAN_UP, obj, current_time + 1);
+        save_reset_state = obj->flags & O_RESET_STATE;
 
 #ifdef DEBUG
-            if (d_flag)
-                fprintf(stderr, "%s CLEANUP %s\n", time_stamp(), get_txt(obj->name));
+        if (d_flag)
+            fprintf(stderr, "%s CLEANUP %s\n", time_stamp(), get_txt(obj->name));
 #endif
 
-            did_swap = MY_TRUE;
-
-            /* Remove all pending destructed objects, to get a true refcount.
-             * But make sure that we don't clobber anything else while
-             * doing so.
-             */
-            cleanup_stuff();
-            remove_destructed_objects(MY_FALSE);
+        did_swap = MY_TRUE;
 
-            /* Supply a flag to the object that says if this program
-             * is inherited by other objects. Cloned objects might as well
-             * believe they are not inherited. Swapped objects will not
-             * have a ref count > 1 (and will have an invalid ob->prog
-             * pointer). If the object is a blueprint, the extra reference
-             * from the program will not be counted.
-             */
-            if (obj->flags & (O_CLONE|O_REPLACED))
-                push_number(inter_sp, 0);
-            else if (O_PROG_SWAPPED(obj))
-                push_number(inter_sp, 1);
-            else if (obj->prog->blueprint == obj)
-                push_number(inter_sp, obj->prog->ref - 1);
-            else
-                push_number(inter_sp, obj->prog->ref);
+        /* Remove all pending destructed objects, to get a true refcount.
+         * But make sure that we don't clobber anything else while
+         * doing so.
+         */
+        cleanup_stuff();
+        remove_destructed_objects(MY_FALSE);
+
+        /* Supply a flag to the object that says if this program
+         * is inherited by other objects. Cloned objects might as well
+         * believe they are not inherited. Swapped objects will not
+         * have a ref count > 1 (and will have an invalid ob->prog
+         * pointer). If the object is a blueprint, the extra reference
+         * from the program will not be counted.
+         */
+        if (obj->flags & (O_CLONE|O_REPLACED))
+            push_number(inter_sp, 0);
+        else if (O_PROG_SWAPPED(obj))
+            push_number(inter_sp, 1);
+        else if (obj->prog->blueprint == obj)
+            push_number(inter_sp, obj->prog->ref - 1);
+        else
+            push_number(inter_sp, obj->prog->ref);
 
-            RESET_LIMITS;
-            CLEAR_EVAL_COST;
-            command_giver = NULL;
-            previous_ob = NULL;
-            trace_level = 0;
-            if (driver_hook[H_CLEAN_UP].type == T_CLOSURE)
-            {
-                lambda_t *l;
+        RESET_LIMITS;
+        CLEAR_EVAL_COST;
+        command_giver = NULL;
+        previous_ob = NULL;
+        trace_level = 0;
+        if (driver_hook[H_CLEAN_UP].type == T_CLOSURE)
+        {
+            lambda_t *l;
 
-                mark_start_evaluation();
-                l = driver_hook[H_CLEAN_UP].u.lambda;
-                if (driver_hook[H_CLEAN_UP].x.closure_type == CLOSURE_LAMBDA)
-                {
-                    free_object(l->ob, "clean_up");
-                    l->ob = ref_object(obj, "clean_up");
-                }
-                push_ref_object(inter_sp, obj, "clean up");
-                call_lambda(&driver_hook[H_CLEAN_UP], 2);
-                svp = inter_sp;
-                pop_stack();
-                mark_end_evaluation();
-            }
-            else if (driver_hook[H_CLEAN_UP].type == T_STRING)
-            {
-                mark_start_evaluation();
-                svp = apply(driver_hook[H_CLEAN_UP].u.str, obj, 1);
-                mark_end_evaluation();
-            }
-            else
-            {
-                pop_stack();
-                goto no_clean_up;
-            }
-            if (obj->flags & O_DESTRUCTED)
+            mark_start_evaluation();
+            l = driver_hook[H_CLEAN_UP].u.lambda;
+            if (driver_hook[H_CLEAN_UP].x.closure_type == CLOSURE_LAMBDA)
             {
-                continue;
+                free_object(l->ob, "clean_up");
+                l->ob = ref_object(obj, "clean_up");
             }
+            push_ref_object(inter_sp, obj, "clean up");
+            call_lambda(&driver_hook[H_CLEAN_UP], 2);
+            svp = inter_sp;
+            pop_stack();
+            mark_end_evaluation();
+        }
+        else if (driver_hook[H_CLEAN_UP].type == T_STRING)
+        {
+            mark_start_evaluation();
+            svp = apply(driver_hook[H_CLEAN_UP].u.str, obj, 1);
+            mark_end_evaluation();
+        }
+        else
+        {
+            pop_stack();
+            goto no_clean_up;
+        }
+        if (obj->flags & O_DESTRUCTED)
+        {
+            continue;
+        }
 
-            if (!svp
-             || (svp->type == T_NUMBER && svp->u.number == 0)
-               )
-                obj->flags &= ~O_WILL_CLEAN_UP;
-            obj->flags |= save_reset_state;
+        if (!svp
+         || (svp->type == T_NUMBER && svp->u.number == 0)
+           )
+            obj->flags &= ~O_WILL_CLEAN_UP;
+        obj->flags |= save_reset_state;
 
 no_clean_up:
-            obj->time_of_ref = current_time;
-                  /* in case the hook didn't update it */
-        }
+        obj->time_of_ref = current_time;
+              /* in case the hook didn't update it */
+        object_queue_reschedule(OQ_CLEAN_UP, obj, 1);
+    } /* while (clean_ups due) */
 
 
-        /* ------ Data Cleanup ------ */
+    /* ------ Data Cleanup ------ */
+
+    /* Objects are processed at intervals determined by their
+     * time to clean up.
+     */
+    while ((num_last_data_cleaned == 0 || !comm_time_to_call_heart_beat)
+        && num_last_data_cleaned < limit_data_clean
+        && NULL != (obj = object_queue_first_due(OQ_DATA_CLEAN)))
+    {
+        clear_state();
+
+        num_last_processed++;
+        object_queue_schedule(OQ_DATA_CLEAN, obj, current_time + 1);
 
-        /* Objects are processed at intervals determined by their
-         * time to clean up.
-         */
-        if ( (num_last_data_cleaned == 0 || !comm_time_to_call_heart_beat)
-            && ((unsigned long)obj->time_cleanup < (unsigned long)current_time)
-            && (num_last_data_cleaned < limit_data_clean)
-           )
-        {
 #ifdef DEBUG
-            if (d_flag)
-                fprintf(stderr, "%s DATA CLEANUP %s\n"
-                              , time_stamp(), get_txt(obj->name));
+        if (d_flag)
+            fprintf(stderr, "%s DATA CLEANUP %s\n"
+                          , time_stamp(), get_txt(obj->name));
 #endif
 
-            cleanup_object(obj);
-            num_last_data_cleaned++;
-        }
+        cleanup_object(obj);
+        num_last_data_cleaned++;
 
+        if (!(obj->flags & O_DESTRUCTED))
+            object_queue_reschedule(OQ_DATA_CLEAN, obj, 1);
+    } /* while (data cleanups due) */
 
-        /* ------ Swapping ------ */
-
-        /* At last, there is a possibility that the object can be swapped
-         * out.
-         *
-         * Variables are swapped after time_to_swap_variables has elapsed
-         * since the last ref, and if the object is either still reset or
-         * the next reset is at least min(5 minutes, time_to_swap_variables/2)
-         * in the future. When a reset is due, this second condition delays the
-         * costly variable swapping until after the reset.
-         *
-         * Programs are swapped after time_to_swap has elapsed, and if
-         * they have only one reference, ie are not cloned or inherited.
-         * Since program swapping is relatively cheap, no care is
-         * taken of resets.
-         */
 
-        if ( (time_to_swap > 0 || time_to_swap_variables > 0)
-         && !(obj->flags & O_HEART_BEAT)
-         && (!did_swap || !comm_time_to_call_heart_beat))
+    /* ------ Swapping ------ */
+
+    /* At last, there is a possibility that the object can be swapped
+     * out.
+     *
+     * Variables are swapped after time_to_swap_variables has elapsed
+     * since the last ref, and if the object is either still reset or
+     * the next reset is at least min(5 minutes, time_to_swap_variables/2)
+     * in the future. When a reset is due, this second condition delays the
+     * costly variable swapping until after the reset.
+     *
+     * Programs are swapped after time_to_swap has elapsed, and if
+     * they have only one reference, ie are not cloned or inherited.
+     * Since program swapping is relatively cheap, no care is
+     * taken of resets.
+     */
+
+    while ((!did_swap || !comm_time_to_call_heart_beat)
+        && NULL != (obj = object_queue_first_due(OQ_SWAP)))
+    {
+        mp_int time_since_ref; /* Time since last reference */
+
+        clear_state();
+
+        num_last_processed++;
+        time_since_ref = current_time - obj->time_of_ref;
+
+        if (!(obj->flags & O_HEART_BEAT))
         {
             /* Swap the variables, if possible */
             if (!O_VAR_SWAPPED(obj)
@@ -1390,13 +1791,15 @@ no_clean_up:
             }
         } /* if (obj can be swapped) */
 
-    } /* End of loop */
+        object_queue_reschedule(OQ_SWAP, obj, swap_recheck);
+    } /* while (swaps due) */
 
     /* Update the processing averages
      */
     update_statistic(&stat_last_processed, num_last_processed);
     update_statistic(&stat_last_data_cleaned, num_last_data_cleaned);
     update_statistic(&stat_in_list, num_listed_objs);
+    mapping_compaction_cycle();
 
     /* Restore the error recovery context */
     rt_context = error_recovery_info.rt.last;
@@ -50,6 +50,11 @@ extern void check_alarm (void);
 extern void install_signal_handlers();
 extern void backend (void);
 extern void preload_objects (int eflag);
+extern void enter_object_queues (object_t *ob) __attribute__((nonnull(1)));
+extern void remove_object_queues (object_t *ob) __attribute__((nonnull(1)));
+extern void update_reset_queue (object_t *ob) __attribute__((nonnull(1)));
+extern void update_clean_up_queue (object_t *ob) __attribute__((nonnull(1)));
+extern void object_queue_driver_info (svalue_t *svp, int value) __attribute__((nonnull(1)));
 extern svalue_t *f_debug_message (svalue_t *sp);
 ALARM_HANDLER_PROT(catch_alarm);
 extern void update_statistic (statistic_t * pStat, long number);
@@ -10,10 +10,23 @@
  * callouts), the callouts of one user can use only MAX_EVAL_COST at
  * one time altogether.
  *
- * Pending call outs are held in a list, sorted in ascending order of
- * remaining delaytime. The actual delay values stored are deltas: the
- * delay this callout is to be scheduled after its predecessor in
- * the list.
+ * Pending call outs are held in a binary min-heap, ordered by their
+ * due time and, for callouts due at the same time, by the order in which
+ * they were created (so callouts with the same delay are executed FIFO).
+ * Every callout remembers its position in the heap, which allows to
+ * remove arbitrary callouts in O(log n).
+ *
+ * Due times are measured on the 'callout clock', which is advanced by
+ * next_call_out_cycle() by the time passed since the last backend cycle.
+ * A delay of n seconds thus means: n seconds counted from the backend
+ * cycle in which the callout was created.
+ *
+ * Additionally the callouts are indexed by the object they belong to
+ * (the object to be called, resp. the object a closure is bound to) in
+ * the owner_table[] hash, so that find_call_out(), remove_call_out() and
+ * the cleanup after an object's destruction only have to look at the
+ * callouts of that object. The table has always as many buckets as the
+ * heap has entries, and is rehashed whenever the heap is resized.
  *
  * TODO: It would be nice if the callout would store from where the
  * TODO:: callout originated and fake a control-stack entry for a proper
@@ -56,19 +69,46 @@
    */
 
 struct call {
-    struct call *next;   /* link to next structure */
-    /* TODO: p_int or mp_int */ int delta;           /* Delay in relation to the previous structure */
+    mp_int      due;          /* Time of the call on the callout clock */
+    p_uint      seq;          /* Creation number, for FIFO ordering */
+    mp_int      heap_index;   /* Index of this structure in call_heap[] */
+    struct call *owner_next;  /* Next/previous callout in the same */
+    struct call *owner_prev;  /*   owner_table[] chain             */
     callback_t fun;
     object_t *command_giver;  /* the saved command_giver */
 };
 
+#define CALL_HEAP_MIN_SIZE 256
+  /* Minimum number of entries allocated for the callout heap.
+   */
+
+static struct call **call_heap = NULL;
+  /* The pending call_outs as a min-heap ordered by (due, seq):
+   * the children of call_heap[i] are call_heap[2*i+1] and call_heap[2*i+2].
+   */
+
+static mp_int call_heap_size = 0;
+  /* Number of entries allocated for call_heap[], which is also the
+   * number of buckets in owner_table[] (and always a power of 2).
+   */
 
-static struct call *call_list = NULL;
-  /* The list of pending call_outs, sorted in ascending order of delay.
+static struct call **owner_table = NULL;
+  /* The hash table of callouts by their owning object, each bucket
+   * holding a doubly linked list of callouts.
    */
 
 static long num_callouts = 0;
-  /* Number of active callouts.
+  /* Number of active callouts, which is also the number of used
+   * entries in call_heap[].
+   */
+
+static mp_int call_out_clock = 0;
+  /* The callout clock: the number of seconds passed since the first
+   * backend cycle.
+   */
+
+static p_uint call_out_seq = 0;
+  /* The creation number for the next callout.
    */
 
 /*-------------------------------------------------------------------------*/
@@ -88,40 +128,285 @@ free_call (struct call *cop)
     pfree(cop);
 } /* free_call() */
 
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+call_before (struct call *a, struct call *b)
+
+/* Return TRUE if callout <a> is to be executed before callout <b>.
+ */
+
+{
+    if (a->due != b->due)
+        return a->due < b->due;
+    return (mp_int)(a->seq - b->seq) < 0;
+      /* Comparing the difference keeps the order intact when
+       * the creation counter wraps around.
+       */
+} /* call_before() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE void
+heap_set (mp_int ix, struct call *cop)
+
+/* Store <cop> at position <ix> in the heap.
+ */
+
+{
+    call_heap[ix] = cop;
+    cop->heap_index = ix;
+} /* heap_set() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE object_t *
+call_owner (struct call *cop)
+
+/* Return the object <cop> belongs to, destructed or not. This is the
+ * object callback_object() would check.
+ */
+
+{
+    if (cop->fun.is_lambda)
+        return !CLOSURE_MALLOCED(cop->fun.function.lambda.x.closure_type)
+               ? cop->fun.function.lambda.u.ob
+               : cop->fun.function.lambda.u.lambda->ob;
+    return cop->fun.function.named.ob;
+} /* call_owner() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE mp_int
+owner_hash (object_t *ob)
+
+/* Return the owner_table[] index for object <ob>.
+ */
+
+{
+    p_uint h = (p_uint)ob;
+
+    h ^= h >> 12;
+    return (mp_int)((h >> 4) & (p_uint)(call_heap_size - 1));
+} /* owner_hash() */
+
+/*-------------------------------------------------------------------------*/
+static void
+owner_link (struct call *cop)
+
+/* Link <cop> into its owner_table[] chain.
+ */
+
+{
+    struct call **chain = &owner_table[owner_hash(call_owner(cop))];
+
+    cop->owner_prev = NULL;
+    cop->owner_next = *chain;
+    if (*chain)
+        (*chain)->owner_prev = cop;
+    *chain = cop;
+} /* owner_link() */
+
+/*-------------------------------------------------------------------------*/
+static void
+owner_unlink (struct call *cop)
+
+/* Remove <cop> from its owner_table[] chain.
+ */
+
+{
+    if (cop->owner_next)
+        cop->owner_next->owner_prev = cop->owner_prev;
+    if (cop->owner_prev)
+        cop->owner_prev->owner_next = cop->owner_next;
+    else
+        owner_table[owner_hash(call_owner(cop))] = cop->owner_next;
+} /* owner_unlink() */
+
+/*-------------------------------------------------------------------------*/
+static void
+heap_sift_up (mp_int ix)
+
+/* Move the heap entry at <ix> up towards the root until the heap
+ * condition is restored.
+ */
+
+{
+    struct call *cop = call_heap[ix];
+
+    while (ix > 0)
+    {
+        mp_int parent = (ix - 1) / 2;
+
+        if (!call_before(cop, call_heap[parent]))
+            break;
+        heap_set(ix, call_heap[parent]);
+        ix = parent;
+    }
+    heap_set(ix, cop);
+} /* heap_sift_up() */
+
+/*-------------------------------------------------------------------------*/
+static void
+heap_sift_down (mp_int ix)
+
+/* Move the heap entry at <ix> down towards the leaves until the heap
+ * condition is restored.
+ */
+
+{
+    struct call *cop = call_heap[ix];
+
+    for (;;)
+    {
+        mp_int child = 2 * ix + 1;
+
+        if (child >= num_callouts)
+            break;
+        if (child + 1 < num_callouts
+         && call_before(call_heap[child+1], call_heap[child]))
+            child++;
+        if (!call_before(call_heap[child], cop))
+            break;
+        heap_set(ix, call_heap[child]);
+        ix = child;
+    }
+    heap_set(ix, cop);
+} /* heap_sift_down() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+resize_call_heap (mp_int new_size)
+
+/* Reallocate the callout heap and the owner table to hold <new_size>
+ * entries, and rehash the owner table.
+ * Return FALSE if memory ran out, leaving the old structures intact.
+ */
+
+{
+    struct call **new_heap, **new_table;
+    mp_int ix;
+
+    new_table = pxalloc(new_size * sizeof(*owner_table));
+    if (!new_table)
+        return MY_FALSE;
+
+    new_heap = prexalloc(call_heap, new_size * sizeof(*call_heap));
+    if (!new_heap)
+    {
+        pfree(new_table);
+        return MY_FALSE;
+    }
+
+    pfree(owner_table);
+    owner_table = new_table;
+    call_heap = new_heap;
+    call_heap_size = new_size;
+
+    memset(owner_table, 0, new_size * sizeof(*owner_table));
+    for (ix = 0; ix < num_callouts; ix++)
+        owner_link(call_heap[ix]);
+
+    return MY_TRUE;
+} /* resize_call_heap() */
+
 /*-------------------------------------------------------------------------*/
 static void
 insert_call (struct call *cop, int delay)
   
-/* Inser the call_out structure <cop> with the <delay> into the callout
- * list.
+/* Insert the call_out structure <cop> with the <delay> into the callout
+ * heap. The caller has to make sure that the heap has room for one
+ * more entry.
  */
 
 {
-    struct call   **copp;   /* Auxiliary pointers for list insertion */
-    struct call    *cop2;
-
+    cop->due = call_out_clock + delay;
+    cop->seq = call_out_seq++;
+    heap_set(num_callouts, cop);
     num_callouts++;
-    for (copp = &call_list; NULL != (cop2 = *copp); copp = &cop2->next)
+    heap_sift_up(cop->heap_index);
+    owner_link(cop);
+} /* insert_call() */
+
+/*-------------------------------------------------------------------------*/
+static void
+remove_call (struct call *cop)
+
+/* Remove the call_out structure <cop> from the callout heap and
+ * the owner table. The structure itself is not deallocated.
+ */
+
+{
+    mp_int ix = cop->heap_index;
+    struct call *last;
+
+    owner_unlink(cop);
+
+    num_callouts--;
+    last = call_heap[num_callouts];
+    if (last != cop)
     {
-        int delta;
-        /* Insert the call_out *after* calls with the same delay (FIFO). */
-        if ((delta = cop2->delta) > delay)
-        {
-            cop2->delta -= delay;
-            cop->delta = delay;
-            cop->next = *copp;
-            *copp = cop;
-            return;
-        }
-        delay -= (delta >= 0 ? delta : 0);
-          /* Especially when called from within a call_out, delta may be
-           * negative.
-           */
+        heap_set(ix, last);
+        if (ix > 0 && call_before(last, call_heap[(ix - 1) / 2]))
+            heap_sift_up(ix);
+        else
+            heap_sift_down(ix);
     }
-    *copp = cop;
-    cop->delta = delay;
-    cop->next = NULL;
-} /* insert_call() */
+
+    /* Give memory back after a spike in callout usage. */
+    if (call_heap_size > CALL_HEAP_MIN_SIZE
+     && num_callouts < call_heap_size / 4)
+    {
+        (void)resize_call_heap(call_heap_size / 2);
+    }
+} /* remove_call() */
+
+/*-------------------------------------------------------------------------*/
+static void
+rebuild_call_heap (void)
+
+/* Restore the heap condition for all entries in call_heap[].
+ */
+
+{
+    mp_int ix;
+
+    for (ix = 0; ix < num_callouts; ix++)
+        call_heap[ix]->heap_index = ix;
+    for (ix = num_callouts / 2 - 1; ix >= 0; ix--)
+        heap_sift_down(ix);
+} /* rebuild_call_heap() */
+
+/*-------------------------------------------------------------------------*/
+static int
+compare_calls (const void *a, const void *b)
+
+/* qsort() comparison function to sort callouts by execution order.
+ */
+
+{
+    struct call *ca = *(struct call * const *)a;
+    struct call *cb = *(struct call * const *)b;
+
+    if (call_before(ca, cb))
+        return -1;
+    if (call_before(cb, ca))
+        return 1;
+    return 0;
+} /* compare_calls() */
+
+/*-------------------------------------------------------------------------*/
+static void
+sort_call_heap (void)
+
+/* Sort call_heap[] in execution order. A sorted array still satisfies
+ * the heap condition, so this can be used to iterate over the callouts
+ * in order without any further allocation.
+ */
+
+{
+    mp_int ix;
+
+    qsort(call_heap, (size_t)num_callouts, sizeof(*call_heap), compare_calls);
+    for (ix = 0; ix < num_callouts; ix++)
+        call_heap[ix]->heap_index = ix;
+} /* sort_call_heap() */
 
 /*-------------------------------------------------------------------------*/
 svalue_t *
@@ -164,6 +449,21 @@ v_call_out (svalue_t *sp, int num_arg)
         /* NOTREACHED */
     }
 
+    /* Make sure that there is room in the heap for the new callout. */
+    if (num_callouts >= call_heap_size)
+    {
+        mp_int new_size = call_heap_size ? 2 * call_heap_size
+                                         : CALL_HEAP_MIN_SIZE;
+
+        if (!resize_call_heap(new_size))
+        {
+            errorf("Out of memory (%zu bytes) for callout heap.\n"
+                  , (size_t)new_size * (sizeof(*call_heap) + sizeof(*owner_table)));
+            /* NOTREACHED */
+            return sp;
+        }
+    }
+
     /* Get a new call structure.
      * Note: it is not useful to pool these allocations, as muds tend
      * to have spikes of high callout usage, but a low longterm average
@@ -210,7 +510,7 @@ v_call_out (svalue_t *sp, int num_arg)
     if (delay < 0)
         delay = 0;
 
-    /* Insert the new structure at its proper place in the list */
+    /* Insert the new structure at its proper place in the heap */
 
     insert_call(cop, delay);
 
@@ -222,29 +522,19 @@ v_call_out (svalue_t *sp, int num_arg)
 void
 next_call_out_cycle (void)
 
-/* Starts the next call_out cycle by decrementing the first delta.
+/* Starts the next call_out cycle by advancing the callout clock.
  * This function is called in the backend cycle before heart_beats are handled.
  */
 
 {
-    static int last_time;
+    static mp_int last_time;
       /* Last time this function was called */
 
-    /* No calls pending: just update the last_time and return */
-
-    if (call_list == NULL)
-    {
-        last_time = current_time;
-        return;
-    }
-
     /* If not set yet, initialize last_time on the first call */
     if (last_time == 0)
         last_time = current_time;
 
-    /* Update the first .delta in the list.
-     */
-    call_list->delta -= current_time - last_time;
+    call_out_clock += current_time - last_time;
 
     last_time = current_time;
 } /* next_call_out_cycle() */
@@ -271,7 +561,7 @@ call_out (void)
 
     /* No calls pending: fine. */
 
-    if (call_list == NULL)
+    if (num_callouts == 0)
         return;
 
     current_interactive = NULL;
@@ -310,30 +600,20 @@ call_out (void)
 
     tracedepth = 0;
 
-    /* Loop over the call list until it is empty or until all
+    /* Loop over the call heap until it is empty or until all
      * due callouts are processed.
      */
-    while (call_list && call_list->delta <= 0)
+    while (num_callouts && call_heap[0]->due <= call_out_clock)
     {
         object_t    *ob;
         struct call *cop;
         wiz_list_t  *user;
 
-        /* Move the first callout out of the chain.
+        /* Move the first callout out of the heap.
          */
-        cop = call_list;
-        call_list = cop->next;
+        cop = call_heap[0];
+        remove_call(cop);
         current_call_out = cop;
-        num_callouts--;
-
-        /* A special case:
-         * If a lot of time has passed, so that current call out was missed,
-         * then it will have a negative delta. This negative delta implies
-         * that the next call out in the list has to be adjusted.
-         */
-        if (cop->delta < 0 && call_list)
-            call_list->delta += cop->delta;
-
 
         /* Get the object for the function call and make sure it's valid */
 
@@ -464,88 +744,124 @@ find_call_out (object_t *ob, svalue_t *fun, Bool do_free_call)
  */
 
 {
-    struct call **copp, *cop;
-    int delay = 0;
+    struct call *cop, *found;
+    mp_int ix;
+    mp_int delay;
     string_t *fun_name;
 
+    found = NULL;
+
     /* Find callout by closure */
 
     if (fun->type != T_STRING)
     {
-        if (fun->type == T_CLOSURE)
+        if (fun->type != T_CLOSURE)
+        {
+            fatal("find_call_out() got %s, expected string/closure.\n"
+                 , typename(fun->type));
+            /* NOTREACHED */
+        }
+
+        if (CLOSURE_MALLOCED(fun->x.closure_type))
         {
-            for (copp = &call_list; NULL != (cop = *copp); copp = &cop->next)
+            /* Equal closures are bound to the same object, so only
+             * the callouts of that object need to be checked.
+             */
+            object_t *owner = fun->u.lambda->ob;
+
+            for ( cop = owner_table ? owner_table[owner_hash(owner)] : NULL
+                ; cop != NULL
+                ; cop = cop->owner_next)
             {
-                delay += cop->delta;
                 if (cop->fun.is_lambda
+                 && call_owner(cop) == owner
                  && closure_eq(&(cop->fun.function.lambda), fun)
+                 && (!found || call_before(cop, found))
                    )
                 {
-                    goto found;
+                    found = cop;
                 }
             }
-
-            /* Not found */
-            free_svalue(fun);
-            put_number(fun, -1);
-            return;
-found:
-            free_svalue(fun);
-            if (do_free_call)
+        }
+        else
+        {
+            /* Efun, simul-efun and operator closures compare equal
+             * regardless of the object they are bound to.
+             */
+            for (ix = 0; ix < num_callouts; ix++)
             {
-                if (cop->next)
-                    cop->next->delta += cop->delta;
-                *copp = cop->next;
-                free_call(cop);
-                num_callouts--;
+                cop = call_heap[ix];
+                if (cop->fun.is_lambda
+                 && closure_eq(&(cop->fun.function.lambda), fun)
+                 && (!found || call_before(cop, found))
+                   )
+                {
+                    found = cop;
+                }
             }
-            /* It is possible to have delay < 0 if we are
-             * called from inside call_out() .
-             */
-            if (delay < 0)
-                delay = 0;
-            put_number(fun, delay);
-            return;
         }
-        fatal("find_call_out() got %s, expected string/closure.\n"
-             , typename(fun->type));
-        /* NOTREACHED */
     }
+    else
+    {
+        /* Find callout by object/name */
 
+        fun_name = find_tabled(fun->u.str);
 
-    /* Find callout by object/name */
-
-    fun_name = find_tabled(fun->u.str);
-
-    if (fun_name != NULL)
-    for (copp = &call_list; NULL != (cop = *copp); copp = &cop->next)
-    {
-        delay += cop->delta;
-        if (cop->fun.function.named.ob == ob
-         && cop->fun.function.named.name == fun_name
-         && !cop->fun.is_lambda)
+        if (fun_name != NULL && owner_table != NULL)
         {
-            if (do_free_call)
+            for ( cop = owner_table[owner_hash(ob)]
+                ; cop != NULL
+                ; cop = cop->owner_next)
             {
-                if (cop->next)
-                    cop->next->delta += cop->delta;
-                *copp = cop->next;
-                free_call(cop);
-                num_callouts--;
+                if (!cop->fun.is_lambda
+                 && cop->fun.function.named.ob == ob
+                 && cop->fun.function.named.name == fun_name
+                 && (!found || call_before(cop, found))
+                   )
+                {
+                    found = cop;
+                }
             }
-            if (delay < 0)
-                delay = 0;
-            free_svalue(fun);
-            put_number(fun, delay);
-            return;
         }
-    } /* if()for() */
+    }
 
-    /* Not found */
     free_svalue(fun);
-    put_number(fun, -1);
+
+    if (!found)
+    {
+        /* Not found */
+        put_number(fun, -1);
+        return;
+    }
+
+    /* It is possible to have delay < 0 if we are
+     * called from inside call_out() .
+     */
+    delay = found->due - call_out_clock;
+    if (delay < 0)
+        delay = 0;
+
+    if (do_free_call)
+    {
+        remove_call(found);
+        free_call(found);
+    }
+
+    put_number(fun, delay);
 } /* find_call_out() */
 
+/*-------------------------------------------------------------------------*/
+static size_t
+call_out_size (void)
+
+/* Return the amount of memory used by callouts.
+ */
+
+{
+    return num_callouts * sizeof (struct call)
+         + call_heap_size * (sizeof(*call_heap) + sizeof(*owner_table));
+} /* call_out_size() */
+
 /*-------------------------------------------------------------------------*/
 size_t
 call_out_status (strbuf_t *sbuf, Bool verbose)
@@ -560,16 +876,16 @@ call_out_status (strbuf_t *sbuf, Bool verbose)
     {
         strbuf_add(sbuf, "\nCall out information:\n");
         strbuf_add(sbuf,"---------------------\n");
-        strbuf_addf(sbuf, "Number of call outs: %8ld, %8ld bytes\n",
-                    num_callouts, num_callouts * sizeof (struct call));
+        strbuf_addf(sbuf, "Number of call outs: %8ld, %8zu bytes\n",
+                    num_callouts, call_out_size());
     }
     else
     {
-        strbuf_addf(sbuf, "call out:\t\t\t%8ld %9ld\n"
-                   , num_callouts, num_callouts * sizeof (struct call));
+        strbuf_addf(sbuf, "call out:\t\t\t%8ld %9zu\n"
+                   , num_callouts, call_out_size());
     }
 
-    return num_callouts * sizeof (struct call);
+    return call_out_size();
 } /* call_out_status() */
 
 /*-------------------------------------------------------------------------*/
@@ -588,7 +904,7 @@ callout_driver_info (svalue_t *svp, int value)
             break;
 
         case DI_SIZE_CALLOUTS:
-            put_number(svp, num_callouts * sizeof(struct call));
+            put_number(svp, call_out_size());
             break;
 
         default:
@@ -608,10 +924,12 @@ count_extra_ref_from_call_outs (void)
  */
 
 {
-    struct call *cop;
+    mp_int ix;
 
-    for (cop = call_list; cop; cop = cop->next)
+    for (ix = 0; ix < num_callouts; ix++)
     {
+        struct call *cop = call_heap[ix];
+
         count_callback_extra_refs(&(cop->fun));
         if (cop->command_giver)
             count_extra_ref_in_object(cop->command_giver);
@@ -629,26 +947,62 @@ remove_stale_call_outs (void)
  */
 
 {
-    struct call **copp, *cop;
+    mp_int ix, kept;
 
-    for (copp = &call_list; NULL != (cop = *copp); )
+    /* Compact the heap array, then restore the heap condition. */
+    for (ix = kept = 0; ix < num_callouts; ix++)
     {
-        object_t *ob;
+        struct call *cop = call_heap[ix];
 
-        ob = callback_object(&(cop->fun));
-        if (!ob)
+        if (!callback_object(&(cop->fun)))
         {
-            num_callouts--;
-            if (cop->next)
-                cop->next->delta += cop->delta;
-            *copp = cop->next;
+            owner_unlink(cop);
             free_call(cop);
-            continue;
         }
-        copp = &cop->next;
+        else
+            call_heap[kept++] = cop;
+    }
+
+    if (kept != num_callouts)
+    {
+        num_callouts = kept;
+        rebuild_call_heap();
     }
 } /* remove_stale_call_outs() */
 
+/*-------------------------------------------------------------------------*/
+void
+remove_object_call_outs (object_t *ob)
+
+/* Remove all callouts belonging to the destructed object <ob>.
+ * This is called when the destruction of <ob> is completed, so that
+ * its callouts don't keep it and their arguments around until they
+ * are due.
+ */
+
+{
+    struct call *cop;
+
+    if (!owner_table)
+        return;
+
+    do {
+        /* remove_call() may rehash the table, so restart the search
+         * from the bucket head after each removal.
+         */
+        for ( cop = owner_table[owner_hash(ob)]
+            ; cop != NULL && call_owner(cop) != ob
+            ; cop = cop->owner_next)
+            NOOP;
+
+        if (cop)
+        {
+            remove_call(cop);
+            free_call(cop);
+        }
+    } while (cop);
+} /* remove_object_call_outs() */
+
 
 #ifdef GC_SUPPORT
 
@@ -660,10 +1014,11 @@ clear_ref_from_call_outs (void)
  */
 
 {
-    struct call *cop;
+    mp_int ix;
 
-    for (cop = call_list; cop; cop = cop->next)
+    for (ix = 0; ix < num_callouts; ix++)
     {
+        struct call *cop = call_heap[ix];
         object_t *ob;
 
         clear_ref_in_callback(&(cop->fun));
@@ -681,11 +1036,13 @@ count_ref_from_call_outs (void)
  */
 
 {
-    struct call *cop;
+    mp_int ix;
     object_t *ob;
 
-    for (cop = call_list; cop; cop = cop->next)
+    for (ix = 0; ix < num_callouts; ix++)
     {
+        struct call *cop = call_heap[ix];
+
         count_ref_in_callback(&(cop->fun));
 
         if ( NULL != (ob = cop->command_giver) )
@@ -715,16 +1072,20 @@ get_all_call_outs (void)
  *  3..: The argument(s).
  */
 {
-    int i, next_time;
-    struct call *cop;
+    mp_int ix;
+    int i;
     vector_t *v;
 
+    /* Bring the callouts into execution order.
+     */
+    sort_call_heap();
+
     /* Count the number of pending callouts and allocate
      * the result array.
      */
-    for (i = 0, cop = call_list; cop; cop = cop->next)
+    for (i = 0, ix = 0; ix < num_callouts; ix++)
     {
-        if (!callback_object(&(cop->fun)))
+        if (!callback_object(&(call_heap[ix]->fun)))
             continue;
         i++;
     }
@@ -733,14 +1094,12 @@ get_all_call_outs (void)
     /* Create the result array contents.
      */
 
-    next_time = 0;
-    for (i=0, cop = call_list; cop; cop = cop->next)
+    for (i = 0, ix = 0; ix < num_callouts; ix++)
     {
+        struct call *cop = call_heap[ix];
         vector_t *vv;
         object_t *ob;
 
-        next_time += cop->delta;
-
         ob = callback_object(&(cop->fun));
         if (!ob)
             continue;
@@ -765,7 +1124,7 @@ get_all_call_outs (void)
             put_ref_string(vv->item + 1, cop->fun.function.named.name);
         }
 
-        vv->item[2].u.number = next_time;
+        vv->item[2].u.number = cop->due - call_out_clock;
 
         if (cop->fun.num_arg > 0)
         {
@@ -12,6 +12,7 @@ extern void  next_call_out_cycle(void);
 extern size_t  call_out_status(strbuf_t *sbuf, Bool verbose);
 extern void  callout_driver_info(svalue_t *svp, int value) __attribute__((nonnull(1)));
 extern void  remove_stale_call_outs(void);
+extern void  remove_object_call_outs(object_t *ob) __attribute__((nonnull(1)));
 
 extern svalue_t *v_call_out(svalue_t *sp, int num_arg);
 extern svalue_t *f_call_out_info(svalue_t *sp);
@@ -2292,9 +2292,11 @@ get_message (char *buff)
             int retries;  /* retries of select() after EINTR */
 
             flush_all_player_mess();
-            twait = comm_time_to_call_heart_beat ? 0 : 1;
-              /* If the heart_beat is due, just check the state
-               * of the sockets, but don't wait.
+            twait = (comm_time_to_call_heart_beat
+                     || (gc_slices_pending && !gc_snapshot_pending)) ? 0 : 1;
+              /* If the heart_beat or a slice of the GC is due, just check
+               * the state of the sockets, but don't wait. While the GC
+               * waits for its snapshot, there is no hurry.
                */
 
             /* Set up fd-sets. */
@@ -2733,6 +2735,9 @@ get_message (char *buff)
                 time_to_call_heart_beat = MY_TRUE;
                 return MY_FALSE;
             }
+            /* let the backend do the next slice of the GC */
+            if (gc_slices_pending)
+                return MY_FALSE;
         } /* if (no NextCmdGiver) */
 
         /* See if we got any udp messages.
@@ -0,0 +1,565 @@
+/*---------------------------------------------------------------------------
+ * Cycle collector for arrays, mappings and structs.
+ *
+ *---------------------------------------------------------------------------
+ * Reference counting alone can't free values which reference each other
+ * in a cycle; without help they stay allocated until the next garbage
+ * collection. With configure_driver(DC_CYCLE_COLLECTION) set to a number
+ * of nodes, this module finds and frees such cycles in the background,
+ * using trial deletion as described by Bacon and Rajan ("Concurrent Cycle
+ * Collection in Reference Counted Systems").
+ *
+ * Whenever free_array(), free_mapping() or free_struct() leave a value
+ * with references, the value is a possible root of a garbage cycle and is
+ * recorded in roots[]. The value notes its position there in its .cc_root
+ * member, so it is recorded only once, and removed when it is freed.
+ *
+ * Once per backend cycle, cycle_collection_step() examines the values
+ * reachable from the recorded roots, up to the configured number of nodes:
+ *
+ *   1. Every node starts with its refcount, and the refcounts are reduced
+ *      by the references from within the nodes. A node left with a
+ *      positive count is referenced from outside.
+ *   2. Everything reachable from a node referenced from outside is live.
+ *   3. The remaining nodes are only referenced by each other, and are
+ *      freed: they are held with an extra reference, emptied, and then
+ *      released.
+ *
+ * Unlike the original algorithm, the counts are kept in a table of their
+ * own, so the values are never modified unless they are garbage. The .cc_root
+ * member of a node holds its index in the table (marked with CC_NODE) while
+ * the step runs.
+ *
+ * References not followed by the collector (closures, lvalues, the values
+ * of destructed keys, or entries of mappings protected by the interpreter)
+ * are counted as references from outside. A node whose references couldn't
+ * be followed because the table was full is treated the same. This
+ * can only keep garbage alive, never free a live value.
+ *
+ * A garbage collection frees all cycles anyway, and forgets the roots
+ * (cc_clear_roots()) before it frees memory behind the back of this module.
+ *---------------------------------------------------------------------------
+ */
+
+#include "driver.h"
+
+#ifdef USE_CYCLE_COLLECTOR
+
+#include "typedefs.h"
+
+#include "cyclegc.h"
+#include "array.h"
+#include "interpret.h"
+#include "mapping.h"
+#include "simulate.h"
+#include "structs.h"
+#include "svalue.h"
+#include "xalloc.h"
+
+/*-------------------------------------------------------------------------*/
+
+#define CC_MAX_ROOTS  10000
+  /* Maximum number of recorded roots. Further candidates are ignored,
+   * and left to the garbage collection.
+   */
+
+#define CC_NODE  0x80000000UL
+  /* Flag in .cc_root, marking it as an index into nodes[].
+   */
+
+/* --- struct cc_node_s: one value examined by a step
+ */
+
+typedef struct cc_node_s
+{
+    svalue_t v;     /* The value, uncounted */
+    p_int    refs;  /* The references from outside the examined values */
+} cc_node_t;
+
+/*-------------------------------------------------------------------------*/
+
+mp_int cycle_collection = 0;
+  /* The maximum number of nodes examined in one step, or 0 if the
+   * cycle collector is disabled.
+   */
+
+statcounter_t cc_num_roots_scanned = 0;
+  /* Number of roots examined.
+   */
+
+statcounter_t cc_num_freed = 0;
+  /* Number of arrays, mappings and structs freed.
+   */
+
+static svalue_t roots[CC_MAX_ROOTS];
+  /* The possible roots of garbage cycles, uncounted.
+   */
+
+static uint32_t num_roots = 0;
+  /* Number of entries in roots[].
+   */
+
+static cc_node_t *nodes = NULL;
+static uint32_t   num_nodes;
+static uint32_t   max_nodes;
+  /* During a step: the examined values, and their number.
+   */
+
+static uint32_t *live_stack;
+static uint32_t  num_live_stack;
+  /* During a step: the live nodes whose references are yet to be
+   * followed.
+   */
+
+static void (*visit)(svalue_t *v);
+  /* During a step: the function applied to every referenced value.
+   */
+
+/*-------------------------------------------------------------------------*/
+static INLINE uint32_t *
+cc_root_of (svalue_t *v)
+
+/* Return the .cc_root member of the array, mapping or struct <v>.
+ */
+
+{
+    switch (v->type)
+    {
+    case T_MAPPING:
+        return &(v->u.map->cc_root);
+    case T_STRUCT:
+        return &(v->u.strct->cc_root);
+    default:
+        return &(v->u.vec->cc_root);
+    }
+} /* cc_root_of() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE p_int *
+ref_of (svalue_t *v)
+
+/* Return the refcount of the array, mapping or struct <v>.
+ */
+
+{
+    switch (v->type)
+    {
+    case T_MAPPING:
+        return &(v->u.map->ref);
+    case T_STRUCT:
+        return &(v->u.strct->ref);
+    default:
+        return &(v->u.vec->ref);
+    }
+} /* ref_of() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+is_collectable (svalue_t *v)
+
+/* Return TRUE if <v> is a value handled by the cycle collector.
+ */
+
+{
+    switch (v->type)
+    {
+    case T_POINTER:
+    case T_QUOTED_ARRAY:
+        return v->u.vec != &null_vector;
+    case T_MAPPING:
+    case T_STRUCT:
+        return MY_TRUE;
+    default:
+        return MY_FALSE;
+    }
+} /* is_collectable() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE svalue_t *
+new_root (void)
+
+/* Return the next free entry in roots[], or NULL if it is full.
+ */
+
+{
+    if (num_roots >= CC_MAX_ROOTS)
+        return NULL;
+    return &roots[num_roots++];
+} /* new_root() */
+
+/*-------------------------------------------------------------------------*/
+void
+cc_add_array (vector_t *v)
+
+/* Array <v> lost a reference, but is still referenced: record it as
+ * a possible root.
+ */
+
+{
+    svalue_t *root;
+
+    if (v != &null_vector && NULL != (root = new_root()))
+    {
+        put_array(root, v);
+        v->cc_root = num_roots;
+    }
+} /* cc_add_array() */
+
+/*-------------------------------------------------------------------------*/
+Bool
+cc_add_mapping (mapping_t *m)
+
+/* Mapping <m> lost a reference, but is still referenced: record it as
+ * a possible root.
+ * Return FALSE (for use within the free_mapping() macro).
+ */
+
+{
+    svalue_t *root;
+
+    if (NULL != (root = new_root()))
+    {
+        put_mapping(root, m);
+        m->cc_root = num_roots;
+    }
+    return MY_FALSE;
+} /* cc_add_mapping() */
+
+/*-------------------------------------------------------------------------*/
+void
+cc_add_struct (struct_t *s)
+
+/* Struct <s> lost a reference, but is still referenced: record it as
+ * a possible root.
+ */
+
+{
+    svalue_t *root;
+
+    if (NULL != (root = new_root()))
+    {
+        put_struct(root, s);
+        s->cc_root = num_roots;
+    }
+} /* cc_add_struct() */
+
+/*-------------------------------------------------------------------------*/
+void
+cc_forget_root (uint32_t ix)
+
+/* Remove the root with the .cc_root value <ix> from roots[], because it
+ * is about to be freed or examined.
+ */
+
+{
+    svalue_t *v = &roots[ix-1];
+
+    *cc_root_of(v) = 0;
+    num_roots--;
+    if (ix-1 < num_roots)
+    {
+        *v = roots[num_roots];
+        *cc_root_of(v) = ix;
+    }
+} /* cc_forget_root() */
+
+/*-------------------------------------------------------------------------*/
+void
+cc_clear_roots (void)
+
+/* Forget all recorded roots.
+ */
+
+{
+    while (num_roots > 0)
+        *cc_root_of(&roots[--num_roots]) = 0;
+} /* cc_clear_roots() */
+
+/*-------------------------------------------------------------------------*/
+void
+set_cycle_collection (mp_int num)
+
+/* Set the maximum number of nodes to examine per backend cycle to <num>,
+ * or disable the cycle collector if <num> is 0.
+ */
+
+{
+    cycle_collection = num;
+    if (!num)
+        cc_clear_roots();
+} /* set_cycle_collection() */
+
+/*-------------------------------------------------------------------------*/
+static void
+visit_entry (svalue_t *key, svalue_t *val, void *extra)
+
+/* Callback for walk_mapping(): visit the <key> and the values <val> of
+ * an entry of the mapping <extra>.
+ */
+
+{
+    p_int num_values = ((mapping_t *)extra)->num_values;
+
+    visit(key);
+    while (num_values-- > 0)
+        visit(val++);
+} /* visit_entry() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+visit_references (svalue_t *v)
+
+/* Apply visit() to every value referenced by the array, mapping or
+ * struct <v>.
+ * Return FALSE if the references can't be followed, because <v> is
+ * a mapping protected by the interpreter.
+ */
+
+{
+    svalue_t *svp;
+    p_int     num;
+
+    switch (v->type)
+    {
+    case T_MAPPING:
+        if (v->u.map->hash && v->u.map->hash->ref)
+            return MY_FALSE;
+        walk_mapping(v->u.map, visit_entry, v->u.map);
+        return MY_TRUE;
+
+    case T_STRUCT:
+        svp = v->u.strct->member;
+        num = struct_size(v->u.strct);
+        break;
+
+    default:
+        svp = v->u.vec->item;
+        num = VEC_SIZE(v->u.vec);
+        break;
+    }
+
+    for ( ; num > 0; num--, svp++)
+        visit(svp);
+
+    return MY_TRUE;
+} /* visit_references() */
+
+/*-------------------------------------------------------------------------*/
+static void
+add_node (svalue_t *v)
+
+/* Add the value <v> to the examined nodes, removing it from the roots.
+ */
+
+{
+    uint32_t *cc_root = cc_root_of(v);
+    cc_node_t *node = &nodes[num_nodes];
+
+    if (*cc_root)
+        cc_forget_root(*cc_root);
+
+    node->v.type = (v->type == T_QUOTED_ARRAY) ? T_POINTER : v->type;
+    node->v.u = v->u;
+    node->refs = *ref_of(v);
+    *cc_root = CC_NODE | num_nodes++;
+} /* add_node() */
+
+/*-------------------------------------------------------------------------*/
+static void
+subtract_reference (svalue_t *v)
+
+/* Visitor for step 1: count the reference to <v> as one from within
+ * the examined nodes, adding <v> to them if there is still room.
+ */
+
+{
+    uint32_t cc_root;
+
+    if (!is_collectable(v))
+        return;
+
+    cc_root = *cc_root_of(v);
+    if (!(cc_root & CC_NODE))
+    {
+        if (num_nodes >= max_nodes)
+            return;
+        cc_root = CC_NODE | num_nodes;
+        add_node(v);
+    }
+
+    nodes[cc_root & ~CC_NODE].refs--;
+} /* subtract_reference() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mark_live (svalue_t *v)
+
+/* Visitor for step 2: <v> is referenced by a live node, so it is live
+ * as well.
+ */
+
+{
+    uint32_t cc_root;
+
+    if (!is_collectable(v))
+        return;
+
+    cc_root = *cc_root_of(v);
+    if ((cc_root & CC_NODE) && !nodes[cc_root & ~CC_NODE].refs)
+    {
+        nodes[cc_root & ~CC_NODE].refs = 1;
+        live_stack[num_live_stack++] = cc_root & ~CC_NODE;
+    }
+} /* mark_live() */
+
+/*-------------------------------------------------------------------------*/
+static void
+free_garbage (cc_node_t *garbage, uint32_t num)
+
+/* Free the <num> nodes in <garbage>, which are referenced only by
+ * each other.
+ */
+
+{
+    uint32_t ix;
+    mp_int enabled = cycle_collection;
+
+    /* Values losing references here aren't new roots. */
+    cycle_collection = 0;
+
+    /* Hold on to the nodes, so that none of them is freed while
+     * the others are emptied.
+     */
+    for (ix = 0; ix < num; ix++)
+        (*ref_of(&garbage[ix].v))++;
+
+    for (ix = 0; ix < num; ix++)
+    {
+        svalue_t *v = &garbage[ix].v;
+        svalue_t *svp;
+        p_int     n;
+
+        switch (v->type)
+        {
+        case T_MAPPING:
+            clear_mapping(v->u.map);
+            continue;
+
+        case T_STRUCT:
+            svp = v->u.strct->member;
+            n = struct_size(v->u.strct);
+            break;
+
+        default:
+            svp = v->u.vec->item;
+            n = VEC_SIZE(v->u.vec);
+            break;
+        }
+
+        for ( ; n > 0; n--, svp++)
+        {
+            free_svalue(svp);
+            put_number(svp, 0);
+        }
+    }
+
+    /* Now only the held references are left. */
+    for (ix = 0; ix < num; ix++)
+    {
+#ifdef DEBUG
+        if (*ref_of(&garbage[ix].v) != 1)
+            fatal("Cycle garbage with %"PRIdPINT" refs left.\n"
+                 , *ref_of(&garbage[ix].v));
+#endif
+        free_svalue(&garbage[ix].v);
+    }
+
+    cycle_collection = enabled;
+    cc_num_freed += num;
+} /* free_garbage() */
+
+/*-------------------------------------------------------------------------*/
+void
+cycle_collection_step (void)
+
+/* Examine the values reachable from the recorded roots, up to the
+ * configured number, and free those only referenced by each other.
+ * Called once per backend cycle while the cycle collector is enabled.
+ */
+
+{
+    uint32_t ix, num_garbage;
+
+    if (!num_roots || !cycle_collection)
+        return;
+
+    max_nodes = (cycle_collection < (mp_int)(CC_NODE-1))
+                ? (uint32_t)cycle_collection : (uint32_t)(CC_NODE-1);
+    nodes = xalloc(max_nodes * sizeof(*nodes));
+    live_stack = xalloc(max_nodes * sizeof(*live_stack));
+    if (!nodes || !live_stack)
+    {
+        if (nodes)
+            xfree(nodes);
+        if (live_stack)
+            xfree(live_stack);
+        nodes = NULL;
+        return;
+    }
+    num_nodes = 0;
+
+    /* Step 1: collect the nodes reachable from the roots, and subtract the
+     * references between them.
+     */
+    visit = subtract_reference;
+    ix = 0;
+    while (num_roots > 0 && num_nodes < max_nodes)
+    {
+        svalue_t root = roots[num_roots-1];
+
+        add_node(&root);
+        cc_num_roots_scanned++;
+
+        for ( ; ix < num_nodes; ix++)
+        {
+            /* Protected mappings count as referenced from outside. */
+            if (!visit_references(&nodes[ix].v))
+                nodes[ix].refs++;
+        }
+    }
+
+    /* Step 2: mark everything reachable from the nodes with references
+     * from outside.
+     */
+    num_live_stack = 0;
+    for (ix = 0; ix < num_nodes; ix++)
+    {
+        if (nodes[ix].refs)
+            live_stack[num_live_stack++] = ix;
+    }
+
+    visit = mark_live;
+    while (num_live_stack > 0)
+        visit_references(&nodes[live_stack[--num_live_stack]].v);
+
+    /* Step 3: free the rest.
+     */
+    num_garbage = 0;
+    for (ix = 0; ix < num_nodes; ix++)
+    {
+        *cc_root_of(&nodes[ix].v) = 0;
+        if (!nodes[ix].refs)
+            nodes[num_garbage++] = nodes[ix];
+    }
+
+    if (num_garbage)
+        free_garbage(nodes, num_garbage);
+
+    xfree(live_stack);
+    xfree(nodes);
+    nodes = NULL;
+} /* cycle_collection_step() */
+
+#endif /* USE_CYCLE_COLLECTOR */
+
+/***************************************************************************/
@@ -0,0 +1,29 @@
+#ifndef CYCLEGC_H__
+#define CYCLEGC_H__ 1
+
+#include "driver.h"
+
+#ifdef USE_CYCLE_COLLECTOR
+
+#include "typedefs.h"
+
+/* --- Variables --- */
+
+extern mp_int cycle_collection;
+
+extern statcounter_t cc_num_roots_scanned;
+extern statcounter_t cc_num_freed;
+
+/* --- Prototypes --- */
+
+extern void cc_add_array(vector_t *v);
+extern Bool cc_add_mapping(mapping_t *m);
+extern void cc_add_struct(struct_t *s);
+extern void cc_forget_root(uint32_t ix);
+extern void cc_clear_roots(void);
+extern void set_cycle_collection(mp_int num);
+extern void cycle_collection_step(void);
+
+#endif /* USE_CYCLE_COLLECTOR */
+
+#endif /* CYCLEGC_H__ */
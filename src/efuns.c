@@ -103,11 +103,13 @@
 #include "call_out.h"
 #include "closure.h"
 #include "comm.h"
+#include "cyclegc.h"
 #include "dumpstat.h"
 #include "exec.h"
 #include "gcollect.h"
 #include "heartbeat.h"
 #include "interpret.h"
+#include "jit.h"
 #include "lex.h"
 #include "main.h"
 #include "mapping.h"
@@ -117,6 +119,8 @@
 #include "mstrings.h"
 #include "object.h"
 #include "otable.h"
+#include "prog_cache.h"
+#include "profile.h"
 #include "ptrtable.h"
 #include "random.h"
 #include "sha1.h"
@@ -7892,6 +7896,11 @@ f_configure_driver (svalue_t *sp)
  *        - DC_DATA_CLEAN_TIME     (3): time delay between data cleans
  *        - DC_TLS_CERTIFICATE     (4): TLS certificate to use (fingerprint)
  *        - DC_TLS_DHE_PARAMETER   (5): TLS Diffie-Hellman paramter to use
+ *        - DC_APPLY_CACHE_SIZE   (10): number of entries in the apply cache
+ *        - DC_PROFILE_INTERVAL   (11): sampling interval of the profiler
+ *        - DC_PROFILE_FUNCTIONS  (12): account the calls of all functions
+ *        - DC_GC_SLICE_TIME      (13): time per slice of an incremental GC
+ *        - DC_CYCLE_COLLECTION   (14): nodes examined by the cycle collector
  * 
  * <data> is dependent on <what>:
  *   DC_MEMORY_LIMIT:        ({soft-limit, hard-limit}) both <int>, given in Bytes.
@@ -7900,6 +7909,11 @@ f_configure_driver (svalue_t *sp)
  *   DC_DATA_CLEAN_TIME:     0 - __INT_MAX__/9 (int), given in seconds
  *   DC_TLS_CERTIFICATE      (string) SHA1 fingerprint
  *   DC_TLS_DHE_PARAMETER    (string) TLS Diffie-Hellman paramter (PEM-encoded)
+ *   DC_APPLY_CACHE_SIZE:    1 - MAX_APPLY_CACHE_SIZE (int)
+ *   DC_PROFILE_INTERVAL:    0 or 100 - __INT_MAX__ (int), given in microseconds.
+ *   DC_PROFILE_FUNCTIONS:   0/1 (int)
+ *   DC_GC_SLICE_TIME:       0 - __INT_MAX__ (int), given in microseconds.
+ *   DC_CYCLE_COLLECTION:    0 - __INT_MAX__ (int), number of values per cycle.
  *
  */
 
@@ -8106,6 +8120,55 @@ f_configure_driver (svalue_t *sp)
             swap_compact_mode = (sp->u.number != 0);
             break;
 
+        case DC_APPLY_CACHE_SIZE:
+            if (sp->type != T_NUMBER)
+                efun_arg_error(2, T_NUMBER, sp->type, sp);
+            if (sp->u.number < 1 || sp->u.number > MAX_APPLY_CACHE_SIZE)
+                errorf("DC_APPLY_CACHE_SIZE must be > 0 and <= %d, "
+                       "but is %"PRIdPINT".\n"
+                      , MAX_APPLY_CACHE_SIZE, sp->u.number);
+            if (!set_apply_cache_size(sp->u.number))
+                errorf("Out of memory for an apply cache of %"PRIdPINT
+                       " entries.\n", sp->u.number);
+            break;
+
+        case DC_PROFILE_INTERVAL:
+            if (sp->type != T_NUMBER)
+                efun_arg_error(2, T_NUMBER, sp->type, sp);
+            if (sp->u.number < 0 || (sp->u.number && sp->u.number < 100))
+                errorf("DC_PROFILE_INTERVAL must be 0 or >= 100, "
+                       "but is %"PRIdPINT".\n", sp->u.number);
+            if (!set_profile_interval(sp->u.number))
+                errorf("Could not set the profiling timer: %s\n"
+                      , strerror(errno));
+            break;
+
+        case DC_PROFILE_FUNCTIONS:
+            if (sp->type != T_NUMBER)
+                efun_arg_error(2, T_NUMBER, sp->type, sp);
+            set_profile_functions(sp->u.number != 0);
+            break;
+
+        case DC_GC_SLICE_TIME:
+            if (sp->type != T_NUMBER)
+                efun_arg_error(2, T_NUMBER, sp->type, sp);
+            if (sp->u.number < 0)
+                errorf("DC_GC_SLICE_TIME must be >= 0, but is %"PRIdPINT".\n"
+                      , sp->u.number);
+            gc_slice_time = sp->u.number;
+            break;
+
+#ifdef USE_CYCLE_COLLECTOR
+        case DC_CYCLE_COLLECTION:
+            if (sp->type != T_NUMBER)
+                efun_arg_error(2, T_NUMBER, sp->type, sp);
+            if (sp->u.number < 0)
+                errorf("DC_CYCLE_COLLECTION must be >= 0, but is %"PRIdPINT".\n"
+                      , sp->u.number);
+            set_cycle_collection(sp->u.number);
+            break;
+#endif
+
     }
 
     // free arguments
@@ -8211,6 +8274,28 @@ f_driver_info (svalue_t *sp)
             put_number(&result, swap_compact_mode);
             break;
 
+        case DC_APPLY_CACHE_SIZE:
+            put_number(&result, get_apply_cache_size());
+            break;
+
+        case DC_PROFILE_INTERVAL:
+            put_number(&result, profile_interval);
+            break;
+
+        case DC_PROFILE_FUNCTIONS:
+            put_number(&result, profile_functions ? 1 : 0);
+            break;
+
+        case DC_GC_SLICE_TIME:
+            put_number(&result, gc_slice_time);
+            break;
+
+#ifdef USE_CYCLE_COLLECTOR
+        case DC_CYCLE_COLLECTION:
+            put_number(&result, cycle_collection);
+            break;
+#endif
+
         /* Driver Environment */
         case DI_BOOT_TIME:
             put_number(&result, boot_time);
@@ -8303,6 +8388,15 @@ f_driver_info (svalue_t *sp)
             put_ref_string(&result, uncaught_error_trace_string);
             break;
 
+        /* Profiling */
+        case DI_PROFILE_SAMPLES:
+            get_profile_samples(&result);
+            break;
+
+        case DI_PROFILE_FUNCTIONS:
+            get_profile_functions(&result);
+            break;
+
         /* LPC Runtime statistics */
 #ifdef APPLY_CACHE_STAT
         case DI_NUM_FUNCTION_NAME_CALLS:
@@ -8316,6 +8410,18 @@ f_driver_info (svalue_t *sp)
         case DI_NUM_FUNCTION_NAME_CALL_MISSES:
             put_number(&result, apply_cache_miss);
             break;
+
+        case DI_NUM_FUNCTION_NAME_CALL_EVICTIONS:
+            put_number(&result, apply_cache_eviction);
+            break;
+
+        case DI_NUM_CALL_SITE_CACHE_HITS:
+            put_number(&result, call_site_cache_hit);
+            break;
+
+        case DI_NUM_CALL_SITE_CACHE_MISSES:
+            put_number(&result, call_site_cache_miss);
+            break;
 #else
 #endif
 
@@ -8344,6 +8450,12 @@ f_driver_info (svalue_t *sp)
         case DI_NUM_STRING_TABLE_HITS_BY_INDEX:
             /* FALLTHROUGH */
         case DI_NUM_STRING_TABLE_COLLISIONS:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_TABLE_RESIZES:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_APPENDS_IN_PLACE:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_APPENDS_COPIED:
             string_driver_info(&result, what);
             break;
 
@@ -8357,6 +8469,96 @@ f_driver_info (svalue_t *sp)
             rxcache_driver_info(&result, what);
             break;
 
+        case DI_NUM_OBJECTS_RESET_QUEUE:
+            /* FALLTHROUGH */
+        case DI_NUM_OBJECTS_CLEAN_UP_QUEUE:
+            /* FALLTHROUGH */
+        case DI_NUM_OBJECTS_DATA_CLEAN_QUEUE:
+            /* FALLTHROUGH */
+        case DI_NUM_OBJECTS_SWAP_QUEUE:
+            object_queue_driver_info(&result, what);
+            break;
+
+        case DI_NUM_MAPPING_COMPACTIONS:
+            /* FALLTHROUGH */
+        case DI_NUM_MAPPING_COMPACTIONS_LAST_CYCLE:
+            /* FALLTHROUGH */
+        case DI_SIZE_MAPPING_COMPACTIONS_SAVED:
+            /* FALLTHROUGH */
+        case DI_SIZE_MAPPING_COMPACTIONS_SAVED_LAST_CYCLE:
+            mapping_driver_info(&result, what);
+            break;
+
+        case DI_NUM_JIT_LOOPS_COMPILED:
+            put_number(&result, jit_loops_compiled);
+            break;
+
+        case DI_NUM_JIT_LOOPS_FAILED:
+            put_number(&result, jit_loops_failed);
+            break;
+
+        case DI_NUM_JIT_RUNS:
+            put_number(&result, jit_runs);
+            break;
+
+        case DI_SIZE_JIT_CODE:
+            put_number(&result, jit_code_size);
+            break;
+
+        case DI_NUM_PROFILE_SAMPLES:
+            put_number(&result, profile_samples);
+            break;
+
+        case DI_NUM_PROFILE_SAMPLES_LOST:
+            put_number(&result, profile_samples_lost);
+            break;
+
+        case DI_NUM_GC_SLICES:
+            put_number(&result, num_gc_slices);
+            break;
+
+        case DI_GC_LAST_PAUSE:
+            put_number(&result, gc_last_pause);
+            break;
+
+        case DI_GC_MAX_PAUSE:
+            put_number(&result, gc_max_pause);
+            break;
+
+        case DI_GC_MAX_SLICE:
+            put_number(&result, gc_max_slice);
+            break;
+
+#ifdef USE_CYCLE_COLLECTOR
+        case DI_NUM_CC_ROOTS_SCANNED:
+            put_number(&result, cc_num_roots_scanned);
+            break;
+
+        case DI_NUM_CC_FREED:
+            put_number(&result, cc_num_freed);
+            break;
+#endif
+
+        case DI_NUM_PROGRAM_CACHE_HITS:
+            put_number(&result, prog_cache_hits);
+            break;
+
+        case DI_NUM_PROGRAM_CACHE_MISSES:
+            put_number(&result, prog_cache_misses);
+            break;
+
+        case DI_NUM_INCLUDE_CACHE_HITS:
+            put_number(&result, inc_cache_hits);
+            break;
+
+        case DI_NUM_INCLUDE_CACHE_MISSES:
+            put_number(&result, inc_cache_misses);
+            break;
+
+        case DI_NUM_INCLUDE_CACHE_REPLAYS:
+            put_number(&result, inc_cache_replays);
+            break;
+
         /* Network statistics */
 #ifdef COMM_STAT
         case DI_NUM_MESSAGES_OUT:
@@ -8497,6 +8699,12 @@ f_driver_info (svalue_t *sp)
         case DI_NUM_STRING_TABLE_SLOTS:
             /* FALLTHROUGH */
         case DI_NUM_STRING_TABLE_SLOTS_USED:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_TABLE_LONGEST_CHAIN:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_TABLE_LONGEST_CHAIN_BEFORE_RESIZE:
+            /* FALLTHROUGH */
+        case DI_NUM_STRING_TABLE_CHAINS_TO_REHASH:
             string_driver_info(&result, what);
             break;
 
@@ -8583,6 +8791,10 @@ f_driver_info (svalue_t *sp)
             mempools_driver_info(&result, what);
             break;
 
+        case DI_SIZE_OBJECT_QUEUES:
+            object_queue_driver_info(&result, what);
+            break;
+
 
         /* Memory swapper statistics */
         case DI_NUM_SWAP_BLOCKS:
@@ -8651,6 +8863,8 @@ f_driver_info (svalue_t *sp)
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_INSPECTED:
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_MERGED:
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_RESULTING:
+        case DI_NUM_LARGE_BLOCKS_RELEASED:
+        case DI_SIZE_LARGE_BLOCKS_RELEASED:
             /* FALLTHROUGH */
 
         case DI_MEMORY_EXTENDED_STATISTICS:
@@ -8772,6 +8986,10 @@ f_dump_driver_info (svalue_t *sp)
 #endif
             break;
 
+        case DDI_PROFILE:
+            success = profile_dump(fname ? fname : STR_PROFDUMP_FNAME);
+            break;
+
         case DDI_MEMORY:
             success = false;
             if (mem_dump_memory(-1))
@@ -9455,7 +9673,7 @@ v_strftime(svalue_t *sp, int num_arg)
         errorf("Bad time in strftime(): %"PRIdMPINT" can't be "
             "represented by the host system. Maybe too large?\n", clk);
 
-    memsafe(rc = new_tabled(ts), strlen(ts)+sizeof(string_t), "strftime() result");
+    memsafe(rc = new_tabled(ts), strlen(ts)+MSTR_HEADER_SIZE, "strftime() result");
     
     sp = pop_n_elems(num_arg, sp);
     push_string(sp, rc);
@@ -452,6 +452,11 @@ struct program_s
        * If swapped out, the data is stored in the swap file at
        * .swapnum+.total_size .
        */
+    call_cache_t   *call_caches;
+      /* Array [.num_call_caches] of the inline caches of the call_other
+       * sites in the bytecode, allocated on first use. NULL when not
+       * allocated yet or swapped out, the caches are never swapped.
+       */
     unsigned short *function_names;
       /* Lookup table [.num_function_names] function-index -> offset of
        * the function within the functions[] table. function_names[] is
@@ -545,6 +550,8 @@ struct program_s
       /* Number of (directly) inherited programs */
     unsigned short num_structs;
       /* Number of listed struct definitions */
+    unsigned short num_call_caches;
+      /* Number of call_other sites with an inline cache */
     unsigned int   num_argument_types;
       /* Number of argument types in .argument_types */
 };
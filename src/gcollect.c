@@ -30,6 +30,14 @@
  * the collected memory blocks can be printed onto a file for closer
  * inspection.
  *
+ * An incremental GC does the clearing and counting in a forked process on
+ * a snapshot of the memory, while the driver goes on (gc_in_snapshot is
+ * TRUE there). The modules must then keep everything the driver might
+ * still use, instead of cleaning it up, and count it as it is. The process
+ * notes the refcounts of the values before it clears them: what the
+ * recount doesn't find are the references from the garbage, which the
+ * driver drops when it frees the garbage.
+ *
  * In order to do its job, the garbage collector calls functions clear_...
  * and count_... in all the other driver modules, where they are supposed
  * to perform their clearing and counting operations. To aid the other
@@ -68,6 +76,10 @@
  *     void count_ref_in_vector(svalue_t *svp, size_t num)
  *         Count the references the <num> elements of vector <p>.
  *
+ *     void note_snapshot_ref(svalue_t *v)
+ *         In the snapshot GC, note the refcount of value <v> before
+ *         it is cleared.
+ *
  * The referencing code for dynamic data should mirror the destructor code,
  * thus, memory leaks can show up as soon as the memory is allocated.
  *
@@ -85,6 +97,14 @@
 #endif
 #include <time.h>
 #include <stdio.h>
+#if defined(HAVE_MMAP) && defined(HAVE_WAITPID)
+#    include <signal.h>
+#    include <sys/mman.h>
+#    include <sys/wait.h>
+#    if defined(MAP_ANONYMOUS)
+#        define GC_SNAPSHOT
+#    endif
+#endif
 
 #include "gcollect.h"
 #include "actions.h"
@@ -93,6 +113,7 @@
 #include "call_out.h"
 #include "closure.h"
 #include "comm.h"
+#include "cyclegc.h"
 #include "efuns.h"
 #include "filestat.h"
 #include "heartbeat.h"
@@ -112,6 +133,7 @@
 #include "pkg-pgsql.h"
 #include "pkg-python.h"
 #include "pkg-tls.h"
+#include "profile.h"
 #include "prolang.h"
 #include "ptrtable.h"
 #include "random.h"
@@ -127,6 +149,7 @@
 #include "i-eval_cost.h"
 
 #include "../mudlib/sys/driver_hook.h"
+#include "../mudlib/sys/driver_info.h"
 
 /*-------------------------------------------------------------------------*/
 
@@ -135,6 +158,35 @@ time_t time_last_gc = 0;
    * when the memory usage is at the edge of a shortage.
    */
 
+mp_int gc_slice_time = 0;
+  /* The time in microseconds one slice of an incremental GC may take,
+   * or 0 if the GC is done in one go.
+   */
+
+Bool gc_slices_pending = MY_FALSE;
+  /* TRUE while an incremental GC is in progress: the backend has to call
+   * garbage_collection_slice() in every cycle.
+   */
+
+statcounter_t num_gc_slices = 0;
+  /* Number of slices done by incremental GCs.
+   */
+
+mp_int gc_last_pause = 0;
+mp_int gc_max_pause = 0;
+  /* Duration of the last and of the longest stop-the-world part of a GC,
+   * in microseconds.
+   */
+
+mp_int gc_max_slice = 0;
+  /* Duration of the longest slice of an incremental GC in microseconds.
+   */
+
+Bool gc_snapshot_pending = MY_FALSE;
+  /* TRUE while a forked process marks the memory for the incremental GC
+   * in progress: the backend only has to look for its result now and then.
+   */
+
 
 #if defined(GC_SUPPORT)
 
@@ -153,6 +205,12 @@ gc_status_t gc_status = gcInactive;
    * swap uses this information when swapping in objects.
    */
 
+Bool gc_in_snapshot = MY_FALSE;
+  /* TRUE in the forked process which marks the memory for an incremental
+   * GC. It must keep everything the driver might still use, and must
+   * not clean up anything.
+   */
+
 object_t *gc_obj_list_destructed;
   /* List of referenced but destructed objects.
    * Scope is global so that the GC support functions in mapping.c can
@@ -171,6 +229,102 @@ static lambda_t *stale_lambda_closures;
    * The now irrelevant .ob pointer is used to link the list elements.
    */
 
+static enum { gcSlicesClear, gcSlicesSnapshot, gcSlicesSweep } gc_slice_phase;
+  /* The phase of the incremental GC in progress:
+   *   gcSlicesClear:    the slices clear the 'referenced' flags, then the
+   *                     GC marks and frees what it can in one go.
+   *   gcSlicesSnapshot: a forked process marks the memory, the slices
+   *                     wait for its list of unreferenced blocks.
+   *   gcSlicesSweep:    the slices free the unreferenced blocks.
+   */
+
+static p_int gc_slices_done;
+  /* Number of slices done by the incremental GC in progress.
+   */
+
+#ifdef GC_SNAPSHOT
+
+/* The memory shared with the forked process of an incremental GC.
+ * The driver fills in the wizlist entries, the process everything else.
+ */
+
+typedef struct gc_snapshot_s      gc_snapshot_t;
+typedef struct gc_snapshot_wiz_s  gc_snapshot_wiz_t;
+typedef struct gc_snapshot_ref_s  gc_snapshot_ref_t;
+typedef struct gc_snapshot_prog_s gc_snapshot_prog_t;
+
+struct gc_snapshot_wiz_s
+{
+    wiz_list_t *wl;            /* The wizlist entry */
+    mp_int      size_array;    /* Size of its arrays in the garbage */
+    mp_int      mapping_total; /* Size of its mappings in the garbage */
+};
+
+struct gc_snapshot_ref_s
+{
+    svalue_t value;  /* A value still in use */
+    p_int    refs;   /* Its refcount at the fork, then the number of
+                      * references to it from the garbage */
+};
+
+struct gc_snapshot_prog_s
+{
+    program_t *prog;  /* A program still in use */
+    p_int      refs;  /* As gc_snapshot_ref_s.refs */
+};
+
+struct gc_snapshot_s
+{
+    volatile Bool done;
+      /* Set by the process when it is finished.
+       */
+    p_int num_blocks;
+      /* Number of unreferenced blocks found, -1 if there were
+       * more than .max_blocks.
+       */
+    p_int max_blocks;
+      /* Size of .blocks[].
+       */
+    mp_int num_arrays;
+    mp_int num_mappings;
+      /* Number of arrays and mappings in the garbage.
+       */
+    p_int num_wiz;
+      /* Number of entries in .wiz[].
+       */
+    gc_snapshot_wiz_t *wiz;
+      /* The wizlist entries with their share of the garbage.
+       */
+    void ** blocks;
+      /* The unreferenced blocks.
+       */
+    p_int num_refs, max_refs;
+    gc_snapshot_ref_t *refs;
+    p_int num_progs, max_progs;
+    gc_snapshot_prog_t *progs;
+      /* The values and programs the garbage references, and the number
+       * of these references.
+       */
+    p_int next_ref, next_prog;
+      /* The next entries of .refs[] and .progs[] the driver handles.
+       */
+};
+
+static gc_snapshot_t *gc_snapshot = NULL;
+  /* The memory shared with the process, while an incremental GC
+   * uses one.
+   */
+
+static size_t gc_snapshot_size;
+  /* The size of *gc_snapshot.
+   */
+
+static pid_t gc_snapshot_pid;
+  /* The process marking the memory.
+   */
+
+#endif /* GC_SNAPSHOT */
+
 #endif /* GC_SUPPORT */
 
 /*-------------------------------------------------------------------------*/
@@ -998,6 +1152,83 @@ void gc_note_malloced_block_ref (void *p) { gc_note_ref(p); }
 #define passed_note_ref(p) note_ref(p)
 #endif
 
+#ifdef GC_SNAPSHOT
+
+/*-------------------------------------------------------------------------*/
+static p_int
+snapshot_value_refs (svalue_t *v)
+
+/* Snapshot GC support: return the refcount of value <v>, which is one of
+ * the values noted by gc_note_snapshot_ref().
+ */
+
+{
+    switch (v->type)
+    {
+    case T_OBJECT:
+        return v->u.ob->ref;
+    case T_STRING:
+        return v->u.str->info.ref;
+    case T_POINTER:
+    case T_QUOTED_ARRAY:
+        /* The null vector is never freed. */
+        return v->u.vec != &null_vector ? v->u.vec->ref : 0;
+    case T_MAPPING:
+        return v->u.map->ref;
+    case T_STRUCT:
+        return v->u.strct->ref;
+    case T_CLOSURE:
+        return v->u.lambda->ref;
+    }
+    return 0;
+} /* snapshot_value_refs() */
+
+/*-------------------------------------------------------------------------*/
+static void
+note_snapshot_prog (program_t *p)
+
+/* Snapshot GC support: note the refcount of program <p> before it is
+ * cleared.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+
+    /* A program the recount finds has at least one reference again. */
+    if (p->ref > 1 && snap->num_progs < snap->max_progs)
+    {
+        snap->progs[snap->num_progs].prog = p;
+        snap->progs[snap->num_progs].refs = p->ref;
+        snap->num_progs++;
+    }
+} /* note_snapshot_prog() */
+
+#endif /* GC_SNAPSHOT */
+
+/*-------------------------------------------------------------------------*/
+void
+gc_note_snapshot_ref (svalue_t *v)
+
+/* Snapshot GC support: note the refcount of the object, string, array,
+ * mapping, struct or lambda closure <v> before it is cleared. If the
+ * table is full, the references from the garbage just stay.
+ */
+
+{
+#ifdef GC_SNAPSHOT
+    gc_snapshot_t *snap = gc_snapshot;
+    p_int refs = snapshot_value_refs(v);
+
+    /* A value the recount finds has at least one reference again. */
+    if (refs > 1 && snap->num_refs < snap->max_refs)
+    {
+        snap->refs[snap->num_refs].value = *v;
+        snap->refs[snap->num_refs].refs = refs;
+        snap->num_refs++;
+    }
+#endif
+} /* gc_note_snapshot_ref() */
+
 /*-------------------------------------------------------------------------*/
 void
 clear_string_ref (string_t *p)
@@ -1006,6 +1237,13 @@ clear_string_ref (string_t *p)
  */
 
 {
+    if (gc_in_snapshot && p->info.ref)
+    {
+        svalue_t sv;
+
+        put_string(&sv, p);
+        note_snapshot_ref(&sv);
+    }
     p->info.ref = 0;
 } /* clear_string_ref() */
 
@@ -1023,6 +1261,10 @@ clear_program_ref (program_t *p, Bool clear_ref)
 
     if (clear_ref)
     {
+#ifdef GC_SNAPSHOT
+        if (gc_in_snapshot)
+            note_snapshot_prog(p);
+#endif
         p->ref = 0;
     }
 
@@ -1152,6 +1394,9 @@ gc_mark_program_ref (program_t *p)
         if (p->line_numbers)
             note_ref(p->line_numbers);
 
+        if (p->call_caches)
+            note_ref(p->call_caches);
+
         /* Non-inherited functions */
 
         for (i = p->num_function_headers; --i >= 0; )
@@ -1238,7 +1483,8 @@ gc_reference_destructed_object (object_t *ob)
 
 /* Note the reference to a destructed object <ob>. The referee has to
  * replace its reference by a svalue.number 0 since all these objects
- * will be freed later.
+ * will be freed later. The snapshot GC counts every reference, as the
+ * driver keeps them.
  */
 
 {
@@ -1267,6 +1513,8 @@ gc_reference_destructed_object (object_t *ob)
             fatal("Destructed object %p '%s' referenced as something else\n"
                  , ob, ob->name ? get_txt(ob->name) : "<null>");
         }
+        if (gc_in_snapshot)
+            ob->ref++;
     }
 } /* gc_reference_destructed_object() */
 
@@ -1358,6 +1606,7 @@ clear_ref_in_vector (svalue_t *svp, size_t num)
         case T_QUOTED_ARRAY:
             if (!p->u.vec->ref)
                 continue;
+            note_snapshot_ref(p);
             p->u.vec->ref = 0;
             clear_ref_in_vector(&p->u.vec->item[0], VEC_SIZE(p->u.vec));
             continue;
@@ -1383,6 +1632,7 @@ clear_ref_in_vector (svalue_t *svp, size_t num)
                             , (p_int)p->u.map);
 #endif
                 m = p->u.map;
+                note_snapshot_ref(p);
                 m->ref = 0;
                 num_values = m->num_values;
                 walk_mapping(m, clear_map_ref_filter, (char *)num_values );
@@ -1397,6 +1647,7 @@ clear_ref_in_vector (svalue_t *svp, size_t num)
                 l = p->u.lambda;
                 if (l->ref)
                 {
+                    note_snapshot_ref(p);
                     l->ref = 0;
                     clear_ref_in_closure(l, p->x.closure_type);
                 }
@@ -1572,7 +1823,8 @@ gc_count_ref_in_closure (svalue_t *csvp)
 
 /* Count the reference to closure <csvp> and all referenced data.
  * Closures using a destructed object are stored in the stale_ lists
- * for later removal (and .ref is set to -1).
+ * for later removal (and .ref is set to -1). The snapshot GC counts them
+ * as they are instead.
  */
 
 {
@@ -1606,9 +1858,10 @@ gc_count_ref_in_closure (svalue_t *csvp)
         object_t *ob;
 
         ob = l->ob;
-        if (ob->flags & O_DESTRUCTED
-         || (   type == CLOSURE_LFUN
-             && l->function.lfun.ob->flags & O_DESTRUCTED) )
+        if (!gc_in_snapshot
+         && (   ob->flags & O_DESTRUCTED
+             || (   type == CLOSURE_LFUN
+                 && l->function.lfun.ob->flags & O_DESTRUCTED) ) )
         {
             l->ref = -1;
             if (type == CLOSURE_LAMBDA)
@@ -1646,12 +1899,21 @@ gc_count_ref_in_closure (svalue_t *csvp)
         }
         else
         {
-             /* Object exists: count reference */
+             /* Count the references to the objects. Only the snapshot GC
+              * finds destructed ones here.
+              */
 
-            ob->ref++;
+            if (ob->flags & O_DESTRUCTED)
+                reference_destructed_object(ob);
+            else
+                ob->ref++;
             if (type == CLOSURE_LFUN)
             {
-                l->function.lfun.ob->ref++;
+                ob = l->function.lfun.ob;
+                if (ob->flags & O_DESTRUCTED)
+                    reference_destructed_object(ob);
+                else
+                    ob->ref++;
                 if(l->function.lfun.inhProg)
                     mark_program_ref(l->function.lfun.inhProg);
             }
@@ -1738,6 +2000,15 @@ clear_ref_in_closure (lambda_t *l, ph_int type)
         lambda_t *l2 = l->function.lambda;
 
         if (l2->ref) {
+            if (gc_in_snapshot)
+            {
+                svalue_t sv;
+
+                sv.type = T_CLOSURE;
+                sv.x.closure_type = CLOSURE_UNBOUND_LAMBDA;
+                sv.u.lambda = l2;
+                note_snapshot_ref(&sv);
+            }
             l2->ref = 0;
             clear_ref_in_closure(l2, CLOSURE_UNBOUND_LAMBDA);
         }
@@ -1800,32 +2071,32 @@ new_default_gc_log (int fd)
 } /* new_default_gc_log() */
 
 /*-------------------------------------------------------------------------*/
-void
-garbage_collection(void)
+static mp_int
+gc_time_since (struct timeval *start)
 
-/* The Mark-Sweep garbage collector.
- *
- * Free all possible memory, then loop through every object and variable
- * in the game, check the reference counts and deallocate unused memory.
- * This takes time and should not be used lightheartedly.
- *
- * The function must be called outside of LPC evaluations.
+/* Return the time since <start> in microseconds.
  */
 
 {
-    object_t *ob, *next_ob;
-    lambda_t *l, *next_l;
-    int i;
-    long dobj_count;
+    struct timeval now;
 
-    if (gcollect_outfd != 1 && gcollect_outfd != 2)
-    {
-        dprintf1(gcollect_outfd, "\n%s --- Garbage Collection ---\n"
-                               , (long)time_stamp());
-    }
+    if (gettimeofday(&now, NULL))
+        return 0;
+    return (mp_int)(now.tv_sec - start->tv_sec) * 1000000
+           + (now.tv_usec - start->tv_usec);
+} /* gc_time_since() */
 
-    /* --- Pass 0: dispose of some unnecessary stuff ---
-     */
+/*-------------------------------------------------------------------------*/
+static void
+dispose_unneeded_memory (Bool cleanup)
+
+/* Pass 0 of the GC: dispose of some unnecessary stuff, and free the
+ * destructed objects which aren't referenced anymore. If <cleanup> is
+ * TRUE, the data of all objects is cleaned up as well.
+ */
+
+{
+    long dobj_count;
 
     dobj_count = tot_alloc_object;
 
@@ -1855,7 +2126,8 @@ garbage_collection(void)
     free_all_local_names();
     remove_unknown_identifier();
     check_wizlist_for_destr();
-    cleanup_all_objects();
+    if (cleanup)
+        cleanup_all_objects();
     if (current_error_trace)
     {
         free_array(current_error_trace);
@@ -1899,14 +2171,18 @@ garbage_collection(void)
         xfree(sh);
     }
 #endif /* CHECK_OBJECT_REF */
+} /* dispose_unneeded_memory() */
 
+/*-------------------------------------------------------------------------*/
+static void
+clear_all_refs (void)
 
-    /* --- Pass 1: clear the 'referenced' flag in all malloced blocks ---
-     */
-    mem_clear_ref_flags();
+/* Pass 2 of the GC: clear the ref counts of everything reachable.
+ */
 
-    /* --- Pass 2: clear the ref counts ---
-     */
+{
+    object_t *ob;
+    int i;
 
     gc_status = gcClearRefs;
     if (d_flag > 3)
@@ -2058,15 +2334,22 @@ garbage_collection(void)
             clear_string_ref(ob->name);
         if (ob->load_name)
             clear_string_ref(ob->load_name);
-        ob->prog->ref = 0;
         clear_program_ref(ob->prog, MY_TRUE);
         ob->ref = 0;
     }
+} /* clear_all_refs() */
 
+/*-------------------------------------------------------------------------*/
+static void
+count_all_refs (void)
 
-    /* --- Pass 3: Compute the ref counts, and set the 'referenced' flag where
-     *             appropriate ---
-     */
+/* Pass 3 of the GC: compute the ref counts, and set the 'referenced' flag
+ * of every reachable memory block. The caller resets gc_status afterwards.
+ */
+
+{
+    object_t *ob;
+    int i;
 
     gc_status = gcCountRefs;
 
@@ -2244,6 +2527,7 @@ garbage_collection(void)
     note_otable_ref();
     count_comm_refs();
     count_interpreter_refs();
+    count_profile_refs();
     count_heart_beat_refs();
     count_rxcache_refs();
 #ifdef USE_PGSQL
@@ -2271,6 +2555,69 @@ garbage_collection(void)
     /* Process the driver hooks */
 
     count_ref_in_vector(driver_hook, NUM_DRIVER_HOOKS);
+} /* count_all_refs() */
+
+/*-------------------------------------------------------------------------*/
+static void
+collect_garbage (Bool incremental)
+
+/* The Mark-Sweep garbage collector.
+ *
+ * Free all possible memory, then loop through every object and variable
+ * in the game, check the reference counts and deallocate unused memory.
+ * This takes time and should not be used lightheartedly.
+ *
+ * If <incremental> is TRUE, the 'referenced' flags have been cleared
+ * by the slices of an incremental GC, and the unreferenced small blocks
+ * are left to the following slices.
+ *
+ * The function must be called outside of LPC evaluations.
+ */
+
+{
+    object_t *ob, *next_ob;
+    lambda_t *l, *next_l;
+    long dobj_count;
+    struct timeval start;
+#ifdef USE_CYCLE_COLLECTOR
+    mp_int cycle_nodes = cycle_collection;
+#endif
+
+    if (gettimeofday(&start, NULL))
+        start.tv_sec = start.tv_usec = 0;
+
+#ifdef USE_CYCLE_COLLECTOR
+    /* The GC frees the garbage cycles itself, so the cycle collector
+     * has to forget its roots, and not collect new ones meanwhile.
+     */
+    set_cycle_collection(0);
+#endif
+
+    if (!incremental && gcollect_outfd != 1 && gcollect_outfd != 2)
+    {
+        dprintf1(gcollect_outfd, "\n%s --- Garbage Collection ---\n"
+                               , (long)time_stamp());
+    }
+
+    /* --- Pass 0: dispose of some unnecessary stuff ---
+     */
+
+    dispose_unneeded_memory(MY_TRUE);
+
+    /* --- Pass 1: clear the 'referenced' flag in all malloced blocks ---
+     */
+    mem_clear_ref_flags();
+
+    /* --- Pass 2: clear the ref counts ---
+     */
+
+    clear_all_refs();
+
+    /* --- Pass 3: Compute the ref counts, and set the 'referenced' flag where
+     *             appropriate ---
+     */
+
+    count_all_refs();
 
     gc_status = gcInactive;
 
@@ -2319,7 +2666,10 @@ garbage_collection(void)
     /* --- Pass 6: Release all unused memory ---
      */
 
-    mem_free_unrefed_memory();
+    if (incremental)
+        mem_begin_free_unrefed_memory();
+    else
+        mem_free_unrefed_memory();
     reallocate_reserved_areas();
     if (!reserved_user_area)
     {
@@ -2365,12 +2715,655 @@ garbage_collection(void)
     }
 #endif
 
+#ifdef USE_CYCLE_COLLECTOR
+    set_cycle_collection(cycle_nodes);
+#endif
+
+    gc_last_pause = gc_time_since(&start);
+    if (gc_last_pause > gc_max_pause)
+        gc_max_pause = gc_last_pause;
+
     /* If the GC log was redirected, close that file and set the
-     * logging back to the default file.
+     * logging back to the default file. An incremental GC still needs
+     * it for its remaining slices.
+     */
+    if (!incremental)
+        restore_default_gc_log();
+} /* collect_garbage() */
+
+#ifdef GC_SNAPSHOT
+
+/*-------------------------------------------------------------------------*/
+static void
+note_tabled_string (string_t *string)
+
+/* Snapshot GC support: note the refcount of the tabled <string>, and clear
+ * it. Unlike other values, the driver still finds it if only the garbage
+ * references it, and has to free it then.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+
+    if (string->info.ref && snap->num_refs < snap->max_refs)
+    {
+        put_string(&snap->refs[snap->num_refs].value, string);
+        snap->refs[snap->num_refs].refs = string->info.ref;
+        snap->num_refs++;
+        string->info.ref = 0;
+    }
+} /* note_tabled_string() */
+
+/*-------------------------------------------------------------------------*/
+static void
+find_garbage_refs (void)
+
+/* Snapshot GC support: compare the noted refcounts with the recount, and
+ * keep the values and programs with references from the garbage, and the
+ * number of these references.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+    p_int i, num, refs;
+
+    for (i = num = 0; i < snap->num_refs; i++)
+    {
+        gc_snapshot_ref_t *r = &snap->refs[i];
+
+        refs = snapshot_value_refs(&r->value);
+
+        /* Values the recount didn't find are garbage themselves, except
+         * for the tabled strings. A found string without refcount has
+         * too many references to count.
+         */
+        if (!refs
+         && (   r->value.type != T_STRING
+             || !r->value.u.str->info.tabled
+             || !TEST_REF(r->value.u.str)))
+            continue;
+
+        if (r->refs > refs)
+        {
+            snap->refs[num].value = r->value;
+            snap->refs[num].refs = r->refs - refs;
+            num++;
+        }
+    }
+    snap->num_refs = num;
+
+    for (i = num = 0; i < snap->num_progs; i++)
+    {
+        gc_snapshot_prog_t *r = &snap->progs[i];
+
+        refs = r->prog->ref;
+        if (refs && r->refs > refs)
+        {
+            snap->progs[num].prog = r->prog;
+            snap->progs[num].refs = r->refs - refs;
+            num++;
+        }
+    }
+    snap->num_progs = num;
+} /* find_garbage_refs() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mark_tabled_string (string_t *string)
+
+/* Snapshot GC support: keep the tabled <string>, the driver can still
+ * find it in the string table.
+ */
+
+{
+    if (TEST_REF(string))
+        MARK_REF(string);
+} /* mark_tabled_string() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mark_snapshot (void)
+
+/* The forked process of an incremental GC: mark all memory the driver
+ * could still use at the time of the fork, and list the other blocks in
+ * gc_snapshot for the driver. The process works on a copy of the memory,
+ * so the marking may change the values as usual, but nothing must be
+ * allocated or freed.
+ *
+ * The function doesn't return.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+    object_t *ob;
+    long fd;
+    p_int i;
+
+    gc_in_snapshot = MY_TRUE;
+
+    /* Don't keep the ports and connections of the driver open,
+     * and don't write into its GC log.
+     */
+    for (fd = sysconf(_SC_OPEN_MAX); --fd > 2; )
+        close(fd);
+    gcollect_outfd = -1;
+
+    /* Remember the statistics, the recount tells the garbage's share.
+     */
+    snap->num_arrays = num_arrays;
+    snap->num_mappings = num_mappings;
+    for (i = 0; i < snap->num_wiz; i++)
+    {
+        snap->wiz[i].size_array = snap->wiz[i].wl->size_array;
+        snap->wiz[i].mapping_total = snap->wiz[i].wl->mapping_total;
+    }
+
+    /* --- Pass 1 to 3, as in collect_garbage(). The clearing notes the
+     * refcounts of the values it reaches, these are the ones the garbage
+     * can reference. Only the objects and the tabled strings are noted
+     * here.
+     */
+
+    mem_clear_ref_flags();
+    for (ob = obj_list; ob; ob = ob->next_all)
+    {
+        svalue_t sv;
+
+        put_object(&sv, ob);
+        gc_note_snapshot_ref(&sv);
+    }
+    for (ob = destructed_objs; ob; ob = ob->next_all)
+    {
+        svalue_t sv;
+
+        put_object(&sv, ob);
+        gc_note_snapshot_ref(&sv);
+    }
+    mstring_walk_table(note_tabled_string);
+    clear_all_refs();
+    count_all_refs();
+
+    /* The driver can still find these in its tables and caches, even if
+     * only garbage references them.
+     */
+    count_tabled_struct_refs();
+    count_static_lpctype_refs();
+    find_garbage_refs();
+    mstring_walk_table(mark_tabled_string);
+
+    gc_status = gcInactive;
+
+    snap->num_arrays -= num_arrays;
+    snap->num_mappings -= num_mappings;
+    for (i = 0; i < snap->num_wiz; i++)
+    {
+        snap->wiz[i].size_array -= snap->wiz[i].wl->size_array;
+        snap->wiz[i].mapping_total -= snap->wiz[i].wl->mapping_total;
+    }
+
+    snap->num_blocks = mem_list_unrefed_memory(snap->blocks, snap->max_blocks);
+    snap->done = MY_TRUE;
+    _exit(0);
+} /* mark_snapshot() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+snapshot_memory_available (size_t size)
+
+/* Return TRUE if the system has <size> bytes of memory available for the
+ * snapshot process. Without a way to tell, assume it has.
+ */
+
+{
+    FILE *f;
+    char line[80];
+    unsigned long kbytes;
+
+    /* Linux knows best how much memory it can give without swapping. */
+    f = fopen("/proc/meminfo", "r");
+    if (f != NULL)
+    {
+        while (fgets(line, sizeof(line), f) != NULL)
+        {
+            if (sscanf(line, "MemAvailable: %lu kB", &kbytes) == 1)
+            {
+                fclose(f);
+                return kbytes >= size / 1024;
+            }
+        }
+        fclose(f);
+    }
+
+#if defined(_SC_AVPHYS_PAGES) && defined(_SC_PAGESIZE)
+    {
+        long pages = sysconf(_SC_AVPHYS_PAGES);
+        long pagesize = sysconf(_SC_PAGESIZE);
+
+        if (pages > 0 && pagesize > 0)
+            return (size_t)pages >= size / (size_t)pagesize;
+    }
+#endif
+
+    return MY_TRUE;
+} /* snapshot_memory_available() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+start_snapshot (void)
+
+/* Start an incremental GC with a forked process, which marks a snapshot
+ * of the memory while the driver goes on. What is garbage at the time of
+ * the fork stays garbage, so the driver can free the blocks the process
+ * lists afterwards. Only pass 0 and the fork itself stop the driver.
+ *
+ * The process changes the refcounts and markers all over the memory, so
+ * the system has to copy about all of it for the process: the memory
+ * use of the driver doubles while the process runs.
+ *
+ * Return FALSE if that's not possible: if anything is swapped out (the
+ * process would share the swap file with the driver), if the system
+ * doesn't have the memory for the process, or if the shared memory or the
+ * process can't be created.
+ */
+
+{
+    struct timeval start;
+    svalue_t sv;
+    gc_snapshot_t *snap;
+    wiz_list_t *wl;
+    p_int max_blocks, max_progs, num_wiz, i;
+    size_t size;
+    pid_t pid;
+
+    if (num_swapped - num_unswapped > 0 || num_vb_swapped > 0)
+        return MY_FALSE;
+
+    mem_driver_info(&sv, DI_SIZE_SYS_ALLOCATED_BLOCKS);
+    if (!snapshot_memory_available((size_t)sv.u.number))
+    {
+        dprintf1(gcollect_outfd, "%s GC snapshot would need too much "
+                                 "memory, collecting in slices.\n"
+                , (long)time_stamp());
+        return MY_FALSE;
+    }
+
+    if (gettimeofday(&start, NULL))
+        start.tv_sec = start.tv_usec = 0;
+
+    /* --- Pass 0, without the cleanup of all objects, which would take
+     * about as long as the marking itself ---
+     */
+    dispose_unneeded_memory(MY_FALSE);
+
+    /* At most all allocated blocks can be unreferenced. */
+    mem_driver_info(&sv, DI_NUM_SMALL_BLOCKS_ALLOCATED);
+    max_blocks = sv.u.number;
+    mem_driver_info(&sv, DI_NUM_LARGE_BLOCKS_ALLOCATED);
+    max_blocks += sv.u.number;
+
+    max_progs = total_num_prog_blocks;
+
+    num_wiz = 1;
+    for (wl = all_wiz; wl; wl = wl->next)
+        num_wiz++;
+
+    /* Every value the garbage references is an allocated block, too. */
+    size = sizeof(*snap) + (size_t)num_wiz * sizeof(*snap->wiz)
+                         + (size_t)max_blocks * sizeof(*snap->blocks)
+                         + (size_t)max_blocks * sizeof(*snap->refs)
+                         + (size_t)max_progs * sizeof(*snap->progs);
+    snap = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS
+               , -1, 0);
+    if (snap == MAP_FAILED)
+        return MY_FALSE;
+
+    snap->done = MY_FALSE;
+    snap->num_blocks = -1;
+    snap->max_blocks = max_blocks;
+    snap->num_wiz = num_wiz;
+    snap->wiz = (gc_snapshot_wiz_t *)(snap + 1);
+    snap->blocks = (void **)(snap->wiz + num_wiz);
+    snap->num_refs = snap->next_ref = 0;
+    snap->max_refs = max_blocks;
+    snap->refs = (gc_snapshot_ref_t *)(snap->blocks + max_blocks);
+    snap->num_progs = snap->next_prog = 0;
+    snap->max_progs = max_progs;
+    snap->progs = (gc_snapshot_prog_t *)(snap->refs + max_blocks);
+    snap->wiz[0].wl = &default_wizlist_entry;
+    for (i = 1, wl = all_wiz; wl; wl = wl->next)
+        snap->wiz[i++].wl = wl;
+
+    gc_snapshot = snap;
+    gc_snapshot_size = size;
+
+#ifdef USE_CYCLE_COLLECTOR
+    /* The roots of the cycle collector aren't referenced, and may be
+     * garbage the driver frees behind its back.
+     */
+    cc_clear_roots();
+#endif
+
+    pid = fork();
+    if (pid == 0)
+        mark_snapshot();
+
+    if (pid < 0)
+    {
+        munmap(snap, size);
+        gc_snapshot = NULL;
+        return MY_FALSE;
+    }
+
+    gc_snapshot_pid = pid;
+    gc_snapshot_pending = MY_TRUE;
+    gc_slice_phase = gcSlicesSnapshot;
+
+    gc_last_pause = gc_time_since(&start);
+    if (gc_last_pause > gc_max_pause)
+        gc_max_pause = gc_last_pause;
+    time_last_gc = time(NULL);
+
+    dprintf2(gcollect_outfd, "%s GC snapshot is marked by process %d.\n"
+            , (long)time_stamp(), (long)pid);
+    return MY_TRUE;
+} /* start_snapshot() */
+
+/*-------------------------------------------------------------------------*/
+static void
+free_snapshot (void)
+
+/* Release the memory shared with the snapshot process.
+ */
+
+{
+    munmap(gc_snapshot, gc_snapshot_size);
+    gc_snapshot = NULL;
+    gc_snapshot_pending = MY_FALSE;
+} /* free_snapshot() */
+
+/*-------------------------------------------------------------------------*/
+static void
+stop_snapshot (void)
+
+/* Kill the snapshot process of the incremental GC in progress.
+ */
+
+{
+    int status;
+
+    kill(gc_snapshot_pid, SIGKILL);
+    while (waitpid(gc_snapshot_pid, &status, 0) < 0 && errno == EINTR) NOOP;
+    free_snapshot();
+} /* stop_snapshot() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+drop_garbage_refs (void)
+
+/* Drop the next references the garbage of the snapshot held on values and
+ * programs still in use, as the garbage would have done when it was
+ * freed. Return TRUE if there are more.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+    int n;
+
+    for (n = 0; n < 64 && snap->next_ref < snap->num_refs; n++)
+    {
+        gc_snapshot_ref_t *r = &snap->refs[snap->next_ref++];
+
+        /* Not for strings with too many references to count */
+        if (snapshot_value_refs(&r->value) < r->refs)
+            continue;
+
+        while (r->refs-- > 0)
+        {
+            svalue_t sv = r->value;
+
+            free_svalue(&sv);
+        }
+    }
+
+    for ( ; n < 64 && snap->next_prog < snap->num_progs; n++)
+    {
+        gc_snapshot_prog_t *r = &snap->progs[snap->next_prog++];
+
+        if (r->prog->ref < r->refs)
+            continue;
+
+        while (r->refs-- > 0)
+            free_prog(r->prog, MY_TRUE);
+    }
+
+    return snap->next_ref < snap->num_refs
+        || snap->next_prog < snap->num_progs;
+} /* drop_garbage_refs() */
+
+/*-------------------------------------------------------------------------*/
+static void
+wait_for_snapshot (void)
+
+/* Look whether the snapshot process of the incremental GC in progress
+ * is finished. If it listed the unreferenced blocks, take them out of the
+ * statistics and let the following slices free them. If it failed,
+ * collect the garbage in one go.
+ */
+
+{
+    gc_snapshot_t *snap = gc_snapshot;
+    int status;
+    pid_t rc;
+    p_int i;
+
+    rc = waitpid(gc_snapshot_pid, &status, WNOHANG);
+    if (rc == 0 || (rc < 0 && errno == EINTR))
+        return;
+
+    /* The process is gone. If SIGCLD is ignored (see start_erq_demon()),
+     * it was reaped already and waitpid() failed.
      */
+    if (!snap->done || snap->num_blocks < 0)
+    {
+        dprintf1(gcollect_outfd, "%s GC snapshot failed, collecting in one "
+                                 "go.\n"
+                , (long)time_stamp());
+        free_snapshot();
+        gc_slices_pending = MY_FALSE;
+        collect_garbage(MY_FALSE);
+        return;
+    }
+
+    num_arrays -= (int)snap->num_arrays;
+    num_mappings -= snap->num_mappings;
+    for (i = 0; i < snap->num_wiz; i++)
+    {
+        snap->wiz[i].wl->size_array -= snap->wiz[i].size_array;
+        snap->wiz[i].wl->mapping_total -= snap->wiz[i].mapping_total;
+    }
+
+    dprintf4(gcollect_outfd, "%s GC snapshot found %d unreferenced blocks, "
+                             "referencing %d values and %d programs.\n"
+            , (long)time_stamp(), snap->num_blocks, snap->num_refs
+            , snap->num_progs);
+
+    /* The list stays in the shared memory until the sweep is done. */
+    mem_begin_free_listed_memory(snap->blocks, snap->num_blocks);
+    gc_snapshot_pending = MY_FALSE;
+    gc_slice_phase = gcSlicesSweep;
+} /* wait_for_snapshot() */
+
+#endif /* GC_SNAPSHOT */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+gc_step (void)
+
+/* Do the next step of the incremental GC in progress. The sweep after a
+ * snapshot drops the references from the garbage first.
+ * Return TRUE if there are more.
+ */
+
+{
+#ifdef GC_SNAPSHOT
+    if (gc_snapshot && drop_garbage_refs())
+        return MY_TRUE;
+#endif
+    return mem_gc_step();
+} /* gc_step() */
+
+/*-------------------------------------------------------------------------*/
+static void
+finish_sweep_slices (void)
+
+/* Complete the sweep of an incremental GC, and give the memory manager
+ * the chance to consolidate the memory freed by it.
+ */
+
+{
+    while (gc_step()) NOOP;
+
+#ifdef GC_SNAPSHOT
+    if (gc_snapshot)
+        free_snapshot();
+#endif
+
+    mem_consolidate(MY_TRUE);
+    reallocate_reserved_areas();
+
+    dprintf2(gcollect_outfd, "%s GC finished after %d slices.\n"
+            , (long)time_stamp(), gc_slices_done);
+    gc_slices_pending = MY_FALSE;
     restore_default_gc_log();
+} /* finish_sweep_slices() */
+
+/*-------------------------------------------------------------------------*/
+void
+garbage_collection (void)
+
+/* Do a full garbage collection in one go. An incremental GC in progress
+ * is completed by it.
+ *
+ * The function must be called outside of LPC evaluations.
+ */
+
+{
+#ifdef GC_SNAPSHOT
+    if (gc_slices_pending && gc_slice_phase == gcSlicesSnapshot)
+        stop_snapshot();
+#endif
+    if (gc_slices_pending && gc_slice_phase == gcSlicesSweep)
+        finish_sweep_slices();
+    gc_slices_pending = MY_FALSE;
+
+    collect_garbage(MY_FALSE);
 } /* garbage_collection() */
 
+/*-------------------------------------------------------------------------*/
+void
+start_garbage_collection (void)
+
+/* Start a garbage collection. If gc_slice_time is set, the GC is done
+ * incrementally by calls to garbage_collection_slice(), otherwise in one
+ * go. Nothing happens if an incremental GC is already in progress.
+ *
+ * The incremental GC forks a process, which marks a snapshot of the
+ * memory while the driver goes on, and then drops the references from the
+ * garbage and frees the unreferenced blocks found by it slice by slice.
+ * Unlike a full GC, this doesn't remove the references to destructed
+ * objects from the values still in use, and keeps the struct types and
+ * lpctypes only referenced from the garbage.
+ *
+ * If no process can be forked, the incremental GC clears the 'referenced'
+ * flags of the small blocks slice by slice, marks all used memory and
+ * frees the large blocks in one go, then frees the unreferenced small
+ * blocks slice by slice again.
+ *
+ * The function must be called outside of LPC evaluations.
+ */
+
+{
+    if (gc_slices_pending)
+        return;
+
+    if (!gc_slice_time)
+    {
+        garbage_collection();
+        return;
+    }
+
+    if (gcollect_outfd != 1 && gcollect_outfd != 2)
+    {
+        dprintf1(gcollect_outfd, "\n%s --- Incremental Garbage Collection ---\n"
+                               , (long)time_stamp());
+    }
+
+    gc_slices_done = 0;
+    gc_slices_pending = MY_TRUE;
+
+#ifdef GC_SNAPSHOT
+    if (start_snapshot())
+        return;
+#endif
+
+    mem_begin_clear_ref_flags();
+    gc_slice_phase = gcSlicesClear;
+} /* start_garbage_collection() */
+
+/*-------------------------------------------------------------------------*/
+void
+garbage_collection_slice (void)
+
+/* Do the next slice of the incremental GC in progress: process slabs
+ * for at most gc_slice_time microseconds. At the end of the clearing,
+ * do the stop-the-world part of the GC. While the snapshot is marked,
+ * just look whether it is done.
+ *
+ * The function must be called outside of LPC evaluations.
+ */
+
+{
+    struct timeval start;
+    mp_int elapsed;
+    Bool more;
+
+    if (!gc_slices_pending)
+        return;
+
+#ifdef GC_SNAPSHOT
+    if (gc_slice_phase == gcSlicesSnapshot)
+    {
+        wait_for_snapshot();
+        return;
+    }
+#endif
+
+    if (gettimeofday(&start, NULL))
+        start.tv_sec = start.tv_usec = 0;
+
+    /* Without a slice time, the rest is done in one go. */
+    do
+        more = gc_step();
+    while (more && (!gc_slice_time || gc_time_since(&start) < gc_slice_time));
+
+    elapsed = gc_time_since(&start);
+    num_gc_slices++;
+    gc_slices_done++;
+    if (elapsed > gc_max_slice)
+        gc_max_slice = elapsed;
+
+    if (more)
+        return;
+
+    if (gc_slice_phase == gcSlicesClear)
+    {
+        gc_slice_phase = gcSlicesSweep;
+        collect_garbage(MY_TRUE);
+    }
+    else
+        finish_sweep_slices();
+} /* garbage_collection_slice() */
+
 
 #if defined(MALLOC_TRACE)
 
@@ -2924,6 +3917,10 @@ garbage_collection (void)
     reallocate_reserved_areas();
     time_last_gc = time(NULL);
 }
+
+void start_garbage_collection (void) { garbage_collection(); }
+void garbage_collection_slice (void) { NOOP }
+
 #endif /* GC_SUPPORT */
 
 
@@ -15,6 +15,7 @@
  */
 typedef enum { gcInactive = 0, gcClearRefs, gcCountRefs } gc_status_t;
 extern gc_status_t gc_status;
+extern Bool gc_in_snapshot;
 
 extern int gcollect_outfd;
 extern int default_gcollect_outfd;
@@ -75,6 +76,7 @@ extern void gc_count_ref_in_vector(svalue_t *svp, size_t num);
 #endif
 extern void gc_count_ref_from_string(string_t *p);
 extern void clear_ref_in_vector(svalue_t *svp, size_t num);
+extern void gc_note_snapshot_ref(svalue_t *v);
 
 extern void restore_default_gc_log (void);
 extern void new_default_gc_log (int fd);
@@ -95,6 +97,9 @@ extern void new_default_gc_log (int fd);
 #define count_ref_from_string(p) \
     GC_REF_DUMP(string_t*, p, "Ref from string", gc_count_ref_from_string)
 
+#define note_snapshot_ref(v) \
+    do { if (gc_in_snapshot) gc_note_snapshot_ref(v); } while(0)
+
 #ifdef DUMP_GC_REFS
 
 #define count_ref_in_vector(p, num) \
@@ -128,6 +133,13 @@ extern void new_default_gc_log (int fd);
 /* --- Variables --- */
 
 extern time_t time_last_gc;
+extern mp_int gc_slice_time;
+extern Bool gc_slices_pending;
+extern Bool gc_snapshot_pending;
+extern statcounter_t num_gc_slices;
+extern mp_int gc_last_pause;
+extern mp_int gc_max_pause;
+extern mp_int gc_max_slice;
 
 /* --- Prototypes --- */
 
@@ -135,6 +147,8 @@ extern void cleanup_object (object_t * obj);
 extern void cleanup_all_objects (void);
 extern void cleanup_driver_structures (void);
 extern void garbage_collection(void);
+extern void start_garbage_collection(void);
+extern void garbage_collection_slice(void);
 extern void setup_print_block_dispatcher(void);
 
 #endif /* GCOLLECT_H__ */
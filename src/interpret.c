@@ -202,9 +202,6 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#ifdef MARK
-#include "profile.h"
-#endif
 
 #include "interpret.h"
 
@@ -219,12 +216,14 @@
 #include "gcollect.h"
 #include "heartbeat.h"
 #include "instrs.h"
+#include "jit.h"
 #include "lex.h"
 #include "mapping.h"
 #include "mstrings.h"
 #include "object.h"
 #include "otable.h"
 #include "parse.h"
+#include "profile.h"
 #include "prolang.h"
 #include "simulate.h"
 #include "simul_efun.h"
@@ -278,6 +277,11 @@ struct catch_context
  *
  * Every entry in the apply cache holds information about a function
  * call, both for functions found and not found.
+ *
+ * The apply cache is set associative: a function call is hashed to one
+ * set of APPLY_CACHE_WAYS entries, which are kept in the order of their
+ * last use. When a new entry has to be added, the least recently used
+ * entry of the set is evicted.
  */
 
 struct cache
@@ -306,9 +310,50 @@ struct cache
        */
 };
 
+/* --- struct call_cache_s: the inline cache of one call_other site
+ *
+ * Every F_CALL_OTHER_CACHED instruction refers to one of these in
+ * the .call_caches of its program. The function name is constant for
+ * a site, so the entries are looked up just by the id_number of the
+ * receiving program. This makes the cache polymorphic: a site which
+ * calls objects of a few different programs will find all of them.
+ */
+
+#define CALL_SITE_CACHE_ENTRIES 4
+  /* Number of receiver programs cached per call site.
+   */
+
+struct call_cache_s
+{
+    int32 generation;
+      /* The call_cache_generation this cache is valid for.
+       */
+    struct cache entries[CALL_SITE_CACHE_ENTRIES];
+      /* The cached receivers, most recently used first. An entry with
+       * .id == 0 is unused; .name is always NULL.
+       */
+#ifdef APPLY_CACHE_STAT
+    statcounter_t hits, misses;
+      /* Number of hits and misses of this call site.
+       */
+#endif
+};
+
 /*-------------------------------------------------------------------------*/
 /* Macros */
 
+#if defined(USE_COMPUTED_GOTO) && !defined(HAS_COMPUTED_GOTO)
+#    undef USE_COMPUTED_GOTO
+#endif
+  /* Without compiler support for computed gotos, eval_instruction()
+   * falls back to dispatching the instructions with a switch.
+   */
+
+
+#if F_EFUNV - F_EFUN0 != 5
+#    error The efun prefix codes F_EFUN0..F_EFUNV must be consecutive.
+#endif
+
 #define ERRORF(s) do{inter_pc = pc; inter_sp = sp; errorf s ;}while(0)
 #define ERROR(s) ERRORF((s))
   /* ERRORF((...)) acts like errorf(...), except that first the local pc and sp
@@ -330,13 +375,17 @@ struct cache
 #else
 #    define CACHE_SIZE (1 << APPLY_CACHE_BITS)
 #endif
-  /* Number of entries in the apply cache.
+  /* Initial number of entries in the apply cache.
    */
 #if CACHE_SIZE > INT_MAX
 #error CACHE_SIZE is > INT_MAX.
 #endif
   /* sanity check - some functions rely that CACHE_SIZE fits into int */
 
+#define APPLY_CACHE_WAYS 4
+  /* Number of entries in one set of the apply cache.
+   */
+
 /*-------------------------------------------------------------------------*/
 /* Tracing */
 
@@ -635,12 +684,35 @@ static Bool runtime_array_range_check = MY_FALSE;
 #ifdef APPLY_CACHE_STAT
 statcounter_t apply_cache_hit  = 0;
 statcounter_t apply_cache_miss = 0;
-  /* Number of hits and misses in the apply cache.
+statcounter_t apply_cache_eviction = 0;
+  /* Number of hits and misses in the apply cache, and the number of
+   * valid entries evicted from it.
+   */
+#endif
+
+static struct cache *cache = NULL;
+  /* The apply cache, an array of <apply_cache_size> entries grouped
+   * into sets of APPLY_CACHE_WAYS entries.
+   */
+
+static p_int apply_cache_size = 0;
+  /* Number of entries in the apply cache, a power of 2.
+   */
+
+static p_int apply_cache_set_mask = 0;
+  /* Number of sets in the apply cache - 1, used to mask the hash value.
+   */
+
+#ifdef APPLY_CACHE_STAT
+statcounter_t call_site_cache_hit  = 0;
+statcounter_t call_site_cache_miss = 0;
+  /* Number of hits and misses in the call site caches.
    */
 #endif
 
-static struct cache cache[CACHE_SIZE];
-  /* The apply cache.
+static int32 call_cache_generation = 1;
+  /* The current generation of the call site caches, incremented
+   * to invalidate all of them at once.
    */
 
 static struct
@@ -704,6 +776,40 @@ static int opcount[MAXOPC];
    * opcode) is used as index.
    */
 
+#define OPCSEQ_TABLE_SIZE (1 << 15)
+  /* Number of entries in the table of instruction sequences,
+   * must be a power of 2.
+   */
+
+#define OPCSEQ_DUMP_LENGTH 100
+  /* Number of the most frequent pairs resp. triples written by opcdump().
+   */
+
+struct opcseq_s
+{
+    short instr[3];  /* The instructions, instr[2] is -1 for pairs */
+    long  count;     /* The number of executions, 0 for an unused entry */
+};
+
+static struct opcseq_s opcseq_table[OPCSEQ_TABLE_SIZE];
+  /* Hash table (with linear probing) counting the executed sequences
+   * of two and three instructions. These are the candidates for new
+   * superinstructions (see func_spec and prolang.y).
+   */
+
+static long opcseq_used = 0;
+  /* Number of used entries in opcseq_table[].
+   */
+
+static long opcseq_lost = 0;
+  /* Number of sequence executions not counted because the table was full.
+   */
+
+static int opcseq_last[2] = { -1, -1 };
+  /* The last two executed instructions, opcseq_last[1] being the
+   * most recent one.
+   */
+
 #endif
 
 #ifdef DEBUG
@@ -743,7 +849,21 @@ struct timeval profiling_timevalue = {0, 0};
    * Default: 0ms (detection deactivated)
    */
 
-static Bool received_prof_signal = MY_FALSE;
+mp_int profile_interval = 0;
+  /* The sampling interval of the profiler in microseconds,
+   * 0 if the profiler is off.
+   */
+
+static volatile mp_int received_prof_signal = 0;
+  /* Number of SIGPROF signals received since eval_instruction() checked
+   * last.
+   */
+
+static mp_int eval_sampled_time = 0;
+  /* While the profiler is sampling: the CPU time (in microseconds) of the
+   * current evaluation as counted by the samples, or -1 if the evaluation
+   * has already been reported as a long execution.
+   */
 
 p_int used_memory_at_eval_start = 0;
   /* used memory (in bytes) at the beginning of the current execution,
@@ -754,7 +874,8 @@ p_int used_memory_at_eval_start = 0;
 /* Forward declarations */
 
 enum { APPLY_NOT_FOUND = 0, APPLY_FOUND, APPLY_DEFAULT_FOUND };
-static int int_apply(string_t *, object_t *, int, Bool, Bool);
+static int int_apply(string_t *, object_t *, int, Bool, Bool, call_cache_t *);
+static call_cache_t *get_call_cache(program_t *prog, int ix);
 static void call_simul_efun(unsigned int code, object_t *ob, int num_arg);
 #ifdef DEBUG
 static void check_extra_ref_in_vector(svalue_t *svp, size_t num);
@@ -811,13 +932,134 @@ void assign_eval_cost(void) { assign_eval_cost_inl(); }
 /*-------------------------------------------------------------------------*/
 void
 handle_profiling_signal(int ignored)
-/* signal handler for the SIGPROF signal. Just sets a flag which is checked in
- * eval_instruction() at the end of each instruction.
+/* signal handler for the SIGPROF signal. Just counts the signal, the counter
+ * is checked in eval_instruction() at the end of each instruction.
  */
 {
-    received_prof_signal = MY_TRUE;
+    received_prof_signal++;
 } // handle_prof()
 
+/*-------------------------------------------------------------------------*/
+static void
+sample_control_stack (mp_int weight)
+
+/* Record the current control stack in the profile, counted <weight> times.
+ * inter_pc must be up to date.
+ *
+ * As in collect_trace(), the function executed in a frame p is found
+ * in p->funstart, but its program and pc in p[1]. Frames of catch()es
+ * aren't recorded, their code is part of the function of the previous
+ * frame. So are the frames of efun and simul-efun closures.
+ */
+
+{
+    struct control_stack *p;
+    profile_frame_t *frames;
+    int num = 0;
+
+    if (!current_prog || csp < &CONTROL_STACK[0])
+    {
+        profile_add_sample(NULL, 0, weight);
+        return;
+    }
+
+    frames = alloca(sizeof(*frames) * (csp - &CONTROL_STACK[0] + 1));
+
+    for (p = &CONTROL_STACK[0]; p <= csp; p++)
+    {
+        bytecode_p  frame_pc;
+        program_t  *prog;
+
+        if (p == csp)
+        {
+            frame_pc = inter_pc;
+            prog = current_prog;
+        }
+        else
+        {
+            /* The code of a catch() continues in the next frame. */
+            if (p[1].catch_call)
+                continue;
+            frame_pc = p[1].pc;
+            prog = p[1].prog;
+        }
+
+        if (!prog || !frame_pc
+         || p->funstart == SIMUL_EFUN_FUNSTART
+         || p->funstart == EFUN_FUNSTART)
+            continue;
+
+        frames[num].file = prog->name;
+        if (p->funstart < prog->program || p->funstart > PROGRAM_END(*prog))
+        {
+            frames[num].name = STR_LAMBDA;
+            frames[num].line = 0;
+        }
+        else
+        {
+            frames[num].name = prog->function_headers[FUNCTION_HEADER_INDEX(p->funstart)].name;
+
+            /* Don't swap in the line numbers just for a sample. */
+            if (prog->line_numbers)
+            {
+                string_t *file;
+
+                frames[num].line = get_line_number(frame_pc, prog, &file);
+                free_mstring(file);
+            }
+            else
+                frames[num].line = 0;
+        }
+        num++;
+    }
+
+    profile_add_sample(frames, num, weight);
+} /* sample_control_stack() */
+
+/*-------------------------------------------------------------------------*/
+static void
+handle_profiling_signals (void)
+
+/* Called by eval_instruction() after SIGPROF signals were received.
+ * inter_pc must be up to date.
+ *
+ * If the profiler is sampling, the control stack is recorded, and the
+ * sampled time of the evaluation is checked against the limit for long
+ * executions. Otherwise the signal is the one-shot timer set by
+ * mark_start_evaluation(), and the evaluation has been running too long.
+ * A long execution is logged with a trace and then continues.
+ */
+
+{
+    mp_int signals = received_prof_signal;
+    char *ts;
+
+    received_prof_signal = 0;
+
+    if (profile_interval)
+    {
+        sample_control_stack(signals);
+
+        if (eval_sampled_time < 0
+         || !(profiling_timevalue.tv_usec || profiling_timevalue.tv_sec))
+            return;
+        eval_sampled_time += signals * profile_interval;
+        if (eval_sampled_time < get_profiling_time_limit())
+            return;
+        eval_sampled_time = -1;
+    }
+
+    ts = time_stamp();
+    debug_message("%s Received profiling signal, evaluation time > %ld.%06lds\n",
+                  ts, (long)profiling_timevalue.tv_sec, (long)profiling_timevalue.tv_usec);
+    printf("%s Received profiling signal, evaluation time > %ld.%06lds\n",
+                  ts, (long)profiling_timevalue.tv_sec, (long)profiling_timevalue.tv_usec);
+    // dump stack trace and continue execution
+    (void)dump_trace(MY_FALSE, NULL, NULL);
+    debug_message("%s ... execution continues.\n", ts);
+    printf("%s ... execution continues.\n", ts);
+} /* handle_profiling_signals() */
+
 /*-------------------------------------------------------------------------*/
 void
 mark_start_evaluation (void)
@@ -829,11 +1071,26 @@ mark_start_evaluation (void)
     // .it_interval is always zero (no auto-repeat), .it_value will be set later
     static struct itimerval prof_time_val = { {0,0}, {0,0} };
 
+    // Calls left over by an error in the last evaluation end with it.
+    if (profile_functions)
+        profile_functions_unwind(-1);
+
     total_evalcost = 0;
     eval_number++;
 
+    // While the profiler is sampling, the timer runs all the time.
+    // Signals received since the last evaluation are counted for the driver.
+    if (profile_interval)
+    {
+        if (received_prof_signal)
+        {
+            profile_add_sample(NULL, 0, received_prof_signal);
+            received_prof_signal = 0;
+        }
+        eval_sampled_time = 0;
+    }
     // start the profiling timer if enabled
-    if (profiling_timevalue.tv_usec || profiling_timevalue.tv_sec)
+    else if (profiling_timevalue.tv_usec || profiling_timevalue.tv_sec)
     {
         prof_time_val.it_value = profiling_timevalue;
         setitimer(ITIMER_PROF, &prof_time_val, NULL);
@@ -857,10 +1114,15 @@ mark_end_evaluation (void)
 {
     static struct itimerval prof_time_val = { {0,0}, {0,0} };
 
-    // disable the profiling timer
-    if (profiling_timevalue.tv_usec || profiling_timevalue.tv_sec)
+    // disable the profiling timer, unless the profiler uses it
+    if (!profile_interval
+     && (profiling_timevalue.tv_usec || profiling_timevalue.tv_sec))
         setitimer(ITIMER_PROF, &prof_time_val, NULL);
 
+    // Calls left by an error end with the evaluation.
+    if (profile_functions)
+        profile_functions_unwind(-1);
+
     if (total_evalcost == 0)
         return;
 
@@ -899,27 +1161,94 @@ init_interpret (void)
  */
 
 {
-    struct cache invalid_entry;
-    int i;
+    if (!set_apply_cache_size(CACHE_SIZE))
+        fatal("Out of memory for the apply cache.\n");
+} /* init_interpret()*/
+
+/*-------------------------------------------------------------------------*/
+Bool
+set_apply_cache_size (p_int size)
+
+/* Resize the apply cache to hold at least <size> entries (rounded up to
+ * the next power of 2 and to at least one set). All cached entries are
+ * discarded. Return FALSE if the new cache can't be allocated, in that
+ * case the old cache is kept.
+ *
+ * The cache entries are not referenced across LPC calls, so this
+ * can be called at any time, even from within an apply.
+ */
 
-    /* The cache is inited to hold entries for 'functions' in a non-existing
-     * program (id 0). The first real apply calls will thus see a (virtual)
-     * collision with 'older' cache entries.
+{
+    struct cache *new_cache;
+    p_int new_size;
+
+    for (new_size = APPLY_CACHE_WAYS; new_size < size; new_size <<= 1) NOOP;
+
+    new_cache = xalloc(new_size * sizeof(*new_cache));
+    if (new_cache == NULL)
+        return MY_FALSE;
+
+    /* All entries are inited to hold 'functions' in a non-existing
+     * program (id 0), which will never be matched.
      */
+    memset(new_cache, 0, new_size * sizeof(*new_cache));
 
-    invalid_entry.id = 0;
-    invalid_entry.progp = (program_t *)1;
-    invalid_entry.name = NULL;
-    
-    /* To silence the compiler: */
-    invalid_entry.variable_index_offset = 0;
-    invalid_entry.function_index_offset = 0;
-    invalid_entry.funstart = 0;
-    invalid_entry.flags = 0;
-
-    for (i = 0; i < CACHE_SIZE; i++)
-        cache[i] = invalid_entry;
-} /* init_interpret()*/
+    if (cache != NULL)
+    {
+        p_int i;
+
+        for (i = 0; i < apply_cache_size; i++)
+            if (cache[i].name)
+                free_mstring(cache[i].name);
+        xfree(cache);
+    }
+
+    cache = new_cache;
+    apply_cache_size = new_size;
+    apply_cache_set_mask = new_size / APPLY_CACHE_WAYS - 1;
+
+    return MY_TRUE;
+} /* set_apply_cache_size() */
+
+/*-------------------------------------------------------------------------*/
+p_int
+get_apply_cache_size (void)
+
+/* Return the number of entries in the apply cache.
+ */
+
+{
+    return apply_cache_size;
+} /* get_apply_cache_size() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE struct cache *
+new_apply_cache_entry (struct cache *set)
+
+/* Make room for a new entry in the apply cache <set> by evicting its
+ * least recently used entry. The returned entry is the first one of the
+ * set; it is cleared, so that the cache stays consistent until the
+ * caller filled it in.
+ */
+
+{
+    struct cache *entry = set + APPLY_CACHE_WAYS - 1;
+
+#ifdef APPLY_CACHE_STAT
+    if (entry->id != 0)
+        apply_cache_eviction++;
+#endif
+    if (entry->name)
+        free_mstring(entry->name);
+
+    memmove(set+1, set, (APPLY_CACHE_WAYS-1) * sizeof(*set));
+
+    set->id = 0;
+    set->name = NULL;
+    set->progp = NULL;
+
+    return set;
+} /* new_apply_cache_entry() */
 
 /*-------------------------------------------------------------------------*/
 static INLINE Bool
@@ -1048,6 +1377,31 @@ struct protected_range_lvalue {
      */
 };
 
+/*-------------------------------------------------------------------------*/
+static INLINE struct protected_char_lvalue *
+get_protected_char_lvalue (void *svp)
+
+/* Return the protector structure whose .v is the svalue <svp>.
+ * The protectors are allocated, so <svp> is aligned for them even
+ * when the svalues themselves are packed (COMPACT_SVALUES).
+ */
+
+{
+    return svp;
+} /* get_protected_char_lvalue() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE struct protected_range_lvalue *
+get_protected_range_lvalue (void *svp)
+
+/* Return the protector structure whose .v is the svalue <svp>, like
+ * get_protected_char_lvalue().
+ */
+
+{
+    return svp;
+} /* get_protected_range_lvalue() */
+
 /*-------------------------------------------------------------------------*/
 /* Forward declarations */
 
@@ -1941,7 +2295,7 @@ assign_svalue (svalue_t *dest, svalue_t *v)
           {
             struct protected_char_lvalue *p;
 
-            p = (struct protected_char_lvalue *)dest;
+            p = get_protected_char_lvalue(dest);
             if (p->lvalue->type == T_STRING
              && get_txt(p->lvalue->u.str) == p->start)
             {
@@ -1964,7 +2318,7 @@ assign_svalue (svalue_t *dest, svalue_t *v)
             {
                 (void)ref_array(v->u.vec); /* transfer_...() will free it once */
                 transfer_protected_pointer_range(
-                  (struct protected_range_lvalue *)dest, v
+                  get_protected_range_lvalue(dest), v
                 );
             }
             return;
@@ -1975,7 +2329,7 @@ assign_svalue (svalue_t *dest, svalue_t *v)
 
         case T_PROTECTED_STRING_RANGE_LVALUE:
             assign_protected_string_range(
-                  (struct protected_range_lvalue *)dest, v, MY_FALSE
+                  get_protected_range_lvalue(dest), v, MY_FALSE
             );
             return;
 
@@ -2095,7 +2449,7 @@ inl_transfer_svalue (svalue_t *dest, svalue_t *v)
           {
             struct protected_char_lvalue *p;
 
-            p = (struct protected_char_lvalue *)dest;
+            p = get_protected_char_lvalue(dest);
             if (p->lvalue->type == T_STRING
              && get_txt(p->lvalue->u.str) == p->start)
             {
@@ -2115,7 +2469,7 @@ inl_transfer_svalue (svalue_t *dest, svalue_t *v)
 
         case T_PROTECTED_POINTER_RANGE_LVALUE:
             transfer_protected_pointer_range(
-              (struct protected_range_lvalue *)dest, v
+              get_protected_range_lvalue(dest), v
             );
             return;
 
@@ -2125,7 +2479,7 @@ inl_transfer_svalue (svalue_t *dest, svalue_t *v)
 
         case T_PROTECTED_STRING_RANGE_LVALUE:
             assign_protected_string_range(
-              (struct protected_range_lvalue *)dest, v, MY_TRUE
+              get_protected_range_lvalue(dest), v, MY_TRUE
             );
             return;
         } /* end switch */
@@ -2604,7 +2958,7 @@ add_number_to_lvalue (svalue_t *dest, int i, svalue_t *pre, svalue_t *post)
       {
         struct protected_char_lvalue *p;
 
-        p = (struct protected_char_lvalue *)dest;
+        p = get_protected_char_lvalue(dest);
         if (p->lvalue->type == T_STRING
          && get_txt(p->lvalue->u.str) == p->start)
         {
@@ -2619,10 +2973,11 @@ add_number_to_lvalue (svalue_t *dest, int i, svalue_t *pre, svalue_t *post)
 
 /*-------------------------------------------------------------------------*/
 static vector_t *
-inter_add_array (vector_t *q, vector_t **vpp)
+inter_add_array (vector_t *q, svalue_t *dest)
 
-/* Append array <q> to array *<vpp>. Both <q> and *<vpp> are freed,
- * the result vector (just one ref) is assigned to *<vpp> and also returned.
+/* Append array <q> to the array in <dest>. Both <q> and the array in <dest>
+ * are freed, the result vector (just one ref) is assigned to <dest>->u.vec
+ * and also returned.
  *
  * <inter_sp> is supposed to point at the two vectors and will be decremented
  * by 2.
@@ -2635,9 +2990,9 @@ inter_add_array (vector_t *q, vector_t **vpp)
     svalue_t *s, *d;   /* Pointers for copying: src and dest */
     size_t p_size, q_size;  /* Sizes of p and q */
 
-    p = *vpp;
+    p = dest->u.vec;
 
-    /* *vpp could be in the summands, thus don't free p / q before
+    /* <dest> could be in the summands, thus don't free p / q before
      * assigning.
      * On the other hand, with an uninitialized array, we musn't assign
      * before the copying is done.
@@ -2680,8 +3035,12 @@ inter_add_array (vector_t *q, vector_t **vpp)
         d = malloc_increment_size(p, q_size * sizeof(svalue_t));
         if ( NULL != d)
         {
-            /* We got the additional memory */
+            /* We got the additional memory. It starts at the old end
+             * of the block, which is rounded up to whole words: with
+             * USE_COMPACT_SVALUES that isn't the end of the old items.
+             */
             r = p;
+            d = r->item + p_size;
             r->ref = 1;
             r->size = p_size + q_size;
 
@@ -2727,7 +3086,7 @@ inter_add_array (vector_t *q, vector_t **vpp)
             }
             *d++ = *s++;
         }
-        *vpp = r;
+        dest->u.vec = r;
         free_empty_vector(q);
     }
     else /* q->ref > 1 */
@@ -2735,7 +3094,7 @@ inter_add_array (vector_t *q, vector_t **vpp)
         for (cnt = (mp_int)q_size; --cnt >= 0; ) {
             assign_checked_svalue_no_free (d++, s++);
         }
-        *vpp = r;
+        dest->u.vec = r;
 
         deref_array(q);
     }
@@ -7760,6 +8119,16 @@ setup_new_frame2 (bytecode_p funstart, svalue_t *sp
       do_trace_call(funstart, is_lambda);
     }
 
+    /* Account the call for the function profile */
+    if (profile_functions && current_prog)
+    {
+        profile_function_enter(current_prog->name
+                              , is_lambda
+                                ? STR_LAMBDA
+                                : current_prog->function_headers[FUNCTION_HEADER_INDEX(funstart)].name
+                              , csp - CONTROL_STACK);
+    }
+
     /* Initialize the break stack, pointing to the entry above
      * the first available svalue.
      */
@@ -8058,6 +8427,147 @@ put_default_argument (svalue_t *sp, int instruction)
     }
 } /* put_default_argument() */
 
+#ifdef OPCPROF
+/*-------------------------------------------------------------------------*/
+static void
+count_opcode_sequence (int first, int second, int third)
+
+/* Count one execution of the instruction sequence <first>, <second>,
+ * <third> in opcseq_table[]. For a pair of instructions, <third> is -1.
+ */
+
+{
+    unsigned long ix;
+
+    ix = ((unsigned long)first * 509 + second) * 509 + third;
+    ix = (ix ^ (ix >> 15)) & (OPCSEQ_TABLE_SIZE-1);
+
+    for (;;)
+    {
+        struct opcseq_s *entry = opcseq_table + ix;
+
+        if (!entry->count)
+        {
+            /* Keep some free entries, so that the search terminates fast */
+            if (opcseq_used >= OPCSEQ_TABLE_SIZE / 4 * 3)
+            {
+                opcseq_lost++;
+                return;
+            }
+            entry->instr[0] = first;
+            entry->instr[1] = second;
+            entry->instr[2] = third;
+            entry->count = 1;
+            opcseq_used++;
+            return;
+        }
+
+        if (entry->instr[0] == first && entry->instr[1] == second
+         && entry->instr[2] == third)
+        {
+            entry->count++;
+            return;
+        }
+
+        ix = (ix + 1) & (OPCSEQ_TABLE_SIZE-1);
+    }
+} /* count_opcode_sequence() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE void
+count_opcode (int instr)
+
+/* Count the execution of instruction <instr>, and of the sequences
+ * it ends.
+ *
+ * The sequences are counted as they are executed, so they also include
+ * pairs spanning a jump or a function call. Only sequences found
+ * consecutively in the program code are candidates for superinstructions.
+ */
+
+{
+    opcount[instr]++;
+
+    if (opcseq_last[1] >= 0)
+    {
+        count_opcode_sequence(opcseq_last[1], instr, -1);
+        if (opcseq_last[0] >= 0)
+            count_opcode_sequence(opcseq_last[0], opcseq_last[1], instr);
+    }
+    opcseq_last[0] = opcseq_last[1];
+    opcseq_last[1] = instr;
+} /* count_opcode() */
+
+#endif /* OPCPROF */
+
+#ifdef TRACE_CODE
+
+/*-------------------------------------------------------------------------*/
+static void
+trace_instruction (int instruction, bytecode_p pc, svalue_t *sp, svalue_t *fp)
+
+/* Store the vitals of the <instruction> (read from <pc>-1) about to be
+ * executed with the stack <sp> and frame <fp> in the trace buffer.
+ */
+
+{
+#if TOTAL_TRACE_LENGTH & TOTAL_TRACE_LENGTH-1
+    if (++last == TOTAL_TRACE_LENGTH)
+        last = 0;
+#else
+    last = (last+1) & (TOTAL_TRACE_LENGTH-1);
+#endif
+    previous_instruction[last] = instruction;
+    previous_pc[last] = pc-1;
+    stack_size[last] = sp - fp - csp->num_local_variables;
+    abs_stack_size[last] = sp - VALUE_STACK;
+    if (previous_objects[last])
+    {
+        /* Need to free the previously stored object */
+        free_object(previous_objects[last], "TRACE_CODE");
+    }
+    previous_objects[last] = ref_object(current_object, "TRACE_CODE");
+    previous_programs[last] = current_prog;
+} /* trace_instruction() */
+
+#endif /* TRACE_CODE */
+
+#ifdef DEBUG
+
+/*-------------------------------------------------------------------------*/
+static void
+bad_stack_after_evaluation (svalue_t *sp, svalue_t *expected_stack
+                           , svalue_t *fp, int instruction, int num_arg)
+  NORETURN;
+
+static void
+bad_stack_after_evaluation (svalue_t *sp, svalue_t *expected_stack
+                           , svalue_t *fp, int instruction, int num_arg)
+
+/* Instruction <instruction> with <num_arg> arguments left the stack at
+ * <sp>, which is not the <expected_stack> (if not NULL) or below the
+ * local variables of the frame <fp>: abort the driver.
+ */
+
+{
+    if (expected_stack && expected_stack != sp)
+    {
+        fatal( "Bad stack after evaluation.\n"
+               "sp: %p expected: %p\n"
+               "Instruction %d(%s), num arg %d\n"
+             , sp, expected_stack
+             , instruction, get_f_name(instruction), num_arg);
+    }
+
+    fatal( "Bad stack after evaluation.\n"
+           "sp: %p minimum expected: %p\n"
+           "Instruction %d(%s), num arg %d\n"
+         , sp, (fp + csp->num_local_variables - 1)
+         , instruction, get_f_name(instruction), num_arg);
+} /* bad_stack_after_evaluation() */
+
+#endif /* DEBUG */
+
 /*-------------------------------------------------------------------------*/
 Bool
 eval_instruction (bytecode_p first_instruction
@@ -8105,8 +8615,26 @@ eval_instruction (bytecode_p first_instruction
     svalue_t *expected_stack; /* Expected stack at the instr end */
 #endif
 
-    svalue_t *ap;
-      /* Argument frame pointer: pointer to first outgoing argument to be
+    static const int efun_prefix_offset[]
+      = { EFUN0_OFFSET, EFUN1_OFFSET, EFUN2_OFFSET
+        , EFUN3_OFFSET, EFUN4_OFFSET, EFUNV_OFFSET };
+      /* The offsets of the efuns behind the prefix codes F_EFUN0..F_EFUNV.
+       */
+
+#ifdef USE_COMPUTED_GOTO
+#   define DISPATCH_TARGET(x) [x] = &&dispatch_##x,
+    static void * const dispatch_table[256]
+      = { [0 ... 255] = &&dispatch_default
+        , FOR_ALL_BYTECODES(DISPATCH_TARGET)
+        };
+#   undef DISPATCH_TARGET
+      /* The address of the code for every instruction, indexed by its
+       * first code byte. Unused codes lead to the default case.
+       */
+#endif
+
+    svalue_t *ap;
+      /* Argument frame pointer: pointer to first outgoing argument to be
        * passed to called function.
        */
     Bool use_ap;
@@ -8206,15 +8734,150 @@ eval_instruction (bytecode_p first_instruction
       /* Test the type of a certain argument.
        */
 
-#   ifdef MARK
+#   if defined(USE_COMPUTED_GOTO) && defined(MARK)
+#        define CASE(x) case (x): dispatch_##x: MARK(x);
+#   elif defined(USE_COMPUTED_GOTO)
+#        define CASE(x) case (x): dispatch_##x:
+#   elif defined(MARK)
 #        define CASE(x) case (x): MARK(x);
 #   else
 #        define CASE(x) case (x):
 #   endif
-      /* Macro to build the case: labels for the evaluator switch.
+      /* Macro to build the case: labels for the evaluator switch,
+       * and with computed gotos the labels for the dispatch table.
        * 'MARK' adds profiling support.
        */
 
+#   ifdef TRACE_CODE
+#        define TRACE_INSTRUCTION() trace_instruction(instruction, pc, sp, fp)
+#   else
+#        define TRACE_INSTRUCTION() NOOP
+#   endif
+      /* Store some vitals of the instruction to execute in the trace
+       * buffer.
+       */
+
+#   if defined(MALLOC_LPC_TRACE) && defined(OPCPROF)
+#        define NOTE_INSTRUCTION() \
+            do { \
+                TRACE_INSTRUCTION(); inter_pc = pc; count_opcode(full_instr); \
+            } while(0)
+#   elif defined(MALLOC_LPC_TRACE)
+#        define NOTE_INSTRUCTION() \
+            do { TRACE_INSTRUCTION(); inter_pc = pc; } while(0)
+#   elif defined(OPCPROF)
+#        define NOTE_INSTRUCTION() \
+            do { TRACE_INSTRUCTION(); count_opcode(full_instr); } while(0)
+#   else
+#        define NOTE_INSTRUCTION() TRACE_INSTRUCTION()
+#   endif
+      /* Do the bookkeeping for the instruction to execute: the trace
+       * buffer, the pc for the allocation traces, and the instruction
+       * profile.
+       */
+
+#   ifdef DEBUG
+#        define DEBUG_EXPECT_STACK() \
+            do { \
+                if (instrs[instruction].min_arg != instrs[instruction].max_arg \
+                 && instruction != F_CALL_OTHER \
+                 && instruction != F_CALL_DIRECT \
+                   ) \
+                { \
+                    num_arg = GET_UINT8(pc); \
+                    pc++; \
+                } \
+                else \
+                    num_arg = -1; \
+                if (num_arg != -1 && !use_ap) \
+                    expected_stack = sp - num_arg + \
+                        ( instrs[full_instr].ret_type == lpctype_void ? 0 : 1 ); \
+                else if (use_ap) \
+                    expected_stack = ap - \
+                        ( instrs[full_instr].ret_type == lpctype_void ? 1 : 0 ); \
+                else \
+                    expected_stack = NULL; \
+            } while(0)
+#        define DEBUG_CHECK_STACK() \
+            do { \
+                if ((expected_stack && expected_stack != sp) \
+                 || sp < fp + csp->num_local_variables - 1) \
+                    bad_stack_after_evaluation(sp, expected_stack, fp \
+                                              , instruction, num_arg); \
+            } while(0)
+#   else
+#        define DEBUG_EXPECT_STACK() NOOP
+#        define DEBUG_CHECK_STACK()  NOOP
+#   endif
+      /* DEBUG_EXPECT_STACK: before an instruction, get the expected number
+       * of arguments and determine the expected stack setting. The code
+       * deliberately looks at instruction and not full_instr, as all
+       * multibyte instructions do not store the number of arguments in
+       * code. If the number of arguments is not stored, it is supposed
+       * that the evaluator knows it.
+       *
+       * DEBUG_CHECK_STACK: after an instruction, check the stack against
+       * the expectation.
+       */
+
+#   ifdef USE_COMPUTED_GOTO
+#        define DISPATCH() \
+            do { \
+                if (sp - VALUE_STACK >= SIZEOF_STACK - 1 \
+                 || received_prof_signal || trace_exec_active \
+                 || (max_memory \
+                     && xalloc_used() - used_memory_at_eval_start > max_memory)) \
+                    goto instruction_done; \
+                DEBUG_CHECK_STACK(); \
+                runtime_no_warn_deprecated = MY_FALSE; \
+                runtime_array_range_check = MY_FALSE; \
+                full_instr = instruction = LOAD_CODE(pc); \
+                if ((unsigned int)(instruction - F_EFUN0) <= F_EFUNV - F_EFUN0) \
+                    full_instr = GET_CODE(pc) \
+                                 + efun_prefix_offset[instruction - F_EFUN0]; \
+                NOTE_INSTRUCTION(); \
+                if (add_eval_cost(1)) \
+                    goto too_long_evaluation; \
+                DEBUG_EXPECT_STACK(); \
+                inter_sp = sp; \
+                inter_pc = pc; \
+                goto *dispatch_table[instruction]; \
+            } while(0)
+#   else
+#        define DISPATCH() break
+#   endif
+      /* Macro to end an instruction and start the next one. With
+       * threaded dispatch, this is the common case of the code after the
+       * switch and at 'again:' for the next instruction, ending in a
+       * jump of its own. This way the CPU can predict the next instruction
+       * from the current one. Everything out of the ordinary (stack end,
+       * tracing, profiling signals, memory limit) leaves to the full code
+       * after the switch.
+       */
+
+#   ifdef JIT_ENABLED
+#        define JIT_LOOP() \
+            do { \
+                jit_code_t jit_code; \
+                if (trace_exec_active) \
+                    break; \
+                jit_code = jit_loop_code(current_prog, pc); \
+                if (jit_code) { \
+                    jit_result_t jit_result = jit_code(sp, fp \
+                      , max_eval_cost ? (uint32_t)max_eval_cost : INT32_MAX); \
+                    jit_runs++; \
+                    pc = jit_result.pc; \
+                    sp = jit_result.sp; \
+                } \
+            } while(0)
+#   else
+#        define JIT_LOOP() NOOP
+#   endif
+      /* Macro to run the native code of a loop, called after a backward
+       * branch to pc was taken. The native code returns the pc of the next
+       * instruction to interpret.
+       */
+
     /* Setup the variables.
      * The next F_RETURN at this level will return out of eval_instruction().
      */
@@ -8235,18 +8898,8 @@ again:
     /* Get the next instruction and increment the pc */
 
     full_instr = instruction = LOAD_CODE(pc);
-    if (full_instr == F_EFUN0)
-        full_instr = GET_CODE(pc) + EFUN0_OFFSET;
-    else if (full_instr == F_EFUN1)
-        full_instr = GET_CODE(pc) + EFUN1_OFFSET;
-    else if (full_instr == F_EFUN2)
-        full_instr = GET_CODE(pc) + EFUN2_OFFSET;
-    else if (full_instr == F_EFUN3)
-        full_instr = GET_CODE(pc) + EFUN3_OFFSET;
-    else if (full_instr == F_EFUN4)
-        full_instr = GET_CODE(pc) + EFUN4_OFFSET;
-    else if (full_instr == F_EFUNV)
-        full_instr = GET_CODE(pc) + EFUNV_OFFSET;
+    if ((unsigned int)(instruction - F_EFUN0) <= F_EFUNV - F_EFUN0)
+        full_instr = GET_CODE(pc) + efun_prefix_offset[instruction - F_EFUN0];
 
 #if 0
     if (full_instr != instruction)
@@ -8260,35 +8913,7 @@ again:
     fflush(stdout);
 #endif
 
-#   ifdef TRACE_CODE
-        /* Store some vitals in the trace buffer */
-
-#       if TOTAL_TRACE_LENGTH & TOTAL_TRACE_LENGTH-1
-            if (++last == TOTAL_TRACE_LENGTH)
-                last = 0;
-#       else
-            last = (last+1) & (TOTAL_TRACE_LENGTH-1);
-#       endif
-        previous_instruction[last] = instruction;
-        previous_pc[last] = pc-1;
-        stack_size[last] = sp - fp - csp->num_local_variables;
-        abs_stack_size[last] = sp - VALUE_STACK;
-        if (previous_objects[last])
-        {
-            /* Need to free the previously stored object */
-            free_object(previous_objects[last], "TRACE_CODE");
-        }
-        previous_objects[last] = ref_object(current_object, "TRACE_CODE");
-        previous_programs[last] = current_prog;
-#   endif  /* ifdef TRACE_CODE */
-
-#   ifdef MALLOC_LPC_TRACE
-        inter_pc = pc;
-#   endif
-
-#   ifdef OPCPROF
-        opcount[full_instr]++;
-#   endif
+    NOTE_INSTRUCTION();
 
     /* If requested, trace the instruction.
      * Print the name of the instruction, but guard against recursions.
@@ -8309,72 +8934,9 @@ again:
      * wizards everything is possible.
      */
     if (add_eval_cost(1))
-    {
-        rt_context_t * context;
-
-        /* Evaluation too long. Restore some globals and throw
-         * an error.
-         */
-
-        printf("%s eval_cost too big %ld\n", time_stamp(), (long)eval_cost);
-
-        assign_eval_cost_inl();
-
-        /* If the error isn't caught, reset the eval costs */
-        for (context = rt_context
-            ; !ERROR_RECOVERY_CONTEXT(context->type)
-            ; context = context->last
-            ) NOOP;
-        if (context->type <= ERROR_RECOVERY_BACKEND)
-        {
-            CLEAR_EVAL_COST;
-            RESET_LIMITS;
-        }
-
-        inter_pc = pc;
-        inter_fp = fp;
-        ERROR("Too long evaluation. Execution aborted.\n");
-    }
-
-#if defined(DEBUG)
-
-    /* Get the expected number of arguments and determined the expected
-     * stack setting.
-     * Note that the code deliberately looks at instruction and not
-     * full_instr, as all multibyte instructions do not store the number
-     * of arguments in code.
-     */
-    if (instrs[instruction].min_arg != instrs[instruction].max_arg
-     && instruction != F_CALL_OTHER
-     && instruction != F_CALL_DIRECT
-       )
-    {
-        num_arg = GET_UINT8(pc);
-        pc++;
-    }
-    else
-    {
-        /* Safety measure. It is supposed that the evaluator knows
-         * the number of arguments.
-         */
-        num_arg = -1;
-    }
+        goto too_long_evaluation;
 
-    if (num_arg != -1 && !use_ap)
-    {
-        expected_stack = sp - num_arg +
-            ( instrs[full_instr].ret_type == lpctype_void ? 0 : 1 );
-    }
-    else if (use_ap)
-    {
-        expected_stack = ap -
-            ( instrs[full_instr].ret_type == lpctype_void ? 1 : 0 );
-    }
-    else
-    {
-        expected_stack = NULL;
-    }
-#endif /* DEBUG */
+    DEBUG_EXPECT_STACK();
 
     /* The monster switch to execute the instruction.
      * The order of the cases is held (mostly) in the order
@@ -8388,9 +8950,18 @@ again:
        * TODO:: the long run, we should do this only for efuns (which are by
        * TODO:: then hopefully all tabled).
        */
+#ifdef USE_COMPUTED_GOTO
+    goto *dispatch_table[instruction];
+#endif
     switch(instruction)
     {
     default:
+#ifdef USE_COMPUTED_GOTO
+    dispatch_default:
+      /* Instructions which are never executed */
+    dispatch_F_LAND_EQ:
+    dispatch_F_LOR_EQ:
+#endif
         fatal("Undefined instruction '%s' (%d)\n", get_f_name(instruction),
               instruction);
         /* NOTREACHED */
@@ -8469,7 +9040,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     CASE(F_EFUN1);                  /* --- efun1 <code>        --- */
@@ -8519,7 +9090,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     CASE(F_EFUN2);                  /* --- efun2 <code>        --- */
@@ -8569,7 +9140,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     CASE(F_EFUN3);                  /* --- efun3 <code>        --- */
@@ -8620,7 +9191,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     CASE(F_EFUN4);                  /* --- efun4 <code>        --- */
@@ -8670,7 +9241,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     CASE(F_EFUNV);                  /* --- efunv <code>        --- */
@@ -8718,7 +9289,7 @@ again:
 #ifdef CHECK_OBJECT_REF
         check_all_object_shadows();
 #endif /* CHECK_OBJECT_REF */
-        break;
+        DISPATCH();
     }
 
     /* --- Predefined functions with counterparts in LPC --- */
@@ -8732,7 +9303,7 @@ again:
          */
         sp++;
         assign_checked_svalue_no_free(sp, find_value((int)(LOAD_UINT8(pc))) );
-        break;
+        DISPATCH();
 
     CASE(F_STRING);                /* --- string <ix>          --- */
     {
@@ -8744,7 +9315,7 @@ again:
 
         LOAD_SHORT(string_number, pc);
         push_ref_string(sp, current_strings[string_number]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_CSTRING3);               /* --- cstring3 <ix>       --- */
@@ -8754,7 +9325,7 @@ again:
          */
         unsigned int ix = LOAD_UINT8(pc);
         push_ref_string(sp, current_strings[ix+0x300]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_CSTRING2);               /* --- cstring2 <ix>       --- */
@@ -8764,7 +9335,7 @@ again:
          */
         unsigned int ix = LOAD_UINT8(pc);
         push_ref_string(sp, current_strings[ix+0x200]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_CSTRING1);               /* --- cstring1 <ix>       --- */
@@ -8774,7 +9345,7 @@ again:
          */
         unsigned int ix = LOAD_UINT8(pc);
         push_ref_string(sp, current_strings[ix+0x100]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_CSTRING0);               /* --- cstring0 <ix>       --- */
@@ -8784,7 +9355,7 @@ again:
          */
         unsigned int ix = LOAD_UINT8(pc);
         push_ref_string(sp, current_strings[ix]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_NUMBER);                 /* --- number <num>        --- */
@@ -8799,26 +9370,26 @@ again:
         sp->type = T_NUMBER;
         memcpy(&sp->u.number, pc, sizeof sp->u.number);
         pc += sizeof sp->u.number;
-        break;
+        DISPATCH();
     }
 
     CASE(F_CONST0);                 /* --- const0              --- */
         /* Push the number 0 onto the stack.
          */
         push_number(sp, 0);
-        break;
+        DISPATCH();
 
     CASE(F_CONST1);                 /* --- const1              --- */
         /* Push the number 1 onto the stack.
          */
         push_number(sp, 1);
-        break;
+        DISPATCH();
 
     CASE(F_NCONST1);                /* --- nconst1             --- */
         /* Push the number -1 onto the stack.
          */
         push_number(sp, -1);
-        break;
+        DISPATCH();
 
     CASE(F_CLIT);                   /* --- clit <num>          --- */
     {
@@ -8826,7 +9397,7 @@ again:
          * <num> is a 8-Bit uint.
          */
         push_number(sp, (p_int)LOAD_UINT8(pc));
-        break;
+        DISPATCH();
     }
 
     CASE(F_NCLIT);                  /* --- nclit <num>         --- */
@@ -8835,7 +9406,7 @@ again:
          * <num> is a 8-Bit uint.
          */
         push_number(sp, -(p_int)LOAD_UINT8(pc));
-        break;
+        DISPATCH();
     }
 
     CASE(F_FCONST0);                /* --- fconst0             --- */
@@ -8848,7 +9419,7 @@ again:
         sp++;
         sp->type = T_FLOAT;
         STORE_DOUBLE(sp, 0.0);
-        break;
+        DISPATCH();
     }
 
     CASE(F_FLOAT);                  /* --- float <mant> <exp>  --- */
@@ -8871,7 +9442,7 @@ again:
         sp->u.mantissa = mantissa;
         sp->x.exponent = exponent;
 #endif // FLOAT_FORMAT_2
-        break;
+        DISPATCH();
     }
 
     CASE(F_CLOSURE);            /* --- closure <ix> <inhIndex> --- */
@@ -9016,7 +9587,7 @@ again:
                             : ix);
             }
         }
-        break;
+        DISPATCH();
     }
 
     CASE(F_SYMBOL);                 /* --- symbol <ix> <num>   --- */
@@ -9034,7 +9605,7 @@ again:
         sp->type = T_SYMBOL;
         sp->x.quotes = LOAD_UINT8(pc);
         sp->u.str = ref_mstring(current_strings[string_number]);
-        break;
+        DISPATCH();
     }
 
     CASE(F_DEFAULT_RETURN);         /* --- default_return      --- */
@@ -9143,6 +9714,8 @@ again:
         current_lambda = csp->lambda;
 
         tracedepth--; /* We leave this level */
+        if (profile_functions)
+            profile_function_leave(csp - CONTROL_STACK);
 
         if (csp->extern_call)
         {
@@ -9176,7 +9749,7 @@ again:
         pc = csp->pc;
         fp = csp->fp;
         csp--;
-        break;
+        DISPATCH();
     }
 
     CASE(F_BREAK);                  /* --- break               --- */
@@ -9187,7 +9760,7 @@ again:
 
         pc = break_sp->u.break_addr;
         break_sp++;
-        break;
+        DISPATCH();
     }
 
     CASE(F_SWITCH);            /* --- switch <lots of data...> --- */
@@ -9780,7 +10353,7 @@ again:
 
         /* o1 is now the offset to jump to. */
         pc += o1;
-        break;
+        DISPATCH();
     }
 
     CASE(F_SSCANF);                 /* --- sscanf <numarg>     --- */
@@ -9810,7 +10383,7 @@ again:
         pop_n_elems(num_arg-1);
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
 #ifdef USE_PARSE_COMMAND
@@ -9859,7 +10432,7 @@ again:
                            , &arg[3], num_arg-3);
         pop_n_elems(num_arg);        /* Get rid of all arguments */
         push_number(sp, i ? 1 : 0);      /* Push the result value */
-        break;
+        DISPATCH();
     }
 #endif /* USE_PARSE_COMMAND */
 
@@ -9870,7 +10443,152 @@ again:
          */
         sp++;
         assign_local_svalue_no_free(sp, fp + LOAD_UINT8(pc));
-        break;
+        DISPATCH();
+
+    /* --- Superinstructions ---
+     *
+     * The compiler writes these over the first instruction of a frequent
+     * sequence, the code of the other instructions stays in place behind
+     * it. That way jumps into the middle of the sequence still work, and
+     * if the following code was changed after the superinstruction had
+     * been written (e.g. to turn an index into an lvalue), just the first
+     * instruction is executed.
+     * The eval cost is charged for every instruction of the sequence.
+     */
+
+    CASE(F_LOCAL_LOCAL);     /* --- local_local <ix> [local <ix2>] --- */
+
+        /* Superinstruction for 'local <ix>; local <ix2>':
+         * push the local variables <ix> and <ix2> onto the stack.
+         */
+        sp++;
+        assign_local_svalue_no_free(sp, fp + LOAD_UINT8(pc));
+        if (*pc == F_LOCAL)
+        {
+            (void)add_eval_cost(1);
+            sp++;
+            assign_local_svalue_no_free(sp, fp + pc[1]);
+            pc += 2;
+        }
+        DISPATCH();
+
+    CASE(F_LOCAL_INDEX);     /* --- local_index <ix> [index] --- */
+
+        /* Superinstruction for 'local <ix>; index':
+         * index sp[0] with local variable <ix>.
+         */
+        sp++;
+        assign_local_svalue_no_free(sp, fp + LOAD_UINT8(pc));
+        if (*pc == F_INDEX)
+        {
+            pc++;
+            (void)add_eval_cost(1);
+            if ((sp-1)->type == T_STRUCT)
+            {
+                ERRORF(("Illegal type to []: %s, expected string/vector/mapping.\n"
+                       , typename((sp-1)->type)
+                      ));
+                /* NOTREACHED */
+            }
+            sp = push_indexed_value(sp, pc, false);
+        }
+        DISPATCH();
+
+    CASE(F_LOCAL_LT); /* --- local_lt <ix> [<rhs>] [lt] [bbranch_when_non_zero <offset>] --- */
+    {
+        /* Superinstruction for 'local <ix>; <rhs>; lt' where <rhs> is
+         * one of 'local <ix2>', 'clit <num>' or 'number <num>', optionally
+         * followed by 'bbranch_when_non_zero <offset>' (as in the condition
+         * of a loop).
+         * Test if local variable <ix> is less than <rhs> and push the
+         * result resp. take the branch if it is true.
+         *
+         * This is only done when both values are numbers, otherwise just
+         * the 'local <ix>' is executed, and the rest of the sequence
+         * as usual.
+         */
+
+        svalue_t *left;
+        bytecode_p next;
+        p_int right = 0;
+        Bool numbers;
+
+        left = fp + LOAD_UINT8(pc);
+        numbers = (left->type == T_NUMBER);
+        next = pc + 1;
+        switch (*pc)
+        {
+        case F_LOCAL:
+            numbers = numbers && fp[*next].type == T_NUMBER;
+            right = fp[*next].u.number;
+            next++;
+            break;
+
+        case F_CLIT:
+            right = *next++;
+            break;
+
+        case F_NUMBER:
+            memcpy(&right, next, sizeof right);
+            next += sizeof right;
+            break;
+
+        default:
+            numbers = MY_FALSE;
+            break;
+        }
+
+        if (!numbers || *next != F_LT)
+        {
+            sp++;
+            assign_local_svalue_no_free(sp, left);
+            break;
+        }
+
+        next++;
+        if (*next == F_BBRANCH_WHEN_NON_ZERO)
+        {
+            (void)add_eval_cost(3);
+            next++;
+            if (left->u.number < right)
+            {
+                pc = next - GET_UINT8(next);
+                JIT_LOOP();
+            }
+            else
+                pc = next + 1;
+        }
+        else
+        {
+            (void)add_eval_cost(2);
+            push_number(sp, left->u.number < right);
+            pc = next;
+        }
+        DISPATCH();
+    }
+
+    CASE(F_INC_LOCAL);   /* --- inc_local <ix> [inc] --- */
+    {
+        /* Superinstruction for 'push_local_variable_lvalue <ix>; inc':
+         * increment local variable <ix> if it is a number.
+         * Otherwise just the lvalue is pushed.
+         */
+
+        svalue_t *svp = fp + LOAD_UINT8(pc);
+
+        if (*pc == F_INC && svp->type == T_NUMBER && svp->u.number != PINT_MAX)
+        {
+            (void)add_eval_cost(1);
+            svp->u.number++;
+            pc++;
+            break;
+        }
+
+        sp++;
+        sp->type = T_LVALUE;
+        sp->u.lvalue = svp;
+        DISPATCH();
+    }
 
     CASE(F_CATCH);       /* --- catch <flags> <offset> <guarded code> --- */
     {
@@ -9973,7 +10691,7 @@ again:
 #ifdef DEBUG
         expected_stack = NULL;
 #endif
-        break;
+        DISPATCH();
     }
 
     CASE(F_INC);                    /* --- inc                 --- */
@@ -10036,7 +10754,7 @@ again:
         ERRORF(("Bad arg to ++: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_DEC);                    /* --- dec                 --- */
@@ -10099,7 +10817,7 @@ again:
         ERRORF(("Bad arg to --: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_POST_INC);               /* --- post_inc            --- */
@@ -10162,7 +10880,7 @@ again:
         ERRORF(("Bad arg to ++: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_POST_DEC);               /* --- post_dec            --- */
@@ -10225,7 +10943,7 @@ again:
         ERRORF(("Bad arg to --: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_PRE_INC);                /* --- pre_inc             --- */
@@ -10286,7 +11004,7 @@ again:
         ERRORF(("Bad arg to ++: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_PRE_DEC);                /* --- pre_dec             --- */
@@ -10347,7 +11065,7 @@ again:
         ERRORF(("Bad arg to --: got '%s', expected numeric type.\n"
                , typename(svp->type)
                ));
-        break;
+        DISPATCH();
     }
 
     CASE(F_LAND);                   /* --- land <offset>       --- */
@@ -10373,7 +11091,7 @@ again:
         }
         sp--;
         pc++;
-        break;
+        DISPATCH();
     }
 
     CASE(F_LOR);                    /* --- lor <offset>        --- */
@@ -10388,7 +11106,7 @@ again:
         else
             pc += GET_UINT8(pc);
         pc++;
-        break;
+        DISPATCH();
     }
 
     CASE(F_ASSIGN);                 /* --- assign              --- */
@@ -10414,7 +11132,7 @@ again:
         dest = sp->u.lvalue;
         assign_svalue(dest, sp-1);
         sp--;
-        break;
+        DISPATCH();
     }
 
     CASE(F_VOID_ASSIGN);            /* --- void_assign         --- */
@@ -10435,7 +11153,7 @@ again:
 #endif
         transfer_svalue(sp->u.lvalue, sp-1);
         sp -= 2;
-        break;
+        DISPATCH();
     }
 
     CASE(F_ADD);                    /* --- add                 --- */
@@ -10657,7 +11375,7 @@ again:
             inter_sp = sp;
             inter_pc = pc;
             DYN_ARRAY_COST(VEC_SIZE(sp->u.vec)+VEC_SIZE(sp[-1].u.vec));
-            inter_add_array(sp->u.vec, &(sp-1)->u.vec);
+            inter_add_array(sp->u.vec, sp-1);
             sp--;
             break;
           }
@@ -10700,7 +11418,7 @@ again:
             /* NOTREACHED */
         }
 
-        break;
+        DISPATCH();
 
     CASE(F_SUBTRACT);               /* --- subtract            --- */
     {
@@ -11115,7 +11833,7 @@ again:
                           , sp[-1].type);
             /* NOTREACHED */
         }
-        break;
+        DISPATCH();
     }
 
     CASE(F_DIVIDE);                 /* --- divide              --- */
@@ -11207,7 +11925,7 @@ again:
         }
         OP_ARG_ERROR(1, TF_FLOAT|TF_NUMBER, sp[-1].type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_MOD);                    /* --- mod                 --- */
@@ -11234,7 +11952,7 @@ again:
             i = (sp-1)->u.number % sp->u.number;
         sp--;
         sp->u.number = i;
-        break;
+        DISPATCH();
     }
 
     CASE(F_GT);                     /* --- gt                  --- */
@@ -11555,7 +12273,7 @@ again:
         pop_stack();
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_NE);                     /* --- ne                  --- */
@@ -11630,7 +12348,7 @@ again:
         pop_stack();
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_COMPL);                  /* --- compl               --- */
@@ -11639,7 +12357,7 @@ again:
          */
         TYPE_TEST1(sp, T_NUMBER);
         sp->u.number = ~ sp->u.number;
-        break;
+        DISPATCH();
 
     CASE(F_AND);                    /* --- and                 --- */
     {
@@ -11740,7 +12458,7 @@ again:
             sp->u.vec = join_array(sp->u.vec, (sp+1)->u.vec);
         }
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_XOR);                    /* --- xor                 --- */
@@ -11770,7 +12488,7 @@ again:
             sp->u.vec = symmetric_diff_array(sp->u.vec, (sp+1)->u.vec);
         }
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_LSH);                    /* --- lsh                 --- */
@@ -11791,7 +12509,7 @@ again:
         p_uint shift = sp->u.number;
         sp--;
         sp->u.number = shift > MAX_SHIFT ? 0 : sp->u.number << shift;
-        break;
+        DISPATCH();
     }
 
     CASE(F_RSH);                    /* --- rsh                 --- */
@@ -11816,7 +12534,7 @@ again:
             sp->u.number = 0;
         else
             sp->u.number = -1;
-        break;
+        DISPATCH();
     }
 
     CASE(F_RSHL);                   /* --- rshl                --- */
@@ -11839,7 +12557,7 @@ again:
             sp->u.number = 0;
         else
             sp->u.number = (p_uint)sp->u.number >> shift;
-        break;
+        DISPATCH();
     }
 
     CASE(F_NOT);                    /* --- not                 --- */
@@ -11857,7 +12575,7 @@ again:
         } else
             free_svalue(sp);
         put_number(sp, 0);
-        break;
+        DISPATCH();
 
     CASE(F_NX_RANGE);               /* --- nx_range            --- */
     CASE(F_RX_RANGE);               /* --- rx_range            --- */
@@ -12066,7 +12784,7 @@ again:
                     "expected string/array.\n", typename(sp[-2].type)
                     ));
         }
-        break;
+        DISPATCH();
       }
 
     CASE(F_ADD_EQ);                 /* --- add_eq              --- */
@@ -12125,7 +12843,7 @@ again:
 
                 len = mstrsize(left) + mstrsize(right);
                 DYN_STRING_COST(len)
-                new_string = mstr_add(left, right);
+                new_string = mstr_extend(left, get_txt(right), mstrsize(right));
                 if (!new_string)
                     ERRORF(("Out of memory (%zu bytes)\n", len));
                 free_string_svalue(sp-1);
@@ -12142,7 +12860,7 @@ again:
                     FATAL("Buffer overflow in F_ADD_EQ: int number too big.\n");
                 len = mstrsize(argp->u.str)+strlen(buff);
                 DYN_STRING_COST(len)
-                new_string = mstr_add_txt(argp->u.str, buff, strlen(buff));
+                new_string = mstr_extend(argp->u.str, buff, strlen(buff));
                 if (!new_string)
                     ERRORF(("Out of memory (%lu bytes)\n"
                            , (unsigned long) len
@@ -12160,7 +12878,7 @@ again:
                     FATAL("Buffer overflow in F_ADD_EQ: float number too big.\n");
                 len = mstrsize(argp->u.str) + strlen(buff);
                 DYN_STRING_COST(len)
-                new_string = mstr_add_txt(argp->u.str, buff, strlen(buff));
+                new_string = mstr_extend(argp->u.str, buff, strlen(buff));
                 if (!new_string)
                     ERRORF(("Out of memory (%zu bytes).\n", len));
                 sp -= 2;
@@ -12171,9 +12889,10 @@ again:
                 /* NOTREACHED */
             }
 
-            /* Replace *argp by the new string */
-            free_string_svalue(argp);
-            put_string(argp, new_string);
+            /* Replace *argp by the new string, mstr_extend() took over
+             * the reference of the old one.
+             */
+            argp->u.str = new_string;
             break;
           }
 
@@ -12338,7 +13057,7 @@ again:
                 inter_sp = sp;
                 inter_pc = pc;
                 DYN_ARRAY_COST(VEC_SIZE(u2.vec)+VEC_SIZE(argp->u.vec));
-                v = inter_add_array(u2.vec, &argp->u.vec);
+                v = inter_add_array(u2.vec, argp);
                 if (instruction == F_VOID_ADD_EQ)
                 {
                     sp -= 2;
@@ -12397,7 +13116,7 @@ again:
             sp++;
             assign_svalue_no_free(sp, argp);
         }
-        break;
+        DISPATCH();
     }
 
     CASE(F_SUB_EQ);                 /* --- sub_eq              --- */
@@ -12630,7 +13349,7 @@ again:
                         , argp->type);
             /* NOTREACHED */
         } /* end of switch */
-        break;
+        DISPATCH();
     }
 
     CASE(F_MULT_EQ);                /* --- mult_eq             --- */
@@ -12918,7 +13637,7 @@ again:
         OP_ARG_ERROR(1, TF_STRING|TF_FLOAT|TF_POINTER|TF_NUMBER
                     , argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_DIV_EQ);                 /* --- div_eq              --- */
@@ -13238,7 +13957,7 @@ again:
 
         OP_ARG_ERROR(1, TF_NUMBER|TF_STRING|TF_POINTER, argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_OR_EQ);                  /* --- or_eq               --- */
@@ -13314,7 +14033,7 @@ again:
 
         OP_ARG_ERROR(1, TF_NUMBER|TF_POINTER, argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_XOR_EQ);                 /* --- xor_eq              --- */
@@ -13391,7 +14110,7 @@ again:
 
         OP_ARG_ERROR(1, TF_NUMBER|TF_POINTER, argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_LSH_EQ);                 /* --- lsh_eq              --- */
@@ -13449,7 +14168,7 @@ again:
 
         OP_ARG_ERROR(1, TF_NUMBER, argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     CASE(F_RSH_EQ);                 /* --- rsh_eq              --- */
@@ -13565,7 +14284,7 @@ again:
 
         OP_ARG_ERROR(1, TF_NUMBER, argp->type);
         /* NOTREACHED */
-        break;
+        DISPATCH();
     }
 
     /* --- Machine internal instructions --- */
@@ -13575,7 +14294,7 @@ again:
          * Simple, huh?
          */
         pop_stack();
-        break;
+        DISPATCH();
 
     CASE(F_POP_SECOND);             /* --- pop_second          --- */
         /* Pop the value under the topmost value and put the
@@ -13583,14 +14302,14 @@ again:
          */
         free_svalue(--sp);
         *sp = sp[1];
-        break;
+        DISPATCH();
 
     CASE(F_DUP);                    /* --- dup                 --- */
         /* Push a duplicate of sp[0] onto the stack.
          */
         sp++;
         assign_svalue_no_free(sp, sp-1);
-        break;
+        DISPATCH();
 
     CASE(F_LDUP);                   /* --- ldup                --- */
       {
@@ -13602,7 +14321,7 @@ again:
         while (svp->type == T_LVALUE || svp->type == T_PROTECTED_LVALUE)
             svp = svp->u.lvalue;
         assign_svalue_no_free(sp, svp);
-        break;
+        DISPATCH();
       }
 
     CASE(F_SWAP_VALUES);            /* --- swap_values         --- */
@@ -13612,7 +14331,7 @@ again:
         svalue_t sv = sp[0];
         sp[0] = sp[-1];
         sp[-1] = sv;
-        break;
+        DISPATCH();
       }
 
     CASE(F_CLEAR_LOCALS);    /* --- clear_locals <first> <num> --- */
@@ -13632,7 +14351,7 @@ again:
             free_svalue(plocal);
             *plocal = const0;
         }
-        break;
+        DISPATCH();
       }
 
     CASE(F_SAVE_ARG_FRAME);         /* --- save_arg_frame      --- */
@@ -13645,7 +14364,7 @@ again:
         sp->type = T_INVALID;
         sp->u.lvalue = ap;
         ap = sp+1;
-        break;
+        DISPATCH();
       }
 
     CASE(F_RESTORE_ARG_FRAME);      /* --- restore_arg_frame   --- */
@@ -13657,7 +14376,7 @@ again:
         ap = sp[-1].u.lvalue;
         sp[-1] = sp[0];
         sp--;
-        break;
+        DISPATCH();
       }
 
     CASE(F_USE_ARG_FRAME);          /* --- use_arg_frame       --- */
@@ -13675,7 +14394,7 @@ again:
             fatal("Previous use_arg_frame hasn't been consumed.\n");
 #endif
         use_ap = MY_TRUE;
-        break;
+        DISPATCH();
       }
 
     CASE(F_FLATTEN_XARG);           /* --- flatten_xarg        --- */
@@ -13743,7 +14462,7 @@ again:
 
             sp--; /* undo the last extraneous sp++ */
         }
-        break;
+        DISPATCH();
       }
 
     CASE(F_FBRANCH);                /* --- fbranch <offset>    --- */
@@ -13753,7 +14472,7 @@ again:
          */
 
         pc += get_bc_offset(pc);
-        break;
+        DISPATCH();
     }
 
     CASE(F_LBRANCH);                /* --- lbranch <offset>    --- */
@@ -13762,8 +14481,12 @@ again:
          * The <offset> is counted from its first byte (TODO: Ugh).
          */
 
-        pc += get_bc_shortoffset(pc);
-        break;
+        bc_shortoffset_t offset = get_bc_shortoffset(pc);
+
+        pc += offset;
+        if (offset < 0)
+            JIT_LOOP();
+        DISPATCH();
     }
 
     CASE(F_LBRANCH_WHEN_ZERO); /* --- lbranch_when_zero <offset> --- */
@@ -13775,13 +14498,17 @@ again:
 
         if (sp->type == T_NUMBER && sp->u.number == 0)
         {
-            pc += get_bc_shortoffset(pc);
+            bc_shortoffset_t offset = get_bc_shortoffset(pc);
+
+            pc += offset;
             sp--;
+            if (offset < 0)
+                JIT_LOOP();
             break;
         }
         pc += sizeof(bc_shortoffset_t);
         pop_stack();
-        break;
+        DISPATCH();
     }
 
     CASE(F_LBRANCH_WHEN_NON_ZERO); /* --- lbranch_when_non_zero <offset> --- */
@@ -13793,13 +14520,17 @@ again:
 
         if (sp->type != T_NUMBER || sp->u.number != 0)
         {
-            pc += get_bc_shortoffset(pc);
+            bc_shortoffset_t offset = get_bc_shortoffset(pc);
+
+            pc += offset;
             pop_stack();
+            if (offset < 0)
+                JIT_LOOP();
             break;
         }
         pc += sizeof(bc_shortoffset_t);
         sp--;
-        break;
+        DISPATCH();
     }
 
     CASE(F_BRANCH);                 /* --- branch <offset>     --- */
@@ -13809,7 +14540,7 @@ again:
          */
 
         pc += get_uint8(pc) + sizeof(bytecode_t);
-        break;
+        DISPATCH();
     }
 
     CASE(F_BRANCH_WHEN_ZERO); /* --- branch_when_zero <offset> --- */
@@ -13862,7 +14593,7 @@ again:
         }
         sp--;
         pc += GET_UINT8(pc) + sizeof(bytecode_t);
-        break;
+        DISPATCH();
     }
 
     CASE(F_BBRANCH_WHEN_ZERO);  /* --- bbranch_when_zero <offset> --- */
@@ -13876,11 +14607,12 @@ again:
         {
             sp--;
             pc -= GET_UINT8(pc);
+            JIT_LOOP();
             break;
         }
         pc += sizeof(bytecode_t);
         pop_stack();
-        break;
+        DISPATCH();
     }
     CASE(F_BBRANCH_WHEN_NON_ZERO); /* --- branch_when_non_zero <offset> --- */
     {
@@ -13902,7 +14634,8 @@ again:
             free_svalue(sp);
         sp--;
         pc -= GET_UINT8(pc);
-        break;
+        JIT_LOOP();
+        DISPATCH();
     }
 
     CASE(F_CALL_FUNCTION)         /* --- call_function <index> --- */
@@ -14004,7 +14737,7 @@ again:
         pc = funstart;
         csp->extern_call = MY_FALSE;
 
-        break;
+        DISPATCH();
     }
 
                    /* --- call_inherited        <prog> <index> --- */
@@ -14094,7 +14827,7 @@ again:
         current_variables += variable_index_offset;
         current_strings = current_prog->strings;
         csp->extern_call = MY_FALSE;
-        break;
+        DISPATCH();
     }
 
     CASE(F_CALL_CLOSURE); /* --- call_closure --- */
@@ -14144,7 +14877,7 @@ again:
             push_number(sp, 0);
         }
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_CONTEXT_IDENTIFIER);  /* --- context_identifier <var_ix> --- */
@@ -14164,7 +14897,7 @@ again:
 
         sp++;
         assign_checked_svalue_no_free(sp, inter_context+LOAD_UINT8(pc));
-        break;
+        DISPATCH();
 
                                /* --- context_identifier16 <var_ix> --- */
     CASE(F_CONTEXT_IDENTIFIER16);
@@ -14188,7 +14921,7 @@ again:
         LOAD_SHORT(var_index, pc);
         sp++;
         assign_checked_svalue_no_free(sp, inter_context+var_index);
-        break;
+        DISPATCH();
      }
 
     CASE(F_PUSH_CONTEXT_LVALUE);   /* --- push_context_lvalue <num> --- */
@@ -14207,7 +14940,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = inter_context + LOAD_UINT8(pc);
-        break;
+        DISPATCH();
 
                                  /* --- push_context16_lvalue <num> --- */
     CASE(F_PUSH_CONTEXT16_LVALUE);
@@ -14230,7 +14963,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = inter_context + var_index;
-        break;
+        DISPATCH();
       }
 
     CASE(F_PUSH_IDENTIFIER_LVALUE);  /* --- push_identifier_lvalue <num> --- */
@@ -14243,7 +14976,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = find_value((int)(LOAD_UINT8(pc) ));
-        break;
+        DISPATCH();
 
     CASE(F_VIRTUAL_VARIABLE);         /* --- virtual_variable <num> --- */
         /* Push the virtual object-global variable <num> onto the stack.
@@ -14257,7 +14990,7 @@ again:
         assign_checked_svalue_no_free(sp
                                      , find_virtual_value((int)(LOAD_UINT8(pc)))
         );
-        break;
+        DISPATCH();
 
                           /* --- push_virtual_variable_lvalue <num> --- */
     CASE(F_PUSH_VIRTUAL_VARIABLE_LVALUE);
@@ -14270,7 +15003,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = find_virtual_value((int)(LOAD_UINT8(pc) ));
-        break;
+        DISPATCH();
 
     CASE(F_IDENTIFIER16);         /* --- identifier16 <var_ix> --- */
     {
@@ -14285,7 +15018,7 @@ again:
         LOAD_SHORT(var_index, pc);
         sp++;
         assign_checked_svalue_no_free(sp, find_value((int)var_index));
-        break;
+        DISPATCH();
     }
 
                        /* --- push_identifier16_lvalue <var_ix> --- */
@@ -14303,7 +15036,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = find_value((int)var_index);
-        break;
+        DISPATCH();
     }
                          /* --- push_local_variable_lvalue <num> --- */
     CASE(F_PUSH_LOCAL_VARIABLE_LVALUE);
@@ -14314,7 +15047,7 @@ again:
         sp++;
         sp->type = T_LVALUE;
         sp->u.lvalue = fp + LOAD_UINT8(pc);
-        break;
+        DISPATCH();
 
     CASE(F_PUSH_INDEXED_S_LVALUE); /* --- push_indexed_s_lvalue --- */
         /* Op. (struct v=sp[-2], mixed i=sp[-1], short idx=sp[0])
@@ -14330,7 +15063,7 @@ again:
 
         sp = check_struct_op(sp, 0, -2, -1, pc, NULL);
         sp = push_indexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_PUSH_INDEXED_LVALUE);    /* --- push_indexed_lvalue --- */
         /* Operator F_PUSH_INDEXED_LVALUE(vector  v=sp[-1], int   i=sp[0])
@@ -14356,7 +15089,7 @@ again:
             }
         }
         sp = push_indexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_PUSH_RINDEXED_LVALUE);   /* --- push_rindexed_lvalue --- */
         /* Operator F_PUSH_RINDEXED_LVALUE(vector v=sp[-1], int i=sp[0])
@@ -14367,7 +15100,7 @@ again:
          */
 
         sp = push_rindexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_PUSH_AINDEXED_LVALUE);   /* --- push_aindexed_lvalue --- */
         /* Operator F_PUSH_AINDEXED_LVALUE(vector v=sp[-1], int i=sp[0])
@@ -14378,7 +15111,7 @@ again:
          */
 
         sp = push_aindexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_INDEX_S_LVALUE);         /* --- index_s_lvalue     --- */
         /* Op. (struct &v=sp[0], int i=sp[-2], short * idx=sp[-1])
@@ -14393,7 +15126,7 @@ again:
 
         sp = check_struct_op(sp, -1, 1, -2, pc, NULL);
         sp = index_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_INDEX_LVALUE);           /* --- index_lvalue       --- */
         /* Operator F_INDEX_LVALUE (string|vector &v=sp[0], int   i=sp[-1])
@@ -14421,7 +15154,7 @@ again:
             }
         }
         sp = index_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_RINDEX_LVALUE);          /* --- rindex_lvalue      --- */
         /* Operator F_RINDEX_LVALUE (string|vector &v=sp[0], int   i=sp[-1])
@@ -14434,7 +15167,7 @@ again:
          */
 
         sp = rindex_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_AINDEX_LVALUE);          /* --- aindex_lvalue      --- */
         /* Operator F_AINDEX_LVALUE (string|vector &v=sp[0], int   i=sp[-1])
@@ -14447,7 +15180,7 @@ again:
          */
 
         sp = aindex_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_S_INDEX);                /* --- s_index            --- */
     {
@@ -14465,7 +15198,7 @@ again:
         bool ignore_error = false;
         sp = check_struct_op(sp, 0, -2, -1, pc, &ignore_error);
         sp = push_indexed_value(sp, pc, ignore_error);
-        break;
+        DISPATCH();
     }
 
     CASE(F_INDEX);                  /* --- index              --- */
@@ -14487,7 +15220,7 @@ again:
             /* NOTREACHED */
         }
         sp = push_indexed_value(sp, pc, false);
-        break;
+        DISPATCH();
 
     CASE(F_RINDEX);                 /* --- rindex              --- */
         /* Operator F_RINDEX (string|vector v=sp[0], int   i=sp[-1])
@@ -14498,7 +15231,7 @@ again:
          */
 
         sp = push_rindexed_value(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_AINDEX);                 /* --- aindex              --- */
         /* Operator F_AINDEX (string|vector v=sp[0], int   i=sp[-1])
@@ -14509,7 +15242,7 @@ again:
          */
 
         sp = push_aindexed_value(sp, pc);
-        break;
+        DISPATCH();
 
     CASE(F_RANGE_LVALUE);           /* --- range_lvalue        --- */
         /* Operator F_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14526,7 +15259,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(NN_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_NR_RANGE_LVALUE);           /* --- nr_range_lvalue     --- */
         /* Operator F_NR_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14540,7 +15273,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(NR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_RN_RANGE_LVALUE);           /* --- rn_range_lvalue     --- */
         /* Operator F_RN_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14554,7 +15287,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(RN_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_RR_RANGE_LVALUE);           /* --- rr_range_lvalue     --- */
         /* Operator F_RR_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14568,7 +15301,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(RR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_NA_RANGE_LVALUE);           /* --- na_range_lvalue     --- */
         /* Operator F_NA_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14582,7 +15315,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(NA_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_AN_RANGE_LVALUE);           /* --- an_range_lvalue     --- */
         /* Operator F_AN_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14596,7 +15329,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(AN_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_RA_RANGE_LVALUE);           /* --- ra_range_lvalue     --- */
         /* Operator F_RA_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14610,7 +15343,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(RA_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_AR_RANGE_LVALUE);           /* --- ar_range_lvalue     --- */
         /* Operator F_AR_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14624,7 +15357,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(AR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_AA_RANGE_LVALUE);           /* --- aa_range_lvalue     --- */
         /* Operator F_AA_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14638,7 +15371,7 @@ again:
 
         inter_pc = pc;
         sp = range_lvalue(AA_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_NX_RANGE_LVALUE);           /* --- nx_range_lvalue     --- */
         /* Operator F_NX_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14658,7 +15391,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = range_lvalue(NR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_RX_RANGE_LVALUE);           /* --- rx_range_lvalue     --- */
         /* Operator F_RX_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14678,7 +15411,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = range_lvalue(RR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_AX_RANGE_LVALUE);           /* --- ax_range_lvalue     --- */
         /* Operator F_AX_RANGE_LVALUE (string|vector &v=sp[0]
@@ -14698,7 +15431,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = range_lvalue(AR_RANGE, sp);
-        break;
+        DISPATCH();
 
                         /* --- push_protected_indexed_s_lvalue --- */
     CASE(F_PUSH_PROTECTED_INDEXED_S_LVALUE);
@@ -14715,7 +15448,7 @@ again:
 
         sp = check_struct_op(sp, 0, 3, -1, pc, NULL);
         sp = push_protected_indexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                           /* --- push_protected_indexed_lvalue --- */
     CASE(F_PUSH_PROTECTED_INDEXED_LVALUE);
@@ -14735,7 +15468,7 @@ again:
             /* NOTREACHED */
         }
         sp = push_protected_indexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                          /* --- push_protected_rindexed_lvalue --- */
     CASE(F_PUSH_PROTECTED_RINDEXED_LVALUE);
@@ -14747,7 +15480,7 @@ again:
          */
 
         sp = push_protected_rindexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                          /* --- push_protected_aindexed_lvalue --- */
     CASE(F_PUSH_PROTECTED_AINDEXED_LVALUE);
@@ -14759,7 +15492,7 @@ again:
          */
 
         sp = push_protected_aindexed_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                       /* --- push_protected_indexed_map_lvalue --- */
     CASE(F_PUSH_PROTECTED_INDEXED_MAP_LVALUE);
@@ -14771,7 +15504,7 @@ again:
          */
 
         push_protected_indexed_map_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                                /* --- protected_index_s_lvalue --- */
     CASE(F_PROTECTED_INDEX_S_LVALUE);
@@ -14788,7 +15521,7 @@ again:
 
         sp = check_struct_op(sp, -1, 1, -2, pc, NULL);
         sp = protected_index_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                                  /* --- protected_index_lvalue --- */
     CASE(F_PROTECTED_INDEX_LVALUE);
@@ -14816,7 +15549,7 @@ again:
             /* NOTREACHED */
         }
         sp = protected_index_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                                 /* --- protected_rindex_lvalue --- */
     CASE(F_PROTECTED_RINDEX_LVALUE);
@@ -14836,7 +15569,7 @@ again:
          */
 
         sp = protected_rindex_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                                 /* --- protected_aindex_lvalue --- */
     CASE(F_PROTECTED_AINDEX_LVALUE);
@@ -14856,7 +15589,7 @@ again:
          */
 
         sp = protected_aindex_lvalue(sp, pc);
-        break;
+        DISPATCH();
 
                               /* --- protected_range_lvalue --- */
     CASE(F_PROTECTED_RANGE_LVALUE);
@@ -14875,7 +15608,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(NN_RANGE, sp);
-        break;
+        DISPATCH();
 
                            /* --- protected_nr_range_lvalue --- */
     CASE(F_PROTECTED_NR_RANGE_LVALUE);
@@ -14894,7 +15627,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(NR_RANGE, sp);
-        break;
+        DISPATCH();
 
                              /* --- protected_rn_range_lvalue --- */
     CASE(F_PROTECTED_RN_RANGE_LVALUE);
@@ -14913,7 +15646,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(RN_RANGE, sp);
-        break;
+        DISPATCH();
 
                              /* --- protected_rr_range_lvalue --- */
     CASE(F_PROTECTED_RR_RANGE_LVALUE);
@@ -14932,7 +15665,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(RR_RANGE, sp);
-        break;
+        DISPATCH();
 
                            /* --- protected_na_range_lvalue --- */
     CASE(F_PROTECTED_NA_RANGE_LVALUE);
@@ -14951,7 +15684,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(NA_RANGE, sp);
-        break;
+        DISPATCH();
 
                              /* --- protected_an_range_lvalue --- */
     CASE(F_PROTECTED_AN_RANGE_LVALUE);
@@ -14970,7 +15703,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(AN_RANGE, sp);
-        break;
+        DISPATCH();
 
                            /* --- protected_ra_range_lvalue --- */
     CASE(F_PROTECTED_RA_RANGE_LVALUE);
@@ -14989,7 +15722,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(RA_RANGE, sp);
-        break;
+        DISPATCH();
 
                              /* --- protected_ar_range_lvalue --- */
     CASE(F_PROTECTED_AR_RANGE_LVALUE);
@@ -15008,7 +15741,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(AR_RANGE, sp);
-        break;
+        DISPATCH();
 
                              /* --- protected_aa_range_lvalue --- */
     CASE(F_PROTECTED_AA_RANGE_LVALUE);
@@ -15027,7 +15760,7 @@ again:
 
         inter_pc = pc;
         sp = protected_range_lvalue(AA_RANGE, sp);
-        break;
+        DISPATCH();
 
                               /* --- protected_nx_range_lvalue --- */
     CASE(F_PROTECTED_NX_RANGE_LVALUE);
@@ -15053,7 +15786,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = protected_range_lvalue(NR_RANGE, sp);
-        break;
+        DISPATCH();
 
                           /* --- protected_rx_range_lvalue --- */
     CASE(F_PROTECTED_RX_RANGE_LVALUE);
@@ -15079,7 +15812,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = protected_range_lvalue(RR_RANGE, sp);
-        break;
+        DISPATCH();
 
                           /* --- protected_ax_range_lvalue --- */
     CASE(F_PROTECTED_AX_RANGE_LVALUE);
@@ -15105,7 +15838,7 @@ again:
         sp[0] = sp[-1];       /* Pull up the 'v' */
         put_number(sp-1, 1);  /* 'Push' the 1 for the upper bound */
         sp = protected_range_lvalue(AR_RANGE, sp);
-        break;
+        DISPATCH();
 
     CASE(F_SIMUL_EFUN);             /* --- simul_efun <code>   --- */
     {
@@ -15252,7 +15985,7 @@ again:
         /*
          * The result of the function call is on the stack.
          */
-        break;
+        DISPATCH();
     }
 
 #ifdef USE_PYTHON
@@ -15278,7 +16011,7 @@ again:
         /*
          * The result of the function call is on the stack.
          */
-        break;
+        DISPATCH();
     }
 #endif /* USE_PYTHON */
 
@@ -15318,7 +16051,7 @@ again:
 
         /* Leave the array on the stack (ref count is already ok) */
         put_array(sp, v);
-        break;
+        DISPATCH();
     }
 
     CASE(F_M_AGGREGATE);     /* --- m_aggregate <size> <width> --- */
@@ -15396,7 +16129,7 @@ again:
 
         /* Put the mapping onto the stack */
         put_mapping(sp, m);
-        break;
+        DISPATCH();
     }
 
     CASE(F_S_AGGREGATE);
@@ -15496,7 +16229,7 @@ again:
         sp++;
         put_struct(sp, st);
 
-        break;
+        DISPATCH();
    }
 
     CASE(F_PREVIOUS_OBJECT0);       /* --- previous_object0    --- */
@@ -15515,7 +16248,7 @@ again:
             push_number(sp, 0);
         else
             push_ref_object(sp, previous_ob, "previous_object0");
-        break;
+        DISPATCH();
 
     CASE(F_LAMBDA_CCONSTANT);    /* --- lambda_cconstant <num> --- */
     {
@@ -15537,7 +16270,7 @@ again:
                                    - LAMBDA_VALUE_OFFSET);
         sp++;
         assign_checked_svalue_no_free(sp, cstart - ix);
-        break;
+        DISPATCH();
     }
 
     CASE(F_LAMBDA_CONSTANT);     /* --- lambda_constant <num> --- */
@@ -15560,7 +16293,7 @@ again:
                                    - LAMBDA_VALUE_OFFSET);
         sp++;
         assign_checked_svalue_no_free(sp, cstart - ix);
-        break;
+        DISPATCH();
     }
 
     CASE(F_MAP_INDEX);              /* --- map_index           --- */
@@ -15610,7 +16343,7 @@ again:
             assign_checked_svalue_no_free(sp, data + n);
         }
         free_mapping(m);
-        break;
+        DISPATCH();
     }
 
     CASE(F_PUSH_INDEXED_MAP_LVALUE); /* --- push_indexed_map_lvalue --- */
@@ -15670,7 +16403,7 @@ again:
             sp->u.lvalue = data + n;
         }
         free_mapping(m);
-        break;
+        DISPATCH();
     }
 
     CASE(F_FOREACH);       /* --- foreach     <nargs> <offset> --- */
@@ -15906,7 +16639,7 @@ again:
         /* Now branch to the FOREACH_NEXT */
         pc += offset;
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_FOREACH_NEXT);         /* --- foreach_next <offset> --- */
@@ -16138,7 +16871,7 @@ again:
 
         /* All that is left is to branch back. */
         pc -= offset;
-        break;
+        DISPATCH();
     }
 
     CASE(F_FOREACH_END);            /* --- foreach_end         --- */
@@ -16166,7 +16899,7 @@ again:
         csp->num_local_variables -= nargs;
 #endif
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_END_CATCH);                  /* --- end_catch       --- */
@@ -16184,7 +16917,7 @@ again:
          */
 
         return MY_TRUE;
-        break;
+        DISPATCH();
 
                           /* --- breakn_continue <num> <offset> ---*/
     CASE(F_BREAKN_CONTINUE);
@@ -16211,7 +16944,7 @@ again:
          */
         break_sp++;
         pc += get_bc_offset(pc);
-        break;
+        DISPATCH();
     }
 
 #ifdef F_JUMP
@@ -16221,7 +16954,7 @@ again:
          */
 
         pc = current_prog->program + get_bc_offset(pc);
-        break;
+        DISPATCH();
     }
 #endif /* F_JUMP */
 
@@ -16256,7 +16989,7 @@ again:
         LOAD_SHORT(size, pc);
         v = allocate_array(size);
         push_array(sp, v);
-        break;
+        DISPATCH();
     }
 
     CASE(F_MOVE_VALUE);             /* --- move_value <offset>  --- */
@@ -16277,7 +17010,7 @@ again:
             ap = sp+i+1;
         else if (ap > sp+i)
             ap++;
-        break;
+        DISPATCH();
     }
 
     CASE(F_DUP_N);                  /* --- dup_n <offset> <num>  --- */
@@ -16294,7 +17027,7 @@ again:
         inter_sp = sp;
         push_svalue_block(num, sp-offset-num+1);
         sp = inter_sp;
-        break;
+        DISPATCH();
     }
 
     CASE(F_POP_N);                  /* --- pop_n <num>  --- */
@@ -16303,7 +17036,7 @@ again:
          */
 
         pop_n_elems(LOAD_UINT8(pc));
-        break;
+        DISPATCH();
     }
 
     CASE(F_PUT_ARRAY_ELEMENT); /* --- put_array_element <offset> <ix>  --- */
@@ -16327,7 +17060,7 @@ again:
 
         transfer_svalue_no_free(sp[-offset-1].u.vec->item+ix, sp);
         sp--;
-        break;
+        DISPATCH();
     }
 
     /* --- Efuns: Miscellaneous --- */
@@ -16365,7 +17098,7 @@ again:
             i = 0;
         free_svalue(sp);
         put_number(sp, i ? 1 : 0);
-        break;
+        DISPATCH();
     }
 
     CASE(F_CLOSUREP);               /* --- closurep            --- */
@@ -16382,7 +17115,7 @@ again:
         i = sp->type == T_CLOSURE;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_FLOATP);                 /* --- floatp              --- */
@@ -16399,7 +17132,7 @@ again:
         i = sp->type == T_FLOAT;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_INTP);                   /* --- intp                --- */
@@ -16416,7 +17149,7 @@ again:
         i = sp->type == T_NUMBER;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_MAPPINGP);               /* --- mappingp            --- */
@@ -16433,7 +17166,7 @@ again:
         i = sp->type == T_MAPPING;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_OBJECTP);                /* --- objectp              --- */
@@ -16450,7 +17183,7 @@ again:
         i = sp->type == T_OBJECT;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_POINTERP);               /* --- pointerp            --- */
@@ -16467,7 +17200,7 @@ again:
         i = sp->type == T_POINTER;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_REFERENCEP);                /* --- referencep      --- */
@@ -16485,7 +17218,7 @@ again:
         i = (sp->type == T_LVALUE && sp->u.lvalue->type == T_LVALUE);
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
       }
 
     CASE(F_STRINGP);                /* --- stringp             --- */
@@ -16502,7 +17235,7 @@ again:
         i = sp->type == T_STRING;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_STRUCTP);                /* --- structp             --- */
@@ -16519,7 +17252,7 @@ again:
         i = sp->type == T_STRUCT;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_SYMBOLP);                /* --- symbolp             --- */
@@ -16536,7 +17269,7 @@ again:
         i = sp->type == T_SYMBOL;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
     }
 
     CASE(F_TYPEOF);                    /* --- typeof          --- */
@@ -16552,7 +17285,7 @@ again:
         mp_int i = sp->type;
         free_svalue(sp);
         put_number(sp, i);
-        break;
+        DISPATCH();
       }
 
     CASE(F_NEGATE);                 /* --- negate              --- */
@@ -16618,7 +17351,7 @@ again:
         inter_sp = --sp;
         inter_pc = pc;
         throw_error(sp+1); /* do the longjump, with extra checks... */
-        break;
+        DISPATCH();
 
     /* --- Efuns: Arrays and Mappings --- */
 
@@ -16682,6 +17415,7 @@ again:
 
     CASE(F_CALL_DIRECT);            /* --- call_direct         --- */
     CASE(F_CALL_OTHER);             /* --- call_other          --- */
+    CASE(F_CALL_OTHER_CACHED);      /* --- call_other_cached <ix> --- */
     {
         /* EFUN call_other(), call_direct()
          *
@@ -16708,6 +17442,10 @@ again:
          * is that the latter does not allow the evaluation of default
          * methods.
          *
+         * ob->fun() calls with a constant function name are compiled
+         * into call_other_cached, whose <ix> operand selects the
+         * inline cache of the call site in the current program.
+         *
          * TODO: A VOID_CALL_OTHER would be nice to have when the result
          * TODO:: is not used.
          */
@@ -16715,6 +17453,18 @@ again:
         svalue_t *arg;
         object_t *ob;
         Bool      b_use_default;
+        call_cache_t *site;
+
+        site = NULL;
+        if (instruction == F_CALL_OTHER_CACHED)
+        {
+            unsigned short ix;
+
+            LOAD_SHORT(ix, pc);
+            inter_pc = pc;
+            inter_sp = sp;
+            site = get_call_cache(current_prog, ix);
+        }
 
         num_arg = sp - ap + 1;
         inter_pc = pc;
@@ -16779,7 +17529,7 @@ again:
 
             /* Call the function with the remaining args on the stack.
              */
-            if (!int_apply(arg[1].u.str, ob, num_arg-2, MY_FALSE, b_use_default))
+            if (!int_apply(arg[1].u.str, ob, num_arg-2, MY_FALSE, b_use_default, site))
             {
                 /* Function not found */
                 if (b_use_default) /* int_apply() removed the args */
@@ -16899,7 +17649,7 @@ again:
                 /* Call the function with the remaining args on the stack.
                  */
                 inter_sp = sp; /* update to new setting */
-                if (!int_apply(arg[1].u.str, ob, num_arg-2, MY_FALSE, b_use_default))
+                if (!int_apply(arg[1].u.str, ob, num_arg-2, MY_FALSE, b_use_default, site))
                 {
                     /* Function not found, Assign 0 as result.
                      */
@@ -16929,7 +17679,7 @@ again:
             free_string_svalue(sp); sp--;
         }
 
-        break;
+        DISPATCH();
     }
 
     CASE(F_EXTERN_CALL);               /* --- extern_call     --- */
@@ -16950,7 +17700,7 @@ again:
 
         while (pt->catch_call) pt--;
         push_number(sp, (pt->extern_call & ~CS_PRETEND) ? 1 : 0);
-        break;
+        DISPATCH();
       }
 
     /* --- Efuns: Objects --- */
@@ -16978,7 +17728,7 @@ again:
             put_ref_object(sp, master_ob, "master");
         else
             put_number(sp, 0);
-        break;
+        DISPATCH();
      }
 
     CASE(F_THIS_INTERACTIVE);       /* --- this_interactive    --- */
@@ -16995,7 +17745,7 @@ again:
             push_ref_object(sp, current_interactive, "this_interactive");
         else
             push_number(sp, 0);
-        break;
+        DISPATCH();
 
     CASE(F_THIS_OBJECT);            /* --- this_object         --- */
         /* EFUN this_object()
@@ -17011,7 +17761,7 @@ again:
             break;
         }
         push_ref_object(sp, current_object, "this_object");
-        break;
+        DISPATCH();
 
     /* --- Efuns: Verbs and Commands --- */
 
@@ -17031,7 +17781,7 @@ again:
             push_ref_object(sp, command_giver, "this_player");
         else
             push_number(sp, 0);
-        break;
+        DISPATCH();
 
     /* --- Optional Efuns: Technical --- */
 
@@ -17049,7 +17799,7 @@ again:
 
         if (sp - fp - csp->num_local_variables + 1 != 0)
             fatal("Bad stack pointer.\n");
-        break;
+        DISPATCH();
 #endif
 
 #ifdef F_SWAP
@@ -17080,12 +17830,15 @@ again:
                 (void)swap_variables(ob);
         }
         free_svalue(sp--);
-        break;
+        DISPATCH();
       }
 #endif
 
     } /* end of the monumental switch */
 
+#ifdef USE_COMPUTED_GOTO
+instruction_done:
+#endif
     /* Instruction executed */
 
     /* Reset the no-warn-deprecated flag */
@@ -17114,40 +17867,14 @@ again:
              );
     }
 
-#ifdef DEBUG
-    if (expected_stack && expected_stack != sp)
-    {
-        fatal( "Bad stack after evaluation.\n"
-               "sp: %p expected: %p\n"
-               "Instruction %d(%s), num arg %d\n"
-             , sp, expected_stack
-             , instruction, get_f_name(instruction), num_arg);
-    }
-
-    if (sp < fp + csp->num_local_variables - 1)
-    {
-        fatal( "Bad stack after evaluation.\n"
-               "sp: %p minimum expected: %p\n"
-               "Instruction %d(%s), num arg %d\n"
-             , sp, (fp + csp->num_local_variables - 1)
-             , instruction, get_f_name(instruction), num_arg);
-    }
-#endif /* DEBUG */
+    DEBUG_CHECK_STACK();
 
-    // Did we receive a SIGPROF signal and should dump a trace into the debuglog?
+    // Did we receive a SIGPROF signal to take a sample or to dump a trace
+    // into the debuglog?
     if (received_prof_signal)
     {
-        received_prof_signal = MY_FALSE;
-        char     *ts = time_stamp();
-        string_t *object_name = NULL;
-        debug_message("%s Received profiling signal, evaluation time > %ld.%06lds\n",
-                      ts, (long)profiling_timevalue.tv_sec, (long)profiling_timevalue.tv_usec);
-        printf("%s Received profiling signal, evaluation time > %ld.%06lds\n",
-                      ts, (long)profiling_timevalue.tv_sec, (long)profiling_timevalue.tv_usec);
-        // dump stack trace and continue execution
-        object_name = dump_trace(MY_FALSE, NULL, NULL);
-        debug_message("%s ... execution continues.\n", ts);
-        printf("%s ... execution continues.\n", ts);
+        inter_pc = pc;
+        handle_profiling_signals();
     }
     
     // Did we allocate too much memory in this execution/evaluation thread?
@@ -17164,6 +17891,34 @@ again:
 
     goto again;
 
+too_long_evaluation:
+  {
+    rt_context_t * context;
+
+    /* Evaluation too long. Restore some globals and throw
+     * an error.
+     */
+
+    printf("%s eval_cost too big %ld\n", time_stamp(), (long)eval_cost);
+
+    assign_eval_cost_inl();
+
+    /* If the error isn't caught, reset the eval costs */
+    for (context = rt_context
+        ; !ERROR_RECOVERY_CONTEXT(context->type)
+        ; context = context->last
+        ) NOOP;
+    if (context->type <= ERROR_RECOVERY_BACKEND)
+    {
+        CLEAR_EVAL_COST;
+        RESET_LIMITS;
+    }
+
+    inter_pc = pc;
+    inter_fp = fp;
+    ERROR("Too long evaluation. Execution aborted.\n");
+  }
+
     /* Get rid of the handy but highly local macros */
 #   undef GET_NUM_ARG
 #   undef RAISE_ARG_ERROR
@@ -17179,6 +17934,11 @@ again:
 #   undef TYPE_TEST_EXP_LEFT
 #   undef TYPE_TEST_EXP_RIGHT
 #   undef CASE
+#   undef DISPATCH
+#   undef TRACE_INSTRUCTION
+#   undef NOTE_INSTRUCTION
+#   undef DEBUG_EXPECT_STACK
+#   undef DEBUG_CHECK_STACK
 #   undef ARG_ERROR_TEMPL
 #   undef OP_ARG_ERROR_TEMPL
 #   undef TYPE_TEST_TEMPL
@@ -17187,10 +17947,25 @@ again:
 
 } /* eval_instruction() */
 
+/*-------------------------------------------------------------------------*/
+static INLINE void
+add_call_site_entry (call_cache_t *site, struct cache *ce)
+
+/* Add a copy of the apply cache entry <ce> as the newest entry to the
+ * call site cache <site>, dropping its oldest entry.
+ */
+
+{
+    memmove(site->entries+1, site->entries
+           , sizeof(site->entries) - sizeof(site->entries[0]));
+    site->entries[0] = *ce;
+    site->entries[0].name = NULL;
+} /* add_call_site_entry() */
+
 /*-------------------------------------------------------------------------*/
 static Bool
 apply_low ( string_t *fun, object_t *ob, int num_arg
-          , Bool b_ign_prot, Bool allowRefs)
+          , Bool b_ign_prot, Bool allowRefs, call_cache_t *site)
 
 /* The low-level implementation of function calls.
  *
@@ -17212,7 +17987,9 @@ apply_low ( string_t *fun, object_t *ob, int num_arg
  * to call an inherited function '::foo' with this function.
  *
  * To speed up the calls, apply_low() maintains a cache of earlier calls, both
- * hits and misses.
+ * hits and misses. If the call is made from a call_other site with an
+ * inline cache, <site> points to that cache and is consulted first;
+ * otherwise <site> is NULL.
  *
  * The function call will swap in the object and also unset its reset status.
  */
@@ -17220,7 +17997,8 @@ apply_low ( string_t *fun, object_t *ob, int num_arg
 {
     program_t *progp;
     struct control_stack *save_csp;
-    p_int ix;
+    struct cache *ce;
+    struct cache *set;
 
     /* This object will now be used, and is thus a target for
      * reset later on (when time due).
@@ -17281,32 +18059,96 @@ retry_for_shadow:
     }
     /* fun is now guaranteed to be a shared string */
 
-    /* Get the hashed index into the cache */
-    ix =
-      ( progp->id_number ^ (p_int)fun ^ ( (p_int)fun >> APPLY_CACHE_BITS ) )
-         & (CACHE_SIZE-1);
+    /* Check the inline cache of the call site first */
+    ce = NULL;
+    if (site != NULL)
+    {
+        int i;
+
+        if (site->generation != call_cache_generation)
+        {
+            memset(site->entries, 0, sizeof(site->entries));
+            site->generation = call_cache_generation;
+        }
+
+        for (i = 0; i < CALL_SITE_CACHE_ENTRIES; i++)
+        {
+            if (site->entries[i].id == progp->id_number)
+            {
+                ce = &site->entries[i];
+                break;
+            }
+        }
+#ifdef APPLY_CACHE_STAT
+        if (ce)
+        {
+            site->hits++;
+            call_site_cache_hit++;
+        }
+        else
+        {
+            site->misses++;
+            call_site_cache_miss++;
+        }
+#endif
+    }
+
+    /* Get the hashed set of the cache. The lowest bits of the name
+     * pointer are always 0 due to the alignment, so they are shifted out.
+     */
+    set = cache + APPLY_CACHE_WAYS *
+      ( ( progp->id_number ^ ((p_int)fun >> 4) ^ ( (p_int)fun >> APPLY_CACHE_BITS ) )
+         & apply_cache_set_mask);
 
     /* Check if we have an entry for this function call */
-    if (cache[ix].id == progp->id_number
-     && (cache[ix].name == fun || mstreq(cache[ix].name, fun))
-       )
+    if (ce == NULL)
     {
-        /* We have found a matching entry in the cache. The contents have
-         * to match, not only the pointers, because cache entries for
-         * functions not existant in _this_ object <ob> are stored as
-         * separately allocated copy, not as another ref to the shared
-         * string. Yet they shall be found here.
-         */
+        int i;
+
+        for (i = 0; i < APPLY_CACHE_WAYS; i++)
+        {
+            /* The contents of the name have to match, not only the
+             * pointers, because cache entries for functions not existant
+             * in _this_ object <ob> are stored as separately allocated
+             * copy, not as another ref to the shared string. Yet they
+             * shall be found here.
+             */
+            if (set[i].id == progp->id_number
+             && (set[i].name == fun || mstreq(set[i].name, fun))
+               )
+                break;
+        }
+
+        if (i < APPLY_CACHE_WAYS)
+        {
+            /* We have found a matching entry in the cache.
+             * Make it the most recently used one of its set.
+             */
 #ifdef APPLY_CACHE_STAT
-        apply_cache_hit++;
+            apply_cache_hit++;
 #endif
-        if (cache[ix].progp
+            if (i > 0)
+            {
+                struct cache tmp = set[i];
+
+                memmove(set+1, set, i * sizeof(*set));
+                set[0] = tmp;
+            }
+            ce = set;
+            if (site != NULL)
+                add_call_site_entry(site, ce);
+        }
+    }
+
+    if (ce != NULL)
+    {
+        if (ce->progp
           /* Static functions may not be called from outside.
            * Protected functions not even from the inside
            */
-          && (   !(cache[ix].flags & (TYPE_MOD_STATIC|TYPE_MOD_PROTECTED)) /* -> neither static nor protected */
+          && (   !(ce->flags & (TYPE_MOD_STATIC|TYPE_MOD_PROTECTED)) /* -> neither static nor protected */
               || b_ign_prot
-              || (   !(cache[ix].flags & TYPE_MOD_PROTECTED)
+              || (   !(ce->flags & TYPE_MOD_PROTECTED)
                   && current_object == ob
                  ) /* --> static but not protected, and caller is owner */
              )
@@ -17318,7 +18160,7 @@ retry_for_shadow:
             bytecode_p funstart;
             
             // check for deprecated functions before pushing a new control stack frame.
-            if (cache[ix].flags & TYPE_MOD_DEPRECATED)
+            if (ce->flags & TYPE_MOD_DEPRECATED)
                 warnf("Callother to deprecated function \'%s\' in object %s (%s).\n",
                       get_txt(fun), get_txt(ob->name), get_txt(ob->prog->name));
 
@@ -17326,24 +18168,24 @@ retry_for_shadow:
             csp->ob = current_object;
             csp->prev_ob = previous_ob;
             csp->num_local_variables = num_arg;
-            csp->funstart = funstart = cache[ix].funstart;
-            current_prog = cache[ix].progp;
+            csp->funstart = funstart = ce->funstart;
+            current_prog = ce->progp;
             current_strings = current_prog->strings;
-            function_index_offset = cache[ix].function_index_offset;
+            function_index_offset = ce->function_index_offset;
 #ifdef DEBUG
-            if (!ob->variables && cache[ix].variable_index_offset)
+            if (!ob->variables && ce->variable_index_offset)
                 fatal("%s Fatal: apply (cached) for object %p '%s' "
                       "w/o variables, but offset %d\n"
                      , time_stamp(), ob, get_txt(ob->name)
-                     , cache[ix].variable_index_offset);
+                     , ce->variable_index_offset);
 #endif
             current_variables = ob->variables;
             if (current_variables)
-                current_variables += cache[ix].variable_index_offset;
+                current_variables += ce->variable_index_offset;
             inter_sp = setup_new_frame2(funstart, inter_sp, allowRefs, MY_FALSE);
                         
             // check argument types
-            check_function_args(cache[ix].progp->function_headers[FUNCTION_HEADER_INDEX(funstart)].offset.fx, cache[ix].progp, funstart);
+            check_function_args(ce->progp->function_headers[FUNCTION_HEADER_INDEX(funstart)].offset.fx, ce->progp, funstart);
             
             previous_ob = current_object;
             current_object = ob;
@@ -17399,11 +18241,9 @@ retry_for_shadow:
                    */
                 csp->ob = current_object;
                 csp->prev_ob = previous_ob;
-                if (cache[ix].name)
-                    free_mstring(cache[ix].name);
-
-                cache[ix].id = progp->id_number;
-                cache[ix].name = ref_mstring(fun);
+                ce = new_apply_cache_entry(set);
+                ce->id = progp->id_number;
+                ce->name = ref_mstring(fun);
 
                 csp->num_local_variables = num_arg;
                 current_prog = progp;
@@ -17411,9 +18251,9 @@ retry_for_shadow:
                 
                 current_strings = current_prog->strings;
 
-                cache[ix].progp = current_prog;
-                cache[ix].function_index_offset = function_index_offset;
-                cache[ix].variable_index_offset = variable_index_offset;
+                ce->progp = current_prog;
+                ce->function_index_offset = function_index_offset;
+                ce->variable_index_offset = variable_index_offset;
 
 #ifdef DEBUG
                 if (!ob->variables && variable_index_offset)
@@ -17427,15 +18267,17 @@ retry_for_shadow:
                     current_variables += variable_index_offset;
                 funstart = current_prog->program + (flags & FUNSTART_MASK);
 
-                cache[ix].funstart = funstart;
-                cache[ix].flags = progp->functions[fx]
+                ce->funstart = funstart;
+                ce->flags = progp->functions[fx]
                                   & (TYPE_MOD_STATIC|TYPE_MOD_PROTECTED|TYPE_MOD_DEPRECATED);
+                if (site != NULL)
+                    add_call_site_entry(site, ce);
 
                 /* Static functions may not be called from outside,
                  * Protected functions not even from the inside.
                  */
-                if (0 != (cache[ix].flags & (TYPE_MOD_STATIC|TYPE_MOD_PROTECTED))
-                  && (   (cache[ix].flags & TYPE_MOD_PROTECTED)
+                if (0 != (ce->flags & (TYPE_MOD_STATIC|TYPE_MOD_PROTECTED))
+                  && (   (ce->flags & TYPE_MOD_PROTECTED)
                       || current_object != ob)
                   && !b_ign_prot
                     )
@@ -17480,12 +18322,12 @@ retry_for_shadow:
 
         /* We have to mark this function as non-existant in this object. */
 
-        if (cache[ix].name)
-            free_mstring(cache[ix].name);
-
-        cache[ix].id = progp->id_number;
-        cache[ix].name = ref_mstring(fun);
-        cache[ix].progp = NULL;
+        ce = new_apply_cache_entry(set);
+        ce->id = progp->id_number;
+        ce->name = ref_mstring(fun);
+        ce->progp = NULL;
+        if (site != NULL)
+            add_call_site_entry(site, ce);
     }
 
     /* At this point, the function was not found in the object. But
@@ -17511,7 +18353,7 @@ failure2:
 /*-------------------------------------------------------------------------*/
 static int
 int_apply (string_t *fun, object_t *ob, int num_arg
-          , Bool b_ign_prot, Bool b_use_default
+          , Bool b_ign_prot, Bool b_use_default, call_cache_t *site
           )
 
 /* The wrapper around apply_low() to handle default methods.
@@ -17522,6 +18364,7 @@ int_apply (string_t *fun, object_t *ob, int num_arg
  * int_apply() takes care of calling shadows where necessary.
  * If <b_use_default> is true and the function call can't be resolved,
  * the function will try to call the default method if one is defined.
+ * <site> is the inline cache of the calling call_other site, or NULL.
  *
  * Results:
  *   APPLY_NOT_FOUND (0): The function was not found (and neither a default
@@ -17544,7 +18387,7 @@ int_apply (string_t *fun, object_t *ob, int num_arg
  */
 
 {
-    if (apply_low(fun, ob, num_arg, b_ign_prot, MY_FALSE))
+    if (apply_low(fun, ob, num_arg, b_ign_prot, MY_FALSE, site))
         return APPLY_FOUND;
 
     if (b_use_default)
@@ -17586,7 +18429,7 @@ int_apply (string_t *fun, object_t *ob, int num_arg
             /* Call the function */
             if (hook->type == T_STRING)
             {
-                rc = apply_low(hook->u.str, ob, num_arg+num_extra, b_ign_prot, MY_TRUE);
+                rc = apply_low(hook->u.str, ob, num_arg+num_extra, b_ign_prot, MY_TRUE, NULL);
             }
             else /* hook->type == T_CLOSURE */
             {
@@ -17705,7 +18548,7 @@ sapply_int (string_t *fun, object_t *ob, int num_arg
 #endif
 
     /* Do the call */
-    if (!int_apply(fun, ob, num_arg, b_find_static, b_use_default))
+    if (!int_apply(fun, ob, num_arg, b_find_static, b_use_default, NULL))
     {
         if (!b_use_default) /* int_apply() did not clean up the stack */
             inter_sp = _pop_n_elems(num_arg, inter_sp);
@@ -18240,6 +19083,7 @@ assert_master_ob_loaded (void)
 
             /* Reenter the object into the various lists */
             enter_object_hash(ob);
+            enter_object_queues(ob);
             ob->next_all = obj_list;
             ob->prev_all = NULL;
             if (obj_list)
@@ -18861,7 +19705,7 @@ call_simul_efun (unsigned int code, object_t *ob, int num_arg)
     function_name = simul_efunp[code].name;
 
     /* First, try calling the function in the given object */
-    if (!int_apply(function_name, ob, num_arg, MY_FALSE, MY_FALSE))
+    if (!int_apply(function_name, ob, num_arg, MY_FALSE, MY_FALSE, NULL))
     {
         /* Function not found: try the alternative sefun objects */
         if (simul_efun_vector)
@@ -18879,7 +19723,7 @@ call_simul_efun (unsigned int code, object_t *ob, int num_arg)
                 }
                 if ( !(ob = get_object(v->u.str)) )
                     continue;
-                if (int_apply(function_name, ob, num_arg, MY_FALSE, MY_FALSE))
+                if (int_apply(function_name, ob, num_arg, MY_FALSE, MY_FALSE, NULL))
                     return;
             }
             return;
@@ -19715,13 +20559,13 @@ void
 invalidate_apply_low_cache (void)
 
 /* Called in the (unlikely) case that all programs had to be renumbered,
- * this invalidates the call cache.
+ * this invalidates the call cache and all call site caches.
  */
 
 {
-    int i;
+    p_int i;
   
-    for (i = 0; i < CACHE_SIZE; i++)
+    for (i = 0; i < apply_cache_size; i++)
     {
         cache[i].id = 0;
         if (cache[i].name)
@@ -19730,21 +20574,72 @@ invalidate_apply_low_cache (void)
             cache[i].name = NULL;
         }
     }
+
+    call_cache_generation++;
+    if (call_cache_generation <= 0)
+        call_cache_generation = 1;
 }
 
+/*-------------------------------------------------------------------------*/
+static call_cache_t *
+get_call_cache (program_t *prog, int ix)
+
+/* Return the inline cache <ix> of the call_other sites in <prog>,
+ * allocating the caches of the program on first use.
+ */
+
+{
+    if (prog->call_caches == NULL)
+    {
+        size_t size = prog->num_call_caches * sizeof(*prog->call_caches);
+
+        prog->call_caches = xalloc(size);
+        if (prog->call_caches == NULL)
+            errorf("Out of memory (%zu bytes) for call_other caches\n", size);
+        memset(prog->call_caches, 0, size);
+        total_prog_block_size += size;
+    }
+
+#ifdef DEBUG
+    if (ix >= prog->num_call_caches)
+        fatal("Call site cache index %d out of range (%d caches) in '%s'\n"
+             , ix, prog->num_call_caches, get_txt(prog->name));
+#endif
+
+    return prog->call_caches + ix;
+} /* get_call_cache() */
+
+/*-------------------------------------------------------------------------*/
+void
+free_call_caches (program_t *prog)
+
+/* Free the inline caches of the call_other sites in <prog>, if any.
+ * They will be reallocated when the program is executed again.
+ */
+
+{
+    if (prog->call_caches != NULL)
+    {
+        total_prog_block_size -= prog->num_call_caches
+                                 * sizeof(*prog->call_caches);
+        xfree(prog->call_caches);
+        prog->call_caches = NULL;
+    }
+} /* free_call_caches() */
+
 
 /*-------------------------------------------------------------------------*/
 size_t
 interpreter_overhead (void)
 
 /* Return the amount of memory allocated for the interpreter.
- * Right now, there is none.
+ * Right now, this is just the apply cache.
  */
 
 {
     size_t sum;
 
-    sum = 0;
+    sum = apply_cache_size * sizeof(*cache);
 
     return sum;
 } /* interpreter_overhead() */
@@ -19790,9 +20685,10 @@ count_interpreter_refs (void)
  */
 
 {
-    int i;
+    p_int i;
 
-    for (i = CACHE_SIZE; --i>= 0; ) {
+    note_malloced_block_ref(cache);
+    for (i = apply_cache_size; --i>= 0; ) {
         if (cache[i].name)
             count_ref_from_string(cache[i].name);
     }
@@ -19827,6 +20723,63 @@ count_interpreter_refs (void)
 
 /*-------------------------------------------------------------------------*/
 #ifdef OPCPROF
+static int
+opcseq_cmp (const void *a, const void *b)
+
+/* qsort() comparison function for opcdump_sequences(): sort the
+ * sequences by descending count.
+ */
+
+{
+    long ca = (*(struct opcseq_s * const *)a)->count;
+    long cb = (*(struct opcseq_s * const *)b)->count;
+
+    return ca < cb ? 1 : (ca > cb ? -1 : 0);
+} /* opcseq_cmp() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opcdump_sequences (FILE *f, int length)
+
+/* Print the OPCSEQ_DUMP_LENGTH most frequent sequences of <length>
+ * (2 or 3) instructions into <f>.
+ */
+
+{
+    struct opcseq_s **list;
+    long num, i;
+
+    list = xalloc(sizeof(*list) * (opcseq_used + 1));
+    if (!list)
+        return;
+
+    for (num = 0, i = 0; i < OPCSEQ_TABLE_SIZE; i++)
+    {
+        if (opcseq_table[i].count
+         && (opcseq_table[i].instr[2] < 0) == (length == 2))
+            list[num++] = opcseq_table + i;
+    }
+    qsort(list, num, sizeof(*list), opcseq_cmp);
+
+    fprintf(f, "\nMost frequent %s:\n", length == 2 ? "pairs" : "triples");
+    for (i = 0; i < num && i < OPCSEQ_DUMP_LENGTH; i++)
+    {
+        struct opcseq_s *entry = list[i];
+        int j;
+
+        for (j = 0; j < length; j++)
+#ifdef VERBOSE_OPCPROF
+            fprintf(f, "%-24s ", get_f_name(entry->instr[j]));
+#else
+            fprintf(f, "%d ", entry->instr[j]);
+#endif
+        fprintf(f, ": %ld\n", entry->count);
+    }
+
+    xfree(list);
+} /* opcdump_sequences() */
+
+/*-------------------------------------------------------------------------*/
 Bool
 opcdump (string_t * fname)
 
@@ -19857,6 +20810,11 @@ opcdump (string_t * fname)
             fprintf(f,"%d: %d\n", i, opcount[i]);
 #endif
     }
+
+    opcdump_sequences(f, 2);
+    opcdump_sequences(f, 3);
+    if (opcseq_lost)
+        fprintf(f, "\n%ld sequences not counted (table full).\n", opcseq_lost);
     fclose(f);
 
     return MY_TRUE;
@@ -21107,7 +22065,7 @@ int_call_resolved (Bool b_use_default, svalue_t *sp, int num_arg)
      */
     if (ob == master_ob)
         b_use_default = MY_FALSE;
-    rc = int_apply(arg[2].u.str, ob, num_arg-3, MY_FALSE, b_use_default);
+    rc = int_apply(arg[2].u.str, ob, num_arg-3, MY_FALSE, b_use_default, NULL);
     if (rc == APPLY_NOT_FOUND)
     {
         /* Function not found */
@@ -21402,5 +22360,39 @@ get_profiling_time_limit()
 {
     return profiling_timevalue.tv_sec * 1000000 + profiling_timevalue.tv_usec;
 } /* get_memory_limit */
+
+/*-------------------------------------------------------------------------*/
+Bool
+set_profile_interval (mp_int interval)
+
+/* Start the profiler with a sample every <interval> microseconds of CPU
+ * time, discarding the samples taken so far. An <interval> of 0 stops the
+ * profiler and keeps the samples.
+ * Return FALSE if the timer couldn't be set.
+ */
+
+{
+    struct itimerval prof_time_val;
+
+    prof_time_val.it_value.tv_sec = interval / 1000000;
+    prof_time_val.it_value.tv_usec = interval % 1000000;
+    prof_time_val.it_interval = prof_time_val.it_value;
+
+    if (interval)
+        profile_clear();
+
+    /* Signals of the old timer are no longer meaningful. */
+    received_prof_signal = 0;
+    eval_sampled_time = 0;
+
+    if (setitimer(ITIMER_PROF, &prof_time_val, NULL))
+    {
+        profile_interval = 0;
+        return MY_FALSE;
+    }
+
+    profile_interval = interval;
+    return MY_TRUE;
+} /* set_profile_interval() */
                             
 /***************************************************************************/
@@ -107,6 +107,10 @@ static const short MAX_SHIFT = (sizeof(p_int) << 3) - 1;
   /* The maximally useful shift (left or right) of a number in LPC.
    */
 
+#define MAX_APPLY_CACHE_SIZE (1 << 24)
+  /* The maximum number of entries in the apply cache.
+   */
+
 /* --- Variables --- */
 
 extern program_t *current_prog;
@@ -125,6 +129,9 @@ extern svalue_t last_indexing_protector;
 #ifdef APPLY_CACHE_STAT
 extern statcounter_t apply_cache_hit;
 extern statcounter_t apply_cache_miss;
+extern statcounter_t apply_cache_eviction;
+extern statcounter_t call_site_cache_hit;
+extern statcounter_t call_site_cache_miss;
 #endif
 
 extern p_uint eval_number;
@@ -134,6 +141,7 @@ extern struct timeval last_eval_duration;
 extern statistic_t stat_total_evalcost;
 extern statistic_t stat_eval_duration;
 extern struct timeval profiling_timevalue;
+extern mp_int profile_interval;
 extern p_int used_memory_at_eval_start;
 
 /* --- Prototypes --- */
@@ -174,6 +182,8 @@ extern svalue_t *push_error_handler(void (*errorhandler)(error_handler_t *), err
 extern void *xalloc_with_error_handler(size_t size);
 
 extern void init_interpret(void);
+extern Bool set_apply_cache_size(p_int size);
+extern p_int get_apply_cache_size(void);
 extern const char *typename(int type);
 extern const char *efun_arg_typename (long type);
 extern void vefun_bad_arg (int arg, svalue_t *sp) NORETURN;
@@ -221,6 +231,7 @@ extern void int_call_lambda(svalue_t *lsvp, int num_arg, Bool allowRefs, Bool ex
 extern inherit_t *adjust_variable_offsets(const inherit_t *inheritp, const program_t *prog, const object_t *obj);
 extern void free_interpreter_temporaries(void);
 extern void invalidate_apply_low_cache(void);
+extern void free_call_caches(program_t *prog);
 extern void m_indices_filter (svalue_t *key, svalue_t *data, void *extra);
 extern void m_values_filter (svalue_t *key, svalue_t *data, void *extra);
 extern void m_unmake_filter ( svalue_t *key, svalue_t *data, void *extra);
@@ -257,6 +268,7 @@ extern void check_a_lot_ref_counts(program_t *search_prog);
 extern void handle_profiling_signal(int ignored);
 extern Bool set_profiling_time_limit(mp_int limit);
 extern mp_int get_profiling_time_limit();
+extern Bool set_profile_interval(mp_int interval);
 
 extern size_t interpreter_overhead(void);
 
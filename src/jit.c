@@ -0,0 +1,1266 @@
+/*---------------------------------------------------------------------------
+ * Template JIT compiler for hot loops.
+ *
+ *---------------------------------------------------------------------------
+ * If the driver is configured with --enable-jit on an x86-64 host, the
+ * interpreter counts how often each backward branch is taken. When a
+ * loop head has been reached JIT_THRESHOLD times, the code from the loop
+ * head on is translated into native code, and further iterations of the
+ * loop are executed by the native code.
+ *
+ * The translation stitches together a fixed machine code template for
+ * every bytecode instruction. It follows the control flow from the loop
+ * head, and covers only the instructions working on numbers: constants,
+ * local variables, the arithmetic, bitwise and comparison operators,
+ * assignments and increments of local variables, and the branches. At
+ * the first instruction of any other kind the native code returns to
+ * the interpreter, which continues with that instruction. The interpreter
+ * also gets control back before anything unusual happens: when a value
+ * isn't a number, on an overflow or a division by zero, the native code
+ * returns at the instruction in question without having executed it, and
+ * the interpreter executes it again and raises the error. That way all
+ * errors are raised by the interpreter, with the usual messages and
+ * catch() semantics.
+ *
+ * The eval cost is charged per basic block: at the beginning of a block
+ * the cost of all its instructions is added to eval_cost if that doesn't
+ * exceed the limit, otherwise the native code returns and the interpreter
+ * runs into the limit itself. If the native code leaves a block in the
+ * middle, it gives back the cost of the instructions not executed. The
+ * eval cost of a loop is therefore the same as in the interpreter.
+ *
+ * All values pushed by the templates are numbers. The native code keeps
+ * the stack pointer of the loop head in a register and addresses the
+ * stack by the depth known at compile time; the stack pointer is written
+ * back when returning to the interpreter.
+ *
+ * Register usage of the native code:
+ *   rbx: the stack pointer at the loop head
+ *   r12: the frame pointer
+ *   r14: the eval cost limit
+ *   r15: &eval_cost
+ *   rbp: &total_evalcost
+ *   rax, rcx, rdx: scratch
+ *
+ * The native code is kept in one mmap()ed area. The area is never
+ * writable and executable at the same time: it is made writable only
+ * while a loop is compiled, and executable again afterwards. When the
+ * area is full, all code is thrown away and the loops are compiled again
+ * when they become hot. Loops are identified by the address of the loop head and
+ * the id_number of their program, so that code of freed or swapped
+ * programs is never used again.
+ *---------------------------------------------------------------------------
+ */
+
+#include "driver.h"
+#include "typedefs.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "instrs.h"
+#include "interpret.h"
+#include "svalue.h"
+
+/*-------------------------------------------------------------------------*/
+
+/* --- Statistics --- */
+
+statcounter_t jit_loops_compiled = 0;
+  /* Number of loops compiled to native code.
+   */
+
+statcounter_t jit_loops_failed = 0;
+  /* Number of hot loops which couldn't be compiled.
+   */
+
+statcounter_t jit_runs = 0;
+  /* Number of times native code was executed.
+   */
+
+size_t jit_code_size = 0;
+  /* Size of the native code in use.
+   */
+
+#ifdef JIT_ENABLED
+
+/*-------------------------------------------------------------------------*/
+
+#define CODE_AREA_SIZE  (1024 * 1024)
+  /* Size of the memory for the native code.
+   */
+
+#define MAX_OPS      512  /* Max. number of instructions in a loop */
+#define MAX_BLOCKS   128  /* Max. number of blocks in a loop */
+#define MAX_JUMPS    256  /* Max. number of jumps between the blocks */
+#define MAX_EXITS    512  /* Max. number of exits to the interpreter */
+#define MAX_DEPTH     32  /* Max. stack depth relative to the loop head */
+
+/* The x86-64 registers */
+
+enum { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI
+     , R8, R9, R10, R11, R12, R13, R14, R15 };
+
+/* The condition codes of Jcc and SETcc */
+
+enum { CC_O = 0x0, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7
+     , CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+     , CC_ALWAYS = -1 };
+
+/* Offsets into an svalue */
+
+#define SV_SIZE    ((int32)sizeof(svalue_t))
+#define SV_TYPE    ((int32)offsetof(svalue_t, type))
+#define SV_NUMBER  ((int32)offsetof(svalue_t, u.number))
+
+/* --- The decoded instructions --- */
+
+typedef enum {
+    JOP_PUSH,            /* Push .value */
+    JOP_LOCAL,           /* Push local variable .ix */
+    JOP_BINARY,          /* Binary operator .instr */
+    JOP_NOT,             /* Logical not */
+    JOP_COMPL,           /* Binary complement */
+    JOP_POP,             /* Pop the top value */
+    JOP_ASSIGN_LOCAL,    /* Pop the top value into local variable .ix */
+    JOP_ADD_LOCAL,       /* Pop the top value and add it to local .ix */
+    JOP_INC_LOCAL,       /* Increment local variable .ix */
+    JOP_LOCAL_LT,        /* Push local .ix < (local .rhs or .value) */
+    JOP_LOCAL_LT_BRANCH, /* Branch to .target if local .ix < rhs */
+    JOP_BRANCH,          /* Branch to .target */
+    JOP_BRANCH_ZERO,     /* Pop the top value, branch if it is 0 */
+    JOP_BRANCH_NON_ZERO, /* Pop the top value, branch if it is not 0 */
+} jit_op_kind_t;
+
+typedef struct jit_op_s   jit_op_t;
+typedef struct label_s    label_t;
+typedef struct jump_s     jump_t;
+typedef struct exit_s     exit_t;
+
+/* --- struct jit_op_s: One decoded instruction or instruction sequence
+ */
+
+struct jit_op_s
+{
+    jit_op_kind_t kind;
+    int           instr;   /* JOP_BINARY: the instruction code */
+    int           cost;    /* The number of instructions executed */
+    int           push;    /* The change of the stack depth */
+    int           ix;      /* The local variable */
+    int           rhs;     /* JOP_LOCAL_LT*: the right local or -1 */
+    p_int         value;   /* The number to push or compare */
+    bytecode_p    next;    /* The following instruction */
+    bytecode_p    target;  /* The branch target */
+};
+
+/* --- struct label_s: The native code of a block
+ */
+
+struct label_s
+{
+    bytecode_p pc;     /* The bytecode of the block */
+    int        depth;  /* The stack depth at the beginning */
+    size_t     pos;    /* The position of the native code */
+};
+
+/* --- struct jump_s: A jump to a block
+ */
+
+struct jump_s
+{
+    bytecode_p pc;     /* The bytecode of the block */
+    int        depth;  /* The stack depth at the jump */
+    size_t     pos;    /* The position of the rel32 to patch */
+};
+
+/* --- struct exit_s: A jump back to the interpreter
+ */
+
+struct exit_s
+{
+    bytecode_p pc;      /* The next instruction to interpret */
+    int        depth;   /* The stack depth */
+    int        refund;  /* The eval cost charged in advance */
+    size_t     pos;     /* The position of the rel32 to patch */
+};
+
+/* --- Variables --- */
+
+jit_loop_t jit_loops[JIT_TABLE_SIZE];
+  /* The loop heads.
+   */
+
+static unsigned char *code_area = NULL;
+  /* The memory for the native code, or NULL if not allocated yet.
+   */
+
+static Bool jit_unavailable = MY_FALSE;
+  /* TRUE if native code can't be executed here.
+   */
+
+/* The state of the compiler */
+
+static unsigned char *code;       /* The code of the current loop */
+static size_t code_pos;           /* The next free byte in code[] */
+static size_t code_max;           /* The space available in code[] */
+static Bool compile_failed;       /* The loop can't be compiled */
+static Bool code_full;            /* The code area is full */
+static int num_ops;               /* The instructions compiled */
+
+static label_t labels[MAX_BLOCKS];
+static int num_labels;
+static jump_t jumps[MAX_JUMPS];
+static int num_jumps;
+static exit_t exits[MAX_EXITS];
+static int num_exits;
+
+/*=========================================================================*/
+
+/*                        MACHINE CODE EMITTER                             */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_byte (int b)
+
+/* Append byte <b> to the native code.
+ */
+
+{
+    if (code_pos < code_max)
+        code[code_pos++] = (unsigned char)b;
+    else
+        compile_failed = code_full = MY_TRUE;
+} /* emit_byte() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_int32 (int32 v)
+
+/* Append the 32-bit value <v> to the native code.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < 4; i++, v >>= 8)
+        emit_byte(v & 0xff);
+} /* emit_int32() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_int64 (int64_t v)
+
+/* Append the 64-bit value <v> to the native code.
+ */
+
+{
+    emit_int32((int32)(v & 0xffffffff));
+    emit_int32((int32)(v >> 32));
+} /* emit_int64() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_opcode (int op, Bool wide, int reg, int rm)
+
+/* Append the REX prefix (if needed) and the opcode <op> (one byte, or
+ * two bytes if > 0xff) for an instruction with the operand size 64 bit
+ * if <wide>, the register resp. opcode extension <reg> and the base
+ * resp. register <rm>.
+ */
+
+{
+    int rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+
+    if (rex != 0x40)
+        emit_byte(rex);
+    if (op > 0xff)
+        emit_byte(op >> 8);
+    emit_byte(op & 0xff);
+} /* emit_opcode() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_mem (int op, Bool wide, int reg, int base, int32 disp)
+
+/* Emit instruction <op> with the register <reg> and the memory operand
+ * [<base> + <disp>].
+ */
+
+{
+    emit_opcode(op, wide, reg, base);
+    emit_byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit_byte(0x24);
+    emit_int32(disp);
+} /* emit_mem() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_reg (int op, Bool wide, int reg, int rm)
+
+/* Emit instruction <op> with the registers <reg> and <rm>.
+ */
+
+{
+    emit_opcode(op, wide, reg, rm);
+    emit_byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+} /* emit_reg() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_mov_imm64 (int reg, int64_t v)
+
+/* Emit 'mov <reg>, <v>'.
+ */
+
+{
+    emit_byte(0x48 | ((reg & 8) ? 1 : 0));
+    emit_byte(0xB8 | (reg & 7));
+    emit_int64(v);
+} /* emit_mov_imm64() */
+
+/*-------------------------------------------------------------------------*/
+static size_t
+emit_jump (int cc)
+
+/* Emit a jump with the condition <cc> (CC_ALWAYS for an unconditional
+ * one) and return the position of its displacement.
+ */
+
+{
+    if (cc == CC_ALWAYS)
+        emit_byte(0xE9);
+    else
+    {
+        emit_byte(0x0F);
+        emit_byte(0x80 | cc);
+    }
+    emit_int32(0);
+    return code_pos - 4;
+} /* emit_jump() */
+
+/*-------------------------------------------------------------------------*/
+static void
+patch_jump (size_t pos, size_t target)
+
+/* Let the jump whose displacement is at <pos> go to <target>.
+ */
+
+{
+    int32 rel = (int32)(target - (pos + 4));
+
+    if (pos + 4 <= code_max)
+        memcpy(code + pos, &rel, 4);
+} /* patch_jump() */
+
+/*=========================================================================*/
+
+/*                            THE TEMPLATES                                */
+
+/*-------------------------------------------------------------------------*/
+static int32
+slot (int depth)
+
+/* Return the offset of the stack value at <depth> from the stack pointer
+ * of the loop head.
+ */
+
+{
+    return depth * SV_SIZE;
+} /* slot() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_exit (int cc, bytecode_p pc, int depth, int refund)
+
+/* Emit a jump with condition <cc> back to the interpreter, which will
+ * continue at <pc> with the stack at <depth>. The eval cost <refund>
+ * was charged for instructions that weren't executed.
+ */
+
+{
+    if (num_exits >= MAX_EXITS)
+    {
+        compile_failed = MY_TRUE;
+        return;
+    }
+    exits[num_exits].pc = pc;
+    exits[num_exits].depth = depth;
+    exits[num_exits].refund = refund;
+    exits[num_exits].pos = emit_jump(cc);
+    num_exits++;
+} /* emit_exit() */
+
+/*-------------------------------------------------------------------------*/
+static label_t *
+find_label (bytecode_p pc)
+
+/* Return the block starting at <pc>, or NULL if there is none yet.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < num_labels; i++)
+        if (labels[i].pc == pc)
+            return &labels[i];
+    return NULL;
+} /* find_label() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_goto (int cc, bytecode_p pc, int depth)
+
+/* Emit a jump with condition <cc> to the block at <pc>, which is compiled
+ * later if it doesn't exist yet.
+ */
+
+{
+    if (num_jumps >= MAX_JUMPS)
+    {
+        compile_failed = MY_TRUE;
+        return;
+    }
+    jumps[num_jumps].pc = pc;
+    jumps[num_jumps].depth = depth;
+    jumps[num_jumps].pos = emit_jump(cc);
+    num_jumps++;
+} /* emit_goto() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_check_number (int base, int32 disp, bytecode_p pc, int depth, int refund)
+
+/* Emit the check that the svalue at [<base> + <disp>] is a number, and
+ * the exit to the interpreter at <pc> if it isn't.
+ */
+
+{
+    emit_mem(0x83, MY_FALSE, 7, base, disp + SV_TYPE);  /* cmp dword [], T_NUMBER */
+    emit_byte(T_NUMBER);
+    emit_exit(CC_NE, pc, depth, refund);
+} /* emit_check_number() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_check_stack (int from, int to, bytecode_p pc, int depth, int refund)
+
+/* Check that the stack values at the depths <from> to <to> are numbers.
+ * Values pushed by the native code are, the values from before the loop
+ * head are checked.
+ */
+
+{
+    int i;
+
+    for (i = from; i <= to && i <= 0; i++)
+        emit_check_number(RBX, slot(i), pc, depth, refund);
+} /* emit_check_stack() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_push_rax (int depth)
+
+/* Store the number in rax as the stack value at <depth>.
+ */
+
+{
+    emit_mem(0xC7, MY_FALSE, 0, RBX, slot(depth) + SV_TYPE); /* mov dword [], T_NUMBER */
+    emit_int32(T_NUMBER);
+    emit_mem(0x89, MY_TRUE, RAX, RBX, slot(depth) + SV_NUMBER); /* mov [], rax */
+} /* emit_push_rax() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_charge (bytecode_p pc, int depth, int cost)
+
+/* Emit the code at the beginning of a block to charge <cost> to the
+ * eval cost, or return to the interpreter at <pc> if the limit would be
+ * exceeded.
+ */
+
+{
+    emit_mem(0x8B, MY_FALSE, RAX, R15, 0);   /* mov eax, [r15] */
+    emit_reg(0x81, MY_TRUE, 0, RAX);         /* add rax, cost */
+    emit_int32(cost);
+    emit_reg(0x39, MY_TRUE, R14, RAX);       /* cmp rax, r14 */
+    emit_exit(CC_A, pc, depth, 0);
+    emit_mem(0x89, MY_FALSE, RAX, R15, 0);   /* mov [r15], eax */
+    emit_mem(0x81, MY_TRUE, 0, RBP, 0);      /* add qword [rbp], cost */
+    emit_int32(cost);
+} /* emit_charge() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_binary (int instr, bytecode_p pc, int depth, int refund)
+
+/* Emit the code for the binary operator <instr> on the two topmost
+ * stack values, the topmost being at <depth>.
+ */
+
+{
+    int32 left = slot(depth-1) + SV_NUMBER;
+    int32 right = slot(depth) + SV_NUMBER;
+
+    emit_check_stack(depth-1, depth, pc, depth, refund);
+
+    switch (instr)
+    {
+    case F_ADD:
+    case F_SUBTRACT:
+    case F_MULTIPLY:
+    case F_AND:
+    case F_OR:
+    case F_XOR:
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, left);
+        switch (instr)
+        {
+        case F_ADD:      emit_mem(0x03, MY_TRUE, RAX, RBX, right); break;
+        case F_SUBTRACT: emit_mem(0x2B, MY_TRUE, RAX, RBX, right); break;
+        case F_MULTIPLY: emit_mem(0x0FAF, MY_TRUE, RAX, RBX, right); break;
+        case F_AND:      emit_mem(0x23, MY_TRUE, RAX, RBX, right); break;
+        case F_OR:       emit_mem(0x0B, MY_TRUE, RAX, RBX, right); break;
+        case F_XOR:      emit_mem(0x33, MY_TRUE, RAX, RBX, right); break;
+        }
+        if (instr == F_ADD || instr == F_SUBTRACT || instr == F_MULTIPLY)
+            emit_exit(CC_O, pc, depth, refund);
+        emit_mem(0x89, MY_TRUE, RAX, RBX, left);
+        break;
+
+    case F_DIVIDE:
+    case F_MOD:
+        /* Division by zero and PINT_MIN / -1 are left to the interpreter */
+        emit_mem(0x8B, MY_TRUE, RCX, RBX, right);
+        emit_reg(0x85, MY_TRUE, RCX, RCX);     /* test rcx, rcx */
+        emit_exit(CC_E, pc, depth, refund);
+        emit_reg(0x83, MY_TRUE, 7, RCX);       /* cmp rcx, -1 */
+        emit_byte(0xFF);
+        emit_exit(CC_E, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, left);
+        emit_byte(0x48);                       /* cqo */
+        emit_byte(0x99);
+        emit_reg(0xF7, MY_TRUE, 7, RCX);       /* idiv rcx */
+        emit_mem(0x89, MY_TRUE, instr == F_DIVIDE ? RAX : RDX, RBX, left);
+        break;
+
+    case F_LSH:
+    case F_RSH:
+    case F_RSHL:
+        /* Shifts by more than MAX_SHIFT are left to the interpreter */
+        emit_mem(0x8B, MY_TRUE, RCX, RBX, right);
+        emit_reg(0x83, MY_TRUE, 7, RCX);       /* cmp rcx, MAX_SHIFT */
+        emit_byte(MAX_SHIFT);
+        emit_exit(CC_A, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, left);
+        emit_reg(0xD3, MY_TRUE, instr == F_LSH ? 4 : (instr == F_RSH ? 7 : 5), RAX);
+        emit_mem(0x89, MY_TRUE, RAX, RBX, left);
+        break;
+
+    default: /* The comparisons */
+      {
+        int cc;
+
+        switch (instr)
+        {
+        case F_LT: cc = CC_L;  break;
+        case F_LE: cc = CC_LE; break;
+        case F_GT: cc = CC_G;  break;
+        case F_GE: cc = CC_GE; break;
+        case F_EQ: cc = CC_E;  break;
+        default:   cc = CC_NE; break;
+        }
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, left);
+        emit_mem(0x3B, MY_TRUE, RAX, RBX, right);  /* cmp rax, [] */
+        emit_reg(0x0F90 | cc, MY_FALSE, 0, RAX);   /* setcc al */
+        emit_reg(0x0FB6, MY_FALSE, RAX, RAX);      /* movzx eax, al */
+        emit_mem(0x89, MY_TRUE, RAX, RBX, left);
+        break;
+      }
+    }
+} /* emit_binary() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_local_lt (jit_op_t *op, bytecode_p pc, int depth, int refund)
+
+/* Emit the comparison of a JOP_LOCAL_LT or JOP_LOCAL_LT_BRANCH, leaving
+ * the flags set.
+ */
+
+{
+    emit_check_number(R12, op->ix * SV_SIZE, pc, depth, refund);
+    if (op->rhs >= 0)
+        emit_check_number(R12, op->rhs * SV_SIZE, pc, depth, refund);
+    emit_mem(0x8B, MY_TRUE, RAX, R12, op->ix * SV_SIZE + SV_NUMBER);
+    if (op->rhs >= 0)
+        emit_mem(0x3B, MY_TRUE, RAX, R12, op->rhs * SV_SIZE + SV_NUMBER);
+    else if (op->value >= INT32_MIN && op->value <= INT32_MAX)
+    {
+        emit_reg(0x81, MY_TRUE, 7, RAX);           /* cmp rax, value */
+        emit_int32((int32)op->value);
+    }
+    else
+    {
+        emit_mov_imm64(RCX, op->value);
+        emit_reg(0x3B, MY_TRUE, RAX, RCX);         /* cmp rax, rcx */
+    }
+} /* emit_local_lt() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_op (jit_op_t *op, bytecode_p pc, int depth, int refund)
+
+/* Emit the code for <op> at <pc>, executed with the stack at <depth>.
+ * If the code returns to the interpreter, the eval cost <refund> is
+ * given back.
+ */
+
+{
+    int32 local = op->ix * SV_SIZE;
+
+    switch (op->kind)
+    {
+    case JOP_PUSH:
+        emit_mem(0xC7, MY_FALSE, 0, RBX, slot(depth+1) + SV_TYPE);
+        emit_int32(T_NUMBER);
+        if (op->value >= INT32_MIN && op->value <= INT32_MAX)
+        {
+            emit_mem(0xC7, MY_TRUE, 0, RBX, slot(depth+1) + SV_NUMBER);
+            emit_int32((int32)op->value);
+        }
+        else
+        {
+            emit_mov_imm64(RAX, op->value);
+            emit_mem(0x89, MY_TRUE, RAX, RBX, slot(depth+1) + SV_NUMBER);
+        }
+        break;
+
+    case JOP_LOCAL:
+        emit_check_number(R12, local, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, R12, local + SV_NUMBER);
+        emit_push_rax(depth+1);
+        break;
+
+    case JOP_BINARY:
+        emit_binary(op->instr, pc, depth, refund);
+        break;
+
+    case JOP_NOT:
+        emit_check_stack(depth, depth, pc, depth, refund);
+        emit_mem(0x83, MY_TRUE, 7, RBX, slot(depth) + SV_NUMBER); /* cmp qword [], 0 */
+        emit_byte(0);
+        emit_reg(0x0F90 | CC_E, MY_FALSE, 0, RAX);                /* sete al */
+        emit_reg(0x0FB6, MY_FALSE, RAX, RAX);                     /* movzx eax, al */
+        emit_mem(0x89, MY_TRUE, RAX, RBX, slot(depth) + SV_NUMBER);
+        break;
+
+    case JOP_COMPL:
+        emit_check_stack(depth, depth, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, slot(depth) + SV_NUMBER);
+        emit_reg(0xF7, MY_TRUE, 2, RAX);                          /* not rax */
+        emit_mem(0x89, MY_TRUE, RAX, RBX, slot(depth) + SV_NUMBER);
+        break;
+
+    case JOP_POP:
+        emit_check_stack(depth, depth, pc, depth, refund);
+        break;
+
+    case JOP_ASSIGN_LOCAL:
+    case JOP_ADD_LOCAL:
+        /* The old value is a number, so nothing needs to be freed */
+        emit_check_stack(depth, depth, pc, depth, refund);
+        emit_check_number(R12, local, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, RBX, slot(depth) + SV_NUMBER);
+        if (op->kind == JOP_ADD_LOCAL)
+        {
+            emit_mem(0x03, MY_TRUE, RAX, R12, local + SV_NUMBER);
+            emit_exit(CC_O, pc, depth, refund);
+        }
+        emit_mem(0x89, MY_TRUE, RAX, R12, local + SV_NUMBER);
+        break;
+
+    case JOP_INC_LOCAL:
+        emit_check_number(R12, local, pc, depth, refund);
+        emit_mem(0x8B, MY_TRUE, RAX, R12, local + SV_NUMBER);
+        emit_reg(0x83, MY_TRUE, 0, RAX);                          /* add rax, 1 */
+        emit_byte(1);
+        emit_exit(CC_O, pc, depth, refund);
+        emit_mem(0x89, MY_TRUE, RAX, R12, local + SV_NUMBER);
+        break;
+
+    case JOP_LOCAL_LT:
+        emit_local_lt(op, pc, depth, refund);
+        emit_reg(0x0F90 | CC_L, MY_FALSE, 0, RAX);                /* setl al */
+        emit_reg(0x0FB6, MY_FALSE, RAX, RAX);                     /* movzx eax, al */
+        emit_push_rax(depth+1);
+        break;
+
+    case JOP_LOCAL_LT_BRANCH:
+        emit_local_lt(op, pc, depth, refund);
+        emit_goto(CC_L, op->target, depth);
+        break;
+
+    case JOP_BRANCH:
+        emit_goto(CC_ALWAYS, op->target, depth);
+        break;
+
+    case JOP_BRANCH_ZERO:
+    case JOP_BRANCH_NON_ZERO:
+        emit_check_stack(depth, depth, pc, depth, refund);
+        emit_mem(0x83, MY_TRUE, 7, RBX, slot(depth) + SV_NUMBER); /* cmp qword [], 0 */
+        emit_byte(0);
+        emit_goto(op->kind == JOP_BRANCH_ZERO ? CC_E : CC_NE, op->target, depth-1);
+        break;
+    }
+} /* emit_op() */
+
+/*=========================================================================*/
+
+/*                             THE COMPILER                                */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+decode (bytecode_p pc, int depth, jit_op_t *op)
+
+/* Decode the instruction at <pc>, executed with the stack at <depth>,
+ * into <op>. Return FALSE if it can't be compiled.
+ *
+ * Superinstructions are decoded like the interpreter executes them: if
+ * the following code doesn't match, just the first instruction.
+ */
+
+{
+    bytecode_p p = pc + 1;
+
+    memset(op, 0, sizeof(*op));
+    op->cost = 1;
+    op->rhs = -1;
+
+    switch (*pc)
+    {
+    case F_CONST0:
+    case F_CONST1:
+    case F_NCONST1:
+        op->kind = JOP_PUSH;
+        op->value = (*pc == F_CONST0) ? 0 : ((*pc == F_CONST1) ? 1 : -1);
+        break;
+
+    case F_CLIT:
+    case F_NCLIT:
+        op->kind = JOP_PUSH;
+        op->value = (*pc == F_CLIT) ? (p_int)p[0] : -(p_int)p[0];
+        p++;
+        break;
+
+    case F_NUMBER:
+        op->kind = JOP_PUSH;
+        memcpy(&op->value, p, sizeof(op->value));
+        p += sizeof(op->value);
+        break;
+
+    case F_LOCAL:
+    case F_LOCAL_LOCAL:  /* The second local is decoded separately */
+    case F_LOCAL_INDEX:  /* The index isn't compiled anyway */
+        op->kind = JOP_LOCAL;
+        op->ix = *p++;
+        break;
+
+    case F_LOCAL_LT:
+      {
+        bytecode_p q;
+
+        op->kind = JOP_LOCAL;
+        op->ix = *p++;
+
+        q = p;
+        switch (*q)
+        {
+        case F_LOCAL:
+            op->rhs = q[1];
+            q += 2;
+            break;
+
+        case F_CLIT:
+            op->value = q[1];
+            q += 2;
+            break;
+
+        case F_NUMBER:
+            memcpy(&op->value, q+1, sizeof(op->value));
+            q += 1 + sizeof(op->value);
+            break;
+
+        default:
+            q = NULL;
+            break;
+        }
+
+        if (q == NULL || *q != F_LT)
+            break;
+
+        q++;
+        if (*q == F_BBRANCH_WHEN_NON_ZERO)
+        {
+            op->kind = JOP_LOCAL_LT_BRANCH;
+            op->cost = 4;
+            op->target = q + 1 - q[1];
+            p = q + 2;
+        }
+        else
+        {
+            op->kind = JOP_LOCAL_LT;
+            op->cost = 3;
+            p = q;
+        }
+        break;
+      }
+
+    case F_INC_LOCAL:
+        if (p[1] != F_INC)
+            return MY_FALSE;
+        op->kind = JOP_INC_LOCAL;
+        op->cost = 2;
+        op->ix = p[0];
+        p += 2;
+        break;
+
+    case F_PUSH_LOCAL_VARIABLE_LVALUE:
+        if (p[1] == F_VOID_ASSIGN)
+            op->kind = JOP_ASSIGN_LOCAL;
+        else if (p[1] == F_VOID_ADD_EQ)
+            op->kind = JOP_ADD_LOCAL;
+        else
+            return MY_FALSE;
+        op->cost = 2;
+        op->ix = p[0];
+        p += 2;
+        break;
+
+    case F_ADD:
+    case F_SUBTRACT:
+    case F_MULTIPLY:
+    case F_DIVIDE:
+    case F_MOD:
+    case F_AND:
+    case F_OR:
+    case F_XOR:
+    case F_LSH:
+    case F_RSH:
+    case F_RSHL:
+    case F_LT:
+    case F_LE:
+    case F_GT:
+    case F_GE:
+    case F_EQ:
+    case F_NE:
+        op->kind = JOP_BINARY;
+        op->instr = *pc;
+        break;
+
+    case F_NOT:
+        op->kind = JOP_NOT;
+        break;
+
+    case F_COMPL:
+        op->kind = JOP_COMPL;
+        break;
+
+    case F_POP_VALUE:
+        op->kind = JOP_POP;
+        break;
+
+    case F_BRANCH:
+        op->kind = JOP_BRANCH;
+        op->target = p + p[0] + 1;
+        p++;
+        break;
+
+    case F_BRANCH_WHEN_ZERO:
+    case F_BRANCH_WHEN_NON_ZERO:
+        op->kind = (*pc == F_BRANCH_WHEN_ZERO) ? JOP_BRANCH_ZERO
+                                               : JOP_BRANCH_NON_ZERO;
+        op->target = p + p[0] + 1;
+        p++;
+        break;
+
+    case F_BBRANCH_WHEN_ZERO:
+    case F_BBRANCH_WHEN_NON_ZERO:
+        op->kind = (*pc == F_BBRANCH_WHEN_ZERO) ? JOP_BRANCH_ZERO
+                                                : JOP_BRANCH_NON_ZERO;
+        op->target = p - p[0];
+        p++;
+        break;
+
+    case F_LBRANCH:
+    case F_LBRANCH_WHEN_ZERO:
+    case F_LBRANCH_WHEN_NON_ZERO:
+        op->kind = (*pc == F_LBRANCH) ? JOP_BRANCH
+                 : ((*pc == F_LBRANCH_WHEN_ZERO) ? JOP_BRANCH_ZERO
+                                                 : JOP_BRANCH_NON_ZERO);
+        op->target = p + get_bc_shortoffset(p);
+        p += sizeof(bc_shortoffset_t);
+        break;
+
+    default:
+        return MY_FALSE;
+    }
+
+    switch (op->kind)
+    {
+    case JOP_PUSH:
+    case JOP_LOCAL:
+    case JOP_LOCAL_LT:
+        op->push = 1;
+        break;
+
+    case JOP_BINARY:
+    case JOP_POP:
+    case JOP_ASSIGN_LOCAL:
+    case JOP_ADD_LOCAL:
+    case JOP_BRANCH_ZERO:
+    case JOP_BRANCH_NON_ZERO:
+        op->push = -1;
+        break;
+
+    default:
+        op->push = 0;
+        break;
+    }
+
+    if (depth + op->push > MAX_DEPTH || depth + op->push < -MAX_DEPTH)
+        return MY_FALSE;
+
+    op->next = p;
+    return MY_TRUE;
+} /* decode() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+is_branch (jit_op_t *op)
+
+/* Return TRUE if <op> ends a block.
+ */
+
+{
+    return op->kind == JOP_BRANCH
+        || op->kind == JOP_BRANCH_ZERO
+        || op->kind == JOP_BRANCH_NON_ZERO
+        || op->kind == JOP_LOCAL_LT_BRANCH;
+} /* is_branch() */
+
+/*-------------------------------------------------------------------------*/
+static void
+compile_block (bytecode_p pc, int depth)
+
+/* Compile the block starting at <pc> with the stack at <depth>, and the
+ * blocks following it without a jump.
+ */
+
+{
+    jit_op_t op;
+
+    while (!compile_failed)
+    {
+        bytecode_p q;
+        int d, cost, num, i, refund;
+
+        if (num_labels >= MAX_BLOCKS)
+        {
+            compile_failed = MY_TRUE;
+            return;
+        }
+        labels[num_labels].pc = pc;
+        labels[num_labels].depth = depth;
+        labels[num_labels].pos = code_pos;
+        num_labels++;
+
+        /* Find the instructions of the block and their cost */
+        q = pc;
+        d = depth;
+        cost = 0;
+        for (num = 0; num_ops + num < MAX_OPS; )
+        {
+            if ((num > 0 && find_label(q)) || !decode(q, d, &op))
+                break;
+            cost += op.cost;
+            d += op.push;
+            num++;
+            if (is_branch(&op))
+                break;
+            q = op.next;
+        }
+
+        if (num == 0)
+        {
+            /* The first instruction can't be compiled */
+            emit_exit(CC_ALWAYS, pc, depth, 0);
+            return;
+        }
+
+        /* Compile the block */
+        emit_charge(pc, depth, cost);
+        refund = cost;
+        q = pc;
+        d = depth;
+        for (i = 0; i < num; i++)
+        {
+            (void)decode(q, d, &op);
+            emit_op(&op, q, d, refund);
+            refund -= op.cost;
+            d += op.push;
+            q = op.next;
+        }
+        num_ops += num;
+
+        /* Continue after the block */
+        if (op.kind == JOP_BRANCH)
+            return;
+        if (find_label(q))
+        {
+            emit_goto(CC_ALWAYS, q, d);
+            return;
+        }
+        pc = q;
+        depth = d;
+    }
+} /* compile_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+emit_exit_stubs (size_t epilogue)
+
+/* Emit the code for the exits to the interpreter: give back the
+ * eval cost, and return the pc and sp via the epilogue.
+ */
+
+{
+    int i, j;
+
+    for (i = 0; i < num_exits && !compile_failed; i++)
+    {
+        exit_t *ex = &exits[i];
+
+        /* Use the stub of an identical exit if possible */
+        for (j = 0; j < i; j++)
+            if (exits[j].pc == ex->pc && exits[j].depth == ex->depth
+             && exits[j].refund == ex->refund)
+                break;
+        if (j < i)
+        {
+            patch_jump(ex->pos, exits[j].pos);
+            ex->pos = exits[j].pos;
+            continue;
+        }
+
+        patch_jump(ex->pos, code_pos);
+        ex->pos = code_pos;  /* Now the position of the stub */
+        if (ex->refund)
+        {
+            emit_mem(0x81, MY_FALSE, 5, R15, 0);  /* sub dword [r15], refund */
+            emit_int32(ex->refund);
+            emit_mem(0x81, MY_TRUE, 5, RBP, 0);   /* sub qword [rbp], refund */
+            emit_int32(ex->refund);
+        }
+        emit_mem(0x8D, MY_TRUE, RDX, RBX, slot(ex->depth)); /* lea rdx, [] */
+        emit_mov_imm64(RAX, (int64_t)(p_int)ex->pc);
+        patch_jump(emit_jump(CC_ALWAYS), epilogue);
+    }
+} /* emit_exit_stubs() */
+
+/*-------------------------------------------------------------------------*/
+static jit_code_t
+compile_loop (bytecode_p pc)
+
+/* Compile the loop starting at <pc> into the code area.
+ * Return the native code, or NULL if the loop can't be compiled.
+ */
+
+{
+    size_t epilogue;
+    int i;
+    jit_op_t op;
+
+    if (!decode(pc, 0, &op))
+        return NULL;
+
+    code = code_area + jit_code_size;
+    code_pos = 0;
+    code_max = CODE_AREA_SIZE - jit_code_size;
+    compile_failed = code_full = MY_FALSE;
+    num_ops = num_labels = num_jumps = num_exits = 0;
+
+    /* The prologue */
+    emit_byte(0x53);                          /* push rbx */
+    emit_byte(0x55);                          /* push rbp */
+    emit_byte(0x41); emit_byte(0x54);         /* push r12 */
+    emit_byte(0x41); emit_byte(0x56);         /* push r14 */
+    emit_byte(0x41); emit_byte(0x57);         /* push r15 */
+    emit_reg(0x89, MY_TRUE, RDI, RBX);        /* mov rbx, rdi */
+    emit_reg(0x89, MY_TRUE, RSI, R12);        /* mov r12, rsi */
+    emit_reg(0x89, MY_FALSE, RDX, R14);       /* mov r14d, edx */
+    emit_mov_imm64(R15, (int64_t)(p_int)&eval_cost);
+    emit_mov_imm64(RBP, (int64_t)(p_int)&total_evalcost);
+
+    /* The blocks, starting with the loop head */
+    compile_block(pc, 0);
+    for (i = 0; i < num_jumps && !compile_failed; i++)
+        if (!find_label(jumps[i].pc))
+            compile_block(jumps[i].pc, jumps[i].depth);
+
+    for (i = 0; i < num_jumps && !compile_failed; i++)
+    {
+        label_t *label = find_label(jumps[i].pc);
+
+        if (label->depth != jumps[i].depth)
+            compile_failed = MY_TRUE;
+        else
+            patch_jump(jumps[i].pos, label->pos);
+    }
+
+    /* The epilogue */
+    epilogue = code_pos;
+    emit_byte(0x41); emit_byte(0x5F);         /* pop r15 */
+    emit_byte(0x41); emit_byte(0x5E);         /* pop r14 */
+    emit_byte(0x41); emit_byte(0x5C);         /* pop r12 */
+    emit_byte(0x5D);                          /* pop rbp */
+    emit_byte(0x5B);                          /* pop rbx */
+    emit_byte(0xC3);                          /* ret */
+
+    emit_exit_stubs(epilogue);
+
+    if (compile_failed)
+        return NULL;
+
+    jit_code_size += (code_pos + 15) & ~(size_t)15;
+    return (jit_code_t)(void *)code;
+} /* compile_loop() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+init_code_area (void)
+
+/* Allocate the memory for the native code. Return FALSE if that's not
+ * possible.
+ */
+
+{
+    void *area;
+
+    /* The templates assume the 16 byte svalues with 32 bit types */
+    if (sizeof(svalue_t) != 16 || sizeof(((svalue_t *)NULL)->type) != 4
+     || sizeof(p_int) != 8 || sizeof(eval_cost) != 4
+     || sizeof(total_evalcost) != 8
+       )
+        return MY_FALSE;
+
+    area = mmap(NULL, CODE_AREA_SIZE, PROT_READ|PROT_WRITE
+               , MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+        return MY_FALSE;
+
+    code_area = area;
+    return MY_TRUE;
+} /* init_code_area() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+protect_code_area (Bool writable)
+
+/* Make the code area writable (<writable> is TRUE) for compiling, or
+ * executable again. Return FALSE on failure.
+ */
+
+{
+    return mprotect(code_area, CODE_AREA_SIZE
+                   , writable ? PROT_READ|PROT_WRITE : PROT_READ|PROT_EXEC
+                   ) == 0;
+} /* protect_code_area() */
+
+/*=========================================================================*/
+
+/*                              INTERFACE                                  */
+
+/*-------------------------------------------------------------------------*/
+jit_code_t
+jit_hot_loop (jit_loop_t *loop, program_t *prog, bytecode_p pc)
+
+/* Called by jit_loop_code() when <loop> isn't the entry for <pc> in
+ * <prog> yet, or when the loop reached the JIT_THRESHOLD. Return the
+ * native code for the loop, or NULL.
+ */
+
+{
+    jit_code_t native;
+
+    if (loop->pc != pc || loop->prog_id != prog->id_number)
+    {
+        /* A new loop (replacing another one) */
+        loop->pc = pc;
+        loop->prog_id = prog->id_number;
+        loop->count = 1;
+        loop->code = NULL;
+        return NULL;
+    }
+
+    if (jit_unavailable)
+        return NULL;
+    if (!code_area && !init_code_area())
+    {
+        jit_unavailable = MY_TRUE;
+        return NULL;
+    }
+
+    /* The native code never calls back into the driver, so no native
+     * code is running while we compile.
+     */
+    if (!protect_code_area(MY_TRUE))
+    {
+        jit_unavailable = MY_TRUE;
+        return NULL;
+    }
+
+    native = compile_loop(pc);
+    if (!native && code_full && jit_code_size > 0)
+    {
+        /* Maybe the code area is just full */
+        jit_flush();
+        loop->pc = pc;
+        loop->prog_id = prog->id_number;
+        loop->count = JIT_THRESHOLD;
+        native = compile_loop(pc);
+    }
+
+    if (!protect_code_area(MY_FALSE))
+    {
+        /* The code can't be executed: don't use any of it. */
+        jit_flush();
+        jit_unavailable = MY_TRUE;
+        return NULL;
+    }
+
+    loop->code = native;
+    if (native)
+        jit_loops_compiled++;
+    else
+        jit_loops_failed++;
+    return native;
+} /* jit_hot_loop() */
+
+/*-------------------------------------------------------------------------*/
+void
+jit_flush (void)
+
+/* Throw away all native code and the loop statistics.
+ */
+
+{
+    memset(jit_loops, 0, sizeof(jit_loops));
+    jit_code_size = 0;
+} /* jit_flush() */
+
+#endif /* JIT_ENABLED */
+
+/***************************************************************************/
@@ -0,0 +1,104 @@
+#ifndef JIT_H__
+#define JIT_H__ 1
+
+#include "driver.h"
+#include "typedefs.h"
+
+#include "bytecode.h"
+#include "exec.h"
+#include "svalue.h"
+
+/* The JIT is only available on x86-64 with the normal svalue layout.
+ * It is not used with OPCPROF, as the native code doesn't count the
+ * instructions.
+ */
+#if defined(USE_JIT) && defined(__x86_64__) && SIZEOF_CHAR_P == 8 \
+ && !defined(COMPACT_SVALUES) && !defined(OPCPROF)
+#    define JIT_ENABLED
+#endif
+
+#ifdef JIT_ENABLED
+
+/* --- Types --- */
+
+typedef struct jit_result_s jit_result_t;
+typedef struct jit_loop_s   jit_loop_t;
+
+/* --- struct jit_result_s: Where the native code returned to the VM
+ */
+
+struct jit_result_s
+{
+    bytecode_p  pc;  /* The next instruction to interpret */
+    svalue_t   *sp;  /* The stack pointer */
+};
+
+/* The native code of a loop.
+ * It is called with the stack and frame pointer of the interpreter and
+ * the highest eval_cost it may reach.
+ */
+typedef jit_result_t (*jit_code_t)(svalue_t *sp, svalue_t *fp, uint32_t limit);
+
+/* --- struct jit_loop_s: A loop head seen by the interpreter
+ */
+
+struct jit_loop_s
+{
+    bytecode_p  pc;       /* The target of the backward branch */
+    int32       prog_id;  /* The id_number of the program */
+    uint32      count;    /* Number of branches to pc, up to JIT_THRESHOLD */
+    jit_code_t  code;     /* The native code, or NULL */
+};
+
+/* --- Constants --- */
+
+#define JIT_TABLE_SIZE  4096
+  /* Number of loop heads remembered, must be a power of 2.
+   */
+
+#define JIT_THRESHOLD   1000
+  /* Number of backward branches to a loop head before it is compiled.
+   */
+
+/* --- Variables --- */
+
+extern jit_loop_t jit_loops[JIT_TABLE_SIZE];
+
+/* --- Prototypes --- */
+
+extern jit_code_t jit_hot_loop(jit_loop_t *loop, program_t *prog, bytecode_p pc);
+extern void jit_flush(void);
+
+/*-------------------------------------------------------------------------*/
+static INLINE jit_code_t
+jit_loop_code (program_t *prog, bytecode_p pc)
+
+/* The interpreter branched back to <pc> in <prog>. Return the native code
+ * for the loop starting at <pc> if there is one, or NULL.
+ * The loop is compiled after it has been executed JIT_THRESHOLD times.
+ */
+
+{
+    jit_loop_t *loop;
+
+    loop = &jit_loops[(((p_uint)pc >> 12) ^ (p_uint)pc) & (JIT_TABLE_SIZE-1)];
+    if (loop->pc == pc && loop->prog_id == prog->id_number)
+    {
+        if (loop->code || loop->count >= JIT_THRESHOLD)
+            return loop->code;
+        if (++loop->count < JIT_THRESHOLD)
+            return NULL;
+    }
+    return jit_hot_loop(loop, prog, pc);
+} /* jit_loop_code() */
+
+#endif /* JIT_ENABLED */
+
+/* --- Statistics --- */
+
+extern statcounter_t jit_loops_compiled;
+extern statcounter_t jit_loops_failed;
+extern statcounter_t jit_runs;
+extern size_t jit_code_size;
+
+#endif /* JIT_H__ */
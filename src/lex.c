@@ -47,6 +47,7 @@
 #include "hash.h"
 #include "instrs.h"
 #include "interpret.h"
+#include "jit.h"
 #include "lang.h"
 #include "main.h"
 #include "mempools.h"
@@ -199,6 +200,15 @@ Bool pragma_rtt_checks;
   /* True: enable runtime type checks for this program
    */
 
+Bool pragma_optimize;
+  /* True: run the optimizer over the function bodies (see prolang.y).
+   */
+
+Bool lex_used_boot_time;
+  /* True: the program used __BOOT_TIME__, its code is valid only for
+   * this boot (see prog_cache.c).
+   */
+
 string_t *last_lex_string;
   /* When lexing string literals, this is the (shared) string lexed
    * so far. It is used to pass string values to lang.c and may be
@@ -231,6 +241,9 @@ typedef struct source_s
     int        fd;       /* Filedescriptor or -1 */
     string_t * str;      /* The source string (referenced), or NULL */
     size_t     current;  /* Current position in .str */
+    Bool       is_file;  /* TRUE if the source is a file, even if it is
+                          * read from the include cache as string.
+                          */
 } source_t;
 
 static source_t yyin;
@@ -440,6 +453,148 @@ static struct incstate
 
 /*-------------------------------------------------------------------------*/
 
+/* The include cache.
+ *
+ * Most objects include the same header files, so the lexer keeps the
+ * text of the included files in memory. It is validated against the file
+ * on each use; files modified in the current second aren't cached at all,
+ * as their mtime doesn't prove their content. The include files are
+ * still searched for as before, so that a new header in an earlier
+ * H_INCLUDE_DIRS directory is found at once.
+ *
+ * Most headers do nothing but (un)define macros and include other
+ * headers. For these the lexer also records which macros the header
+ * looked at and what it defined, and when the header is included again
+ * in the same situation, these effects are replayed instead of lexing the
+ * file again. A recording is abandoned if the header produces tokens,
+ * uses #pragma, #line, #echo or dynamic macros, causes a warning or error,
+ * ends an #if it didn't start, or gets an auto-include string.
+ *
+ * A recording is a list of events:
+ *   IE_QUERY:  macro <name> was looked up: it was undefined (<text> is NULL)
+ *              or defined with <nargs> and <text>, or dynamic.
+ *   IE_DEFINE: macro <name> was defined with <nargs> and <text> in <line>.
+ *   IE_UNDEF:  macro <name> was undefined.
+ *   IE_START:  the file <text> was included as <name> in <line>, the file
+ *              had the given <mtime> and <size>.
+ *   IE_END:    the last started include ended.
+ *
+ * Only the first query of each macro is recorded, as the later states are
+ * determined by the header itself.
+ */
+
+#define INC_CACHE_SIZE  256
+  /* Number of hash chains for files, must be a power of 2.
+   */
+
+#define INC_CACHE_MAX_FILE  (256 * 1024)
+  /* Files bigger than this are not cached.
+   */
+
+#define INC_CACHE_MAX_TEXT  (8 * 1024 * 1024)
+  /* Maximum total size of the cached texts. When it is exceeded,
+   * the cache is flushed.
+   */
+
+#define INC_CACHE_VARIANTS  4
+  /* Maximum number of recordings kept per file (eg. for the first
+   * and the guarded second include of a header).
+   */
+
+enum inc_event_type
+{
+    IE_QUERY, IE_DEFINE, IE_UNDEF, IE_START, IE_END
+};
+
+/* IE_QUERY states */
+
+#define IQ_UNDEFINED 0
+#define IQ_DEFINED   1
+#define IQ_SPECIAL   2
+
+typedef struct inc_event_s   inc_event_t;
+typedef struct inc_variant_s inc_variant_t;
+typedef struct inc_file_s    inc_file_t;
+typedef struct inc_record_s  inc_record_t;
+
+struct inc_event_s
+{
+    inc_event_t *next;
+    char         type;   /* IE_xxx */
+    char         state;  /* IE_QUERY: IQ_xxx, IE_START: the delimiter */
+    short        nargs;  /* IE_QUERY, IE_DEFINE: number of macro args */
+    int          line;   /* IE_DEFINE, IE_START: line in the header */
+    int64_t      mtime;  /* IE_START: modification time of the file */
+    int64_t      size;   /* IE_START: size of the file */
+    char        *name;   /* Macro or include name */
+    char        *text;   /* Macro text or file name, or NULL.
+                          * <name> and <text> are allocated with the event.
+                          */
+};
+
+struct inc_variant_s
+{
+    inc_variant_t *next;
+    inc_event_t   *events;  /* The recorded events */
+    int            lines;   /* Number of lines lexed for the recording */
+    int            depth;   /* Maximum nesting of includes in <events> */
+};
+
+struct inc_file_s
+{
+    inc_file_t    *next;      /* Next file in the hash chain */
+    int64_t        mtime;     /* Modification time of the file */
+    int64_t        size;      /* Size of the file */
+    string_t      *text;      /* The text of the file, or NULL */
+    inc_variant_t *variants;  /* The recordings of the file */
+    Bool           impure;    /* TRUE: the file can't be replayed */
+    char           path[1];   /* The filename, allocated with the entry */
+};
+
+struct inc_record_s
+{
+    inc_record_t    *prev;      /* The next outer recording */
+    struct incstate *inc;       /* The include being recorded */
+    lpc_ifstate_t   *iftop;     /* The #if state at the start */
+    int              problems;  /* Number of errors and warnings at the start */
+    int              lines;     /* total_lines at the start */
+    int              level;     /* Current nesting of includes */
+    int              depth;     /* Maximum nesting of includes */
+    Bool             impure;    /* TRUE: the file did more than defines */
+    Bool             discard;   /* TRUE: the recording can't be used */
+    int64_t          mtime;     /* Modification time of the file */
+    int64_t          size;      /* Size of the file */
+    inc_event_t     *first;     /* The recorded events */
+    inc_event_t    **last;      /* Where to append the next event */
+    char             path[1];   /* The filename, allocated with the record */
+};
+
+static inc_file_t *inc_files[INC_CACHE_SIZE];
+  /* The cached files.
+   */
+
+static size_t inc_cache_text_size = 0;
+  /* Total size of the cached texts.
+   */
+
+static inc_record_t *inc_records = NULL;
+  /* The active recordings, innermost first.
+   */
+
+statcounter_t inc_cache_hits = 0;
+  /* Number of includes which were read from the cache or replayed.
+   */
+
+statcounter_t inc_cache_misses = 0;
+  /* Number of includes which had to be read from the file.
+   */
+
+statcounter_t inc_cache_replays = 0;
+  /* Number of includes which were replayed.
+   */
+
+/*-------------------------------------------------------------------------*/
+
 /* Translation table of reserved words into the lexcodes assigned by yacc
  * in lang.h.
  */
@@ -612,6 +767,7 @@ static char *get_current_file(char **);
 static char *get_current_line(char **);
 static char *get_current_function(char **);
 static char *get_version(char **);
+static char *get_boot_time(char **);
 static char *get_hostname(char **);
 static char *get_domainname(char **);
 static char *get_current_dir(char **);
@@ -620,6 +776,8 @@ static char *efun_defined(char **);
 static void lexerrorf VARPROT((char *, ...), printf, 1, 2);
 static void lexerror(char *);
 static ident_t *lookup_define(char *);
+static ident_t *find_define(char *);
+static void undefine_macro(char *);
 
 /*-------------------------------------------------------------------------*/
 
@@ -807,6 +965,9 @@ init_lexer(void)
 #ifdef USE_MCCP
     add_permanent_define("__MCCP__", -1, string_copy("1"), MY_FALSE);
 #endif
+#ifdef JIT_ENABLED
+    add_permanent_define("__JIT__", -1, string_copy("1"), MY_FALSE);
+#endif
 #ifdef USE_MYSQL
     add_permanent_define("__MYSQL__", -1, string_copy("1"), MY_FALSE);
 #endif
@@ -828,6 +989,9 @@ init_lexer(void)
     add_permanent_define("__LPC_NOSAVE__", -1, string_copy("1"), MY_FALSE);
 #ifdef USE_DEPRECATED
     add_permanent_define("__DEPRECATED__", -1, string_copy("1"), MY_FALSE);
+#endif
+#ifdef USE_CYCLE_COLLECTOR
+    add_permanent_define("__CYCLE_COLLECTOR__", -1, string_copy("1"), MY_FALSE);
 #endif
     add_permanent_define("__LPC_STRUCTS__", -1, string_copy("1"), MY_FALSE);
     add_permanent_define("__LPC_INLINE_CLOSURES__", -1, string_copy("1"), MY_FALSE);
@@ -873,8 +1037,7 @@ init_lexer(void)
     add_permanent_define("__FLOAT_MAX__", -1, string_copy(mtext), MY_FALSE);
     sprintf(mtext, "(%g)", DBL_MIN);
     add_permanent_define("__FLOAT_MIN__", -1, string_copy(mtext), MY_FALSE);
-    sprintf(mtext, "%"PRIdMPINT, get_current_time());
-    add_permanent_define("__BOOT_TIME__", -1, string_copy(mtext), MY_FALSE);
+    add_permanent_define("__BOOT_TIME__", -1, (void *)get_boot_time, MY_TRUE);
 
     /* Add the permanent macro definitions given on the commandline */
 
@@ -2073,16 +2236,18 @@ realloc_defbuf (void)
 
 /*-------------------------------------------------------------------------*/
 static void
-set_input_source (int fd, string_t * str)
+set_input_source (int fd, string_t * str, Bool is_file)
 
 /* Set the current input source to <fd>/<str>.
- * If <str> is given, it will be referenced.
+ * If <str> is given, it will be referenced. <is_file> tells if the
+ * source is the text of a file.
  */
 
 {
     yyin.fd = fd;
     yyin.str = str ? ref_mstring(str) : NULL;
     yyin.current = 0;
+    yyin.is_file = is_file;
 } /* set_input_source() */
 
 /*-------------------------------------------------------------------------*/
@@ -2096,6 +2261,7 @@ close_input_source (void)
     if (yyin.fd != -1)    close(yyin.fd);         yyin.fd = -1;
     if (yyin.str != NULL) free_mstring(yyin.str); yyin.str = NULL;
     yyin.current = 0;
+    yyin.is_file = MY_FALSE;
 } /* close_input_source() */
 
 /*-------------------------------------------------------------------------*/
@@ -2435,6 +2601,28 @@ handle_cond (Bool c)
     }
 } /* handle_cond() */
 
+/*-------------------------------------------------------------------------*/
+static void
+pop_ifstate (void)
+
+/* Remove the top entry from the ifstate-stack. A recording for the
+ * include cache which started inside this #if can't be used.
+ */
+
+{
+    lpc_ifstate_t *p = iftop;
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        if (rec->iftop == p)
+            rec->discard = MY_TRUE;
+    }
+
+    iftop = p->next;
+    mempool_free(lexpool, p);
+} /* pop_ifstate() */
+
 /*-------------------------------------------------------------------------*/
 static Bool
 start_new_include (int fd, string_t * str
@@ -2532,34 +2720,34 @@ start_new_include (int fd, string_t * str
     linebufend   = outp - 1; /* allow trailing zero */
     linebufstart = linebufend - MAXLINE;
     *(outp = linebufend) = '\0';
-    set_input_source(fd, str);
+    set_input_source(fd, str, name_ext == NULL);
     _myfilbuf();
 
     return MY_TRUE;
 } /* start_new_include() */
 
 /*-------------------------------------------------------------------------*/
-static void
-add_auto_include (const char * obj_file, const char *cur_file, Bool sys_include)
+string_t *
+get_auto_include_string (const char * obj_file, const char *cur_file
+                        , Bool sys_include)
 
-/* A new file <cur_file> was opened while compiling object <object_file>.
- * Add the auto-include information if available.
+/* Return the auto-include string for <cur_file> while compiling object
+ * <obj_file>, or NULL if there is none.
  *
- * If <cur_file> is NULL, then the <object_file> itself has just been
+ * If <cur_file> is NULL, then the <obj_file> itself has just been
  * opened, otherwise <cur_file> is an included file. In the latter case,
  * flag <sys_include> purveys if it was a <>-type include.
  *
- * The global <current_loc.line> must be valid and will be modified.
+ * The result is not counted and only valid until the next call of an
+ * LPC closure.
  */
 
 {
-    string_t * auto_include_string = NULL;
-
     if (driver_hook[H_AUTO_INCLUDE].type == T_STRING
      && cur_file == NULL
        )
     {
-        auto_include_string = driver_hook[H_AUTO_INCLUDE].u.str;
+        return driver_hook[H_AUTO_INCLUDE].u.str;
     }
     else if (driver_hook[H_AUTO_INCLUDE].type == T_CLOSURE)
     {
@@ -2580,25 +2768,43 @@ add_auto_include (const char * obj_file, const char *cur_file, Bool sys_include)
         svp = secure_apply_lambda(driver_hook+H_AUTO_INCLUDE, 3);
         if (svp && svp->type == T_STRING)
         {
-            auto_include_string = svp->u.str;
+            return svp->u.str;
         }
     }
 
+    return NULL;
+} /* get_auto_include_string() */
+
+/*-------------------------------------------------------------------------*/
+static void
+add_auto_include (string_t * auto_include_string, Bool is_include)
+
+/* A new file was opened, add its auto-include string
+ * <auto_include_string> (as returned by get_auto_include_string()),
+ * which may be NULL.
+ *
+ * <is_include> is FALSE if the object file itself has just been opened,
+ * and TRUE for an included file.
+ *
+ * The global <current_loc.line> must be valid and will be modified.
+ */
+
+{
     if (auto_include_string != NULL)
     {
         /* The auto include string is handled like a normal include */
-        if (cur_file != NULL)   /* Otherwise we already are at line 1 */
+        if (is_include)         /* Otherwise we already are at line 1 */
             current_loc.line++; /* Make sure to restore to line 1 */
         (void)start_new_include(-1, auto_include_string
                                , current_loc.file->name, "auto include", ')');
-        if (cur_file == NULL)   /* Otherwise #include will increment it */
+        if (!is_include)        /* Otherwise #include will increment it */
             current_loc.line++; /* Make sure to start at line 1 */
     }
 } /* add_auto_include() */
 
 /*-------------------------------------------------------------------------*/
 static void
-merge (char *name, mp_int namelen, char *deststart)
+merge (char *name, mp_int namelen, const char *currentfile, char *deststart)
 
 /* Take the given include file <name> of length <namelen>, make it
  * a proper absolute pathname and store it into the buffer <deststart>.
@@ -2631,10 +2837,11 @@ merge (char *name, mp_int namelen, char *deststart)
     {
         /* relative path */
 
-        char *cp, *dp;
+        const char *cp;
+        char *dp;
 
         dest = (dp = deststart) - 1;
-        for (cp = current_loc.file->name; *cp; *dp++ = *cp++)
+        for (cp = currentfile; *cp; *dp++ = *cp++)
         {
             if (*cp == '/')
                 dest = dp;
@@ -2715,15 +2922,19 @@ merge (char *name, mp_int namelen, char *deststart)
 } /* merge() */
 
 /*-------------------------------------------------------------------------*/
-static int
-open_include_file (char *buf, char *name, mp_int namelen, char delim)
+static char *
+find_include_file (char *buf, char *name, mp_int namelen, char delim
+                  , const char *cur_file, struct stat *pStat)
 
-/* Open the include file <name> (length <namelen>) and return the file
- * descriptor. On failure, generate an error message and return -1.
+/* Find the include file <name> (length <namelen>), included from file
+ * <cur_file>, and return the name of the file to open, with its status
+ * in *<pStat>. On failure, generate an error message if necessary and
+ * return NULL.
  *
- * <buf> is a buffer of size INC_OPEN_BUFSIZE and may be used to
+ * <buf> is a buffer of size INC_OPEN_BUFSIZE and is used to
  * generate the real filename - <name> is just the name given in the
- * #include statement.
+ * #include statement. The result points into <buf>, which holds the name
+ * for the source location.
  *
  * <delim> is '"' for #include ""-type includes, and '>' else.
  * Relative "-includes are searched relative to the current file.
@@ -2732,9 +2943,7 @@ open_include_file (char *buf, char *name, mp_int namelen, char delim)
  */
 
 {
-    int fd;
-    int i;
-    struct stat aStat;
+    size_t i;
 
     /* First, try to call master->include_file().
      * Since simulate::load_object() makes sure that the master has been
@@ -2751,13 +2960,13 @@ open_include_file (char *buf, char *name, mp_int namelen, char delim)
         if (!compat_mode)
         {
             char * filename;
-            filename = alloca(strlen(current_loc.file->name)+2);
+            filename = alloca(strlen(cur_file)+2);
             *filename = '/';
-            strcpy(filename+1, current_loc.file->name);
+            strcpy(filename+1, cur_file);
             push_c_string(inter_sp, filename);
         }
         else
-            push_c_string(inter_sp, current_loc.file->name);
+            push_c_string(inter_sp, (char *)cur_file);
 
         push_number(inter_sp, (delim == '"') ? 0 : 1);
         res = apply_master(STR_INCLUDE_FILE, 3);
@@ -2773,163 +2982,862 @@ open_include_file (char *buf, char *name, mp_int namelen, char delim)
             if (res->type != T_STRING)
             {
                 yyerrorf("Illegal to include file '%s'.", name);
-                return -1;
+                return NULL;
             }
 
             if (mstrsize(res->u.str) >= INC_OPEN_BUFSIZE)
             {
                 yyerrorf("Include name '%s' too long.", get_txt(res->u.str));
-                return -1;
+                return NULL;
+            }
+
+            for (cp = get_txt(res->u.str); *cp == '/'; cp++) NOOP;
+
+            if (!legal_path(cp))
+            {
+                yyerrorf("Illegal path '%s'.", get_txt(res->u.str));
+                return NULL;
+            }
+
+            strcpy(buf, cp);
+            if (!stat(buf, pStat) && S_ISREG(pStat->st_mode))
+                return buf;
+
+            /* If we come here, we fail: file not found */
+            return NULL;
+        }
+    }
+    else if (EVALUATION_TOO_LONG())
+    {
+        yyerrorf("Can't call master::%s for '%s': eval cost too big"
+                , get_txt(STR_INCLUDE_FILE), name);
+    }
+
+    /* The master apply didn't succeed, try the manual handling */
+
+    if (delim == '"') /* It's a "-include */
+    {
+        /* Merge the <name> with the current filename. */
+        merge(name, namelen, cur_file, buf);
+
+        /* Test the file */
+        if (!stat(buf, pStat) && S_ISREG(pStat->st_mode))
+            return buf;
+
+        /* Include not found - fall back onto <> search pattern */
+    }
+
+    /* Handle a '<'-include. */
+
+    if (driver_hook[H_INCLUDE_DIRS].type == T_POINTER)
+    {
+        char * cp;
+        char * iname;
+
+        /* H_INCLUDE_DIRS is a vector of include directories.
+         */
+
+        if (namelen + inc_list_maxlen >= INC_OPEN_BUFSIZE)
+        {
+            yyerror("Include name too long.");
+            return NULL;
+        }
+
+        for (cp = name; *cp == '/'; cp++) NOOP;
+
+        /* The filename must not specifiy parent directories */
+        if (!check_no_parentdirs(cp))
+            return NULL;
+
+        /* Search all include dirs specified.
+         */
+        for (i = 0; i < inc_list_size; i++)
+        {
+            sprintf(buf, "%s%s", get_txt(inc_list[i].u.str), name);
+            for (iname = buf; *iname == '/'; iname++) NOOP;
+            if (!stat(iname, pStat) && S_ISREG(pStat->st_mode))
+                return iname;
+        }
+
+        /* If we come here, the include file was not found */
+    }
+    else if (driver_hook[H_INCLUDE_DIRS].type == T_CLOSURE)
+    {
+        /* H_INCLUDE_DIRS is a function generating the full
+         * include file name.
+         */
+
+        svalue_t *svp;
+
+        /* Setup and call the closure */
+        push_c_string(inter_sp, name);
+        push_c_string(inter_sp, (char *)cur_file);
+        if (driver_hook[H_INCLUDE_DIRS].x.closure_type == CLOSURE_LAMBDA)
+        {
+            free_object(driver_hook[H_INCLUDE_DIRS].u.lambda->ob, "find_include_file");
+            driver_hook[H_INCLUDE_DIRS].u.lambda->ob = ref_object(current_object, "find_include_file");
+        }
+        svp = secure_apply_lambda(&driver_hook[H_INCLUDE_DIRS], 2);
+
+        /* The result must be legal relative pathname */
+
+        if (svp && svp->type == T_STRING
+         && mstrsize(svp->u.str) < INC_OPEN_BUFSIZE)
+        {
+            char * cp;
+
+            for (cp = get_txt(svp->u.str); *cp == '/'; cp++) NOOP;
+            strcpy(buf, cp);
+            if (legal_path(buf)
+             && !stat(buf, pStat) && S_ISREG(pStat->st_mode))
+                return buf;
+        }
+
+        /* If we come here, the include file was not found */
+    }
+
+    /* File not found */
+    return NULL;
+} /* find_include_file() */
+
+/*-------------------------------------------------------------------------*/
+static void
+free_inc_events (inc_event_t *ev)
+
+/* Free the list of include cache events <ev>.
+ */
+
+{
+    while (ev != NULL)
+    {
+        inc_event_t *next = ev->next;
+
+        xfree(ev);
+        ev = next;
+    }
+} /* free_inc_events() */
+
+/*-------------------------------------------------------------------------*/
+static void
+free_inc_variants (inc_variant_t *var)
+
+/* Free the list of recordings <var>.
+ */
+
+{
+    while (var != NULL)
+    {
+        inc_variant_t *next = var->next;
+
+        free_inc_events(var->events);
+        xfree(var);
+        var = next;
+    }
+} /* free_inc_variants() */
+
+/*-------------------------------------------------------------------------*/
+static void
+flush_inc_files (void)
+
+/* Remove all files from the include cache.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < INC_CACHE_SIZE; i++)
+    {
+        inc_file_t *f, *next;
+
+        for (f = inc_files[i]; f != NULL; f = next)
+        {
+            next = f->next;
+            if (f->text != NULL)
+                free_mstring(f->text);
+            free_inc_variants(f->variants);
+            xfree(f);
+        }
+        inc_files[i] = NULL;
+    }
+    inc_cache_text_size = 0;
+} /* flush_inc_files() */
+
+/*-------------------------------------------------------------------------*/
+static inc_file_t *
+find_inc_file (const char *path, int64_t mtime, int64_t size, Bool create)
+
+/* Return the include cache entry for the file <path>, which has the
+ * modification time <mtime> and the size <size>. The data of an entry for
+ * a different version of the file is discarded. If there is no entry and
+ * <create> is TRUE, a new one is created.
+ *
+ * Result is NULL if there is no entry (or not enough memory).
+ */
+
+{
+    inc_file_t *f, **chain;
+
+    chain = &inc_files[hashmem32(path, strlen(path)) & (INC_CACHE_SIZE-1)];
+    for (f = *chain; f != NULL; f = f->next)
+    {
+        if (!strcmp(f->path, path))
+            break;
+    }
+
+    if (f != NULL)
+    {
+        if (f->mtime != mtime || f->size != size)
+        {
+            /* The file changed */
+            if (f->text != NULL)
+            {
+                inc_cache_text_size -= mstrsize(f->text);
+                free_mstring(f->text);
+                f->text = NULL;
+            }
+            free_inc_variants(f->variants);
+            f->variants = NULL;
+            f->impure = MY_FALSE;
+            f->mtime = mtime;
+            f->size = size;
+        }
+        return f;
+    }
+
+    if (!create)
+        return NULL;
+
+    f = xalloc(sizeof(*f) + strlen(path));
+    if (f == NULL)
+        return NULL;
+
+    f->mtime = mtime;
+    f->size = size;
+    f->text = NULL;
+    f->variants = NULL;
+    f->impure = MY_FALSE;
+    strcpy(f->path, path);
+
+    f->next = *chain;
+    *chain = f;
+    return f;
+} /* find_inc_file() */
+
+/*-------------------------------------------------------------------------*/
+static string_t *
+read_inc_file (inc_file_t *file, int fd)
+
+/* Read the text of the cached <file> from <fd> and keep it in the cache.
+ * Return the text, or NULL if the file isn't cached; <fd> is still at
+ * the beginning of the file then.
+ */
+
+{
+    string_t *text;
+    size_t size;
+
+    size = (size_t)file->size;
+    if (size > INC_CACHE_MAX_FILE)
+        return NULL;
+
+    text = alloc_mstring(size);
+    if (text == NULL)
+        return NULL;
+
+    if (read(fd, get_txt(text), size) != (ssize_t)size)
+    {
+        free_mstring(text);
+        lseek(fd, 0, SEEK_SET);
+        return NULL;
+    }
+
+    file->text = text;
+    inc_cache_text_size += size;
+    return text;
+} /* read_inc_file() */
+
+/*-------------------------------------------------------------------------*/
+static inc_event_t *
+add_inc_event (inc_record_t *rec, char type, const char *name, const char *text)
+
+/* Add an event of <type> with <name> and <text> (both may be NULL) to the
+ * recording <rec> and return it. If there is not enough memory, the
+ * recording is discarded and NULL is returned.
+ */
+
+{
+    inc_event_t *ev;
+    size_t nlen, tlen;
+
+    nlen = name ? strlen(name)+1 : 0;
+    tlen = text ? strlen(text)+1 : 0;
+
+    ev = xalloc(sizeof(*ev) + nlen + tlen);
+    if (ev == NULL)
+    {
+        rec->discard = MY_TRUE;
+        return NULL;
+    }
+
+    ev->next = NULL;
+    ev->type = type;
+    ev->state = 0;
+    ev->nargs = 0;
+    ev->line = 0;
+    ev->mtime = 0;
+    ev->size = 0;
+    ev->name = name ? memcpy((char *)(ev+1), name, nlen) : NULL;
+    ev->text = text ? memcpy((char *)(ev+1) + nlen, text, tlen) : NULL;
+
+    *rec->last = ev;
+    rec->last = &ev->next;
+    return ev;
+} /* add_inc_event() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+inc_record_knows (inc_record_t *rec, const char *name)
+
+/* Return TRUE if the recording <rec> already queried or changed the
+ * macro <name>.
+ */
+
+{
+    inc_event_t *ev;
+
+    for (ev = rec->first; ev != NULL; ev = ev->next)
+    {
+        if ((ev->type == IE_QUERY || ev->type == IE_DEFINE || ev->type == IE_UNDEF)
+         && !strcmp(ev->name, name))
+            return MY_TRUE;
+    }
+    return MY_FALSE;
+} /* inc_record_knows() */
+
+/*-------------------------------------------------------------------------*/
+static void
+record_inc_query (const char *name, ident_t *p)
+
+/* The macro <name> was looked up, <p> is its definition or NULL.
+ * Record this in the active recordings which don't know the macro yet.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        inc_event_t *ev;
+
+        if (rec->impure || rec->discard || inc_record_knows(rec, name))
+            continue;
+
+        if (p == NULL)
+        {
+            if ((ev = add_inc_event(rec, IE_QUERY, name, NULL)) != NULL)
+                ev->state = IQ_UNDEFINED;
+        }
+        else if (p->u.define.special)
+        {
+            if ((ev = add_inc_event(rec, IE_QUERY, name, NULL)) != NULL)
+            {
+                ev->state = IQ_SPECIAL;
+                ev->nargs = p->u.define.nargs;
+            }
+        }
+        else
+        {
+            if ((ev = add_inc_event(rec, IE_QUERY, name, p->u.define.exps.str)) != NULL)
+            {
+                ev->state = IQ_DEFINED;
+                ev->nargs = p->u.define.nargs;
+            }
+        }
+    }
+} /* record_inc_query() */
+
+/*-------------------------------------------------------------------------*/
+static void
+record_inc_define (const char *name, short nargs, const char *exps)
+
+/* Record the definition of macro <name> with <nargs> and <exps> in the
+ * current line in the active recordings.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        inc_event_t *ev;
+
+        if (rec->impure || rec->discard)
+            continue;
+
+        if ((ev = add_inc_event(rec, IE_DEFINE, name, exps)) != NULL)
+        {
+            ev->nargs = nargs;
+            ev->line = current_loc.line;
+        }
+    }
+} /* record_inc_define() */
+
+/*-------------------------------------------------------------------------*/
+static void
+record_inc_undef (const char *name)
+
+/* Record the #undef of macro <name> in the active recordings.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        if (!rec->impure && !rec->discard)
+            (void)add_inc_event(rec, IE_UNDEF, name, NULL);
+    }
+} /* record_inc_undef() */
+
+/*-------------------------------------------------------------------------*/
+static void
+record_inc_start (const char *name, const char *path, char delim
+                 , int64_t mtime, int64_t size)
+
+/* Record in the active recordings that the file <path> with <mtime> and
+ * <size> is included in the current line as <name> with delimiter <delim>.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        inc_event_t *ev;
+
+        if (rec->impure || rec->discard)
+            continue;
+
+        if ((ev = add_inc_event(rec, IE_START, name, path)) != NULL)
+        {
+            ev->state = delim;
+            ev->line = current_loc.line;
+            ev->mtime = mtime;
+            ev->size = size;
+        }
+        if (++rec->level > rec->depth)
+            rec->depth = rec->level;
+    }
+} /* record_inc_start() */
+
+/*-------------------------------------------------------------------------*/
+static void
+record_inc_end (void)
+
+/* Record the end of the last started include in the active recordings.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        if (rec->impure || rec->discard)
+            continue;
+
+        (void)add_inc_event(rec, IE_END, NULL, NULL);
+        rec->level--;
+    }
+} /* record_inc_end() */
+
+/*-------------------------------------------------------------------------*/
+static void
+taint_inc_records (Bool impure)
+
+/* The current file did something which can't be replayed. If <impure>
+ * is TRUE, this is a property of the files being recorded, else their
+ * recordings are just unusable this time.
+ */
+
+{
+    inc_record_t *rec;
+
+    for (rec = inc_records; rec != NULL; rec = rec->prev)
+    {
+        if (impure)
+            rec->impure = MY_TRUE;
+        else
+            rec->discard = MY_TRUE;
+    }
+} /* taint_inc_records() */
+
+/*-------------------------------------------------------------------------*/
+static void
+start_inc_record (const char *path, struct stat *st)
+
+/* The file <path> with status <st> has been pushed onto the include stack,
+ * start recording its effects.
+ */
+
+{
+    inc_record_t *rec;
+
+    rec = xalloc(sizeof(*rec) + strlen(path));
+    if (rec == NULL)
+        return;
+
+    rec->prev = inc_records;
+    rec->inc = inctop;
+    rec->iftop = iftop;
+    rec->problems = num_parse_error + num_parse_warning;
+    rec->lines = total_lines;
+    rec->level = 0;
+    rec->depth = 0;
+    rec->impure = MY_FALSE;
+    rec->discard = MY_FALSE;
+    rec->mtime = (int64_t)st->st_mtime;
+    rec->size = (int64_t)st->st_size;
+    rec->first = NULL;
+    rec->last = &rec->first;
+    strcpy(rec->path, path);
+
+    inc_records = rec;
+} /* start_inc_record() */
+
+/*-------------------------------------------------------------------------*/
+static void
+end_inc_record (Bool complete)
+
+/* End the innermost recording. If <complete> is TRUE, the file was lexed
+ * to its end, and the recording is stored in the cache if it is usable.
+ */
+
+{
+    inc_record_t *rec;
+    inc_file_t *file;
+
+    rec = inc_records;
+    inc_records = rec->prev;
+
+    file = complete ? find_inc_file(rec->path, rec->mtime, rec->size, MY_FALSE)
+                    : NULL;
+
+    if (file != NULL && rec->impure)
+    {
+        file->impure = MY_TRUE;
+        free_inc_variants(file->variants);
+        file->variants = NULL;
+    }
+    else if (file != NULL && !rec->discard
+          && rec->level == 0
+          && rec->iftop == iftop
+          && rec->problems == num_parse_error + num_parse_warning)
+    {
+        inc_variant_t *var;
+
+        var = xalloc(sizeof(*var));
+        if (var != NULL)
+        {
+            inc_variant_t **pp;
+            int num;
+
+            var->events = rec->first;
+            var->lines = total_lines - rec->lines - 1;
+            var->depth = rec->depth;
+            var->next = file->variants;
+            file->variants = var;
+            rec->first = NULL;
+
+            /* Forget the oldest recording if there are too many */
+            for (pp = &file->variants, num = 0; *pp; pp = &(*pp)->next)
+            {
+                if (++num > INC_CACHE_VARIANTS)
+                {
+                    free_inc_variants(*pp);
+                    *pp = NULL;
+                    break;
+                }
+            }
+        }
+    }
+
+    free_inc_events(rec->first);
+    xfree(rec);
+} /* end_inc_record() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+replay_matches (inc_variant_t *var, const char *path)
+
+/* Check if the recording <var> of the file <path> (the name used for
+ * the source location) can be replayed in the current situation: the
+ * macros it queried must still be the same, and its includes must still
+ * find the same, unchanged files.
+ */
+
+{
+    inc_event_t *ev;
+    const char **files;
+    int level;
+    char buf[INC_OPEN_BUFSIZE];
+
+    /* The names of the files including the files of IE_START events */
+    files = alloca((var->depth + 1) * sizeof(*files));
+    files[0] = path;
+    level = 0;
+
+    for (ev = var->events; ev != NULL; ev = ev->next)
+    {
+        switch (ev->type)
+        {
+        case IE_QUERY:
+          {
+            ident_t *p = find_define(ev->name);
+
+            if (p == NULL)
+            {
+                if (ev->state != IQ_UNDEFINED)
+                    return MY_FALSE;
             }
+            else if (p->u.define.special)
+            {
+                if (ev->state != IQ_SPECIAL || ev->nargs != p->u.define.nargs)
+                    return MY_FALSE;
+            }
+            else if (ev->state != IQ_DEFINED
+                  || ev->nargs != p->u.define.nargs
+                  || strcmp(ev->text, p->u.define.exps.str))
+                return MY_FALSE;
+            break;
+          }
+
+        case IE_START:
+          {
+            struct stat st;
+
+            if (NULL == find_include_file(buf, ev->name, (mp_int)strlen(ev->name)
+                                         , ev->state, files[level], &st)
+             || strcmp(buf, ev->text)
+             || (int64_t)st.st_mtime != ev->mtime
+             || (int64_t)st.st_size != ev->size
+             || NULL != get_auto_include_string(object_file, ev->text
+                                               , ev->state != '"')
+               )
+                return MY_FALSE;
+            files[++level] = ev->text;
+            break;
+          }
+
+        case IE_END:
+            level--;
+            break;
+        }
+    }
+
+    return MY_TRUE;
+} /* replay_matches() */
+
+/*-------------------------------------------------------------------------*/
+static void
+replay_variant (inc_variant_t *var, char *path, char delim)
+
+/* Replay the recording <var> of the file <path>, which is included with
+ * delimiter <delim>: store the include information and apply the macro
+ * definitions, just as lexing the file would.
+ */
+
+{
+    struct replay_inc_s {
+        mp_uint      offset;  /* Handle returned by store_include_info() */
+        source_loc_t loc;     /* Location of the #include */
+    } *stack;
+    source_file_t *src;
+    struct incstate *ip;
+    inc_event_t *ev;
+    int depth, level;
+
+    for (depth = 1, ip = inctop; ip != NULL; ip = ip->next)
+        depth++;
+
+    src = new_source_file(path, &current_loc);
+    if (src == NULL)
+    {
+        lexerror("Out of memory");
+        return;
+    }
 
-            for (cp = get_txt(res->u.str); *cp == '/'; cp++) NOOP;
+    stack = alloca((var->depth + 1) * sizeof(*stack));
+    level = 0;
+    stack[0].offset = store_include_info(path, path, delim, depth);
+    stack[0].loc = current_loc;
+    current_loc.file = src;
+    current_loc.line = 0;
 
-            if (!legal_path(cp))
-            {
-                yyerrorf("Illegal path '%s'.", get_txt(res->u.str));
-                return -1;
-            }
+    for (ev = var->events; ev != NULL; ev = ev->next)
+    {
+        switch (ev->type)
+        {
+        case IE_QUERY:
+            if (inc_records)
+                record_inc_query(ev->name, find_define(ev->name));
+            break;
 
-            strcpy(buf, cp);
-            if (!stat(buf, &aStat)
-             && S_ISREG(aStat.st_mode)
-             && (fd = ixopen(buf, O_RDONLY|O_BINARY)) >= 0 )
+        case IE_DEFINE:
+            current_loc.line = ev->line;
+            add_define(ev->name, ev->nargs, ev->text, current_loc);
+            break;
+
+        case IE_UNDEF:
+            undefine_macro(ev->name);
+            break;
+
+        case IE_START:
+            current_loc.line = ev->line;
+            if (inc_records)
+                record_inc_start(ev->name, ev->text, ev->state
+                                , ev->mtime, ev->size);
+            level++;
+            stack[level].offset = store_include_info(ev->text, ev->text
+                                                    , ev->state, depth + level);
+            stack[level].loc = current_loc;
+            src = new_source_file(ev->text, &current_loc);
+            if (src == NULL)
             {
-                FCOUNT_INCL(buf);
-                return fd;
+                lexerror("Out of memory");
+                src = current_loc.file;
             }
-            if (errno == EMFILE) lexerror("File descriptors exhausted");
-#if ENFILE
-            if (errno == ENFILE) lexerror("File table overflow");
-#endif
+            current_loc.file = src;
+            current_loc.line = 0;
+            break;
 
-            /* If we come here, we fail: file not found */
-            return -1;
+        case IE_END:
+            store_include_end(stack[level].offset, stack[level].loc.line);
+            current_loc = stack[level].loc;
+            level--;
+            if (inc_records)
+                record_inc_end();
+            break;
         }
     }
-    else if (EVALUATION_TOO_LONG())
-    {
-        yyerrorf("Can't call master::%s for '%s': eval cost too big"
-                , get_txt(STR_INCLUDE_FILE), name);
-    }
 
-    /* The master apply didn't succeed, try the manual handling */
+    store_include_end(stack[0].offset, stack[0].loc.line);
+    current_loc = stack[0].loc;
+    total_lines += var->lines;
+} /* replay_variant() */
 
-    if (delim == '"') /* It's a "-include */
-    {
-        /* Merge the <name> with the current filename. */
-        merge(name, namelen, buf);
+/*-------------------------------------------------------------------------*/
+static void
+include_file (char *buf, char *fname, char *name, char delim, struct stat *st)
 
-        /* Test the file and open it */
-        if (!stat(buf, &aStat)
-         && S_ISREG(aStat.st_mode)
-         && (fd = ixopen(buf, O_RDONLY|O_BINARY)) >= 0)
-        {
-            FCOUNT_INCL(buf);
-            return fd;
-        }
+/* Include the file <fname> with status <st>, which was found for the
+ * #include <name> with delimiter <delim>. <buf> is the name of the file
+ * used for the source location.
+ *
+ * If possible, the effects of the file are replayed or its text is taken
+ * from the include cache. Otherwise the file is read, and kept in the
+ * cache if possible.
+ */
 
-        if (errno == EMFILE)
-            lexerror("File descriptors exhausted");
-#ifdef ENFILE
-        if (errno == ENFILE)
-            lexerror("File table overflow");
-#endif
-        /* Include not found - fall back onto <> search pattern */
-    }
+{
+    inc_file_t    *file = NULL;
+    inc_variant_t *var;
+    string_t      *auto_include;
+    string_t      *text = NULL;
+    int            fd = -1;
 
-    /* Handle a '<'-include. */
+    FCOUNT_INCL(fname);
 
-    if (driver_hook[H_INCLUDE_DIRS].type == T_POINTER)
+    /* A file modified in this second may change again without changing
+     * its mtime, so it can't be cached yet.
+     */
+    if (st->st_mtime < time(NULL))
     {
-        char * cp;
-
-        /* H_INCLUDE_DIRS is a vector of include directories.
-         */
-
-        if (namelen + inc_list_maxlen >= INC_OPEN_BUFSIZE)
+        file = find_inc_file(fname, st->st_mtime, st->st_size, MY_TRUE);
+        if (file != NULL && file->text == NULL
+         && st->st_size <= INC_CACHE_MAX_FILE
+         && inc_cache_text_size + st->st_size > INC_CACHE_MAX_TEXT)
         {
-            yyerror("Include name too long.");
-            return -1;
+            flush_inc_files();
+            file = find_inc_file(fname, st->st_mtime, st->st_size, MY_TRUE);
         }
+    }
+    else if (inc_records)
+        taint_inc_records(MY_FALSE);
 
-        for (cp = name; *cp == '/'; cp++) NOOP;
+    auto_include = get_auto_include_string(object_file, buf, delim != '"');
+    if (auto_include != NULL)
+    {
+        ref_mstring(auto_include);
+        if (inc_records)
+            taint_inc_records(MY_FALSE);
+    }
 
-        /* The filename must not specifiy parent directories */
-        if (!check_no_parentdirs(cp))
-            return -1;
+    if (inc_records)
+        record_inc_start(name, buf, delim, st->st_mtime, st->st_size);
 
-        /* Search all include dirs specified.
-         */
-        for (i = 0; (size_t)i < inc_list_size; i++)
+    /* Try to replay the file */
+    if (file != NULL && auto_include == NULL)
+    {
+        for (var = file->variants; var != NULL; var = var->next)
         {
-            char * iname;
-            sprintf(buf, "%s%s", get_txt(inc_list[i].u.str), name);
-            for (iname = buf; *iname == '/'; iname++) NOOP;
-            if (!stat(iname, &aStat)
-             && S_ISREG(aStat.st_mode)
-             && (fd = ixopen(iname, O_RDONLY|O_BINARY)) >= 0 )
+            if (replay_matches(var, buf))
             {
-                FCOUNT_INCL(iname);
-                return fd;
+                replay_variant(var, buf, delim);
+                inc_cache_hits++;
+                inc_cache_replays++;
+                if (inc_records)
+                    record_inc_end();
+                return;
             }
-            if (errno == EMFILE) lexerror("File descriptors exhausted");
-#if ENFILE
-            if (errno == ENFILE) lexerror("File table overflow");
-#endif
         }
+    }
 
-        /* If we come here, the include file was not found */
+    /* Get the text of the file */
+    if (file != NULL && file->text != NULL)
+    {
+        inc_cache_hits++;
+        text = file->text;
     }
-    else if (driver_hook[H_INCLUDE_DIRS].type == T_CLOSURE)
+    else
     {
-        /* H_INCLUDE_DIRS is a function generating the full
-         * include file name.
-         */
-
-        svalue_t *svp;
-
-        /* Setup and call the closure */
-        push_c_string(inter_sp, name);
-        push_c_string(inter_sp, current_loc.file->name);
-        if (driver_hook[H_INCLUDE_DIRS].x.closure_type == CLOSURE_LAMBDA)
+        inc_cache_misses++;
+        if ((fd = ixopen(fname, O_RDONLY|O_BINARY)) < 0)
         {
-            free_object(driver_hook[H_INCLUDE_DIRS].u.lambda->ob, "open_include_file");
-            driver_hook[H_INCLUDE_DIRS].u.lambda->ob = ref_object(current_object, "open_include_file");
+            if (errno == EMFILE) lexerror("File descriptors exhausted");
+#if ENFILE
+            if (errno == ENFILE) lexerror("File table overflow");
+#endif
+            yyerrorf("Cannot #include '%s'", name);
+            if (auto_include != NULL)
+                free_mstring(auto_include);
+            return;
         }
-        svp = secure_apply_lambda(&driver_hook[H_INCLUDE_DIRS], 2);
-
-        /* The result must be legal relative pathname */
 
-        if (svp && svp->type == T_STRING
-         && mstrsize(svp->u.str) < INC_OPEN_BUFSIZE)
+        if (file != NULL && (text = read_inc_file(file, fd)) != NULL)
         {
-            char * cp;
-
-            for (cp = get_txt(svp->u.str); *cp == '/'; cp++) NOOP;
-            strcpy(buf, cp);
-            if (legal_path(buf))
-            {
-                if (!stat(buf, &aStat)
-                 && S_ISREG(aStat.st_mode)
-                 && (fd = ixopen(buf, O_RDONLY|O_BINARY)) >= 0 )
-                {
-                    FCOUNT_INCL(buf);
-                    return fd;
-                }
-                if (errno == EMFILE) lexerror("File descriptors exhausted");
-#if ENFILE
-                if (errno == ENFILE) lexerror("File table overflow");
-#endif
-            }
+            close(fd);
+            fd = -1;
         }
+    }
 
-        /* If we come here, the include file was not found */
+    if (!start_new_include(fd, text, buf, NULL, delim))
+    {
+        if (fd >= 0)
+            close(fd);
+        if (auto_include != NULL)
+            free_mstring(auto_include);
+        return;
     }
 
-    /* File not found */
-    return -1;
-} /* open_include_file() */
+    if (file != NULL && !file->impure && auto_include == NULL)
+        start_inc_record(fname, st);
+
+    if (auto_include != NULL)
+    {
+        add_auto_include(auto_include, MY_TRUE);
+        free_mstring(auto_include);
+    }
+} /* include_file() */
 
 /*-------------------------------------------------------------------------*/
 void *
@@ -2955,7 +3863,8 @@ handle_include (char *name)
 
 {
     char *p;
-    int   fd;        /* fd of new include file */
+    char *fname;     /* Name of the include file to open */
+    struct stat aStat; /* Status of the include file */
     char  delim;     /* Filename end-delimiter ('"' or '>'). */
     char *old_outp;  /* Save the original outp */
     Bool  in_buffer = MY_FALSE; /* True if macro was expanded */
@@ -3119,11 +4028,10 @@ handle_include (char *name)
     /* Open the include file, put the current lexer state onto
      * the incstack, and set up for the new file.
      */
-    if ((fd = open_include_file(buf, name, p - name, delim)) >= 0)
+    if ((fname = find_include_file(buf, name, p - name, delim
+                                  , current_loc.file->name, &aStat)) != NULL)
     {
-        if (!start_new_include(fd, NULL, buf, NULL, delim))
-            return;
-        add_auto_include(object_file, current_loc.file->name, delim != '"');
+        include_file(buf, fname, name, delim, &aStat);
     }
     else
     {
@@ -3465,6 +4373,16 @@ handle_pragma (char *str)
             pragma_rtt_checks = MY_FALSE;
             validPragma = MY_TRUE;
         }
+        else if (strncmp(base, "optimize", namelen) == 0)
+        {
+            pragma_optimize = MY_TRUE;
+            validPragma = MY_TRUE;
+        }
+        else if (strncmp(base, "no_optimize", namelen) == 0)
+        {
+            pragma_optimize = MY_FALSE;
+            validPragma = MY_TRUE;
+        }
         else if (strncmp(base, "share_variables", namelen) == 0)
         {
             if (variables_defined)
@@ -4430,10 +5348,7 @@ handle_preprocessor_statement (char * in_yyp)
 
         if (iftop && iftop->state == EXPECT_ELSE)
         {
-            lpc_ifstate_t *p = iftop;
-
-            iftop = p->next;
-            mempool_free(lexpool, p);
+            pop_ifstate();
             skip_to("endif", NULL);
         }
         else
@@ -4445,10 +5360,7 @@ handle_preprocessor_statement (char * in_yyp)
     {
         if (iftop && iftop->state == EXPECT_ELSE)
         {
-            lpc_ifstate_t *p = iftop;
-
-            iftop = p->next;
-            mempool_free(lexpool, p);
+            pop_ifstate();
             skip_to("endif", NULL);
         }
         else
@@ -4470,10 +5382,7 @@ handle_preprocessor_statement (char * in_yyp)
          && (   iftop->state == EXPECT_ENDIF
              || iftop->state == EXPECT_ELSE))
         {
-            lpc_ifstate_t *p = iftop;
-
-            iftop = p->next;
-            mempool_free(lexpool, p);
+            pop_ifstate();
         }
         else
         {
@@ -4482,74 +5391,19 @@ handle_preprocessor_statement (char * in_yyp)
     }
     else if (strncmp("undef", yytext, wlen) == 0)
     {
-        ident_t *p, **q;
-        int h;
-
         deltrail(sp);
-
-        /* Lookup identifier <sp> in the ident_table and
-         * remove it there if it is a #define'd identifier.
-         * If it is a permanent define, park the ident
-         * structure in the undefined_permanent_defines list.
-         */
-        h = identhash(sp);
-        for (q = &ident_table[h]; NULL != ( p= *q); q=&p->next)
-        {
-            if (strcmp(sp, get_txt(p->name)))
-                continue;
-
-            if (p->type != I_TYPE_DEFINE) /* failure */
-                break;
-
-            if (!p->u.define.permanent)
-            {
-#if defined(LEXDEBUG)
-                fprintf(stderr, "%s #undef define '%s' %d '%s'\n"
-                       , time_stamp(), get_txt(p->name)
-                       , p->u.define.nargs
-                       , p->u.define.exps.str);
-                fflush(stderr);
-#endif
-                if (p->inferior)
-                {
-                    p->inferior->next = p->next;
-                    *q = p->inferior;
-                }
-                else
-                {
-                    *q = p->next;
-                }
-                xfree(p->u.define.exps.str);
-                free_mstring(p->name);
-                p->name = NULL;
-                    /* mark for later freeing by all_defines */
-                /* success */
-                break;
-           }
-           else
-           {
-                if (p->inferior)
-                {
-                    p->inferior->next = p->next;
-                    *q = p->inferior;
-                }
-                else
-                {
-                    *q = p->next;
-                }
-                p->next = undefined_permanent_defines;
-                undefined_permanent_defines = p;
-                /* success */
-                break;
-            }
-        }
+        undefine_macro(sp);
     }
     else if (strncmp("echo", yytext, wlen) == 0)
     {
+        if (inc_records)
+            taint_inc_records(MY_TRUE);
         fprintf(stderr, "%s %s\n", time_stamp(), sp);
     }
     else if (strncmp("pragma", yytext, wlen) == 0)
     {
+        if (inc_records)
+            taint_inc_records(MY_TRUE);
         handle_pragma(sp);
     }
     else if (strncmp("line", yytext, wlen) == 0)
@@ -4557,6 +5411,8 @@ handle_preprocessor_statement (char * in_yyp)
         char * end;
         long new_line;
 
+        if (inc_records)
+            taint_inc_records(MY_TRUE);
         deltrail(sp);
         new_line = strtol(sp, &end, 0);
         if (end == sp || *end != '\0')
@@ -4627,10 +5483,16 @@ yylex1 (void)
                  * file
                  */
                 struct incstate *p;
-                Bool was_string_source = (yyin.fd == -1);
+                Bool was_file = yyin.is_file;
 
                 p = inctop;
 
+                /* End the recording for the include cache */
+                if (inc_records && inc_records->inc == p)
+                    end_inc_record(MY_TRUE);
+                if (inc_records && was_file)
+                    record_inc_end();
+
                 /* End the lexing of the included file */
                 close_input_source();
                 nexpands = 0;
@@ -4638,7 +5500,7 @@ yylex1 (void)
 
                 /* Restore the previous state */
                 current_loc = p->loc;
-                if (!was_string_source)
+                if (was_file)
                     current_loc.line++;
 
                 yyin = p->yyin;
@@ -5287,6 +6149,8 @@ yylex1 (void)
             {
             case I_TYPE_DEFINE:
 
+                if (inc_records)
+                    taint_inc_records(MY_TRUE);
                 outp = yyp;
                 _expand_define(&p->u.define, p);
                 if (lex_fatal)
@@ -5361,6 +6225,8 @@ yylex (void)
     yytext[0] = '\0';
 #endif
     r = yylex1();
+    if (inc_records)
+        taint_inc_records(MY_TRUE);
 #ifdef LEXDEBUG
     fprintf(stderr, "%s lex=%d(%s) ", time_stamp(), r, yytext);
 #endif
@@ -5379,13 +6245,15 @@ start_new_file (int fd, const char * fname)
 {
     object_file = fname;
 
+    while (inc_records)
+        end_inc_record(MY_FALSE);
     cleanup_source_files();
     free_defines();
 
     current_loc.file = new_source_file(fname, NULL);
     current_loc.line = 1; /* already used in first _myfilbuf() */
 
-    set_input_source(fd, NULL);
+    set_input_source(fd, NULL, MY_TRUE);
 
     if (!defbuf_len)
     {
@@ -5398,6 +6266,7 @@ start_new_file (int fd, const char * fname)
     _myfilbuf();
 
     lex_fatal = MY_FALSE;
+    lex_used_boot_time = MY_FALSE;
 
     pragma_check_overloads = MY_TRUE;
     pragma_strict_types = PRAGMA_WEAK_TYPES;
@@ -5414,10 +6283,12 @@ start_new_file (int fd, const char * fname)
     pragma_warn_empty_casts = MY_TRUE;
     pragma_share_variables = share_variables;
     pragma_rtt_checks = MY_FALSE;
+    pragma_optimize = MY_TRUE;
 
     nexpands = 0;
 
-    add_auto_include(object_file, NULL, MY_FALSE);
+    add_auto_include(get_auto_include_string(object_file, NULL, MY_FALSE)
+                    , MY_FALSE);
 } /* start_new_file() */
 
 /*-------------------------------------------------------------------------*/
@@ -5428,6 +6299,9 @@ end_new_file (void)
  */
 
 {
+    while (inc_records)
+        end_inc_record(MY_FALSE);
+
     while (inctop)
     {
         struct incstate *p;
@@ -5891,6 +6765,9 @@ add_define (char *name, short nargs, char *exps, source_loc_t loc)
 {
     ident_t *p;
 
+    if (inc_records)
+        record_inc_query(name, find_define(name));
+
     /* Lookup/create a new identifier entry */
     p = make_shared_identifier(name, I_TYPE_DEFINE, 0);
     if (!p)
@@ -5957,6 +6834,8 @@ add_define (char *name, short nargs, char *exps, source_loc_t loc)
         fprintf(stderr, "%s define '%s' %d '%s'\n"
                , time_stamp(), name, nargs, exps);
 #endif
+        if (inc_records)
+            record_inc_define(name, nargs, exps);
     }
 } /* add_define() */
 
@@ -6023,6 +6902,30 @@ add_permanent_define (char *name, short nargs, void *exps, Bool special)
     permanent_defines = p;
 } /* add_permanent_define() */
 
+/*-------------------------------------------------------------------------*/
+uint32_t
+hash_permanent_defines (void)
+
+/* Return a hash of the names and replacement texts of all permanent
+ * defines. The program cache uses it to notice changed driver options.
+ * Macros which compute their text for each use are only hashed by name.
+ */
+
+{
+    ident_t *p;
+    uint32_t hash = INITIAL_HASH;
+
+    for (p = permanent_defines; p; p = p->next_all)
+    {
+        hash = hashmem32_chained(get_txt(p->name), mstrsize(p->name), hash);
+        if (!p->u.define.special)
+            hash = hashmem32_chained(p->u.define.exps.str
+                                    , strlen(p->u.define.exps.str), hash);
+    }
+
+    return hash;
+} /* hash_permanent_defines() */
+
 /*-------------------------------------------------------------------------*/
 void
 free_defines (void)
@@ -6081,10 +6984,103 @@ free_defines (void)
     nexpands = 0;
 } /* free_defines() */
 
+/*-------------------------------------------------------------------------*/
+static void
+undefine_macro (char *name)
+
+/* #undef the macro <name>, if it is defined.
+ */
+
+{
+    ident_t *p, **q;
+    int h;
+
+    if (inc_records)
+    {
+        record_inc_query(name, find_define(name));
+        record_inc_undef(name);
+    }
+
+    /* Lookup identifier <name> in the ident_table and
+     * remove it there if it is a #define'd identifier.
+     * If it is a permanent define, park the ident
+     * structure in the undefined_permanent_defines list.
+     */
+    h = identhash(name);
+    for (q = &ident_table[h]; NULL != ( p= *q); q=&p->next)
+    {
+        if (strcmp(name, get_txt(p->name)))
+            continue;
+
+        if (p->type != I_TYPE_DEFINE) /* failure */
+            break;
+
+        if (!p->u.define.permanent)
+        {
+#if defined(LEXDEBUG)
+            fprintf(stderr, "%s #undef define '%s' %d '%s'\n"
+                   , time_stamp(), get_txt(p->name)
+                   , p->u.define.nargs
+                   , p->u.define.exps.str);
+            fflush(stderr);
+#endif
+            if (p->inferior)
+            {
+                p->inferior->next = p->next;
+                *q = p->inferior;
+            }
+            else
+            {
+                *q = p->next;
+            }
+            xfree(p->u.define.exps.str);
+            free_mstring(p->name);
+            p->name = NULL;
+                /* mark for later freeing by all_defines */
+            /* success */
+            break;
+        }
+        else
+        {
+            if (p->inferior)
+            {
+                p->inferior->next = p->next;
+                *q = p->inferior;
+            }
+            else
+            {
+                *q = p->next;
+            }
+            p->next = undefined_permanent_defines;
+            undefined_permanent_defines = p;
+            /* success */
+            break;
+        }
+    }
+} /* undefine_macro() */
+
 /*-------------------------------------------------------------------------*/
 static ident_t *
 lookup_define (char *s)
 
+/* Lookup the name <s> in the identtable and return a pointer to its
+ * ident structure if it is a define. Return NULL else.
+ * The lookup is recorded for the include cache.
+ */
+
+{
+    ident_t *p;
+
+    p = find_define(s);
+    if (inc_records)
+        record_inc_query(s, p);
+    return p;
+} /* lookup_define() */
+
+/*-------------------------------------------------------------------------*/
+static ident_t *
+find_define (char *s)
+
 /* Lookup the name <s> in the identtable and return a pointer to its
  * ident structure if it is a define. Return NULL else.
  */
@@ -6116,7 +7112,7 @@ lookup_define (char *s)
     } /* not found */
 
     return NULL;
-} /* lookup_define() */
+} /* find_define() */
 
 
 /*-------------------------------------------------------------------------*/
@@ -6250,6 +7246,8 @@ _expand_define (struct defn *p, ident_t * macro)
         }
         else
         {
+            if (inc_records)
+                taint_inc_records(MY_TRUE);
             e = (*p->exps.fun)(NULL);
             if (!e) {
                 lexerror("Out of memory");
@@ -6531,6 +7529,8 @@ _expand_define (struct defn *p, ident_t * macro)
         /* (Don't) handle dynamic function macros */
         if (p->special)
         {
+            if (inc_records)
+                taint_inc_records(MY_TRUE);
             (void)(*p->exps.fun)(args);
             DEMUTEX;
             return MY_TRUE;
@@ -7260,6 +8260,24 @@ get_version(char ** args UNUSED)
     return buf;
 } /* get_version() */
 
+/*-------------------------------------------------------------------------*/
+static char *
+get_boot_time (char ** args UNUSED)
+
+/* Dynamic macro __BOOT_TIME__: return the time the driver was started.
+ */
+
+{
+#ifdef __MWERKS__
+#    pragma unused(args)
+#endif
+    char buf[40];
+
+    lex_used_boot_time = MY_TRUE;
+    sprintf(buf, "%"PRIdMPINT, boot_time);
+    return string_copy(buf);
+} /* get_boot_time() */
+
 /*-------------------------------------------------------------------------*/
 static char *
 get_hostname (char ** args UNUSED)
@@ -7374,7 +8392,7 @@ show_lexer_status (strbuf_t * sbuf, Bool verbose UNUSED)
 #if defined(__MWERKS__)
 #    pragma unused(verbose)
 #endif
-    size_t sum;
+    size_t sum, inc_sum;
     ident_t *p;
     int i;
 
@@ -7395,9 +8413,42 @@ show_lexer_status (strbuf_t * sbuf, Bool verbose UNUSED)
     sum += defbuf_len;
     sum += 2 * DEFMAX; /* for the buffers in _expand_define() */
 
+    /* Count the include cache */
+    inc_sum = 0;
+    for (i = 0; i < INC_CACHE_SIZE; i++)
+    {
+        inc_file_t *f;
+
+        for (f = inc_files[i]; f != NULL; f = f->next)
+        {
+            inc_variant_t *var;
+
+            inc_sum += sizeof(*f) + strlen(f->path);
+            if (f->text != NULL)
+                inc_sum += mstr_mem_size(f->text);
+            for (var = f->variants; var != NULL; var = var->next)
+            {
+                inc_event_t *ev;
+
+                inc_sum += sizeof(*var);
+                for (ev = var->events; ev != NULL; ev = ev->next)
+                {
+                    inc_sum += sizeof(*ev);
+                    if (ev->name)
+                        inc_sum += strlen(ev->name)+1;
+                    if (ev->text)
+                        inc_sum += strlen(ev->text)+1;
+                }
+            }
+        }
+    }
+
     if (sbuf)
+    {
         strbuf_addf(sbuf, "Lexer structures\t\t\t %9zu\n", sum);
-    return sum;
+        strbuf_addf(sbuf, "Include cache\t\t\t\t %9zu\n", inc_sum);
+    }
+    return sum + inc_sum;
 } /* show_lexer_status() */
 
 /*-------------------------------------------------------------------------*/
@@ -7452,6 +8503,42 @@ count_lex_refs (void)
 
     if (lexpool)
         mempool_note_refs(lexpool);
+
+    /* Include cache */
+    for (i = 0; i < INC_CACHE_SIZE; i++)
+    {
+        inc_file_t *f;
+
+        for (f = inc_files[i]; f != NULL; f = f->next)
+        {
+            inc_variant_t *var;
+
+            note_malloced_block_ref(f);
+            if (f->text != NULL)
+                count_ref_from_string(f->text);
+            for (var = f->variants; var != NULL; var = var->next)
+            {
+                inc_event_t *ev;
+
+                note_malloced_block_ref(var);
+                for (ev = var->events; ev != NULL; ev = ev->next)
+                    note_malloced_block_ref(ev);
+            }
+        }
+    }
+
+    {
+        inc_record_t *rec;
+
+        for (rec = inc_records; rec != NULL; rec = rec->prev)
+        {
+            inc_event_t *ev;
+
+            note_malloced_block_ref(rec);
+            for (ev = rec->first; ev != NULL; ev = ev->next)
+                note_malloced_block_ref(ev);
+        }
+    }
 }
 #endif /* GC_SUPPORT */
 
@@ -249,6 +249,11 @@ extern Bool pragma_warn_empty_casts;
 extern Bool pragma_check_overloads;
 extern Bool pragma_share_variables;
 extern Bool pragma_rtt_checks;
+extern Bool pragma_optimize;
+extern Bool lex_used_boot_time;
+extern statcounter_t inc_cache_hits;
+extern statcounter_t inc_cache_misses;
+extern statcounter_t inc_cache_replays;
 extern string_t *last_lex_string;
 extern ident_t *all_efuns;
 
@@ -284,6 +289,8 @@ extern void lex_close(char *msg);
 extern void start_new_file(int fd, const char * fname);
 extern char *get_f_name(int n);
 extern void free_defines(void);
+extern uint32_t hash_permanent_defines(void);
+extern string_t *get_auto_include_string(const char *obj_file, const char *cur_file, Bool sys_include);
 extern size_t show_lexer_status (strbuf_t * sbuf, Bool verbose);
 extern void set_inc_list(vector_t *v);
 extern void remove_unknown_identifier(void);
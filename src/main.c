@@ -64,6 +64,7 @@
 #include "otable.h"
 #include "patchlevel.h"
 #include "pkg-tls.h"
+#include "prog_cache.h"
 #include "random.h"
 #include "simulate.h"
 #include "simul_efun.h"
@@ -1142,6 +1143,7 @@ typedef enum OptNumber {
  , cNoTimers        /* --no-timers          */
  , cNoPreload       /* --no-preload         */
  , cPidFile         /* --pidfile            */
+ , cProgramCache    /* --program-cache      */
  , cRandomdevice    /* --randomdevice       */
  , cRandomSeed      /* --random-seed        */
  , cRegexp          /* --regexp             */
@@ -1676,6 +1678,13 @@ static Option aOptions[]
         "    Write the pid of the driver process into <filename>.\n"
       }
 
+    , { 0,   "program-cache",      cProgramCache,   MY_TRUE
+      , "  --program-cache <dirname>\n"
+      , "  --program-cache <dirname>\n"
+        "    Keep the compiled programs in directory <dirname>, and load\n"
+        "    them from there instead of compiling them again.\n"
+      }
+
     , { 0,   "randomdevice",       cRandomdevice,   MY_TRUE
       , "  --randomdevice <filename>\n"
       , "  --randomdevice <filename>\n"
@@ -2938,6 +2947,12 @@ eval_arg (int eOption, const char * pValue)
         usage();
         return hrError;
 
+    case cProgramCache:
+        if (prog_cache_dir != NULL)
+            free(prog_cache_dir);
+        prog_cache_dir = strdup(pValue);
+        break;
+
     case cPidFile:
         {
             FILE * pidfile;
@@ -3173,6 +3173,26 @@ create_instrs (void)
         }
     }
 
+    /* The list of all single byte instructions, for the dispatch
+     * table of the interpreter.
+     */
+    fprintf(fpw,
+"\n/* --- single byte instructions --- */\n\n"
+"#define FOR_ALL_BYTECODES(X) \\\n"
+           );
+
+    for (i = instr_offset[C_CODE]; i < instr_offset[C_EFUN0]; i++)
+    {
+        fprintf(fpw, "    X(%s) \\\n", make_f_name(instr[i].key));
+    }
+
+    fprintf(fpw,
+"\n"
+"  /* Applies X() to the names of all instructions which are encoded\n"
+"   * in a single byte (codes and untabled efuns).\n"
+"   */\n"
+           );
+
     fprintf(fpw,
 "\n"
 "/************************************************************************/\n"
@@ -7,13 +7,11 @@
  * TODO:: provide wrapper functions which do throw errorf()s, so that every
  * TODO:: caller can handle the errors himself (like the swapper).
  *
- * TODO: A better mapping implementation would utilise the to-be-written
- * TODO:: small block pools. The mapping entries would be unified to
- * TODO:: (hash header:key:values) tuples and stored in a pool.
- * TODO:: The 'compacted' part of the mapping would obviously go away,
- * TODO:: and all indexing would be done through hash table.
- * TODO:: The pool is not absolutely required, but would reduce overhead if
- * TODO:: MALLOC_TRACE is in effect.
+ * TODO: The hashed entries are now (hash:key:values) tuples stored in
+ * TODO:: pool blocks and indexed by an open addressing table. Letting the
+ * TODO:: 'compacted' part go away as well would make the indexing simpler,
+ * TODO:: but a compacted entry takes about half the memory of a hashed one
+ * TODO:: (no link, no slot), and the swapper depends on its layout.
  *
  * TODO: Check if the use of mp_int is reasonable for values for num_values
  * TODO::and num_entries (which are in the struct p_int). And check as
@@ -59,10 +57,10 @@
  *
  * The mapping_hash_t block is used to record all the new additions to
  * the mapping since the last compaction. The new entries' data is kept
- * directly in the hash entries. The hash table grows with the
- * number of hashed entries, so that the average chain length is
- * no more than 2. For easier computations,the number of buckets
- * is always a power of 2.
+ * directly in the hash entries, which are allocated from pool blocks
+ * and indexed by an open addressing table. The table grows with the
+ * number of hashed entries, so that it is never more than 3/4 full.
+ * For easier computations, the number of slots is always a power of 2.
  *
  * All mappings with a mapping_hash_t structure are considered 'dirty'
  * (and vice versa, only 'dirty' mappings have a mapping_hash_t).
@@ -70,19 +68,26 @@
  * the dirty mappings by sorting the hashed entries into the condensed part,
  * removing the hashed part by this.
  *
- * To be compacted, a mapping has to conform to a number of conditions:
- *  - it has been at least TIME_TO_COMPACT seconds (typical 10 minutes)
- *    since the last addition or deletion of an entry
- * and
- *     - it was to be at least 2*TIME_TO_COMPACT seconds (typical 20 minutes)
- *       since the last addition or deletion of an entry
- *  or - the number of condensed-deleted entries is at least half the capacity
- *       of the condensed part
- *  or - the number of hashed entries exceeds the number non-deleted condensed
- *       entries.
+ * The hash part counts the mutations of the mapping, and the lookups
+ * in the hash part with the number of slots they probed. Every time
+ * the backend cleans up the data of an object, its dirty mappings are
+ * checked against these counters (which are then reset):
+ *  - a mapping which wasn't used at all since the last check is
+ *    compacted, as the hash part is just overhead now;
+ *  - a mapping with a large amount of waste is compacted even if it's
+ *    mutated frequently: when the number of condensed-deleted entries
+ *    is at least half the capacity of the condensed part, or when the
+ *    number of hashed entries exceeds the number of non-deleted condensed
+ *    entries;
+ *  - a mapping with more mutations than lookups is left alone otherwise,
+ *    as it would be dirty again right away;
+ *  - a mapping mostly read is compacted when the slots probed in the
+ *    hash part since the last check outweigh the cost of the compaction,
+ *    ie. exceed the number of entries.
  *
  * The idea is to minimize reallocations of the (potentially large) condensed
- * block, as it easily runs into fragmentation of the large block heap.
+ * block, as it easily runs into fragmentation of the large block heap,
+ * while not letting frequently used mappings stay dirty forever.
  *
  * A garbage collection however compacts all mappings unconditionally.
  *
@@ -155,29 +160,55 @@
  * -- mapping_hash_t --
  *
  *   hash_mapping_t {
- *       p_int        mask;
  *       p_int        used;
- *       p_int        cond_deleted;
+ *       p_int        mask;
+ *       p_int        deleted_slots;
  *       p_int        ref;
- *       mp_int       last_used;
+ *       p_int        mutations;
+ *       p_int        lookups;
+ *       p_int        probes;
+ *       p_int        cond_deleted;
  *       map_chain_t *deleted;
- *       map_chain_t *chains[ 1 +.mask ];
+ *       map_chain_t *free_entries;
+ *       map_block_t *blocks;
+ *       mp_int       pool_size;
+ *       map_chain_t *slots[ 1 +.mask ];
+ *       (unsigned char tags[ 1 +.mask ];)
  *   }
  *
  *   This structure keeps track of the changes to a mapping. Every mapping
  *   with a hash part is considered 'dirty'.
  *
- *   New entries to the mapping are kept in the hashtable made up by
- *   .chains[]. There are .mask+1 different chains, with .mask+1 always
- *   being a power of two. This way, .mask can be used in a binary-&
- *   operation to convert a hash value into a chain index. The number
- *   of entries in the hashtable is listed in .used.
- *
- *   The driver imposes an upper limit onto the average length of the
- *   chains: if the average length exceeds two elements, the size of
- *   the hashtable is doubled (by reallocating the hash_mapping structure).
- *   This is the reason why you can allocate a mapping with a given 'size':
- *   it reduces the number of reallocations in the long run.
+ *   New entries to the mapping are indexed by the open addressing table
+ *   .slots[]. There are .mask+1 slots, with .mask+1 always being a power
+ *   of two. This way, .mask can be used in a binary-& operation to convert
+ *   a hash value into the index of the first slot to look at. Collisions
+ *   are resolved by linear probing: a key is searched in the following
+ *   slots until it is found or an empty (NULL) slot is reached. The slot
+ *   of a removed entry is set to DELETED_SLOT (counted in .deleted_slots)
+ *   so that the probe sequences of other keys remain intact; such slots
+ *   are reused for new entries. The number of entries in the table is
+ *   listed in .used.
+ *
+ *   The slots are followed by one tag byte per slot (see HASH_TAGS()),
+ *   which holds a few bits of the hash of the entry in the slot. A lookup
+ *   compares only the keys of entries with a matching tag, so that it
+ *   doesn't have to touch the other entries of a probe sequence.
+ *
+ *   The driver keeps the table at most 3/4 full, counting the deleted
+ *   slots: if an addition would exceed this limit, the table is rebuilt
+ *   (by reallocating the hash_mapping structure), doubled in size unless
+ *   most of the occupied slots are just deleted ones. This is the reason
+ *   why you can allocate a mapping with a given 'size': it reduces the
+ *   number of reallocations in the long run.
+ *
+ *   The entries themselves are not stored in the table, but in pool
+ *   blocks (the list .blocks, with a total size of .pool_size), which are
+ *   deallocated only together with the hash part. This saves one
+ *   allocation per entry and keeps the entries close together. Most
+ *   importantly, entries never move: rebuilding the table just rearranges
+ *   the pointers, so pointers to entry values remain valid. Entries no
+ *   longer in use are kept in the list .free_entries for reuse.
  *
  *   .condensed_deleted gives the number of deleted entries in
  *   the mappings condensed_part.
@@ -192,22 +223,43 @@
  *   protection is in effect. If the .ref falls back to 0, all
  *   the pending deletions of the .deleted entries are performed.
  *
- *   .last_used holds the time (seconds since the epoch) of the last addition
- *   or removal of an entry. It is used by the compaction algorithm to
- *   determine whether the mapping should be compacted or not.
+ *   .mutations counts the additions and removals of entries, .lookups
+ *   the lookups in the hash part and .probes the slots inspected by
+ *   these lookups. The counters are used by the compaction algorithm to
+ *   determine whether the mapping should be compacted or not, and are
+ *   reset after each such check.
+ *
+ * -- map_block_t --
+ *
+ *   map_block_t {
+ *       map_block_t *next;
+ *       p_int        size;
+ *       map_chain_t  entries[ .size ];
+ *   }
+ *
+ *   A pool block of a hash_mapping, holding .size entries. The size
+ *   of a block depends on the size of the hash_mapping at the time
+ *   the block is allocated, so that the pool roughly doubles with every
+ *   new block, up to MAP_BLOCK_MAX_ENTRIES entries per block.
  *
  * -- map_chain_t --
  *
- *   This structure is used to keep single entries in the hash chains
- *   of hash_mapping, and occasionally, in the .deleted list of
- *   protector mappings.
+ *   This structure is used to keep single entries of the hash_mapping;
+ *   the name is historical from the time the entries were kept in
+ *   hash chains.
  *
  *   map_chain_t {
- *       map_chain_t *next;
+ *       union {
+ *           map_chain_t *next;
+ *           mp_int       hash;
+ *       } u;
  *       svalue_t data[ mapping->num_values+1 ];
  *   }
  *
- *   .next is the next struct map_chain in the hash chain (or .deleted list).
+ *   While the entry is in the table, .u.hash holds the hash of its key,
+ *   so the table can be rebuilt without looking at the keys.
+ *   Otherwise .u.next links the entry into the .free_entries or .deleted
+ *   list, and is used by compact_mapping() to sort the entries.
  *   .data holds the key and it's data values.
  *
  *---------------------------------------------------------------------------
@@ -237,25 +289,26 @@
 
 #include "i-svalue_cmp.h"
 
-#define TIME_TO_COMPACT (600) /* 10 Minutes */
-   /* TODO: Make this configurable.
-    * TODO:: When doing so, also implement the shrinking of the hashtable
-    */
+#include "../mudlib/sys/driver_info.h"
 
 /*-------------------------------------------------------------------------*/
 /* Types */
 
 /* The local typedefs */
 typedef struct map_chain_s    map_chain_t;
+typedef struct map_block_s    map_block_t;
 typedef struct walk_mapping_s walk_mapping_t;
 
-/* --- struct map_chain_s: one entry in a hash chain ---
+/* --- struct map_chain_s: one hashed entry ---
  *
  * The hashed mapping entries.
  */
 
 struct map_chain_s {
-    map_chain_t * next;  /* next entry */
+    union {
+        map_chain_t * next;  /* next entry in the free or deleted list */
+        mp_int        hash;  /* the hash of the key while in the table */
+    } u;
     svalue_t      data[1 /* +mapping->num_values */];
       /* [0]: the key, [1..]: the data */
 };
@@ -266,6 +319,41 @@ struct map_chain_s {
   /* Allocation size of a map_chain_t for <nv> values per key.
    */
 
+/* --- struct map_block_s: a pool block of hashed entries ---
+ */
+
+struct map_block_s {
+    map_block_t * next;  /* next block of this hash part */
+    p_int         size;  /* number of entries in this block */
+    /* followed by .size map_chain_t entries */
+};
+
+#define SIZEOF_MB(nv, size) ( \
+    sizeof(map_block_t) + (size) * SIZEOF_MCH((map_chain_t *)NULL, nv) \
+                            )
+  /* Allocation size of a map_block_t for <size> entries with <nv>
+   * values per key.
+   */
+
+#define MAP_BLOCK_MAX_ENTRIES 256
+  /* Maximum number of entries in one pool block.
+   */
+
+static map_chain_t deleted_slot_marker;
+#define DELETED_SLOT (&deleted_slot_marker)
+  /* The marker for deleted slots in mapping_hash_t.slots[].
+   */
+
+#define SLOT_USED(mc) ((mc) != NULL && (mc) != DELETED_SLOT)
+  /* Return TRUE if the slot value <mc> denotes an entry.
+   */
+
+#define HASH_TAG(hash) ((unsigned char)(((uint32_t)(hash) * 2654435761U) >> 24))
+  /* The tag of an entry with the hash value <hash>. The multiplication
+   * mixes all bits of the hash into the tag, so that it also tells
+   * apart entries whose hashes differ only in the bits used as index.
+   */
+
 
 /* --- struct walk_mapping_s: contains all walk_mapping pointers */
 
@@ -292,6 +380,26 @@ mp_int num_dirty_mappings = 0;
   /* Number of allocated mappings with a hash and a condensed part.
    */
 
+static statcounter_t num_compactions = 0;
+  /* Number of compacted mappings.
+   */
+
+static statcounter_t size_compaction_saved = 0;
+  /* Memory saved by the compactions.
+   */
+
+static statcounter_t num_cycle_compactions = 0;
+static statcounter_t size_cycle_compaction_saved = 0;
+  /* Number of compacted mappings and the memory saved by them in the
+   * current backend cycle.
+   */
+
+static statcounter_t num_last_compactions = 0;
+static statcounter_t size_last_compaction_saved = 0;
+  /* Number of compacted mappings and the memory saved by them in the
+   * last backend cycle.
+   */
+
 mapping_t *stale_mappings;
   /* During a garbage collection, this is a list of mappings with
    * keys referencing destructed objects/lambdas, linked through
@@ -329,10 +437,11 @@ printf("DEBUG: %s: m %p user %p total %ld - %ld = %ld\n", where, (m), (m)->user,
 #endif
 
 /*-------------------------------------------------------------------------*/
-static INLINE map_chain_t *
-new_map_chain (mapping_t * m)
+static map_chain_t *
+new_map_chain (mapping_t * m, mapping_hash_t * hm)
 
-/* Return a fresh map_chain_t for mapping <m>.
+/* Return a fresh map_chain_t from the pool of the hash part <hm> of
+ * mapping <m>, allocating a new pool block if necessary.
  * The .data[] values are not initialised.
  *
  * Return NULL if out of memory.
@@ -341,13 +450,48 @@ new_map_chain (mapping_t * m)
 {
     map_chain_t *rc;
 
-    rc = xalloc(SIZEOF_MCH(rc, m->num_values));
-    if (rc)
+    if (hm->free_entries == NULL)
     {
-        LOG_ALLOC("new_map_chain", SIZEOF_MCH(rc, m->num_values), SIZEOF_MCH(rc, m->num_values));
-        m->user->mapping_total += SIZEOF_MCH(rc, m->num_values);
+        map_block_t *mb;
+        p_int size, i;
+        size_t entry_size = SIZEOF_MCH(rc, m->num_values);
+        char *p;
+
+        /* The first block is sized after the capacity of the table,
+         * every further block (roughly) doubles the pool.
+         */
+        size = hm->used ? hm->used : ((hm->mask + 1) * 3) / 4;
+        if (size < 1)
+            size = 1;
+        else if (size > MAP_BLOCK_MAX_ENTRIES)
+            size = MAP_BLOCK_MAX_ENTRIES;
+
+        mb = xalloc(SIZEOF_MB(m->num_values, size));
+        if (!mb)
+            return NULL;
+
+        mb->next = hm->blocks;
+        mb->size = size;
+        hm->blocks = mb;
+        hm->pool_size += SIZEOF_MB(m->num_values, size);
+
+        LOG_ALLOC("new_map_chain", SIZEOF_MB(m->num_values, size), SIZEOF_MB(m->num_values, size));
+        m->user->mapping_total += SIZEOF_MB(m->num_values, size);
+
+        /* Put the new entries into the free list, the first one
+         * at the head.
+         */
+        for (i = size, p = (char *)(mb+1) + size * entry_size; --i >= 0; )
+        {
+            p -= entry_size;
+            ((map_chain_t *)p)->u.next = hm->free_entries;
+            hm->free_entries = (map_chain_t *)p;
+        }
     }
 
+    rc = hm->free_entries;
+    hm->free_entries = rc->u.next;
+
     return rc;
 } /* new_map_chain() */
 
@@ -355,7 +499,8 @@ new_map_chain (mapping_t * m)
 static INLINE void
 free_map_chain (mapping_t * m, map_chain_t *mch, Bool no_data)
 
-/* Free the map_chain <mch> of mapping <m>.
+/* Free the map_chain <mch> of mapping <m>, returning it to the pool
+ * of the hash part.
  * If <no_data> is TRUE, the svalues themselves are supposed to be empty.
  */
 
@@ -370,11 +515,35 @@ free_map_chain (mapping_t * m, map_chain_t *mch, Bool no_data)
         }
     }
 
-    LOG_SUB("free_map_chain", SIZEOF_MCH(mch, m->num_values));
-    m->user->mapping_total -= SIZEOF_MCH(mch, m->num_values);
-    xfree(mch);
+    mch->u.next = m->hash->free_entries;
+    m->hash->free_entries = mch;
 } /* free_map_chain() */
 
+/*-------------------------------------------------------------------------*/
+static void
+free_map_pool (mapping_t * m, mapping_hash_t * hm)
+
+/* Deallocate all pool blocks of the hash part <hm> of mapping <m>.
+ * The svalues in the entries are supposed to be freed already.
+ */
+
+{
+    map_block_t *mb, *next;
+
+    for (mb = hm->blocks; mb != NULL; mb = next)
+    {
+        next = mb->next;
+        xfree(mb);
+    }
+
+    LOG_SUB("free_map_pool", hm->pool_size);
+    m->user->mapping_total -= hm->pool_size;
+
+    hm->blocks = NULL;
+    hm->free_entries = NULL;
+    hm->pool_size = 0;
+} /* free_map_pool() */
+
 /*-------------------------------------------------------------------------*/
 static INLINE mapping_hash_t *
 get_new_hash ( mapping_t *m, mp_int hash_size)
@@ -389,57 +558,100 @@ get_new_hash ( mapping_t *m, mp_int hash_size)
 {
     mapping_hash_t *hm;
     map_chain_t **mcp;
+    mp_int size;
 
-    /* Compute the number of hash buckets to 2**k, where
-     * k is such that 2**(k+1) > size >= 2**k.
-     *
-     * To do this, compute 'size' to (2**k)-1 by first setting
-     * all bits after the leading '1' and then shifting the
-     * number right once. The result is then also the mask
-     * required for indexing.
-     */
-    hash_size |= hash_size >> 1;
-    hash_size |= hash_size >> 2;
-    hash_size |= hash_size >> 4;
-    if (hash_size & ~0xff)
-    {
-        hash_size |= hash_size >> 8;
-        hash_size |= hash_size >> 16;
-    }
-    hash_size >>= 1;
-
-    /* Allocate the hash_mapping big enough to hold (size+1) hash
-     * buckets.
-     * size must not exceed the accessible indexing range. This is
-     * a possibility because size as a mp_int may have a different
+    /* The number of slots must not exceed the accessible indexing range.
+     * This is a possibility because size as a mp_int may have a different
      * range than array indices which are size_t.
      * TODO: The 0x100000 seems to be a safety offset, but is it?
      */
-    if (hash_size > (mp_int)((SIZE_MAX - sizeof *hm - 0x100000) / sizeof *mcp)
-     || !(hm = xalloc(sizeof *hm + sizeof *mcp * hash_size) ) )
-    {
+    if (hash_size > (mp_int)((SIZE_MAX - sizeof *hm - 0x100000) / sizeof *mcp / 2))
         return NULL;
-    }
 
-    hm->mask = hash_size;
-    hm->used = hm->cond_deleted = hm->ref = 0;
-    hm->last_used = current_time;
+    /* Compute the number of slots as the smallest power of 2 which
+     * keeps the table at most 3/4 full with <hash_size> entries.
+     */
+    for (size = 1; size * 3 < hash_size * 4; size <<= 1)
+        NOOP;
+
+    hm = xalloc(sizeof *hm + sizeof *mcp * (size - 1) + size);
+    if (!hm)
+        return NULL;
+
+    hm->mask = size - 1;
+    hm->used = hm->deleted_slots = hm->cond_deleted = hm->ref = 0;
+    hm->mutations = hm->lookups = hm->probes = 0;
 
     /* These members don't really need a default initialisation
      * but it's here to catch bogies.
      */
     hm->deleted = NULL;
 
-    /* Initialise the hashbuckets (there is at least one) */
-    mcp = hm->chains;
-    do *mcp++ = NULL; while (--hash_size >= 0);
+    hm->free_entries = NULL;
+    hm->blocks = NULL;
+    hm->pool_size = 0;
+
+    /* Initialise the slots (there is at least one) */
+    mcp = hm->slots;
+    do *mcp++ = NULL; while (--size > 0);
 
-    LOG_ALLOC("get_new_hash", SIZEOF_MH(hm), sizeof *hm + sizeof *mcp * hm->mask);
+    LOG_ALLOC("get_new_hash", SIZEOF_MH(hm), SIZEOF_MH(hm));
     m->user->mapping_total += SIZEOF_MH(hm);
 
     return hm;
 } /* get_new_hash() */
 
+/*-------------------------------------------------------------------------*/
+static INLINE void
+insert_hash_entry (mapping_hash_t *hm, map_chain_t *mc, mp_int hash)
+
+/* Enter the entry <mc> with the hash value <hash> into the table of <hm>,
+ * which must have room for it. The key must not be in the table yet.
+ * .used is not changed.
+ */
+
+{
+    p_int ix = hash & hm->mask;
+
+    while (SLOT_USED(hm->slots[ix]))
+        ix = (ix + 1) & hm->mask;
+
+    if (hm->slots[ix] == DELETED_SLOT)
+        hm->deleted_slots--;
+    hm->slots[ix] = mc;
+    HASH_TAGS(hm)[ix] = HASH_TAG(hash);
+    mc->u.hash = hash;
+} /* insert_hash_entry() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE void
+clear_hash_slot (mapping_hash_t *hm, p_int ix)
+
+/* Remove the entry in slot <ix> from the table of <hm>. If the following
+ * slot is empty, no probe sequence can continue past this slot, so it
+ * (and any deleted slots right before it) can be emptied; otherwise it
+ * is marked as deleted. .used is not changed.
+ */
+
+{
+    if (hm->slots[(ix + 1) & hm->mask] == NULL)
+    {
+        hm->slots[ix] = NULL;
+        for (ix = (ix - 1) & hm->mask
+            ; hm->slots[ix] == DELETED_SLOT
+            ; ix = (ix - 1) & hm->mask)
+        {
+            hm->slots[ix] = NULL;
+            hm->deleted_slots--;
+        }
+    }
+    else
+    {
+        hm->slots[ix] = DELETED_SLOT;
+        hm->deleted_slots++;
+    }
+} /* clear_hash_slot() */
+
 /*-------------------------------------------------------------------------*/
 static mapping_t *
 get_new_mapping ( wiz_list_t * user, mp_int num_values
@@ -517,6 +729,9 @@ get_new_mapping ( wiz_list_t * user, mp_int num_values
     m->cond = cm;
     m->hash = hm;
     m->next = NULL;
+#ifdef USE_CYCLE_COLLECTOR
+    m->cc_root = 0;
+#endif
     m->num_values = num_values;
     m->num_entries = 0;
     // there can't be a destructed object in the mapping now, record the
@@ -577,6 +792,74 @@ allocate_cond_mapping (wiz_list_t * user, mp_int size, mp_int num_values)
     return get_new_mapping(user, num_values, 0, size);
 } /* allocate_cond_mapping() */
 
+/*-------------------------------------------------------------------------*/
+static void
+free_mapping_data (mapping_t *m, Bool no_data)
+
+/* Deallocate the condensed and the hashed part of mapping <m>, properly
+ * freeing the contained svalues unless <no_data> is TRUE.
+ * The mapping itself and its counters are left alone.
+ */
+
+{
+    mapping_hash_t *hm;  /* Hashed part of <m> */
+
+    /* Free the condensed data */
+    if (m->cond != NULL)
+    {
+        p_int left = m->cond->size * (m->num_values + 1);
+        svalue_t *data = &(m->cond->data[0]);
+
+        for (; !no_data && left > 0; left--, data++)
+            free_svalue(data);
+
+        LOG_SUB("free_mapping cond", SIZEOF_MC(m->cond, m->num_values));
+        m->user->mapping_total -= SIZEOF_MC(m->cond, m->num_values);
+        check_total_mapping_size();
+        xfree(m->cond);
+        m->cond = NULL;
+
+    }
+
+    /* Free the hashed data */
+    if ( NULL != (hm = m->hash) )
+    {
+        map_chain_t **mcp, *mc;
+        p_int i, num_values;
+
+#ifdef DEBUG
+        if (hm->ref)
+            fatal("Ref count in freed hash mapping: %"PRIdPINT"\n", hm->ref);
+#endif
+        LOG_SUB("free_mapping hash", SIZEOF_MH(hm));
+        m->user->mapping_total -= SIZEOF_MH(hm);
+
+        /* Free the values of all entries */
+
+        if (!no_data)
+        {
+            num_values = m->num_values;
+            for (mcp = hm->slots, i = hm->mask + 1; --i >= 0; )
+            {
+                mc = *mcp++;
+                if (SLOT_USED(mc))
+                {
+                    p_int j;
+
+                    for (j = num_values; j >= 0; j--)
+                        free_svalue(mc->data+j);
+                }
+            }
+        }
+
+        free_map_pool(m, hm);
+        check_total_mapping_size();
+
+        xfree(hm);
+        m->hash = NULL;
+    }
+} /* free_mapping_data() */
+
 /*-------------------------------------------------------------------------*/
 Bool
 _free_mapping (mapping_t *m, Bool no_data)
@@ -597,8 +880,6 @@ _free_mapping (mapping_t *m, Bool no_data)
  */
 
 {
-    mapping_hash_t *hm;  /* Hashed part of <m> */
-
 #ifdef DEBUG
     if (!m)
         fatal("NULL pointer passed to free_mapping().\n");
@@ -617,61 +898,18 @@ _free_mapping (mapping_t *m, Bool no_data)
     else if (m->hash)
         num_hash_mappings--;
 
+#ifdef USE_CYCLE_COLLECTOR
+    if (m->cc_root)
+        cc_forget_root(m->cc_root);
+#endif
+
     m->ref = 0;
       /* In case of free_empty_mapping(), this is neither guaranteed nor a
        * precondition, but in case this mapping needs to be entered into the
        * dirty list the refcount needs to be correct.
        */
 
-    /* Free the condensed data */
-    if (m->cond != NULL)
-    {
-        p_int left = m->cond->size * (m->num_values + 1);
-        svalue_t *data = &(m->cond->data[0]);
-
-        for (; !no_data && left > 0; left--, data++)
-            free_svalue(data);
-
-        LOG_SUB("free_mapping cond", SIZEOF_MC(m->cond, m->num_values));
-        m->user->mapping_total -= SIZEOF_MC(m->cond, m->num_values);
-        check_total_mapping_size();
-        xfree(m->cond);
-        m->cond = NULL;
-
-    }
-
-    /* Free the hashed data */
-    if ( NULL != (hm = m->hash) )
-    {
-        map_chain_t **mcp, *mc, *next;
-        p_int i;
-
-#ifdef DEBUG
-        if (hm->ref)
-            fatal("Ref count in freed hash mapping: %"PRIdPINT"\n", hm->ref);
-#endif
-        LOG_SUB("free_mapping hash", SIZEOF_MH(hm));
-        m->user->mapping_total -= SIZEOF_MH(hm);
-        check_total_mapping_size();
-
-        mcp = hm->chains;
-
-        /* Loop through all chains */
-
-        i = hm->mask + 1;
-        do {
-
-            /* Free this chain */
-
-            for (next = *mcp++; NULL != (mc = next); )
-            {
-                next = mc->next;
-                free_map_chain(m, mc, no_data);
-            }
-        } while (--i);
-
-        xfree(hm);
-    }
+    free_mapping_data(m, no_data);
 
     /* Free the base structure.
      */
@@ -684,6 +922,28 @@ _free_mapping (mapping_t *m, Bool no_data)
     return MY_TRUE;
 } /* _free_mapping() */
 
+#ifdef USE_CYCLE_COLLECTOR
+/*-------------------------------------------------------------------------*/
+void
+clear_mapping (mapping_t *m)
+
+/* Remove all entries from mapping <m>, which must not be protected.
+ * The cycle collector uses this to take apart garbage mappings, as their
+ * cycles may run through the keys as well as through the values.
+ */
+
+{
+    if (m->cond && m->hash)
+        num_dirty_mappings--;
+    else if (m->hash)
+        num_hash_mappings--;
+
+    free_mapping_data(m, MY_FALSE);
+    m->num_entries = 0;
+} /* clear_mapping() */
+
+#endif /* USE_CYCLE_COLLECTOR */
+
 /*-------------------------------------------------------------------------*/
 void
 free_protector_mapping (mapping_t *m)
@@ -732,7 +992,7 @@ free_protector_mapping (mapping_t *m)
 
         for (mc = hm->deleted; mc; mc = next)
         {
-            next = mc->next;
+            next = mc->u.next;
             free_map_chain(m, mc, MY_FALSE);
         }
 
@@ -766,15 +1026,15 @@ mhash (svalue_t * svp)
     case T_CLOSURE:
         if (CLOSURE_REFERENCES_CODE(svp->x.closure_type))
         {
-            i = (p_int)(svp->u.lambda) ^ *SVALUE_FULLTYPE(svp);
+            i = (p_int)(svp->u.lambda) ^ SVALUE_FULLTYPE(svp);
         }
         else if (CLOSURE_MALLOCED(svp->x.closure_type))
         {
-            i = (p_int)(svp->u.lambda->ob) ^ *SVALUE_FULLTYPE(svp);
+            i = (p_int)(svp->u.lambda->ob) ^ SVALUE_FULLTYPE(svp);
         }
         else /* Efun, Simul-Efun, Operator closure */
         {
-            i = *SVALUE_FULLTYPE(svp);
+            i = SVALUE_FULLTYPE(svp);
         }
         break;
 
@@ -786,7 +1046,7 @@ mhash (svalue_t * svp)
 #endif
 
     default:
-        i = svp->u.number ^ *SVALUE_FULLTYPE(svp);
+        i = svp->u.number ^ SVALUE_FULLTYPE(svp);
         break;
     }
 
@@ -796,6 +1056,77 @@ mhash (svalue_t * svp)
     return i;
 } /* mhash() */
 
+/*-------------------------------------------------------------------------*/
+static p_int
+find_hash_slot (mapping_hash_t *hm, map_chain_t *mc)
+
+/* Return the index of the slot in the table of <hm> holding the entry <mc>.
+ */
+
+{
+    p_int ix = mc->u.hash & hm->mask;
+
+    while (hm->slots[ix] != mc)
+    {
+        if (hm->slots[ix] == NULL)
+            fatal("Mapping entry didn't hash to the same spot.\n");
+        ix = (ix + 1) & hm->mask;
+    }
+
+    return ix;
+} /* find_hash_slot() */
+
+/*-------------------------------------------------------------------------*/
+static mapping_hash_t *
+rebuild_hash (mapping_t *m, mp_int size)
+
+/* Rebuild the table of the hash part of mapping <m> with <size> slots
+ * (a power of two large enough for all entries), dropping all deleted
+ * slots. The entries themselves are not moved.
+ *
+ * Return the new hash part (which is already linked into <m>),
+ * or NULL when out of memory (the old hash part is then unchanged).
+ */
+
+{
+    mapping_hash_t *hm, *hm2;
+    map_chain_t **mcp;
+    p_int j;
+
+    hm2 = m->hash;
+
+    hm = xalloc(sizeof *hm - sizeof *mcp + sizeof *mcp * size + size);
+    if (!hm)
+        return NULL;
+
+    /* Initialise the new structure except for the slots */
+
+    *hm = *hm2;
+    hm->mask = size - 1;
+    hm->deleted_slots = 0;
+    mcp = hm->slots;
+    do *mcp++ = NULL; while (--size);
+
+    /* Rehash the entries into the new table */
+
+    for (mcp = hm2->slots, j = hm2->mask + 1; --j >= 0; mcp++)
+    {
+        if (SLOT_USED(*mcp))
+            insert_hash_entry(hm, *mcp, (*mcp)->u.hash);
+    }
+    m->hash = hm;
+
+    LOG_ALLOC("rebuild_hash", SIZEOF_MH(hm) - SIZEOF_MH(hm2), SIZEOF_MH(hm));
+    m->user->mapping_total += SIZEOF_MH(hm) - SIZEOF_MH(hm2);
+    check_total_mapping_size();
+
+    /* Away, old data! */
+
+    xfree(hm2);
+
+    return hm;
+} /* rebuild_hash() */
+
 /*-------------------------------------------------------------------------*/
 static svalue_t *
 find_map_entry ( mapping_t *m, svalue_t *map_index
@@ -915,14 +1246,23 @@ find_map_entry ( mapping_t *m, svalue_t *map_index
     {
         mapping_hash_t *hm = m->hash;
         map_chain_t *mc;
+        unsigned char *tags = HASH_TAGS(hm);
 
-        mp_int idx = mhash(map_index) & hm->mask;
+        mp_int hash = mhash(map_index);
+        mp_int idx = hash & hm->mask;
+        unsigned char tag = HASH_TAG(hash);
 
-        /* Look for the value in the chain determined by index */
+        /* Probe the slots starting at the one determined by the hash,
+         * until the entry or an empty slot is found. Only entries with
+         * the right tag can hold the key.
+         */
 
-        for (mc = hm->chains[idx]; mc != NULL; mc = mc->next)
+        hm->lookups++;
+        for ( ; NULL != (mc = hm->slots[idx]); idx = (idx + 1) & hm->mask)
         {
-            if (!svalue_eq(&(mc->data[0]), map_index))
+            hm->probes++;
+            if (tags[idx] == tag && mc != DELETED_SLOT
+             && !svalue_eq(&(mc->data[0]), map_index))
             {
                 /* Found it */
                 *ppChain = mc;
@@ -1026,15 +1366,9 @@ static svalue_t local_const0;
         }
     }
 
-    /* Get the new entry svalues, but don't assign the key value
-     * yet - further steps might still fail.
-     */
-    mc = new_map_chain(m);
-    if (NULL == mc)
-        return NULL;
-
     /* If the mapping has no hashed index, create one with just one
-     * chain and put the new entry in there.
+     * slot. Don't assign the key value yet - further steps might
+     * still fail.
      */
 
     if ( !(hm = m->hash) )
@@ -1045,90 +1379,38 @@ static svalue_t local_const0;
 
         hm = get_new_hash(m, 1);
         if (!hm)
-        {
-            free_map_chain(m, mc, MY_TRUE);
             return NULL; /* Oops */
-        }
         m->hash = hm;
 
-        /* Now insert the map_chain structure into its chain */
-        hm->chains[0] = mc;
-        mc->next = NULL;
-
         if (m->cond)
             num_dirty_mappings++;
         else
             num_hash_mappings++;
     }
-    else
+    else if ((hm->used + hm->deleted_slots + 1) * 4 > (hm->mask + 1) * 3)
     {
-
-        /* The hashed index exists, so we can insert the new entry there.
-         *
-         * However, if the average number of map_chains per chain exceeds 2,
-         * double the size of the bucket array first.
+        /* The hashed index exists, but the new entry would fill the
+         * table more than 3/4. If at least half of the occupied slots
+         * are real entries, double the table size, otherwise just
+         * rebuild it to get rid of the deleted slots.
          */
-        if (hm->used & ~hm->mask<<1)
-        {
-            mapping_hash_t *hm2;
-            mp_int size, mask, j;
-            map_chain_t **mcp, **mcp2, *next;
-
-            hm2 = hm;
-
-            /* Compute new size and mask, and allocate the structure */
+        mp_int size = hm->mask + 1;
 
-            size = (hm->mask << 1) + 2;
-            mask = size - 1;
-
-            hm = xalloc(sizeof *hm - sizeof *mcp + sizeof *mcp * size);
-            if (!hm)
-            {
-                free_map_chain(m, mc, MY_TRUE);
-                return NULL;
-            }
-
-            /* Initialise the new structure except for the chains */
-
-            *hm = *hm2;
-            hm->mask = mask;
-            mcp = hm->chains;
-            do *mcp++ = NULL; while (--size);
-
-            /* Copy the old chains into the new buckets by rehashing
-             * them.
-             */
-            mcp = hm->chains;
-            mcp2 = hm2->chains;
-            for (j = hm2->mask + 1; --j >= 0; )
-            {
-                map_chain_t *mc2;
+        if ((hm->used + 1) * 2 > size)
+            size *= 2;
 
-                for (mc2 = *mcp2++; mc2; mc2 = next)
-                {
-                    next = mc2->next;
-                    idx = mhash(&(mc2->data[0])) & mask;
-                    mc2->next = mcp[idx];
-                    mcp[idx] = mc2;
-                }
-            }
-            m->hash = hm;
-
-            LOG_ALLOC("get_map_lvalue - existing hash", SIZEOF_MH(hm) - SIZEOF_MH(hm2), sizeof *hm - sizeof *mcp + sizeof *mcp * size);
-            m->user->mapping_total += SIZEOF_MH(hm) - SIZEOF_MH(hm2);
-            check_total_mapping_size();
-
-            /* Away, old data! */
-
-            xfree(hm2);
-        }
+        hm = rebuild_hash(m, size);
+        if (!hm)
+            return NULL;
+    }
 
-        /* Finally, insert the new entry into its chain */
+    /* Get the new entry svalues and insert it into the table.
+     */
+    mc = new_map_chain(m, hm);
+    if (NULL == mc)
+        return NULL;
 
-        idx = mhash(map_index) & hm->mask;
-        mc->next = hm->chains[idx];
-        hm->chains[idx] = mc;
-    }
+    insert_hash_entry(hm, mc, mhash(map_index));
 
     /* With the new map_chain structure inserted, we can adjust
      * the statistics and copy the key value into the structure.
@@ -1139,7 +1421,7 @@ static svalue_t local_const0;
         ; idx--, entry++)
         put_number(entry, 0);
 
-    hm->last_used = current_time;
+    hm->mutations++;
     hm->used++;
     m->num_entries++;
 
@@ -1193,20 +1475,19 @@ mapping_references_objects (mapping_t *m)
         map_chain_t **mcp, *mc;
         p_int i;
 
-        /* Walk all chains */
+        /* Walk all slots */
 
-        for (mcp = hm->chains, i = hm->mask + 1; --i >= 0;)
+        for (mcp = hm->slots, i = hm->mask + 1; --i >= 0;)
         {
-            /* Walk this chain */
-
-            for (mc = *mcp++; NULL != mc; mc = mc->next)
+            mc = *mcp++;
+            if (SLOT_USED(mc))
             {
                 svalue_t * entry = &(mc->data[0]);
 
                 if (T_OBJECT == entry->type || T_CLOSURE == entry->type)
                     return MY_TRUE;
-            } /* walk this chain */
-        } /* walk all chains */
+            }
+        } /* walk all slots */
     } /* if (hash part exists) */
 
     return MY_FALSE;
@@ -1291,16 +1572,17 @@ check_map_for_destr_keys (mapping_t *m)
     
     if ( NULL != (hm = m->hash) )
     {
-        map_chain_t **mcp, **mcp2, *mc;
+        map_chain_t *mc;
         p_int i;
         
-        /* Walk all chains */
+        /* Walk all slots. Removing an entry doesn't move any other
+         * entries, so it is safe to continue the walk.
+         */
         
-        for (mcp = hm->chains, i = hm->mask + 1; --i >= 0;)
+        for (i = 0; i <= hm->mask; i++)
         {
-            /* Walk this chain */
-            
-            for (mcp2 = mcp++; NULL != (mc = *mcp2); )
+            mc = hm->slots[i];
+            if (SLOT_USED(mc))
             {
                 /* Destructed object as key: remove entry */
                 
@@ -1310,7 +1592,7 @@ check_map_for_destr_keys (mapping_t *m)
                 {
                     m->num_entries--;
                     
-                    *mcp2 = mc->next;
+                    clear_hash_slot(hm, i);
                     
                     /* If the mapping is a protector mapping, move
                      * the entry into the 'deleted' list, else
@@ -1318,7 +1600,7 @@ check_map_for_destr_keys (mapping_t *m)
                      */
                     if (hm->ref)
                     {
-                        mc->next = hm->deleted;
+                        mc->u.next = hm->deleted;
                         hm->deleted = mc;
                     }
                     else
@@ -1326,13 +1608,9 @@ check_map_for_destr_keys (mapping_t *m)
                         free_map_chain(m, mc, MY_FALSE);
                     }
                     hm->used--;
-                    continue;
                 }
-
-                mcp2 = &mc->next;
-                
-            } /* walk this chain */
-        } /* walk all chains */
+            }
+        } /* walk all slots */
     } /* if (hash part exists) */
 
     // finally, record the current counter of destructed objects.
@@ -1378,16 +1656,15 @@ check_map_for_destr_values (mapping_t *m)
     
     if ( NULL != (hm = m->hash) )
     {
-        map_chain_t **mcp, **mcp2, *mc;
+        map_chain_t **mcp, *mc;
         p_int i, j;
         
-        /* Walk all chains */
+        /* Walk all slots */
         
-        for (mcp = hm->chains, i = hm->mask + 1; --i >= 0;)
+        for (mcp = hm->slots, i = hm->mask + 1; --i >= 0;)
         {
-            /* Walk this chain */
-            
-            for (mcp2 = mcp++; NULL != (mc = *mcp2); )
+            mc = *mcp++;
+            if (SLOT_USED(mc))
             {
 
                 svalue_t * entry = &(mc->data[0]); // this is the key
@@ -1400,11 +1677,8 @@ check_map_for_destr_values (mapping_t *m)
                         assign_svalue(entry, &const0);
                     }
                 }
-                
-                mcp2 = &mc->next;
-                
-            } /* walk this chain */
-        } /* walk all chains */
+            }
+        } /* walk all slots */
     } /* if (hash part exists) */
         
 } /* check_map_for_destr_values() */
@@ -1489,29 +1763,15 @@ remove_mapping (mapping_t *m, svalue_t *map_index)
                     num_hash_mappings++;
             }
 
-            hm->last_used = current_time;
+            hm->mutations++;
             hm->cond_deleted++;
         }
         else if (mc != NULL && NULL != (hm = m->hash))
         {
             /* The key is in the hash mapping */
 
-            map_chain_t *prev, *mc2;
-            mp_int idx = mhash(entry) & hm->mask;
-
-            for ( prev = 0, mc2 = hm->chains[idx]
-                ; mc2 != NULL && mc2 != mc
-                ; prev = mc2, mc2 = mc2->next)
-                NOOP;
-
-            if (mc2 == NULL)
-                fatal("Mapping entry didn't hash to the same spot.\n");
-
-            /* Unlink the found entry */
-            if (prev)
-                prev->next = mc->next;
-            else
-                hm->chains[idx] = mc->next;
+            /* Remove the found entry from the table */
+            clear_hash_slot(hm, find_hash_slot(hm, mc));
 
             /* If the mapping is a protector mapping, move
              * the entry into the 'deleted' list, else
@@ -1519,7 +1779,7 @@ remove_mapping (mapping_t *m, svalue_t *map_index)
              */
             if (hm->ref)
             {
-                mc->next = hm->deleted;
+                mc->u.next = hm->deleted;
                 hm->deleted = mc;
             }
             else
@@ -1527,11 +1787,10 @@ remove_mapping (mapping_t *m, svalue_t *map_index)
                 free_map_chain(m, mc, MY_FALSE);
             }
 
-            hm->last_used = current_time;
+            hm->mutations++;
             hm->used--;
-            /* TODO: Reduce the size of the hashtable if the average
-             * TODO:: number of entries per chain is <= 1 (or better <= 0.5
-             * TODO:: to provide some breathing space for new entries).
+            /* TODO: Reduce the size of the hashtable if it is
+             * TODO:: less than 1/8 full.
              */
         }
         else
@@ -1613,81 +1872,67 @@ resize_mapping (mapping_t *m, mp_int new_width)
 
     if ( NULL != (hm = m->hash) )
     {
-        map_chain_t **mcp, **mcp2;
+        map_chain_t **mcp, *mc, *mc2;
         mp_int size;
 
         /* Allocate and initialize the hash structure */
 
-        size = hm->mask + 1;
-        hm2 = xalloc(sizeof *hm - sizeof *mcp + sizeof *mcp * size);
+        hm2 = get_new_hash(m2, hm->used);
         if (!hm2)
         {
-            outofmem(sizeof *hm - sizeof *mcp + sizeof *mcp * size, "hash structure");
+            outofmem(sizeof *hm + sizeof *mcp * hm->used, "hash structure");
             /* NOTREACHED */
             return NULL;
         }
 
-        hm2->mask = hm->mask;
-        hm2->used = hm->used;
-        hm2->last_used = current_time;
-        hm2->cond_deleted = 0;
-        hm2->deleted = NULL;
-        hm2->ref = 0;
+        /* Now copy the hash entries */
 
-        /* Now copy the hash chains */
+        for (mcp = hm->slots, size = hm->mask + 1; --size >= 0; )
+        {
+            mc = *mcp++;
+            if (!SLOT_USED(mc))
+                continue;
 
-        mcp = hm->chains;
-        mcp2 = hm2->chains;
-        do {
-            map_chain_t *last = NULL, *mc, *mc2;
+            if(destructed_object_ref(&(mc->data[0])))
+            {
+                --num_entries;
+            }
+            else
+            {
+                svalue_t *src, *dest;
+                p_int i;
 
-            for (mc = *mcp++; mc; mc = mc->next)
-                if(destructed_object_ref(&(mc->data[0])))
+                mc2 = new_map_chain(m2, hm2);
+                if (!mc2)
                 {
-                    --num_entries;
-                    --hm2->used;
+                    outofmem(SIZEOF_MCH(mc, new_width), "hash link");
+                    /* NOTREACHED */
+                    return NULL;
                 }
-                else
-                {
-                    svalue_t *src, *dest;
-                    p_int i;
-
-                    mc2 = new_map_chain(m2);
-                    if (!mc2)
-                    {
-                        xfree(hm2);
-                        outofmem(SIZEOF_MCH(mc, new_width), "hash link");
-                        /* NOTREACHED */
-                        return NULL;
-                    }
-
-                    /* Copy the key and the common values */
-                    for (src = &(mc->data[0]), dest = &(mc2->data[0]), i = common_width
-                        ; i >= 0
-                        ; --i, src++, dest++)
-                    {
-                        assign_svalue_no_free(dest, src);
-                    }
-
-                    /* Zero out any extraneous values */
-                    for (dest = &(mc2->data[common_width+1]), i = new_width - common_width
-                        ; i > 0
-                        ; --i, dest++)
-                    {
-                        put_number(dest, 0);
-                    }
 
+                /* Copy the key and the common values */
+                for (src = &(mc->data[0]), dest = &(mc2->data[0]), i = common_width
+                    ; i >= 0
+                    ; --i, src++, dest++)
+                {
+                    assign_svalue_no_free(dest, src);
+                }
 
-                    mc2->next = last;
-                    last = mc2;
+                /* Zero out any extraneous values */
+                for (dest = &(mc2->data[common_width+1]), i = new_width - common_width
+                    ; i > 0
+                    ; --i, dest++)
+                {
+                    put_number(dest, 0);
                 }
-            *mcp2++ = last;
-        } while (--size);
+
+                insert_hash_entry(hm2, mc2, mc->u.hash);
+                hm2->used++;
+            }
+        }
 
         /* Plug the new hash into the new mapping */
         m2->hash = hm2;
-        LOG_ALLOC("copy_mapping - hash", SIZEOF_MH(hm2), sizeof *hm - sizeof *mcp + sizeof *mcp * size);
-        m->user->mapping_total += SIZEOF_MH(hm2);
         check_total_mapping_size();
         if (m->cond)
             num_dirty_mappings++;
@@ -1990,11 +2235,11 @@ add_mapping (mapping_t *m1, mapping_t *m2)
         p_int size;
 
         size = hm->mask + 1;
-        mcp = hm->chains;
+        mcp = hm->slots;
         do {
-            map_chain_t *mc;
+            map_chain_t *mc = *mcp++;
 
-            for (mc = *mcp++; mc; mc = mc->next)
+            if (SLOT_USED(mc))
             {
                 svalue_t * src, * dest;
                 p_int i;
@@ -2023,11 +2268,11 @@ add_mapping (mapping_t *m1, mapping_t *m2)
         p_int size;
 
         size = hm->mask + 1;
-        mcp = hm->chains;
+        mcp = hm->slots;
         do {
-            map_chain_t *mc;
+            map_chain_t *mc = *mcp++;
 
-            for (mc = *mcp++; mc; mc = mc->next)
+            if (SLOT_USED(mc))
             {
                 svalue_t * src, * dest;
                 p_int i;
@@ -2100,22 +2345,87 @@ walk_mapping ( mapping_t *m
     {
         mp_int size;
 
+        /* Re-read m->hash in every step, in case <func> caused
+         * the table to be rebuilt.
+         */
         for (size = hm->mask; size >= 0; size--)
         {
             map_chain_t *mc;
 
-            for (mc = hm->chains[size]; mc != NULL; )
-            {
-                map_chain_t *next = mc->next;
-                if (!destructed_object_ref(&(mc->data[0])))
-                    (*func)(&(mc->data[0]), &(mc->data[1]), extra);
-                mc = next;
-            }
+            if (NULL == (hm = m->hash) || size > hm->mask)
+                break;
+
+            mc = hm->slots[size];
+            if (SLOT_USED(mc) && !destructed_object_ref(&(mc->data[0])))
+                (*func)(&(mc->data[0]), &(mc->data[1]), extra);
         }
     }
 
 } /* walk_mapping() */
 
+/*-------------------------------------------------------------------------*/
+static Bool
+worth_compacting (mapping_t *m, mapping_hash_t *hm)
+
+/* Decide if the dirty mapping <m> with the hash part <hm> should be
+ * compacted by a regular cleanup, using the accesses counted since the
+ * last check (see the description at the top of the file).
+ */
+
+{
+    p_int cond_size = m->cond ? (p_int)m->cond->size : 0;
+
+    /* Not used since the last check: the hash part is just overhead. */
+    if (!hm->mutations && !hm->lookups)
+        return MY_TRUE;
+
+    /* A lot of waste: compact even if it's mutated frequently. */
+    if (cond_size
+     && (   hm->cond_deleted * 2 >= cond_size
+         || hm->used >= cond_size - hm->cond_deleted))
+        return MY_TRUE;
+
+    /* Mostly mutated: it would be dirty again soon. */
+    if (hm->mutations > hm->lookups)
+        return MY_FALSE;
+
+    /* Mostly read: compact if the probes in the hash part since the
+     * last check outweigh the cost of the compaction.
+     */
+    return hm->probes >= m->num_entries;
+} /* worth_compacting() */
+
+/*-------------------------------------------------------------------------*/
+static void
+note_compaction (mp_int saved)
+
+/* Count a mapping compaction which saved <saved> bytes of memory.
+ */
+
+{
+    num_compactions++;
+    size_compaction_saved += saved;
+    num_cycle_compactions++;
+    size_cycle_compaction_saved += saved;
+} /* note_compaction() */
+
+/*-------------------------------------------------------------------------*/
+void
+mapping_compaction_cycle (void)
+
+/* Called by the backend at the end of each cycle of object processing:
+ * remember the compaction statistics of the cycle (including the
+ * compactions done since the previous cycle outside of it, e.g. by
+ * a garbage collection) and start counting anew.
+ */
+
+{
+    num_last_compactions = num_cycle_compactions;
+    size_last_compaction_saved = size_cycle_compaction_saved;
+    num_cycle_compactions = 0;
+    size_cycle_compaction_saved = 0;
+} /* mapping_compaction_cycle() */
+
 /*-------------------------------------------------------------------------*/
 Bool
 compact_mapping (mapping_t *m, Bool force)
@@ -2123,10 +2433,8 @@ compact_mapping (mapping_t *m, Bool force)
 /* Compact the mapping <m>.
  *
  * If <force> is TRUE, always compact the mapping.
- * If <force> is FALSE, the mappings is compacted if
- *   - have a .last_used time of 2*TIME_TO_COMPACT or more seconds earlier,
- *   - or have to have at least half of their condensed entries deleted
- *     and have a .last_used time of TIME_TO_COMPACT or more seconds earlier.
+ * If <force> is FALSE, the mapping is compacted if worth_compacting()
+ * says so, and the access counters of the hash part are reset otherwise.
  *
  * Return TRUE if the mapping has been freed altogether in the function
  * (ie. <m> is now invalid), or FALSE if it still exists.
@@ -2161,13 +2469,16 @@ compact_mapping (mapping_t *m, Bool force)
        */
 
     mp_int count1, count2;
-    map_chain_t **mcpp, *mcp, *next;
+    map_chain_t **mcpp, *mcp;
     map_chain_t *last_hash;
       /* Auxiliaries */
 
     mp_int runlength;
       /* Current Mergesort partition length */
 
+    mp_int size_before;
+      /* Memory used by the hash and condensed parts before the compaction */
+
     malloc_privilege = MALLOC_SYSTEM;
       /* compact_mappings() may be called in very low memory situations,
        * so it has to be allowed to use the system reserve.
@@ -2221,20 +2532,15 @@ compact_mapping (mapping_t *m, Bool force)
 
     /* Test the compaction criterium.
      * By testing it before check_map_for_destr_keys(), the size related
-     * criterias might trigger later than desired, but the time criterium
+     * criterias might trigger later than desired, but the idle criterium
      * makes sure that we won't miss one.
      */
-    if (!force
-     && !(   current_time - hm->last_used >= TIME_TO_COMPACT
-          && (   hm->cond_deleted * 2 >= m->num_entries - hm->used 
-              || hm->used >= m->num_entries - hm->used - hm->cond_deleted
-              || current_time - hm->last_used >= 2*TIME_TO_COMPACT
-             )
-         )
-       )
+    if (!force && !worth_compacting(m, hm))
     {
-        /* This mapping doesn't qualify for compaction.
+        /* This mapping doesn't qualify for compaction, start
+         * a new measuring period.
          */
+        hm->mutations = hm->lookups = hm->probes = 0;
         m->ref--; /* undo the ref increment from above */
         malloc_privilege = old_malloc_privilege;
         return MY_FALSE;
@@ -2256,6 +2562,8 @@ compact_mapping (mapping_t *m, Bool force)
         LOG_SUB("compact_mapping(): no need to", SIZEOF_MH(hm));
         malloc_privilege = old_malloc_privilege;
         m->user->mapping_total -= SIZEOF_MH(hm);
+        note_compaction(SIZEOF_MH_ALL(hm));
+        free_map_pool(m, hm);
         m->hash = NULL;
 
         if (m->cond)
@@ -2276,6 +2584,8 @@ compact_mapping (mapping_t *m, Bool force)
 
     /* This mapping can be compacted, and there is something to compact. */
 
+    size_before = SIZEOF_MH_ALL(hm) + (cm ? SIZEOF_MC(cm, m->num_values) : 0);
+
     /* Get the temporary result mapping (we need the condensed block
      * anyway, and this way it's simple to keep the statistics
      * straight).
@@ -2295,7 +2605,7 @@ compact_mapping (mapping_t *m, Bool force)
     {
         /* --- Setup Mergesort ---
          *
-         * Unravel all hash chains into two chains, dangling from hook1
+         * Link all hashed entries into two chains, dangling from hook1
          * and hook2.
          *
          * The chains differ in length by at most 1 element. Within
@@ -2304,30 +2614,28 @@ compact_mapping (mapping_t *m, Bool force)
          * In this loop, hook1 is always the next chain to add to,
          * and last_hash is the first element of the next pair to add.
          */
-        mcpp = hm->chains;
+        mcpp = hm->slots;
         count1 = hm->mask;
         hook1 = hook2 = NULL;
         last_hash = NULL;
 
         do {
             mcp = *mcpp;
-            *mcpp++ = NULL; /* m no longer owns this chain */
-            while (mcp)
+            *mcpp++ = NULL; /* m no longer owns this entry */
+            if (SLOT_USED(mcp))
             {
-                next = mcp->next;
-
                 if (last_hash)
                 {
                     int d = svalue_cmp(&(mcp->data[0]), &(last_hash->data[0]));
 
                     if (d < 0) {
-                        last_hash->next = hook1;
-                        mcp->next = last_hash;
+                        last_hash->u.next = hook1;
+                        mcp->u.next = last_hash;
                         hook1 = hook2;
                         hook2 = mcp;
                     } else {
-                        mcp->next = hook1;
-                        last_hash->next = mcp;
+                        mcp->u.next = hook1;
+                        last_hash->u.next = mcp;
                         hook1 = hook2;
                         hook2 = last_hash;
                     }
@@ -2337,14 +2645,13 @@ compact_mapping (mapping_t *m, Bool force)
                 {
                     last_hash = mcp;
                 }
-                mcp = next;
             }
         } while (--count1 >= 0);
 
         /* Add the remaining odd element */
         if (last_hash)
         {
-            last_hash->next = hook1;
+            last_hash->u.next = hook1;
             hook1 = last_hash;
         }
 
@@ -2367,7 +2674,7 @@ compact_mapping (mapping_t *m, Bool force)
                 out2 = &out_hook1;
                 *out2 = hook2;
                 while (--count2 >= 0) {
-                    out2 = &(*out2)->next;
+                    out2 = &(*out2)->u.next;
                 }
                 hook2 = *out2;
                 count1 = count2 = runlength;
@@ -2378,7 +2685,7 @@ compact_mapping (mapping_t *m, Bool force)
                 out2 = &out_hook1;
                 *out2 = hook1;
                 do {
-                    out2 = &(*out2)->next;
+                    out2 = &(*out2)->u.next;
                 } while (--count1);
                 hook1 = *out2;
                 count1 = count2 = runlength;
@@ -2399,13 +2706,13 @@ compact_mapping (mapping_t *m, Bool force)
                     if (d > 0)
                     {
                         *out1 = hook2;
-                        out1 = &hook2->next;
+                        out1 = &hook2->u.next;
                         hook2 = *out1;
                         if (!--count2)
                         {
                             *out1 = hook1;
                             do {
-                                out1 = &(*out1)->next;
+                                out1 = &(*out1)->u.next;
                             } while (--count1);
                             hook1 = *out1;
                             break;
@@ -2414,13 +2721,13 @@ compact_mapping (mapping_t *m, Bool force)
                     else
                     {
                         *out1 = hook1;
-                        out1 = &hook1->next;
+                        out1 = &hook1->u.next;
                         hook1 = *out1;
                         if (!--count1)
                         {
                             *out1 = hook2;
                             do {
-                                out1 = &(*out1)->next;
+                                out1 = &(*out1)->u.next;
                             } while (--count2);
                             hook2 = *out1;
                             break;
@@ -2484,7 +2791,6 @@ compact_mapping (mapping_t *m, Bool force)
                 {
                     /* Take entry from hook1 */
 
-                    map_chain_t *temp;
                     svalue_t    *src;
                     p_int i;
 
@@ -2493,9 +2799,7 @@ compact_mapping (mapping_t *m, Bool force)
                     for (src = &(hook1->data[1]), i = num_values; i > 0; --i)
                         *dest_data++ = *src++;
 
-                    temp = hook1;
-                    hook1 = temp->next;
-                    free_map_chain(m, temp, MY_TRUE);
+                    hook1 = hook1->u.next;
                 }
                 else
                 {
@@ -2544,7 +2848,6 @@ compact_mapping (mapping_t *m, Bool force)
 
                 while (hook1)
                 {
-                    map_chain_t *temp;
                     svalue_t    *src;
                     p_int i;
 
@@ -2553,9 +2856,7 @@ compact_mapping (mapping_t *m, Bool force)
                     for (src = &(hook1->data[1]), i = num_values; i > 0; --i)
                         *dest_data++ = *src++;
 
-                    temp = hook1;
-                    hook1 = temp->next;
-                    free_map_chain(m, temp, MY_TRUE);
+                    hook1 = hook1->u.next;
                 }
             }
         } /* --- End of Merge --- */
@@ -2563,7 +2864,7 @@ compact_mapping (mapping_t *m, Bool force)
 
     /* Switch the new key and data blocks from m2 to m, and
      * vice versa for the old ones. We don't assign the hash block
-     * as we already deleted all the map_chain structures.
+     * as we already moved all the entry values out of it.
      */
     m->cond = cm2;
     m2->cond = cm;
@@ -2573,13 +2874,13 @@ compact_mapping (mapping_t *m, Bool force)
     LOG_SUB("compact_mapping() - remove old hash", SIZEOF_MH(hm));
     malloc_privilege = old_malloc_privilege;
     m->user->mapping_total -= SIZEOF_MH(hm);
+    free_map_pool(m, hm);
     check_total_mapping_size();
-      /* The memorysize for the map_chain_t structure has already been
-       * subtracted.
-       */
 
     xfree(hm);
 
+    note_compaction(size_before - (cm2 ? SIZEOF_MC(cm2, num_values) : 0));
+
     free_empty_mapping(m2);
       /* Get rid of the temporary mapping and the old cond block.
        */
@@ -2657,6 +2958,39 @@ total_mapping_size (void)
     return total;
 } /* total_mapping_size() */
 
+/*-------------------------------------------------------------------------*/
+void
+mapping_driver_info (svalue_t *svp, int value)
+
+/* Returns the mapping compaction information for driver_info(<what>).
+ * <svp> points to the svalue for the result.
+ */
+
+{
+    switch (value)
+    {
+        case DI_NUM_MAPPING_COMPACTIONS:
+            put_number(svp, num_compactions);
+            break;
+
+        case DI_NUM_MAPPING_COMPACTIONS_LAST_CYCLE:
+            put_number(svp, num_last_compactions);
+            break;
+
+        case DI_SIZE_MAPPING_COMPACTIONS_SAVED:
+            put_number(svp, size_compaction_saved);
+            break;
+
+        case DI_SIZE_MAPPING_COMPACTIONS_SAVED_LAST_CYCLE:
+            put_number(svp, size_last_compaction_saved);
+            break;
+
+        default:
+            fatal("Unknown option for mapping_driver_info(): %d\n", value);
+            break;
+    }
+} /* mapping_driver_info() */
+
 /*-------------------------------------------------------------------------*/
 size_t
 mapping_overhead (mapping_t *m)
@@ -2671,8 +3005,8 @@ mapping_overhead (mapping_t *m)
     if (m->cond)
         rc += sizeof(m->cond) - sizeof(svalue_t);
     if (m->hash)
-        rc += SIZEOF_MH(m->hash)
-              + m->hash->used * (sizeof(map_chain_t) - sizeof(svalue_t))
+        rc += SIZEOF_MH_ALL(m->hash)
+              - m->hash->used * (m->num_values + 1) * sizeof(svalue_t)
            ;
 
     return rc;
@@ -2968,7 +3302,13 @@ count_ref_in_mapping (mapping_t *m)
     if (m->cond)
         note_malloced_block_ref(m->cond);
     if (m->hash)
+    {
+        map_block_t *mb;
+
         note_malloced_block_ref(m->hash);
+        for (mb = m->hash->blocks; mb != NULL; mb = mb->next)
+            note_malloced_block_ref(mb);
+    }
 
     /* Count references by condensed keys and their data.
      * Take special care of keys referencing destructed objects/lambdas.
@@ -2980,14 +3320,16 @@ count_ref_in_mapping (mapping_t *m)
         svalue_t * key = &(m->cond->data[size]);
         svalue_t * data = COND_DATA(m->cond, size, num_values);
 
-        if (destructed_object_ref(key))
+        /* The snapshot GC counts these entries as they are, the driver
+         * keeps them.
+         */
+        if (!gc_in_snapshot && destructed_object_ref(key))
         {
             /* This key is a destructed object, resp. is bound to a destructed
              * object. The entry has to be deleted.
              */
             handle_destructed_key(key);
             m->num_entries--;
-
             any_destructed = MY_TRUE;
         }
         else
@@ -3003,18 +3345,16 @@ count_ref_in_mapping (mapping_t *m)
     size = m->hash ? m->hash->mask+1 : 0;
     while ( --size >= 0)
     {
-        map_chain_t * mc = m->hash->chains[size];
+        map_chain_t * mc = m->hash->slots[size];
 
-        for ( ; mc != NULL; mc = mc->next)
+        if (SLOT_USED(mc))
         {
-            note_malloced_block_ref(mc);
-            if (destructed_object_ref(mc->data))
+            if (!gc_in_snapshot && destructed_object_ref(mc->data))
             {
                 /* This key is a destructed object, resp. is bound to a
                  * destructed object. The entry has to be deleted.
                  */
                 handle_destructed_key(mc->data);
-
                 any_destructed = MY_TRUE;
             }
             else
@@ -3147,39 +3487,23 @@ clean_stale_mappings (void)
 
             for (ix = 0; ix <= (size_t)hm->mask; ix++)
             {
-                map_chain_t * mc, * mcp;
+                map_chain_t * mc = hm->slots[ix];
 
-                for (mcp = NULL, mc = hm->chains[ix]; mc != NULL ; )
+                if (SLOT_USED(mc) && mc->data[0].type == T_INVALID)
                 {
-                    if (mc->data[0].type == T_INVALID)
-                    {
-                        /* This key has been marked for deletion,
-                         * now remove it altogether.
-                         */
-                        map_chain_t * this = mc;
+                    /* This key has been marked for deletion,
+                     * now remove it altogether. The entry goes
+                     * back into the pool, the memory remains
+                     * accounted with the hash part.
+                     */
+                    clear_hash_slot(hm, ix);
 
-                        if (mcp == NULL)
-                        {
-                            hm->chains[ix] = this->next;
-                        }
-                        else
-                        {
-                            mcp->next = this->next;
-                        }
-                        mc = this->next;
+                    mc->u.next = hm->free_entries;
+                    hm->free_entries = mc;
 
-                        m->num_entries--;
-                        hm->used--;
-                        m->user->mapping_total -= SIZEOF_MCH(this, num_values);
-                        xfree(this);
-                    }
-                    else
-                    {
-                        /* Valid key - just step forward */
-                        mcp = mc;
-                        mc = mc->next;
-                    }
-                } /* for(mc) */
+                    m->num_entries--;
+                    hm->used--;
+                }
             } /* for(ix) */
         } /* hash part */
 
@@ -3840,7 +4164,7 @@ f_walk_mapping_cleanup (error_handler_t *arg)
 
             for (mc = hm->deleted; mc; mc = next)
             {
-                next = mc->next;
+                next = mc->u.next;
                 free_map_chain(m, mc, MY_FALSE);
             }
 
@@ -3,6 +3,7 @@
 
 #include "driver.h"
 #include "typedefs.h"
+#include "cyclegc.h"
 #include "svalue.h"
 
 /* --- Types --- */
@@ -23,6 +24,10 @@ struct mapping_s {
     p_int       num_values;        /* Number of values for a key */
     p_int       num_entries;       /* Number of valid entries */
     uint32_t    last_destr_check;  /* Last check for destr. object in keys */
+#ifdef USE_CYCLE_COLLECTOR
+    uint32_t    cc_root;
+      /* Index+1 in the roots of the cycle collector, or 0 */
+#endif
     struct mapping_cond_s * cond;  /* Condensed entries */
     struct mapping_hash_s * hash;  /* Hashed entries */
     mapping_t  *next;
@@ -34,9 +39,10 @@ struct mapping_s {
 /* --- struct mapping_hash_s: the hashed index ---
  *
  * New entries in a mapping are stored in a hash structure for fast
- * access. The hash grows dynamically with the number of entries -
- * the structure is then reallocated to fit - the goal is to keep
- * on average two entries per hash bucket.
+ * access. The entries themselves are allocated from pool blocks owned by
+ * the hash structure, and indexed by an open addressing table which grows
+ * dynamically with the number of entries - the structure is then
+ * reallocated to fit - the goal is to keep the table at most 3/4 full.
  *
  * This structure is exported so that interpret.c can use it to
  * build protectors.
@@ -45,16 +51,25 @@ struct mapping_s {
 struct mapping_hash_s {
     p_int         used;        /* Number of entries in the hash */
     p_int         mask;
-      /* Index mask for chains[], converting the raw hash value into
+      /* Index mask for slots[], converting the raw hash value into
        * the valid index number using a bit-and operation.
-       * Incremented by one, it's the number of chains.
+       * Incremented by one, it's the number of slots.
+       */
+    p_int         deleted_slots;
+      /* Number of slots[] marked as deleted.
        */
     p_int         ref;
       /* Refcount if this mapping is part of a T_PROTECTOR_MAPPING svalue.
        * The value is <= the mappings main refcount.
        */
-    mp_int        last_used;
-      /* Time of the last change (add or delete) to the mapping.
+    p_int         mutations;
+      /* Number of additions and deletions since the last compaction check.
+       */
+    p_int         lookups;
+      /* Number of lookups in the hash part since the last compaction check.
+       */
+    p_int         probes;
+      /* Number of slots probed by these lookups.
        */
     p_int         cond_deleted;
       /* Number of entries deleted from the condensed part
@@ -64,24 +79,37 @@ struct mapping_hash_s {
        * pending because the they may still be used as destination for
        * a lvalue.
        */
-    struct map_chain_s * chains[ 1 /* +.mask */ ];
-      /* The hash chain heads ('hash buckets')
+    struct map_chain_s *free_entries;
+      /* List of unused entries in the pool blocks.
+       */
+    struct map_block_s *blocks;
+      /* The pool blocks holding the entries.
+       */
+    mp_int        pool_size;
+      /* Total allocated size of the pool blocks.
+       */
+    struct map_chain_s * slots[ 1 /* +.mask */ ];
+      /* The open addressing table of entries, followed by the
+       * tags of the slots (see HASH_TAGS()).
        */
 };
 
-#define SIZEOF_MH_ALL(hm, nv) ( \
-    sizeof(*(hm)) + sizeof(map_chain_t *) * (hm)->mask \
-                  + (sizeof(map_chain_t) + sizeof(svalue_t) * (nv)) * ((hm)->used) \
-                      )
-  /* Allocation size of a given mapping_hash_t structure for a mapping
-   * with <nv> values per key, including map_chain structures.
+#define HASH_TAGS(hm) ((unsigned char *)((hm)->slots + (hm)->mask + 1))
+  /* The array of the .mask+1 slot tags of mapping_hash_t <hm>, each
+   * holding some bits of the hash of the entry in the slot.
+   */
+
+#define SIZEOF_MH_ALL(hm) ( SIZEOF_MH(hm) + (hm)->pool_size )
+  /* Allocation size of a given mapping_hash_t structure, including
+   * the pool blocks with the entries.
    */
 
 #define SIZEOF_MH(hm) ( \
-    sizeof(*(hm)) + sizeof(map_chain_t *) * (hm)->mask \
+    sizeof(*(hm)) + sizeof(struct map_chain_s *) * (hm)->mask \
+                  + (hm)->mask + 1 \
                       )
   /* Allocation size of a given mapping_hash_t structure, excluding
-   * the map_chain structures.
+   * the pool blocks.
    */
 
 
@@ -154,11 +182,18 @@ struct mvf_info
 
 /* Bool free_mapping(mapping_t *m)
  *   Subtract one ref from mapping <m>, and free the mapping fully if
- *   the refcount reaches zero.
+ *   the refcount reaches zero. Otherwise <m> may have become cyclic
+ *   garbage and is handed to the cycle collector.
  *   Return TRUE if the mapping is deallocated, and FALSE if not.
  */
 
+#ifdef USE_CYCLE_COLLECTOR
+#define free_mapping(m) ( (--((m)->ref) <= 0) ? _free_mapping(m, MY_FALSE) \
+                        : (cycle_collection && !(m)->cc_root) ? cc_add_mapping(m) \
+                        : MY_FALSE )
+#else
 #define free_mapping(m) ( (--((m)->ref) <= 0) ? _free_mapping(m, MY_FALSE) : MY_FALSE )
+#endif
 
 /* p_int deref_mapping(mapping_t *m)
  *   Subtract one ref from mapping <m>, but don't check if it needs to
@@ -178,6 +213,9 @@ extern mp_int num_dirty_mappings;
 extern mapping_t *allocate_mapping(mp_int size, mp_int num_values);
 extern mapping_t *allocate_cond_mapping(wiz_list_t * user, mp_int size, mp_int num_values);
 extern Bool _free_mapping(mapping_t *m, Bool no_data);
+#ifdef USE_CYCLE_COLLECTOR
+extern void clear_mapping(mapping_t *m);
+#endif
 #define free_empty_mapping(m) _free_mapping(m, MY_TRUE)
 extern void free_protector_mapping(mapping_t *m);
 extern svalue_t *_get_map_lvalue(mapping_t *m, svalue_t *map_index, Bool need_lvalue, Bool check_size);
@@ -195,6 +233,8 @@ extern mapping_t *add_mapping(mapping_t *m1, mapping_t *m2);
 extern void walk_mapping(mapping_t *m, void (*func)(svalue_t *key, svalue_t *val, void *extra), void *extra);
 extern Bool compact_mapping(mapping_t *m, Bool force);
 extern mp_int total_mapping_size(void);
+extern void mapping_compaction_cycle(void);
+extern void mapping_driver_info(svalue_t *svp, int value);
 extern size_t mapping_overhead(mapping_t *m);
 extern void set_mapping_user(mapping_t *m, object_t *owner);
 
@@ -13,8 +13,19 @@
  * On the creation of a new string the driver can lookup the table for
  * an already existing copy and return a reference to a string held therein.
  * This is used mainly for function names in programs, but also for
- * mapping keys. The table is organized as a hash table
- * with HTABLE_SIZE entries.
+ * mapping keys. The table is organized as a hash table with a power-of-two
+ * number of chains, starting with (at least) HTABLE_SIZE entries.
+ *
+ * The table grows when the number of tabled strings exceeds
+ * STRINGTABLE_MAX_LOAD strings per chain, and shrinks back (not below its
+ * initial size) when it falls under 1/STRINGTABLE_MIN_LOAD_INV strings per
+ * chain. Resizing doesn't happen in one go: a new table is allocated and
+ * the chains of the old table are migrated one by one, a few with every
+ * string added and a larger batch with every backend cycle
+ * (mstring_rehash_step()). While this is in progress, old chains with
+ * an index >= rehash_index are still authoritative; all others have already
+ * been moved into the new table. This way every string has exactly one
+ * chain it can be in, and a lookup still needs just one chain search.
  *
  * Strings are sequences of chars, stored in an array of known size. The
  * size itself is stored separately, allowing the string to contain every
@@ -31,13 +42,18 @@
  *            Bool tabled      :  1;
  *            unsigned int ref : 31;
  *        } info;
+ *        hash32_t   hash;            0, or the hash of the string
  *        string_t * next;            String table pointer.
- *        size_t     size;            Length of the string 
- *        hash32_t    hash;            0, or the hash of the string
+ *        size_t     size;            Length of the string
  *        char       txt[1.. .size];
  *        char       null             Gratuituous terminator
  *    }
  *
+ * A string is allocated with just MSTR_HEADER_SIZE + .size bytes, not
+ * with the padded sizeof(string_t). Most strings in a mud are short
+ * (verbs, ids, directions, property names), so the header is the
+ * larger part of them and every word saved there counts.
+ *
  * The hash of the string is computed on-demand. Should the string hash
  * to value 0, the value 0x8000 is used instead - this way the usual
  * calculation (hash % tablesize) won't be affected.
@@ -81,23 +97,42 @@
 #include "../mudlib/sys/driver_info.h"
 
 /*-------------------------------------------------------------------------*/
-#if HTABLE_SIZE > MAX_HASH32
-#error The hash table size must not be larger then MAX_HASH32.
+#if HTABLE_SIZE > MAX_HASH32 / 2
+#error The hash table size must not be larger then MAX_HASH32 / 2.
 The end.
 #endif
 
+#define STRINGTABLE_MAX_SIZE ((hash32_t)1 << 30)
+  /* The string table doesn't grow beyond this number of chains.
+   */
+
+#define STRINGTABLE_MAX_LOAD 2
+  /* The table is doubled when there are more tabled strings than
+   * STRINGTABLE_MAX_LOAD times the number of chains.
+   */
+
+#define STRINGTABLE_MIN_LOAD_INV 8
+  /* The table is shrunk when there are less tabled strings than
+   * the number of chains / STRINGTABLE_MIN_LOAD_INV.
+   */
+
+#define REHASH_CHAINS_PER_ADD 2
+  /* Number of old chains migrated with every string added to the table
+   * during a resize. As the table grows again only after the number
+   * of strings doubled, this guarantees that a resize is finished before
+   * the next one becomes necessary.
+   */
+
+#define REHASH_CHAINS_PER_STEP 16384
+  /* Number of old chains migrated by every call to mstring_rehash_step().
+   */
+
 static INLINE hash32_t
-HashToIndex(hash32_t hash)
-/* Adapt a hash value to our table size.
+HashToIndex (hash32_t hash, hash32_t size)
+/* Adapt a hash value to a table of <size> chains (a power of 2).
  */
 {
-#if !( (HTABLE_SIZE) & (HTABLE_SIZE)-1 )
-    // use faster masking in case of HTABLE_SIZE being a power of 2.
-    return hash & ((HTABLE_SIZE)-1);
-#else
-    // fallback to slow modulo.
-    return hash % HTABLE_SIZE;
-#endif
+    return hash & (size - 1);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -107,6 +142,28 @@ static string_t ** stringtable = NULL;
    * the string chains.
    */
 
+static hash32_t stringtable_size = 0;
+  /* The number of chains in stringtable[], a power of 2.
+   */
+
+static hash32_t min_stringtable_size = 0;
+  /* The initial size of the stringtable[], it won't shrink below this.
+   */
+
+static string_t ** old_stringtable = NULL;
+  /* During a resize: the previous string table, whose chains are
+   * moved into stringtable[] bit by bit. NULL otherwise.
+   */
+
+static hash32_t old_stringtable_size = 0;
+  /* The number of chains in old_stringtable[].
+   */
+
+static hash32_t rehash_index = 0;
+  /* During a resize: the index of the next chain in old_stringtable[]
+   * to migrate. All chains below it are empty.
+   */
+
 /* Statistics */
 
        mp_uint mstr_used = 0;
@@ -144,6 +201,27 @@ static statcounter_t mstr_collisions = 0;
   /* Number of collisions when adding a new distinct string.
    */
 
+static statcounter_t mstr_resizes = 0;
+  /* Number of times the string table was resized.
+   */
+
+static statcounter_t mstr_appends_in_place = 0;
+  /* Number of mstring_extend() calls which appended in place.
+   */
+
+static statcounter_t mstr_appends_copied = 0;
+  /* Number of mstring_extend() calls which had to copy the string.
+   */
+
+static mp_uint mstr_max_chain_before_resize = 0;
+  /* Length of the longest chain searched between the previous and the
+   * last resize.
+   */
+
+static mp_uint mstr_max_chain_searched = 0;
+  /* Length of the longest chain searched since the last resize.
+   */
+
 static mp_uint mstr_untabled_count = 0;
   /* Number of distinct untabled strings.
    */
@@ -253,6 +331,174 @@ mstring_get_hash (string_t * pStr)
     return get_hash(pStr);
 } /* mstring_get_hash() */
 
+/*-------------------------------------------------------------------------*/
+static INLINE string_t **
+find_chain (hash32_t hash)
+/* Return the head of the chain which holds (or would hold) the strings
+ * with <hash>. During a resize this is the chain of the old table
+ * if that one hasn't been migrated yet.
+ */
+
+{
+    if (old_stringtable != NULL)
+    {
+        hash32_t idx = HashToIndex(hash, old_stringtable_size);
+
+        if (idx >= rehash_index)
+            return &old_stringtable[idx];
+    }
+
+    return &stringtable[HashToIndex(hash, stringtable_size)];
+} /* find_chain() */
+
+/*-------------------------------------------------------------------------*/
+static mp_uint
+longest_chain (void)
+/* Return the length of the longest chain in the table(s).
+ */
+
+{
+    mp_uint max_len = 0;
+    string_t **table = stringtable;
+    hash32_t size = stringtable_size;
+    int t;
+
+    for (t = 0; t < 2; t++)
+    {
+        hash32_t x;
+
+        for (x = 0; table != NULL && x < size; x++)
+        {
+            string_t *p;
+            mp_uint len = 0;
+
+            for (p = table[x]; p != NULL; p = p->next)
+                len++;
+            if (len > max_len)
+                max_len = len;
+        }
+
+        table = old_stringtable;
+        size = old_stringtable_size;
+    }
+
+    return max_len;
+} /* longest_chain() */
+
+/*-------------------------------------------------------------------------*/
+static void
+rehash_chains (hash32_t num)
+/* During a resize: move the next <num> chains of the old table into the
+ * new one. When all chains are migrated, the old table is deallocated.
+ */
+
+{
+    for ( ; num > 0 && rehash_index < old_stringtable_size; num--)
+    {
+        string_t *p = old_stringtable[rehash_index];
+
+        old_stringtable[rehash_index++] = NULL;
+        if (p == NULL)
+            continue;
+
+        mstr_chains--;
+        while (p != NULL)
+        {
+            string_t *next = p->next;
+            string_t **chain = &stringtable[HashToIndex(get_hash(p), stringtable_size)];
+
+            if (*chain == NULL)
+                mstr_chains++;
+            p->next = *chain;
+            *chain = p;
+            p = next;
+        }
+    }
+
+    if (rehash_index >= old_stringtable_size)
+    {
+        xfree(old_stringtable);
+        old_stringtable = NULL;
+        old_stringtable_size = 0;
+        rehash_index = 0;
+    }
+} /* rehash_chains() */
+
+/*-------------------------------------------------------------------------*/
+static void
+resize_stringtable (hash32_t new_size)
+/* Start resizing the string table to <new_size> chains. A resize
+ * still in progress is finished first. If there is not enough memory for
+ * the new table, the old one is kept.
+ */
+
+{
+    string_t **new_table;
+    hash32_t x;
+
+    if (old_stringtable != NULL)
+        rehash_chains(old_stringtable_size);
+
+    new_table = xalloc(sizeof(*new_table) * new_size);
+    if (!new_table)
+        return;
+
+    for (x = 0; x < new_size; x++)
+        new_table[x] = NULL;
+
+    mstr_max_chain_before_resize = mstr_max_chain_searched;
+    mstr_max_chain_searched = 0;
+    mstr_resizes++;
+
+    old_stringtable = stringtable;
+    old_stringtable_size = stringtable_size;
+    rehash_index = 0;
+
+    stringtable = new_table;
+    stringtable_size = new_size;
+} /* resize_stringtable() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE void
+string_added (void)
+/* Called after a string has been added to the table: continue a pending
+ * resize, or start one if the table became too crowded.
+ */
+
+{
+    if (old_stringtable != NULL)
+        rehash_chains(REHASH_CHAINS_PER_ADD);
+    else if (mstr_tabled_count > (mp_uint)stringtable_size * STRINGTABLE_MAX_LOAD
+          && stringtable_size < STRINGTABLE_MAX_SIZE)
+        resize_stringtable(stringtable_size * 2);
+} /* string_added() */
+
+/*-------------------------------------------------------------------------*/
+void
+mstring_rehash_step (void)
+
+/* Called from the backend loop: migrate the next batch of chains if the
+ * string table is being resized, or start shrinking it if it has become
+ * too sparse.
+ */
+
+{
+    if (old_stringtable != NULL)
+        rehash_chains(REHASH_CHAINS_PER_STEP);
+    else if (stringtable_size > min_stringtable_size
+          && mstr_tabled_count < stringtable_size / STRINGTABLE_MIN_LOAD_INV)
+    {
+        hash32_t new_size = stringtable_size / 2;
+
+        /* Shrink in one go to a load of at least 1/2 string per chain. */
+        while (new_size > min_stringtable_size
+            && mstr_tabled_count < new_size / 2)
+            new_size /= 2;
+
+        resize_stringtable(new_size);
+    }
+} /* mstring_rehash_step() */
+
 /*-------------------------------------------------------------------------*/
 static INLINE string_t *
 find_and_move (const char * const s, size_t size, hash32_t hash)
@@ -265,15 +511,15 @@ find_and_move (const char * const s, size_t size, hash32_t hash)
 
 {
     string_t *prev, *rover;
+    mp_uint len = 0;
 
-    hash32_t idx = HashToIndex(hash);
+    string_t **chain = find_chain(hash);
 
     mstr_searches_byvalue++;
 
     /* Find the string in the table */
 
-    mstr_searchlen_byvalue++;
-    for ( prev = NULL, rover = stringtable[idx]
+    for ( prev = NULL, rover = *chain
         ;    rover != NULL
           && get_txt(rover) != s
           && !(   size == mstrsize(rover)
@@ -282,7 +528,16 @@ find_and_move (const char * const s, size_t size, hash32_t hash)
               )
         ; prev = rover, rover = rover->next
         )
-        mstr_searchlen_byvalue++;
+        len++;
+
+    mstr_searchlen_byvalue += len + 1;
+
+    /* An unsuccessful search walked the whole chain, which is how new
+     * strings are added: this keeps track of the longest chain without
+     * having to walk the table.
+     */
+    if (len > mstr_max_chain_searched)
+        mstr_max_chain_searched = len;
 
     /* If the string is in the table (rover != NULL), but not at the beginning
      * of the chain, move it there.
@@ -290,8 +545,8 @@ find_and_move (const char * const s, size_t size, hash32_t hash)
     if (rover && prev)
     {
         prev->next = rover->next;
-        rover->next = stringtable[idx];
-        stringtable[idx] = rover;
+        rover->next = *chain;
+        *chain = rover;
     }
 
     if (rover)
@@ -302,9 +557,9 @@ find_and_move (const char * const s, size_t size, hash32_t hash)
 
 /*-------------------------------------------------------------------------*/
 static INLINE string_t *
-move_to_head (string_t *s, int idx)
+move_to_head (string_t *s, string_t **chain)
 
-/* If <s> is a tabled string in the stringtable[<index>] chain: move it to
+/* If <s> is a tabled string in the string table <chain>: move it to
  * the head of the chain and return its pointer.
  * If <s> is not found in that chain, return NULL.
  */
@@ -317,7 +572,7 @@ move_to_head (string_t *s, int idx)
     /* Find the string in the table */
 
     mstr_searchlen++;
-    for ( prev = NULL, rover = stringtable[idx]
+    for ( prev = NULL, rover = *chain
         ; rover != NULL && rover != s
         ; prev = rover, rover = rover->next
         )
@@ -332,8 +587,8 @@ move_to_head (string_t *s, int idx)
     if (rover && prev)
     {
         prev->next = rover->next;
-        rover->next = stringtable[idx];
-        stringtable[idx] = rover;
+        rover->next = *chain;
+        *chain = rover;
     }
 
     if (rover)
@@ -356,12 +611,11 @@ make_new_tabled (const char * const pTxt, size_t size, hash32_t hash MTRACE_DECL
 
 {
     string_t * string;
-    hash32_t   idx = HashToIndex(hash);
+    string_t ** chain;
 
     /* Get the memory for a new one */
 
-    string = xalloc_pass(size + sizeof(*string));
-      /* sizeof(*string) includes the extra data byte */
+    string = xalloc_pass(size + MSTR_HEADER_SIZE);
     if (!string)
         return NULL;
 
@@ -377,14 +631,16 @@ make_new_tabled (const char * const pTxt, size_t size, hash32_t hash MTRACE_DECL
        * the bitfield is initialized in parts.
        */
 
+    chain = find_chain(hash);
+
     mstr_added++;
-    if (NULL == stringtable[idx])
+    if (NULL == *chain)
         mstr_chains++;
     else
         mstr_collisions++;
 
-    string->next = stringtable[idx];
-    stringtable[idx] = string;
+    string->next = *chain;
+    *chain = string;
 
     {
         size_t msize;
@@ -396,18 +652,20 @@ make_new_tabled (const char * const pTxt, size_t size, hash32_t hash MTRACE_DECL
         mstr_tabled_size += msize;
     }
 
+    string_added();
+
     return string;
 } /* make_new_tabled() */
 
 /*-------------------------------------------------------------------------*/
-string_t *
-mstring_alloc_string (size_t iSize MTRACE_DECL)
+static INLINE string_t *
+alloc_untabled (size_t iSize, size_t iRoom MTRACE_DECL)
 
-/* Aliased to: alloc_mstring(iSize)
- * Also called by mstring_new_string().
+/* Helper function for mstring_alloc_string() and mstring_extend().
  *
- * Create a new untabled string with space for <iSize> characters and
- * return it, counting the result as one reference.
+ * Create a new untabled string of <iSize> characters in a memory block
+ * with space for <iRoom> >= <iSize> characters, and return it counting
+ * the result as one reference.
  *
  * If memory runs out, NULL is returned.
  */
@@ -417,7 +675,7 @@ mstring_alloc_string (size_t iSize MTRACE_DECL)
 
     /* Get the memory */
 
-    string = xalloc_pass(iSize + sizeof(*string));
+    string = xalloc_pass(iRoom + MSTR_HEADER_SIZE);
     if (!string)
         return NULL;
 
@@ -443,6 +701,23 @@ mstring_alloc_string (size_t iSize MTRACE_DECL)
     }
 
     return string;
+} /* alloc_untabled() */
+
+/*-------------------------------------------------------------------------*/
+string_t *
+mstring_alloc_string (size_t iSize MTRACE_DECL)
+
+/* Aliased to: alloc_mstring(iSize)
+ * Also called by mstring_new_string().
+ *
+ * Create a new untabled string with space for <iSize> characters and
+ * return it, counting the result as one reference.
+ *
+ * If memory runs out, NULL is returned.
+ */
+
+{
+    return alloc_untabled(iSize, iSize MTRACE_PASS);
 } /* mstring_alloc_string() */
 
 /*-------------------------------------------------------------------------*/
@@ -576,7 +851,6 @@ table_string (string_t * pStr MTRACE_DECL)
 {
     string_t *string;
     hash32_t   hash;
-    hash32_t   idx;
     size_t     size;
     size_t     msize;
 
@@ -590,7 +864,6 @@ table_string (string_t * pStr MTRACE_DECL)
 
     size = pStr->size;
     hash = get_hash(pStr);
-    idx = HashToIndex(hash);
 
     /* Check if the string has already been tabled */
     string = find_and_move(pStr->txt, size, hash);
@@ -599,16 +872,18 @@ table_string (string_t * pStr MTRACE_DECL)
     {
         /* No: add the string into the table.
          */
+        string_t **chain = find_chain(hash);
+
         pStr->info.tabled = MY_TRUE;
 
         mstr_added++;
-        if (NULL == stringtable[idx])
+        if (NULL == *chain)
             mstr_chains++;
         else
             mstr_collisions++;
 
-        pStr->next = stringtable[idx];
-        stringtable[idx] = pStr;
+        pStr->next = *chain;
+        *chain = pStr;
 
         mstr_tabled_count++;
         mstr_tabled_size += msize;
@@ -617,6 +892,7 @@ table_string (string_t * pStr MTRACE_DECL)
         mstr_untabled_size -= msize;
 
         string = pStr;
+        string_added();
     }
 
     /* That's all */
@@ -858,22 +1134,22 @@ mstring_free (string_t *s)
     {
         /* A tabled string */
 
-        hash32_t idx;
+        string_t **chain;
 
         mstr_tabled_count--;
         mstr_tabled_size -= msize;
 
-        idx = HashToIndex(get_hash(s));
-        if (NULL == move_to_head(s, idx))
+        chain = find_chain(get_hash(s));
+        if (NULL == move_to_head(s, chain))
         {
             fatal("String %p (%s) doesn't hash to the same spot.\n"
                  , s, s->txt
                  );
         }
 
-        stringtable[idx] = s->next;
+        *chain = s->next;
 
-        if (NULL == stringtable[idx])
+        if (NULL == *chain)
             mstr_chains--;
         mstr_deleted++;
 
@@ -1404,6 +1680,67 @@ mstring_append_txt (string_t *left, const char *right, size_t len MTRACE_DECL)
     return tmp;
 } /* mstring_append_txt() */
 
+/*-------------------------------------------------------------------------*/
+string_t *
+mstring_extend (string_t *left, const char *right, size_t len MTRACE_DECL)
+
+/* Aliased to: mstr_extend(left,right,len)
+ *
+ * Append the <len> bytes of data in buffer <right> to string <left>, as
+ * done by 's += x', and return the result string. It is untabled and has
+ * one reference, the reference of <left> is passed on to it.
+ *
+ * If <left> is singular, the data is appended in place if the memory
+ * block of <left> has room for it. Otherwise the result is allocated
+ * with room for half its size again, so a string built by repeated
+ * appends is copied just O(log n) times instead of on every append.
+ * A string which is not singular is copied to an exact fit first.
+ *
+ * If memory runs out, NULL is returned and <left> is not changed.
+ */
+
+{
+    size_t lleft, lnew, room;
+    string_t *tmp;
+
+    lleft = mstrsize(left);
+    lnew = lleft + len;
+
+    if (!mstr_singular(left))
+    {
+        mstr_appends_copied++;
+        tmp = mstring_add_txt(left, right, len MTRACE_PASS);
+        if (tmp)
+            free_mstring(left);
+        return tmp;
+    }
+
+    if (xalloc_usable_size(left) >= lnew + MSTR_HEADER_SIZE)
+    {
+        memcpy(left->txt + lleft, right, len);
+        left->txt[lnew] = '\0';
+        left->size = lnew;
+        left->hash = 0;
+        mstr_used_size += len;
+        mstr_untabled_size += len;
+        mstr_appends_in_place++;
+        return left;
+    }
+
+    mstr_appends_copied++;
+    room = lnew + lnew / 2;
+    if (room < lnew)
+        room = lnew;
+    tmp = alloc_untabled(lnew, room MTRACE_PASS);
+    if (tmp)
+    {
+        memcpy(tmp->txt, left->txt, lleft);
+        memcpy(tmp->txt + lleft, right, len);
+        free_mstring(left);
+    }
+    return tmp;
+} /* mstring_extend() */
+
 /*-------------------------------------------------------------------------*/
 string_t *
 mstring_repeat (const string_t *base, size_t num MTRACE_DECL)
@@ -1563,15 +1900,20 @@ mstring_init (void)
  */
 
 {
-    int x;
+    hash32_t x;
+
+    /* Round the configured size up to the next power of 2 */
+    for (stringtable_size = 1; stringtable_size < HTABLE_SIZE; )
+        stringtable_size <<= 1;
+    min_stringtable_size = stringtable_size;
 
-    stringtable = xalloc(sizeof(*stringtable) * HTABLE_SIZE);
+    stringtable = xalloc(sizeof(*stringtable) * stringtable_size);
 
     if (!stringtable)
         fatal("(mstring_init) Out of memory (%lu bytes) for string table\n"
-             , (unsigned long) sizeof(*stringtable)*HTABLE_SIZE);
+             , (unsigned long) sizeof(*stringtable)*stringtable_size);
 
-    for (x = 0; x < HTABLE_SIZE; x++)
+    for (x = 0; x < stringtable_size; x++)
         stringtable[x] = NULL;
 
     init_standard_strings();
@@ -1588,9 +1930,9 @@ mstring_clear_refs (void)
  */
 
 {
-    int x;
+    hash32_t x;
 
-    for (x = 0; x < HTABLE_SIZE; x++)
+    for (x = 0; x < stringtable_size; x++)
     {
         string_t *p;
         for (p = stringtable[x]; p; p = p->next )
@@ -1599,6 +1941,15 @@ mstring_clear_refs (void)
         }
     }
 
+    for (x = rehash_index; x < old_stringtable_size; x++)
+    {
+        string_t *p;
+        for (p = old_stringtable[x]; p; p = p->next )
+        {
+            p->info.ref = 0;
+        }
+    }
+
 } /* mstring_clear_refs() */
 
 /*-------------------------------------------------------------------------*/
@@ -1612,6 +1963,8 @@ mstring_note_refs (void)
     int x;
 
     note_malloced_block_ref(stringtable);
+    if (old_stringtable != NULL)
+        note_malloced_block_ref(old_stringtable);
 
     for (x = 0; x < SHSTR_NOSTRINGS; x++)
     {
@@ -1630,9 +1983,9 @@ mstring_walk_table (void (*func) (string_t *))
  */
 
 {
-    int x;
+    hash32_t x;
 
-    for (x = 0; x < HTABLE_SIZE; x++)
+    for (x = 0; x < stringtable_size; x++)
     {
         string_t * p;
         for (p = stringtable[x]; NULL != p; p = p->next)
@@ -1640,60 +1993,89 @@ mstring_walk_table (void (*func) (string_t *))
             (*func)(p);
         }
     }
+
+    for (x = rehash_index; x < old_stringtable_size; x++)
+    {
+        string_t * p;
+        for (p = old_stringtable[x]; NULL != p; p = p->next)
+        {
+            (*func)(p);
+        }
+    }
 } /* mstring_walk_table() */
 
 /*-------------------------------------------------------------------------*/
-void
-mstring_gc_table (void)
+static void
+gc_chain (string_t ** chain)
 
-/* GC support: Remove all strings from the table which have a refcount
- * of 0.
- *
- * This can only happen in the last stage of a GC.
+/* GC support: Remove all strings from the string table <chain> which have
+ * a refcount of 0.
  */
 
 {
-    int x;
+    string_t * prev, * next;
+
+    if (*chain == NULL)
+        return;
 
-    for (x = 0; x < HTABLE_SIZE; x++)
+    for (prev = NULL, next = *chain; next != NULL; )
     {
-        string_t * prev, * next;
-        for (prev = NULL, next = stringtable[x]; next != NULL; )
+        if (next->info.ref == 0)
         {
-            if (next->info.ref == 0)
+            string_t * this = next;
+
+            /* Unlink the string from the table, then free it. */
+            if (prev == NULL)
             {
-                string_t * this = next;
-
-                /* Unlink the string from the table, then free it. */
-                if (prev == NULL)
-                {
-                    stringtable[x] = this->next;
-                    next = this->next;
-                }
-                else
-                {
-                    prev->next = this->next;
-                    next = this->next;
-                }
-
-                mstr_untabled_count++;
-                mstr_untabled_size += mstr_mem_size(this);
-                mstr_tabled_count--;
-                mstr_tabled_size += mstr_mem_size(this);
-                mstr_deleted++;
-
-                this->info.ref = 1;
-                this->info.tabled = MY_FALSE;
-                free_mstring(this);
+                *chain = this->next;
+                next = this->next;
             }
             else
             {
-                /* Step to next string */
-                prev = next;
-                next = next->next;
+                prev->next = this->next;
+                next = this->next;
             }
+
+            mstr_untabled_count++;
+            mstr_untabled_size += mstr_mem_size(this);
+            mstr_tabled_count--;
+            mstr_tabled_size += mstr_mem_size(this);
+            mstr_deleted++;
+
+            this->info.ref = 1;
+            this->info.tabled = MY_FALSE;
+            free_mstring(this);
         }
-    } /* for (x) */
+        else
+        {
+            /* Step to next string */
+            prev = next;
+            next = next->next;
+        }
+    }
+
+    if (*chain == NULL)
+        mstr_chains--;
+} /* gc_chain() */
+
+/*-------------------------------------------------------------------------*/
+void
+mstring_gc_table (void)
+
+/* GC support: Remove all strings from the table which have a refcount
+ * of 0.
+ *
+ * This can only happen in the last stage of a GC.
+ */
+
+{
+    hash32_t x;
+
+    for (x = 0; x < stringtable_size; x++)
+        gc_chain(&stringtable[x]);
+
+    for (x = rehash_index; x < old_stringtable_size; x++)
+        gc_chain(&old_stringtable[x]);
 } /* mstring_gc_table() */
 
 #endif /* GC_SUPPORT */
@@ -1707,14 +2089,15 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
  */
 
 {
-#   define STR_OVERHEAD (sizeof(string_t)+1)
+#   define STR_OVERHEAD MSTR_HEADER_SIZE
 
-    statcounter_t stringtable_size;
+    statcounter_t table_size;
     statcounter_t distinct_strings;
     statcounter_t distinct_size;
     statcounter_t distinct_overhead;
 
-    stringtable_size = HTABLE_SIZE * sizeof(string_t *);
+    table_size = ((statcounter_t)stringtable_size + old_stringtable_size)
+                     * sizeof(string_t *);
     distinct_strings = mstr_tabled_count + mstr_untabled_count;
     distinct_size = mstr_tabled_size + mstr_untabled_size;
     distinct_overhead = mstr_tabled_count * STR_OVERHEAD
@@ -1725,9 +2108,9 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
         strbuf_addf(sbuf
                    , "Strings alloced\t\t\t%8"PRIuSTATCOUNTER" %9"PRIuSTATCOUNTER
                      " (%"PRIuSTATCOUNTER" + %"PRIuSTATCOUNTER" overhead)\n"
-                   , distinct_strings, distinct_size + stringtable_size
+                   , distinct_strings, distinct_size + table_size
                    , distinct_size - distinct_overhead
-                   , distinct_overhead + stringtable_size
+                   , distinct_overhead + table_size
                    );
     }
     else
@@ -1746,17 +2129,17 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
         strbuf_addf(sbuf,  "Total allocated\t%9"PRIuSTATCOUNTER" %9"PRIuSTATCOUNTER
                            " (%9"PRIuSTATCOUNTER"+%9"PRIuSTATCOUNTER")\n"
                         , distinct_strings
-                        , distinct_size + stringtable_size
+                        , distinct_size + table_size
                         , distinct_size - distinct_overhead
-                        , distinct_overhead + stringtable_size
+                        , distinct_overhead + table_size
                         );
         strbuf_addf(sbuf,  " - tabled\t%9"PRIuMPINT" %9"PRIuSTATCOUNTER" (%9"PRIuMPINT"+%9"PRIuSTATCOUNTER")\n"
                         , mstr_tabled_count
-                        , mstr_tabled_size + stringtable_size
+                        , mstr_tabled_size + table_size
                         , mstr_tabled_size
                           ? mstr_tabled_size - mstr_tabled_count * STR_OVERHEAD
                           : 0
-                        , mstr_tabled_count * STR_OVERHEAD + stringtable_size
+                        , mstr_tabled_count * STR_OVERHEAD + table_size
                         );
         strbuf_addf(sbuf,  " - untabled\t%9"PRIuMPINT" %9"PRIuMPINT" (%9"PRIuMPINT"+%9"PRIuMPINT")\n"
                         , mstr_untabled_count
@@ -1768,9 +2151,9 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
                         );
         strbuf_addf(sbuf, "\nSpace required vs. 'regular C' string implementation: "
                           "%"PRIuSTATCOUNTER"%% with, %"PRIuSTATCOUNTER"%% without overhead.\n"
-                        , ((distinct_size + stringtable_size) * 100L)
-                          / (mstr_used_size - mstr_used * sizeof(string_t))
-                        , ((distinct_size + stringtable_size
+                        , ((distinct_size + table_size) * 100L)
+                          / (mstr_used_size - mstr_used * (STR_OVERHEAD-1))
+                        , ((distinct_size + table_size
                                           - distinct_overhead) * 100L)
                           / (mstr_used_size - mstr_used * STR_OVERHEAD)
                         );
@@ -1785,9 +2168,22 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
                         , (float)mstr_searchlen_byvalue / (float)mstr_searches_byvalue
                         );
         strbuf_addf(sbuf, "Hash chains used: %"PRIuMPINT" of %lu (%.1f%%)\n"
-                        , mstr_chains, (unsigned long)HTABLE_SIZE
-                        , 100.0 * (float)mstr_chains / (float)HTABLE_SIZE
+                        , mstr_chains
+                        , (unsigned long)stringtable_size + old_stringtable_size
+                        , 100.0 * (float)mstr_chains
+                                / (float)(stringtable_size + old_stringtable_size - rehash_index)
                         );
+        strbuf_addf(sbuf, "Table resizes: %"PRIuSTATCOUNTER
+                          " - longest chain: %"PRIuMPINT
+                          " (%"PRIuMPINT" before last resize)\n"
+                        , mstr_resizes, longest_chain()
+                        , mstr_max_chain_before_resize
+                        );
+        if (old_stringtable != NULL)
+            strbuf_addf(sbuf, "Resize in progress: %lu of %lu chains migrated\n"
+                            , (unsigned long)rehash_index
+                            , (unsigned long)old_stringtable_size
+                            );
         strbuf_addf(sbuf, "Distinct strings added: %"PRIuSTATCOUNTER" "
                           "- deleted: %"PRIuSTATCOUNTER"\n"
                         , mstr_added, mstr_deleted
@@ -1819,7 +2215,7 @@ add_string_status (strbuf_t *sbuf, Bool verbose)
 #endif /* EXT_STRING_STATS */
     }
 
-    return stringtable_size + distinct_size;
+    return table_size + distinct_size;
 #   undef STR_OVERHEAD
 } /* add_string_status() */
 
@@ -1870,6 +2266,30 @@ string_driver_info (svalue_t *svp, int value)
             put_number(svp, mstr_collisions);
             break;
 
+        case DI_NUM_STRING_TABLE_RESIZES:
+            put_number(svp, mstr_resizes);
+            break;
+
+        case DI_NUM_STRING_APPENDS_IN_PLACE:
+            put_number(svp, mstr_appends_in_place);
+            break;
+
+        case DI_NUM_STRING_APPENDS_COPIED:
+            put_number(svp, mstr_appends_copied);
+            break;
+
+        case DI_NUM_STRING_TABLE_LONGEST_CHAIN:
+            put_number(svp, longest_chain());
+            break;
+
+        case DI_NUM_STRING_TABLE_LONGEST_CHAIN_BEFORE_RESIZE:
+            put_number(svp, mstr_max_chain_before_resize);
+            break;
+
+        case DI_NUM_STRING_TABLE_CHAINS_TO_REHASH:
+            put_number(svp, old_stringtable_size - rehash_index);
+            break;
+
 
         case DI_NUM_VIRTUAL_STRINGS:
             put_number(svp, mstr_used);
@@ -1888,7 +2308,7 @@ string_driver_info (svalue_t *svp, int value)
             break;
 
         case DI_NUM_STRING_TABLE_SLOTS:
-            put_number(svp, HTABLE_SIZE);
+            put_number(svp, stringtable_size);
             break;
 
         case DI_NUM_STRING_TABLE_SLOTS_USED:
@@ -1909,11 +2329,12 @@ string_driver_info (svalue_t *svp, int value)
             break;
 
         case DI_SIZE_STRING_TABLE:
-            put_number(svp, HTABLE_SIZE * sizeof(string_t *));
+            put_number(svp, ((mp_int)stringtable_size + old_stringtable_size)
+                            * sizeof(string_t *));
             break;
 
         case DI_SIZE_STRING_OVERHEAD:
-            put_number(svp, sizeof(string_t)-1);
+            put_number(svp, MSTR_HEADER_SIZE-1);
             break;
 
 
@@ -4,6 +4,8 @@
 #include "driver.h"
 #include "typedefs.h"
 
+#include <stddef.h>  /* offsetof() for MSTR_HEADER_SIZE */
+
 #include "hash.h"
 
 /* --- Types --- */
@@ -45,13 +47,21 @@ struct string_s
         Bool tabled      :  1;
         unsigned int ref : 31;
     } info;
+    hash32_t   hash;    /* 0, or the hash of the string */
     string_t * next;    /* Linkpointer in string table. */
     size_t     size;    /* Length of the string */
-    hash32_t   hash;    /* 0, or the hash of the string */
     char       txt[1];  /* In fact .size characters plus one '\0' */
       /* The string text follows here */
 };
 
+#define MSTR_HEADER_SIZE (offsetof(string_t, txt) + 1)
+  /* The memory a string needs in addition to its characters: the header
+   * and the terminating '\0'. The fields are ordered so that the text
+   * starts right after them, so this is less than sizeof(string_t), which
+   * includes the padding after .txt - on 64-bit hosts a string with up
+   * to 7 characters fits into 32 bytes instead of 40.
+   */
+
 /* --- Constants --- */
 
 #define MSTRING_HASH_LENGTH (256)
@@ -65,6 +75,7 @@ extern mp_uint mstr_used_size;
 /* --- Prototypes --- */
 
 extern void mstring_init (void);
+extern void mstring_rehash_step (void);
 extern hash32_t   mstring_get_hash (string_t * pStr);
 extern hash32_t   hash_string (const char * const s, size_t size);
 extern hash32_t   hash_string_chained (const char * const s, size_t size, hash32_t chainhash);
@@ -97,6 +108,7 @@ extern string_t * mstring_add_txt (const string_t *left, const char *right, size
 extern string_t * mstring_add_to_txt (const char *left, size_t len, const string_t *right MTRACE_DECL);
 extern string_t * mstring_append (string_t *left, const string_t *right MTRACE_DECL);
 extern string_t * mstring_append_txt (string_t *left, const char *right, size_t len MTRACE_DECL);
+extern string_t * mstring_extend (string_t *left, const char *right, size_t len MTRACE_DECL);
 extern string_t * mstring_repeat(const string_t *base, size_t num MTRACE_DECL);
 extern string_t * mstring_extract (const string_t *str, size_t start, long end MTRACE_DECL);
 extern long       mstring_chr (const string_t *p, char c);
@@ -124,7 +136,7 @@ static INLINE size_t mstr_mem_size(const string_t * const s)
    *   Used only to keep the statistics up to date.
    */
 {
-    return sizeof(string_t) + s->size;
+    return MSTR_HEADER_SIZE + s->size;
 }
 
 static INLINE hash32_t mstr_hash(const string_t * const s)
@@ -278,6 +290,7 @@ static INLINE void extract_cstr(char *d, const string_t *const s, size_t l)
 #define mstr_add_to_txt(pTxt1,len,pStr2) mstring_add_to_txt(pTxt1, len, pStr2 MTRACE_ARG)
 #define mstr_append(pStr1,pStr2)  mstring_append(pStr1,pStr2 MTRACE_ARG)
 #define mstr_append_txt(pStr1,pTxt2,len) mstring_append_txt(pStr1,pTxt2,len MTRACE_ARG)
+#define mstr_extend(pStr1,pTxt2,len) mstring_extend(pStr1,pTxt2,len MTRACE_ARG)
 #define mstr_repeat(pStr,num)    mstring_repeat(pStr,num MTRACE_ARG)
 #define mstr_extract(pStr,start,end) mstring_extract (pStr,start,end MTRACE_ARG)
 #define add_slash(pStr)          mstring_add_slash(pStr MTRACE_ARG)
@@ -43,6 +43,7 @@
  *       int             extra_num_variables;  (ifdef DEBUG)
  *       svalue_t      * variables;
  *       unsigned long   ticks, gigaticks;
+ *       int32           queue_pos[NUM_OBJECT_QUEUES];
  *   }
  *
  * The .flags collect some vital information about the object:
@@ -77,8 +78,12 @@
  * is still in a reset state, or it is swapped out, the backend simply
  * sets a new .time_reset time, but does not do any real action.
  * To reduce the lag caused by the reset calls, all objects are kept
- * in the reset_table sorted by their time_reset. The .next_reset pointer
- * is used to built the table.
+ * in the backend's reset queue sorted by their time_reset. Whenever
+ * .time_reset is changed, update_reset_queue() must be called.
+ *
+ * .queue_pos[] are the positions of the object in the backend's queues
+ * for resets, clean_ups, data cleanups and swapping, so that the backend
+ * doesn't have to scan all objects to find those with work due.
  *
  * .load_time simply is the time when the object was created. .load_id
  * serves to determine the creation order of objects created at the
@@ -168,6 +173,7 @@
 #include "filestat.h"
 #include "interpret.h"
 #include "instrs.h"
+#include "jit.h"
 #include "lex.h"
 #include "main.h"
 #include "mapping.h"
@@ -657,6 +663,9 @@ _free_prog (program_t *progp, Bool free_all, const char * file, int line
         progp->line_numbers = NULL;
     }
 
+    /* Free the call site caches. */
+    free_call_caches(progp);
+
     /* Is it a 'real' free? Then dereference all the
      * things held by the program, too.
      */
@@ -833,8 +842,11 @@ reset_object (object_t *ob, int arg)
 {
     /* Be sure to update time first ! */
     if (time_to_reset > 0)
+    {
         ob->time_reset = current_time + time_to_reset/2
                          + (mp_int)random_number((uint32)time_to_reset/2);
+        update_reset_queue(ob);
+    }
 
     if (driver_hook[arg].type == T_CLOSURE)
     {
@@ -883,6 +895,8 @@ reset_object (object_t *ob, int arg)
             ob->time_reset = 0;
     }
 
+    update_reset_queue(ob);
+
     /* Object is reset now */
     ob->flags |= O_RESET_STATE;
 } /* reset_object() */
@@ -1424,6 +1438,9 @@ renumber_programs (void)
             renumber_program(ob->prog);
     }
     invalidate_apply_low_cache();
+#ifdef JIT_ENABLED
+    jit_flush();
+#endif
     return ++current_id_number;
 }
 
@@ -3627,6 +3644,7 @@ f_set_next_reset (svalue_t *sp)
             current_object->time_reset = 0;
         else if (new_time > 0)
             current_object->time_reset = new_time + current_time;
+        update_reset_queue(current_object);
     }
     return sp;
 } /* f_set_next_reset() */
@@ -15,6 +15,10 @@
 /* --- struct object: the base structure of every object
  */
 
+#define NUM_OBJECT_QUEUES 4
+  /* Number of the backend's object queues, see OQ_* below.
+   */
+
 struct object_s
 {
     unsigned short flags; /* Bits or'ed together, see below */
@@ -58,8 +62,21 @@ struct object_s
       /* Evalcost used by this object. The total cost
        * is computed with gigaticks*1E9+ticks.
        */
+    int32 queue_pos[NUM_OBJECT_QUEUES];
+      /* Positions+1 of this object in the backend's object queues,
+       * 0 if the object is not in that queue.
+       */
 };
 
+/* Indices of the backend's object queues (see backend.c), in which the
+ * objects wait for their next reset, clean_up, data cleanup or swap.
+ */
+
+#define OQ_RESET          0
+#define OQ_CLEAN_UP       1
+#define OQ_DATA_CLEAN     2
+#define OQ_SWAP           3
+
 
 /* Values of object_t.flags: */
 
@@ -14,15 +14,21 @@
  *   is found in the index chain, it is moved to the head of the chain
  *   to speed up further lookups.
  *
- *   The size of the hash table is given by OTABLE_SIZE in config.h. It does
- *   not need to be prime, and should probably be set to 1/4 of the number
- *   of objects in the game.
+ *   The initial size of the hash table is given by OTABLE_SIZE in config.h,
+ *   rounded up to the next power of two. The table doubles when it holds
+ *   more than OTABLE_MAX_LOAD objects per chain and shrinks again (not
+ *   below the initial size) when it becomes sparse. The hash values of
+ *   the object names are cached in the name strings, so no rehashing of
+ *   the names is necessary.
  *
- *   The table links are not counted in the object's refcount.
+ *   A resize allocates the new table and migrates the chains of the old
+ *   table bit by bit: a few with every object entered, and a larger batch
+ *   with every backend cycle (otable_rehash_step()). During the transition
+ *   both tables are in use: chains of the old table with an index
+ *   >= otable_rehash_index haven't been migrated yet and are still
+ *   authoritative, all other objects are found in the new table.
  *
- *   TODO: Maybe make the object table size dynamic (start with 128 and double
- *   TODO:: as required). This also requires to store the hashvalue in
- *   TODO:: the object.
+ *   The table links are not counted in the object's refcount.
  *---------------------------------------------------------------------------
  */
 
@@ -49,24 +55,28 @@
 /*                           OBJECT TABLE                                  */
 /*-------------------------------------------------------------------------*/
 
-/* Hash the string <s> and compute the appropriate table index
- */
-static INLINE hash32_t ObjHash(string_t * const s)
-{
-#if !( (OTABLE_SIZE) & (OTABLE_SIZE)-1 )
-    return mstr_get_hash(s) & ((OTABLE_SIZE)-1);
-#else
-    return mstr_get_hash(s) % (OTABLE_SIZE);
-#endif
-}
-static INLINE hash32_t ObjHashStr(char const * const s, size_t len)
-{
-#if !( (OTABLE_SIZE) & (OTABLE_SIZE)-1 )
-    return hash_string(s, len) & ((OTABLE_SIZE)-1);
-#else
-    return hash_string(s, len) % (OTABLE_SIZE);
-#endif
-}
+#define OTABLE_MAX_SIZE ((hash32_t)1 << 30)
+  /* The object table doesn't grow beyond this number of chains.
+   */
+
+#define OTABLE_MAX_LOAD 2
+  /* The table is doubled when there are more objects than
+   * OTABLE_MAX_LOAD times the number of chains.
+   */
+
+#define OTABLE_MIN_LOAD_INV 8
+  /* The table is shrunk when there are less objects than
+   * the number of chains / OTABLE_MIN_LOAD_INV.
+   */
+
+#define OTABLE_REHASH_PER_ENTER 2
+  /* Number of old chains migrated with every object entered during
+   * a resize.
+   */
+
+#define OTABLE_REHASH_PER_STEP 16384
+  /* Number of old chains migrated by every call to otable_rehash_step().
+   */
 
 static object_t ** obj_table = NULL;
   /* Pointer to the (allocated) hashtable.
@@ -76,6 +86,31 @@ static long objs_in_table = 0;
   /* Number of objects in the table.
    */
 
+static hash32_t otable_size = 0;
+  /* Number of chains in obj_table[], a power of 2.
+   */
+
+static hash32_t min_otable_size = 0;
+  /* The initial size of obj_table[], it won't shrink below this.
+   */
+
+static object_t ** old_obj_table = NULL;
+  /* During a resize: the previous hashtable, NULL otherwise.
+   */
+
+static hash32_t old_otable_size = 0;
+  /* Number of chains in old_obj_table[].
+   */
+
+static hash32_t otable_rehash_index = 0;
+  /* During a resize: the next chain of old_obj_table[] to migrate.
+   * All chains below it are empty.
+   */
+
+static statcounter_t otable_resizes = 0;
+  /* Number of resizes of the table.
+   */
+
 static statcounter_t obj_searches = 0;
 static statcounter_t obj_probes = 0;
 static statcounter_t objs_found = 0;
@@ -88,6 +123,119 @@ static statcounter_t user_obj_found = 0;
   /* Number of externally requested lookups, and how many succeeded.
    */
 
+/*-------------------------------------------------------------------------*/
+static INLINE object_t **
+obj_chain (hash32_t hash)
+
+/* Return the head of the chain which holds (or would hold) the objects
+ * whose names hash to <hash>: during a resize the chain of the old table
+ * if that one hasn't been migrated yet, otherwise the one of the new table.
+ */
+
+{
+    if (old_obj_table != NULL)
+    {
+        hash32_t h = hash & (old_otable_size - 1);
+
+        if (h >= otable_rehash_index)
+            return &old_obj_table[h];
+    }
+
+    return &obj_table[hash & (otable_size - 1)];
+} /* obj_chain() */
+
+/*-------------------------------------------------------------------------*/
+static void
+rehash_obj_chains (hash32_t num)
+
+/* During a resize: migrate the next <num> chains of the old table into
+ * the new one. When all chains are migrated, the old table is freed.
+ */
+
+{
+    for ( ; num > 0 && otable_rehash_index < old_otable_size; num--)
+    {
+        object_t *ob = old_obj_table[otable_rehash_index];
+
+        old_obj_table[otable_rehash_index++] = NULL;
+        while (ob != NULL)
+        {
+            object_t *next = ob->next_hash;
+            object_t **chain = &obj_table[mstr_get_hash(ob->name) & (otable_size - 1)];
+
+            ob->next_hash = *chain;
+            *chain = ob;
+            ob = next;
+        }
+    }
+
+    if (otable_rehash_index >= old_otable_size)
+    {
+        xfree(old_obj_table);
+        old_obj_table = NULL;
+        old_otable_size = 0;
+        otable_rehash_index = 0;
+    }
+} /* rehash_obj_chains() */
+
+/*-------------------------------------------------------------------------*/
+static void
+resize_otable (hash32_t new_size)
+
+/* Start resizing the table to <new_size> chains, finishing a resize still
+ * in progress first. If the memory for the new table can't be allocated,
+ * the old one stays in use.
+ */
+
+{
+    object_t **new_table;
+    hash32_t x;
+
+    if (old_obj_table != NULL)
+        rehash_obj_chains(old_otable_size);
+
+    new_table = xalloc(sizeof(object_t *) * new_size);
+    if (!new_table)
+        return;
+
+    for (x = 0; x < new_size; x++)
+        new_table[x] = NULL;
+
+    otable_resizes++;
+
+    old_obj_table = obj_table;
+    old_otable_size = otable_size;
+    otable_rehash_index = 0;
+
+    obj_table = new_table;
+    otable_size = new_size;
+} /* resize_otable() */
+
+/*-------------------------------------------------------------------------*/
+void
+otable_rehash_step (void)
+
+/* Called from the backend loop: continue a pending resize of the table,
+ * or start to shrink it if it has become too sparse.
+ */
+
+{
+    if (old_obj_table != NULL)
+        rehash_obj_chains(OTABLE_REHASH_PER_STEP);
+    else if (otable_size > min_otable_size
+          && (hash32_t)objs_in_table < otable_size / OTABLE_MIN_LOAD_INV)
+    {
+        hash32_t new_size = otable_size / 2;
+
+        /* Shrink in one go to a load of at least 1/2 object per chain. */
+        while (new_size > min_otable_size
+            && (hash32_t)objs_in_table < new_size / 2)
+            new_size /= 2;
+
+        resize_otable(new_size);
+    }
+} /* otable_rehash_step() */
+
 /*-------------------------------------------------------------------------*/
 static object_t *
 find_obj_n (string_t *s)
@@ -102,9 +250,9 @@ find_obj_n (string_t *s)
 {
     object_t * curr, *prev;
 
-    int h = ObjHash(s);
+    object_t ** chain = obj_chain(mstr_get_hash(s));
 
-    curr = obj_table[h];
+    curr = *chain;
     prev = NULL;
 
     obj_searches++;
@@ -117,8 +265,8 @@ find_obj_n (string_t *s)
             if (prev) /* not at head of list */
             {
                 prev->next_hash = curr->next_hash;
-                curr->next_hash = obj_table[h];
-                obj_table[h] = curr;
+                curr->next_hash = *chain;
+                *chain = curr;
             }
             objs_found++;
             return curr;
@@ -146,9 +294,9 @@ find_obj_n_str (char const * const s)
 {
     object_t * curr, *prev;
 
-    int h = ObjHashStr(s,strlen(s));
+    object_t ** chain = obj_chain(hash_string(s, strlen(s)));
 
-    curr = obj_table[h];
+    curr = *chain;
     prev = NULL;
 
     obj_searches++;
@@ -161,8 +309,8 @@ find_obj_n_str (char const * const s)
             if (prev) /* not at head of list */
             {
                 prev->next_hash = curr->next_hash;
-                curr->next_hash = obj_table[h];
-                obj_table[h] = curr;
+                curr->next_hash = *chain;
+                *chain = curr;
             }
             objs_found++;
             return curr;
@@ -188,7 +336,7 @@ enter_object_hash (object_t *ob)
 #ifdef DEBUG
     object_t * s;
 #endif
-    int h = ObjHash(ob->name);
+    object_t ** chain;
 
 #ifdef DEBUG
     s = find_obj_n(ob->name);
@@ -206,9 +354,17 @@ enter_object_hash (object_t *ob)
              , get_txt(ob->name));
 #endif
 
-    ob->next_hash = obj_table[h];
-    obj_table[h] = ob;
+    chain = obj_chain(mstr_get_hash(ob->name));
+    ob->next_hash = *chain;
+    *chain = ob;
     objs_in_table++;
+
+    /* Continue a pending resize, or start one if the table got crowded. */
+    if (old_obj_table != NULL)
+        rehash_obj_chains(OTABLE_REHASH_PER_ENTER);
+    else if ((hash32_t)objs_in_table > otable_size * OTABLE_MAX_LOAD
+          && otable_size < OTABLE_MAX_SIZE)
+        resize_otable(otable_size * 2);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -220,7 +376,7 @@ remove_object_hash (object_t *ob)
 
 {
     object_t * s;
-    int h = ObjHash(ob->name);
+    object_t ** chain = obj_chain(mstr_get_hash(ob->name));
 
     s = find_obj_n(ob->name);
 
@@ -228,7 +384,7 @@ remove_object_hash (object_t *ob)
         fatal( "Remove object \"%s\": found a different object!"
              , get_txt(ob->name));
 
-    obj_table[h] = ob->next_hash;
+    *chain = ob->next_hash;
     ob->next_hash = NULL;
     objs_in_table--;
 }
@@ -283,7 +439,11 @@ show_otable_status (strbuf_t * sbuf, Bool verbose)
         strbuf_add(sbuf, "------------------------------\n");
         strbuf_addf(sbuf
                    , "Average hash chain length                   %.2f\n"
-                   , (float) objs_in_table / (float) OTABLE_SIZE);
+                   , (float) objs_in_table
+                     / (float) (otable_size + old_otable_size - otable_rehash_index));
+        strbuf_addf(sbuf
+                   , "Table size/resizes                   %lu (%"PRIuSTATCOUNTER")\n"
+                   , (unsigned long) otable_size, otable_resizes);
         strbuf_addf(sbuf
                    , "Searches/average search length       %"PRIuSTATCOUNTER" (%.2f)\n"
                    , obj_searches
@@ -297,8 +457,8 @@ show_otable_status (strbuf_t * sbuf, Bool verbose)
     /* objs_in_table * sizeof(object_t) is already accounted for
        in tot_alloc_object_size.  */
     strbuf_addf(sbuf, "hash table overhead\t\t\t %9ld\n",
-                (long)(OTABLE_SIZE * sizeof(object_t *)));
-    return OTABLE_SIZE * sizeof(object_t *);
+                (long)((otable_size + old_otable_size) * sizeof(object_t *)));
+    return (otable_size + old_otable_size) * sizeof(object_t *);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -317,11 +477,12 @@ otable_driver_info (svalue_t *svp, int value)
             break;
 
         case DI_NUM_OBJECT_TABLE_SLOTS:
-            put_number(svp, OTABLE_SIZE);
+            put_number(svp, otable_size);
             break;
 
         case DI_SIZE_OBJECT_TABLE:
-            put_number(svp, OTABLE_SIZE * sizeof(object_t *));
+            put_number(svp, ((mp_int)otable_size + old_otable_size)
+                            * sizeof(object_t *));
             break;
 
 
@@ -343,10 +504,15 @@ init_otable (void)
  */
 
 {
-    int x;
-    obj_table = xalloc(sizeof(object_t *) * OTABLE_SIZE);
+    hash32_t x;
+
+    for (otable_size = 1; otable_size < OTABLE_SIZE; )
+        otable_size <<= 1;
+    min_otable_size = otable_size;
+
+    obj_table = xalloc(sizeof(object_t *) * otable_size);
 
-    for (x = 0; x < OTABLE_SIZE; x++)
+    for (x = 0; x < otable_size; x++)
         obj_table[x] = NULL;
 }
 
@@ -360,6 +526,8 @@ note_otable_ref (void)
 
 {
     note_malloced_block_ref((char *)obj_table);
+    if (old_obj_table != NULL)
+        note_malloced_block_ref((char *)old_obj_table);
 }
 
 #endif /* GC_SUPPORT */
@@ -6,6 +6,7 @@
 #include "strfuns.h"
 
 extern void init_otable(void);
+extern void otable_rehash_step(void);
 extern size_t show_otable_status(strbuf_t *sbuf, Bool verbose);
 extern void otable_driver_info(svalue_t *svp, int value) __attribute__((nonnull(1)));
 
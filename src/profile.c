@@ -0,0 +1,685 @@
+/*---------------------------------------------------------------------------
+ * Sampling profiler for LPC code.
+ *
+ *---------------------------------------------------------------------------
+ * When configure_driver(DC_PROFILE_INTERVAL) sets a sampling interval,
+ * the ITIMER_PROF timer sends a SIGPROF signal every time the driver
+ * used that much CPU time (see set_profile_interval() in interpret.c).
+ * The interpreter notices the signal at the end of the current
+ * instruction and records its control stack here,
+ * as a list of frames (program, function and line), weighted with the
+ * number of signals received since the last sample. Signals received
+ * outside of an evaluation are recorded as an empty stack.
+ *
+ * The profile keeps every distinct frame and every distinct stack only
+ * once, in two hash tables:
+ *
+ *   frames[]:       the frames, with counted references to their strings.
+ *   stacks[]:       the stacks with their number of samples. The frames
+ *                   of a stack are stored as indices into frames[], in
+ *                   the slice .first .. .first+.depth-1 of stack_frames[].
+ *
+ * The chains of the hash tables are made of indices into the arrays,
+ * offset by one so that 0 can mark the end of a chain.
+ *
+ * The profile is returned by driver_info(DI_PROFILE_SAMPLES) as a
+ * mapping, or written by dump_driver_info(DDI_PROFILE) into a file, both
+ * in the 'folded stacks' format used by flame graph tools: the frames of
+ * a stack from the outermost to the innermost, separated by ';', each
+ * frame written as "<program>:<function>:<line>".
+ *
+ * Setting a new interval discards the samples collected so far, setting
+ * the interval to 0 stops the sampling but keeps the samples.
+ *
+ * The module also keeps the per-function accounting enabled with
+ * configure_driver(DC_PROFILE_FUNCTIONS). The interpreter reports the
+ * entry into every lfun and lambda closure together with the depth of its
+ * control frame, and every return. For each function the profile counts
+ * the calls, and the ticks and the wall time (in microseconds) spent in
+ * the function itself and in the function with everything it called:
+ *
+ *   functions[]:    the functions by program and name, in a hash table
+ *                   like frames[].
+ *   calls[]:        the stack of the active calls, with the ticks and the
+ *                   time at their start and the part of them spent in
+ *                   called functions.
+ *
+ * The inclusive numbers of a recursive function are only added when its
+ * outermost call returns. Calls left by an error are closed when a call
+ * or return happens at or below their depth, or at the end of the
+ * evaluation, and count until then.
+ *---------------------------------------------------------------------------
+ */
+
+#include "driver.h"
+#include "typedefs.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "profile.h"
+#include "filestat.h"
+#include "gcollect.h"
+#include "interpret.h"
+#include "mapping.h"
+#include "mstrings.h"
+#include "simulate.h"
+#include "stdstrings.h"
+#include "strfuns.h"
+#include "svalue.h"
+#include "xalloc.h"
+
+#include "../mudlib/sys/driver_info.h"
+
+/*-------------------------------------------------------------------------*/
+
+#define PROFILE_TABLE_SIZE  4096
+  /* Number of buckets in each hash table, must be a power of 2.
+   */
+
+#define PROFILE_MAX_FRAMES  65536
+  /* Max. number of distinct frames.
+   */
+
+#define PROFILE_MAX_STACKS  65536
+  /* Max. number of distinct stacks.
+   */
+
+#define PROFILE_MAX_STACK_FRAMES  (1 << 22)
+  /* Max. number of frames of all distinct stacks together.
+   */
+
+#define PROFILE_HASH(h) ((((h) >> 16) ^ (h)) & (PROFILE_TABLE_SIZE-1))
+  /* Bucket of the hash value <h> (a p_uint).
+   */
+
+/* --- struct frame_entry_s: A distinct frame
+ */
+
+typedef struct frame_entry_s
+{
+    profile_frame_t frame;  /* The frame, with counted strings */
+    int32           next;   /* Next entry in the hash chain + 1, or 0 */
+} frame_entry_t;
+
+/* --- struct stack_entry_s: A distinct stack
+ */
+
+typedef struct stack_entry_s
+{
+    int32   first;  /* Index of the first frame in stack_frames[] */
+    int32   depth;  /* Number of frames */
+    p_uint  hash;   /* The hash value of the frames */
+    p_int   count;  /* Number of samples */
+    int32   next;   /* Next entry in the hash chain + 1, or 0 */
+} stack_entry_t;
+
+/* --- struct function_entry_s: The accounting of a function
+ */
+
+typedef struct function_entry_s
+{
+    string_t *file;        /* The program name, counted */
+    string_t *name;        /* The function name, counted */
+    int32     next;        /* Next entry in the hash chain + 1, or 0 */
+    int32     active;      /* Number of active calls */
+    p_int     calls;       /* Number of calls */
+    p_int     ticks_self;  /* Ticks spent in the function itself */
+    p_int     ticks;       /* Ticks spent in and below the function */
+    p_int     time_self;   /* Time spent in the function itself */
+    p_int     time;        /* Time spent in and below the function */
+} function_entry_t;
+
+/* --- struct call_entry_s: An active call of a function
+ */
+
+typedef struct call_entry_s
+{
+    int32         fun;          /* Index of the function in functions[] */
+    int           depth;        /* Depth of the control frame */
+    unsigned long start_ticks;  /* total_evalcost at the start */
+    mp_int        start_time;   /* Time of the start */
+    p_int         child_ticks;  /* Ticks spent in called functions */
+    p_int         child_time;   /* Time spent in called functions */
+} call_entry_t;
+
+/*-------------------------------------------------------------------------*/
+
+statcounter_t profile_samples = 0;
+  /* Number of samples taken.
+   */
+
+statcounter_t profile_samples_lost = 0;
+  /* Number of samples that couldn't be recorded because the profile
+   * was full.
+   */
+
+static frame_entry_t *frames = NULL;
+static int32 num_frames = 0;
+static int32 size_frames = 0;
+static int32 frame_table[PROFILE_TABLE_SIZE];
+  /* The distinct frames, and their hash table.
+   */
+
+static stack_entry_t *stacks = NULL;
+static int32 num_stacks = 0;
+static int32 size_stacks = 0;
+static int32 stack_table[PROFILE_TABLE_SIZE];
+  /* The distinct stacks, and their hash table.
+   */
+
+static int32 *stack_frames = NULL;
+static int32 num_stack_frames = 0;
+static int32 size_stack_frames = 0;
+  /* The frame indices of all stacks.
+   */
+
+Bool profile_functions = MY_FALSE;
+  /* TRUE if the calls of the functions are accounted.
+   */
+
+static function_entry_t *functions = NULL;
+static int32 num_functions = 0;
+static int32 size_functions = 0;
+static int32 function_table[PROFILE_TABLE_SIZE];
+  /* The accounted functions, and their hash table.
+   */
+
+static call_entry_t *calls = NULL;
+static int32 num_calls = 0;
+static int32 size_calls = 0;
+  /* The stack of the active calls.
+   */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+grow_array (void **array, int32 *size, int32 needed, size_t elsize, int32 limit)
+
+/* Make sure that the permanent <array> of <*size> elements of <elsize>
+ * bytes each has room for <needed> elements, but no more than <limit>.
+ * Return TRUE on success, FALSE if the array can't be grown.
+ */
+
+{
+    int32 new_size;
+    void *new_array;
+
+    if (needed <= *size)
+        return MY_TRUE;
+    if (needed > limit)
+        return MY_FALSE;
+
+    new_size = *size ? *size : 1024;
+    while (new_size < needed)
+        new_size *= 2;
+    if (new_size > limit)
+        new_size = limit;
+
+    new_array = prexalloc(*array, new_size * elsize);
+    if (!new_array)
+        return MY_FALSE;
+
+    *array = new_array;
+    *size = new_size;
+    return MY_TRUE;
+} /* grow_array() */
+
+/*-------------------------------------------------------------------------*/
+static int32
+lookup_frame (profile_frame_t *frame)
+
+/* Return the index of <frame> in frames[], adding it if necessary.
+ * Return -1 if the frame table is full.
+ */
+
+{
+    p_uint hash;
+    int32 ix;
+
+    hash = (p_uint)frame->file ^ ((p_uint)frame->name << 3) ^ frame->line;
+    hash = PROFILE_HASH(hash);
+
+    for (ix = frame_table[hash]; ix; ix = frames[ix-1].next)
+    {
+        frame_entry_t *entry = frames + ix - 1;
+
+        if (entry->frame.file == frame->file
+         && entry->frame.name == frame->name
+         && entry->frame.line == frame->line)
+            return ix - 1;
+    }
+
+    if (!grow_array((void **)&frames, &size_frames, num_frames+1
+                   , sizeof(*frames), PROFILE_MAX_FRAMES))
+        return -1;
+
+    ix = num_frames++;
+    frames[ix].frame.file = ref_mstring(frame->file);
+    frames[ix].frame.name = ref_mstring(frame->name);
+    frames[ix].frame.line = frame->line;
+    frames[ix].next = frame_table[hash];
+    frame_table[hash] = ix + 1;
+
+    return ix;
+} /* lookup_frame() */
+
+/*-------------------------------------------------------------------------*/
+void
+profile_add_sample (profile_frame_t *sample, int num, mp_int weight)
+
+/* Record a sample of the control stack <sample>, <num> frames from the
+ * outermost to the innermost one. The sample is counted <weight> times.
+ */
+
+{
+    int32 *ids;
+    p_uint hash;
+    int32 ix;
+    int i;
+
+    profile_samples += weight;
+
+    /* Look up the frames and compute the hash of the stack. */
+    if (!grow_array((void **)&stack_frames, &size_stack_frames
+                   , num_stack_frames + num, sizeof(*stack_frames)
+                   , PROFILE_MAX_STACK_FRAMES))
+    {
+        profile_samples_lost += weight;
+        return;
+    }
+
+    ids = stack_frames + num_stack_frames;
+    hash = num;
+    for (i = 0; i < num; i++)
+    {
+        ids[i] = lookup_frame(sample + i);
+        if (ids[i] < 0)
+        {
+            profile_samples_lost += weight;
+            return;
+        }
+        hash = hash * 31 + ids[i];
+    }
+
+    /* Is the stack known? */
+    for (ix = stack_table[PROFILE_HASH(hash)]; ix; ix = stacks[ix-1].next)
+    {
+        stack_entry_t *entry = stacks + ix - 1;
+
+        if (entry->hash == hash && entry->depth == num
+         && !memcmp(stack_frames + entry->first, ids, num * sizeof(*ids)))
+        {
+            entry->count += weight;
+            return;
+        }
+    }
+
+    /* A new stack: keep the frame indices just stored. */
+    if (!grow_array((void **)&stacks, &size_stacks, num_stacks+1
+                   , sizeof(*stacks), PROFILE_MAX_STACKS))
+    {
+        profile_samples_lost += weight;
+        return;
+    }
+
+    ix = num_stacks++;
+    stacks[ix].first = num_stack_frames;
+    stacks[ix].depth = num;
+    stacks[ix].hash = hash;
+    stacks[ix].count = weight;
+    stacks[ix].next = stack_table[PROFILE_HASH(hash)];
+    stack_table[PROFILE_HASH(hash)] = ix + 1;
+    num_stack_frames += num;
+} /* profile_add_sample() */
+
+/*-------------------------------------------------------------------------*/
+void
+profile_clear (void)
+
+/* Discard all samples.
+ */
+
+{
+    int32 ix;
+
+    for (ix = 0; ix < num_frames; ix++)
+    {
+        free_mstring(frames[ix].frame.file);
+        free_mstring(frames[ix].frame.name);
+    }
+
+    num_frames = num_stacks = num_stack_frames = 0;
+    memset(frame_table, 0, sizeof(frame_table));
+    memset(stack_table, 0, sizeof(stack_table));
+    profile_samples = profile_samples_lost = 0;
+} /* profile_clear() */
+
+/*-------------------------------------------------------------------------*/
+static void
+add_folded_stack (strbuf_t *sbuf, stack_entry_t *stack)
+
+/* Add the frames of <stack> in the folded format to <sbuf>.
+ */
+
+{
+    int32 i;
+
+    if (!stack->depth)
+        strbuf_add(sbuf, "(driver)");
+
+    for (i = 0; i < stack->depth; i++)
+    {
+        profile_frame_t *frame = &frames[stack_frames[stack->first + i]].frame;
+
+        if (i)
+            strbuf_addc(sbuf, ';');
+        strbuf_addn(sbuf, get_txt(frame->file), mstrsize(frame->file));
+        strbuf_addc(sbuf, ':');
+        strbuf_addn(sbuf, get_txt(frame->name), mstrsize(frame->name));
+        if (frame->line)
+            strbuf_addf(sbuf, ":%d", frame->line);
+    }
+} /* add_folded_stack() */
+
+/*-------------------------------------------------------------------------*/
+void
+get_profile_samples (svalue_t *svp)
+
+/* Put a mapping of the folded stacks to their number of samples
+ * into <svp>.
+ */
+
+{
+    mapping_t *m;
+    int32 ix;
+
+    memsafe(m = allocate_mapping(num_stacks, 1), num_stacks, "profile mapping");
+    put_mapping(svp, m);
+
+    for (ix = 0; ix < num_stacks; ix++)
+    {
+        strbuf_t sbuf;
+        svalue_t key;
+        svalue_t *data;
+
+        strbuf_zero(&sbuf);
+        add_folded_stack(&sbuf, stacks + ix);
+        strbuf_store(&sbuf, &key);
+
+        /* Programs with the same name may give the same text. */
+        data = get_map_lvalue(m, &key);
+        free_svalue(&key);
+        if (!data)
+            outofmemory("profile mapping");
+        put_number(data, data->u.number + stacks[ix].count);
+    }
+} /* get_profile_samples() */
+
+/*-------------------------------------------------------------------------*/
+Bool
+profile_dump (string_t *fname)
+
+/* Write the folded stacks with their number of samples into the file
+ * <fname>, one stack per line.
+ * Return TRUE on success, FALSE if <fname> can't be written.
+ */
+
+{
+    FILE *f;
+    int32 ix;
+
+    fname = check_valid_path(fname, current_object, STR_PROFDUMP, MY_TRUE);
+    if (!fname)
+        return MY_FALSE;
+    f = fopen(get_txt(fname), "w");
+    if (!f)
+    {
+        free_mstring(fname);
+        return MY_FALSE;
+    }
+    FCOUNT_WRITE(get_txt(fname));
+    free_mstring(fname);
+
+    for (ix = 0; ix < num_stacks; ix++)
+    {
+        strbuf_t sbuf;
+
+        strbuf_zero(&sbuf);
+        add_folded_stack(&sbuf, stacks + ix);
+        fprintf(f, "%.*s %"PRIdPINT"\n", (int)sbuf.length, sbuf.buf
+               , stacks[ix].count);
+        strbuf_free(&sbuf);
+    }
+
+    fclose(f);
+    return MY_TRUE;
+} /* profile_dump() */
+
+/*-------------------------------------------------------------------------*/
+static mp_int
+profile_time (void)
+
+/* Return the current time in microseconds.
+ */
+
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL))
+        return 0;
+    return (mp_int)tv.tv_sec * 1000000 + tv.tv_usec;
+} /* profile_time() */
+
+/*-------------------------------------------------------------------------*/
+static void
+close_call (mp_int now)
+
+/* The topmost active call ends at time <now>: add its ticks and time
+ * to its function and to its caller.
+ */
+
+{
+    call_entry_t *call = calls + --num_calls;
+    function_entry_t *fun = functions + call->fun;
+    p_int ticks = (p_int)(total_evalcost - call->start_ticks);
+    p_int time = now - call->start_time;
+
+    fun->ticks_self += ticks - call->child_ticks;
+    fun->time_self += time - call->child_time;
+    if (--fun->active == 0)
+    {
+        fun->ticks += ticks;
+        fun->time += time;
+    }
+
+    if (num_calls)
+    {
+        calls[num_calls-1].child_ticks += ticks;
+        calls[num_calls-1].child_time += time;
+    }
+} /* close_call() */
+
+/*-------------------------------------------------------------------------*/
+void
+profile_functions_unwind (int depth)
+
+/* Close all active calls with a control frame deeper than <depth>. They
+ * were left by an error. A <depth> of -1 closes all calls.
+ */
+
+{
+    mp_int now;
+
+    if (!num_calls || calls[num_calls-1].depth <= depth)
+        return;
+
+    now = profile_time();
+    while (num_calls && calls[num_calls-1].depth > depth)
+        close_call(now);
+} /* profile_functions_unwind() */
+
+/*-------------------------------------------------------------------------*/
+void
+profile_function_enter (string_t *file, string_t *name, int depth)
+
+/* The function <name> of the program <file> is called with a control
+ * frame of depth <depth>.
+ */
+
+{
+    p_uint hash;
+    int32 ix;
+    call_entry_t *call;
+
+    profile_functions_unwind(depth - 1);
+
+    hash = (p_uint)file ^ ((p_uint)name << 3);
+    hash = PROFILE_HASH(hash);
+
+    for (ix = function_table[hash]; ix; ix = functions[ix-1].next)
+    {
+        if (functions[ix-1].file == file && functions[ix-1].name == name)
+            break;
+    }
+
+    if (!ix)
+    {
+        if (!grow_array((void **)&functions, &size_functions, num_functions+1
+                       , sizeof(*functions), PROFILE_MAX_FRAMES))
+            return;
+
+        ix = num_functions++;
+        memset(functions + ix, 0, sizeof(*functions));
+        functions[ix].file = ref_mstring(file);
+        functions[ix].name = ref_mstring(name);
+        functions[ix].next = function_table[hash];
+        function_table[hash] = ++ix;
+    }
+
+    if (!grow_array((void **)&calls, &size_calls, num_calls+1
+                   , sizeof(*calls), INT32_MAX))
+        return;
+
+    functions[ix-1].calls++;
+    functions[ix-1].active++;
+
+    call = calls + num_calls++;
+    call->fun = ix - 1;
+    call->depth = depth;
+    call->start_ticks = total_evalcost;
+    call->start_time = profile_time();
+    call->child_ticks = 0;
+    call->child_time = 0;
+} /* profile_function_enter() */
+
+/*-------------------------------------------------------------------------*/
+void
+profile_function_leave (int depth)
+
+/* The function with the control frame of depth <depth> returns.
+ */
+
+{
+    profile_functions_unwind(depth);
+    if (num_calls && calls[num_calls-1].depth == depth)
+        close_call(profile_time());
+} /* profile_function_leave() */
+
+/*-------------------------------------------------------------------------*/
+void
+set_profile_functions (Bool enable)
+
+/* Start the accounting of the function calls if <enable> is TRUE,
+ * discarding the old numbers, or stop it and keep the numbers.
+ */
+
+{
+    int32 ix;
+
+    profile_functions_unwind(-1);
+    profile_functions = enable;
+    if (!enable)
+        return;
+
+    for (ix = 0; ix < num_functions; ix++)
+    {
+        free_mstring(functions[ix].file);
+        free_mstring(functions[ix].name);
+    }
+    num_functions = 0;
+    memset(function_table, 0, sizeof(function_table));
+} /* set_profile_functions() */
+
+/*-------------------------------------------------------------------------*/
+void
+get_profile_functions (svalue_t *svp)
+
+/* Put a mapping of the accounted functions into <svp>. The keys are
+ * "<program>:<function>", the values the numbers in the order given
+ * by the PROFILE_* indices in driver_info.h.
+ */
+
+{
+    mapping_t *m;
+    int32 ix;
+
+    memsafe(m = allocate_mapping(num_functions, PROFILE_MAX), num_functions
+           , "profile mapping");
+    put_mapping(svp, m);
+
+    for (ix = 0; ix < num_functions; ix++)
+    {
+        function_entry_t *fun = functions + ix;
+        strbuf_t sbuf;
+        svalue_t key;
+        svalue_t *data;
+
+        strbuf_zero(&sbuf);
+        strbuf_addn(&sbuf, get_txt(fun->file), mstrsize(fun->file));
+        strbuf_addc(&sbuf, ':');
+        strbuf_addn(&sbuf, get_txt(fun->name), mstrsize(fun->name));
+        strbuf_store(&sbuf, &key);
+
+        /* Programs with the same name may give the same text. */
+        data = get_map_lvalue(m, &key);
+        free_svalue(&key);
+        if (!data)
+            outofmemory("profile mapping");
+        data[PROFILE_CALLS].u.number += fun->calls;
+        data[PROFILE_TICKS_SELF].u.number += fun->ticks_self;
+        data[PROFILE_TICKS].u.number += fun->ticks;
+        data[PROFILE_TIME_SELF].u.number += fun->time_self;
+        data[PROFILE_TIME].u.number += fun->time;
+    }
+} /* get_profile_functions() */
+
+/*-------------------------------------------------------------------------*/
+#if defined(GC_SUPPORT)
+
+void
+count_profile_refs (void)
+
+/* GC Support: Count the references to the strings of the frames
+ * and functions.
+ * The tables themselves are permanent allocations.
+ */
+
+{
+    int32 ix;
+
+    for (ix = 0; ix < num_frames; ix++)
+    {
+        count_ref_from_string(frames[ix].frame.file);
+        count_ref_from_string(frames[ix].frame.name);
+    }
+    for (ix = 0; ix < num_functions; ix++)
+    {
+        count_ref_from_string(functions[ix].file);
+        count_ref_from_string(functions[ix].name);
+    }
+} /* count_profile_refs() */
+
+#endif /* GC_SUPPORT */
+
+/***************************************************************************/
@@ -0,0 +1,45 @@
+#ifndef PROFILE_H__
+#define PROFILE_H__ 1
+
+#include "driver.h"
+#include "typedefs.h"
+
+/* --- Types --- */
+
+typedef struct profile_frame_s profile_frame_t;
+
+/* --- struct profile_frame_s: One frame of a sampled control stack
+ */
+
+struct profile_frame_s
+{
+    string_t *file;  /* The program name, uncounted */
+    string_t *name;  /* The function name, uncounted */
+    int       line;  /* The line number, or 0 if unknown */
+};
+
+/* --- Variables --- */
+
+extern Bool profile_functions;
+
+extern statcounter_t profile_samples;
+extern statcounter_t profile_samples_lost;
+
+/* --- Prototypes --- */
+
+extern void profile_clear(void);
+extern void profile_add_sample(profile_frame_t *sample, int num, mp_int weight);
+extern void get_profile_samples(svalue_t *svp);
+extern Bool profile_dump(string_t *fname);
+
+extern void profile_function_enter(string_t *file, string_t *name, int depth);
+extern void profile_function_leave(int depth);
+extern void profile_functions_unwind(int depth);
+extern void set_profile_functions(Bool enable);
+extern void get_profile_functions(svalue_t *svp);
+
+#if defined(GC_SUPPORT)
+extern void count_profile_refs(void);
+#endif /* GC_SUPPORT */
+
+#endif /* PROFILE_H__ */
@@ -0,0 +1,1159 @@
+/*---------------------------------------------------------------------------
+ * Persistent program cache.
+ *
+ *---------------------------------------------------------------------------
+ * If the driver is started with --program-cache <dir>, every program
+ * compiled by load_object() is written into a file in <dir>, and the
+ * next time the same file is loaded (usually after a reboot), the program
+ * is read from that file instead of being compiled again.
+ *
+ * A cache file holds the program block in the form the swapper writes
+ * it, with all pointers into the block changed into offsets, and the
+ * line numbers. The data the program references outside of its block is
+ * stored in pools and replaced by pool indices: the shared strings, the
+ * type objects, and the names of the inherited programs.
+ *
+ * A cached program is used only if
+ *  - it was written by a driver with the same instruction set, data
+ *    sizes and permanent defines,
+ *  - the source file and all included files still have the size and
+ *    modification time they had when the program was compiled,
+ *  - the H_AUTO_INCLUDE hook still returns the same texts,
+ *  - the simul efuns still have the same indices, and
+ *  - the inherited programs are loaded and have the same interface
+ *    (functions, variables and inherits) as the programs used when
+ *    compiling. Their code may have changed.
+ *
+ * If an inherited program isn't loaded yet, load_cached_program() sets
+ * inherit_file, and load_object() loads it and tries again - just as if
+ * the compiler had found the inherit.
+ *
+ * Programs defining or using structs aren't cached, as struct types
+ * belong to the program that defined them. Neither are programs using
+ * __BOOT_TIME__. Changes in the include paths (H_INCLUDE_DIRS) and
+ * answers of master::inherit_file() aren't noticed.
+ * Compiler warnings are of course not repeated for a cached program.
+ *
+ * The files use the byte order and data sizes of the driver that wrote
+ * them, they can't be moved to another machine.
+ *---------------------------------------------------------------------------
+ */
+
+#include "driver.h"
+#include "typedefs.h"
+
+#include "my-alloca.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prog_cache.h"
+#include "backend.h"
+#include "exec.h"
+#include "hash.h"
+#include "instrs.h"
+#include "lex.h"
+#include "main.h"
+#include "mstrings.h"
+#include "object.h"
+#include "prolang.h"
+#include "simulate.h"
+#include "simul_efun.h"
+#include "stdstrings.h"
+#include "swap.h"
+#include "types.h"
+#include "xalloc.h"
+
+/*-------------------------------------------------------------------------*/
+
+#define CACHE_MAGIC   "LDPC"
+#define CACHE_VERSION 1
+
+typedef struct cache_header_s cache_header_t;
+typedef struct cache_type_s   cache_type_t;
+typedef struct cache_pool_s   cache_pool_t;
+typedef struct type_entry_s   type_entry_t;
+
+/* --- struct cache_header_s: The beginning of a cache file
+ *
+ * The header is followed by
+ *   - the program block (.total_size bytes),
+ *   - the line numbers (.line_numbers_size bytes),
+ *   - the interface hash of every inherited program (uint32_t),
+ *   - modification time and size of every include (two int64_t),
+ *   - the type pool (.num_types cache_type_t), and
+ *   - the string pool (.num_strings times the length as uint32_t and
+ *     the text with a trailing '\0'). The first string is the name of
+ *     the program.
+ */
+
+struct cache_header_s
+{
+    char     magic[4];          /* CACHE_MAGIC */
+    uint32_t stamp;             /* driver_stamp() */
+    int64_t  mtime;             /* Modification time of the source file */
+    int64_t  size;              /* Size of the source file */
+    uint32_t defines_hash;      /* hash_permanent_defines() */
+    uint32_t sefun_hash;        /* simul_efun_hash() */
+    uint32_t auto_include_hash; /* auto_include_hash() */
+    uint32_t num_strings;       /* Number of strings in the pool */
+    uint32_t num_types;         /* Number of types in the pool */
+    uint32_t unused;
+    p_int    total_size;        /* Size of the program block */
+    p_int    line_numbers_size; /* Size of the line numbers */
+};
+
+/* --- struct cache_type_s: A type in the type pool
+ *
+ * Types are referenced by their pool index + 1, 0 is NULL. A type
+ * only references types stored before itself.
+ */
+
+struct cache_type_s
+{
+    uint32_t t_class; /* TCLASS_PRIMARY, TCLASS_ARRAY or TCLASS_UNION */
+    uint32_t first;   /* The primary type, element type or union head */
+    uint32_t second;  /* The union member */
+};
+
+/* --- struct cache_pool_s: A pool of strings or types to be written
+ */
+
+struct cache_pool_s
+{
+    char   *entries;  /* The entries */
+    size_t  num;      /* Number of entries used */
+    size_t  size;     /* Number of entries allocated */
+};
+
+/* --- struct type_entry_s: An entry in the type pool
+ */
+
+struct type_entry_s
+{
+    lpctype_t    *type;
+    cache_type_t  rec;
+};
+
+/*-------------------------------------------------------------------------*/
+
+char *prog_cache_dir = NULL;
+  /* The directory for the cache files, or NULL if there is no cache.
+   */
+
+statcounter_t prog_cache_hits = 0;
+statcounter_t prog_cache_misses = 0;
+  /* Number of programs loaded from the cache, resp. the number of loads
+   * which didn't find a valid program in it.
+   */
+
+static program_t *sort_prog;
+  /* The program whose function names are sorted by
+   * compare_function_names().
+   */
+
+/*-------------------------------------------------------------------------*/
+static INLINE uint32_t
+hash_number (p_int n, uint32_t hash)
+
+/* Add the number <n> to <hash> and return the result. */
+
+{
+    return hashmem32_chained(&n, sizeof n, hash);
+} /* hash_number() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE uint32_t
+hash_mstring (string_t *str, uint32_t hash)
+
+/* Add the string <str> to <hash> and return the result. */
+
+{
+    return hashmem32_chained(get_txt(str), mstrsize(str), hash);
+} /* hash_mstring() */
+
+/*-------------------------------------------------------------------------*/
+static uint32_t
+driver_stamp (void)
+
+/* Return a hash of everything in this driver that the format of the
+ * programs depends on: the instruction set and the sizes of the
+ * structures.
+ */
+
+{
+    static uint32_t stamp = 0;
+
+    if (!stamp)
+    {
+        int i;
+
+        stamp = hash_number(CACHE_VERSION, INITIAL_HASH);
+        stamp = hash_number(sizeof(program_t), stamp);
+        stamp = hash_number(sizeof(function_t), stamp);
+        stamp = hash_number(sizeof(variable_t), stamp);
+        stamp = hash_number(sizeof(inherit_t), stamp);
+        stamp = hash_number(sizeof(include_t), stamp);
+        stamp = hash_number(sizeof(linenumbers_t), stamp);
+
+        for (i = 0; i <= LAST_INSTRUCTION_CODE; i++)
+        {
+            if (instrs[i].name)
+                stamp = hashmem32_chained(instrs[i].name
+                                         , strlen(instrs[i].name), stamp);
+            stamp = hash_number(instrs[i].min_arg, stamp);
+            stamp = hash_number(instrs[i].max_arg, stamp);
+        }
+    }
+
+    return stamp;
+} /* driver_stamp() */
+
+/*-------------------------------------------------------------------------*/
+static uint32_t
+simul_efun_hash (Bool isMasterObj)
+
+/* Return a hash of the simul efun table, which the compiled code indexes.
+ * The master and its inherits are compiled without simul efuns, for
+ * them 0 is returned.
+ */
+
+{
+    uint32_t hash = INITIAL_HASH;
+    int i;
+
+    if (isMasterObj)
+        return 0;
+
+    for (i = 0; i < num_simul_efun; i++)
+    {
+        if (simul_efunp[i].name)
+            hash = hash_mstring(simul_efunp[i].name, hash);
+        hash = hash_number(simul_efunp[i].num_arg, hash);
+        hash = hash_number(simul_efunp[i].flags
+                           & (TYPE_MOD_VARARGS | TYPE_MOD_XVARARGS), hash);
+    }
+
+    return hash;
+} /* simul_efun_hash() */
+
+/*-------------------------------------------------------------------------*/
+static uint32_t
+interface_hash (program_t *prog)
+
+/* Return a hash of everything a program inheriting <prog> depends on:
+ * the function and variable tables and the inherits, but not the code
+ * or the addresses of the functions.
+ */
+
+{
+    uint32_t hash;
+    int i;
+
+    hash = hash_mstring(prog->name, INITIAL_HASH);
+    hash = hash_number(prog->num_functions, hash);
+    hash = hash_number(prog->num_variables, hash);
+    hash = hash_number(prog->num_inherited, hash);
+
+    for (i = 0; i < prog->num_functions; i++)
+    {
+        funflag_t flags = prog->functions[i];
+
+        if (!(flags & NAME_INHERITED))
+            flags &= ~FUNSTART_MASK;
+        hash = hash_number(flags, hash);
+    }
+
+    for (i = 0; i < prog->num_function_headers; i++)
+    {
+        function_t *header = prog->function_headers + i;
+
+        hash = hash_mstring(header->name, hash);
+        hash = hash_number(header->num_arg, hash);
+        hash = hash_number(header->flags & ~FUNSTART_MASK, hash);
+    }
+
+    for (i = 0; i < prog->num_variables; i++)
+    {
+        hash = hash_mstring(prog->variables[i].name, hash);
+        hash = hash_number(prog->variables[i].type.t_flags, hash);
+    }
+
+    for (i = 0; i < prog->num_inherited; i++)
+    {
+        inherit_t *inh = prog->inherit + i;
+
+        hash = hash_number(interface_hash(inh->prog), hash);
+        hash = hash_number(inh->function_index_offset, hash);
+        hash = hash_number(inh->variable_index_offset, hash);
+        hash = hash_number(inh->inherit_type, hash);
+    }
+
+    return hash;
+} /* interface_hash() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+is_file_include (include_t *inc)
+
+/* Return TRUE if <inc> describes an included file, and not an include
+ * from another source like the auto-include string.
+ */
+
+{
+    char delim = get_txt(inc->name)[0];
+
+    return delim == '"' || delim == '<';
+} /* is_file_include() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE const char *
+include_file_name (include_t *inc)
+
+/* Return the name of the included file <inc> relative to the mudlib. */
+
+{
+    const char *name = get_txt(inc->filename);
+
+    while (*name == '/')
+        name++;
+    return name;
+} /* include_file_name() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+get_include_stamps (program_t *prog, int64_t *stamps)
+
+/* Store the modification time and size of every file included by <prog>
+ * in <stamps> (two entries per include).
+ *
+ * Return FALSE if a file can't be found.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < prog->num_includes; i++)
+    {
+        include_t *inc = prog->includes + i;
+        struct stat st;
+
+        stamps[2*i] = stamps[2*i+1] = 0;
+        if (!is_file_include(inc))
+            continue;
+        if (ixstat(include_file_name(inc), &st) == -1)
+            return MY_FALSE;
+        stamps[2*i] = (int64_t)st.st_mtime;
+        stamps[2*i+1] = (int64_t)st.st_size;
+    }
+
+    return MY_TRUE;
+} /* get_include_stamps() */
+
+/*-------------------------------------------------------------------------*/
+static uint32_t
+auto_include_hash (const char *fname, program_t *prog)
+
+/* Return a hash of the auto-include texts for the program <prog>
+ * compiled from <fname>, and the files it included.
+ */
+
+{
+    uint32_t hash = INITIAL_HASH;
+    string_t *str;
+    int i;
+
+    str = get_auto_include_string(fname, NULL, MY_FALSE);
+    if (str)
+        hash = hash_mstring(str, hash);
+
+    for (i = 0; i < prog->num_includes; i++)
+    {
+        include_t *inc = prog->includes + i;
+
+        if (!is_file_include(inc))
+            continue;
+
+        str = get_auto_include_string(fname, include_file_name(inc)
+                                     , get_txt(inc->name)[0] == '<');
+        hash = hash_number(i, hash);
+        if (str)
+            hash = hash_mstring(str, hash);
+    }
+
+    return hash;
+} /* auto_include_hash() */
+
+/*-------------------------------------------------------------------------*/
+static char *
+cache_file_name (const char *fname, char *buf)
+
+/* Write the name of the cache file for the program <fname> into <buf>,
+ * which must hold strlen(prog_cache_dir)+32 characters. Return <buf>.
+ */
+
+{
+    size_t len = strlen(fname);
+
+    sprintf(buf, "%s/%08"PRIx32"%08"PRIx32".lpc", prog_cache_dir
+           , (uint32_t)hashmem32(fname, len)
+           , (uint32_t)hashmem32_chained(fname, len, CACHE_VERSION));
+    return buf;
+} /* cache_file_name() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+pool_add (cache_pool_t *pool, const void *entry, size_t entry_size)
+
+/* Append the <entry> of <entry_size> bytes to <pool>.
+ * Return FALSE when out of memory.
+ */
+
+{
+    if (pool->num == pool->size)
+    {
+        size_t size = pool->size ? 2 * pool->size : 64;
+        char *entries = rexalloc(pool->entries, size * entry_size);
+
+        if (!entries)
+            return MY_FALSE;
+        pool->entries = entries;
+        pool->size = size;
+    }
+
+    memcpy(pool->entries + pool->num * entry_size, entry, entry_size);
+    pool->num++;
+    return MY_TRUE;
+} /* pool_add() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+encode_string (cache_pool_t *pool, string_t **strp)
+
+/* Add the string *<strp> to the string <pool> and replace it by its index.
+ * Return FALSE when out of memory.
+ */
+
+{
+    p_int ix = (p_int)pool->num;
+
+    if (!pool_add(pool, strp, sizeof *strp))
+        return MY_FALSE;
+    *strp = (string_t *)ix;
+    return MY_TRUE;
+} /* encode_string() */
+
+/*-------------------------------------------------------------------------*/
+static long
+add_type (cache_pool_t *pool, lpctype_t *t)
+
+/* Add the type <t> and its components to the type <pool> unless they
+ * are there already.
+ * Return the index + 1 of the type, 0 for NULL, or -1 if the type
+ * can't be stored (structs) or memory ran out.
+ */
+
+{
+    type_entry_t entry;
+    size_t i;
+
+    if (t == NULL)
+        return 0;
+
+    for (i = 0; i < pool->num; i++)
+        if (((type_entry_t *)pool->entries)[i].type == t)
+            return (long)i + 1;
+
+    entry.type = t;
+    entry.rec.t_class = t->t_class;
+    entry.rec.first = entry.rec.second = 0;
+
+    switch (t->t_class)
+    {
+    case TCLASS_PRIMARY:
+        entry.rec.first = t->t_primary;
+        break;
+
+    case TCLASS_ARRAY:
+    {
+        long element = add_type(pool, t->t_array.element);
+
+        if (element <= 0)
+            return -1;
+        entry.rec.first = (uint32_t)element;
+        break;
+    }
+
+    case TCLASS_UNION:
+    {
+        long head = add_type(pool, t->t_union.head);
+        long member = add_type(pool, t->t_union.member);
+
+        if (head <= 0 || member <= 0)
+            return -1;
+        entry.rec.first = (uint32_t)head;
+        entry.rec.second = (uint32_t)member;
+        break;
+    }
+
+    default:
+        return -1;
+    }
+
+    if (!pool_add(pool, &entry, sizeof entry))
+        return -1;
+    return (long)pool->num;
+} /* add_type() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+encode_type (cache_pool_t *pool, lpctype_t **tp)
+
+/* Add the type *<tp> to the type <pool> and replace it by its index.
+ * Return FALSE if that's not possible.
+ */
+
+{
+    long ix = add_type(pool, *tp);
+
+    if (ix < 0)
+        return MY_FALSE;
+    *tp = (lpctype_t *)ix;
+    return MY_TRUE;
+} /* encode_type() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+encode_program (program_t *copy, program_t *prog
+               , cache_pool_t *strings, cache_pool_t *types)
+
+/* <copy> is a copy of the program block of <prog>. Replace the strings,
+ * types and inherited programs referenced by <copy> by their indices in
+ * the <strings> and <types> pools, and the pointers into the block by
+ * offsets.
+ * Return FALSE if the program can't be stored.
+ */
+
+{
+    int i;
+
+#define REBASE(type, name) \
+    if (prog->name) \
+        copy->name = (type)((char *)copy + ((char *)prog->name - (char *)prog))
+
+    REBASE(bytecode_p, program);
+    REBASE(unsigned short *, function_names);
+    REBASE(funflag_t *, functions);
+    REBASE(function_t *, function_headers);
+    REBASE(string_t **, strings);
+    REBASE(variable_t *, variables);
+    REBASE(inherit_t *, inherit);
+    REBASE(include_t *, includes);
+    REBASE(lpctype_t **, argument_types);
+    REBASE(unsigned short *, type_start);
+
+#undef REBASE
+
+    for (i = 0; i < copy->num_strings; i++)
+        if (!encode_string(strings, copy->strings + i))
+            return MY_FALSE;
+
+    for (i = 0; i < copy->num_function_headers; i++)
+    {
+        function_t *header = copy->function_headers + i;
+
+        if (!encode_string(strings, &header->name)
+         || !encode_type(types, &header->type))
+            return MY_FALSE;
+    }
+
+    for (i = 0; i < copy->num_variables; i++)
+    {
+        variable_t *var = copy->variables + i;
+
+        if (!encode_string(strings, &var->name)
+         || !encode_type(types, &var->type.t_type))
+            return MY_FALSE;
+    }
+
+    for (i = 0; i < copy->num_includes; i++)
+    {
+        include_t *inc = copy->includes + i;
+
+        if (!encode_string(strings, &inc->name)
+         || !encode_string(strings, &inc->filename))
+            return MY_FALSE;
+    }
+
+    for (i = 0; i < (int)copy->num_argument_types; i++)
+        if (!encode_type(types, copy->argument_types + i))
+            return MY_FALSE;
+
+    for (i = 0; i < copy->num_inherited; i++)
+    {
+        string_t *name = copy->inherit[i].prog->name;
+
+        if (!encode_string(strings, &name))
+            return MY_FALSE;
+        copy->inherit[i].prog = (program_t *)name;
+    }
+
+    locate_out(copy);
+
+    copy->ref = 0;
+#ifdef DEBUG
+    copy->extra_ref = 0;
+#endif
+    copy->name = NULL;
+    copy->blueprint = NULL;
+    copy->line_numbers = NULL;
+    copy->call_caches = NULL;
+    copy->swap_num = -1;
+
+    return MY_TRUE;
+} /* encode_program() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+write_cache_file (FILE *f, cache_header_t *header, program_t *copy
+                 , program_t *prog, uint32_t *inherit_hashes
+                 , int64_t *stamps, cache_pool_t *strings
+                 , cache_pool_t *types)
+
+/* Write the cache file for <prog> with the given parts into <f>.
+ * Return FALSE on errors.
+ */
+
+{
+    size_t i;
+
+    if (fwrite(header, sizeof *header, 1, f) != 1
+     || fwrite(copy, prog->total_size, 1, f) != 1
+     || fwrite(prog->line_numbers, prog->line_numbers->size, 1, f) != 1
+     || (prog->num_inherited
+         && fwrite(inherit_hashes, sizeof *inherit_hashes
+                  , prog->num_inherited, f) != prog->num_inherited)
+     || (prog->num_includes
+         && fwrite(stamps, 2 * sizeof *stamps
+                  , prog->num_includes, f) != prog->num_includes)
+       )
+        return MY_FALSE;
+
+    for (i = 0; i < types->num; i++)
+    {
+        if (fwrite(&((type_entry_t *)types->entries)[i].rec
+                  , sizeof(cache_type_t), 1, f) != 1)
+            return MY_FALSE;
+    }
+
+    for (i = 0; i < strings->num; i++)
+    {
+        string_t *str = ((string_t **)strings->entries)[i];
+        uint32_t len = (uint32_t)mstrsize(str);
+
+        if (fwrite(&len, sizeof len, 1, f) != 1
+         || fwrite(get_txt(str), len + 1, 1, f) != 1)
+            return MY_FALSE;
+    }
+
+    return MY_TRUE;
+} /* write_cache_file() */
+
+/*-------------------------------------------------------------------------*/
+void
+store_cached_program (program_t *prog, const char *fname, struct stat *st
+                     , Bool isMasterObj)
+
+/* The program <prog> was just compiled from the file <fname> with the
+ * status <st>. If there is a program cache, write the program into it.
+ * <isMasterObj> is TRUE if the program belongs to the master or one of
+ * its inherits.
+ *
+ * Failures are not considered errors, the program simply isn't stored.
+ */
+
+{
+    static Bool reported = MY_FALSE;
+    cache_header_t header;
+    cache_pool_t strings = { NULL, 0, 0 };
+    cache_pool_t types = { NULL, 0, 0 };
+    program_t *copy;
+    uint32_t *inherit_hashes;
+    int64_t *stamps;
+    char *path, *tmp_path;
+    Bool ok;
+    int i;
+
+    if (!prog_cache_dir || prog->num_structs || !prog->line_numbers
+     || lex_used_boot_time)
+        return;
+
+    copy = xalloc(prog->total_size);
+    inherit_hashes = xalloc((prog->num_inherited + 1) * sizeof *inherit_hashes);
+    stamps = xalloc((prog->num_includes + 1) * 2 * sizeof *stamps);
+    if (!copy || !inherit_hashes || !stamps)
+    {
+        if (copy)
+            xfree(copy);
+        if (inherit_hashes)
+            xfree(inherit_hashes);
+        if (stamps)
+            xfree(stamps);
+        return;
+    }
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, CACHE_MAGIC, sizeof header.magic);
+    header.stamp = driver_stamp();
+    header.mtime = (int64_t)st->st_mtime;
+    header.size = (int64_t)st->st_size;
+    header.defines_hash = hash_permanent_defines();
+    header.sefun_hash = simul_efun_hash(isMasterObj);
+    header.auto_include_hash = auto_include_hash(fname, prog);
+    header.total_size = prog->total_size;
+    header.line_numbers_size = (p_int)prog->line_numbers->size;
+
+    for (i = 0; i < prog->num_inherited; i++)
+        inherit_hashes[i] = interface_hash(prog->inherit[i].prog);
+
+    memcpy(copy, prog, prog->total_size);
+
+    /* The name of the program is the first string in the pool */
+    ok = pool_add(&strings, &prog->name, sizeof prog->name)
+      && encode_program(copy, prog, &strings, &types)
+      && get_include_stamps(prog, stamps);
+
+    if (ok)
+    {
+        FILE *f;
+
+        header.num_strings = (uint32_t)strings.num;
+        header.num_types = (uint32_t)types.num;
+
+        path = alloca(strlen(prog_cache_dir) + 32);
+        tmp_path = alloca(strlen(prog_cache_dir) + 40);
+        cache_file_name(fname, path);
+        sprintf(tmp_path, "%s.%ld", path, (long)getpid());
+
+        f = fopen(tmp_path, "wb");
+        if (f == NULL)
+            ok = MY_FALSE;
+        else
+        {
+            ok = write_cache_file(f, &header, copy, prog, inherit_hashes
+                                 , stamps, &strings, &types);
+            if (fclose(f) != 0)
+                ok = MY_FALSE;
+            if (!ok || rename(tmp_path, path) != 0)
+            {
+                ok = MY_FALSE;
+                unlink(tmp_path);
+            }
+        }
+
+        if (!ok && !reported)
+        {
+            debug_message("%s Can't write the program cache file for '%s' "
+                          "into '%s'.\n"
+                         , time_stamp(), fname, prog_cache_dir);
+            reported = MY_TRUE;
+        }
+    }
+
+    xfree(copy);
+    xfree(inherit_hashes);
+    xfree(stamps);
+    if (strings.entries)
+        xfree(strings.entries);
+    if (types.entries)
+        xfree(types.entries);
+} /* store_cached_program() */
+
+/*-------------------------------------------------------------------------*/
+static const char *
+take (const char **pos, const char *end, size_t len)
+
+/* Take the next <len> bytes from the buffer at *<pos> ending at <end>.
+ * Return a pointer to them, or NULL if the buffer is too short.
+ */
+
+{
+    const char *p = *pos;
+
+    if ((size_t)(end - p) < len)
+        return NULL;
+    *pos = p + len;
+    return p;
+} /* take() */
+
+/*-------------------------------------------------------------------------*/
+static lpctype_t *
+primary_type (uint32_t t)
+
+/* Return the type object for the primary type <t>, or NULL. */
+
+{
+    switch (t)
+    {
+    case TYPE_UNKNOWN:      return lpctype_unknown;
+    case TYPE_NUMBER:       return lpctype_int;
+    case TYPE_STRING:       return lpctype_string;
+    case TYPE_VOID:         return lpctype_void;
+    case TYPE_OBJECT:       return lpctype_object;
+    case TYPE_MAPPING:      return lpctype_mapping;
+    case TYPE_FLOAT:        return lpctype_float;
+    case TYPE_ANY:          return lpctype_mixed;
+    case TYPE_CLOSURE:      return lpctype_closure;
+    case TYPE_SYMBOL:       return lpctype_symbol;
+    case TYPE_QUOTED_ARRAY: return lpctype_quoted_array;
+    }
+    return NULL;
+} /* primary_type() */
+
+/*-------------------------------------------------------------------------*/
+static int
+compare_function_names (const void *a, const void *b)
+
+/* qsort() comparison of two indices into sort_prog->function_names[].
+ * The order has to match the one in prolang.y:epilog().
+ */
+
+{
+    string_t *name_a, *name_b;
+
+    name_a = get_function_header(sort_prog, *(const unsigned short *)a)->name;
+    name_b = get_function_header(sort_prog, *(const unsigned short *)b)->name;
+    return memcmp(&name_a, &name_b, sizeof name_a);
+} /* compare_function_names() */
+
+/*-------------------------------------------------------------------------*/
+static program_t *
+decode_program (const char *buf, size_t len, const char *fname
+               , struct stat *st, Bool isMasterObj)
+
+/* Create the program for <fname> with the status <st> from the cache
+ * file contents <buf> of <len> bytes.
+ *
+ * Return the program, or NULL if the file is invalid or out of date.
+ * If an inherited program needs to be loaded first, inherit_file is set.
+ */
+
+{
+    const char *pos = buf, *end = buf + len;
+    const char *block, *line_numbers, *hashes, *file_stamps, *type_recs;
+    cache_header_t header;
+    program_t tmp, *prog;
+    program_t **inherited;
+    const char **texts;
+    uint32_t *lengths;
+    string_t **strs;
+    lpctype_t **types;
+    int64_t *stamps;
+    Bool corrupt;
+    uint32_t i;
+
+#define STRING(ix) (corrupt |= ((p_int)(ix) < 0 || (p_int)(ix) >= (p_int)header.num_strings) \
+                   , ref_mstring(strs[corrupt ? 0 : (p_int)(ix)]))
+#define TYPE(ix) (corrupt |= ((p_int)(ix) < 0 || (p_int)(ix) > (p_int)header.num_types) \
+                 , (corrupt || !(ix)) ? NULL : ref_lpctype(types[(p_int)(ix)-1]))
+
+    /* Check the header */
+    if (!take(&pos, end, sizeof header))
+        return NULL;
+    memcpy(&header, buf, sizeof header);
+
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof header.magic)
+     || header.stamp != driver_stamp()
+     || header.mtime != (int64_t)st->st_mtime
+     || header.size != (int64_t)st->st_size
+     || header.defines_hash != hash_permanent_defines()
+     || header.sefun_hash != simul_efun_hash(isMasterObj)
+     || header.total_size < (p_int)sizeof tmp
+     || header.line_numbers_size < (p_int)sizeof(linenumbers_t)
+     || header.num_strings < 1
+     || header.num_strings > len
+     || (size_t)header.num_types > len
+       )
+        return NULL;
+
+    /* Find the parts of the file */
+    block = take(&pos, end, header.total_size);
+    line_numbers = take(&pos, end, header.line_numbers_size);
+    if (!block || !line_numbers)
+        return NULL;
+    memcpy(&tmp, block, sizeof tmp);
+    if (((linenumbers_t *)line_numbers)->size != (size_t)header.line_numbers_size
+     || tmp.total_size != header.total_size
+     || (tmp.num_inherited
+         && ((p_int)tmp.inherit < (p_int)sizeof tmp
+          || (p_int)tmp.inherit + tmp.num_inherited * (p_int)sizeof(inherit_t)
+             > header.total_size))
+       )
+        return NULL;
+
+    hashes = take(&pos, end, tmp.num_inherited * sizeof(uint32_t));
+    file_stamps = take(&pos, end, tmp.num_includes * 2 * sizeof(int64_t));
+    type_recs = take(&pos, end, header.num_types * sizeof(cache_type_t));
+    if (!hashes || !file_stamps || !type_recs)
+        return NULL;
+
+    texts = alloca(header.num_strings * sizeof *texts);
+    lengths = alloca(header.num_strings * sizeof *lengths);
+    for (i = 0; i < header.num_strings; i++)
+    {
+        const char *p = take(&pos, end, sizeof lengths[i]);
+
+        if (!p)
+            return NULL;
+        memcpy(lengths + i, p, sizeof lengths[i]);
+        if (!(texts[i] = take(&pos, end, (size_t)lengths[i] + 1)))
+            return NULL;
+    }
+
+    if (strcmp(texts[0], fname))
+        return NULL;
+
+    /* Find the inherited programs */
+    inherited = alloca((tmp.num_inherited + 1) * sizeof *inherited);
+    for (i = 0; i < tmp.num_inherited; i++)
+    {
+        inherit_t inh;
+        uint32_t hash;
+        p_int ix;
+        size_t name_len;
+        char *name;
+        object_t *ob;
+
+        memcpy(&inh, block + (p_int)tmp.inherit + i * sizeof inh, sizeof inh);
+        memcpy(&hash, hashes + i * sizeof hash, sizeof hash);
+        ix = (p_int)inh.prog;
+        if (ix < 0 || ix >= (p_int)header.num_strings)
+            return NULL;
+
+        /* The object name is the program name without the '.c' */
+        name_len = lengths[ix];
+        if (name_len < 2 || strcmp(texts[ix] + name_len - 2, ".c"))
+            return NULL;
+        name_len -= 2;
+        name = alloca(name_len + 1);
+        memcpy(name, texts[ix], name_len);
+        name[name_len] = '\0';
+
+        ob = find_object_str(name);
+        if (!ob)
+        {
+            inherit_file = new_tabled(name);
+            return NULL;
+        }
+        if (ob->flags & O_SWAPPED && load_ob_from_swap(ob) < 0)
+            return NULL;
+
+        if (strcmp(get_txt(ob->prog->name), texts[ix])
+         || interface_hash(ob->prog) != hash)
+            return NULL;
+        inherited[i] = ob->prog;
+    }
+
+    /* Everything should be fine, create the pooled data */
+    prog = xalloc(header.total_size);
+    strs = xalloc(header.num_strings * sizeof *strs);
+    types = xalloc((header.num_types + 1) * sizeof *types);
+    stamps = xalloc((tmp.num_includes + 1) * 2 * sizeof *stamps);
+    if (!prog || !strs || !types || !stamps)
+    {
+        if (prog)
+            xfree(prog);
+        if (strs)
+            xfree(strs);
+        if (types)
+            xfree(types);
+        if (stamps)
+            xfree(stamps);
+        return NULL;
+    }
+
+    corrupt = MY_FALSE;
+    init_standard_lpctypes();
+    for (i = 0; i < header.num_strings; i++)
+    {
+        strs[i] = new_n_tabled(texts[i], lengths[i]);
+        if (!strs[i])
+            strs[i] = ref_mstring(STR_DEFAULT);
+    }
+
+    for (i = 0; i < header.num_types; i++)
+    {
+        cache_type_t rec;
+        lpctype_t *t = NULL;
+
+        memcpy(&rec, type_recs + i * sizeof rec, sizeof rec);
+        if (rec.t_class == TCLASS_PRIMARY)
+            t = ref_lpctype(primary_type(rec.first));
+        else if (rec.first < 1 || rec.first > i || rec.second > i)
+            t = NULL;
+        else if (rec.t_class == TCLASS_ARRAY)
+            t = get_array_type(types[rec.first-1]);
+        else if (rec.t_class == TCLASS_UNION && rec.second >= 1)
+            t = get_union_type(types[rec.first-1], types[rec.second-1]);
+
+        if (t == NULL)
+        {
+            corrupt = MY_TRUE;
+            t = ref_lpctype(lpctype_mixed);
+        }
+        types[i] = t;
+    }
+
+    /* Create the program block */
+    memcpy(prog, block, header.total_size);
+    locate_in(prog);
+    if (!prog->num_inherited)
+        prog->inherit = NULL;
+    if (!prog->num_includes)
+        prog->includes = NULL;
+    prog->struct_defs = NULL;
+    prog->num_structs = 0;
+    prog->flags &= ~P_REPLACE_ACTIVE;
+
+    prog->ref = 0;
+#ifdef DEBUG
+    prog->extra_ref = 0;
+#endif
+    prog->name = new_mstring(fname);
+    prog->blueprint = NULL;
+    prog->id_number =
+      ++current_id_number ? current_id_number : renumber_programs();
+    prog->load_time = current_time;
+    prog->call_caches = NULL;
+    prog->swap_num = -1;
+
+    for (i = 0; i < prog->num_strings; i++)
+        prog->strings[i] = STRING(prog->strings[i]);
+
+    for (i = 0; i < prog->num_function_headers; i++)
+    {
+        function_t *fun = prog->function_headers + i;
+
+        fun->name = STRING(fun->name);
+        fun->type = TYPE(fun->type);
+    }
+
+    for (i = 0; i < prog->num_variables; i++)
+    {
+        variable_t *var = prog->variables + i;
+
+        var->name = STRING(var->name);
+        var->type.t_type = TYPE(var->type.t_type);
+    }
+
+    for (i = 0; i < prog->num_includes; i++)
+    {
+        include_t *inc = prog->includes + i;
+
+        inc->name = STRING(inc->name);
+        inc->filename = STRING(inc->filename);
+    }
+
+    for (i = 0; i < prog->num_argument_types; i++)
+        prog->argument_types[i] = TYPE(prog->argument_types[i]);
+
+    for (i = 0; i < prog->num_inherited; i++)
+        prog->inherit[i].prog = inherited[i];
+
+#undef STRING
+#undef TYPE
+
+    /* The function names are sorted by the addresses of their names */
+    sort_prog = prog;
+    qsort(prog->function_names, prog->num_function_names
+         , sizeof *prog->function_names, compare_function_names);
+
+    prog->line_numbers = xalloc(header.line_numbers_size);
+    if (prog->line_numbers)
+        memcpy(prog->line_numbers, line_numbers, header.line_numbers_size);
+    else
+        corrupt = MY_TRUE;
+
+    reference_prog(prog, "load_cached_program");
+    for (i = 0; i < prog->num_inherited; i++)
+        reference_prog(prog->inherit[i].prog, "inheritance");
+
+    total_prog_block_size += prog->total_size + mstrsize(prog->name);
+    if (prog->line_numbers)
+        total_prog_block_size += prog->line_numbers->size;
+    total_num_prog_blocks += 1;
+
+    /* Release the pools */
+    for (i = 0; i < header.num_strings; i++)
+        free_mstring(strs[i]);
+    for (i = 0; i < header.num_types; i++)
+        free_lpctype(types[i]);
+    xfree(strs);
+    xfree(types);
+
+    /* At last check the includes, now that the program can tell them */
+    if (corrupt
+     || !get_include_stamps(prog, stamps)
+     || memcmp(stamps, file_stamps, prog->num_includes * 2 * sizeof *stamps)
+     || auto_include_hash(fname, prog) != header.auto_include_hash
+       )
+    {
+        free_prog(prog, MY_TRUE);
+        prog = NULL;
+    }
+
+    xfree(stamps);
+    return prog;
+} /* decode_program() */
+
+/*-------------------------------------------------------------------------*/
+program_t *
+load_cached_program (const char *fname, struct stat *st, Bool isMasterObj)
+
+/* Look for the program of the file <fname> with the status <st> in the
+ * program cache. <isMasterObj> is TRUE if the program belongs to the master
+ * or one of its inherits.
+ *
+ * Return the program (with one reference), or NULL if there is no valid
+ * one. In the latter case inherit_file may be set to an inherited program
+ * which needs to be loaded before the cached program can be used.
+ */
+
+{
+    char *path;
+    char *buf;
+    FILE *f;
+    struct stat fst;
+    program_t *prog = NULL;
+
+    if (!prog_cache_dir)
+        return NULL;
+
+    path = alloca(strlen(prog_cache_dir) + 32);
+    f = fopen(cache_file_name(fname, path), "rb");
+    if (f != NULL)
+    {
+        if (fstat(fileno(f), &fst) == 0
+         && NULL != (buf = xalloc((size_t)fst.st_size + 1)))
+        {
+            if (fread(buf, (size_t)fst.st_size, 1, f) == 1)
+                prog = decode_program(buf, (size_t)fst.st_size, fname
+                                     , st, isMasterObj);
+            xfree(buf);
+        }
+        fclose(f);
+    }
+
+    if (prog)
+        prog_cache_hits++;
+    else if (!inherit_file)
+        prog_cache_misses++;
+
+    return prog;
+} /* load_cached_program() */
+
+/***************************************************************************/
+
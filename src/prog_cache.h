@@ -0,0 +1,20 @@
+#ifndef PROG_CACHE_H__
+#define PROG_CACHE_H__ 1
+
+#include <sys/stat.h>
+
+#include "driver.h"
+#include "typedefs.h"
+
+/* --- Variables --- */
+
+extern char *prog_cache_dir;
+extern statcounter_t prog_cache_hits;
+extern statcounter_t prog_cache_misses;
+
+/* --- Prototypes --- */
+
+extern program_t *load_cached_program(const char *fname, struct stat *st, Bool isMasterObj);
+extern void store_cached_program(program_t *prog, const char *fname, struct stat *st, Bool isMasterObj);
+
+#endif /* PROG_CACHE_H__ */
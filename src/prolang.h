@@ -20,6 +20,7 @@ extern int num_virtual_variables;
 extern short hook_type_map[];
 extern string_t *inherit_file;
 extern int num_parse_error;
+extern int num_parse_warning;
 extern program_t *compiled_prog;
 extern Bool variables_defined;
 
@@ -34,6 +35,7 @@ extern void store_line_number_info(void);
 extern void store_line_number_backward(int offset);
 extern mp_uint store_include_info(char *name, char *file, char delim, int inc_depth);
 extern void store_include_end(mp_uint inc_offset, int include_line);
+extern void init_standard_lpctypes(void);
 extern void compile_file(int fd, const char * fname, Bool isMasterObj);
 extern Bool is_undef_function (bytecode_p fun);
 extern short find_inherited_function (const char * super_name, const char * real_name , unsigned short * pInherit, funflag_t *flags);
@@ -130,6 +130,10 @@ typedef struct const_list_svalue_s const_list_svalue_t;
 typedef struct struct_init_s       struct_init_t;
 typedef struct efun_shadow_s       efun_shadow_t;
 typedef struct mem_block_s         mem_block_t;
+typedef struct opt_local_s         opt_local_t;
+typedef struct opt_mark_s          opt_mark_t;
+typedef struct opt_site_s          opt_site_t;
+typedef struct opt_frame_s         opt_frame_t;
 
 /*-------------------------------------------------------------------------*/
 /* Exported result variables */
@@ -159,6 +163,10 @@ int num_parse_error;
   /* Number of errors in the compile.
    */
 
+int num_parse_warning;
+  /* Number of warnings in the compile.
+   */
+
 Bool variables_defined;
   /* TRUE: Variable definitions have been encountered.
    */
@@ -807,6 +815,11 @@ static int call_other_sefun;
   /* Index of the call_other() sefun, or < 0 if none;
    */
 
+static int num_call_caches;
+  /* Number of call_other sites with an inline cache
+   * (F_CALL_OTHER_CACHED) generated so far.
+   */
+
 static ident_t *all_globals = NULL;
   /* List of all created global identifiers (variables and functions).
    */
@@ -946,6 +959,129 @@ static const char * compiled_file;
    * the program's name. Set by prolog().
    */
 
+/*-------------------------------------------------------------------------*/
+/* State of the optimizer (see the OPTIMIZER section).
+ */
+
+#define OPT_MAX_SITES  256
+  /* Max number of code sites per function remembered for the final pass.
+   */
+
+#define OPT_MAX_TEMPS  4
+  /* Max number of hidden locals holding hoisted loop invariants.
+   */
+
+#define OPT_MAX_HOPS   8
+  /* Max number of branches followed when threading a jump.
+   */
+
+/* What the optimizer knows about a local variable.
+ */
+struct opt_local_s
+{
+    p_int value;   /* The known value */
+    Bool  known;   /* TRUE if the variable is known to hold <value> */
+    Bool  escaped; /* TRUE if a reference to the variable was created */
+};
+
+/* A position in the program code to which the code can be cut back.
+ */
+struct opt_mark_s
+{
+    p_int         pc;            /* The program size, or -1 if unset */
+    mp_uint       li_size;       /* The size of the linenumber data */
+    p_int         stored_bytes;  /* Saved <stored_bytes> */
+    p_int         stored_lines;  /* Saved <stored_lines> */
+    unsigned long barrier;       /* Saved <opt_barrier> */
+};
+
+/* A site in the code to be revisited when the function is complete.
+ */
+struct opt_site_s
+{
+    p_int pos;   /* Address of the instruction resp. byte */
+    int   kind;  /* OPT_SITE_xxx */
+};
+
+#define OPT_SITE_BRANCH  0
+  /* A branch instruction to be threaded.
+   */
+
+#define OPT_SITE_TEMP    1
+  /* The operand byte of a hidden local, holding the index of the
+   * temporary to be turned into a local index.
+   */
+
+/* The optimizer state of one nested statement (if, loops, switch) resp.
+ * inline closure.
+ */
+struct opt_frame_s
+{
+    opt_mark_t dead;       /* Saved <opt_dead> of the enclosing code */
+    Bool       propagate;  /* Saved <opt_propagate> */
+
+    int        cond;       /* if: OPT_COND_xxx */
+    opt_mark_t mark;       /* if: where to cut off a branch never taken */
+    p_int      else_start; /* if: start of an else part without a branch
+                            * over it */
+    Bool       ends;       /* if: both parts end with a return, break
+                            * or continue */
+
+    int        hoist_local;   /* loops: local hoisted out of the condition,
+                               * or -1 */
+    int        hoist_temp;    /* loops: temporary holding the sizeof() */
+    p_int      hoist_pos;     /* loops: address of the preheader code */
+    int        hoist_len;     /* loops: length of the preheader code */
+    int        hoist_offset;  /* loops: offset of the sizeof() in the
+                               * condition code */
+};
+
+#define OPT_COND_NORMAL   0  /* Condition isn't constant */
+#define OPT_COND_TRUE     1  /* Condition is always true */
+#define OPT_COND_FALSE    2  /* Condition is always false */
+#define OPT_COND_REMOVED  3  /* Condition false, if-part removed */
+
+static Bool opt_active;
+  /* TRUE if the function being compiled is to be optimized, set
+   * from pragma_optimize at the start of the function body.
+   */
+
+static Bool opt_propagate;
+  /* TRUE if the values of locals may be tracked: in function bodies, but
+   * not in inline closures.
+   */
+
+static opt_local_t opt_locals[MAX_LOCAL];
+  /* What is known about the locals of the current function.
+   */
+
+static unsigned long opt_barrier;
+  /* Counter incremented whenever code or linenumber data is moved in a
+   * way marks can't follow (includes, inline closures).
+   */
+
+static opt_mark_t opt_dead;
+  /* If set, the code after this mark is unreachable.
+   */
+
+static opt_site_t opt_sites[OPT_MAX_SITES];
+static int        opt_num_sites;
+  /* Sites to revisit at the end of the function.
+   */
+
+static opt_frame_t opt_frames[COMPILER_STACK_SIZE];
+static int         opt_frame_depth;
+  /* Stack of the optimizer states of nested statements.
+   */
+
+static int opt_num_temps;
+  /* Number of hidden temporaries used by the current function.
+   */
+
+static int opt_temps_in_use;
+  /* Number of hidden temporaries currently in use.
+   */
+
   /* A few standard types we often need.
    * We'll initialize them later (using the type functions, so all pointers
    * are correctly set) and then put them into a static storage (and set
@@ -967,10 +1103,12 @@ lpctype_t *lpctype_unknown_array = &_lpctype_unknown_array,
 /* Forward declarations */
 
 struct lvalue_s; /* Defined within YYSTYPE aka %union */
+struct s_lrvalue; /* Defined within YYSTYPE aka %union */
 
 static void define_local_variable (ident_t* name, lpctype_t* actual_type, struct lvalue_s *lv, Bool redeclare, Bool with_init);
-static void init_local_variable (ident_t* name, struct lvalue_s *lv, int assign_op, fulltype_t type2);
+static void init_local_variable (ident_t* name, struct lvalue_s *lv, int assign_op, fulltype_t type2, p_int start);
 static Bool add_lvalue_code ( struct lvalue_s * lv, int instruction);
+static void ins_binary_operator (int instruction, struct s_lrvalue *left, struct s_lrvalue *right);
 static void insert_pop_value(void);
 static void arrange_protected_lvalue(p_int, int, p_int, int);
 static int insert_inherited(char *, string_t *, program_t **, function_t *, int, bytecode_p);
@@ -986,6 +1124,8 @@ static void copy_variables(program_t *, funflag_t);
 static int copy_functions(program_t *, funflag_t type);
 static void copy_structs(program_t *, funflag_t);
 static void new_inline_closure (void);
+static void opt_drop_sites (p_int from);
+static void opt_code_moved (p_int from, p_int len);
 static void fix_function_inherit_indices(program_t *);
 static void fix_variable_index_offsets(program_t *);
 static short store_prog_string (string_t *str);
@@ -1050,6 +1190,7 @@ yywarn (const char *str)
 {
     char *context;
 
+    num_parse_warning++;
     context = lex_error_context();
     fprintf(stderr, "%s %s line %d: Warning: %s%s.\n"
                   , time_stamp(), current_loc.file->name, current_loc.line
@@ -3024,6 +3165,7 @@ fix_branch (int ltoken, p_int dest, p_int loc)
         /* Store the new branch instruction */
         PUT_CODE(p, ltoken);
         upd_short(loc, offset+2);
+        opt_code_moved(loc+1, 1);
 
         if (offset > 0x7ffd)
             yyerrorf("Compiler limit: Too much code to branch over: %"
@@ -3092,6 +3234,7 @@ yymove_switch_instructions (int len, p_int blocklen)
           mem_block[A_PROGRAM].block + switch_pc,
           blocklen
         );
+        opt_code_moved(switch_pc, len);
     }
     else
     {
@@ -3142,67 +3285,1040 @@ update_lop_branch ( p_uint address, int instruction )
  */
 
 {
-    p_int offset;
+    p_int offset;
+
+    last_expression = -1;
+
+    offset = mem_block[A_PROGRAM].current_size - ( address + 1);
+    if (offset > 0xff)
+    {
+        /* A long branch is needed */
+
+        int i;
+        bytecode_p p;
+
+        ins_short(0);
+        ins_byte(0);
+        p = PROGRAM_BLOCK + mem_block[A_PROGRAM].current_size-1;
+        for (i = offset; --i >= 0; --p )
+            *p = p[-3];
+        p[-4] = F_DUP;
+        p[-3] = instruction;
+        upd_short(address+1, offset+3);
+        if (offset > 0x7ffc)
+            yyerrorf("Compiler limit: Too much code to skip for ||/&&:"
+                     " %"PRIdPINT" bytes" , offset);
+        p[0]  = F_POP_VALUE;
+        opt_code_moved(address+1, 3);
+    }
+    else
+    {
+        mem_block[A_PROGRAM].block[address] = offset;
+    }
+} /* update_lop_branch() */
+
+/*-------------------------------------------------------------------------*/
+static void
+shuffle_code (p_uint start1, p_uint start2, p_uint end)
+
+/* Reverse the order of the program blocks [start1..start2[ and [start2..end[
+ */
+
+{
+    p_uint len1 = start2 - start1;
+    p_uint len2 = end - start2;
+
+    bytecode_p pStart1 = PROGRAM_BLOCK + start1;
+    bytecode_p pStart2 = PROGRAM_BLOCK + start2;
+
+    bytecode_p * pTmp;
+
+    if (!len1 || !len2)
+        return;
+
+    pTmp = xalloc(len1);
+    if (!pTmp)
+    {
+        yyerror("(shuffle_code) Out of memory");
+        return;
+    }
+    memmove(pTmp, pStart1, len1);
+    memmove(pStart1, pStart2, len2);
+    memmove(pStart1+len2, pTmp, len1);
+    xfree(pTmp);
+} /* shuffle_code() */
+
+/* ===========================   OPTIMIZER   =========================== */
+
+/* The optimizer works on the code while it is generated: only the parser
+ * knows where statements, conditions and loops begin and end, the bytecode
+ * itself can't even be decoded without it. It is active in function bodies
+ * compiled with #pragma optimize (the default) and does:
+ *
+ *  - fold integer operations on constants and on locals with a known
+ *    constant value (constant propagation),
+ *  - remove assignments of values a local is known to hold already, in
+ *    particular the initialization of new locals with 0,
+ *  - remove unreachable code after return, break and continue, and
+ *    the branches of if()s with a constant condition,
+ *  - compile loops with a constant true condition without the check,
+ *  - thread jumps to jumps, and turn jumps to a 'return 0' into the
+ *    return itself,
+ *  - hoist the sizeof() of a local array or string out of a loop
+ *    condition into a hidden local, if the loop doesn't assign to the
+ *    variable.
+ *
+ * The values of the locals are tracked along straight code only: wherever
+ * control flows join (else, end of if, loop heads and ends, case labels)
+ * everything is forgotten.
+ */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+opt_enabled (void)
+
+/* Return TRUE if the code of the current function is to be optimized.
+ */
+
+{
+    return opt_active && !num_parse_error;
+} /* opt_enabled() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+opt_fold_enabled (void)
+
+/* Return TRUE if constant expressions are to be folded. This is done
+ * outside of functions as well.
+ */
+
+{
+    return pragma_optimize && !num_parse_error;
+} /* opt_fold_enabled() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+opt_can_remove (p_int start)
+
+/* Return TRUE if the code from <start> on can simply be cut off: no
+ * linenumber information was stored for it yet.
+ */
+
+{
+    return start >= 0 && stored_bytes <= start;
+} /* opt_can_remove() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_forget_all (void)
+
+/* Forget the known values of all locals.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < MAX_LOCAL; i++)
+        opt_locals[i].known = MY_FALSE;
+} /* opt_forget_all() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_local_written (int num)
+
+/* Local <num> is assigned an unknown value.
+ */
+
+{
+    if (num >= 0 && num < MAX_LOCAL)
+        opt_locals[num].known = MY_FALSE;
+} /* opt_local_written() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_local_escaped (int num)
+
+/* A reference to local <num> is created: its value can change behind
+ * our back from now on.
+ */
+
+{
+    if (num >= 0 && num < MAX_LOCAL)
+    {
+        opt_locals[num].known = MY_FALSE;
+        opt_locals[num].escaped = MY_TRUE;
+    }
+} /* opt_local_escaped() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_local_declared (int num, Bool cleared)
+
+/* Local <num> is (re)declared. If <cleared> is TRUE, it is known to be 0.
+ * Inside inline closures the local numbers belong to the closure,
+ * so these declarations are ignored.
+ */
+
+{
+    if (opt_propagate && num >= 0 && num < MAX_LOCAL)
+    {
+        opt_locals[num].value = 0;
+        opt_locals[num].known = cleared;
+        opt_locals[num].escaped = MY_FALSE;
+    }
+} /* opt_local_declared() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_begin_function (void)
+
+/* The body of a new function starts: reset the optimizer state.
+ */
+
+{
+    int i;
+
+    opt_active = pragma_optimize;
+    opt_propagate = opt_active;
+    for (i = 0; i < MAX_LOCAL; i++)
+    {
+        opt_locals[i].known = MY_FALSE;
+        opt_locals[i].escaped = MY_FALSE;
+    }
+    opt_dead.pc = -1;
+    opt_num_sites = 0;
+    opt_frame_depth = 0;
+    opt_num_temps = 0;
+    opt_temps_in_use = 0;
+} /* opt_begin_function() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_set_mark (opt_mark_t *mark)
+
+/* Set <mark> to the current end of the program.
+ */
+
+{
+    store_line_number_info();
+    mark->pc = CURRENT_PROGRAM_SIZE;
+    mark->li_size = LINENUMBER_SIZE;
+    mark->stored_bytes = stored_bytes;
+    mark->stored_lines = stored_lines;
+    mark->barrier = opt_barrier;
+} /* opt_set_mark() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_truncate (opt_mark_t *mark)
+
+/* Remove all code generated since <mark> was set, if that is possible.
+ * Return TRUE on success.
+ *
+ * Not possible is a removal of code which is still referenced: by pending
+ * break or continue branches, or by the CLEAR_LOCALS of an open scope
+ * (which is completed later).
+ */
+
+{
+    p_int pc = mark->pc;
+    int i;
+
+    if (!opt_enabled() || pc < 0 || mark->barrier != opt_barrier
+     || LINENUMBER_SIZE < mark->li_size)
+        return MY_FALSE;
+
+    if (pc >= CURRENT_PROGRAM_SIZE)
+        return pc == CURRENT_PROGRAM_SIZE;
+
+    if (!(current_break_address & (BREAK_ON_STACK|BREAK_DELIMITER))
+     && (current_break_address & BREAK_ADDRESS_MASK) >= pc)
+        return MY_FALSE;
+
+    if (!(current_continue_address & CONTINUE_DELIMITER)
+     && (current_continue_address & CONTINUE_ADDRESS_MASK) >= pc)
+        return MY_FALSE;
+
+    for (i = 0; i < block_depth; i++)
+    {
+        if (block_scope[i].num_locals > block_scope[i].num_cleared
+         && block_scope[i].addr >= (mp_uint)pc)
+            return MY_FALSE;
+    }
+
+    CURRENT_PROGRAM_SIZE = pc;
+    LINENUMBER_SIZE = mark->li_size;
+    stored_bytes = mark->stored_bytes;
+    stored_lines = mark->stored_lines;
+    last_expression = -1;
+    opt_drop_sites(pc);
+
+    /* The removed code may have assigned values */
+    opt_forget_all();
+
+    return MY_TRUE;
+} /* opt_truncate() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_drop_sites (p_int from)
+
+/* The code from address <from> on was removed: forget its sites.
+ */
+
+{
+    int i, j;
+
+    for (i = j = 0; i < opt_num_sites; i++)
+    {
+        if (opt_sites[i].pos < from)
+            opt_sites[j++] = opt_sites[i];
+    }
+    opt_num_sites = j;
+} /* opt_drop_sites() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_code_moved (p_int from, p_int len)
+
+/* The code from address <from> on was moved back by <len> bytes:
+ * adjust the remembered addresses.
+ */
+
+{
+    int i;
+
+    for (i = 0; i < opt_num_sites; i++)
+    {
+        if (opt_sites[i].pos >= from)
+            opt_sites[i].pos += len;
+    }
+
+    /* Marks can't follow, as the linenumbers don't. */
+    if (opt_dead.pc >= from)
+        opt_dead.barrier = ~opt_barrier;
+
+    for (i = 0; i < opt_frame_depth && i < COMPILER_STACK_SIZE; i++)
+    {
+        opt_frame_t *frame = opt_frames + i;
+
+        if (frame->dead.pc >= from)
+            frame->dead.barrier = ~opt_barrier;
+        if (frame->mark.pc >= from)
+            frame->mark.barrier = ~opt_barrier;
+        if (frame->else_start >= from)
+            frame->else_start += len;
+        if (frame->hoist_local >= 0 && frame->hoist_pos >= from)
+            frame->hoist_pos += len;
+    }
+} /* opt_code_moved() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_add_site (p_int pos, int kind)
+
+/* Remember the code at <pos> as site of <kind> for the end of the function.
+ * Return TRUE on success, FALSE if there is no more room.
+ *
+ * Branches may not use the last OPT_MAX_TEMPS entries: they are kept
+ * for the condition sites of the loops with hoisted invariants, which
+ * must not get lost.
+ */
+
+{
+    int limit = OPT_MAX_SITES;
+
+    if (kind == OPT_SITE_BRANCH)
+    {
+        if (!opt_enabled())
+            return MY_FALSE;
+        limit -= OPT_MAX_TEMPS;
+    }
+    if (opt_num_sites >= limit)
+        return MY_FALSE;
+
+    opt_sites[opt_num_sites].pos = pos;
+    opt_sites[opt_num_sites].kind = kind;
+    opt_num_sites++;
+    return MY_TRUE;
+} /* opt_add_site() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_add_loop_break (p_int pos)
+
+/* The loop break with the offset at <pos> was just completed: note it
+ * for the jump threading.
+ */
+
+{
+    if (pos > 0 && PROGRAM_BLOCK[pos-1] == F_FBRANCH)
+        (void)opt_add_site(pos-1, OPT_SITE_BRANCH);
+} /* opt_add_loop_break() */
+
+/*-------------------------------------------------------------------------*/
+static opt_frame_t *
+opt_push_frame (void)
+
+/* A new statement with its own control flow (or an inline closure)
+ * begins: push and return a new frame. The code inside of course isn't
+ * dead just because the code around it is.
+ */
+
+{
+    static opt_frame_t dummy;
+    opt_frame_t *frame;
+
+    if (opt_frame_depth >= COMPILER_STACK_SIZE)
+    {
+        if (opt_frame_depth == COMPILER_STACK_SIZE)
+            yyerror("Compiler stack overflow");
+        opt_frame_depth++;
+        frame = &dummy;
+    }
+    else
+        frame = opt_frames + opt_frame_depth++;
+
+    frame->dead = opt_dead;
+    frame->propagate = opt_propagate;
+    frame->cond = OPT_COND_NORMAL;
+    frame->mark.pc = -1;
+    frame->else_start = -1;
+    frame->ends = MY_FALSE;
+    frame->hoist_local = -1;
+    frame->hoist_temp = -1;
+
+    opt_dead.pc = -1;
+
+    return frame;
+} /* opt_push_frame() */
+
+/*-------------------------------------------------------------------------*/
+static opt_frame_t *
+opt_top_frame (void)
+
+/* Return the innermost frame.
+ */
+
+{
+    static opt_frame_t dummy;
+
+    if (opt_frame_depth < 1 || opt_frame_depth > COMPILER_STACK_SIZE)
+    {
+        dummy.dead.pc = -1;
+        dummy.propagate = MY_FALSE;
+        dummy.cond = OPT_COND_NORMAL;
+        dummy.mark.pc = -1;
+        dummy.else_start = -1;
+        dummy.ends = MY_FALSE;
+        dummy.hoist_local = -1;
+        dummy.hoist_temp = -1;
+        return &dummy;
+    }
+    return opt_frames + opt_frame_depth - 1;
+} /* opt_top_frame() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_pop_frame (void)
+
+/* The statement of the innermost frame is complete: pop the frame.
+ */
+
+{
+    opt_frame_t *frame = opt_top_frame();
+
+    opt_dead = frame->dead;
+    opt_propagate = frame->propagate;
+    if (frame->hoist_temp >= 0)
+        opt_temps_in_use--;
+    if (opt_frame_depth > 0)
+        opt_frame_depth--;
+} /* opt_pop_frame() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_mark_dead (void)
+
+/* The code generated next is unreachable (after a return, break or
+ * continue).
+ */
+
+{
+    if (opt_enabled() && opt_dead.pc < 0)
+        opt_set_mark(&opt_dead);
+} /* opt_mark_dead() */
+
+/*-------------------------------------------------------------------------*/
+static INLINE Bool
+opt_unreachable (void)
+
+/* Return TRUE if the code generated next is never executed. Jumps in
+ * such code can be left out.
+ */
+
+{
+    return opt_enabled() && opt_dead.pc >= 0;
+} /* opt_unreachable() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_jump_target (void)
+
+/* The code generated next is the target of a jump (else part, case
+ * label): it is reachable, and nothing is known about the locals.
+ */
+
+{
+    opt_dead.pc = -1;
+    opt_forget_all();
+} /* opt_jump_target() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_statement_end (void)
+
+/* A statement is complete: if it is unreachable, remove it.
+ */
+
+{
+    if (opt_dead.pc >= 0 && CURRENT_PROGRAM_SIZE > opt_dead.pc)
+        (void)opt_truncate(&opt_dead);
+} /* opt_statement_end() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_constant_value (p_int start, p_int end, p_int *value)
+
+/* If the code in [<start>..<end>[ is one instruction pushing a constant
+ * number, or the value of a local with a known value, return TRUE and
+ * the number in *<value>.
+ */
+
+{
+    bytecode_p p = PROGRAM_BLOCK + start;
+
+    if (start < 0 || end <= start || end > CURRENT_PROGRAM_SIZE)
+        return MY_FALSE;
+
+    switch (end - start)
+    {
+    case 1:
+        switch (*p)
+        {
+        case F_CONST0:  *value = 0;  return MY_TRUE;
+        case F_CONST1:  *value = 1;  return MY_TRUE;
+        case F_NCONST1: *value = -1; return MY_TRUE;
+        }
+        break;
+
+    case 2:
+        switch (*p)
+        {
+        case F_CLIT:
+            *value = p[1];
+            return MY_TRUE;
+
+        case F_NCLIT:
+            *value = -(p_int)p[1];
+            return MY_TRUE;
+
+        case F_LOCAL:
+            if (opt_propagate && p[1] < MAX_LOCAL && opt_locals[p[1]].known)
+            {
+                *value = opt_locals[p[1]].value;
+                return MY_TRUE;
+            }
+            break;
+        }
+        break;
+
+    case 1 + sizeof(p_int):
+        if (*p == F_NUMBER)
+        {
+            *value = read_p_int(start + 1);
+            return MY_TRUE;
+        }
+        break;
+    }
+
+    return MY_FALSE;
+} /* opt_constant_value() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_fold_binary (int instruction, p_int left_start, p_int right_start)
+
+/* The code for both operands of the binary operator <instruction> was
+ * just generated at <left_start> resp. <right_start>. If both are constant
+ * and the operation can't raise an error, replace the code by the result
+ * and return TRUE.
+ */
+
+{
+    p_int a, b, res;
+
+    if (!opt_fold_enabled() || !opt_can_remove(left_start)
+     || !opt_constant_value(left_start, right_start, &a)
+     || !opt_constant_value(right_start, CURRENT_PROGRAM_SIZE, &b))
+        return MY_FALSE;
+
+    switch (instruction)
+    {
+    case F_ADD:
+        if ((b > 0 && a > PINT_MAX - b) || (b < 0 && a < PINT_MIN - b))
+            return MY_FALSE;
+        res = a + b;
+        break;
+
+    case F_SUBTRACT:
+        if ((b < 0 && a > PINT_MAX + b) || (b > 0 && a < PINT_MIN + b))
+            return MY_FALSE;
+        res = a - b;
+        break;
+
+    case F_MULTIPLY:
+      {
+        p_int abs_a = a < 0 ? -a : a;
+        p_int abs_b = b < 0 ? -b : b;
+
+        if (a == PINT_MIN || b == PINT_MIN
+         || (abs_a != 0 && abs_b > PINT_MAX / abs_a))
+            return MY_FALSE;
+        res = a * b;
+        break;
+      }
+
+    case F_DIVIDE:
+        if (b == 0 || b == -1)
+            return MY_FALSE;
+        res = a / b;
+        break;
+
+    case F_MOD:
+        if (b == 0 || b == -1)
+            return MY_FALSE;
+        res = a % b;
+        break;
+
+    case F_AND: res = a & b;  break;
+    case F_OR:  res = a | b;  break;
+    case F_XOR: res = a ^ b;  break;
+    case F_EQ:  res = a == b; break;
+    case F_NE:  res = a != b; break;
+    case F_LT:  res = a < b;  break;
+    case F_LE:  res = a <= b; break;
+    case F_GT:  res = a > b;  break;
+    case F_GE:  res = a >= b; break;
+
+    default:
+        return MY_FALSE;
+    }
+
+    CURRENT_PROGRAM_SIZE = left_start;
+    ins_number(res);
+    last_expression = left_start;
+    return MY_TRUE;
+} /* opt_fold_binary() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_fold_unary (int instruction, p_int start)
+
+/* The code for the operand of the unary operator <instruction> was just
+ * generated at <start>. If it is constant, replace the code by the
+ * result and return TRUE.
+ */
+
+{
+    p_int a, res;
+
+    if (!opt_fold_enabled() || !opt_can_remove(start)
+     || !opt_constant_value(start, CURRENT_PROGRAM_SIZE, &a))
+        return MY_FALSE;
+
+    switch (instruction)
+    {
+    case F_NOT:   res = !a; break;
+    case F_COMPL: res = ~a; break;
+
+    default:
+        return MY_FALSE;
+    }
+
+    CURRENT_PROGRAM_SIZE = start;
+    ins_number(res);
+    last_expression = start;
+    return MY_TRUE;
+} /* opt_fold_unary() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_assignment (p_int start)
+
+/* A statement (or initialization of a local) assigning a value was
+ * just completed, its code starts at <start>. If it assigns a constant to
+ * a local, remember the value. If the local is known to hold this value
+ * already, remove the assignment.
+ */
+
+{
+    bytecode_p p = PROGRAM_BLOCK + CURRENT_PROGRAM_SIZE;
+    p_int value;
+    int num;
+
+    if (!opt_enabled() || !opt_propagate
+     || CURRENT_PROGRAM_SIZE - start < 4
+     || p[-1] != F_VOID_ASSIGN || p[-3] != F_PUSH_LOCAL_VARIABLE_LVALUE
+     || !opt_constant_value(start, CURRENT_PROGRAM_SIZE - 3, &value))
+        return;
+
+    num = p[-2];
+    if (num < def_function_num_args || num >= MAX_LOCAL
+     || opt_locals[num].escaped)
+        return;
+
+    if (opt_locals[num].known && opt_locals[num].value == value
+     && opt_can_remove(start))
+    {
+        CURRENT_PROGRAM_SIZE = start;
+        last_expression = -1;
+        return;
+    }
+
+    opt_locals[num].value = value;
+    opt_locals[num].known = MY_TRUE;
+} /* opt_assignment() */
+
+/*-------------------------------------------------------------------------*/
+static int
+opt_condition (p_int start)
+
+/* The condition of an if() was just compiled at <start>. If it is
+ * constant, remove its code and return OPT_COND_TRUE resp. OPT_COND_FALSE,
+ * otherwise return OPT_COND_NORMAL.
+ */
+
+{
+    p_int value;
+
+    if (!opt_enabled() || !opt_can_remove(start)
+     || !opt_constant_value(start, CURRENT_PROGRAM_SIZE, &value))
+        return OPT_COND_NORMAL;
+
+    CURRENT_PROGRAM_SIZE = start;
+    last_expression = -1;
+    return value ? OPT_COND_TRUE : OPT_COND_FALSE;
+} /* opt_condition() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_endless_loop (p_int start)
+
+/* Return TRUE if the loop condition compiled at <start> is always true.
+ */
+
+{
+    return opt_enabled()
+        && CURRENT_PROGRAM_SIZE == start + 1
+        && PROGRAM_BLOCK[start] == F_CONST1;
+} /* opt_endless_loop() */
+
+/*-------------------------------------------------------------------------*/
+static Bool
+opt_is_sizeof_local (p_int pos, int *num)
+
+/* Return TRUE if the code at <pos> is 'local <num>; sizeof' for a local
+ * whose size can't change unless it's assigned to, and set *<num>.
+ */
+
+{
+    bytecode_p p = PROGRAM_BLOCK + pos;
+    lpctype_t *type;
+    int n;
+
+    if (p[0] != F_LOCAL)
+        return MY_FALSE;
+    p += 2;
+    if (instrs[F_SIZEOF].prefix && *p++ != instrs[F_SIZEOF].prefix)
+        return MY_FALSE;
+    if (*p != instrs[F_SIZEOF].opcode)
+        return MY_FALSE;
+
+    n = PROGRAM_BLOCK[pos+1];
+    if (n < def_function_num_args || n >= MAX_LOCAL
+     || opt_locals[n].escaped)
+        return MY_FALSE;
+
+    /* Only arrays and strings are immutable in their size. */
+    type = type_of_locals[n].t_type;
+    if (type == NULL
+     || (type != lpctype_string && type->t_class != TCLASS_ARRAY))
+        return MY_FALSE;
+
+    *num = n;
+    return MY_TRUE;
+} /* opt_is_sizeof_local() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_loop_condition (opt_frame_t *frame, p_int start)
+
+/* The condition of a while() or for() loop of <frame> was just compiled
+ * at <start>. Check if it compares a simple value with the size
+ * of a local array or string, and if yes, note the local in <frame>.
+ */
+
+{
+    p_int length = CURRENT_PROGRAM_SIZE - start;
+    p_int sizeof_length = 3 + (instrs[F_SIZEOF].prefix ? 1 : 0);
+    bytecode_p p = PROGRAM_BLOCK + start;
+    int num, offset;
+
+    if (!opt_enabled() || !opt_propagate || !exact_types
+     || MAX_LOCAL + OPT_MAX_TEMPS > 0xff
+     || opt_temps_in_use >= OPT_MAX_TEMPS
+     || opt_num_sites + 1 >= OPT_MAX_SITES - OPT_MAX_TEMPS
+     || length != 2 + sizeof_length + 1)
+        return;
+
+    switch (p[length-1])
+    {
+    case F_LT: case F_LE: case F_GT: case F_GE: case F_EQ: case F_NE:
+        break;
+    default:
+        return;
+    }
+
+    /* The other operand must be a single instruction without
+     * side effects.
+     */
+    if (opt_is_sizeof_local(start, &num))
+        offset = 0;
+    else if (opt_is_sizeof_local(start + 2, &num))
+        offset = 2;
+    else
+        return;
+
+    switch (p[offset ? 0 : sizeof_length])
+    {
+    case F_LOCAL: case F_IDENTIFIER: case F_CLIT:
+        break;
+    default:
+        return;
+    }
+
+    frame->hoist_local = num;
+    frame->hoist_offset = offset;
+    frame->hoist_len = sizeof_length + 3;
+} /* opt_loop_condition() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_loop_preheader (opt_frame_t *frame)
+
+/* If the loop of <frame> has a sizeof() to hoist, compute it into
+ * a hidden local before the loop.
+ */
+
+{
+    if (frame->hoist_local < 0)
+        return;
+
+    frame->hoist_temp = opt_temps_in_use++;
+    if (opt_temps_in_use > opt_num_temps)
+        opt_num_temps = opt_temps_in_use;
+
+    frame->hoist_pos = CURRENT_PROGRAM_SIZE;
+    ins_f_code(F_LOCAL);
+    ins_byte(frame->hoist_local);
+    ins_f_code(F_SIZEOF);
+    ins_f_code(F_PUSH_LOCAL_VARIABLE_LVALUE);
+    (void)opt_add_site(CURRENT_PROGRAM_SIZE, OPT_SITE_TEMP);
+    ins_byte(frame->hoist_temp);
+    ins_f_code(F_VOID_ASSIGN);
+    last_expression = -1;
+} /* opt_loop_preheader() */
+
+/*-------------------------------------------------------------------------*/
+static p_int
+opt_loop_end (opt_frame_t *frame, bytecode_p cond, p_int *length)
+
+/* The body of the loop of <frame> is complete, its condition code of
+ * *<length> bytes is held in <cond> (plus the two bytes of the
+ * final branch). If the hoisted local wasn't assigned to in the loop,
+ * make the condition use the hidden local and return the offset of its
+ * index byte in <cond>, which the caller has to note as OPT_SITE_TEMP.
+ * Otherwise skip the preheader code and return -1.
+ */
+
+{
+    p_int pos;
+    int num = frame->hoist_local;
+    Bool assigned = opt_locals[num].escaped || !opt_propagate;
+    p_int sizeof_length = frame->hoist_len - 3;
+
+    if (num < 0)
+        return -1;
+
+    for (pos = frame->hoist_pos + frame->hoist_len
+        ; !assigned && pos < CURRENT_PROGRAM_SIZE - 1
+        ; pos++)
+    {
+        if ((PROGRAM_BLOCK[pos] == F_PUSH_LOCAL_VARIABLE_LVALUE
+          || PROGRAM_BLOCK[pos] == F_INC_LOCAL)
+         && PROGRAM_BLOCK[pos+1] == num)
+            assigned = MY_TRUE;
+    }
+
+    if (assigned)
+    {
+        /* Just jump over the preheader */
+        PROGRAM_BLOCK[frame->hoist_pos] = F_BRANCH;
+        PROGRAM_BLOCK[frame->hoist_pos+1] = frame->hoist_len - 2;
+        return -1;
+    }
+
+    /* Replace 'local <num>; sizeof' by 'local <temp>' */
+    pos = frame->hoist_offset;
+    cond[pos+1] = frame->hoist_temp;
+    memmove(cond + pos + 2, cond + pos + sizeof_length
+           , *length + 2 - pos - sizeof_length);
+    *length -= sizeof_length - 2;
+
+    /* Both operands are locals now */
+    if (cond[0] == F_LOCAL && cond[2] == F_LOCAL)
+        cond[0] = cond[4] == F_LT ? F_LOCAL_LT : F_LOCAL_LOCAL;
+
+    return pos + 1;
+} /* opt_loop_end() */
+
+/*-------------------------------------------------------------------------*/
+static p_int
+opt_branch_target (p_int pos)
+
+/* Return the destination of the branch instruction at <pos>, or -1 if
+ * there is no branch.
+ */
+
+{
+    bytecode_p p = PROGRAM_BLOCK + pos;
+
+    switch (*p)
+    {
+    case F_BRANCH:
+    case F_BRANCH_WHEN_ZERO:
+    case F_BRANCH_WHEN_NON_ZERO:
+        return pos + 2 + p[1];
+
+    case F_BBRANCH_WHEN_ZERO:
+    case F_BBRANCH_WHEN_NON_ZERO:
+        return pos + 1 - p[1];
+
+    case F_LBRANCH:
+    case F_LBRANCH_WHEN_ZERO:
+    case F_LBRANCH_WHEN_NON_ZERO:
+        return pos + 1 + read_short(pos + 1);
+
+    case F_FBRANCH:
+        return pos + 1 + read_jump_offset(pos + 1);
+    }
+
+    return -1;
+} /* opt_branch_target() */
+
+/*-------------------------------------------------------------------------*/
+static void
+opt_thread_branch (p_int pos, p_int start)
+
+/* Thread the branch at <pos> of the function with the code at <start>:
+ * if it jumps to unconditional jumps, jump directly to their final
+ * destination if the branch can reach it. An unconditional jump
+ * to a RETURN0 is replaced by the RETURN0.
+ */
+
+{
+    bytecode_t code = PROGRAM_BLOCK[pos];
+    p_int dest, next, offset;
+    Bool unconditional;
+    int hops;
+
+    unconditional = (code == F_BRANCH || code == F_LBRANCH
+                  || code == F_FBRANCH);
+    dest = opt_branch_target(pos);
+    if (dest < start || dest >= CURRENT_PROGRAM_SIZE)
+        return;
 
-    last_expression = -1;
+    for (hops = 0; hops < OPT_MAX_HOPS; hops++)
+    {
+        code = PROGRAM_BLOCK[dest];
+        if (code != F_BRANCH && code != F_LBRANCH && code != F_FBRANCH)
+            break;
+        next = opt_branch_target(dest);
+        if (next < start || next >= CURRENT_PROGRAM_SIZE
+         || next == dest || next == pos)
+            break;
+        dest = next;
+    }
 
-    offset = mem_block[A_PROGRAM].current_size - ( address + 1);
-    if (offset > 0xff)
+    if (unconditional && PROGRAM_BLOCK[dest] == F_RETURN0)
     {
-        /* A long branch is needed */
+        PROGRAM_BLOCK[pos] = F_RETURN0;
+        return;
+    }
 
-        int i;
-        bytecode_p p;
+    if (dest == opt_branch_target(pos))
+        return;
 
-        ins_short(0);
-        ins_byte(0);
-        p = PROGRAM_BLOCK + mem_block[A_PROGRAM].current_size-1;
-        for (i = offset; --i >= 0; --p )
-            *p = p[-3];
-        p[-4] = F_DUP;
-        p[-3] = instruction;
-        upd_short(address+1, offset+3);
-        if (offset > 0x7ffc)
-            yyerrorf("Compiler limit: Too much code to skip for ||/&&:"
-                     " %"PRIdPINT" bytes" , offset);
-        p[0]  = F_POP_VALUE;
-    }
-    else
+    switch (PROGRAM_BLOCK[pos])
     {
-        mem_block[A_PROGRAM].block[address] = offset;
+    case F_BRANCH:
+    case F_BRANCH_WHEN_ZERO:
+    case F_BRANCH_WHEN_NON_ZERO:
+        offset = dest - (pos + 2);
+        if (offset >= 0 && offset <= 0xff)
+            PROGRAM_BLOCK[pos+1] = offset;
+        break;
+
+    case F_LBRANCH:
+    case F_LBRANCH_WHEN_ZERO:
+    case F_LBRANCH_WHEN_NON_ZERO:
+        offset = dest - (pos + 1);
+        if (offset >= SHRT_MIN && offset <= SHRT_MAX)
+            upd_short(pos + 1, offset);
+        break;
+
+    case F_FBRANCH:
+        upd_jump_offset(pos + 1, dest - (pos + 1));
+        break;
     }
-} /* update_lop_branch() */
+} /* opt_thread_branch() */
 
 /*-------------------------------------------------------------------------*/
 static void
-shuffle_code (p_uint start1, p_uint start2, p_uint end)
+opt_end_function (p_int start, int num_locals)
 
-/* Reverse the order of the program blocks [start1..start2[ and [start2..end[
+/* The code of the function at <start> is complete, with <num_locals>
+ * locals (including the arguments). Give the hidden locals their
+ * indices behind the normal locals, and thread the branches.
  */
 
 {
-    p_uint len1 = start2 - start1;
-    p_uint len2 = end - start2;
-
-    bytecode_p pStart1 = PROGRAM_BLOCK + start1;
-    bytecode_p pStart2 = PROGRAM_BLOCK + start2;
-
-    bytecode_p * pTmp;
-
-    if (!len1 || !len2)
-        return;
+    int i, j;
 
-    pTmp = xalloc(len1);
-    if (!pTmp)
+    for (i = j = 0; i < opt_num_sites; i++)
     {
-        yyerror("(shuffle_code) Out of memory");
-        return;
+        opt_site_t *site = opt_sites + i;
+
+        if (site->pos < start)
+            opt_sites[j++] = *site;
+        else if (site->kind == OPT_SITE_TEMP)
+            PROGRAM_BLOCK[site->pos] += num_locals;
+        else if (opt_enabled())
+            opt_thread_branch(site->pos, start);
     }
-    memmove(pTmp, pStart1, len1);
-    memmove(pStart1, pStart2, len2);
-    memmove(pStart1+len2, pTmp, len1);
-    xfree(pTmp);
-} /* shuffle_code() */
+    opt_num_sites = j;
+} /* opt_end_function() */
 
 /* ========================   LOCALS and SCOPES   ======================== */
 
@@ -4770,6 +5886,10 @@ def_function_complete ( p_int body_start, Bool is_inline)
         int num_vars = max_number_of_locals - num_args
                                             + max_break_stack_need;
 
+        /* Make room for the hidden locals of the optimizer */
+        if (!is_inline)
+            num_vars += opt_num_temps;
+
         define_new_function(MY_TRUE, ident
                             , num_args
                             , num_vars
@@ -4777,7 +5897,11 @@ def_function_complete ( p_int body_start, Bool is_inline)
                             , 0, returntype);
 
         /* Catch a missing return if the function has a return type */
-        if (returntype.t_type != lpctype_void
+        if (opt_unreachable())
+        {
+            /* The end of the code isn't reached, no return needed */
+        }
+        else if (returntype.t_type != lpctype_void
          && (   returntype.t_type != lpctype_unknown
              || pragma_strict_types
             )
@@ -4821,6 +5945,8 @@ def_function_complete ( p_int body_start, Bool is_inline)
         {
             ins_f_code(F_RETURN0);
         }
+
+        opt_end_function(body_start, max_number_of_locals);
     }
 
     /* Clean up for normal functions.
@@ -4836,6 +5962,7 @@ def_function_complete ( p_int body_start, Bool is_inline)
     {
         free_all_local_names();
         block_depth = 0;
+        opt_active = opt_propagate = MY_FALSE;
     }
 
 } /* def_function_complete() */
@@ -5657,6 +6784,12 @@ printf("DEBUG:   type ptrs: %p, %p\n",
     /* Add the structure to the memblock */
     ADD_INLINE_CLOSURE(&ict);
     current_inline = &(INLINE_CLOSURE(INLINE_CLOSURE_COUNT-1));
+
+    /* The closure has its own locals, and its code will be moved. */
+    (void)opt_push_frame();
+    opt_propagate = MY_FALSE;
+    opt_forget_all();
+    opt_barrier++;
 } /* new_inline_closure() */
 
 /*-------------------------------------------------------------------------*/
@@ -5696,6 +6829,10 @@ printf("DEBUG:   depth %d, locals: %d/%d, break: %d/%d\n",
     length = current_inline->length;
     end = current_inline->end;
 
+    opt_drop_sites(end);
+    opt_pop_frame();
+    opt_barrier++;
+
     if (!bAbort)
     {
         backup_start = INLINE_PROGRAM_SIZE;
@@ -6790,6 +7927,7 @@ function_body:
                       , mem_block[A_PROGRAM].current_size + FUNCTION_HDR_SIZE);
               YYACCEPT;
           }
+          opt_begin_function();
       }
 
       block
@@ -7890,8 +9028,12 @@ statements_block:
 
 statements:
       /* empty */
-    | statements local_name_list ';' { free_lpctype($2); }
-    | statements statement
+    | statements local_name_list ';'
+      {
+          free_lpctype($2);
+          opt_statement_end();
+      }
+    | statements statement { opt_statement_end(); }
 ;
 
 
@@ -7916,7 +9058,7 @@ local_name_list:
       }
       L_ASSIGN expr0
       {
-          init_local_variable($2, &$<lvalue>3, $4, $5.type);
+          init_local_variable($2, &$<lvalue>3, $4, $5.type, $5.start);
 
           free_fulltype($5.type);
           $$ = $1;
@@ -7927,7 +9069,7 @@ local_name_list:
       }
       L_ASSIGN expr0
       {
-          init_local_variable($2, &$<lvalue>3, $4, $5.type);
+          init_local_variable($2, &$<lvalue>3, $4, $5.type, $5.start);
 
           free_fulltype($5.type);
           $$ = $1;
@@ -7958,7 +9100,7 @@ local_name_list:
       }
       L_ASSIGN expr0
       {
-          init_local_variable($4, &$<lvalue>5, $6, $7.type);
+          init_local_variable($4, &$<lvalue>5, $6, $7.type, $7.start);
 
           free_fulltype($7.type);
           $$ = $1;
@@ -7971,7 +9113,7 @@ local_name_list:
       }
       L_ASSIGN expr0
       {
-          init_local_variable($4, &$<lvalue>5, $6, $7.type);
+          init_local_variable($4, &$<lvalue>5, $6, $7.type, $7.start);
 
           free_fulltype($7.type);
           $$ = $1;
@@ -7983,6 +9125,7 @@ statement:
       comma_expr ';'
       {
           insert_pop_value();
+          opt_assignment($1.start);
 #ifdef F_BREAK_POINT
           if (d_flag)
               ins_f_code(F_BREAK_POINT);
@@ -8004,7 +9147,11 @@ statement:
           if (current_break_address == 0)
               yyerror("break statement outside loop");
 
-          if (current_break_address & BREAK_ON_STACK)
+          if (opt_unreachable())
+          {
+              /* No jump needed where the code isn't reached anyway */
+          }
+          else if (current_break_address & BREAK_ON_STACK)
           {
               /* We break from a switch() */
 
@@ -8021,6 +9168,7 @@ statement:
                   yyerrorf("Compiler limit: (L_BREAK) value too large: %"PRIdBcOffset
                           , current_break_address);
           }
+          opt_mark_dead();
       }
 
     | L_CONTINUE ';'        /* This code is a jump */
@@ -8030,6 +9178,10 @@ statement:
           if (current_continue_address == 0)
               yyerror("continue statement outside loop");
 
+          /* No jump needed where the code isn't reached anyway */
+          if (opt_unreachable())
+              break;
+
           if ( 0 != (depth = (current_continue_address & SWITCH_DEPTH_MASK)) )
           {
               /* A continue inside a switch */
@@ -8068,6 +9220,7 @@ statement:
           current_continue_address =
                         ( current_continue_address & SWITCH_DEPTH_MASK ) |
                         ( CURRENT_PROGRAM_SIZE - sizeof(int32) );
+          opt_mark_dead();
       }
 ; /* statement */
 
@@ -8079,6 +9232,7 @@ return:
               lpctype_error("Must return a value for a function declared",
                          exact_types);
           ins_f_code(F_RETURN0);
+          opt_mark_dead();
       }
 
     | L_RETURN comma_expr
@@ -8117,6 +9271,7 @@ return:
           }
           else
               ins_f_code(F_RETURN);
+          opt_mark_dead();
 
           free_fulltype($2.type);
       }
@@ -8141,6 +9296,9 @@ while:
           $<numbers>$[1] = current_break_address;
 
           push_address(); /* Remember the starting address */
+
+          /* The condition is executed after the body */
+          opt_forget_all();
       }
 
       L_WHILE '(' comma_expr ')'
@@ -8150,6 +9308,22 @@ while:
           p_int addr = pop_address();
           p_int length = CURRENT_PROGRAM_SIZE - addr;
           bytecode_p expression;
+          opt_frame_t *frame = opt_push_frame();
+
+          if (opt_endless_loop(addr))
+          {
+              /* 'while(1)': just jump back to the start of the body */
+              $<expression>$.p = NULL;
+              CURRENT_PROGRAM_SIZE = addr;
+              last_expression = -1;
+              push_address();
+
+              current_continue_address = CONTINUE_DELIMITER;
+              current_break_address = BREAK_DELIMITER;
+              break;
+          }
+
+          opt_loop_condition(frame, addr);
 
           /* Take the <cond> code, add the BBRANCH instruction and
            * store all of it outside the program. After the <body>
@@ -8184,6 +9358,8 @@ while:
           CURRENT_PROGRAM_SIZE = addr;
           last_expression = -1;
 
+          opt_loop_preheader(frame);
+
           /* The initial branch to the condition code */
           ins_f_code(F_BRANCH);
           push_address();
@@ -8191,6 +9367,7 @@ while:
 
           current_continue_address = CONTINUE_DELIMITER;
           current_break_address = BREAK_DELIMITER;
+          opt_forget_all();
       }
 
       statement
@@ -8204,6 +9381,7 @@ while:
           p_int offset;
           bc_offset_t next_addr;
           p_int addr = pop_address();
+          p_int length, temp;
 
           /* Update the offsets of all continue BRANCHes
            * (resp BREAK_CONTINUEs) to branch to the current address.
@@ -8216,40 +9394,57 @@ while:
                   CURRENT_PROGRAM_SIZE - current_continue_address);
           }
 
-          /* If necessary, update the leading BRANCH to an LBRANCH */
-          offset = fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, addr);
-
-          /* Add the condition code to the program */
-          if ($<expression>6.line != current_loc.line)
-              store_line_number_info();
-          add_to_mem_block(A_PROGRAM, $<expression>6.p, $<expression>6.length+2);
-          yfree($<expression>6.p);
-
-          /* Complete the branch at the end of the condition code */
-          offset += addr + 1 - ( CURRENT_PROGRAM_SIZE - 1 );
-          if (offset < -0xff)
+          if ($<expression>6.p == NULL)
           {
-              /* We need a LBRANCH instead of the BBRANCH */
-
-              bytecode_p codep;
-
+              /* Endless loop: jump back to the start of the body */
+              offset = addr - (CURRENT_PROGRAM_SIZE + 1);
               if (offset < -0x8000)
                   yyerror("offset overflow");
-              codep = PROGRAM_BLOCK + --CURRENT_PROGRAM_SIZE - 1;
-              *codep = *codep == F_BBRANCH_WHEN_NON_ZERO
-                       ? F_LBRANCH_WHEN_NON_ZERO
-                       : F_LBRANCH_WHEN_ZERO
-              ;
+              ins_f_code(F_LBRANCH);
               ins_short(offset);
           }
           else
           {
-              /* Just add the short offset */
-              mem_block[A_PROGRAM].block[CURRENT_PROGRAM_SIZE-1] = -offset;
-          }
+              length = $<expression>6.length;
+              temp = opt_loop_end(opt_top_frame(), $<expression>6.p, &length);
+
+              /* If necessary, update the leading BRANCH to an LBRANCH */
+              offset = fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, addr);
+
+              /* Add the condition code to the program */
+              if ($<expression>6.line != current_loc.line)
+                  store_line_number_info();
+              if (temp >= 0)
+                  (void)opt_add_site(CURRENT_PROGRAM_SIZE + temp, OPT_SITE_TEMP);
+              add_to_mem_block(A_PROGRAM, $<expression>6.p, length+2);
+              yfree($<expression>6.p);
+
+              /* Complete the branch at the end of the condition code */
+              offset += addr + 1 - ( CURRENT_PROGRAM_SIZE - 1 );
+              if (offset < -0xff)
+              {
+                  /* We need a LBRANCH instead of the BBRANCH */
+
+                  bytecode_p codep;
 
-          if ($<expression>6.line != current_loc.line)
-              store_line_number_relocation($<expression>6.line);
+                  if (offset < -0x8000)
+                      yyerror("offset overflow");
+                  codep = PROGRAM_BLOCK + --CURRENT_PROGRAM_SIZE - 1;
+                  *codep = *codep == F_BBRANCH_WHEN_NON_ZERO
+                           ? F_LBRANCH_WHEN_NON_ZERO
+                           : F_LBRANCH_WHEN_ZERO
+                  ;
+                  ins_short(offset);
+              }
+              else
+              {
+                  /* Just add the short offset */
+                  mem_block[A_PROGRAM].block[CURRENT_PROGRAM_SIZE-1] = -offset;
+              }
+
+              if ($<expression>6.line != current_loc.line)
+                  store_line_number_relocation($<expression>6.line);
+          }
 
           /* Now that we have the end of the while(), we can finish
            * up the breaks.
@@ -8260,11 +9455,14 @@ while:
               next_addr = read_jump_offset(current_break_address);
               upd_jump_offset(current_break_address,
                   CURRENT_PROGRAM_SIZE - current_break_address);
+              opt_add_loop_break(current_break_address);
           }
 
           /* Restore the previous environment */
           current_continue_address = $<numbers>1[0];
           current_break_address    = $<numbers>1[1];
+          opt_pop_frame();
+          opt_forget_all();
 
           free_fulltype($4.type);
       }
@@ -8290,6 +9488,8 @@ do:
           current_continue_address = CONTINUE_DELIMITER;
 
           push_address(); /* Address to branch back to */
+          (void)opt_push_frame();
+          opt_forget_all();
       }
 
       L_DO statement L_WHILE
@@ -8310,6 +9510,9 @@ do:
               upd_jump_offset(current_continue_address,
                   current - current_continue_address);
           }
+
+          /* The condition is reachable by continue */
+          opt_jump_target();
       }
 
       '(' comma_expr ')' ';'
@@ -8335,7 +9538,24 @@ do:
 
           /* Add the branch statement */
           dest = PROGRAM_BLOCK + current;
-          if (current == last_expression + 1 && dest[-1] == F_NOT)
+          if (opt_enabled() && $7.start == current - 1
+           && dest[-1] == F_CONST1)
+          {
+              /* 'while(1)': branch back unconditionally */
+              offset = addr - current;
+              if (offset < -0x8000)
+                  yyerror("offset overflow");
+              PUT_CODE(dest-1, F_LBRANCH);
+              PUT_SHORT(dest, offset);
+              current += 2;
+          }
+          else if (opt_enabled() && $7.start == current - 1
+           && dest[-1] == F_CONST0 && opt_can_remove(current - 1))
+          {
+              /* 'while(0)': no branch at all */
+              current--;
+          }
+          else if (current == last_expression + 1 && dest[-1] == F_NOT)
           {
               /* Optimize 'NOT BBRANCH_WHEN_NON_ZERO' to 'BBRANCH_WHEN_ZERO'
                */
@@ -8382,11 +9602,14 @@ do:
               next_addr = read_jump_offset(current_break_address);
               upd_jump_offset(current_break_address,
                   current - current_break_address);
+              opt_add_loop_break(current_break_address);
           }
 
           /* Restore the previous environment */
           current_continue_address = $<numbers>1[0];
           current_break_address    = $<numbers>1[1];
+          opt_pop_frame();
+          opt_forget_all();
 
           free_fulltype($7.type);
       }
@@ -8434,6 +9657,9 @@ for:
 
           current_continue_address = CONTINUE_DELIMITER;
           $<number>$ = CURRENT_PROGRAM_SIZE;
+
+          /* The condition is executed after the body */
+          opt_forget_all();
       }
 
       for_expr ';'
@@ -8447,8 +9673,23 @@ for:
 
           p_int start, length;
           bytecode_p expression;
+          opt_frame_t *frame = opt_push_frame();
 
           start = $<number>6;
+
+          if (opt_endless_loop(start))
+          {
+              /* 'for(;;)': no condition code needed */
+              $<expression>$.p = NULL;
+              $<expression>$.length = 0;
+              $<expression>$.line = current_loc.line;
+              CURRENT_PROGRAM_SIZE = start;
+              last_expression = -1;
+              break;
+          }
+
+          opt_loop_condition(frame, start);
+
           length = CURRENT_PROGRAM_SIZE - start;
           expression = yalloc(length+2);
           memcpy(expression, mem_block[A_PROGRAM].block + start, length );
@@ -8506,8 +9747,15 @@ for:
           last_expression = -1;
           current_break_address = BREAK_DELIMITER;
 
-          ins_f_code(F_BRANCH); /* over the body to the condition */
-          ins_byte(0);
+          if ($<expression>9.p != NULL)
+          {
+              opt_loop_preheader(opt_top_frame());
+              $<number>6 = CURRENT_PROGRAM_SIZE;
+
+              ins_f_code(F_BRANCH); /* over the body to the condition */
+              ins_byte(0);
+          }
+          opt_forget_all();
 
           /* Fix the number of locals to clear, now that we know it
            */
@@ -8531,7 +9779,7 @@ for:
            * the break and continues.
            */
 
-          p_int offset;
+          p_int offset, length, temp;
           bc_offset_t next_addr;
 
           /* Patch up the continues */
@@ -8559,37 +9807,54 @@ for:
           }
           yfree($<expression>12.p);
 
-          /* Fix the branch over the body */
-          offset =
-            fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, $<number>6 + 1);
-
-          /* Add the <cond> code block */
-          add_to_mem_block(A_PROGRAM, $<expression>9.p, $<expression>9.length+2);
-          yfree($<expression>9.p);
-
-          /* Create the branch back after the condition */
-          offset += $<number>6 + 2 - ( CURRENT_PROGRAM_SIZE - 1 );
-          if (offset < -0xff)
+          if ($<expression>9.p == NULL)
           {
-              bytecode_p codep;
-
+              /* Endless loop: jump back to the start of the body */
+              offset = $<number>6 - (CURRENT_PROGRAM_SIZE + 1);
               if (offset < -0x8000)
                   yyerror("offset overflow");
-
-              codep = PROGRAM_BLOCK + --CURRENT_PROGRAM_SIZE - 1;
-              *codep = *codep == F_BBRANCH_WHEN_NON_ZERO
-                       ? F_LBRANCH_WHEN_NON_ZERO
-                       : F_LBRANCH_WHEN_ZERO
-              ;
+              ins_f_code(F_LBRANCH);
               ins_short(offset);
           }
           else
           {
-              mem_block[A_PROGRAM].block[CURRENT_PROGRAM_SIZE-1] = -offset;
-          }
+              length = $<expression>9.length;
+              temp = opt_loop_end(opt_top_frame(), $<expression>9.p, &length);
+
+              /* Fix the branch over the body */
+              offset =
+                fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, $<number>6 + 1);
+
+              /* Add the <cond> code block */
+              if (temp >= 0)
+                  (void)opt_add_site(CURRENT_PROGRAM_SIZE + temp, OPT_SITE_TEMP);
+              add_to_mem_block(A_PROGRAM, $<expression>9.p, length+2);
+              yfree($<expression>9.p);
+
+              /* Create the branch back after the condition */
+              offset += $<number>6 + 2 - ( CURRENT_PROGRAM_SIZE - 1 );
+              if (offset < -0xff)
+              {
+                  bytecode_p codep;
+
+                  if (offset < -0x8000)
+                      yyerror("offset overflow");
+
+                  codep = PROGRAM_BLOCK + --CURRENT_PROGRAM_SIZE - 1;
+                  *codep = *codep == F_BBRANCH_WHEN_NON_ZERO
+                           ? F_LBRANCH_WHEN_NON_ZERO
+                           : F_LBRANCH_WHEN_ZERO
+                  ;
+                  ins_short(offset);
+              }
+              else
+              {
+                  mem_block[A_PROGRAM].block[CURRENT_PROGRAM_SIZE-1] = -offset;
+              }
 
-          if ($<expression>9.line != current_loc.line)
-              store_line_number_relocation($<expression>9.line);
+              if ($<expression>9.line != current_loc.line)
+                  store_line_number_relocation($<expression>9.line);
+          }
 
           /* Now complete the break instructions.
            */
@@ -8599,11 +9864,14 @@ for:
               next_addr = read_jump_offset(current_break_address);
               upd_jump_offset(current_break_address,
                   CURRENT_PROGRAM_SIZE - current_break_address);
+              opt_add_loop_break(current_break_address);
           }
 
           /* Restore the previous environment */
           current_continue_address = $<numbers>3[0];
           current_break_address    = $<numbers>3[1];
+          opt_pop_frame();
+          opt_forget_all();
 
           /* and leave the for scope */
           leave_block_scope(MY_FALSE);
@@ -8791,6 +10059,8 @@ foreach:
           ins_short(0);
 
           push_address(); /* Address to branch back to */
+          (void)opt_push_frame();
+          opt_forget_all();
       }
 
       statement
@@ -8879,6 +10149,8 @@ foreach:
           /* Restore the previous environment */
           current_continue_address = $<numbers>3[0];
           current_break_address    = $<numbers>3[1];
+          opt_pop_frame();
+          opt_forget_all();
 
           /* and leave the scope */
           leave_block_scope(MY_FALSE);
@@ -9057,6 +10329,7 @@ switch:
         case_state.previous = statep;
         push_explicit(current_break_address);
         push_explicit(switch_pc);
+        (void)opt_push_frame();
 
         /* Create the SWITCH instruction plus two empty bytes */
         ins_f_code(F_SWITCH);
@@ -9120,6 +10393,8 @@ switch:
         if (current_continue_address)
             current_continue_address -= SWITCH_DEPTH_UNIT;
         current_break_stack_need--;
+        opt_pop_frame();
+        opt_forget_all();
 
         free_fulltype($3.type);
       }
@@ -9162,6 +10437,7 @@ case: L_CASE case_label ':'
         }
         temp->addr = mem_block[A_PROGRAM].current_size - switch_pc;
         temp->line = current_loc.line;
+        opt_jump_target();
     }
 
     | L_CASE case_label L_RANGE case_label ':'
@@ -9218,6 +10494,7 @@ case: L_CASE case_label ':'
         temp->key = $4.key;
         temp->addr = CURRENT_PROGRAM_SIZE - switch_pc;
         temp->line = 0; /* marks the upper bound of the range */
+        opt_jump_target();
     }
 ; /* case */
 
@@ -9264,6 +10541,7 @@ default:
               yyerror("Duplicate default");
 
           case_state.default_addr = CURRENT_PROGRAM_SIZE - switch_pc;
+          opt_jump_target();
     }
 ; /* default */
 
@@ -9290,12 +10568,33 @@ condStart:
 
           mp_uint current;
           bytecode_p current_code;
+          opt_frame_t *frame = opt_push_frame();
 
           /* Turn off the case labels */
 
           $$[0] = current_break_address;
           current_break_address &= ~CASE_LABELS_ENABLED;
 
+          /* With a constant condition, only one branch is compiled
+           * (or both, if the other can't be removed).
+           */
+          frame->cond = opt_condition($3.start);
+          if (frame->cond == OPT_COND_TRUE)
+          {
+              $$[1] = -1;
+              free_fulltype($3.type);
+              break;
+          }
+          if (frame->cond == OPT_COND_FALSE)
+          {
+              opt_set_mark(&frame->mark);
+              ins_f_code(F_BRANCH);
+              $$[1] = CURRENT_PROGRAM_SIZE;
+              ins_byte(0);
+              free_fulltype($3.type);
+              break;
+          }
+
           current = CURRENT_PROGRAM_SIZE;
           if (!realloc_a_program(2))
           {
@@ -9330,25 +10629,45 @@ cond:
       optional_else
       {
           p_int destination, location, offset;
+          opt_frame_t frame = *opt_top_frame();
+
+          opt_pop_frame();
 
-          /* Complete the branch over the if-part */
+          /* Complete the branch over the if-part, unless the if-part
+           * is never executed and could be removed.
+           */
           destination = (p_int)$3;
           location = $1[1];
-          if ( (offset = destination - location) > 0x100)
+          if (location < 0 || frame.cond == OPT_COND_REMOVED
+           || (frame.cond == OPT_COND_FALSE && opt_truncate(&frame.mark)))
           {
-              fix_branch(
-                mem_block[A_PROGRAM].block[location-1] ==
-                 F_BRANCH_WHEN_ZERO ?
-                  F_LBRANCH_WHEN_ZERO :
-                  F_LBRANCH_WHEN_NON_ZERO
-                ,
-                destination, location
-              );
+              /* Nothing to do */
           }
           else
           {
-              mem_block[A_PROGRAM].block[location] = offset - 1;
+              bytecode_t code = mem_block[A_PROGRAM].block[location-1];
+
+              if ( (offset = destination - location) > 0x100)
+              {
+                  fix_branch(
+                    code == F_BRANCH_WHEN_ZERO ? F_LBRANCH_WHEN_ZERO :
+                    code == F_BRANCH ? F_LBRANCH :
+                                       F_LBRANCH_WHEN_NON_ZERO
+                    ,
+                    destination, location
+                  );
+              }
+              else
+              {
+                  mem_block[A_PROGRAM].block[location] = offset - 1;
+              }
+              (void)opt_add_site(location-1, OPT_SITE_BRANCH);
           }
+          opt_forget_all();
+
+          /* If both parts end, so does the whole statement */
+          if (frame.ends)
+              opt_mark_dead();
 
           /* Restore the previous case-labels status without
            * changing the actual break-address.
@@ -9367,18 +10686,65 @@ optional_else:
 
     | L_ELSE
       {
-          /* Add the branch over the else part */
-          ins_f_code(F_BRANCH);
-          $<address>$ = CURRENT_PROGRAM_SIZE;
-          ins_byte(0);
+          opt_frame_t *frame = opt_top_frame();
+          Bool if_part_ends = opt_unreachable();
+
+          opt_jump_target();
+
+          if (frame->cond == OPT_COND_FALSE && opt_truncate(&frame->mark))
+          {
+              /* The if-part is gone, and so is the need for a branch */
+              frame->cond = OPT_COND_REMOVED;
+              frame->else_start = CURRENT_PROGRAM_SIZE;
+              frame->ends = MY_TRUE;
+              $<number>$ = -1;
+          }
+          else
+          {
+              if (frame->cond == OPT_COND_FALSE)
+                  frame->cond = OPT_COND_NORMAL;
+              else if (frame->cond == OPT_COND_TRUE)
+                  opt_set_mark(&frame->mark);
+
+              frame->ends = if_part_ends;
+              if (if_part_ends)
+              {
+                  /* The if-part ends with a return, break or continue */
+                  frame->else_start = CURRENT_PROGRAM_SIZE;
+                  $<number>$ = -1;
+              }
+              else
+              {
+                  /* Add the branch over the else part */
+                  ins_f_code(F_BRANCH);
+                  $<number>$ = CURRENT_PROGRAM_SIZE;
+                  ins_byte(0);
+              }
+          }
       }
       statement
       {
           /* Fix up the branch over the else part and return
            * the start address of the else part.
            */
-          $$ = fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, $<address>2);
-          $$ += $<address>2 + 1;
+          opt_frame_t *frame = opt_top_frame();
+
+          frame->ends = frame->ends && opt_unreachable();
+
+          if (frame->cond == OPT_COND_TRUE && opt_truncate(&frame->mark))
+          {
+              $$ = CURRENT_PROGRAM_SIZE;
+          }
+          else if ($<number>2 < 0)
+          {
+              $$ = frame->else_start;
+          }
+          else
+          {
+              $$ = fix_branch( F_LBRANCH, CURRENT_PROGRAM_SIZE, $<number>2);
+              $$ += $<number>2 + 1;
+              (void)opt_add_site($<number>2 - 1, OPT_SITE_BRANCH);
+          }
       }
 ; /* optional_else */
 
@@ -9841,7 +11207,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_OR);
+          ins_binary_operator(F_OR, &$1, &$3);
 
           $$.end = CURRENT_PROGRAM_SIZE;
       }
@@ -9857,7 +11223,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_XOR);
+          ins_binary_operator(F_XOR, &$1, &$3);
 
           $$.end = CURRENT_PROGRAM_SIZE;
       }
@@ -9873,7 +11239,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_AND);
+          ins_binary_operator(F_AND, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       } /* end of '&' code */
 
@@ -9892,7 +11258,7 @@ expr0:
           free_fulltype($3.type);
           free_lpctype(result);
 
-          ins_f_code(F_EQ);
+          ins_binary_operator(F_EQ, &$1, &$3);
 
           $$ = $1;
           $$.type = get_fulltype(lpctype_int);
@@ -9914,7 +11280,7 @@ expr0:
           free_fulltype($3.type);
           free_lpctype(result);
 
-          ins_f_code(F_NE);
+          ins_binary_operator(F_NE, &$1, &$3);
 
           $$ = $1;
           $$.type = get_fulltype(lpctype_int);
@@ -9930,7 +11296,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_GT);
+          ins_binary_operator(F_GT, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
     | expr0 L_GE  expr0
@@ -9941,7 +11307,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_GE);
+          ins_binary_operator(F_GE, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
     | expr0 '<'  expr0
@@ -9952,7 +11318,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_LT);
+          ins_binary_operator(F_LT, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
     | expr0 L_LE  expr0
@@ -9963,7 +11329,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_LE);
+          ins_binary_operator(F_LE, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
 
@@ -9979,7 +11345,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_LSH);
+          ins_binary_operator(F_LSH, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
 
@@ -9994,7 +11360,7 @@ expr0:
           free_fulltype($1.type);
           free_fulltype($3.type);
 
-          ins_f_code(F_RSH);
+          ins_binary_operator(F_RSH, &$1, &$3);
           $$.end = CURRENT_PROGRAM_SIZE;
       }
 
@@ -10099,7 +11465,7 @@ expr0:
               lpctype_t *result = check_binary_op_types($1.type.t_type, $4.type.t_type, "+", types_addition, lpctype_mixed);
               $$.type = get_fulltype(result);
 
-              ins_f_code(F_ADD);
+              ins_binary_operator(F_ADD, &$1, &$4);
           }
 
           free_fulltype($1.type);
@@ -10115,7 +11481,7 @@ expr0:
           lpctype_t *result = check_binary_op_types($1.type.t_type, $3.type.t_type, "-", types_subtraction, lpctype_mixed);
           $$.type = get_fulltype(result);
 
-          ins_f_code(F_SUBTRACT);
+          ins_binary_operator(F_SUBTRACT, &$1, &$3);
           free_fulltype($1.type);
           free_fulltype($3.type);
           $$.end = CURRENT_PROGRAM_SIZE;
@@ -10128,7 +11494,7 @@ expr0:
           lpctype_t *result = check_binary_op_types($1.type.t_type, $3.type.t_type, "*", types_multiplication, lpctype_mixed);
           $$.type = get_fulltype(result);
 
-          ins_f_code(F_MULTIPLY);
+          ins_binary_operator(F_MULTIPLY, &$1, &$3);
           free_fulltype($1.type);
           free_fulltype($3.type);
           $$.end = CURRENT_PROGRAM_SIZE;
@@ -10141,7 +11507,7 @@ expr0:
           lpctype_t *result = check_binary_op_types($1.type.t_type, $3.type.t_type, "%", types_modulus, lpctype_int);
           $$.type = get_fulltype(result);
 
-          ins_f_code(F_MOD);
+          ins_binary_operator(F_MOD, &$1, &$3);
           free_fulltype($1.type);
           free_fulltype($3.type);
           $$.end = CURRENT_PROGRAM_SIZE;
@@ -10153,7 +11519,7 @@ expr0:
           lpctype_t *result = check_binary_op_types($1.type.t_type, $3.type.t_type, "/", types_division, lpctype_int);
           $$.type = get_fulltype(result);
 
-          ins_f_code(F_DIVIDE);
+          ins_binary_operator(F_DIVIDE, &$1, &$3);
           free_fulltype($1.type);
           free_fulltype($3.type);
           $$.end = CURRENT_PROGRAM_SIZE;
@@ -10344,6 +11710,7 @@ expr0:
           {
               add_f_code(F_PUSH_LOCAL_VARIABLE_LVALUE);
               add_byte($2->u.local.num);
+              opt_local_written($2->u.local.num);
           }
           CURRENT_PROGRAM_SIZE =
             (last_expression = CURRENT_PROGRAM_SIZE + 2) + 1;
@@ -10537,8 +11904,13 @@ expr0:
     | L_NOT expr0
       {
           $$ = $2;
-          last_expression = CURRENT_PROGRAM_SIZE;
-          ins_f_code(F_NOT);        /* Any type is valid here. */
+          if (opt_fold_unary(F_NOT, $2.start))
+              $$.code = -1;
+          else
+          {
+              last_expression = CURRENT_PROGRAM_SIZE;
+              ins_f_code(F_NOT);        /* Any type is valid here. */
+          }
           $$.end = CURRENT_PROGRAM_SIZE;
           $$.type = get_fulltype(lpctype_int);
 
@@ -10553,7 +11925,10 @@ expr0:
           if (exact_types && !lpctype_contains(lpctype_int, $2.type.t_type))
               fulltype_error("Bad argument to ~", $2.type);
 
-          ins_f_code(F_COMPL);
+          if (opt_fold_unary(F_COMPL, $2.start))
+              $$.code = -1;
+          else
+              ins_f_code(F_COMPL);
           $$.end = CURRENT_PROGRAM_SIZE;
           $$.type = get_fulltype(lpctype_int);
 
@@ -11189,6 +12564,7 @@ expr4:
           {
               *p++ = F_PUSH_LOCAL_VARIABLE_LVALUE;
               *p = $2->u.local.num;
+              opt_local_escaped($2->u.local.num);
           }
           $$.type.t_type = ref_lpctype(type);
           $$.type.t_flags = TYPE_MOD_REFERENCE;
@@ -11414,6 +12790,14 @@ expr4:
           if ($2.inst == F_INDEX)
           {
               $$.code = F_PUSH_INDEXED_LVALUE;
+
+              /* An index by a local variable becomes a superinstruction.
+               * If this turns into an lvalue later, the F_INDEX is changed
+               * and the interpreter just executes the F_LOCAL.
+               */
+              if ($2.start + 2 == CURRENT_PROGRAM_SIZE
+               && PROGRAM_BLOCK[$2.start] == F_LOCAL)
+                  PROGRAM_BLOCK[$2.start] = F_LOCAL_INDEX;
               ins_f_code(F_INDEX);
           }
           else if ($2.inst == F_RINDEX)
@@ -13268,6 +14652,17 @@ function_call:
               }
               $$.type = get_fulltype(funp->type);
           }
+          else if ($3 != NULL && num_call_caches < USHRT_MAX)
+          {
+              /* true call_other with a constant function name:
+               * give the call site its own inline cache.
+               */
+              add_f_code(F_CALL_OTHER_CACHED);
+              add_short(num_call_caches);
+              num_call_caches++;
+              CURRENT_PROGRAM_SIZE += 3;
+              $$.type = get_fulltype(instrs[F_CALL_OTHER].ret_type);
+          }
           else /* true call_other */
           {
               add_f_code(F_CALL_OTHER);
@@ -13818,6 +15213,7 @@ lvalue_list:
           {
               ins_f_code(F_PUSH_LOCAL_VARIABLE_LVALUE);
               ins_byte($3->u.local.num);
+              opt_local_written($3->u.local.num);
           }
           $$ = 1 + $1;
       }
@@ -14035,6 +15431,8 @@ printf("DEBUG:   context name '%s'\n", get_txt(name->name));
     lv->length = 0;
     lv->type = actual_type;
 
+    opt_local_declared(q->u.local.num, !with_init);
+
     if (!with_init)
     {
         /* If this is a float variable, we need to insert an appropriate
@@ -14055,11 +15453,12 @@ printf("DEBUG:   context name '%s'\n", get_txt(name->name));
 /*-------------------------------------------------------------------------*/
 static void
 init_local_variable ( ident_t* name, struct lvalue_s *lv, int assign_op
-                    , fulltype_t exprtype)
+                    , fulltype_t exprtype, p_int start)
 
 /* This is called directly from a parser rule: <type> <name> = <expr>
  * It will be called after the call to define_local_variable().
- * It assigns the result of <expr> to the variable.
+ * It assigns the result of <expr>, whose code starts at <start>,
+ * to the variable.
  */
 
 {
@@ -14087,8 +15486,25 @@ if (current_inline && current_inline->parse_context)
     if (exprtype.t_flags & TYPE_MOD_REFERENCE)
         yyerror("Can't trace reference assignments");
 
+    /* The variable was cleared by CLEAR_LOCALS, so an initialization
+     * with 0 can be skipped.
+     */
+    if (opt_enabled() && opt_propagate && lv->length == 0
+     && lv->u.simple[0] == F_PUSH_LOCAL_VARIABLE_LVALUE
+     && CURRENT_PROGRAM_SIZE == start + 1
+     && PROGRAM_BLOCK[start] == F_CONST0
+     && opt_can_remove(start))
+    {
+        CURRENT_PROGRAM_SIZE = start;
+        last_expression = -1;
+        opt_local_declared(lv->u.simple[1], MY_TRUE);
+        return;
+    }
+
     if (!add_lvalue_code(lv, F_VOID_ASSIGN))
         return;
+
+    opt_assignment(start);
 } /* init_local_variable() */
 
 /*-------------------------------------------------------------------------*/
@@ -14111,6 +15527,7 @@ add_lvalue_code ( struct lvalue_s * lv, int instruction)
         add_to_mem_block(A_PROGRAM, lv->u.p, length);
         yfree(lv->u.p);
         last_expression = CURRENT_PROGRAM_SIZE;
+        opt_forget_all();
     }
     else
     {
@@ -14118,6 +15535,14 @@ add_lvalue_code ( struct lvalue_s * lv, int instruction)
         mp_uint current_size;
 
         source = lv->u.simple;
+        if (source[0] == F_PUSH_LOCAL_VARIABLE_LVALUE)
+        {
+            /* Without an instruction the lvalue is kept as a reference */
+            if (instruction == 0)
+                opt_local_escaped(source[1]);
+            else
+                opt_local_written(source[1]);
+        }
         current_size = CURRENT_PROGRAM_SIZE;
         if (!realloc_a_program(2))
         {
@@ -14129,6 +15554,13 @@ add_lvalue_code ( struct lvalue_s * lv, int instruction)
         dest = PROGRAM_BLOCK + current_size;
         *dest++ = *source++;
         *dest++ = *source;
+
+        /* In a void context, insert_pop_value() will make an INC out of
+         * these, so use the superinstruction for the increment.
+         */
+        if (dest[-2] == F_PUSH_LOCAL_VARIABLE_LVALUE
+         && (instruction == F_POST_INC || instruction == F_PRE_INC))
+            dest[-2] = F_INC_LOCAL;
     }
 
     if (instruction != 0)
@@ -14137,6 +15569,46 @@ add_lvalue_code ( struct lvalue_s * lv, int instruction)
     return MY_TRUE;
 } /* add_lvalue_code() */
 
+/*-------------------------------------------------------------------------*/
+static void
+ins_binary_operator (int instruction, struct s_lrvalue *left, struct s_lrvalue *right)
+
+/* Add the code for the binary operator <instruction>, the code for its
+ * operands <left> and <right> was just generated.
+ *
+ * If both operands are constant, the result is computed right away.
+ * If the operands are simple enough, write a superinstruction over the
+ * first instruction of the sequence (see func_spec). The operands are
+ * rvalues for good now, so their code won't be changed anymore.
+ */
+
+{
+    bytecode_p p;
+    p_int length;
+
+    if (opt_fold_binary(instruction, left->start, right->start))
+        return;
+
+    /* The left operand must be exactly one F_LOCAL */
+    if (left->code == F_PUSH_LOCAL_VARIABLE_LVALUE
+     && right->start == left->start + 2
+     && PROGRAM_BLOCK[left->start] == F_LOCAL)
+    {
+        p = PROGRAM_BLOCK + right->start;
+        length = CURRENT_PROGRAM_SIZE - right->start;
+
+        if (instruction == F_LT
+         && (   (length == 2 && (*p == F_LOCAL || *p == F_CLIT))
+             || (length == 1 + (p_int)sizeof(p_int) && *p == F_NUMBER))
+           )
+            PROGRAM_BLOCK[left->start] = F_LOCAL_LT;
+        else if (length == 2 && *p == F_LOCAL)
+            PROGRAM_BLOCK[left->start] = F_LOCAL_LOCAL;
+    }
+
+    ins_f_code(instruction);
+} /* ins_binary_operator() */
+
 /*-------------------------------------------------------------------------*/
 static void
 insert_pop_value (void)
@@ -16041,6 +17513,9 @@ store_include_info (char *name, char * filename, char delim, int depth)
 {
     mp_uint rc;
 
+    /* Code from before the include can't be cut off anymore */
+    opt_barrier++;
+
     /* Generate and store the plain include information */
     {
         include_t inc;
@@ -16151,6 +17626,7 @@ store_include_end (mp_uint inc_offset, int include_line)
 {
     unsigned char c;
 
+    opt_barrier++;
     stored_lines = include_line;
     if (last_include_start == mem_block[A_LINENUMBERS].current_size)
     {
@@ -16186,6 +17662,30 @@ store_include_end (mp_uint inc_offset, int include_line)
     }
 } /* store_include_end() */
 
+/*-------------------------------------------------------------------------*/
+void
+init_standard_lpctypes (void)
+
+/* Create the static standard types (lpctype_any_array and friends) if
+ * that hasn't been done yet. This must happen before any other program
+ * creates these types, so it is called before the first compile, or
+ * before the first program is read from the program cache.
+ */
+
+{
+    if (!_lpctypes_initialized)
+    {
+        make_static_type(get_array_type(lpctype_unknown),            &_lpctype_unknown_array);
+        make_static_type(get_array_type(lpctype_mixed),              &_lpctype_any_array);
+        make_static_type(get_union_type(lpctype_int, lpctype_float), &_lpctype_int_float);
+        make_static_type(get_array_type(lpctype_int),                &_lpctype_int_array);
+        make_static_type(get_array_type(lpctype_string),             &_lpctype_string_array);
+        make_static_type(get_array_type(lpctype_object),             &_lpctype_object_array);
+
+        _lpctypes_initialized = true;
+    }
+} /* init_standard_lpctypes() */
+
 /*-------------------------------------------------------------------------*/
 static void
 prolog (const char * fname, Bool isMasterObj)
@@ -16208,17 +17708,7 @@ prolog (const char * fname, Bool isMasterObj)
     }
     type_of_arguments.current_size = 0;
 
-    if (!_lpctypes_initialized)
-    {
-        make_static_type(get_array_type(lpctype_unknown),            &_lpctype_unknown_array);
-        make_static_type(get_array_type(lpctype_mixed),              &_lpctype_any_array);
-        make_static_type(get_union_type(lpctype_int, lpctype_float), &_lpctype_int_float);
-        make_static_type(get_array_type(lpctype_int),                &_lpctype_int_array);
-        make_static_type(get_array_type(lpctype_string),             &_lpctype_string_array);
-        make_static_type(get_array_type(lpctype_object),             &_lpctype_object_array);
-
-        _lpctypes_initialized = true;
-    }
+    init_standard_lpctypes();
 
 
     /* Initialize all the globals */
@@ -16227,15 +17717,22 @@ prolog (const char * fname, Bool isMasterObj)
     last_expression  = -1;
     compiled_prog    = NULL;  /* NULL means fail to load. */
     heart_beat       = -1;
+    num_call_caches  = 0;
     comp_stackp      = 0;     /* Local temp stack used by compiler */
     current_continue_address = 0;
     current_break_address    = 0;
     num_parse_error  = 0;
+    num_parse_warning = 0;
     block_depth      = 0;
     default_varmod = 0;
     default_funmod = 0;
     current_inline = NULL;
     inline_closure_id = 0;
+    opt_active = opt_propagate = MY_FALSE;
+    opt_num_sites = 0;
+    opt_frame_depth = 0;
+    opt_num_temps = 0;
+    opt_temps_in_use = 0;
 
     free_all_local_names();   /* In case of earlier error */
 
@@ -16764,6 +18261,7 @@ epilog (void)
         prog->total_size = size;
         prog->ref = 0;
         prog->heart_beat = heart_beat;
+        prog->num_call_caches = (unsigned short)num_call_caches;
         prog->id_number =
           ++current_id_number ? current_id_number : renumber_programs();
         prog->flags = (pragma_no_clone ? P_NO_CLONE : 0)
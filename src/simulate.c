@@ -60,6 +60,7 @@
 #include "pkg-sqlite.h"
 #endif
 #include "pkg-python.h"
+#include "prog_cache.h"
 #include "prolang.h"
 #include "sent.h"
 #include "simul_efun.h"
@@ -627,6 +628,20 @@ fatal (const char *fmt, ...)
     va_list va;
     char *ts;
 
+#ifdef GC_SUPPORT
+    /* The forked process of an incremental GC just gives up, the driver
+     * then collects the garbage in one go.
+     */
+    if (gc_in_snapshot)
+    {
+        va_start(va, fmt);
+        fprintf(stderr, "%s GC snapshot: ", time_stamp());
+        vfprintf(stderr, fmt, va);
+        va_end(va);
+        _exit(1);
+    }
+#endif
+
     /* Prevent double fatal. */
     if (in_fatal)
     {
@@ -1799,6 +1814,7 @@ load_object (const char *lname, Bool create_super, int depth
     char       *name; /* Copy of <lname> */
     char       *fname; /* Filename for <name> */
     program_t  *prog;
+    Bool        from_cache = MY_FALSE; /* TRUE: prog is from the cache */
     namechain_t nlink;
 
 #ifdef DEBUG
@@ -1997,31 +2013,53 @@ load_object (const char *lname, Bool create_super, int depth
                  , name, current_loc.file->name);
         }
 
-        fd = ixopen(fname, O_RDONLY | O_BINARY);
-        if (fd <= 0)
+        /* A valid program in the program cache saves the compilation,
+         * but it may need an inherit loaded first, too.
+         */
+        compiled_prog = load_cached_program(fname, &c_st, isMasterObj);
+        if (compiled_prog)
         {
-            perror(fname);
-            errorf("Could not read the file.\n");
+            if (comp_flag)
+                fprintf(stderr, " cached\n");
+            num_parse_error = 0;
+            from_cache = MY_TRUE;
+            break;
         }
-        FCOUNT_COMP(fname);
 
-        /* The file name is needed before compile_file(), in case there is
-         * an initial 'line too long' error.
-         */
-        compile_file(fd, fname, isMasterObj);
-        if (comp_flag)
+        if (NULL != inherit_file)
         {
-            if (NULL == inherit_file)
-                fprintf(stderr, " done\n");
-            else
-            {
+            if (comp_flag)
                 fprintf(stderr, " needs inherit\n");
-            }
+            num_parse_error = 0;
         }
+        else
+        {
+            fd = ixopen(fname, O_RDONLY | O_BINARY);
+            if (fd <= 0)
+            {
+                perror(fname);
+                errorf("Could not read the file.\n");
+            }
+            FCOUNT_COMP(fname);
 
-        update_compile_av(total_lines);
-        total_lines = 0;
-        (void)close(fd);
+            /* The file name is needed before compile_file(), in case there
+             * is an initial 'line too long' error.
+             */
+            compile_file(fd, fname, isMasterObj);
+            if (comp_flag)
+            {
+                if (NULL == inherit_file)
+                    fprintf(stderr, " done\n");
+                else
+                {
+                    fprintf(stderr, " needs inherit\n");
+                }
+            }
+
+            update_compile_av(total_lines);
+            total_lines = 0;
+            (void)close(fd);
+        }
 
         /* If there is no inherited file to compile, we can
          * end the loop here.
@@ -2107,6 +2145,9 @@ load_object (const char *lname, Bool create_super, int depth
 
     prog = compiled_prog;
 
+    if (!from_cache)
+        store_cached_program(prog, fname, &c_st, isMasterObj);
+
     ob = get_empty_object(prog->num_variables);
 
     if (!ob)
@@ -2146,6 +2187,7 @@ load_object (const char *lname, Bool create_super, int depth
         obj_list_end = ob;
     num_listed_objs++;
     enter_object_hash(ob);        /* add name to fast object lookup table */
+    enter_object_queues(ob);
 
     /* Give the object its uids */
     push_give_uid_error_context(ob);
@@ -2202,7 +2244,10 @@ load_object (const char *lname, Bool create_super, int depth
     }
 
     if ( !(ob->flags & O_DESTRUCTED))
+    {
         ob->flags |= O_WILL_CLEAN_UP;
+        update_clean_up_queue(ob);
+    }
 
     /* free the error handler with the buffer for name and fname. */
     pop_stack();
@@ -2399,6 +2444,7 @@ clone_object (string_t *str1)
         obj_list_end = new_ob;
     num_listed_objs++;
     enter_object_hash(new_ob);        /* Add name to fast object lookup table */
+    enter_object_queues(new_ob);
     push_give_uid_error_context(new_ob);
     push_ref_object(inter_sp, ob, "clone_object");
     push_ref_string(inter_sp, new_ob->name);
@@ -2761,6 +2807,7 @@ destruct (object_t *ob)
      * halt execution.
      */
     remove_object_hash(ob);
+    remove_object_queues(ob);
     if (ob->prev_all)
         ob->prev_all->next_all = ob->next_all;
     if (ob->next_all)
@@ -2959,6 +3006,11 @@ remove_object (object_t *ob
 #endif /* CHECK_OBJECT_REF */
     }
 
+    /* Pending callouts can't be executed anymore, but they would keep
+     * the object referenced until they are due.
+     */
+    remove_object_call_outs(ob);
+
     /* Either free the object, or link it up for future freeing. */
     if (ob->ref <= 1)
     {
@@ -3293,10 +3345,21 @@ status_parse (strbuf_t * sbuf, char * buff)
             strbuf_addf(sbuf
                        , "Calls to apply_low: %10"PRIuSTATCOUNTER"\n"
                          "Cache hits:         %10"PRIuSTATCOUNTER" (%.2f%%)\n"
+                         "Cache evictions:    %10"PRIuSTATCOUNTER"\n"
+                         "Cache size:         %10"PRIdPINT"\n"
                        , (apply_cache_hit+apply_cache_miss)
                        , apply_cache_hit
                        , 100.*(float)apply_cache_hit/
-                         (float)(apply_cache_hit+apply_cache_miss) );
+                         (float)(apply_cache_hit+apply_cache_miss)
+                       , apply_cache_eviction
+                       , get_apply_cache_size() );
+            strbuf_addf(sbuf
+                       , "Call site lookups:  %10"PRIuSTATCOUNTER"\n"
+                         "Call site hits:     %10"PRIuSTATCOUNTER" (%.2f%%)\n"
+                       , (call_site_cache_hit+call_site_cache_miss)
+                       , call_site_cache_hit
+                       , 100.*(float)call_site_cache_hit/
+                         (float)(call_site_cache_hit+call_site_cache_miss) );
 #endif
         }
         tot =  alloc_action_sent * sizeof(action_t);
@@ -66,6 +66,12 @@
  * keep a load-depending cache of free slabs around to avoid thrashing
  * in the large allocator.
  *
+ * Every RELEASE_TIME seconds and after a GC, mem_consolidate() also gives
+ * the memory of free large blocks of at least RELEASE_MIN_SIZE back to the
+ * system with madvise(MADV_DONTNEED). The blocks stay in the heap: just the
+ * pages between their header and their trailer are released, and are
+ * mapped in again when the block is allocated.
+ *
  * In order to determine the slab for a block, the distance to the slab begin
  * is stored as number (counting in words) in the size field of the block.
  * In addition, bit 27 (0x08000000) is set to mark the block as 'small'.
@@ -83,6 +89,12 @@
  * Large blocks are allocated from the system - if large allocation is
  * too small (less than 256 KByte), the allocator allocates a 256 KByte
  * block and enters the 'unnecessary' extra memory into the freelist.
+#ifdef MALLOC_HUGEPAGES
+ * With MALLOC_HUGEPAGES, the blocks from the system are 2 MByte instead,
+ * and the system is advised to back them with transparent huge pages.
+ * As the slabs are allocated as large blocks, they are packed into these
+ * huge pages as well.
+#endif
  * Large blocks are stored with boundary tags: the size field without flags
  * is replicated in the last word of the block.
  *
@@ -226,6 +238,16 @@
 #    define MADVISE(new,old)  NOOP
 #endif
 
+#if (defined(HAVE_MADVISE) || defined(HAVE_MMAP)) && defined(MADV_DONTNEED)
+#    define RELEASE_MEMORY(p,size)  madvise(p,size,MADV_DONTNEED)
+#endif
+
+#if defined(MALLOC_HUGEPAGES) && defined(MADV_HUGEPAGE) \
+ && (defined(MALLOC_SBRK) || defined(HAVE_MMAP))
+#    define HUGEPAGE_SIZE 0x200000  /* 2 MByte */
+#    define HUGEPAGE_ADVISE(p,size)  madvise(p,size,MADV_HUGEPAGE)
+#endif
+
 // for sysconf()
 #include <unistd.h>
 
@@ -336,6 +358,10 @@
 #define SMALL_BLOCK_MIN (2)
    /* Minimum size of a small block in words */
 
+#define GC_LISTED_STEP (32)
+   /* Number of blocks found by a snapshot GC freed by one mem_gc_step().
+    */
+
 #define SMALL_BLOCK_NUM (16)
    /* Number of different small block sizes.
     */
@@ -373,6 +399,23 @@
 #    define CHUNK_SIZE    (0x40000 - GRANULARITY - EXTERN_MALLOC_OVERHEAD)
 #endif
 
+#ifdef HUGEPAGE_SIZE
+    /* Get the heap in huge pages, the slabs and large blocks are then
+     * allocated from within them.
+     */
+#    undef CHUNK_SIZE
+#    define CHUNK_SIZE          HUGEPAGE_SIZE
+#endif
+
+#define RELEASE_MIN_SIZE (4 * CHUNK_SIZE)
+   /* The memory of free large blocks of at least this size is given
+    * back to the system.
+    */
+
+#define RELEASE_TIME (60)
+   /* Interval in seconds in which the free memory is given back.
+    */
+
 
 /* Bitflags for the size field:
  * TODO: Assumes a word_t of at least 32 bit.
@@ -503,6 +546,7 @@ struct slab_s
                              */
     mslab_t * prev, * next;  /* Link pointers for slab list. */
     unsigned long numAllocated;  /* Number of blocks allocated. */
+    unsigned long gcIx;     /* Index+1 of the slab in gc_slabs[], or 0. */
     word_t * freeList;      /* List of free blocks. */
     word_t   blocks[1];     /* First word of the allocatable memory. */
 };
@@ -591,6 +635,16 @@ static t_stat sbrk_stat;
   /* Number and size of allocated heap blocks.
    */
 
+static t_stat large_released_stat = {0,0};
+  /* Number and size (in bytes) of the free large blocks whose memory was
+   * given back to the system by the last release. This figure is a subset
+   * of large_free_stat.
+   */
+
+static mp_int last_release_time = 0;
+  /* Time of the last release of free memory.
+   */
+
 static t_stat perm_alloc_stat = {0,0};
   /* Number and size of permanent allocations functions (incl overhead). This
    * figure is a subset of {small,large}_alloc_stat.
@@ -614,6 +668,40 @@ static unsigned long num_avl_nodes = 0;
    */
 #endif /* USE_AVL_FREELIST */
 
+/* --- Incremental GC variables --- */
+
+static mslab_t ** gc_slabs = NULL;
+static unsigned long gc_num_slabs = 0;
+static unsigned long gc_next_slab = 0;
+  /* The slabs still to be processed by mem_gc_step(), and the index of
+   * the next one. Each listed slab knows its entry by its .gcIx, the
+   * entries of slabs which became free meanwhile are NULL.
+   */
+
+static Bool gc_sweeping = MY_FALSE;
+  /* TRUE if mem_gc_step() frees the unreferenced blocks, FALSE if it
+   * clears the 'referenced' flags.
+   */
+
+static word_t gc_alloc_white = 0;
+  /* M_REF while the flags are cleared incrementally: small blocks
+   * allocated meanwhile start out unreferenced like the already
+   * cleared ones, else 0.
+   */
+
+static mp_int gc_small_freed = 0;
+static mp_int gc_large_freed = 0;
+  /* Number of small resp. large blocks freed by the current incremental
+   * sweep.
+   */
+
+static void ** gc_listed = NULL;
+static p_int gc_num_listed = 0;
+static p_int gc_next_listed = 0;
+  /* The allocations found unreferenced by a snapshot GC, which are freed
+   * by mem_gc_step(), and the index of the next one.
+   */
+
 /*-------------------------------------------------------------------------*/
 /* Forward declarations */
 
@@ -622,6 +710,8 @@ static char *esbrk(word_t size, size_t * pExtra) __attribute__((malloc,warn_unus
 static char *large_malloc(word_t size, Bool force_m) __attribute__((malloc,warn_unused_result));
 #define large_malloc_int(size, force_m) large_malloc(size, force_m)
 static void large_free(char *);
+static mp_int mem_free_unrefed_slab_memory(const char * tag, mslab_t * slab
+                                          , int ix, word_t * startp);
 
 static INLINE size_t mem_overhead (void) __attribute__((const));
 
@@ -928,7 +1018,7 @@ mem_dump_data (strbuf_t *sbuf)
 #if defined(REPLACE_MALLOC)
     t_stat clib_st;
 #endif
-    t_stat l_alloc, l_free, l_wasted;
+    t_stat l_alloc, l_free, l_wasted, l_released;
     t_stat s_alloc, s_free, s_slab, s_free_slab;
     unsigned long s_overhead;
 
@@ -950,6 +1040,7 @@ mem_dump_data (strbuf_t *sbuf)
     l_alloc = large_alloc_stat; l_alloc.size *= GRANULARITY;
     l_free = large_free_stat; l_free.size *= GRANULARITY;
     l_wasted = large_wasted_stat;
+    l_released = large_released_stat;
     s_alloc = small_alloc_stat;
     s_free = small_free_stat;
     s_slab = small_slab_stat; s_slab.size += s_slab.counter * M_OVERHEAD * GRANULARITY;
@@ -969,6 +1060,7 @@ mem_dump_data (strbuf_t *sbuf)
                , l_alloc.size - l_alloc.counter * ML_OVERHEAD * GRANULARITY
                );
     dump_stat("large free blocks: %8lu        %10lu (c)\n",l_free);
+    dump_stat("large released:    %8lu        %10lu    \n",l_released);
     dump_stat("large wasted:      %8lu        %10lu (d)\n\n",l_wasted);
     dump_stat("small slabs:       %8lu        %10lu (e)\n",s_slab);
     dump_stat("small blocks:      %8lu        %10lu (f)\n",s_alloc);
@@ -1307,6 +1399,14 @@ mem_driver_info (svalue_t *svp, int value)
             put_number(svp, malloc_increment_size_total);
             break;
 
+        case DI_NUM_LARGE_BLOCKS_RELEASED:
+            put_number(svp, large_released_stat.counter);
+            break;
+
+        case DI_SIZE_LARGE_BLOCKS_RELEASED:
+            put_number(svp, large_released_stat.size);
+            break;
+
         case DI_NUM_REPLACEMENT_MALLOC_CALLS:
 #if defined(REPLACE_MALLOC)
             put_number(svp, clib_alloc_stat.counter);
@@ -1793,7 +1893,7 @@ mem_alloc (size_t size)
         /* Setup the block (M_SIZE) is mostly ok. */
         MAKE_SMALL_CHECK(block, size);
         block[M_SIZE] |= (M_GC_FREE|M_REF);
-        block[M_SIZE] &= ~THIS_BLOCK;
+        block[M_SIZE] &= ~(THIS_BLOCK|gc_alloc_white);
 
         block += M_OVERHEAD;
 
@@ -1885,6 +1985,7 @@ mem_alloc (size_t size)
         slab->next = slab->prev = NULL;
         slab->freeList = NULL;
         slab->numAllocated = 0;
+        slab->gcIx = 0;
 
         slabtable[ix].fresh = slab;
         slabtable[ix].freshMem = slab->blocks + (slabtable[ix].numBlocks * slab->size / GRANULARITY);
@@ -1912,7 +2013,7 @@ mem_alloc (size_t size)
               , block, slabtable[ix].fresh->blocks, ((char *)slabtable[ix].fresh->blocks) + (slabtable[ix].numBlocks * slabtable[ix].fresh->size)
               );
         block[M_SIZE] =   (word_t)(block - (word_t *)(slabtable[ix].fresh))
-                        | (M_SMALL|M_GC_FREE|M_REF);
+                        | ((M_SMALL|M_GC_FREE|M_REF) & ~gc_alloc_white);
         MAKE_SMALL_CHECK_UNCHECKED(block, size);
         block += M_OVERHEAD;
 
@@ -2111,6 +2212,13 @@ sfree (void * ptr)
             if (slabtable[ix].last == slab)
                 slabtable[ix].last = slab->prev;
 
+            /* A free slab has nothing left for an incremental GC. */
+            if (slab->gcIx)
+            {
+                gc_slabs[slab->gcIx-1] = NULL;
+                slab->gcIx = 0;
+            }
+
 #           if SLAB_RETENTION_TIME > 0
                 ulog3f("slaballoc:   current time %d, free (first %x, last %x)\n"
                       , current_time, slabtable[ix].firstFree, slabtable[ix].lastFree
@@ -3557,6 +3665,23 @@ large_free (char *ptr)
     (void)add_large_free(p, size);
 } /* large_free() */
 
+/*-------------------------------------------------------------------------*/
+#ifdef HUGEPAGE_SIZE
+static void
+advise_hugepages (char * p, size_t size)
+
+/* Let the system back the new heap memory <p> of <size> bytes with
+ * transparent huge pages where possible.
+ */
+
+{
+    size_t pagesize = getpagesize();
+    char * start = (char *)((p_uint)p & ~(p_uint)(pagesize - 1));
+
+    (void)HUGEPAGE_ADVISE(start, (p + size) - start);
+} /* advise_hugepages() */
+#endif /* HUGEPAGE_SIZE */
+
 /*-------------------------------------------------------------------------*/
 static char *
 esbrk (word_t size, size_t * pExtra)
@@ -3573,6 +3698,8 @@ esbrk (word_t size, size_t * pExtra)
 #elif HAVE_MMAP
  * Use mmap() to allocate a new block of memory. If this block borders
  * to the previous one, both blocks are joined.
+ * With MALLOC_HUGEPAGES, the block is a multiple of 2 MByte and aligned
+ * to 2 MByte, so that it can be backed by huge pages completely.
  * The allocated block (modulo joints) is tagged at both ends with fake
  * "allocated" blocks of which cover the unallocated areas - large_malloc()
  * will perceive this as a fragmented heap.
@@ -3606,9 +3733,28 @@ esbrk (word_t size, size_t * pExtra)
         assert_stack_gap();
     }
 
+#ifdef HUGEPAGE_SIZE
+    /* Let the heap end on a huge page boundary, else the last pages
+     * can't be backed by a huge page when they are touched first.
+     * The fake block of the first call stays as it is.
+     */
+    if (heap_end != heap_start)
+    {
+        size_t grow = (((p_uint)heap_end + size + HUGEPAGE_SIZE - 1)
+                       & ~(p_uint)(HUGEPAGE_SIZE - 1))
+                    - ((p_uint)heap_end + size);
+
+        size += grow;
+        *pExtra = grow;
+    }
+#endif
+
     /* Get the new block */
     if ((int)brk((char *)heap_end + size) == -1)
         return NULL;
+#ifdef HUGEPAGE_SIZE
+    advise_hugepages((char *)heap_end, size);
+#endif
 
     count_up(&sbrk_stat, size);
     heap_end = (word_t*)((char *)heap_end + size);
@@ -3641,10 +3787,29 @@ esbrk (word_t size, size_t * pExtra)
             size += pagesize;
             size &= ~pagesize;
         }
+#ifdef HUGEPAGE_SIZE
+        // get new huge page(s): map one more, then cut off the unaligned
+        // parts at both ends.
+        size = (size + HUGEPAGE_SIZE - 1) & ~(size_t)(HUGEPAGE_SIZE - 1);
+        block = mmap(0, size + HUGEPAGE_SIZE, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+        if (block == MAP_FAILED)
+            return NULL;
+        {
+            char * aligned = (char *)(((p_uint)block + HUGEPAGE_SIZE - 1)
+                                      & ~(p_uint)(HUGEPAGE_SIZE - 1));
+
+            if (aligned != block)
+                munmap(block, aligned - block);
+            munmap(aligned + size, block + HUGEPAGE_SIZE - aligned);
+            block = aligned;
+        }
+        advise_hugepages(block, size);
+#else
         // get new page(s)
         block = mmap(0, size, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
         if (block == MAP_FAILED)
             return NULL;
+#endif /* HUGEPAGE_SIZE */
     }
 #else
     block = malloc(size);
@@ -4001,17 +4166,248 @@ mem_clear_slab_memory_flags ( const char * tag
     }
 } /* mem_clear_slab_memory_flags() */
 
+/*-------------------------------------------------------------------------*/
+static Bool
+gc_list_slabs (Bool sweeping)
+
+/* Start an incremental GC step by listing all used slabs in gc_slabs[]
+ * for mem_gc_step(), which will clear their flags or, if <sweeping> is
+ * TRUE, free their unreferenced blocks.
+ * Return FALSE if there is no memory for the list.
+ */
+
+{
+    unsigned long num;
+    int i;
+
+    num = 0;
+    for (i = 0; i < SMALL_BLOCK_NUM; ++i)
+        num += slabtable[i].numSlabs - slabtable[i].numFreeSlabs;
+
+    gc_slabs = mem_alloc((num ? num : 1) * sizeof(*gc_slabs));
+    if (!gc_slabs)
+        return MY_FALSE;
+    mem_mark_permanent(gc_slabs);
+
+    gc_num_slabs = 0;
+    gc_next_slab = 0;
+    gc_sweeping = sweeping;
+    gc_small_freed = 0;
+
+    for (i = 0; i < SMALL_BLOCK_NUM; ++i)
+    {
+        mslab_t * slab;
+
+        if (slabtable[i].fresh)
+        {
+            gc_slabs[gc_num_slabs++] = slabtable[i].fresh;
+            slabtable[i].fresh->gcIx = gc_num_slabs;
+        }
+        for (slab = slabtable[i].first; slab != NULL; slab = slab->next)
+        {
+            gc_slabs[gc_num_slabs++] = slab;
+            slab->gcIx = gc_num_slabs;
+        }
+        for (slab = slabtable[i].fullSlabs; slab != NULL; slab = slab->next)
+        {
+            gc_slabs[gc_num_slabs++] = slab;
+            slab->gcIx = gc_num_slabs;
+        }
+    }
+
+    /* Blocks allocated while the flags are cleared must be unreferenced
+     * as well, the marking will find them if they are still used.
+     */
+    if (!sweeping)
+        gc_alloc_white = M_REF;
+
+    return MY_TRUE;
+} /* gc_list_slabs() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_free_lost_small_block (word_t * p, size_t size)
+
+/* Free the small block <p> of <size> bytes which the GC found to be lost.
+ */
+
+{
+    count_back(&xalloc_stat, size - (T_OVERHEAD * GRANULARITY));
+    dprintf2(gcollect_outfd, "freeing small block 0x%x (user 0x%x)"
+            , (p_uint)p, (p_uint)(p+M_OVERHEAD));
+#ifdef MALLOC_TRACE
+    dprintf2(gcollect_outfd, " %s %d"
+            , p[XM_FILE+M_OVERHEAD], p[XM_LINE+M_OVERHEAD]);
+#endif
+    writes(gcollect_outfd, "\n");
+#ifdef MALLOC_LPC_TRACE
+    write_lpc_trace(gcollect_outfd, p + M_OVERHEAD, MY_FALSE);
+#endif
+    print_block(gcollect_outfd, p + M_OVERHEAD);
+
+    /* Recover the block */
+    *p |= M_REF;
+    sfree(p+M_OVERHEAD);
+} /* mem_free_lost_small_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_free_lost_large_block (word_t * p)
+
+/* Free the large block <p> (pointing to its size word) which the GC found
+ * to be lost.
+ */
+
+{
+    count_back(&xalloc_stat, mem_block_size(p+ML_OVERHEAD));
+#if defined(MALLOC_TRACE) || defined(MALLOC_LPC_TRACE)
+    dprintf1(gcollect_outfd, "freeing large block 0x%x", (p_uint)p);
+#endif
+#ifdef MALLOC_TRACE
+    dprintf3(gcollect_outfd, " %s %d size 0x%x\n",
+      p[XM_FILE+ML_OVERHEAD], p[XM_LINE+ML_OVERHEAD], *p & M_MASK
+    );
+#endif
+#ifdef MALLOC_LPC_TRACE
+    write_lpc_trace(gcollect_outfd, p + ML_OVERHEAD, MY_FALSE);
+#endif
+    print_block(gcollect_outfd, p + ML_OVERHEAD);
+    large_free((char *)(p+ML_OVERHEAD));
+} /* mem_free_lost_large_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_free_listed_block (void * p)
+
+/* Free the allocation <p> which a snapshot GC found to be unreferenced.
+ * As nothing references it, it is still allocated: the flags are checked
+ * just in case.
+ */
+
+{
+    word_t * q = (word_t *)p - M_OVERHEAD;
+
+    if (q[M_SIZE] & M_SMALL)
+    {
+        if ((q[M_SIZE] & (THIS_BLOCK|M_GC_FREE)) == M_GC_FREE)
+        {
+            gc_small_freed++;
+            mem_free_lost_small_block(q, mem_block_total_size(p));
+        }
+    }
+    else if ((q[M_SIZE] & (THIS_BLOCK|M_GC_FREE)) == (THIS_BLOCK|M_GC_FREE))
+    {
+        gc_large_freed++;
+        mem_free_lost_large_block(q + M_LSIZE);
+    }
+} /* mem_free_listed_block() */
+
+/*-------------------------------------------------------------------------*/
+Bool
+mem_gc_step (void)
+
+/* Process the next slab of an incremental GC started with
+ * mem_begin_clear_ref_flags() or mem_begin_free_unrefed_memory(), or the
+ * next GC_LISTED_STEP blocks of one started with
+ * mem_begin_free_listed_memory().
+ * Return TRUE if there is more to do, FALSE if all is done.
+ */
+
+{
+    if (gc_listed != NULL)
+    {
+        p_int end = gc_next_listed + GC_LISTED_STEP;
+
+        if (end > gc_num_listed)
+            end = gc_num_listed;
+        while (gc_next_listed < end)
+            mem_free_listed_block(gc_listed[gc_next_listed++]);
+        if (gc_next_listed < gc_num_listed)
+            return MY_TRUE;
+
+        if (gc_large_freed)
+        {
+            dprintf1(gcollect_outfd, "%d large blocks freed\n", gc_large_freed);
+        }
+        if (gc_small_freed)
+        {
+            dprintf1(gcollect_outfd, "%d small blocks freed\n", gc_small_freed);
+        }
+        gc_listed = NULL;
+        gc_num_listed = gc_next_listed = 0;
+        return MY_FALSE;
+    }
+
+    while (gc_slabs != NULL && gc_next_slab < gc_num_slabs)
+    {
+        mslab_t * slab = gc_slabs[gc_next_slab++];
+        word_t * startp = NULL;
+        int ix;
+
+        if (slab == NULL)
+            continue;
+
+        slab->gcIx = 0;
+        ix = SIZE_INDEX(slab->size);
+        if (slab == slabtable[ix].fresh)
+            startp = slabtable[ix].freshMem;
+
+        if (gc_sweeping)
+            gc_small_freed += mem_free_unrefed_slab_memory("listed", slab, ix
+                                                          , startp);
+        else
+            mem_clear_slab_memory_flags("listed", slab, ix, startp);
+        return MY_TRUE;
+    }
+
+    if (gc_slabs != NULL)
+    {
+        if (gc_sweeping && gc_small_freed)
+        {
+            dprintf1(gcollect_outfd, "%d small blocks freed\n", gc_small_freed);
+        }
+        sfree(gc_slabs);
+        gc_slabs = NULL;
+        gc_num_slabs = gc_next_slab = 0;
+        gc_alloc_white = 0;
+    }
+
+    return MY_FALSE;
+} /* mem_gc_step() */
+
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_clear_ref_flags (void)
+
+/* Start clearing the M_REF flags of the small blocks in preparation for a
+ * GC, one slab per call of mem_gc_step(). mem_clear_ref_flags() completes
+ * the clearing.
+ */
+
+{
+    /* Complete a pending incremental sweep first. */
+    while (mem_gc_step()) NOOP;
+
+    (void)gc_list_slabs(MY_FALSE);
+} /* mem_begin_clear_ref_flags() */
+
 /*-------------------------------------------------------------------------*/
 void
 mem_clear_ref_flags (void)
 
 /* Walk through all allocated blocks and clear the M_REF flag in preparation
- * for a GC.
+ * for a GC. If the clearing was started with mem_begin_clear_ref_flags(),
+ * just the rest of it is done.
  */
 
 {
     word_t *p, *last;
     int i;
+    Bool cleared;
+
+    /* Complete a pending incremental sweep or clearing. */
+    cleared = (gc_slabs != NULL && !gc_sweeping);
+    while (mem_gc_step()) NOOP;
 
     /* Clear the large blocks */
     last = heap_end - TL_OVERHEAD;
@@ -4038,25 +4434,36 @@ mem_clear_ref_flags (void)
         ulog1f("slaballoc: clear_ref [%d]\n", i);
 
         /* Mark the fresh slab.
+         * If the blocks were cleared incrementally, just the slabs
+         * themselves need to be marked again.
          */
         if (slabtable[i].fresh)
         {
-            mem_clear_slab_memory_flags( "fresh",  slabtable[i].fresh, i
-                                       , slabtable[i].freshMem);
+            if (cleared)
+                mem_mark_ref(slabtable[i].fresh);
+            else
+                mem_clear_slab_memory_flags( "fresh",  slabtable[i].fresh, i
+                                           , slabtable[i].freshMem);
         }
 
         /* Mark the partially used slabs.
          */
         for  (slab = slabtable[i].first; slab != NULL; slab = slab->next)
         {
-            mem_clear_slab_memory_flags("partial", slab, i, NULL);
+            if (cleared)
+                mem_mark_ref(slab);
+            else
+                mem_clear_slab_memory_flags("partial", slab, i, NULL);
         }
 
         /* Mark the fully used slabs.
          */
         for  (slab = slabtable[i].fullSlabs; slab != NULL; slab = slab->next)
         {
-            mem_clear_slab_memory_flags("full", slab, i, NULL);
+            if (cleared)
+                mem_mark_ref(slab);
+            else
+                mem_clear_slab_memory_flags("full", slab, i, NULL);
         }
 
         /* Mark the fully free slabs.
@@ -4112,22 +4519,7 @@ mem_free_unrefed_slab_memory ( const char * tag
         {
             /* Unref'd small blocks are definitely lost */
             success++;
-            count_back(&xalloc_stat, slab->size - (T_OVERHEAD * GRANULARITY));
-            dprintf2(gcollect_outfd, "freeing small block 0x%x (user 0x%x)"
-                    , (p_uint)p, (p_uint)(p+M_OVERHEAD));
-#ifdef MALLOC_TRACE
-            dprintf2(gcollect_outfd, " %s %d"
-                    , p[XM_FILE+M_OVERHEAD], p[XM_LINE+M_OVERHEAD]);
-#endif
-            writes(gcollect_outfd, "\n");
-#ifdef MALLOC_LPC_TRACE
-            write_lpc_trace(gcollect_outfd, p + M_OVERHEAD, MY_FALSE);
-#endif
-            print_block(gcollect_outfd, p + M_OVERHEAD);
-
-            /* Recover the block */
-            *p |= M_REF;
-            sfree(p+M_OVERHEAD);
+            mem_free_lost_small_block(p, slab->size);
         }
 #if 0 && defined(DEBUG_MALLOC_ALLOCS)
         else
@@ -4141,16 +4533,15 @@ mem_free_unrefed_slab_memory ( const char * tag
 } /* mem_free_unrefed_slab_memory() */
 
 /*-------------------------------------------------------------------------*/
-void
-mem_free_unrefed_memory (void)
+static void
+mem_free_unrefed_large_memory (void)
 
-/* The GC marked all used memory as REF'd, now recover all blocks which
- * are allocated, but haven't been marked.
+/* The GC marked all used memory as REF'd, now recover all large blocks
+ * which are allocated, but haven't been marked.
  */
 
 {
     word_t *p, *last;
-    int i;
     mp_int success = 0;
 
     /* Scan the heap for lost large blocks */
@@ -4169,22 +4560,9 @@ mem_free_unrefed_memory (void)
             word_t size2, flags2;
 
             success++;
-            count_back(&xalloc_stat, mem_block_size(p+ML_OVERHEAD));
-#if defined(MALLOC_TRACE) || defined(MALLOC_LPC_TRACE)
-            dprintf1(gcollect_outfd, "freeing large block 0x%x", (p_uint)p);
-#endif
-#ifdef MALLOC_TRACE
-            dprintf3(gcollect_outfd, " %s %d size 0x%x\n",
-              p[XM_FILE+ML_OVERHEAD], p[XM_LINE+ML_OVERHEAD], size & M_MASK
-            );
-#endif
-#ifdef MALLOC_LPC_TRACE
-            write_lpc_trace(gcollect_outfd, p + ML_OVERHEAD, MY_FALSE);
-#endif
-            print_block(gcollect_outfd, p + ML_OVERHEAD);
             size2 = p[size];
             flags2 = p[size + 1];
-            large_free((char *)(p+ML_OVERHEAD));
+            mem_free_lost_large_block(p);
             if ( !(flags2 & THIS_BLOCK) )
                 size += size2;
         }
@@ -4194,11 +4572,25 @@ mem_free_unrefed_memory (void)
     {
         dprintf1(gcollect_outfd, "%d large blocks freed\n", success);
     }
+} /* mem_free_unrefed_large_memory() */
+
+/*-------------------------------------------------------------------------*/
+void
+mem_free_unrefed_memory (void)
+
+/* The GC marked all used memory as REF'd, now recover all blocks which
+ * are allocated, but haven't been marked.
+ */
+
+{
+    int i;
+    mp_int success = 0;
+
+    mem_free_unrefed_large_memory();
 
     /* Scan the small chunks for lost small blocks.
      * Remember that small blocks in the free-lists are marked as ref'd.
      */
-    success = 0;
     for  (i = 0; i < SMALL_BLOCK_NUM; ++i)
     {
         mslab_t * slab, *next;
@@ -4237,6 +4629,123 @@ mem_free_unrefed_memory (void)
     }
 } /* mem_free_unrefed_memory() */
 
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_free_unrefed_memory (void)
+
+/* The GC marked all used memory as REF'd: recover the large blocks which
+ * haven't been marked, and start recovering the small ones, one slab
+ * per call of mem_gc_step(). Blocks allocated or freed meanwhile are
+ * marked as REF'd, so only the lost blocks are recovered.
+ */
+
+{
+    if (!gc_list_slabs(MY_TRUE))
+    {
+        mem_free_unrefed_memory();
+        return;
+    }
+
+    mem_free_unrefed_large_memory();
+} /* mem_begin_free_unrefed_memory() */
+
+/*-------------------------------------------------------------------------*/
+static p_int
+mem_list_unrefed_slab_memory ( mslab_t * slab, int ix, word_t * startp
+                             , void ** list, p_int num, p_int max)
+
+/* Add the unreferenced blocks in <slab> of table[<ix>] to <list>, which
+ * holds <num> of at most <max> entries. If <startp> is not NULL, it denotes
+ * the starting memory address for the scan (used for the fresh slab).
+ * Return the new number of entries, or -1 if <list> is full.
+ */
+
+{
+    word_t * p;
+
+    p = (startp != NULL) ? startp : slab->blocks;
+    while (p < slab->blocks + slabtable[ix].numBlocks * slab->size / GRANULARITY)
+    {
+        if ((*p & (M_REF|M_GC_FREE)) == M_GC_FREE)
+        {
+            if (num >= max)
+                return -1;
+            list[num++] = p + M_OVERHEAD;
+        }
+        p += slab->size / GRANULARITY;
+    }
+
+    return num;
+} /* mem_list_unrefed_slab_memory() */
+
+/*-------------------------------------------------------------------------*/
+p_int
+mem_list_unrefed_memory (void ** list, p_int max)
+
+/* The GC marked all used memory as REF'd: store the allocations which
+ * haven't been marked in <list>, but not more than <max> of them. Nothing
+ * is freed: this is done by a snapshot GC in a child process, the driver
+ * itself frees the allocations with mem_begin_free_listed_memory().
+ * Return the number of allocations, or -1 if there are more than <max>.
+ */
+
+{
+    word_t *p, *last;
+    p_int num = 0;
+    int i;
+
+    /* Scan the heap for lost large blocks */
+    last = heap_end - TL_OVERHEAD;
+    for (p = heap_start; p < last; p += *p)
+    {
+        if ( (p[1] & (M_REF|THIS_BLOCK|M_GC_FREE)) == (THIS_BLOCK|M_GC_FREE) )
+        {
+            if (num >= max)
+                return -1;
+            list[num++] = p + ML_OVERHEAD;
+        }
+    }
+
+    /* Scan the slabs for lost small blocks */
+    for (i = 0; i < SMALL_BLOCK_NUM && num >= 0; ++i)
+    {
+        mslab_t * slab;
+
+        if (slabtable[i].fresh)
+            num = mem_list_unrefed_slab_memory(slabtable[i].fresh, i
+                                              , slabtable[i].freshMem
+                                              , list, num, max);
+        for (slab = slabtable[i].first; slab != NULL && num >= 0
+            ; slab = slab->next)
+            num = mem_list_unrefed_slab_memory(slab, i, NULL, list, num, max);
+        for (slab = slabtable[i].fullSlabs; slab != NULL && num >= 0
+            ; slab = slab->next)
+            num = mem_list_unrefed_slab_memory(slab, i, NULL, list, num, max);
+    }
+
+    return num;
+} /* mem_list_unrefed_memory() */
+
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_free_listed_memory (void ** list, p_int num)
+
+/* Start freeing the <num> allocations in <list> which a snapshot GC found
+ * to be unreferenced, GC_LISTED_STEP of them per call of mem_gc_step().
+ * <list> has to stay valid until mem_gc_step() returns FALSE.
+ */
+
+{
+    /* Complete a pending incremental sweep or clearing first. */
+    while (mem_gc_step()) NOOP;
+
+    gc_listed = list;
+    gc_num_listed = num;
+    gc_next_listed = 0;
+    gc_small_freed = 0;
+    gc_large_freed = 0;
+} /* mem_begin_free_listed_memory() */
+
 /*-------------------------------------------------------------------------*/
 #if 0
 static void
@@ -4454,6 +4963,81 @@ mem_dump_memory (int fd)
     return MY_TRUE;
 } /* mem_dump_memory() */
 
+/*-------------------------------------------------------------------------*/
+#ifdef RELEASE_MEMORY
+static void
+release_free_block (struct free_block * b, size_t pagesize)
+
+/* Give the memory of the free large block with the node <b> back to the
+ * system. The node and the size copy at the end of the block are kept,
+ * so just the full pages inbetween are released.
+ */
+
+{
+    word_t * ptr = (word_t *)b - M_OVERHEAD;
+    char * start, * end;
+
+    start = (char *)(b + 1);
+    start = (char *)(((p_uint)start + pagesize - 1) & ~(p_uint)(pagesize - 1));
+    end = (char *)(ptr + b->size - 2);
+    end = (char *)((p_uint)end & ~(p_uint)(pagesize - 1));
+
+    if (start < end && !RELEASE_MEMORY(start, end - start))
+        count_up(&large_released_stat, end - start);
+} /* release_free_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+release_free_tree (struct free_block * node, size_t pagesize)
+
+/* Release the memory of all blocks of at least RELEASE_MIN_SIZE in the
+ * subtree <node> of the free tree. As the tree is sorted by size, the
+ * left subtrees of small nodes can be skipped.
+ */
+
+{
+    while (node != NULL)
+    {
+        if (node->size * GRANULARITY >= RELEASE_MIN_SIZE)
+        {
+#ifdef USE_AVL_FREELIST
+            struct free_block * b;
+
+            for (b = node; b != NULL; b = b->next)
+                release_free_block(b, pagesize);
+#else
+            release_free_block(node, pagesize);
+#endif /* USE_AVL_FREELIST */
+            release_free_tree(node->left, pagesize);
+        }
+        node = node->right;
+    }
+} /* release_free_tree() */
+#endif /* RELEASE_MEMORY */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_release_free_memory (void)
+
+/* Give the memory of the large free blocks of at least RELEASE_MIN_SIZE
+ * back to the system. The statistics count only the blocks of this
+ * release, as the blocks released earlier may have been allocated again
+ * meanwhile.
+ */
+
+{
+    last_release_time = current_time;
+    large_released_stat.counter = 0;
+    large_released_stat.size = 0;
+
+#if defined(RELEASE_MEMORY) && defined(HUGEPAGE_SIZE)
+    /* Don't break up the huge pages. */
+    release_free_tree(free_tree, HUGEPAGE_SIZE);
+#elif defined(RELEASE_MEMORY)
+    release_free_tree(free_tree, getpagesize());
+#endif
+} /* mem_release_free_memory() */
+
 /*-------------------------------------------------------------------------*/
 void
 mem_consolidate (Bool force)
@@ -4463,6 +5047,10 @@ mem_consolidate (Bool force)
  * If <force> is TRUE, all fully free slabs are deallocated.
  * If <force> is FALSE, only the free slabs older than SLAB_RETENTION_TIME
  * are deallocated.
+ *
+ * Afterwards the memory of the large free blocks is given back to the
+ * system if <force> is TRUE or the last release was RELEASE_TIME seconds
+ * ago.
  */
 
 {
@@ -4521,6 +5109,9 @@ mem_consolidate (Bool force)
 #ifdef MALLOC_EXT_STATISTICS
     extstat_update_max(extstats + EXTSTAT_SLABS);
 #endif /* MALLOC_EXT_STATISTICS */
+
+    if (force || current_time - last_release_time >= RELEASE_TIME)
+        mem_release_free_memory();
 } /* mem_consolidate() */
 
 /*-------------------------------------------------------------------------*/
@@ -88,6 +88,11 @@
  * Large blocks are stored with boundary tags: the size field without flags
  * is replicated in the last word of the block.
  *
+ * Every RELEASE_TIME seconds and after a GC, mem_consolidate() gives the
+ * memory of free large blocks of at least RELEASE_MIN_SIZE back to the
+ * system with madvise(MADV_DONTNEED). The blocks stay in the heap: just
+ * the pages between their AVL node and their last word are released.
+ *
  * The free large blocks are stored in an AVL tree for fast retrieval
  * of best fits. The AVL structures are stored in the user area of the blocks.
  *
@@ -239,6 +244,11 @@
 #    define MADVISE(new,old)  NOOP
 #endif
 
+#if (defined(HAVE_MADVISE) || defined(HAVE_MMAP) || defined(HAVE_POSIX_MADVISE)) \
+ && defined(MADV_DONTNEED)
+#    define RELEASE_MEMORY(p,size)  madvise(p,size,MADV_DONTNEED)
+#endif
+
 // for sysconf()
 #include <unistd.h>
 
@@ -397,6 +407,15 @@
 #    define CHUNK_SIZE    (0x40000 - GRANULARITY - EXTERN_MALLOC_OVERHEAD)
 #endif
 
+#define RELEASE_MIN_SIZE (4 * CHUNK_SIZE)
+   /* The memory of free large blocks of at least this size is given
+    * back to the system.
+    */
+
+#define RELEASE_TIME (60)
+   /* Interval in seconds in which the free memory is given back.
+    */
+
 
 /* Bitflags for the size field:
  * TODO: Assumes a 32-Bit word_t.
@@ -566,6 +585,16 @@ static t_stat sbrk_stat;
   /* Number and size of allocated heap blocks.
    */
 
+static t_stat large_released_stat = {0,0};
+  /* Number and size (in bytes) of the free large blocks whose memory was
+   * given back to the system by the last release. This figure is a subset
+   * of large_free_stat.
+   */
+
+static mp_int last_release_time = 0;
+  /* Time of the last release of free memory.
+   */
+
 static t_stat perm_alloc_stat = {0,0};
   /* Number and size of permanent allocations functions (incl overhead). This
    * figure is a subset of {small,large}_alloc_stat.
@@ -832,7 +861,7 @@ mem_dump_data (strbuf_t *sbuf)
     t_stat clib_st;
 #endif
     t_stat sbrk_st, perm_st, xalloc_st;
-    t_stat l_alloc, l_free, l_wasted;
+    t_stat l_alloc, l_free, l_wasted, l_released;
     t_stat s_alloc, s_free, s_wasted, s_chunk;
 
     /* Get a snapshot of the statistics - strbuf_add() might do further
@@ -852,6 +881,7 @@ mem_dump_data (strbuf_t *sbuf)
     l_alloc = large_alloc_stat; l_alloc.size *= GRANULARITY;
     l_free = large_free_stat; l_free.size *= GRANULARITY;
     l_wasted = large_wasted_stat;
+    l_released = large_released_stat;
     s_alloc = small_alloc_stat;
     s_free = small_free_stat;
     s_wasted = small_chunk_wasted;
@@ -869,6 +899,7 @@ mem_dump_data (strbuf_t *sbuf)
                , l_alloc.size - l_alloc.counter * ML_OVERHEAD * GRANULARITY
                );
     dump_stat("large free blocks: %8lu        %10lu (c)\n",l_free);
+    dump_stat("large released:    %8lu        %10lu    \n",l_released);
     dump_stat("large wasted:      %8lu        %10lu (d)\n\n",l_wasted);
     dump_stat("small chunks:      %8lu        %10lu (e)\n",s_chunk);
     dump_stat("small blocks:      %8lu        %10lu (f)\n",s_alloc);
@@ -1106,6 +1137,14 @@ mem_driver_info (svalue_t *svp, int value)
             put_number(svp, malloc_increment_size_total);
             break;
 
+        case DI_NUM_LARGE_BLOCKS_RELEASED:
+            put_number(svp, large_released_stat.counter);
+            break;
+
+        case DI_SIZE_LARGE_BLOCKS_RELEASED:
+            put_number(svp, large_released_stat.size);
+            break;
+
         case DI_NUM_REPLACEMENT_MALLOC_CALLS:
 #if defined(REPLACE_MALLOC)
             put_number(svp, clib_alloc_stat.counter);
@@ -3901,6 +3940,57 @@ mem_clear_ref_flags (void)
     }
 } /* mem_clear_ref_flags() */
 
+/*-------------------------------------------------------------------------*/
+static void
+mem_free_lost_small_block (word_t * q)
+
+/* Free the small block <q> which the GC found to be lost.
+ */
+
+{
+    count_back(&xalloc_stat, mem_block_size(q+M_OVERHEAD));
+    dprintf2(gcollect_outfd, "freeing small block 0x%x (user 0x%x)"
+            , (p_uint)q, (p_uint)(q+M_OVERHEAD));
+#ifdef MALLOC_TRACE
+    dprintf2(gcollect_outfd, " %s %d"
+            , q[XM_FILE+M_OVERHEAD], q[XM_LINE+M_OVERHEAD]);
+#endif
+    writes(gcollect_outfd, "\n");
+#ifdef MALLOC_LPC_TRACE
+    write_lpc_trace(gcollect_outfd, q + M_OVERHEAD, MY_FALSE);
+#endif
+    print_block(gcollect_outfd, q + M_OVERHEAD);
+
+    /* Recover the block */
+    *q |= M_REF;
+    sfree(q+M_OVERHEAD);
+} /* mem_free_lost_small_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_free_lost_large_block (word_t * p)
+
+/* Free the large block <p> (pointing to its size word) which the GC found
+ * to be lost.
+ */
+
+{
+    count_back(&xalloc_stat, mem_block_size(p+ML_OVERHEAD));
+#if defined(MALLOC_TRACE) || defined(MALLOC_LPC_TRACE)
+    dprintf1(gcollect_outfd, "freeing large block 0x%x", (p_uint)p);
+#endif
+#ifdef MALLOC_TRACE
+    dprintf3(gcollect_outfd, " %s %d size 0x%x\n",
+      p[XM_FILE+ML_OVERHEAD], p[XM_LINE+ML_OVERHEAD], *p & M_MASK
+    );
+#endif
+#ifdef MALLOC_LPC_TRACE
+    write_lpc_trace(gcollect_outfd, p + ML_OVERHEAD, MY_FALSE);
+#endif
+    print_block(gcollect_outfd, p + ML_OVERHEAD);
+    large_free((char *)(p+ML_OVERHEAD));
+} /* mem_free_lost_large_block() */
+
 /*-------------------------------------------------------------------------*/
 void
 mem_free_unrefed_memory (void)
@@ -3929,22 +4019,9 @@ mem_free_unrefed_memory (void)
             word_t size2, flags2;
 
             success++;
-            count_back(&xalloc_stat, mem_block_size(p+ML_OVERHEAD));
-#if defined(MALLOC_TRACE) || defined(MALLOC_LPC_TRACE)
-            dprintf1(gcollect_outfd, "freeing large block 0x%x", (p_uint)p);
-#endif
-#ifdef MALLOC_TRACE
-            dprintf3(gcollect_outfd, " %s %d size 0x%x\n",
-              p[XM_FILE+ML_OVERHEAD], p[XM_LINE+ML_OVERHEAD], size & M_MASK
-            );
-#endif
-#ifdef MALLOC_LPC_TRACE
-            write_lpc_trace(gcollect_outfd, p + ML_OVERHEAD, MY_FALSE);
-#endif
-            print_block(gcollect_outfd, p + ML_OVERHEAD);
             size2 = p[size];
             flags2 = p[size + 1];
-            large_free((char *)(p+ML_OVERHEAD));
+            mem_free_lost_large_block(p);
             if ( !(flags2 & THIS_BLOCK) )
                 size += size2;
         }
@@ -3977,22 +4054,7 @@ mem_free_unrefed_memory (void)
             {
                 /* Unref'd small blocks are definitely lost */
                 success++;
-                count_back(&xalloc_stat, mem_block_size(q+M_OVERHEAD));
-                dprintf2(gcollect_outfd, "freeing small block 0x%x (user 0x%x)"
-                        , (p_uint)q, (p_uint)(q+M_OVERHEAD));
-#ifdef MALLOC_TRACE
-                dprintf2(gcollect_outfd, " %s %d"
-                        , q[XM_FILE+M_OVERHEAD], q[XM_LINE+M_OVERHEAD]);
-#endif
-                writes(gcollect_outfd, "\n");
-#ifdef MALLOC_LPC_TRACE
-                write_lpc_trace(gcollect_outfd, q + M_OVERHEAD, MY_FALSE);
-#endif
-                print_block(gcollect_outfd, q + M_OVERHEAD);
-
-                /* Recover the block */
-                *q |= M_REF;
-                sfree(q+M_OVERHEAD);
+                mem_free_lost_small_block(q);
             }
             q += size & M_MASK;
         }
@@ -4002,6 +4064,131 @@ mem_free_unrefed_memory (void)
     }
 } /* mem_free_unrefed_memory() */
 
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_clear_ref_flags (void)
+
+/* Start clearing the M_REF flags incrementally. smalloc clears all of
+ * them at once in mem_clear_ref_flags().
+ */
+
+{
+    NOOP;
+} /* mem_begin_clear_ref_flags() */
+
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_free_unrefed_memory (void)
+
+/* Start freeing the unreferenced memory incrementally. smalloc frees all
+ * of it at once.
+ */
+
+{
+    mem_free_unrefed_memory();
+} /* mem_begin_free_unrefed_memory() */
+
+/*-------------------------------------------------------------------------*/
+p_int
+mem_list_unrefed_memory (void ** list, p_int max)
+
+/* The GC marked all used memory as REF'd: store the allocations which
+ * haven't been marked in <list>, but not more than <max> of them. Nothing
+ * is freed: this is done by a snapshot GC in a child process, the driver
+ * itself frees the allocations with mem_begin_free_listed_memory().
+ * Return the number of allocations, or -1 if there are more than <max>.
+ */
+
+{
+    word_t *p, *q, *last;
+    p_int num = 0;
+
+    /* Scan the heap for lost large blocks */
+    last = heap_end - TL_OVERHEAD;
+    for (p = heap_start; p < last; p += *p)
+    {
+        if ( (p[1] & (M_REF|THIS_BLOCK|M_GC_FREE)) == (THIS_BLOCK|M_GC_FREE) )
+        {
+            if (num >= max)
+                return -1;
+            list[num++] = p + ML_OVERHEAD;
+        }
+    }
+
+    /* Scan the small chunks for lost small blocks */
+    for (p = last_small_chunk; p; p = *(word_t**)p)
+    {
+        word_t *end;
+
+        end = p - ML_OVERHEAD + p[-ML_OVERHEAD];
+        for (q = p+1; q < end; q += *q & M_MASK)
+        {
+            if ((*q & (M_REF|M_GC_FREE)) == M_GC_FREE)
+            {
+                if (num >= max)
+                    return -1;
+                list[num++] = q + M_OVERHEAD;
+            }
+        }
+    }
+
+    return num;
+} /* mem_list_unrefed_memory() */
+
+/*-------------------------------------------------------------------------*/
+void
+mem_begin_free_listed_memory (void ** list, p_int num)
+
+/* Free the <num> allocations in <list> which a snapshot GC found to be
+ * unreferenced. smalloc frees all of them at once.
+ */
+
+{
+    p_int i;
+    mp_int small_freed = 0, large_freed = 0;
+
+    for (i = 0; i < num; i++)
+    {
+        word_t * q = (word_t *)list[i] - M_OVERHEAD;
+
+        /* As nothing references the blocks, they are still allocated:
+         * the flags are checked just in case.
+         */
+        if (!(q[M_SIZE] & M_GC_FREE))
+            continue;
+        if ((q[M_SIZE] & M_MASK) <= SMALL_BLOCK_MAX)
+        {
+            small_freed++;
+            mem_free_lost_small_block(q);
+        }
+        else if (q[M_SIZE] & THIS_BLOCK)
+        {
+            large_freed++;
+            mem_free_lost_large_block(q + M_LSIZE);
+        }
+    }
+
+    if (large_freed)
+    {
+        dprintf1(gcollect_outfd, "%d large blocks freed\n", large_freed);
+    }
+    if (small_freed)
+    {
+        dprintf1(gcollect_outfd, "%d small blocks freed\n", small_freed);
+    }
+} /* mem_begin_free_listed_memory() */
+
+/*-------------------------------------------------------------------------*/
+Bool
+mem_gc_step (void)
+
+/* Do the next step of an incremental GC: smalloc has none.
+ */
+
+{
+    return MY_FALSE;
+} /* mem_gc_step() */
+
 /*-------------------------------------------------------------------------*/
 Bool
 mem_dump_memory (int fd)
@@ -4139,6 +4326,78 @@ mem_dump_memory (int fd)
     return MY_TRUE;
 } /* mem_dump_memory() */
 
+/*-------------------------------------------------------------------------*/
+#ifdef RELEASE_MEMORY
+static void
+release_free_block (struct free_block * b, size_t pagesize)
+
+/* Give the memory of the free large block with the node <b> back to the
+ * system. The node and the size copy at the end of the block are kept,
+ * so just the full pages inbetween are released.
+ */
+
+{
+    word_t * ptr = (word_t *)b - M_OVERHEAD;
+    char * start, * end;
+
+    start = (char *)(b + 1);
+    start = (char *)(((p_uint)start + pagesize - 1) & ~(p_uint)(pagesize - 1));
+    end = (char *)(ptr + b->size - 2);
+    end = (char *)((p_uint)end & ~(p_uint)(pagesize - 1));
+
+    if (start < end && !RELEASE_MEMORY(start, end - start))
+        count_up(&large_released_stat, end - start);
+} /* release_free_block() */
+
+/*-------------------------------------------------------------------------*/
+static void
+release_free_tree (struct free_block * node, size_t pagesize)
+
+/* Release the memory of all blocks of at least RELEASE_MIN_SIZE in the
+ * subtree <node> of the free tree. As the tree is sorted by size, the
+ * left subtrees of small nodes can be skipped.
+ */
+
+{
+    while (node != NULL)
+    {
+        if (node->size * GRANULARITY >= RELEASE_MIN_SIZE)
+        {
+#ifdef USE_AVL_FREELIST
+            struct free_block * b;
+
+            for (b = node; b != NULL; b = b->next)
+                release_free_block(b, pagesize);
+#else
+            release_free_block(node, pagesize);
+#endif /* USE_AVL_FREELIST */
+            release_free_tree(node->left, pagesize);
+        }
+        node = node->right;
+    }
+} /* release_free_tree() */
+#endif /* RELEASE_MEMORY */
+
+/*-------------------------------------------------------------------------*/
+static void
+mem_release_free_memory (void)
+
+/* Give the memory of the large free blocks of at least RELEASE_MIN_SIZE
+ * back to the system. The statistics count only the blocks of this
+ * release, as the blocks released earlier may have been allocated again
+ * meanwhile.
+ */
+
+{
+    last_release_time = current_time;
+    large_released_stat.counter = 0;
+    large_released_stat.size = 0;
+
+#ifdef RELEASE_MEMORY
+    release_free_tree(free_tree, getpagesize());
+#endif /* RELEASE_MEMORY */
+} /* mem_release_free_memory() */
+
 /*-------------------------------------------------------------------------*/
 void
 mem_consolidate (Bool force)
@@ -4148,6 +4407,10 @@ mem_consolidate (Bool force)
  * If <force> is TRUE, the small free blocks are defragmented first.
  * Then, the function walks the list of small chunks and free all which are
  * totally unused.
+ *
+ * Afterwards the memory of the large free blocks is given back to the
+ * system if <force> is TRUE or the last release was RELEASE_TIME seconds
+ * ago.
  */
 
 {
@@ -4188,6 +4451,9 @@ mem_consolidate (Bool force)
             this = *(word_t**)this;
         }
     } /* for (all chunks) */
+
+    if (force || current_time - last_release_time >= RELEASE_TIME)
+        mem_release_free_memory();
 } /* mem_consolidate() */
 
 
@@ -12,6 +12,11 @@ extern void mem_dump_data(strbuf_t *sbuf);
 extern void mem_dump_extdata(strbuf_t *sbuf);
 extern void mem_clear_ref_flags(void);
 extern void mem_free_unrefed_memory(void);
+extern void mem_begin_clear_ref_flags(void);
+extern void mem_begin_free_unrefed_memory(void);
+extern Bool mem_gc_step(void);
+extern p_int mem_list_unrefed_memory(void ** list, p_int max);
+extern void mem_begin_free_listed_memory(void ** list, p_int num);
 extern void mem_consolidate (Bool force);
 extern void walk_new_small_malloced( void (*func)(void *, long) );
 #ifdef MALLOC_CHECK
@@ -469,6 +469,9 @@ struct_new (struct_type_t *pSType)
         svalue_t       *svp;
 
         pStruct->ref = 1;
+#ifdef USE_CYCLE_COLLECTOR
+        pStruct->cc_root = 0;
+#endif
         pStruct->type = ref_struct_type(pSType);
         if (current_object)
             pStruct->user = current_object->user;
@@ -830,6 +833,11 @@ struct_free_empty (struct_t *pStruct)
     size_struct -= STRUCT_MEMSIZE(pStruct);
     pStruct->user->struct_total -= STRUCT_MEMSIZE(pStruct);
 
+#ifdef USE_CYCLE_COLLECTOR
+    if (pStruct->cc_root)
+        cc_forget_root(pStruct->cc_root);
+#endif
+
     /* Don't free_struct_type(pStruct->type) */
 
     xfree(pStruct);
@@ -1177,8 +1185,12 @@ clear_struct_name_ref (struct_name_t * pSName)
         pSName->ref = 0;
         pSName->name->info.ref = 0;
         pSName->prog_name->info.ref = 0;
-        pSName->lpctype = NULL;
-        pSName->current = NULL;
+        /* The snapshot GC keeps them, see count_tabled_struct_refs(). */
+        if (!gc_in_snapshot)
+        {
+            pSName->lpctype = NULL;
+            pSName->current = NULL;
+        }
     }
 
 } /* clear_struct_name_ref() */
@@ -1193,6 +1205,13 @@ clear_struct_ref (struct_t * pStruct)
 {
     if (pStruct->ref != 0)
     {
+        if (gc_in_snapshot)
+        {
+            svalue_t sv;
+
+            put_struct(&sv, pStruct);
+            note_snapshot_ref(&sv);
+        }
         clear_memory_reference(pStruct);
         pStruct->ref = 0;
         clear_struct_type_ref(pStruct->type);
@@ -1301,6 +1320,39 @@ clear_tabled_struct_refs (void)
     }
 } /* clear_tabled_struct_refs() */
 
+/*-------------------------------------------------------------------------*/
+void
+count_tabled_struct_refs (void)
+
+/* Snapshot GC support: Count all struct names in the hash table, and the
+ * struct types and lpctypes cached in them. The driver can still find
+ * them there, even if only garbage references them.
+ */
+
+{
+
+    if (table && table_size)
+    {
+        size_t num;
+
+        for (num = 0; num < table_size; num++)
+        {
+            struct_name_t * pSName;
+            for (pSName = table[num]; pSName != NULL; pSName = pSName->next)
+            {
+                count_struct_name_ref(pSName);
+                if (pSName->current)
+                    count_struct_type_ref(pSName->current);
+                if (pSName->lpctype)
+                {
+                    count_lpctype_ref(pSName->lpctype);
+                    count_cached_lpctype_refs(pSName->lpctype);
+                }
+            }
+        }
+    }
+} /* count_tabled_struct_refs() */
+
 /*-------------------------------------------------------------------------*/
 void
 remove_unreferenced_structs (void)
@@ -5,6 +5,7 @@
 
 #include "typedefs.h"
 
+#include "cyclegc.h"
 #include "exec.h"
 #include "hash.h"
 #include "svalue.h"
@@ -27,6 +28,10 @@ struct struct_s
     struct_type_t * type;  /* The type object */
     p_int           ref;   /* Number of references */
     wiz_list_t    * user;  /* Who made the struct */
+#ifdef USE_CYCLE_COLLECTOR
+    uint32_t        cc_root;
+      /* Index+1 in the roots of the cycle collector, or 0 */
+#endif
     svalue_t        member[1 /* .type->num_members */ ];
       /* The struct member values */
 };
@@ -144,6 +149,7 @@ extern void clear_tabled_struct_refs (void);
 extern void count_struct_type_ref (struct_type_t * pSType);
 extern void count_struct_name_ref (struct_name_t * pSName);
 extern void count_struct_ref (struct_t * pStruct);
+extern void count_tabled_struct_refs (void);
 extern void remove_unreferenced_structs (void);
 
 #endif /* GC_SUPPORT */
@@ -248,7 +254,8 @@ static INLINE struct_name_t *ref_struct_name(struct_name_t *t)
 
 /* void free_struct(struct_t *t)
  *   Subtract one ref from struct <t>, and free the struct
- *   fully if the refcount reaches zero.
+ *   fully if the refcount reaches zero. Otherwise <t> may have become
+ *   cyclic garbage and is handed to the cycle collector.
  *
  * void free_struct_type(struct_type_t *t)
  *   Subtract one ref from struct typeobject <t>, and free the typeobject
@@ -262,6 +269,10 @@ static INLINE void free_struct(struct_t *t)
 {
     if (--(t->ref) <= 0)
         struct_free(t);
+#ifdef USE_CYCLE_COLLECTOR
+    else if (cycle_collection && !t->cc_root)
+        cc_add_struct(t);
+#endif
 }
 static INLINE void free_struct_type(struct_type_t *t)
 {
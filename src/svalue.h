@@ -140,20 +140,39 @@ union u {
  * T_LVALUEs are also used to reference meta data, like T_ERROR_HANDLER
  * svalues. TODO: Maybe they should get the T_META type.
  */
+
+#if defined(USE_COMPACT_SVALUES) && SIZEOF_CHAR_P == 8 && defined(__GNUC__) \
+ && (defined(__x86_64__) || defined(__aarch64__))
+#    define COMPACT_SVALUES
+#endif
+  /* With COMPACT_SVALUES, the type fields are just 16 bits wide (as on
+   * 32-bit hosts) and the svalue is packed into 12 bytes instead of 16.
+   * The value itself is then not aligned to 8 bytes, so this is only
+   * allowed on hosts which can load unaligned pointers.
+   */
+
+#ifdef COMPACT_SVALUES
+typedef int16_t sv_half_t;
+#else
+typedef ph_int sv_half_t;
+#endif
+  /* The type of the primary and secondary type fields.
+   */
+
 struct svalue_s
 {
-    ph_int type;  /* Primary type information */
-    union {       /* Secondary type information */
+    sv_half_t type;  /* Primary type information */
+    union {          /* Secondary type information */
 #ifndef FLOAT_FORMAT_2
-        int16_t exponent;    /* Exponent of a T_FLOAT */
+        int16_t exponent;       /* Exponent of a T_FLOAT */
 #endif
-        ph_int closure_type; /* Type of a T_CLOSURE */
-        ph_int lvalue_type;  /* Type of a T_LVALUE */
-        ph_int quotes;       /* Number of quotes of a quoted array or symbol */
-        ph_int num_arg;      /* used by call_out.c to for vararg callouts */
-        ph_int extern_args;  /* Callbacks: true if the argument memory was
-                              * allocated externally */
-        ph_int generic;
+        sv_half_t closure_type; /* Type of a T_CLOSURE */
+        sv_half_t lvalue_type;  /* Type of a T_LVALUE */
+        sv_half_t quotes;       /* Number of quotes of a quoted array or symbol */
+        sv_half_t num_arg;      /* used by call_out.c to for vararg callouts */
+        sv_half_t extern_args;  /* Callbacks: true if the argument memory was
+                                 * allocated externally */
+        sv_half_t generic;
           /* For types without secondary type information, this is set to
            * a fixed value, usually (u.number << 1).
            * Also, this field is also used as generic 'secondary type field'
@@ -161,13 +180,19 @@ struct svalue_s
            */
     } x;
     union u u;  /* The value */
-};
+}
+#ifdef COMPACT_SVALUES
+__attribute__((packed, aligned(4)))
+#endif
+;
 
-#define SVALUE_FULLTYPE(svp) ((p_int *)(svp))
-  /* Return a pointer to an integer with the primary and secondary type
-   * information.
+#ifdef COMPACT_SVALUES
+#define SVALUE_FULLTYPE(svp) (*(int32_t *)(svp))
+#else
+#define SVALUE_FULLTYPE(svp) (*(p_int *)(svp))
+#endif
+  /* Return an integer with the primary and secondary type information.
    */
-/* TODO: Sanity test: sizeof struct { ph_int, ph_int } <= sizeof p_int */
 
 
 /* struct svalue_s.type: Primary types.
@@ -302,12 +302,12 @@ static unsigned char *free_swapped_svalues(svalue_t *, mp_int, unsigned char *);
 static unsigned char * dump_swapped_values (mp_int num, unsigned char * p, int indent);
 
 /*-------------------------------------------------------------------------*/
-static Bool
+Bool
 locate_out (program_t *prog)
 
 /* Prepare program <prog> for swap out: all pointers within the program
  * memory block are changed into offsets relative to the start of the
- * area.
+ * area. The program cache uses this as well.
  *
  * Return TRUE on success.
  */
@@ -341,7 +341,7 @@ locate_out (program_t *prog)
 
 
 /*-------------------------------------------------------------------------*/
-static Bool
+Bool
 locate_in (program_t *prog)
 
 /* After <prog> was swapped in, restore the intra-block pointers
@@ -2174,6 +2174,7 @@ load_ob_from_swap (object_t *ob)
         ob->prog = prog;
         locate_in (prog); /* relocate the internal pointers */
         prog->line_numbers = NULL;
+        prog->call_caches = NULL;
 
         /* The reference count will already be 1 ! */
 
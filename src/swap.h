@@ -16,6 +16,8 @@ extern mp_int total_num_prog_blocks;
 extern mp_int total_prog_block_size;
 
 /* --- Prototypes --- */
+extern Bool locate_out(program_t *prog);
+extern Bool locate_in(program_t *prog);
 extern Bool swap_program(object_t *ob);
 extern Bool swap_variables(object_t *ob);
 extern Bool swap(object_t *ob, int mode);
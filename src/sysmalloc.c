@@ -209,6 +209,8 @@ mem_driver_info (svalue_t *svp, int value)
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_INSPECTED:
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_MERGED:
         case DI_NUM_MEMORY_DEFRAGMENTATION_BLOCKS_RESULTING:
+        case DI_NUM_LARGE_BLOCKS_RELEASED:
+        case DI_SIZE_LARGE_BLOCKS_RELEASED:
         case DI_MEMORY_EXTENDED_STATISTICS:
             put_number(svp, 0);
             break;
@@ -15,6 +15,7 @@ typedef struct action_s           action_t;           /* sent.h */
 // NOTE: mk_bytecode_gen.sh assumes that sizeof(bytecode_t) == 1
 typedef unsigned char             bytecode_t;         /* bytecode.h */
 typedef bytecode_t              * bytecode_p;         /* bytecode.h */
+typedef struct call_cache_s       call_cache_t;       /* interpret.c */
 typedef struct callback_s         callback_t;         /* simulate.h */
 typedef struct case_list_entry_s  case_list_entry_t;  /* switch.h */
 typedef struct case_state_s       case_state_t;       /* switch.h */
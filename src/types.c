@@ -727,9 +727,14 @@ clear_lpctype_ref (lpctype_t *t)
 
     /* Not reference counted pointers become NULL, so they don't
      * become dangling pointers after GC collected their blocks.
+     * A snapshot GC doesn't collect anything itself, the driver
+     * keeps using these pointers (see count_cached_lpctype_refs()).
      */
-    t->array_of = NULL;
-    t->unions_of = NULL;
+    if (!gc_in_snapshot)
+    {
+        t->array_of = NULL;
+        t->unions_of = NULL;
+    }
 
     switch(t->t_class)
     {
@@ -739,7 +744,8 @@ clear_lpctype_ref (lpctype_t *t)
     case TCLASS_STRUCT:
         if (t->t_struct.name)
             clear_struct_name_ref(t->t_struct.name);
-        t->t_struct.def = NULL;
+        if (!gc_in_snapshot)
+            t->t_struct.def = NULL;
         break;
 
     case TCLASS_ARRAY:
@@ -753,8 +759,10 @@ clear_lpctype_ref (lpctype_t *t)
         /* Mark it as not-yet counted. We need this mark
          * for static lpctype objects, because there
          * test_memory_reference() doesn't work.
+         * The snapshot GC leaves the union in its list.
          */
-        t->t_union.next = lpctype_void;
+        if (!gc_in_snapshot)
+            t->t_union.next = lpctype_void;
         break;
     }
 
@@ -834,4 +842,54 @@ count_lpctype_ref (lpctype_t *t)
     }
 } /* count_lpctype_ref() */
 
+/*-------------------------------------------------------------------------*/
+void
+count_cached_lpctype_refs (lpctype_t *t)
+
+/* Snapshot GC support: Count all types cached in <t>, and the types
+ * cached in them. The driver can still find them there, even if only
+ * garbage references them.
+ */
+
+{
+    lpctype_t *u;
+
+    if (t->t_class == TCLASS_STRUCT && t->t_struct.def)
+        count_struct_type_ref(t->t_struct.def);
+
+    if (t->array_of)
+    {
+        count_lpctype_ref(t->array_of);
+        count_cached_lpctype_refs(t->array_of);
+    }
+
+    for (u = t->unions_of; u != NULL; u = u->t_union.next)
+    {
+        count_lpctype_ref(u);
+        count_cached_lpctype_refs(u);
+    }
+} /* count_cached_lpctype_refs() */
+
+/*-------------------------------------------------------------------------*/
+void
+count_static_lpctype_refs (void)
+
+/* Snapshot GC support: Count all types cached in the static types.
+ */
+
+{
+    count_cached_lpctype_refs(lpctype_int);
+    count_cached_lpctype_refs(lpctype_string);
+    count_cached_lpctype_refs(lpctype_object);
+    count_cached_lpctype_refs(lpctype_mapping);
+    count_cached_lpctype_refs(lpctype_float);
+    count_cached_lpctype_refs(lpctype_mixed);
+    count_cached_lpctype_refs(lpctype_closure);
+    count_cached_lpctype_refs(lpctype_symbol);
+    count_cached_lpctype_refs(lpctype_quoted_array);
+    count_cached_lpctype_refs(lpctype_any_struct);
+    count_cached_lpctype_refs(lpctype_void);
+    count_cached_lpctype_refs(lpctype_unknown);
+} /* count_static_lpctype_refs() */
+
 #endif /* GC_SUPPORT */
@@ -291,6 +291,8 @@ static INLINE fulltype_t get_fulltype(lpctype_t *t)
 
 extern void clear_lpctype_ref (lpctype_t *t);
 extern void count_lpctype_ref (lpctype_t *t);
+extern void count_cached_lpctype_refs (lpctype_t *t);
+extern void count_static_lpctype_refs (void);
 
 /* void clear_fulltype_ref(fulltype_t &t)
  *   Clear all references associated with <t>.
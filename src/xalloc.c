@@ -309,6 +309,22 @@ mdb_log_sbrk (p_int size)
  *     Free all memory marked as 'unreferenced'.
  *     This routine also has to accordingly adjust xalloc_stat.
  *
+ *   void mem_begin_clear_ref_flags()
+ *   void mem_begin_free_unrefed_memory()
+ *   Bool mem_gc_step()
+ *     Incremental variants of the above: the _begin functions start
+ *     the clearing resp. freeing, each mem_gc_step() does a bounded part
+ *     of it and returns FALSE when all is done. mem_clear_ref_flags()
+ *     completes a begun clearing. Allocators without incremental support
+ *     do all the work in the _begin or the final call.
+ *
+ *   p_int mem_list_unrefed_memory(void ** list, p_int max)
+ *   void mem_begin_free_listed_memory(void ** list, p_int num)
+ *     For a GC marking a snapshot of the memory in a child process: the
+ *     child lists the unreferenced allocations instead of freeing them,
+ *     the driver frees them from the list, incrementally by mem_gc_step()
+ *     if supported.
+ *
 #ifdef MALLOC_TRACE
  *   static Bool mem_is_freed (void * p, size_t minsize)
  *     Return true if <p> is a free block.
@@ -373,6 +389,30 @@ xalloced_size (void * p
 #endif
 } /* xalloced_size() */
 
+/*-------------------------------------------------------------------------*/
+size_t
+xalloc_usable_size (void * p
+#ifdef NO_MEM_BLOCK_SIZE
+                             UNUSED
+#endif /* NO_MEM_BLOCK_SIZE */
+                   )
+
+/* Return the number of bytes usable in block <p>. This can be more than
+ * was asked for, as the allocators round up the sizes. If the allocator
+ * can't tell the size, 0 is returned.
+ */
+
+{
+#ifndef NO_MEM_BLOCK_SIZE
+    return xalloced_size(p) - XM_OVERHEAD_SIZE;
+#else
+#   ifdef __MWERKS__
+#       pragma unused(p)
+#   endif
+    return 0;
+#endif
+} /* xalloc_usable_size() */
+
 /*-------------------------------------------------------------------------*/
 size_t
 xalloc_overhead (void)
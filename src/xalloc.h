@@ -139,6 +139,7 @@ extern int stack_direction;
 #define rexalloc_pass(old,size) rexalloc_traced((old),(size) MTRACE_PASS)
 
 extern size_t  xalloced_size (void * p)  __attribute__((nonnull(1)));
+extern size_t  xalloc_usable_size (void * p)  __attribute__((nonnull(1)));
 extern size_t  xalloc_overhead (void);
 
 extern void * xalloc_traced(size_t size MTRACE_DECL)
@@ -190,6 +191,11 @@ extern void mem_update_stats(void);
 #ifdef GC_SUPPORT
 extern void mem_clear_ref_flags(void);
 extern void mem_free_unrefed_memory(void);
+extern void mem_begin_clear_ref_flags(void);
+extern void mem_begin_free_unrefed_memory(void);
+extern Bool mem_gc_step(void);
+extern p_int mem_list_unrefed_memory(void ** list, p_int max);
+extern void mem_begin_free_listed_memory(void ** list, p_int num);
 #endif /* GC_SUPPORT */
 
 /* --- Associated functions --- */
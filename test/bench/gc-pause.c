@@ -0,0 +1,100 @@
+/* Garbage collection pause benchmark.
+ *
+ * Builds a large heap of small arrays, strings and mappings with some
+ * cyclic garbage in between, then runs a garbage collection in one go
+ * and an incremental one, and reports how long the driver was stopped
+ * by each (DI_GC_LAST_PAUSE), and the longest slice and the number of
+ * slices of the incremental one.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --max-mapping 0 \
+ *       --max-mapping-keys 0 --hard-malloc-limit unlimited \
+ *       --no-wizlist-file --access-file none --access-log none \
+ *       -Mbench/gc-pause.c -m. 65432
+ *
+ * Change NUM_NODES to compare the pauses for different heap sizes.
+ */
+
+#include "/inc/base.inc"
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+
+#define LOG_FILE  "/gc-pause.log"
+#define NUM_NODES 1000000
+
+mixed *nodes;
+
+/* Some cyclic garbage, only a GC can free it. */
+void make_garbage(int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        mixed *a = ({ 0, "garbage " + i });
+
+        a[0] = ([ "array": a ]);
+    }
+}
+
+void make_heap()
+{
+    nodes = allocate(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; i++)
+    {
+        nodes[i] = ({ i, "node " + i, ([ i: i ]) });
+        if (i % 100 == 0)
+            make_garbage(1);
+    }
+}
+
+void report(string what)
+{
+    msg("  %-12s pause %8d us, longest slice %6d us, %6d slices\n", what
+       , driver_info(DI_GC_LAST_PAUSE), driver_info(DI_GC_MAX_SLICE)
+       , driver_info(DI_NUM_GC_SLICES));
+}
+
+/* Wait until the incremental GC is finished. */
+void wait_gc(int tries)
+{
+    /* The log is too large for read_file(), its end will do. */
+    string log = read_bytes(LOG_FILE, -100, 100);
+
+    if ((!log || strstr(log, "GC finished after") < 0) && tries < 600)
+    {
+        call_out(#'wait_gc, 1, tries + 1);
+        return;
+    }
+
+    rm(LOG_FILE);
+    report("incremental");
+    shutdown(0);
+}
+
+/* The full GC is done by the backend after this execution thread. */
+void run_incremental()
+{
+    rm(LOG_FILE);
+    report("full");
+
+    make_garbage(NUM_NODES / 100);
+    configure_driver(DC_GC_SLICE_TIME, 2000);
+    garbage_collection(LOG_FILE);
+    call_out(#'wait_gc, 0, 0);
+}
+
+void run_benchmark()
+{
+    make_heap();
+
+    msg("GC pause benchmark: %d nodes in %d MByte\n", NUM_NODES
+       , driver_info(DI_SIZE_SYS_ALLOCATED_BLOCKS) / 1048576);
+
+    garbage_collection(LOG_FILE);
+    call_out(#'run_incremental, 0);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+}
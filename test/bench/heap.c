@@ -0,0 +1,129 @@
+/* Large heap benchmark.
+ *
+ * Builds a large graph of small arrays and a large mapping, then times
+ * LPC loops which access them in random order, reporting the executed
+ * instructions per second for each, taking the best of several rounds.
+ * Unlike the loops of vm.c, these are dominated by cache and TLB misses.
+ *
+ * Run it once with a driver configured with --enable-malloc-hugepages
+ * and once without to compare a heap in huge pages with one in normal
+ * pages.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --max-mapping 0 \
+ *       --max-mapping-keys 0 --hard-malloc-limit unlimited \
+ *       --no-wizlist-file --access-file none --access-log none \
+ *       -Mbench/heap.c -m. 65432
+ */
+
+#include "/inc/base.inc"
+#include "/sys/driver_info.h"
+
+#define NUM_NODES      1000000
+#define NUM_ITERATIONS 1000000
+#define NUM_ROUNDS     5
+
+mapping rates = ([]);
+mixed *nodes;
+mapping table = ([]);
+
+int now()
+{
+    int *t = utime();
+    return t[0] * 1000000 + t[1];
+}
+
+/* Link the nodes into one cycle in random order. */
+void make_heap()
+{
+    int *order = allocate(NUM_NODES);
+
+    nodes = allocate(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; i++)
+    {
+        order[i] = i;
+        nodes[i] = ({ 0, i });
+        table[i * 7919] = nodes[i];
+    }
+
+    for (int i = NUM_NODES - 1; i > 0; i--)
+    {
+        int j = random(i + 1);
+        int tmp = order[i];
+
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    for (int i = 0; i < NUM_NODES; i++)
+        nodes[order[i]][0] = nodes[order[(i + 1) % NUM_NODES]];
+}
+
+int bench_chase()
+{
+    mixed *n = nodes[0];
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        sum += n[1];
+        n = n[0];
+    }
+    return sum;
+}
+
+int bench_lookup()
+{
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+        sum += table[random(NUM_NODES) * 7919][1];
+    return sum;
+}
+
+int bench_index()
+{
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+        sum += nodes[random(NUM_NODES)][1];
+    return sum;
+}
+
+void run(string what, closure fun)
+{
+    int start, cost;
+    float rate;
+
+    cost = get_eval_cost();
+    start = now();
+    funcall(fun);
+    rate = to_float(cost - get_eval_cost()) / (now() - start);
+    if (rate > rates[what])
+        rates[what] = rate;
+}
+
+void run_benchmark()
+{
+    make_heap();
+
+    for (int r = 0; r < NUM_ROUNDS; r++)
+    {
+        run("pointer chase", #'bench_chase);
+        run("mapping lookup", #'bench_lookup);
+        run("random index", #'bench_index);
+    }
+
+    msg("Heap benchmark: %d nodes in %d MByte, best of %d rounds, "
+        "million instructions per second\n", NUM_NODES,
+        driver_info(DI_SIZE_SYS_ALLOCATED_BLOCKS) / 1048576, NUM_ROUNDS);
+    foreach (string what: sort_array(m_indices(rates), #'>))
+        msg("  %-20s %8.2f\n", what, rates[what]);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+    shutdown(0);
+}
@@ -0,0 +1,95 @@
+/* Mapping benchmark.
+ *
+ * Times insertion, lookup, iteration and deletion on mappings which are
+ * still 'dirty', ie. which keep their entries in the hash part as they
+ * haven't been compacted by the backend yet, taking the best of several
+ * rounds.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --max-mapping 0 \
+ *       --max-mapping-keys 0 --no-wizlist-file --access-file none \
+ *       --access-log none -Mbench/mapping.c -m. 65432
+ */
+
+#include "/inc/base.inc"
+
+#define NUM_KEYS   100000
+#define NUM_ROUNDS 9
+
+int *int_keys;
+string *string_keys;
+mapping timings = ([]);
+
+int now()
+{
+    int *t = utime();
+    return t[0] * 1000000 + t[1];
+}
+
+void record(string what, int start)
+{
+    int time = now() - start;
+
+    if (!member(timings, what) || time < timings[what])
+        timings[what] = time;
+}
+
+void run_round(mixed *keys, string kind)
+{
+    mapping m = ([]);
+    int start, sum;
+
+    start = now();
+    foreach (mixed key: keys)
+        m[key] = 1;
+    record(kind + " insert", start);
+
+    start = now();
+    foreach (mixed key: keys)
+        sum += m[key];
+    record(kind + " lookup hit", start);
+
+    start = now();
+    foreach (mixed key: keys)
+        sum += member(m, ({ key }));
+    record(kind + " lookup miss", start);
+
+    start = now();
+    foreach (mixed key, int val: m)
+        sum += val;
+    record(kind + " iterate", start);
+
+    start = now();
+    foreach (mixed key: keys)
+        m_delete(m, key);
+    record(kind + " delete", start);
+}
+
+void run_benchmark()
+{
+    int_keys = allocate(NUM_KEYS);
+    string_keys = allocate(NUM_KEYS);
+    for (int i = 0; i < NUM_KEYS; i++)
+    {
+        int_keys[i] = i * 7919;
+        string_keys[i] = "key " + i;
+    }
+
+    for (int r = 0; r < NUM_ROUNDS; r++)
+    {
+        run_round(int_keys, "int");
+        run_round(string_keys, "string");
+    }
+
+    msg("Mapping benchmark: %d keys, best of %d rounds, times in ms\n",
+        NUM_KEYS, NUM_ROUNDS);
+    foreach (string what: sort_array(m_indices(timings), #'>))
+        msg("  %-20s %8.2f\n", what, timings[what] / 1000.0);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+    shutdown(0);
+}
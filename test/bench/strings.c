@@ -0,0 +1,66 @@
+/* Memory benchmark for short strings.
+ *
+ * Creates strings like the ones a mud is full of - verbs, ids, directions
+ * and property names with a few characters - both tabled (as mapping
+ * keys) and untabled (in arrays), and reports the memory and the small
+ * blocks they take.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --max-mapping 0 \
+ *       --max-mapping-keys 0 --no-wizlist-file --access-file none \
+ *       --access-log none -Mbench/strings.c -m. 65432
+ */
+
+#include "/inc/base.inc"
+#include "/sys/driver_info.h"
+
+#define NUM_STRINGS 100000
+
+mixed *keep = ({});
+
+/* Return the current memory usage. */
+mapping usage()
+{
+    return ([
+        "strings":      driver_info(DI_SIZE_STRINGS),
+        "small blocks": driver_info(DI_SIZE_SMALL_BLOCKS_ALLOCATED),
+        "total":        driver_info(DI_SIZE_MEMORY_USED),
+    ]);
+}
+
+void run_benchmark()
+{
+    mapping before, after, tabled = ([]);
+    string *untabled = allocate(NUM_STRINGS);
+    int blocks = driver_info(DI_NUM_SMALL_BLOCKS_ALLOCATED);
+
+    before = usage();
+    for (int i = 0; i < NUM_STRINGS; i++)
+    {
+        /* Lengths from 1 to 12 characters. */
+        string s = sprintf("%x", i * 7919)[0..i % 12];
+
+        untabled[i] = s + "";
+        tabled[s] = 1;
+    }
+    keep = ({ untabled, tabled });
+    after = usage();
+
+    msg("String benchmark: %d untabled and %d tabled short strings\n",
+        NUM_STRINGS, sizeof(tabled));
+    msg("  %-20s %10d\n", "average size",
+        driver_info(DI_SIZE_STRINGS) / driver_info(DI_NUM_STRINGS));
+    msg("  %-20s %10d\n", "string overhead",
+        driver_info(DI_SIZE_STRING_OVERHEAD));
+    msg("  %-20s %10d\n", "small blocks",
+        driver_info(DI_NUM_SMALL_BLOCKS_ALLOCATED) - blocks);
+    foreach (string what: sort_array(m_indices(after), #'>))
+        msg("  %-20s %10d bytes\n", what, after[what] - before[what]);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+    shutdown(0);
+}
@@ -0,0 +1,89 @@
+/* Memory benchmark for the svalue representation.
+ *
+ * Builds data shaped like the data of a running mud: player objects with
+ * a few dozen variables, inventories, property mappings and arrays of
+ * short strings and numbers. Then reports how much memory the arrays,
+ * mappings and objects take. Compare the numbers of a normal driver with
+ * those of one configured with --enable-compact-svalues.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --max-mapping 0 \
+ *       --no-wizlist-file --access-file none --access-log none \
+ *       -Mbench/svalues.c -m. 65432
+ */
+
+#include "/inc/base.inc"
+#include "/sys/driver_info.h"
+
+#define NUM_OBJECTS 2000
+
+/* The "player" program, written to disk and cloned. */
+#define PLAYER_FILE "/log/bench-svalues-player.c"
+#define PLAYER_CODE \
+    "string name, title, race, guild, *aliases;\n" \
+    "int level, hp, max_hp, sp, max_sp, xp, money, age, weight;\n" \
+    "int str, dex, con, intel, wis, cha;\n" \
+    "mapping skills, properties, quests;\n" \
+    "object *inventory;\n" \
+    "mixed *history;\n" \
+    "float ratio;\n" \
+    "void fill(int i, object *inv) {\n" \
+    "  name = \"player\" + i; title = \"the novice\"; race = \"human\";\n" \
+    "  guild = \"fighter\"; aliases = ({ \"p\" + i, \"n\" + i });\n" \
+    "  level = i % 50; hp = max_hp = 100 + i; sp = max_sp = 50 + i;\n" \
+    "  xp = i * 1000; money = i * 7; age = i * 3600; weight = 70;\n" \
+    "  str = dex = con = intel = wis = cha = 10 + i % 10;\n" \
+    "  skills = ([ \"sword\": i % 100, \"shield\": 50, \"climb\": 20,\n" \
+    "              \"swim\": 30, \"dodge\": i % 70 ]);\n" \
+    "  properties = ([ \"invisible\": 0, \"light\": 1, \"size\": 3,\n" \
+    "                  \"short\": name + \" \" + title ]);\n" \
+    "  quests = ([ \"quest\" + (i % 20): 1, \"quest\" + (i % 7): 1 ]);\n" \
+    "  inventory = inv; ratio = i / 7.0;\n" \
+    "  history = map(allocate(20), (: ({ $2, \"say\", $2 * 2 }) :), i);\n" \
+    "}\n"
+
+object *players = ({});
+
+/* Return the current memory usage. */
+mapping usage()
+{
+    return ([
+        "arrays":   driver_info(DI_SIZE_ARRAYS),
+        "mappings": driver_info(DI_SIZE_MAPPINGS),
+        "objects":  driver_info(DI_SIZE_OBJECTS),
+        "total":    driver_info(DI_SIZE_MEMORY_USED),
+    ]);
+}
+
+void run_benchmark()
+{
+    mapping before, after;
+
+    rm(PLAYER_FILE);
+    write_file(PLAYER_FILE, PLAYER_CODE);
+    load_object(PLAYER_FILE);
+
+    before = usage();
+    for (int i = 0; i < NUM_OBJECTS; i++)
+    {
+        object ob = clone_object(PLAYER_FILE);
+
+        ob->fill(i, players[<10..]);
+        players += ({ ob });
+    }
+    after = usage();
+
+    msg("svalue benchmark: memory for %d player objects, in bytes\n",
+        NUM_OBJECTS);
+    foreach (string what: sort_array(m_indices(after), #'>))
+        msg("  %-20s %10d\n", what, after[what] - before[what]);
+
+    rm(PLAYER_FILE);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+    shutdown(0);
+}
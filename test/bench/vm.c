@@ -0,0 +1,140 @@
+/* Virtual machine benchmark.
+ *
+ * Times a few kinds of tight LPC loops and reports the number of
+ * executed instructions per second for each, taking the best of several
+ * rounds. Every instruction costs one tick, so the instructions are
+ * counted by get_eval_cost().
+ *
+ * Run it once with a driver configured with --enable-jit and once
+ * without to compare the native code of hot loops with the interpreter.
+ *
+ * This is not part of the test suite, run it from the test directory with:
+ *
+ *   ../src/ldmud -u-1 -E 0 -N --max-array 0 --no-wizlist-file \
+ *       --access-file none --access-log none -Mbench/vm.c -m. 65432
+ */
+
+#include "/inc/base.inc"
+
+#define NUM_ITERATIONS 1000000
+#define NUM_ROUNDS     10
+
+mapping rates = ([]);
+
+int now()
+{
+    int *t = utime();
+    return t[0] * 1000000 + t[1];
+}
+
+int add(int a, int b) { return a + b; }
+
+int bench_loop()
+{
+    int i;
+
+    for (i = 0; i < NUM_ITERATIONS; i++)
+        ;
+    return i;
+}
+
+int bench_arithmetic()
+{
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+        sum = (sum + i * 3 - (i >> 1)) % 65536;
+    return sum;
+}
+
+int bench_float()
+{
+    float sum = 0.0;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+        sum = sum * 0.5 + i;
+    return to_int(sum);
+}
+
+int bench_array()
+{
+    int *arr = allocate(1024, 1);
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        arr[i & 1023] = i;
+        sum += arr[(i + 1) & 1023];
+    }
+    return sum;
+}
+
+int bench_local_call()
+{
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+        sum = add(sum, i) & 0xffff;
+    return sum;
+}
+
+int bench_call_other()
+{
+    object me = this_object();
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS / 4; i++)
+        sum = me->add(sum, i) & 0xffff;
+    return sum;
+}
+
+int bench_string()
+{
+    string s;
+    int sum;
+
+    for (int i = 0; i < NUM_ITERATIONS / 4; i++)
+    {
+        s = "abc" + (i & 15);
+        sum += sizeof(s);
+    }
+    return sum;
+}
+
+void run(string what, closure fun)
+{
+    int start, cost;
+    float rate;
+
+    cost = get_eval_cost();
+    start = now();
+    funcall(fun);
+    rate = to_float(cost - get_eval_cost()) / (now() - start);
+    if (rate > rates[what])
+        rates[what] = rate;
+}
+
+void run_benchmark()
+{
+    for (int r = 0; r < NUM_ROUNDS; r++)
+    {
+        run("loop", #'bench_loop);
+        run("arithmetic", #'bench_arithmetic);
+        run("float", #'bench_float);
+        run("array", #'bench_array);
+        run("local call", #'bench_local_call);
+        run("call_other", #'bench_call_other);
+        run("string", #'bench_string);
+    }
+
+    msg("VM benchmark: best of %d rounds, million instructions per second\n",
+        NUM_ROUNDS);
+    foreach (string what: sort_array(m_indices(rates), #'>))
+        msg("  %-20s %8.2f\n", what, rates[what]);
+}
+
+void epilog(int eflag)
+{
+    run_benchmark();
+    shutdown(0);
+}
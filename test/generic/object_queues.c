@@ -0,0 +1,80 @@
+/* Test for the backend's reset and clean_up queues, to be run with
+ * short reset and clean_up times (see t-object-queues.sh).
+ */
+
+#include "/inc/base.inc"
+#include "/sys/driver_hook.h"
+#include "/sys/driver_info.h"
+
+mapping noted = ([]);
+
+void note(string what, object ob)
+{
+    noted[what] = (noted[what] || ({})) + ({ ob });
+}
+
+int clean_up(int ref)
+{
+    return 1;
+}
+
+void check(object *obs)
+{
+    int errors;
+
+    if (member(noted["reset"] || ({}), obs[0]) < 0)
+    {
+        msg("FAILURE: set_next_reset() object was not reset.\n");
+        errors++;
+    }
+
+    if (member(noted["reset"] || ({}), obs[1]) >= 0)
+    {
+        msg("FAILURE: Object reset despite set_next_reset(-1).\n");
+        errors++;
+    }
+
+    if (member(noted["clean_up"] || ({}), obs[2]) < 0)
+    {
+        msg("FAILURE: clean_up() was not called.\n");
+        errors++;
+    }
+
+    if (member(noted["clean_up"] || ({}), obs[3]) < 0)
+    {
+        msg("FAILURE: clean_up() was not called for the blueprint.\n");
+        errors++;
+    }
+
+    if (!driver_info(DI_NUM_OBJECTS_RESET_QUEUE)
+     || !driver_info(DI_NUM_OBJECTS_DATA_CLEAN_QUEUE))
+    {
+        msg("FAILURE: Object queues are empty.\n");
+        errors++;
+    }
+
+    if (!errors)
+        msg("Success.\n");
+    shutdown(errors && 1);
+}
+
+string *epilog(int eflag)
+{
+    object *obs;
+
+    msg("\nRunning test for the object queues:\n"
+          "-----------------------------------\n");
+
+    set_driver_hook(H_RESET, "reset");
+    set_driver_hook(H_CLEAN_UP, "clean_up");
+
+    obs = ({ clone_object("/generic/queue_ob"),
+             clone_object("/generic/queue_ob"),
+             clone_object("/generic/queue_ob"),
+             load_object("/generic/queue_ob") });
+    obs[0]->next_reset(1);
+    obs[1]->next_reset(-1);
+
+    call_out(#'check, 10, obs);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/* Compare the program sizes of a mudlib compiled with and without the
+ * optimizer, to be run as master of a copy of the lp-245 mudlib
+ * (see t-optimizer.sh). The objects are only compiled, not created.
+ *
+ * The files to compile are listed in /files. Every one is compiled
+ * twice, once with #pragma no_optimize (given by the auto-include hook),
+ * and once without. The test fails if the optimizer changes which files
+ * compile, or doesn't make the mudlib smaller as a whole. Single programs
+ * may grow: hoisting a sizeof() out of a loop costs a few bytes.
+ */
+
+#include "/sys/debug_message.h"
+#include "/sys/driver_hook.h"
+#include "/sys/object_info.h"
+
+/* Efuns of the old driver which are no longer there */
+#define COMPAT "#define strlen sizeof\n"
+
+int optimize;
+
+static void msg(string str, varargs mixed *par)
+{
+    debug_message(apply(#'sprintf, str, par), DMSG_STDERR | DMSG_LOGFILE);
+}
+
+/* Find includes in /sys and /room, like the master of the mudlib does. */
+static string include_dirs(string name, string current_file)
+{
+    foreach (string dir: ({ "", "sys/", "room/" }))
+        if (file_size("/" + dir + name) >= 0)
+            return dir + name;
+    return 0;
+}
+
+/* Add the light mechanism to every object, like the master of the
+ * mudlib does, and turn off the optimizer in the first round.
+ */
+static string auto_include(string base_file, string current_file
+                          , int sys_include)
+{
+    string str = COMPAT;
+
+    if (current_file)
+        return 0;
+    if (!optimize)
+        str = "#pragma no_optimize\n" + str;
+    if (member(({ "obj/light.c", "obj/simul_efun.c" }), base_file) < 0)
+        str += "virtual inherit \"/obj/light\";\n";
+    return str;
+}
+
+void inaugurate_master(int arg)
+{
+    set_driver_hook(H_LOAD_UIDS, unbound_lambda(({}), "uid"));
+    set_driver_hook(H_CLONE_UIDS, unbound_lambda(({}), "uid"));
+    set_driver_hook(H_INCLUDE_DIRS, #'include_dirs);
+    set_driver_hook(H_AUTO_INCLUDE, #'auto_include);
+}
+
+string get_master_uid()
+{
+    return "uid";
+}
+
+mixed get_simul_efun()
+{
+    if (catch(load_object("/obj/simul_efun"); nolog))
+        return 0;
+    return "obj/simul_efun";
+}
+
+mixed valid_read(string path, string uid, string func, object ob)
+{
+    return 1;
+}
+
+int prepare_destruct(object ob)
+{
+    return 0;
+}
+
+void log_error(string file, string err, int warn)
+{
+    /* The errors of the old mudlib are of no interest here. */
+}
+
+/* Compile every file and return the program sizes, or 0 for the files
+ * which don't compile.
+ */
+mapping compile_all(string *files)
+{
+    mapping sizes = ([]);
+
+    foreach (string file: files)
+    {
+        object ob;
+
+        if (catch(ob = load_object(file); nolog))
+            sizes[file] = 0;
+        else
+            sizes[file] = object_info(ob, OI_PROG_SIZE);
+    }
+
+    /* Destruct everything, so that the inherited programs are compiled
+     * again in the next round.
+     */
+    foreach (object ob: objects())
+        if (ob != this_object() && ob != find_object("/obj/simul_efun"))
+            destruct(ob);
+
+    return sizes;
+}
+
+string *epilog(int eflag)
+{
+    string *files;
+    mapping plain, optimized;
+    int plain_total, optimized_total, compiled, smaller, errors;
+
+    files = explode(read_file("/files"), "\n") - ({ "" });
+
+    optimize = 0;
+    plain = compile_all(files);
+    optimize = 1;
+    optimized = compile_all(files);
+
+    foreach (string file: files)
+    {
+        if (!plain[file] != !optimized[file])
+        {
+            msg("FAILURE: %s compiles only %s the optimizer.\n"
+               , file, plain[file] ? "without" : "with");
+            errors++;
+        }
+
+        if (plain[file])
+            compiled++;
+        if (optimized[file] < plain[file])
+            smaller++;
+        plain_total += plain[file];
+        optimized_total += optimized[file];
+    }
+
+    msg("Compiled %d of %d files: %d bytes of code, %d bytes optimized, "
+        "%d programs smaller.\n"
+       , compiled, sizeof(files), plain_total, optimized_total, smaller);
+
+    if (optimized_total >= plain_total)
+    {
+        msg("FAILURE: The optimized code isn't smaller.\n");
+        errors++;
+    }
+
+    if (!errors)
+        msg("Success.\n");
+    shutdown(errors ? 1 : 0);
+    return 0;
+}
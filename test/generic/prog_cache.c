@@ -0,0 +1,206 @@
+/* Test the program cache, to be run twice as master of a copy of the
+ * lp-245 mudlib (see t-prog-cache.sh).
+ *
+ * The first run compiles the files listed in /files and writes a
+ * description of every program into /programs. The second run must get
+ * all programs from the cache, and they must look the same. It then
+ * changes an include file, which must lead to a recompilation.
+ */
+
+#include "/sys/debug_message.h"
+#include "/sys/driver_hook.h"
+#include "/sys/driver_info.h"
+#include "/sys/functionlist.h"
+#include "/sys/inherit_list.h"
+#include "/sys/object_info.h"
+
+/* Efuns of the old driver which are no longer there */
+#define COMPAT "#define strlen sizeof\n"
+
+static void msg(string str, varargs mixed *par)
+{
+    debug_message(apply(#'sprintf, str, par), DMSG_STDERR | DMSG_LOGFILE);
+}
+
+/* Find includes in /sys and /room, like the master of the mudlib does. */
+static string include_dirs(string name, string current_file)
+{
+    foreach (string dir: ({ "", "sys/", "room/" }))
+        if (file_size("/" + dir + name) >= 0)
+            return dir + name;
+    return 0;
+}
+
+/* Add the light mechanism to every object, like the master of the
+ * mudlib does. So most programs inherit /obj/light, which the cache
+ * has to load first.
+ */
+static string auto_include(string base_file, string current_file
+                          , int sys_include)
+{
+    if (current_file)
+        return 0;
+    if (member(({ "obj/light.c", "obj/simul_efun.c", "prog_cache.c" })
+              , base_file) >= 0)
+        return COMPAT;
+    return COMPAT + "virtual inherit \"/obj/light\";\n";
+}
+
+void inaugurate_master(int arg)
+{
+    set_driver_hook(H_LOAD_UIDS, unbound_lambda(({}), "uid"));
+    set_driver_hook(H_CLONE_UIDS, unbound_lambda(({}), "uid"));
+    set_driver_hook(H_INCLUDE_DIRS, #'include_dirs);
+    set_driver_hook(H_AUTO_INCLUDE, #'auto_include);
+}
+
+string get_master_uid()
+{
+    return "uid";
+}
+
+mixed get_simul_efun()
+{
+    if (catch(load_object("/obj/simul_efun"); nolog))
+        return 0;
+    return "obj/simul_efun";
+}
+
+mixed valid_read(string path, string uid, string func, object ob)
+{
+    return 1;
+}
+
+mixed valid_write(string path, string uid, string func, object ob)
+{
+    return 1;
+}
+
+int prepare_destruct(object ob)
+{
+    return 0;
+}
+
+void log_error(string file, string err, int warn)
+{
+    /* The errors of the old mudlib are of no interest here. */
+}
+
+/* Describe the program of every file, 0 for the files which don't
+ * compile. The description is a string, so it can be compared.
+ */
+mapping describe_all(string *files)
+{
+    mapping programs = ([]);
+
+    foreach (string file: files)
+    {
+        object ob;
+
+        if (catch(ob = load_object(file); nolog))
+            programs[file] = 0;
+        else
+            programs[file] = save_value(({
+                object_info(ob, OI_PROG_SIZE),
+                functionlist(ob, RETURN_FUNCTION_NAME | RETURN_FUNCTION_FLAGS
+                               | RETURN_FUNCTION_TYPE
+                               | RETURN_FUNCTION_NUMARG),
+                variable_list(ob, RETURN_FUNCTION_NAME
+                                | RETURN_FUNCTION_FLAGS
+                                | RETURN_FUNCTION_TYPE),
+                inherit_list(ob, INHLIST_TREE | INHLIST_TAG_VIRTUAL),
+                include_list(ob),
+            }));
+    }
+    return programs;
+}
+
+/* Write a test object including /test.h, which defines <value>, and
+ * check that the object sees the value.
+ */
+int check_include(string value)
+{
+    object ob;
+
+    if (ob = find_object("/test_ob"))
+        destruct(ob);
+    rm("/test.h");
+    write_file("/test.h", "#define VALUE \"" + value + "\"\n");
+    if (file_size("/test_ob.c") < 0)
+        write_file("/test_ob.c",
+            "#include \"/test.h\"\n"
+            "string query_value() { return VALUE; }\n");
+
+    if (catch(ob = load_object("/test_ob")))
+        return 0;
+    return ob->query_value() == value;
+}
+
+string *epilog(int eflag)
+{
+    string *files;
+    mapping programs;
+    int errors;
+
+    files = explode(read_file("/files"), "\n") - ({ "" });
+
+    if (file_size("/programs") < 0)
+    {
+        /* First run: fill the cache. */
+        if (!check_include("first"))
+        {
+            msg("FAILURE: The test object doesn't work.\n");
+            errors++;
+        }
+        write_file("/programs", save_value(describe_all(files)));
+        if (driver_info(DI_NUM_PROGRAM_CACHE_HITS))
+        {
+            msg("FAILURE: Cache hits in the first run.\n");
+            errors++;
+        }
+    }
+    else
+    {
+        mapping cached;
+        int hits;
+
+        /* Second run: use the cache. */
+        programs = restore_value(read_file("/programs"));
+        cached = describe_all(files);
+        foreach (string file: files)
+            if (programs[file] != cached[file])
+            {
+                msg("FAILURE: The cached program of %s differs.\n", file);
+                errors++;
+            }
+
+        hits = driver_info(DI_NUM_PROGRAM_CACHE_HITS);
+        if (hits < sizeof(filter(programs, (: $2 :))))
+        {
+            msg("FAILURE: Only %d of %d programs from the cache.\n"
+               , hits, sizeof(filter(programs, (: $2 :))));
+            errors++;
+        }
+
+        /* /test_ob is still in the cache, but /test.h changed. */
+        if (!check_include("second, longer"))
+        {
+            msg("FAILURE: A changed include file wasn't noticed.\n");
+            errors++;
+        }
+        if (driver_info(DI_NUM_PROGRAM_CACHE_HITS) != hits)
+        {
+            msg("FAILURE: The outdated program was taken from the cache.\n");
+            errors++;
+        }
+
+        msg("%d programs from the cache, %d compiled.\n"
+           , driver_info(DI_NUM_PROGRAM_CACHE_HITS)
+           , driver_info(DI_NUM_PROGRAM_CACHE_MISSES));
+        if (!errors)
+            msg("Success.\n");
+    }
+
+    shutdown(errors ? 1 : 0);
+    return 0;
+}
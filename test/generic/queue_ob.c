@@ -0,0 +1,21 @@
+/* Helper object for t-object-queues.sh */
+
+void create()
+{
+}
+
+void reset()
+{
+    __MASTER_OBJECT__->note("reset", this_object());
+}
+
+int clean_up(int ref)
+{
+    __MASTER_OBJECT__->note("clean_up", this_object());
+    return 0;
+}
+
+void next_reset(int delay)
+{
+    set_next_reset(delay);
+}
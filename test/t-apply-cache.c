@@ -0,0 +1,102 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+
+/* Tests for the resizing and the statistics of the apply cache.
+ */
+
+#define NUM_ROUNDS 10
+
+int f0() { return 0; }
+int f1() { return 1; }
+int f2() { return 2; }
+int f3() { return 3; }
+int f4() { return 4; }
+int f5() { return 5; }
+
+/* Call f0() .. f5() by name and check their results. */
+int call_all()
+{
+    for (int i = 0; i < NUM_ROUNDS; i++)
+        for (int j = 0; j < 6; j++)
+            if (call_other(this_object(), "f" + j) != j
+             || call_other(this_object(), "g" + j) != 0)
+                return 0;
+    return 1;
+}
+
+mixed *tests = ({
+    ({ "default size", 0,
+        (: driver_info(DC_APPLY_CACHE_SIZE) >= 4 :)
+    }),
+    ({ "size is rounded up", 0,
+        function int ()
+        {
+            configure_driver(DC_APPLY_CACHE_SIZE, 1000);
+            return driver_info(DC_APPLY_CACHE_SIZE) == 1024;
+        }
+    }),
+    ({ "calls with a large cache", 0, #'call_all }),
+    ({ "calls with a single set", 0,
+        function int ()
+        {
+            int evictions = driver_info(DI_NUM_FUNCTION_NAME_CALL_EVICTIONS);
+
+            configure_driver(DC_APPLY_CACHE_SIZE, 1);
+            if (driver_info(DC_APPLY_CACHE_SIZE) != 4)
+                return 0;
+            if (!call_all())
+                return 0;
+            return driver_info(DI_NUM_FUNCTION_NAME_CALL_EVICTIONS) > evictions;
+        }
+    }),
+    ({ "resizing during a call", 0,
+        function int ()
+        {
+            int res = call_other(this_object(), "resize_and_call", 64);
+            return res == 5 && driver_info(DC_APPLY_CACHE_SIZE) == 64;
+        }
+    }),
+    ({ "hits are counted", 0,
+        function int ()
+        {
+            int hits = driver_info(DI_NUM_FUNCTION_NAME_CALL_HITS);
+
+            call_all();
+            return driver_info(DI_NUM_FUNCTION_NAME_CALL_HITS) > hits;
+        }
+    }),
+    ({ "illegal size", TF_ERROR,
+        (: configure_driver(DC_APPLY_CACHE_SIZE, 0) :)
+    }),
+});
+
+int resize_and_call(int size)
+{
+    configure_driver(DC_APPLY_CACHE_SIZE, size);
+    return call_other(this_object(), "f5");
+}
+
+void run_test()
+{
+    msg("\nRunning test for the apply cache:\n"
+          "---------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                shutdown(0);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
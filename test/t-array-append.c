@@ -0,0 +1,105 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+/* Tests for arrays built by repeated appends, which are extended in
+ * place when the allocator can grow their memory block.
+ */
+
+#define NUM_ELEMENTS 2000
+
+/* Check that <arr> holds <num> elements, each the result of <fun>. */
+int check(mixed *arr, int num, closure fun)
+{
+    if (sizeof(arr) != num)
+        return 0;
+    foreach (int i: num)
+    {
+        if (arr[i] != funcall(fun, i))
+            return 0;
+    }
+    return 1;
+}
+
+mixed *tests = ({
+    ({ "strings", 0,
+        function int ()
+        {
+            string *arr = ({});
+
+            for (int i = 0; i < NUM_ELEMENTS; i++)
+                arr += ({ "x" });
+            return check(arr, NUM_ELEMENTS, (: "x" :));
+        }
+    }),
+    ({ "numbers", 0,
+        function int ()
+        {
+            int *arr = ({});
+
+            for (int i = 0; i < NUM_ELEMENTS; i++)
+                arr += ({ i });
+            return check(arr, NUM_ELEMENTS, (: $1 :));
+        }
+    }),
+    ({ "several at once", 0,
+        function int ()
+        {
+            mixed *arr = ({});
+
+            for (int i = 0; i < NUM_ELEMENTS; i += 3)
+                arr += ({ i, i + 1, i + 2 });
+            return check(arr, NUM_ELEMENTS + 1, (: $1 :));
+        }
+    }),
+    ({ "arrays", 0,
+        function int ()
+        {
+            mixed *arr = ({});
+
+            for (int i = 0; i < NUM_ELEMENTS; i++)
+                arr += ({ ({ i, "value " + i }) });
+            return check(map(arr, (: $1[0] :)), NUM_ELEMENTS, (: $1 :))
+                && check(map(arr, (: $1[1] :)), NUM_ELEMENTS,
+                         (: "value " + $1 :));
+        }
+    }),
+    ({ "shared array", 0,
+        function int ()
+        {
+            int *arr = ({});
+            int *copy;
+
+            for (int i = 0; i < NUM_ELEMENTS; i++)
+            {
+                arr += ({ i });
+                if (i == NUM_ELEMENTS / 2)
+                    copy = arr;
+            }
+            return check(arr, NUM_ELEMENTS, (: $1 :))
+                && check(copy, NUM_ELEMENTS / 2 + 1, (: $1 :));
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for array appends:\n"
+          "-------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
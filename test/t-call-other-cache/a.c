@@ -0,0 +1,2 @@
+int fun() { return 1; }
+static int hidden() { return 1; }
@@ -0,0 +1,3 @@
+inherit "/a";
+
+int fun() { return 3 * ::fun(); }
@@ -0,0 +1 @@
+int fun() { return 5; }
@@ -0,0 +1,117 @@
+/* Tests for the inline caches of call_other sites.
+ *
+ * All calls of a function go through the same ob->fun() site,
+ * which has to find the right function for each receiving program,
+ * also when there are more programs than cache entries.
+ */
+
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/deep_eq.inc"
+
+#include "/sys/driver_info.h"
+
+#define NUM_ROUNDS 10
+
+int call_fun(object ob)    { return ob->fun(); }
+int call_hidden(object ob) { return ob->hidden(); }
+mixed call_all(object *obs) { return obs->fun(); }
+
+mixed *tests = ({
+    ({ "one receiver", 0,
+        function int ()
+        {
+            object a = load_object("/a");
+            for (int i = 0; i < NUM_ROUNDS; i++)
+                if (call_fun(a) != 1)
+                    return 0;
+            return 1;
+        }
+    }),
+    ({ "several receivers", 0,
+        function int ()
+        {
+            object *obs = map(({ "/a", "/b", "/c", "/d", "/e" }), #'load_object);
+            int *expected = ({ 1, 2, 3, 0, 5 });
+
+            for (int i = 0; i < NUM_ROUNDS; i++)
+                for (int j = 0; j < sizeof(obs); j++)
+                    if (call_fun(obs[j]) != expected[j])
+                        return 0;
+            return 1;
+        }
+    }),
+    ({ "array of receivers", 0,
+        function int ()
+        {
+            object *obs = map(({ "/e", "/d", "/a" }), #'load_object);
+
+            for (int i = 0; i < NUM_ROUNDS; i++)
+                if (!deep_eq(call_all(obs), ({ 5, 0, 1 })))
+                    return 0;
+            return 1;
+        }
+    }),
+    ({ "static function", 0,
+        function int ()
+        {
+            for (int i = 0; i < NUM_ROUNDS; i++)
+                if (call_hidden(load_object("/a")) != 0)
+                    return 0;
+            return 1;
+        }
+    }),
+    ({ "shadowed receiver", 0,
+        function int ()
+        {
+            object b = clone_object("/b");
+            object sh = clone_object("/sh");
+
+            if (call_fun(b) != 2 || !sh->start(b))
+                return 0;
+            for (int i = 0; i < NUM_ROUNDS; i++)
+                if (call_fun(b) != 10 || call_fun(load_object("/b")) != 2)
+                    return 0;
+            destruct(sh);
+            return call_fun(b) == 2;
+        }
+    }),
+    ({ "reloaded receiver", 0,
+        function int ()
+        {
+            destruct(find_object("/c"));
+            return call_fun(load_object("/c")) == 3;
+        }
+    }),
+    ({ "cache statistics", 0,
+        (: driver_info(DI_NUM_CALL_SITE_CACHE_HITS) > NUM_ROUNDS
+        && driver_info(DI_NUM_CALL_SITE_CACHE_MISSES) > 0 :)
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the call_other caches:\n"
+          "---------------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                shutdown(0);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
+
+int query_allow_shadow(object victim)
+{
+    return 1;
+}
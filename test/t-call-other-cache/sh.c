@@ -0,0 +1,3 @@
+int fun() { return 10; }
+
+int start(object ob) { return shadow(ob) != 0; }
@@ -0,0 +1,124 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+#include "/inc/deep_eq.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for the callout scheduling: execution order, call_out_info(),
+ * find_call_out() and remove_call_out().
+ */
+
+string *executed = ({});
+
+void co(string tag) { executed += ({ tag }); }
+void other(string tag) { executed += ({ tag }); }
+
+void setup_callouts()
+{
+    executed = ({});
+    call_out("co", 3, "c");
+    call_out("co", 1, "a1");
+    call_out("other", 2, "b");
+    call_out("co", 1, "a2");
+    call_out("co", 0, "z");
+}
+
+mixed *tests = ({
+    ({ "call_out_info order", 0,
+        function int ()
+        {
+            mixed *info;
+
+            setup_callouts();
+            info = filter(call_out_info(), (: $1[0] == this_object() && stringp($1[1]) :));
+            return deep_eq(map(info, (: $1[3] :)), ({ "z", "a1", "a2", "b", "c" }))
+                && deep_eq(map(info, (: $1[2] :)), ({ 0, 1, 1, 2, 3 }));
+        }
+    }),
+    ({ "find_call_out 1", 0, (: find_call_out("co") == 0 :) }),
+    ({ "find_call_out 2", 0, (: find_call_out("other") == 2 :) }),
+    ({ "find_call_out 3", 0, (: find_call_out("none") == -1 :) }),
+    ({ "remove_call_out 1", 0, (: remove_call_out("co") == 0 :) }),
+    ({ "remove_call_out 2", 0, (: find_call_out("co") == 1 :) }),
+    ({ "remove_call_out 3", 0, (: remove_call_out("other") == 2 :) }),
+    ({ "remove_call_out 4", 0, (: remove_call_out("other") == -1 :) }),
+    ({ "remove_call_out 5", 0,
+        function int ()
+        {
+            closure cl = function void () { executed += ({ "cl" }); };
+
+            call_out(cl, 2);
+            return find_call_out(cl) == 2
+                && remove_call_out(cl) == 2
+                && find_call_out(cl) == -1;
+        }
+    }),
+    ({ "destructed object", 0,
+        function int ()
+        {
+            object ob = clone_object(this_object());
+
+            ob->start_callouts();
+            destruct(ob);
+            return !sizeof(filter(call_out_info(), (: !$1[0] :)));
+        }
+    }),
+    ({ "call_out_info after removal", 0,
+        function int ()
+        {
+            mixed *info = filter(call_out_info(), (: $1[0] == this_object() && stringp($1[1]) :));
+            return deep_eq(map(info, (: $1[3] :)), ({ "a1", "a2", "c" }));
+        }
+    }),
+});
+
+void start_callouts()
+{
+    call_out("co", 100, "clone 1");
+    call_out(#'co, 100, "clone 2");
+    call_out(function void () { co("clone 3"); }, 100);
+}
+
+void check_execution()
+{
+    if (!deep_eq(executed, ({ "a1", "a2", "c" })))
+    {
+        msg("Callouts executed in wrong order: %O\n", executed);
+        shutdown(1);
+        return;
+    }
+
+    if (driver_info(DI_NUM_CALLOUTS) != 0)
+    {
+        msg("Callouts of destructed object were not removed: %d left.\n",
+            driver_info(DI_NUM_CALLOUTS));
+        shutdown(1);
+        return;
+    }
+
+    msg("Callouts executed in order.\n");
+    start_gc(#'shutdown);
+}
+
+void run_test()
+{
+    msg("\nRunning test for call_out scheduling:\n"
+          "-------------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                call_out("check_execution", 5);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
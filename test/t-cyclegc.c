@@ -0,0 +1,151 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+
+/* Tests for the cycle collector.
+ */
+
+struct node
+{
+    mixed next;
+};
+
+mixed *kept;
+mixed *ring;
+closure cl;
+int ring_ok;
+int freed;
+
+/* Some cyclic garbage: 9 arrays, mappings and structs, one of them
+ * only referenced by a cycle.
+ */
+void make_garbage()
+{
+    mixed *a = ({ 0 });
+    mixed *b = ({ 0 });
+    mixed *c = ({ 0, ({ 1, 2 }) });
+    mapping m = ([]), k1 = ([]), k2 = ([]);
+    struct node s = (<node>);
+
+    a[0] = a;
+
+    m["b"] = b;
+    b[0] = m;
+
+    s->next = ({ s });
+
+    k1[k2] = 1;
+    k2[k1] = 1;
+
+    c[0] = c;
+}
+
+/* Some cycles that are still referenced. */
+void make_data()
+{
+    mixed *x, *d = ({ 0 });
+
+    kept = ({ 0, ([ "data": 42 ]) });
+    kept[0] = kept;
+    x = kept;
+    x = 0;
+
+    d[0] = d;
+    cl = function mixed * () { return d; };
+}
+
+/* A ring of 5 arrays, too long for 2 nodes per step. */
+void make_ring()
+{
+    mixed *first = ({ 0 }), *last = first;
+
+    for (int i = 0; i < 4; i++)
+        last = ({ last });
+    first[0] = last;
+    ring = first;
+}
+
+int check_ring()
+{
+    mixed *r = ring;
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (!pointerp(r))
+            return 0;
+        r = r[0];
+    }
+    return r == ring;
+}
+
+mixed *tests = ({
+    ({ "illegal number", TF_ERROR,
+        (: configure_driver(DC_CYCLE_COLLECTION, -1) :)
+    }),
+    ({ "setting", 0,
+        (: driver_info(DC_CYCLE_COLLECTION) == 1000 :)
+    }),
+    ({ "roots scanned", 0,
+        (: driver_info(DI_NUM_CC_ROOTS_SCANNED) > 0 :)
+    }),
+    ({ "garbage freed", 0,
+        (: driver_info(DI_NUM_CC_FREED) - freed == 9 :)
+    }),
+    ({ "data kept", 0,
+        (: kept[0] == kept && kept[1]["data"] == 42 :)
+    }),
+    ({ "closure references kept", 0,
+        (: funcall(cl)[0] == funcall(cl) :)
+    }),
+    ({ "partial scan", 0,
+        (: ring_ok && check_ring() :)
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the cycle collector:\n"
+          "-------------------------------------\n");
+
+    run_array(tests,
+        (:
+            configure_driver(DC_CYCLE_COLLECTION, 0);
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+/* The ring survived the steps with a small table, now try the others. */
+void check_partial()
+{
+    ring_ok = check_ring();
+
+    configure_driver(DC_CYCLE_COLLECTION, 1000);
+    freed = driver_info(DI_NUM_CC_FREED);
+    make_garbage();
+    make_data();
+
+    call_out(#'run_test, 2);
+}
+
+string *epilog(int eflag)
+{
+#ifndef __CYCLE_COLLECTOR__
+    /* Not compiled in, nothing to test. */
+    start_gc(#'shutdown);
+    return 0;
+#endif
+
+    configure_driver(DC_CYCLE_COLLECTION, 2);
+    make_ring();
+
+    call_out(#'check_partial, 2);
+    return 0;
+}
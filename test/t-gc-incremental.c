@@ -0,0 +1,165 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+
+/* Tests for the incremental garbage collection.
+ */
+
+#define LOG_FILE "/log/t-gc-incremental.log"
+
+mixed *kept = ({});
+mapping stale = ([]);
+object *clones = ({});
+string log;
+
+/* Some cyclic garbage, only a GC can free it. */
+void make_garbage()
+{
+    for (int i = 0; i < 100; i++)
+    {
+        mixed *a = ({ 0, "garbage " + i });
+
+        a[0] = ([ "array": a ]);
+    }
+}
+
+/* Destructed objects only referenced from the garbage, the GC has to drop
+ * these references.
+ */
+void make_dangling()
+{
+    foreach (int i: 3)
+    {
+        mixed *a = ({ 0, clone_object(this_object()) });
+
+        a[0] = a;
+        destruct(a[1]);
+    }
+}
+
+/* Some data that must survive the GC. */
+void make_data(int n)
+{
+    kept += ({ ({ n, sprintf("data %d", n), ([ n: ({ n }) ]) }) });
+}
+
+/* A mapping with a destructed key, its data is only referenced there.
+ * The mapping must not be touched before the GC, and there must be more
+ * objects than destructed ones, or the key is removed beforehand.
+ */
+void make_stale()
+{
+    object ob = clone_object(this_object());
+
+    foreach (int i: 2)
+        clones += ({ clone_object(this_object()) });
+    stale[ob] = ({ "stale data", object_name(ob) });
+    destruct(ob);
+}
+
+int check_stale()
+{
+    mixed *values = m_values(stale);
+
+    stale = 0;
+    return sizeof(values) == 0
+        || (sizeof(values) == 1 && values[0][0] == "stale data");
+}
+
+int check_data()
+{
+    foreach (int n: sizeof(kept))
+    {
+        if (kept[n][0] != n || kept[n][1] != sprintf("data %d", n)
+         || kept[n][2][n][0] != n)
+            return 0;
+    }
+    return sizeof(kept) > 0;
+}
+
+mixed *tests = ({
+    ({ "illegal slice time", TF_ERROR,
+        (: configure_driver(DC_GC_SLICE_TIME, -1) :)
+    }),
+    ({ "slice time", 0,
+        (: driver_info(DC_GC_SLICE_TIME) == 1 :)
+    }),
+    ({ "finished", 0,
+        (: log && strstr(log, "GC finished after") >= 0 :)
+    }),
+    ({ "snapshot", 0,
+        (: log && strstr(log, "GC snapshot found") >= 0 :)
+    }),
+    ({ "slices", 0,
+        (: driver_info(DI_NUM_GC_SLICES) > 1
+        && driver_info(DI_GC_MAX_SLICE) > 0 :)
+    }),
+    ({ "pause", 0,
+        (: driver_info(DI_GC_LAST_PAUSE) > 0
+        && driver_info(DI_GC_MAX_PAUSE) >= driver_info(DI_GC_LAST_PAUSE) :)
+    }),
+    ({ "garbage freed", 0,
+        (: log && sizeof(regexp(explode(log, "\n"), "freeing small block")) :)
+    }),
+    ({ "data kept", 0,
+        #'check_data
+    }),
+    ({ "garbage references dropped", 0,
+        /* Only the destructed key of the stale mapping is left. */
+        (: driver_info(DI_NUM_OBJECTS_DESTRUCTED)
+         + driver_info(DI_NUM_OBJECTS_NEWLY_DESTRUCTED) <= 1 :)
+    }),
+    ({ "stale mapping data kept", 0,
+        #'check_stale
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the incremental GC:\n"
+          "------------------------------------\n");
+
+    run_array(tests,
+        (:
+            configure_driver(DC_GC_SLICE_TIME, 0);
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+/* Wait until the incremental GC is finished. */
+void wait_gc(int tries)
+{
+    make_data(sizeof(kept));
+
+    log = read_file(LOG_FILE);
+    if ((!log || strstr(log, "GC finished after") < 0) && tries < 30)
+    {
+        call_out(#'wait_gc, 1, tries + 1);
+        return;
+    }
+
+    /* Let the backend free the destructed objects first. */
+    rm(LOG_FILE);
+    call_out(#'run_test, 1);
+}
+
+string *epilog(int eflag)
+{
+    configure_driver(DC_GC_SLICE_TIME, 1);
+    make_garbage();
+    make_dangling();
+    make_stale();
+    make_data(0);
+
+    garbage_collection(LOG_FILE);
+    call_out(#'wait_gc, 0, 0);
+    return 0;
+}
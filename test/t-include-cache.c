@@ -0,0 +1,205 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/deep_eq.inc"
+
+#include "/sys/driver_hook.h"
+#include "/sys/driver_info.h"
+
+/* Tests for the include cache.
+ *
+ * The headers are written first. Files modified in the current second
+ * are not cached, so the tests start two seconds later.
+ */
+
+#define DIR "/log/inc-cache/"
+#define SEARCH "/log/inc-cache/search.c"
+
+mapping headers = ([
+    "defs.h":
+        "#ifndef DEFS_H\n"
+        "#define DEFS_H\n"
+        "#define VALUE 42\n"
+        "#define ADD(a,b) ((a)+(b))\n"
+        "#include \"more.h\"\n"
+        "#endif\n",
+    "more.h":
+        "#ifdef EXTRA\n"
+        "#define HAS_EXTRA 1\n"
+        "#else\n"
+        "#define HAS_EXTRA 0\n"
+        "#endif\n"
+        "#undef TO_UNDEF\n",
+    "code.h":
+        "#define FROM_CODE 1\n"
+        "int from_header() { return FROM_CODE; }\n",
+]);
+
+mapping objects = ([
+    "plain.c":
+        "#define TO_UNDEF\n"
+        "#include \"defs.h\"\n"
+        "mixed *query() { return ({ ADD(VALUE, 0), HAS_EXTRA,\n"
+        "#ifdef TO_UNDEF\n"
+        "  1\n"
+        "#else\n"
+        "  0\n"
+        "#endif\n"
+        "  , __LINE__ }); }\n",
+    "extra.c":
+        "#define EXTRA\n"
+        "#include \"defs.h\"\n"
+        "#include \"defs.h\"\n"
+        "mixed *query() { return ({ ADD(VALUE, 1), HAS_EXTRA, 0, __LINE__ }); }\n",
+    "code.c":
+        "#include \"code.h\"\n"
+        "mixed *query() { return ({ from_header(), FROM_CODE, 0, __LINE__ }); }\n",
+    "conflict.c":
+        "#define VALUE 1\n"
+        "#include \"defs.h\"\n"
+        "mixed *query() { return ({ VALUE }); }\n",
+]);
+
+mapping expected = ([
+    "plain.c":    ({ 42, 0, 0, 9 }),
+    "extra.c":    ({ 43, 1, 0, 4 }),
+    "code.c":     ({ 1, 1, 0, 2 }),
+    "conflict.c": 0,
+]);
+
+/* Compile all objects and return their query() results and include lists.
+ * Objects which don't compile are 0.
+ */
+mapping compile_all()
+{
+    mapping result = ([]);
+
+    foreach (string file: objects)
+    {
+        object ob = find_object(DIR + file);
+
+        if (ob)
+            destruct(ob);
+        if (catch(ob = load_object(DIR + file); nolog))
+            result[file] = 0;
+        else
+            result[file] = ({ ob->query(), include_list(ob) });
+    }
+    return result;
+}
+
+/* Check that the results of compile_all() are as expected. */
+int check_results(mapping result)
+{
+    foreach (string file, mixed res: result)
+    {
+        if (!res != !expected[file])
+            return 0;
+        if (res && deep_eq(res[0], expected[file]) == 0)
+            return 0;
+    }
+    return 1;
+}
+
+/* Compile SEARCH, which <>-includes found.h, and return its result. */
+int compile_search()
+{
+    object ob = find_object(SEARCH);
+
+    if (ob)
+        destruct(ob);
+    return load_object(SEARCH)->query();
+}
+
+mapping first_result;
+
+mixed *tests = ({
+    ({ "first compile", 0,
+        function int ()
+        {
+            first_result = compile_all();
+            return check_results(first_result);
+        }
+    }),
+    ({ "compile with the include cache", 0,
+        function int ()
+        {
+            int hits = driver_info(DI_NUM_INCLUDE_CACHE_HITS);
+            int replays = driver_info(DI_NUM_INCLUDE_CACHE_REPLAYS);
+            mapping result = compile_all();
+
+            return check_results(result)
+                && deep_eq(result, first_result)
+                && driver_info(DI_NUM_INCLUDE_CACHE_HITS) > hits
+                && driver_info(DI_NUM_INCLUDE_CACHE_REPLAYS) > replays;
+        }
+    }),
+    ({ "changed header", 0,
+        function int ()
+        {
+            mapping result;
+
+            rm(DIR "more.h");
+            write_file(DIR "more.h", "#define HAS_EXTRA 2\n");
+            result = compile_all();
+            return result["plain.c"][0][1] == 2
+                && result["extra.c"][0][1] == 2;
+        }
+    }),
+    ({ "new header in an earlier include dir", 0,
+        function int ()
+        {
+            if (compile_search() != 2 || compile_search() != 2)
+                return 0;
+            write_file(DIR "first/found.h", "#define FOUND 1\n");
+            return compile_search() == 1;
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the include cache:\n"
+          "-----------------------------------\n");
+
+    run_array(tests,
+        (:
+            foreach (string file: objects + headers)
+                rm(DIR + file);
+            rm(DIR "first/found.h");
+            rm(DIR "second/found.h");
+            rm(SEARCH);
+            rmdir(DIR "first");
+            rmdir(DIR "second");
+            rmdir(DIR);
+
+            if($1)
+                shutdown(1);
+            else
+                shutdown(0);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    mkdir(DIR);
+    foreach (string file, string text: headers + objects)
+    {
+        rm(DIR + file);
+        write_file(DIR + file, text);
+    }
+
+    mkdir(DIR "first");
+    mkdir(DIR "second");
+    rm(DIR "first/found.h");
+    rm(DIR "second/found.h");
+    rm(SEARCH);
+    write_file(DIR "second/found.h", "#define FOUND 2\n");
+    write_file(SEARCH, "#include <found.h>\n"
+                       "int query() { return FOUND; }\n");
+    set_driver_hook(H_INCLUDE_DIRS, ({ DIR "first/", DIR "second/" }));
+
+    call_out(#'run_test, 2);
+    return 0;
+}
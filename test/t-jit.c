@@ -0,0 +1,233 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for loops that are compiled to native code when the driver
+ * has been configured with --enable-jit. Every loop runs long enough
+ * to become hot, the results must be the same as the interpreter's.
+ */
+
+#define HOT 5000
+
+/* One step of the arithmetic loop, executed by the interpreter. */
+int step(int acc, int i)
+{
+    acc = (acc * 3 + i / 7 - i % 5) & 0xffffff;
+    acc ^= (i << 3) | (acc >> 2);
+    acc += (i < 100) + (i <= 50) + (i > 4000) + (i >= 10) + (i == 7)
+         + (i != 8) + !(i & 1) + (~i & 3) + ((-i) >>> 60);
+    return acc;
+}
+
+int arithmetic(int n)
+{
+    int acc = 1;
+
+    for (int i = 0; i < n; i++)
+    {
+        acc = (acc * 3 + i / 7 - i % 5) & 0xffffff;
+        acc ^= (i << 3) | (acc >> 2);
+        acc += (i < 100) + (i <= 50) + (i > 4000) + (i >= 10) + (i == 7)
+             + (i != 8) + !(i & 1) + (~i & 3) + ((-i) >>> 60);
+    }
+    return acc;
+}
+
+int sum(int n)
+{
+    int s;
+
+    for (int i = 0; i < n; i++)
+        s += i;
+    return s;
+}
+
+mixed sum_mixed(mixed s, int n)
+{
+    for (int i = 0; i < n; i++)
+        s += i;
+    return s;
+}
+
+int nested(int n)
+{
+    int count, i = 0;
+
+    while (i < n)
+    {
+        int j = 0;
+
+        do
+        {
+            if (j % 3 == 0 || j == i)
+                count += 2;
+            else if (!(j & 4))
+                count--;
+            j++;
+        } while (j < 20);
+        i++;
+    }
+    return count;
+}
+
+void add_to(int x, int n)
+{
+    for (int i = 0; i < n; i++)
+        x += i;
+}
+
+/* Only used by the eval cost test, so it is cold when that starts. */
+int branches(int n)
+{
+    int count;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (i % 3 == 0 || i == 7)
+            count += 2;
+        else if (!(i & 4))
+            count--;
+    }
+    return count;
+}
+
+/* Increment a number until it overflows. */
+void overflow()
+{
+    int x = __INT_MAX__ - HOT;
+
+    for (int i = 0; i < 2 * HOT; i++)
+        x += 1;
+}
+
+/* Divide by a number that reaches 0 after HOT iterations. */
+void divide()
+{
+    int x;
+
+    for (int i = 0; i < 2 * HOT; i++)
+        x = 1000 / (HOT - i);
+}
+
+int endless()
+{
+    int i;
+
+    while (1)
+        i++;
+    return i;
+}
+
+/* The eval cost of the call of <fun> with <arg>. */
+int cost(closure fun, int arg)
+{
+    int before = get_eval_cost();
+
+    funcall(fun, arg);
+    return before - get_eval_cost();
+}
+
+mixed *tests = ({
+    ({ "sum", 0,
+        (: sum(HOT) == HOT * (HOT - 1) / 2 && sum(3) == 3 :)
+    }),
+    ({ "arithmetic", 0,
+        function int ()
+        {
+            int acc = 1;
+
+            for (int i = 0; i < HOT; i++)
+                acc = step(acc, i);
+            return arithmetic(HOT) == acc && arithmetic(HOT) == acc;
+        }
+    }),
+    ({ "nested loops", 0,
+        (: nested(10) == 75 && nested(HOT) == 30034 && nested(200) == 1234 :)
+    }),
+    ({ "other types", 0,
+        (: sum_mixed(0, HOT) == HOT * (HOT - 1) / 2
+        && sum_mixed(0.5, 4) == 6.5
+        && sum_mixed("", 4) == "0123"
+        && sum_mixed(({}), 0) == ({}) :)
+    }),
+    ({ "references", 0,
+        function int ()
+        {
+            int x = 1;
+
+            add_to(&x, HOT);
+            add_to(&x, 3);
+            return x == 1 + HOT * (HOT - 1) / 2 + 3;
+        }
+    }),
+    ({ "numeric overflow", 0,
+        function int ()
+        {
+            string err = catch(overflow(); nolog);
+
+            return sizeof(err) && strstr(err, "Numeric overflow") >= 0;
+        }
+    }),
+    ({ "division by zero", 0,
+        function int ()
+        {
+            string err = catch(divide(); nolog);
+
+            return sizeof(err) && strstr(err, "Division by zero") >= 0;
+        }
+    }),
+    ({ "eval cost", 0,
+        function int ()
+        {
+            int cold = cost(#'branches, 100);
+
+            branches(HOT);
+            return cost(#'branches, 100) == cold;
+        }
+    }),
+    ({ "too long evaluation", 0,
+        function int ()
+        {
+            string err = catch(limited(#'endless, ({ 100000 })); nolog);
+
+            return sizeof(err) && strstr(err, "Too long evaluation") >= 0;
+        }
+    }),
+    ({ "driver_info", 0,
+        function int ()
+        {
+#ifdef __JIT__
+            return driver_info(DI_NUM_JIT_LOOPS_COMPILED) > 0
+                && driver_info(DI_NUM_JIT_RUNS) > 0
+                && driver_info(DI_SIZE_JIT_CODE) > 0;
+#else
+            return driver_info(DI_NUM_JIT_LOOPS_COMPILED) == 0
+                && driver_info(DI_NUM_JIT_RUNS) == 0;
+#endif
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the JIT compiler:\n"
+          "----------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+#include "/inc/deep_eq.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for the mapping compaction and its statistics.
+ */
+
+#define NUM_KEYS 1000
+
+mapping hashed, hybrid;
+int compactions;
+
+mixed *tests = ({
+    ({ "lookups in the hash part", 0,
+        function int ()
+        {
+            hashed = ([]);
+            for (int i = 0; i < NUM_KEYS; i++)
+                hashed[i] = i * 2;
+            for (int i = 0; i < NUM_KEYS; i++)
+                if (hashed[i] != i * 2)
+                    return 0;
+            return !member(hashed, NUM_KEYS) && sizeof(hashed) == NUM_KEYS;
+        }
+    }),
+    ({ "deletions from the hash part", 0,
+        function int ()
+        {
+            for (int i = 0; i < NUM_KEYS; i += 2)
+                m_delete(hashed, i);
+            for (int i = 0; i < NUM_KEYS; i++)
+                if (member(hashed, i) != (i % 2))
+                    return 0;
+            return sizeof(hashed) == NUM_KEYS / 2;
+        }
+    }),
+    ({ "reinsertion after deletions", 0,
+        function int ()
+        {
+            for (int i = 0; i < NUM_KEYS; i += 2)
+                hashed[i] = i * 2;
+            for (int i = 0; i < NUM_KEYS; i++)
+                if (hashed[i] != i * 2)
+                    return 0;
+            return sizeof(hashed) == NUM_KEYS;
+        }
+    }),
+    ({ "hybrid mapping", 0,
+        function int ()
+        {
+            /* Literal mappings are created condensed. */
+            hybrid = ([ "a": 1, "b": 2, "c": 3 ]);
+            m_delete(hybrid, "b");
+            hybrid["d"] = 4;
+            return deep_eq(hybrid, ([ "a": 1, "c": 3, "d": 4 ]));
+        }
+    }),
+    ({ "compaction statistics", 0,
+        (: driver_info(DI_NUM_MAPPING_COMPACTIONS) >= 0
+        && driver_info(DI_NUM_MAPPING_COMPACTIONS_LAST_CYCLE) >= 0
+        && driver_info(DI_SIZE_MAPPING_COMPACTIONS_SAVED) >= 0
+        && driver_info(DI_SIZE_MAPPING_COMPACTIONS_SAVED_LAST_CYCLE) >= 0 :)
+    }),
+});
+
+void check_compaction(int gc_error)
+{
+    if (gc_error)
+    {
+        shutdown(1);
+        return;
+    }
+
+    if (driver_info(DI_NUM_MAPPING_COMPACTIONS) < compactions + 2
+     || driver_info(DI_SIZE_MAPPING_COMPACTIONS_SAVED) <= 0)
+    {
+        msg("Mappings weren't compacted by the GC: %d compactions, %d bytes.\n",
+            driver_info(DI_NUM_MAPPING_COMPACTIONS),
+            driver_info(DI_SIZE_MAPPING_COMPACTIONS_SAVED));
+        shutdown(1);
+        return;
+    }
+
+    for (int i = 0; i < NUM_KEYS; i++)
+        if (hashed[i] != i * 2)
+        {
+            msg("Wrong value after compaction for key %d.\n", i);
+            shutdown(1);
+            return;
+        }
+
+    if (!deep_eq(hybrid, ([ "a": 1, "c": 3, "d": 4 ])))
+    {
+        msg("Wrong hybrid mapping after compaction.\n");
+        shutdown(1);
+        return;
+    }
+
+    msg("Compacted mappings: %d, %d bytes saved.\n",
+        driver_info(DI_NUM_MAPPING_COMPACTIONS),
+        driver_info(DI_SIZE_MAPPING_COMPACTIONS_SAVED));
+    shutdown(0);
+}
+
+void run_test()
+{
+    msg("\nRunning test for the mapping compaction:\n"
+          "----------------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+            {
+                compactions = driver_info(DI_NUM_MAPPING_COMPACTIONS);
+                start_gc(#'check_compaction);
+            }
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "/inc/base.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/driver_info.h"
+
+/* Test that the allocator gives free memory back to the system.
+ */
+
+mixed *big;
+
+void check_release()
+{
+    string name = driver_info(DI_MEMORY_ALLOCATOR_NAME);
+
+    msg("\nRunning test for the release of free memory:\n"
+          "--------------------------------------------\n");
+
+    /* Only slaballoc and smalloc release memory. */
+    if (name != "slaballoc" && name != "smalloc")
+    {
+        start_gc(#'shutdown);
+        return;
+    }
+
+    if (driver_info(DI_NUM_LARGE_BLOCKS_RELEASED) > 0
+     && driver_info(DI_SIZE_LARGE_BLOCKS_RELEASED) >= 4 * 0x40000
+     && driver_info(DI_SIZE_LARGE_BLOCKS_RELEASED)
+        <= driver_info(DI_SIZE_LARGE_BLOCKS_FREE))
+    {
+        msg("Success.\n");
+        start_gc(#'shutdown);
+    }
+    else
+    {
+        msg("FAILURE! Released %d blocks with %d bytes.\n"
+           , driver_info(DI_NUM_LARGE_BLOCKS_RELEASED)
+           , driver_info(DI_SIZE_LARGE_BLOCKS_RELEASED));
+        shutdown(1);
+    }
+}
+
+string *epilog(int eflag)
+{
+    /* A free block of 16 MB, the GC then gives it back. */
+    big = allocate(2000000);
+    big = 0;
+
+    garbage_collection();
+    call_out(#'check_release, 1);
+    return 0;
+}
@@ -0,0 +1,3 @@
+# Run the object queue test with short reset and clean_up times.
+${DRIVER} ${DRIVER_DEFAULTS} --reset-time 3 --cleanup-time 2 -m. \
+    -Mgeneric/object_queues --debug-file=${TEST_LOGFILE} > /dev/null || exit 1
@@ -0,0 +1,89 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for the resizing of the object table.
+ */
+
+#define NUM_CLONES 10000
+
+object *clones;
+int initial_slots;
+
+mixed *tests = ({
+    ({ "table grows", 0,
+        function int ()
+        {
+            initial_slots = driver_info(DI_NUM_OBJECT_TABLE_SLOTS);
+
+            clones = allocate(NUM_CLONES);
+            for (int i = 0; i < NUM_CLONES; i++)
+                clones[i] = clone_object(this_object());
+
+            return driver_info(DI_NUM_OBJECT_TABLE_SLOTS) > initial_slots;
+        }
+    }),
+    ({ "find_object after growing", 0,
+        function int ()
+        {
+            foreach (object ob: clones)
+                if (find_object(object_name(ob)) != ob)
+                    return 0;
+            return find_object(object_name(this_object())) == this_object();
+        }
+    }),
+    ({ "destruct clones", 0,
+        function int ()
+        {
+            foreach (object ob: clones)
+                destruct(ob);
+            clones = 0;
+            return driver_info(DI_NUM_OBJECTS_IN_TABLE) < NUM_CLONES;
+        }
+    }),
+});
+
+void check_shrink()
+{
+    if (driver_info(DI_NUM_OBJECT_TABLE_SLOTS) != initial_slots)
+    {
+        msg("Object table didn't shrink: %d slots.\n",
+            driver_info(DI_NUM_OBJECT_TABLE_SLOTS));
+        shutdown(1);
+        return;
+    }
+
+    if (find_object(object_name(this_object())) != this_object())
+    {
+        msg("Master not found after shrinking the object table.\n");
+        shutdown(1);
+        return;
+    }
+
+    msg("Object table shrunk to %d slots.\n", driver_info(DI_NUM_OBJECT_TABLE_SLOTS));
+    start_gc(#'shutdown);
+}
+
+void run_test()
+{
+    msg("\nRunning test for the object table:\n"
+          "----------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                call_out("check_shrink", 4);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
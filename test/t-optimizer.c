@@ -0,0 +1,297 @@
+#pragma strong_types
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+
+/* Tests for the optimizer: the optimized code must compute the same
+ * results as the code it replaces.
+ *
+ * The optimizer doesn't track the locals of inline closures, so the
+ * tests are mostly done in normal functions.
+ */
+
+int zero() { return 0; }
+
+void set_five(int i) { i = 5; }
+
+void clear_arr(int *arr) { arr = ({}); }
+
+int folding()
+{
+    return 2 + 3 * 4 == 14 && 7 / 2 == 3 && 7 % 3 == 1 && -7 / 2 == -3
+        && (5 & 3) == 1 && (5 | 3) == 7 && (5 ^ 3) == 6
+        && (1 < 2) == 1 && (2 <= 1) == 0 && !0 == 1 && ~0 == -1
+        && -__INT_MAX__ - 1 == __INT_MIN__;
+}
+
+int division_by_zero()
+{
+    int a = 5, b;
+
+    return a / b;
+}
+
+int propagation()
+{
+    int a = 3, b;
+    int c = a * 4 + b;
+
+    b = c - 2;
+    a = 1;
+    return a == 1 && b == 10 && c == 12;
+}
+
+int propagation_branches()
+{
+    int a = 1;
+
+    if (zero())
+        a = 2;
+    else
+        a += 5;
+    return a + 1 == 7;
+}
+
+int propagation_loops()
+{
+    int a = 1, n;
+
+    while (n < 4)
+    {
+        n += a;
+        a = 2;
+    }
+    return n == 5;
+}
+
+int propagation_references()
+{
+    int a = 1;
+
+    set_five(&a);
+    return a + 1 == 6;
+}
+
+int redundant_stores()
+{
+    int a = 0, b;
+
+    a = 0;
+    b = 0;
+    if (zero() == 0)
+        b = 4;
+    b = 0;
+    return a == 0 && b == 0;
+}
+
+int constant_conditions()
+{
+    int a = 1;
+
+    if (0)
+        a = 99;
+    if (1)
+        a += 2;
+    else
+        a = 99;
+    if (0)
+        a = 99;
+    else
+        a += 3;
+    return a == 6;
+}
+
+int classify(int i)
+{
+    switch (i)
+    {
+    case 0:
+        return 10;
+        i = 5;
+    case 1:
+        i += 20;
+        break;
+        i = 6;
+    default:
+        i += 30;
+    }
+    return i;
+}
+
+int sign(int i)
+{
+    if (i < 0)
+        return -1;
+    else if (i > 0)
+        return 1;
+    else
+        return 0;
+}
+
+int count_odd(int *arr)
+{
+    int n;
+
+    foreach (int i: arr)
+    {
+        if (i < 0)
+            break;
+        else if (i % 2 == 0)
+            continue;
+        else
+            n++;
+    }
+    return n;
+}
+
+int first_big(int *arr)
+{
+    int i;
+
+    while (1)
+    {
+        if (arr[i] > 10)
+            break;
+        i++;
+    }
+    return i;
+}
+
+int endless_loops()
+{
+    int n;
+
+    for (;;)
+        if (++n == 3)
+            break;
+    while (1)
+    {
+        if (n++ > 5)
+            break;
+        continue;
+    }
+    do
+        n++;
+    while (0);
+    return n == 8;
+}
+
+int sum_all(int *arr)
+{
+    int sum;
+
+    for (int i = 0; i < sizeof(arr); i++)
+        sum += arr[i];
+    return sum;
+}
+
+int count_chars(string str)
+{
+    int n, i;
+
+    while (i < sizeof(str))
+    {
+        if (str[i] == 'a')
+            n++;
+        i++;
+    }
+    return n;
+}
+
+int sum_nested(int *arr)
+{
+    int sum;
+
+    for (int i = 0; i < sizeof(arr); i++)
+        for (int j = 0; j < sizeof(arr); j++)
+            sum += arr[i] * arr[j];
+    return sum;
+}
+
+int sum_shrinking(int *arr)
+{
+    int sum;
+
+    for (int i = 0; i < sizeof(arr); i++)
+    {
+        sum += arr[i];
+        if (i == 1)
+            arr = arr[0..1];
+    }
+    return sum;
+}
+
+int sum_by_ref(int *arr)
+{
+    int sum;
+    int *copy = arr;
+
+    for (int i = 0; i < sizeof(copy); i++)
+    {
+        sum += copy[i];
+        clear_arr(&copy);
+    }
+    return sum;
+}
+
+int inline_closures()
+{
+    int a = 2;
+    closure cl = function int (int x) { int y = 0; return x + y + a; };
+
+    if (0)
+        cl = 0;
+    a = 3;
+    return funcall(cl, a) == 5 && a == 3;
+}
+
+mixed *tests = ({
+    ({ "constant folding", 0, #'folding }),
+    ({ "division by zero", TF_ERROR, #'division_by_zero }),
+    ({ "constant propagation", 0, #'propagation }),
+    ({ "propagation across branches", 0, #'propagation_branches }),
+    ({ "propagation in loops", 0, #'propagation_loops }),
+    ({ "propagation with references", 0, #'propagation_references }),
+    ({ "redundant stores", 0, #'redundant_stores }),
+    ({ "if with constant condition", 0, #'constant_conditions }),
+    ({ "unreachable code", 0,
+        (: classify(0) == 10 && classify(1) == 21 && classify(2) == 32 :)
+    }),
+    ({ "if-parts ending in jumps", 0,
+        (: sign(-5) == -1 && sign(0) == 0 && sign(7) == 1
+        && count_odd(({ 1, 2, 3, 5, -1, 7 })) == 3 :)
+    }),
+    ({ "endless loops", 0,
+        (: endless_loops() && first_big(({ 1, 5, 12 })) == 2 :)
+    }),
+    ({ "hoisted sizeof", 0,
+        (: sum_all(({ 1, 2, 3, 4 })) == 10 && sum_all(({})) == 0
+        && count_chars("banana") == 3 && sum_nested(({ 1, 2 })) == 9 :)
+    }),
+    ({ "sizeof not hoisted", 0,
+        (: sum_shrinking(({ 1, 2, 3, 4 })) == 3
+        && sum_by_ref(({ 1, 2, 3 })) == 1 :)
+    }),
+    ({ "inline closures", 0, #'inline_closures }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the optimizer:\n"
+          "-------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                shutdown(0);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
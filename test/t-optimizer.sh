@@ -0,0 +1,25 @@
+# Compile the lp-245 mudlib with and without the optimizer and compare
+# the sizes of the programs.
+echo
+echo "Running test for the optimizer on mud/lp-245:"
+echo "---------------------------------------------"
+OPTIONS=""
+SKIP=""
+# filter the python script, it's not found in the other mudlib
+for option in ${DRIVER_DEFAULTS}; do
+    if [ -n "${SKIP}" ]; then SKIP=""; continue; fi
+    case ${option} in
+    --python-script) SKIP=1 ;;
+    *)  OPTIONS="${OPTIONS} ${option}" ;;
+    esac
+done
+LIB=log/lp-245
+rm -rf ${LIB}
+cp -R ../mud/lp-245 ${LIB} && cp generic/optimizer.c ${LIB}/ || exit 1
+(cd ${LIB} && find . -name "*.c" ! -name optimizer.c | sed 's/^\.//' | sort) \
+    > ${LIB}/files
+${DRIVER} ${OPTIONS} -m${LIB} -Moptimizer \
+    --debug-file "`pwd`/${TEST_LOGFILE}" > /dev/null
+RC=$?
+rm -rf ${LIB}
+exit ${RC}
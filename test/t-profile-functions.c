@@ -0,0 +1,152 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+
+/* Tests for the accounting of the function calls.
+ */
+
+int leaf(int n)
+{
+    int x;
+
+    for (int i = 0; i < n; i++)
+        x += i;
+    return x;
+}
+
+void outer()
+{
+    for (int i = 0; i < 3; i++)
+        leaf(100);
+}
+
+int fact(int n)
+{
+    return n <= 1 ? 1 : n * fact(n - 1);
+}
+
+void fail()
+{
+    leaf(10);
+    raise_error("Failed\n");
+}
+
+/* The numbers of the function <fun> of this program. */
+int *numbers(string fun)
+{
+    mapping m = driver_info(DI_PROFILE_FUNCTIONS);
+    string key = program_name() + ":" + fun;
+
+    if (key[0] == '/')
+        key = key[1..];
+    if (!member(m, key))
+        return 0;
+    return map(({ PROFILE_CALLS, PROFILE_TICKS_SELF, PROFILE_TICKS,
+                  PROFILE_TIME_SELF, PROFILE_TIME }),
+               (: $2[$3, $1] :), m, key);
+}
+
+mixed *tests = ({
+    ({ "start", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_FUNCTIONS, 1);
+            return driver_info(DC_PROFILE_FUNCTIONS) == 1;
+        }
+    }),
+    ({ "calls", 0,
+        function int ()
+        {
+            outer();
+            fact(10);
+            catch(fail(); nolog);
+            leaf(0);
+
+            return numbers("outer")[PROFILE_CALLS] == 1
+                && numbers("leaf")[PROFILE_CALLS] == 5
+                && numbers("fact")[PROFILE_CALLS] == 10
+                && numbers("fail")[PROFILE_CALLS] == 1;
+        }
+    }),
+    ({ "inclusive ticks", 0,
+        function int ()
+        {
+            int *o = numbers("outer"), *l = numbers("leaf");
+
+            return o[PROFILE_TICKS] > o[PROFILE_TICKS_SELF]
+                && o[PROFILE_TICKS_SELF] > 0
+                && o[PROFILE_TICKS] < o[PROFILE_TICKS_SELF] + l[PROFILE_TICKS]
+                && l[PROFILE_TICKS] == l[PROFILE_TICKS_SELF]
+                && o[PROFILE_TIME] >= o[PROFILE_TIME_SELF];
+        }
+    }),
+    ({ "recursion", 0,
+        function int ()
+        {
+            int *f = numbers("fact");
+
+            /* Only the outermost call adds the inclusive numbers. */
+            return f[PROFILE_TICKS] == f[PROFILE_TICKS_SELF]
+                && f[PROFILE_TIME] == f[PROFILE_TIME_SELF];
+        }
+    }),
+    ({ "error", 0,
+        function int ()
+        {
+            int *f = numbers("fail");
+
+            return f[PROFILE_TICKS] > f[PROFILE_TICKS_SELF]
+                && f[PROFILE_TICKS_SELF] > 0;
+        }
+    }),
+    ({ "lambda", 0,
+        function int ()
+        {
+            funcall(lambda(0, ({ #'leaf, 10 })));
+            return sizeof(filter(m_indices(driver_info(DI_PROFILE_FUNCTIONS)),
+                                 (: $1[<9..] == ":<lambda>" :)));
+        }
+    }),
+    ({ "stop", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_FUNCTIONS, 0);
+            outer();
+            return driver_info(DC_PROFILE_FUNCTIONS) == 0
+                && numbers("outer")[PROFILE_CALLS] == 1;
+        }
+    }),
+    ({ "reset", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_FUNCTIONS, 1);
+            configure_driver(DC_PROFILE_FUNCTIONS, 0);
+            return numbers("outer") == 0;
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the function profile:\n"
+          "--------------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/configuration.h"
+#include "/sys/driver_info.h"
+#include "/sys/rtlimits.h"
+
+/* Tests for the sampling profiler.
+ */
+
+#define NUM_SAMPLES 20
+#define DUMP_FILE   "/log/t-profile.folded"
+
+int burn(int n)
+{
+    int x;
+
+    for (int i = 0; i < n; i++)
+        x += i * i;
+    return x;
+}
+
+/* Burn CPU time until the profiler took NUM_SAMPLES samples. */
+int sample()
+{
+    int end = time() + 30;
+
+    while (driver_info(DI_NUM_PROFILE_SAMPLES) < NUM_SAMPLES && time() < end)
+        catch(burn(10000));
+    return driver_info(DI_NUM_PROFILE_SAMPLES) >= NUM_SAMPLES;
+}
+
+mixed *tests = ({
+    ({ "illegal interval", TF_ERROR,
+        (: configure_driver(DC_PROFILE_INTERVAL, 50) :)
+    }),
+    ({ "start", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_INTERVAL, 1000);
+            return driver_info(DC_PROFILE_INTERVAL) == 1000
+                && driver_info(DI_NUM_PROFILE_SAMPLES) == 0;
+        }
+    }),
+    ({ "sampling", 0,
+        (: limited(#'sample, ({ LIMIT_UNLIMITED })) :)
+    }),
+    ({ "stop", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_INTERVAL, 0);
+            return driver_info(DC_PROFILE_INTERVAL) == 0
+                && driver_info(DI_NUM_PROFILE_SAMPLES) >= NUM_SAMPLES;
+        }
+    }),
+    ({ "samples", 0,
+        function int ()
+        {
+            mapping samples = driver_info(DI_PROFILE_SAMPLES);
+            int sum;
+
+            foreach (string stack, int count: samples)
+                sum += count;
+
+            /* The catch() frame isn't recorded. */
+            return sum == driver_info(DI_NUM_PROFILE_SAMPLES)
+                          - driver_info(DI_NUM_PROFILE_SAMPLES_LOST)
+                && sizeof(regexp(m_indices(samples),
+                       ":sample:[0-9]+;[^;]*:burn:[0-9]+$"));
+        }
+    }),
+    ({ "dump", 0,
+        function int ()
+        {
+            string *lines;
+            int sum;
+
+            if (!dump_driver_info(DDI_PROFILE, DUMP_FILE))
+                return 0;
+            lines = explode(read_file(DUMP_FILE), "\n") - ({ "" });
+            rm(DUMP_FILE);
+
+            foreach (string line: lines)
+            {
+                string stack;
+                int count;
+
+                if (sscanf(line, "%s %d", stack, count) != 2
+                 || driver_info(DI_PROFILE_SAMPLES)[stack] != count)
+                    return 0;
+                sum += count;
+            }
+            return sizeof(lines) == sizeof(driver_info(DI_PROFILE_SAMPLES))
+                && sum == driver_info(DI_NUM_PROFILE_SAMPLES)
+                          - driver_info(DI_NUM_PROFILE_SAMPLES_LOST);
+        }
+    }),
+    ({ "restart", 0,
+        function int ()
+        {
+            configure_driver(DC_PROFILE_INTERVAL, 1000);
+            configure_driver(DC_PROFILE_INTERVAL, 0);
+            return sizeof(driver_info(DI_PROFILE_SAMPLES)) <= 1;
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for the profiler:\n"
+          "------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
@@ -0,0 +1,29 @@
+# Compile the lp-245 mudlib twice with the program cache: the second run
+# must take the programs from the cache and get the same programs.
+echo
+echo "Running test for the program cache on mud/lp-245:"
+echo "-------------------------------------------------"
+OPTIONS=""
+SKIP=""
+# filter the python script, it's not found in the other mudlib
+for option in ${DRIVER_DEFAULTS}; do
+    if [ -n "${SKIP}" ]; then SKIP=""; continue; fi
+    case ${option} in
+    --python-script) SKIP=1 ;;
+    *)  OPTIONS="${OPTIONS} ${option}" ;;
+    esac
+done
+LIB=log/lp-245-cache
+CACHE="`pwd`/log/prog-cache"
+rm -rf ${LIB} ${CACHE}
+mkdir ${CACHE} || exit 1
+cp -R ../mud/lp-245 ${LIB} && cp generic/prog_cache.c ${LIB}/ || exit 1
+(cd ${LIB} && find . -name "*.c" ! -name prog_cache.c | sed 's/^\.//' | sort) \
+    > ${LIB}/files
+RC=0
+for run in 1 2; do
+    ${DRIVER} ${OPTIONS} -m${LIB} -Mprog_cache --program-cache ${CACHE} \
+        --debug-file "`pwd`/${TEST_LOGFILE}" > /dev/null || { RC=1; break; }
+done
+rm -rf ${LIB} ${CACHE}
+exit ${RC}
@@ -0,0 +1,168 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+#include "/inc/deep_eq.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for strings built by repeated appends, which are extended in
+ * place when possible.
+ */
+
+#define NUM_LINES 200
+#define SAVE_FILE "/log/t-string-append"
+
+string description;
+string *lines;
+mapping rooms;
+
+/* Build a room description line by line. */
+string build(int num)
+{
+    string s = "";
+
+    for (int i = 0; i < num; i++)
+        s += "Line " + i + "\n";
+    return s;
+}
+
+mixed *tests = ({
+    ({ "appends in place", 0,
+        function int ()
+        {
+            int in_place = driver_info(DI_NUM_STRING_APPENDS_IN_PLACE);
+            int copied = driver_info(DI_NUM_STRING_APPENDS_COPIED);
+
+            lines = allocate(NUM_LINES);
+            for (int i = 0; i < NUM_LINES; i++)
+                lines[i] = "Line " + i;
+            description = build(NUM_LINES);
+
+            return driver_info(DI_NUM_STRING_APPENDS_IN_PLACE) - in_place
+                       > NUM_LINES / 2
+                && driver_info(DI_NUM_STRING_APPENDS_COPIED) - copied
+                       < NUM_LINES / 4;
+        }
+    }),
+    ({ "content", 0,
+        (: description == implode(lines, "\n") + "\n"
+        && sizeof(description) == sizeof(implode(lines, "\n")) + 1 :)
+    }),
+    ({ "comparison", 0,
+        function int ()
+        {
+            string s = build(NUM_LINES);
+
+            return s == description
+                && !(s < description) && !(s > description)
+                && build(NUM_LINES - 1) < description
+                && s + "" == description;
+        }
+    }),
+    ({ "sprintf", 0,
+        (: sprintf("%s", description) == description
+        && sprintf("<%-5s>", build(1)) == "<Line 0\n>"
+        && sprintf("%O", build(2)) == "\"Line 0\nLine 1\n\"" :)
+    }),
+    ({ "explode", 0,
+        (: deep_eq(explode(description, "\n"), lines + ({ "" }))
+        && deep_eq(explode(description, "\n")[<2..<2], ({ lines[<1] })) :)
+    }),
+    ({ "save_object", 0,
+        function int ()
+        {
+            string saved = description;
+
+            rooms = ([ build(3): build(2) ]);
+            save_object(SAVE_FILE);
+            description = rooms = 0;
+            restore_object(SAVE_FILE);
+            rm(SAVE_FILE ".o");
+
+            return description == saved
+                && deep_eq(rooms, ([ build(3): build(2) ]));
+        }
+    }),
+    ({ "save_value", 0,
+        (: restore_value(save_value(description)) == description :)
+    }),
+    ({ "mapping key after appends", 0,
+        function int ()
+        {
+            mapping m = ([ "abc": 1, "abcd": 2 ]);
+            string s = "a" + "";
+
+            s += "b";
+            s += "c";
+            if (m[s] != 1)
+                return 0;
+            s += "d";
+            return m[s] == 2 && member(m, s + "e") == 0;
+        }
+    }),
+    ({ "shared string", 0,
+        function int ()
+        {
+            string s = build(3);
+            string t = s;
+            string *arr = ({ s });
+
+            s += "more";
+            return t == build(3) && arr[0] == build(3)
+                && s == build(3) + "more";
+        }
+    }),
+    ({ "self append", 0,
+        function int ()
+        {
+            string s = build(2);
+
+            s += "x";
+            s += s;
+            return s == build(2) + "x" + build(2) + "x";
+        }
+    }),
+    ({ "numbers", 0,
+        function int ()
+        {
+            string s = "n";
+
+            for (int i = 0; i < 10; i++)
+                s += i;
+            s += 0.5;
+            return s == "n01234567890.5";
+        }
+    }),
+    ({ "array element", 0,
+        function int ()
+        {
+            string *arr = ({ "a" + "", "b" });
+
+            for (int i = 0; i < 10; i++)
+                arr[0] += "x";
+            return arr[0] == "a" + "xxxxxxxxxx" && arr[1] == "b";
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for string appends:\n"
+          "--------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                start_gc(#'shutdown);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/gc.inc"
+
+#include "/sys/driver_info.h"
+
+/* Tests for the resizing of the shared string table.
+ */
+
+#define NUM_KEYS 50000
+#define NUM_MAPPINGS 10
+
+/* Mapping keys are tabled strings; spread them over several mappings
+ * to stay below the mapping size limit.
+ */
+mapping *keys;
+int initial_slots;
+
+mixed *tests = ({
+    ({ "table grows", 0,
+        function int ()
+        {
+            initial_slots = driver_info(DI_NUM_STRING_TABLE_SLOTS);
+
+            keys = map(allocate(NUM_MAPPINGS), (: ([]) :));
+            for (int i = 0; i < NUM_KEYS; i++)
+                keys[i % NUM_MAPPINGS]["key " + i] = i;
+
+            return driver_info(DI_NUM_STRING_TABLE_SLOTS) > initial_slots
+                && driver_info(DI_NUM_STRING_TABLE_RESIZES) > 0;
+        }
+    }),
+    ({ "lookups after growing", 0,
+        function int ()
+        {
+            for (int i = 0; i < NUM_KEYS; i++)
+                if (keys[i % NUM_MAPPINGS]["key " + i] != i)
+                    return 0;
+            return sizeof(keys[0]) == NUM_KEYS / NUM_MAPPINGS;
+        }
+    }),
+    ({ "chain length", 0,
+        (: driver_info(DI_NUM_STRING_TABLE_LONGEST_CHAIN) < 32 :)
+    }),
+    ({ "slots used", 0,
+        (: driver_info(DI_NUM_STRING_TABLE_SLOTS_USED) <= driver_info(DI_NUM_STRING_TABLE_SLOTS)
+                + driver_info(DI_NUM_STRING_TABLE_CHAINS_TO_REHASH) :)
+    }),
+});
+
+void check_shrink()
+{
+    if (driver_info(DI_NUM_STRING_TABLE_CHAINS_TO_REHASH) != 0)
+    {
+        msg("String table resize wasn't finished: %d chains left.\n",
+            driver_info(DI_NUM_STRING_TABLE_CHAINS_TO_REHASH));
+        shutdown(1);
+        return;
+    }
+
+    if (driver_info(DI_NUM_STRING_TABLE_SLOTS) >= 4 * initial_slots)
+    {
+        msg("String table didn't shrink: %d slots.\n",
+            driver_info(DI_NUM_STRING_TABLE_SLOTS));
+        shutdown(1);
+        return;
+    }
+
+    msg("String table shrunk to %d slots.\n", driver_info(DI_NUM_STRING_TABLE_SLOTS));
+    start_gc(#'shutdown);
+}
+
+void run_test()
+{
+    msg("\nRunning test for the string table:\n"
+          "----------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+            {
+                keys = 0;
+                call_out("check_shrink", 4);
+            }
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}
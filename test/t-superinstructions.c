@@ -0,0 +1,177 @@
+#include "/inc/base.inc"
+#include "/inc/testarray.inc"
+#include "/inc/deep_eq.inc"
+
+/* Tests for the superinstructions: they must behave like the instruction
+ * sequences they replace, also for operands they don't handle themselves.
+ */
+
+int count_to(mixed limit)
+{
+    int i, n;
+
+    for (i = 0; i < limit; i++)
+        n++;
+    return n;
+}
+
+mixed *collect(mixed arr)
+{
+    mixed *res = ({});
+
+    for (int i = 0; i < sizeof(arr); i++)
+        res += ({ arr[i] });
+    return res;
+}
+
+void inc_ref(int i)
+{
+    i++;
+}
+
+mixed *tests = ({
+    ({ "local < clit loop", 0, (: count_to(10) == 10 :) }),
+    ({ "local < number loop", 0, (: count_to(1000) == 1000 :) }),
+    ({ "local < local loop", 0,
+        function int ()
+        {
+            int i, n, limit = 20;
+
+            while (i < limit)
+            {
+                i++;
+                n += 2;
+            }
+            return n == 40;
+        }
+    }),
+    ({ "local < float loop", 0, (: count_to(2.5) == 3 :) }),
+    ({ "local < clit result", 0,
+        function int ()
+        {
+            int a = 5, b = 50;
+            return (a < 10) == 1 && (b < 10) == 0;
+        }
+    }),
+    ({ "local < number with float", 0,
+        function int ()
+        {
+            float f = 0.5;
+            return (f < 1000) == 1;
+        }
+    }),
+    ({ "local < local with strings", 0,
+        function int ()
+        {
+            string a = "abc", b = "abd";
+            return (a < b) == 1 && (b < a) == 0;
+        }
+    }),
+    ({ "local < local with mismatch", TF_ERROR,
+        function int ()
+        {
+            mixed a = "abc", b = 1;
+            return a < b;
+        }
+    }),
+    ({ "local + local", 0,
+        function int ()
+        {
+            int a = 3, b = 4;
+            string s = "x", t = "y";
+            return a + b == 7 && a * b == 12 && s + t == "xy";
+        }
+    }),
+    ({ "index by local", 0,
+        (: deep_eq(collect(({ 1, "two", 3.0 })), ({ 1, "two", 3.0 }))
+        && deep_eq(collect("ab"), ({ 'a', 'b' })) :)
+    }),
+    ({ "index mapping by local", 0,
+        function int ()
+        {
+            mapping m = ([ "a": 1, "b": 2 ]);
+            string k = "b";
+            return m[k] == 2;
+        }
+    }),
+    ({ "index lvalue by local", 0,
+        function int ()
+        {
+            int *arr = ({ 0, 0, 0 });
+            mixed *nested = ({ ({ 0, 0 }), ({ 0, 0 }) });
+            int i = 1, j = 0;
+
+            arr[i] = 5;
+            arr[i]++;
+            nested[i][j] = 7;
+            return deep_eq(arr, ({ 0, 6, 0 }))
+                && deep_eq(nested, ({ ({ 0, 0 }), ({ 7, 0 }) }));
+        }
+    }),
+    ({ "index by non-number local", TF_ERROR,
+        function mixed ()
+        {
+            int *arr = ({ 1, 2 });
+            mixed i = "x";
+            return arr[i];
+        }
+    }),
+    ({ "increment of a local", 0,
+        function int ()
+        {
+            int i = 1;
+            float f = 1.5;
+            int j;
+
+            i++;
+            ++i;
+            f++;
+            j = i++;
+            return i == 4 && j == 3 && f == 2.5;
+        }
+    }),
+    ({ "increment of a reference", 0,
+        function int ()
+        {
+            int i = 1;
+            inc_ref(&i);
+            return i == 2;
+        }
+    }),
+    ({ "increment overflow", TF_ERROR,
+        function void ()
+        {
+            int i = __INT_MAX__;
+            i++;
+        }
+    }),
+    ({ "increment of a string", TF_ERROR,
+        function void ()
+        {
+            mixed s = "abc";
+            s++;
+        }
+    }),
+});
+
+void run_test()
+{
+    msg("\nRunning test for superinstructions:\n"
+          "-----------------------------------\n");
+
+    run_array(tests,
+        (:
+            if($1)
+                shutdown(1);
+            else
+                shutdown(0);
+
+            return 0;
+        :));
+}
+
+string *epilog(int eflag)
+{
+    run_test();
+    return 0;
+}